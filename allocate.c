@@ -43,6 +43,10 @@
 #include "expression.h"
 #include "linearize.h"
 
+unsigned long allocated_blob_bytes;
+int hugepage_blobs;
+unsigned long hugepage_regions;
+
 void protect_allocations(struct allocator_struct *desc)
 {
 	desc->blobs = NULL;
@@ -57,26 +61,42 @@ void drop_all_allocations(struct allocator_struct *desc)
 	desc->total_bytes = 0;
 	desc->useful_bytes = 0;
 	desc->freelist = NULL;
+	desc->freelist_bytes = 0;
 	while (blob) {
 		struct allocation_blob *next = blob->next;
-		blob_free(blob, desc->chunking);
+		free_allocation_blob(desc, blob);
 		blob = next;
 	}
 }
 
-void free_one_entry(struct allocator_struct *desc, void *entry)
+void free_allocation_blob(struct allocator_struct *desc, struct allocation_blob *blob)
+{
+	allocated_blob_bytes -= desc->chunking;
+	blob_free(blob, desc->chunking);
+}
+
+void free_one_entry(struct allocator_struct *desc, void *entry, unsigned int size)
 {
 	void **p = entry;
+
+	if (desc->redirect)
+		desc = desc->redirect;
 	*p = desc->freelist;
 	desc->freelist = p;
+	desc->freelist_bytes += size;
 }
 
 void *allocate(struct allocator_struct *desc, unsigned int size)
 {
-	unsigned long alignment = desc->alignment;
-	struct allocation_blob *blob = desc->blobs;
+	unsigned long alignment;
+	struct allocation_blob *blob;
 	void *retval;
 
+	if (desc->redirect)
+		desc = desc->redirect;
+	blob = desc->blobs;
+	alignment = desc->alignment;
+
 	/*
 	 * NOTE! The freelist only works with things that are
 	 *  (a) sufficiently aligned
@@ -88,6 +108,7 @@ void *allocate(struct allocator_struct *desc, unsigned int size)
 		void **p = desc->freelist;
 		retval = p;
 		desc->freelist = *p;
+		desc->freelist_bytes -= size;
 		do {
 			*p = NULL;
 			p++;
@@ -106,6 +127,7 @@ void *allocate(struct allocator_struct *desc, unsigned int size)
 		if (size > chunking)
 			die("alloc too big");
 		desc->total_bytes += chunking;
+		allocated_blob_bytes += chunking;
 		newblob->next = blob;
 		blob = newblob;
 		desc->blobs = newblob;
@@ -135,6 +157,7 @@ void get_allocator_stats(struct allocator_struct *x, struct allocator_stats *s)
 	s->allocations = x->allocations;
 	s->useful_bytes = x->useful_bytes;
 	s->total_bytes = x->total_bytes;
+	s->freelist_bytes = x->freelist_bytes;
 }
 
 ALLOCATOR(ident, "identifiers");
@@ -153,4 +176,41 @@ ALLOCATOR(instruction, "instruction");
 ALLOCATOR(multijmp, "multijmp");
 ALLOCATOR(pseudo, "pseudo");
 
+/*
+ * The expressions and statements of function bodies can come from their own
+ * allocators so that they can be thrown away when the file is done.  The
+ * bodies are kept for one more file after they are retired.  Smatch has a
+ * number of "static struct expression *handled;" pointers and freeing the
+ * memory right away would let the next file's expressions show up at the
+ * same addresses.
+ */
+static struct allocator_struct body_expression_allocator = {
+	.name = "body expressions",
+	.alignment = __alignof__(struct expression),
+	.chunking = CHUNK };
+static struct allocator_struct body_statement_allocator = {
+	.name = "body statements",
+	.alignment = __alignof__(struct statement),
+	.chunking = CHUNK };
+static struct allocator_struct retired_expression_allocator;
+static struct allocator_struct retired_statement_allocator;
+
+void use_body_allocators(int on)
+{
+	expression_allocator.redirect = on ? &body_expression_allocator : NULL;
+	statement_allocator.redirect = on ? &body_statement_allocator : NULL;
+}
 
+static void retire_allocations(struct allocator_struct *desc, struct allocator_struct *retired)
+{
+	drop_all_allocations(retired);
+	*retired = *desc;
+	desc->blobs = NULL;
+	drop_all_allocations(desc);
+}
+
+void retire_body_allocations(void)
+{
+	retire_allocations(&body_expression_allocator, &retired_expression_allocator);
+	retire_allocations(&body_statement_allocator, &retired_statement_allocator);
+}
@@ -15,23 +15,32 @@ struct allocator_struct {
 	unsigned int alignment;
 	unsigned int chunking;
 	void *freelist;
+	/* when set the allocations go here instead, see use_body_allocators() */
+	struct allocator_struct *redirect;
 	/* statistics */
 	unsigned long allocations, total_bytes, useful_bytes;
+	unsigned long freelist_bytes;
 };
 
 struct allocator_stats {
 	const char *name;
 	unsigned int allocations;
-	unsigned long total_bytes, useful_bytes;
+	unsigned long total_bytes, useful_bytes, freelist_bytes;
 };
 
+/* the blobs which all the allocators are holding right now */
+extern unsigned long allocated_blob_bytes;
+
 extern void protect_allocations(struct allocator_struct *desc);
 extern void drop_all_allocations(struct allocator_struct *desc);
 extern void *allocate(struct allocator_struct *desc, unsigned int size);
-extern void free_one_entry(struct allocator_struct *desc, void *entry);
+extern void free_one_entry(struct allocator_struct *desc, void *entry, unsigned int size);
+extern void free_allocation_blob(struct allocator_struct *desc, struct allocation_blob *blob);
 extern void show_allocations(struct allocator_struct *);
 extern void get_allocator_stats(struct allocator_struct *, struct allocator_stats *);
 extern void show_allocation_stats(void);
+extern void use_body_allocators(int on);
+extern void retire_body_allocations(void);
 
 #define __DECLARE_ALLOCATOR(type, x)		\
 	extern type *__alloc_##x(int);		\
@@ -53,7 +62,7 @@ extern void show_allocation_stats(void);
 	}							\
 	void __free_##x(type *entry)				\
 	{							\
-		free_one_entry(&x##_allocator, entry);		\
+		free_one_entry(&x##_allocator, entry, objsize);	\
 	}							\
 	void show_##x##_alloc(void)				\
 	{							\
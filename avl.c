@@ -28,6 +28,7 @@
 
 static AvlNode *mkNode(const struct sm_state *sm);
 static void freeNode(AvlNode *node);
+static AvlNode *ownNode(AvlNode **p);
 
 static AvlNode *lookup(const struct stree *avl, AvlNode *node, const struct sm_state *sm);
 
@@ -43,6 +44,7 @@ static bool checkOrder(struct stree *avl);
 static size_t countNode(AvlNode *node);
 
 int unfree_stree;
+int unfree_avl_node;
 
 /*
  * Utility macros for converting between
@@ -56,6 +58,8 @@ int unfree_stree;
 #define bal(side) ((side) == 0 ? -1 : 1)
 #define side(bal) ((bal)  == 1 ?  1 : 0)
 
+static unsigned long long avl_gen;
+
 static struct stree *avl_new(void)
 {
 	struct stree *avl = malloc(sizeof(*avl));
@@ -69,6 +73,8 @@ static struct stree *avl_new(void)
 	avl->count = 0;
 	avl->stree_id = 0;
 	avl->references = 1;
+	avl->pool_used = 0;
+	avl->gen = ++avl_gen;
 	return avl;
 }
 
@@ -92,6 +98,12 @@ void free_stree(struct stree **avl)
 	*avl = NULL;
 }
 
+unsigned long stree_bytes(void)
+{
+	return unfree_avl_node * sizeof(AvlNode) +
+	       unfree_stree * (sizeof(struct stree) + num_checks);
+}
+
 struct sm_state *avl_lookup(const struct stree *avl, const struct sm_state *sm)
 {
 	AvlNode *found;
@@ -119,13 +131,26 @@ size_t stree_count(const struct stree *avl)
 	return avl->count;
 }
 
-static struct stree *clone_stree_real(struct stree *orig)
+/*
+ * The new stree shares all the nodes with the original.  The nodes are
+ * copied as they are modified so an insert or remove only copies the path
+ * down from the root.
+ */
+struct stree *avl_copy(struct stree *orig)
 {
 	struct stree *new = avl_new();
-	AvlIter i;
 
-	avl_foreach(i, orig)
-		avl_insert(&new, i.sm);
+	new->root = orig->root;
+	if (new->root)
+		new->root->refs++;
+	memcpy(new->has_states, orig->has_states, num_checks);
+	new->count = orig->count;
+	return new;
+}
+
+static struct stree *clone_stree_real(struct stree *orig)
+{
+	struct stree *new = avl_copy(orig);
 
 	new->base_stree = orig->base_stree;
 	return new;
@@ -145,6 +170,7 @@ bool avl_insert(struct stree **avl, const struct sm_state *sm)
 	/* fortunately we never call get_state() on "unnull_path" */
 	if (sm->owner != USHRT_MAX)
 		(*avl)->has_states[sm->owner] = 1;
+	(*avl)->gen = ++avl_gen;
 	insert_sm(*avl, &(*avl)->root, sm);
 	return (*avl)->count != old_count;
 }
@@ -161,6 +187,7 @@ bool avl_remove(struct stree **avl, const struct sm_state *sm)
 		*avl = clone_stree_real(*avl);
 	}
 
+	(*avl)->gen = ++avl_gen;
 	remove_sm(*avl, &(*avl)->root, sm, &node);
 
 	if ((*avl)->count == 0)
@@ -170,6 +197,7 @@ bool avl_remove(struct stree **avl, const struct sm_state *sm)
 		return false;
 	} else {
 		free(node);
+		unfree_avl_node--;
 		return true;
 	}
 }
@@ -179,23 +207,51 @@ static AvlNode *mkNode(const struct sm_state *sm)
 	AvlNode *node = malloc(sizeof(*node));
 
 	assert(node != NULL);
+	unfree_avl_node++;
 
 	node->sm = sm;
 	node->lr[0] = NULL;
 	node->lr[1] = NULL;
 	node->balance = 0;
+	node->refs = 1;
 	return node;
 }
 
 static void freeNode(AvlNode *node)
 {
-	if (node) {
+	if (node && --node->refs == 0) {
 		freeNode(node->lr[0]);
 		freeNode(node->lr[1]);
 		free(node);
+		unfree_avl_node--;
 	}
 }
 
+/*
+ * Make sure *p isn't shared with another stree before we modify it.  The
+ * copy takes a reference to the children.
+ */
+static AvlNode *ownNode(AvlNode **p)
+{
+	AvlNode *node = *p;
+	AvlNode *copy;
+
+	if (node->refs == 1)
+		return node;
+
+	copy = mkNode(node->sm);
+	copy->lr[0] = node->lr[0];
+	copy->lr[1] = node->lr[1];
+	copy->balance = node->balance;
+	if (copy->lr[0])
+		copy->lr[0]->refs++;
+	if (copy->lr[1])
+		copy->lr[1]->refs++;
+	node->refs--;
+	*p = copy;
+	return copy;
+}
+
 static AvlNode *lookup(const struct stree *avl, AvlNode *node, const struct sm_state *sm)
 {
 	int cmp;
@@ -224,7 +280,7 @@ static bool insert_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm)
 		avl->count++;
 		return true;
 	} else {
-		AvlNode *node = *p;
+		AvlNode *node = ownNode(p);
 		int      cmp  = cmp_tracker(sm, node->sm);
 
 		if (cmp == 0) {
@@ -252,7 +308,7 @@ static bool remove_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm,
 	if (p == NULL || *p == NULL) {
 		return false;
 	} else {
-		AvlNode *node = *p;
+		AvlNode *node = ownNode(p);
 		int      cmp  = cmp_tracker(sm, node->sm);
 
 		if (cmp == 0) {
@@ -312,7 +368,7 @@ static bool remove_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm,
  */
 static bool removeExtremum(AvlNode **p, int side, AvlNode **ret)
 {
-	AvlNode *node = *p;
+	AvlNode *node = ownNode(p);
 
 	if (node->lr[side] == NULL) {
 		*ret = node;
@@ -355,7 +411,7 @@ static int sway(AvlNode **p, int sway)
 static void balance(AvlNode **p, int side)
 {
 	AvlNode  *node  = *p,
-	         *child = node->lr[side];
+	         *child = ownNode(&node->lr[side]);
 	int opposite    = 1 - side;
 	int bal         = bal(side);
 
@@ -370,7 +426,7 @@ static void balance(AvlNode **p, int side)
 
 	} else {
 		/* Left-right (side == 0) or right-left (side == 1) */
-		AvlNode *grandchild = child->lr[opposite];
+		AvlNode *grandchild = ownNode(&child->lr[opposite]);
 
 		node->lr[side]           = grandchild->lr[opposite];
 		child->lr[opposite]      = grandchild->lr[side];
@@ -473,6 +529,68 @@ void avl_iter_begin(AvlIter *iter, struct stree *avl, AvlDirection dir)
 	iter->node  = node;
 }
 
+void avl_iter_begin_owner(AvlIter *iter, struct stree *avl, int owner)
+{
+	AvlNode *node;
+
+	iter->stack_index = 0;
+	iter->direction   = FORWARD;
+	iter->sm          = NULL;
+	iter->node        = NULL;
+
+	if (!avl)
+		return;
+
+	/*
+	 * The stack holds the nodes we went left at.  Those are the ones
+	 * which come after the current node.
+	 */
+	for (node = avl->root; node; ) {
+		if (node->sm->owner < owner) {
+			node = node->lr[1];
+			continue;
+		}
+		iter->stack[iter->stack_index++] = node;
+		node = node->lr[0];
+	}
+
+	if (iter->stack_index == 0)
+		return;
+	node = iter->stack[--iter->stack_index];
+	iter->sm   = (struct sm_state *) node->sm;
+	iter->node = node;
+}
+
+void avl_iter_begin_name(AvlIter *iter, struct stree *avl, int owner, const char *name)
+{
+	AvlNode *node;
+
+	iter->stack_index = 0;
+	iter->direction   = FORWARD;
+	iter->sm          = NULL;
+	iter->node        = NULL;
+
+	if (!avl)
+		return;
+
+	/* Same as avl_iter_begin_owner() but the key is (owner, name). */
+	for (node = avl->root; node; ) {
+		if (node->sm->owner < owner ||
+		    (node->sm->owner == owner && strcmp(node->sm->name, name) < 0)) {
+			node = node->lr[1];
+			continue;
+		}
+		iter->stack[iter->stack_index++] = node;
+		node = node->lr[0];
+	}
+
+	if (iter->stack_index == 0)
+		return;
+	node = iter->stack[--iter->stack_index];
+	iter->sm   = (struct sm_state *) node->sm;
+	iter->node = node;
+}
+
 void avl_iter_next(AvlIter *iter)
 {
 	AvlNode     *node = iter->node;
@@ -499,6 +617,92 @@ void avl_iter_next(AvlIter *iter)
 	iter->sm   = (struct sm_state *) node->sm;
 }
 
+/*
+ * Each side has a stack of pending items.  An item is either a whole
+ * subtree which hasn't been looked at yet or a single node.  When both
+ * sides have the same subtree on top it's skipped.  Otherwise we split the
+ * subtree with the bigger root first because the shared subtree, if there
+ * is one, is on its left spine.
+ */
+static void pair_push(AvlPairIter *iter, int side, AvlNode *node, bool whole)
+{
+	int idx = iter->stack_index[side];
+
+	if (!node)
+		return;
+	assert(idx < ARRAY_SIZE(iter->stack[side]));
+	iter->stack[side][idx] = node;
+	iter->whole[side][idx] = whole;
+	iter->stack_index[side]++;
+}
+
+static AvlNode *pair_top(AvlPairIter *iter, int side, bool *whole)
+{
+	int idx = iter->stack_index[side];
+
+	if (idx == 0)
+		return NULL;
+	*whole = iter->whole[side][idx - 1];
+	return iter->stack[side][idx - 1];
+}
+
+static void pair_split(AvlPairIter *iter, int side)
+{
+	AvlNode *node = iter->stack[side][--iter->stack_index[side]];
+
+	pair_push(iter, side, node->lr[1], true);
+	pair_push(iter, side, node, false);
+	pair_push(iter, side, node->lr[0], true);
+}
+
+static void pair_settle(AvlPairIter *iter)
+{
+	AvlNode *one, *two;
+	bool whole_one = false, whole_two = false;
+
+	for (;;) {
+		one = pair_top(iter, 0, &whole_one);
+		two = pair_top(iter, 1, &whole_two);
+
+		if (one && one == two && whole_one && whole_two) {
+			iter->stack_index[0]--;
+			iter->stack_index[1]--;
+			continue;
+		}
+		if (one && whole_one &&
+		    (!two || !whole_two || cmp_tracker(one->sm, two->sm) >= 0)) {
+			pair_split(iter, 0);
+			continue;
+		}
+		if (two && whole_two) {
+			pair_split(iter, 1);
+			continue;
+		}
+		break;
+	}
+
+	iter->one = one ? (struct sm_state *)one->sm : NULL;
+	iter->two = two ? (struct sm_state *)two->sm : NULL;
+}
+
+void avl_pair_begin(AvlPairIter *iter, struct stree *one, struct stree *two)
+{
+	iter->stack_index[0] = 0;
+	iter->stack_index[1] = 0;
+	pair_push(iter, 0, one ? one->root : NULL, true);
+	pair_push(iter, 1, two ? two->root : NULL, true);
+	pair_settle(iter);
+}
+
+void avl_pair_next(AvlPairIter *iter, bool next_one, bool next_two)
+{
+	if (next_one && iter->one)
+		iter->stack_index[0]--;
+	if (next_two && iter->two)
+		iter->stack_index[1]--;
+	pair_settle(iter);
+}
+
 struct stree *clone_stree(struct stree *orig)
 {
 	if (!orig)
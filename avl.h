@@ -30,6 +30,7 @@ struct sm_state;
 
 typedef struct AvlNode       AvlNode;
 typedef struct AvlIter       AvlIter;
+typedef struct AvlPairIter   AvlPairIter;
 
 struct stree {
 	AvlNode    *root;
@@ -38,6 +39,9 @@ struct stree {
 	size_t      count;
 	int stree_id;
 	int references;
+	unsigned int pool_used;
+	/* a new number every time the stree changes, never reused */
+	unsigned long long gen;
 };
 
 void free_stree(struct stree **avl);
@@ -66,6 +70,18 @@ bool avl_remove(struct stree **avl, const struct sm_state *sm);
 	 * Return true if it was removed.
 	 */
 
+struct stree *avl_copy(struct stree *orig);
+	/*
+	 * O(1). Return a new stree with the same states as orig.  The nodes
+	 * are shared until one of the strees is modified.
+	 */
+
+unsigned long stree_bytes(void);
+	/*
+	 * O(1). How much memory all the strees which haven't been freed are
+	 * using.
+	 */
+
 bool avl_check_invariants(struct stree *avl);
 	/* For testing purposes.  This function will always return true :-) */
 
@@ -100,15 +116,19 @@ bool avl_check_invariants(struct stree *avl);
 #define END_FOR_EACH_SM_SAFE(_sm) }		\
 	free_stree(&_copy); }
 
+/*
+ * The states are sorted by owner first so this only looks at the states
+ * which belong to _owner.
+ */
 #define FOR_EACH_MY_SM(_owner, avl, _sm) {		\
 	bool __has_state = has_states(avl, _owner);	\
 	AvlIter _i;					\
-	avl_foreach(_i, avl) {				\
-		if (!__has_state)			\
-			break;				\
+	for (avl_iter_begin_owner(&_i, __has_state ? avl : NULL, _owner); \
+	     _i.node != NULL;				\
+	     avl_iter_next(&_i)) {			\
 		_sm = _i.sm;				\
 		if (_sm->owner != _owner)		\
-			continue;			\
+			break;				\
 
 #define avl_foreach_reverse(iter, avl) avl_traverse(iter, avl, BACKWARD)
 	/* O(n). Traverse an stree tree in reverse order. */
@@ -127,11 +147,35 @@ struct AvlIter {
 
 void avl_iter_begin(AvlIter *iter, struct stree *avl, AvlDirection dir);
 void avl_iter_next(AvlIter *iter);
+void avl_iter_begin_owner(AvlIter *iter, struct stree *avl, int owner);
+	/* O(log n). Start a FORWARD traversal at the first state for owner. */
+void avl_iter_begin_name(AvlIter *iter, struct stree *avl, int owner, const char *name);
+	/* O(log n). Start at the first state for owner which is >= name. */
 #define avl_traverse(iter, avl, direction)        \
 	for (avl_iter_begin(&(iter), avl, direction); \
 	     (iter).node != NULL;                     \
 	     avl_iter_next(&iter))
 
+/*
+ * Walk two strees side by side in order.  iter.one and iter.two are the
+ * next sm from each stree (NULL at the end).  Subtrees which the strees
+ * share are skipped so the pairs where iter.one == iter.two don't all
+ * show up.  The cost depends on how much the strees differ rather than
+ * how big they are.
+ */
+struct AvlPairIter {
+	struct sm_state *one;
+	struct sm_state *two;
+
+	/* private */
+	AvlNode      *stack[2][128];
+	bool          whole[2][128];
+	int           stack_index[2];
+};
+
+void avl_pair_begin(AvlPairIter *iter, struct stree *one, struct stree *two);
+void avl_pair_next(AvlPairIter *iter, bool next_one, bool next_two);
+
 
 /***************** Internal data structures ******************/
 
@@ -140,6 +184,7 @@ struct AvlNode {
 
 	AvlNode    *lr[2];
 	int         balance; /* -1, 0, or 1 */
+	int         refs;    /* strees can share nodes */
 };
 
 AvlNode *avl_lookup_node(const struct stree *avl, const struct sm_state *sm);
@@ -38,9 +38,20 @@
 #include "symbol.h"
 
 static xmlDocPtr doc = NULL;       /* document pointer */
-static xmlNodePtr root_node = NULL;/* root node pointer */
 static int idcount = 0;
 
+/*
+ * The document isn't kept in memory.  The nodes which go at the top of it
+ * are built one at a time, with their children, and are written out and
+ * freed as soon as the symbol which needed them is done.  A symbol only
+ * keeps its id in ->aux.
+ */
+static xmlNodePtr *top_nodes;
+static int nr_top_nodes, max_top_nodes;
+static int started;
+
+#define sym_id(sym)	((int)(long)(sym)->aux - 1)
+
 static void examine_symbol(struct symbol *sym, xmlNodePtr node);
 
 static xmlAttrPtr newProp(xmlNodePtr node, const char *name, const char *value)
@@ -69,9 +80,17 @@ static xmlNodePtr new_sym_node(struct symbol *sym, const char *name, xmlNodePtr
 
 	assert(name != NULL);
 	assert(sym != NULL);
-	assert(parent != NULL);
 
-	node = xmlNewChild(parent, NULL, BAD_CAST "symbol", NULL);
+	if (parent) {
+		node = xmlNewChild(parent, NULL, BAD_CAST "symbol", NULL);
+	} else {
+		node = xmlNewDocNode(doc, NULL, BAD_CAST "symbol", NULL);
+		if (nr_top_nodes == max_top_nodes) {
+			max_top_nodes = max_top_nodes ? max_top_nodes * 2 : 16;
+			top_nodes = realloc(top_nodes, max_top_nodes * sizeof(*top_nodes));
+		}
+		top_nodes[nr_top_nodes++] = node;
+	}
 
 	newProp(node, "type", name);
 
@@ -90,9 +109,8 @@ static xmlNodePtr new_sym_node(struct symbol *sym, const char *name, xmlNodePtr
 		if (sym->pos.stream != sym->endpos.stream)
 			newProp(node, "end-file", stream_name(sym->endpos.stream));
         }
-	sym->aux = node;
-
 	idcount++;
+	sym->aux = (void *)(long)idcount;
 
 	return node;
 }
@@ -188,10 +206,12 @@ static void examine_symbol(struct symbol *sym, xmlNodePtr node)
 	if (sym->ctype.base_type) {
 		if ((base = builtin_typename(sym->ctype.base_type)) == NULL) {
 			if (!sym->ctype.base_type->aux) {
-				examine_symbol(sym->ctype.base_type, root_node);
+				examine_symbol(sym->ctype.base_type, NULL);
 			}
-			xmlNewProp(child, BAD_CAST "base-type",
-			           xmlGetProp((xmlNodePtr)sym->ctype.base_type->aux, BAD_CAST "id"));
+			if (sym->ctype.base_type->aux)
+				newIdProp(child, "base-type", sym_id(sym->ctype.base_type));
+			else
+				xmlNewProp(child, BAD_CAST "base-type", NULL);
 		} else {
 			newProp(child, "base-type-builtin", base);
 		}
@@ -255,12 +275,12 @@ static void examine_namespace(struct symbol *sym)
 
 	switch(sym->namespace) {
 	case NS_MACRO:
-		examine_macro(sym, root_node);
+		examine_macro(sym, NULL);
 		break;
 	case NS_TYPEDEF:
 	case NS_STRUCT:
 	case NS_SYMBOL:
-		examine_symbol(sym, root_node);
+		examine_symbol(sym, NULL);
 		break;
 	case NS_NONE:
 	case NS_LABEL:
@@ -275,6 +295,29 @@ static void examine_namespace(struct symbol *sym)
 
 }
 
+/* the same layout as xmlSaveFormatFileEnc() gives for the whole document */
+static void write_top_nodes(void)
+{
+	xmlBufferPtr buf;
+	int i;
+
+	if (!nr_top_nodes)
+		return;
+	if (!started) {
+		printf("<parse>\n");
+		started = 1;
+	}
+	buf = xmlBufferCreate();
+	for (i = 0; i < nr_top_nodes; i++) {
+		xmlBufferEmpty(buf);
+		xmlNodeDump(buf, doc, top_nodes[i], 1, 1);
+		printf("  %s\n", (const char *)xmlBufferContent(buf));
+		xmlFreeNode(top_nodes[i]);
+	}
+	xmlBufferFree(buf);
+	nr_top_nodes = 0;
+}
+
 static int get_stream_id (const char *name)
 {
 	int i;
@@ -293,8 +336,10 @@ static inline void examine_symbol_list(const char *file, struct symbol_list *lis
 	if (!list)
 		return;
 	FOR_EACH_PTR(list, sym) {
-		if (sym->pos.stream == stream_id)
+		if (sym->pos.stream == stream_id) {
 			examine_namespace(sym);
+			write_top_nodes();
+		}
 	} END_FOR_EACH_PTR(sym);
 }
 
@@ -305,8 +350,7 @@ int main(int argc, char **argv)
 	char *file;
 
 	doc = xmlNewDoc(BAD_CAST "1.0");
-	root_node = xmlNewNode(NULL, BAD_CAST "parse");
-	xmlDocSetRootElement(doc, root_node);
+	printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
 
 /* - A DTD is probably unnecessary for something like this
 
@@ -326,7 +370,7 @@ int main(int argc, char **argv)
 	} END_FOR_EACH_PTR(file);
 
 
-	xmlSaveFormatFileEnc("-", doc, "UTF-8", 1);
+	printf(started ? "</parse>\n" : "<parse/>\n");
 	xmlFreeDoc(doc);
 	xmlCleanupParser();
 
@@ -155,9 +155,6 @@ static void match_condition(struct expression *expr)
 	struct range_list *rl_left_orig, *rl_right_orig;
 	struct range_list *rl_left, *rl_right;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
-
 	type = get_type(expr);
 	if (!type)
 		return;
@@ -215,5 +212,5 @@ void check_always_true(int id)
 {
 	my_id = id;
 
-	add_hook(&match_condition, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 }
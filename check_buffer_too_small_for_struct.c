@@ -72,9 +72,6 @@ static void match_dereferences(struct expression *expr)
 	sval_t min_size;
 	int limit_type;
 
-	if (expr->type != EXPR_PREOP)
-		return;
-
 	expr = strip_expr(expr->unop);
 	state = get_state_expr(my_id, expr);
 	if (state != &too_small)
@@ -109,5 +106,5 @@ void check_buffer_too_small_for_struct(int id)
 	my_id = id;
 
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
-	add_hook(&match_dereferences, DEREF_HOOK);
+	add_expr_type_hook(&match_dereferences, DEREF_HOOK, EXPR_TYPE_BIT(EXPR_PREOP));
 }
@@ -918,15 +918,30 @@ static void match_mem(const char *fn, struct expression *expr, void *info)
 	show_ptrlist_alloc();
 	sm_msg("%lu pools", get_pool_count());
 	sm_msg("%d strees", unfree_stree);
+	if (hugepage_blobs)
+		sm_msg("%lu hugepage regions", hugepage_regions);
 	show_smatch_state_alloc();
 	show_sm_state_alloc();
 }
 
+static void match_owner_mem(const char *fn, struct expression *expr, void *info)
+{
+	show_owner_mem();
+}
+
 static void match_exit(const char *fn, struct expression *expr, void *info)
 {
 	exit(0);
 }
 
+static void match_over_budget(const char *fn, struct expression *expr, void *info)
+{
+	/* the degraded pass of the function would only give up again */
+	if (__degraded_pass)
+		return;
+	__use_up_func_budget();
+}
+
 static struct stree *old_stree;
 static void trace_var(struct statement *stmt)
 {
@@ -1013,7 +1028,9 @@ void check_debug(int id)
 	add_function_hook("__smatch_expr", &match_expr, NULL);
 	add_function_hook("__smatch_state_count", &match_state_count, NULL);
 	add_function_hook("__smatch_mem", &match_mem, NULL);
+	add_function_hook("__smatch_owner_mem", &match_owner_mem, NULL);
 	add_function_hook("__smatch_exit", &match_exit, NULL);
+	add_function_hook("__smatch_over_budget", &match_over_budget, NULL);
 	add_function_hook("__smatch_units", &match_units, NULL);
 	add_function_hook("__smatch_container", &match_container, NULL);
 	add_function_hook("__smatch_param_key", &match_param_key, NULL);
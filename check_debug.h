@@ -77,11 +77,13 @@ static inline void __smatch_stree_id(void){}
 static inline void __smatch_mtag(void *p){}
 static inline void __smatch_mtag_data(long long arg){}
 static inline void __smatch_exit(void){}
+static inline void __smatch_over_budget(void){}
 
 static inline void __smatch_expr(const char *str, void *p){}
 
 static inline void __smatch_state_count(void){}
 static inline void __smatch_mem(void){}
+static inline void __smatch_owner_mem(void){}
 
 static inline void __smatch_units(long long var){}
 
@@ -146,8 +146,6 @@ static void check_dereference_name_sym(char *name, struct symbol *sym)
 
 static void match_dereferences(struct expression *expr)
 {
-	if (expr->type != EXPR_PREOP)
-		return;
 	check_dereference(expr->unop);
 }
 
@@ -286,7 +284,7 @@ void check_deref(int id)
 
 	add_unmatched_state_hook(my_id, &unmatched_state);
 	add_modification_hook(my_id, &is_ok);
-	add_hook(&match_dereferences, DEREF_HOOK);
+	add_expr_type_hook(&match_dereferences, DEREF_HOOK, EXPR_TYPE_BIT(EXPR_PREOP));
 	add_hook(&match_pointer_as_array, OP_HOOK);
 	select_return_implies_hook(DEREFERENCE, &set_param_dereferenced);
 	add_hook(&match_condition, CONDITION_HOOK);
@@ -76,52 +76,62 @@ static void match_syscall_definition(struct symbol *sym)
 	} END_FOR_EACH_PTR(arg);
 }
 
-static void print_read_list(void)
+static bool seen_before(struct tracker_list *list, struct tracker *tracker)
 {
-    struct tracker *tracker;
-    int i = 0;
-
-    FOR_EACH_PTR(read_list, tracker) {
-	    if (i == 0)
-		    sm_printf("%s read_list: [", syscall_name);
-	    sm_printf("%s, ", tracker->name);
-	    i++;
-    } END_FOR_EACH_PTR(tracker);
-
-    if (i > 0)
-	    sm_printf("]\n");
+	struct tracker *tmp;
+
+	FOR_EACH_PTR(list, tmp) {
+		if (tmp == tracker)
+			return false;
+		if (strcmp(tmp->name, tracker->name) == 0)
+			return true;
+	} END_FOR_EACH_PTR(tmp);
+
+	return false;
 }
 
-static void print_write_list(void)
+static void print_json_list(FILE *file, const char *key, struct tracker_list *list)
 {
 	struct tracker *tracker;
 	int i = 0;
 
-	FOR_EACH_PTR(write_list, tracker) {
-		if (i == 0)
-			sm_printf("%s write_list: [", syscall_name);
-		sm_printf("%s, ", tracker->name);
-		i++;
+	fprintf(file, ", \"%s\": [", key);
+	FOR_EACH_PTR(list, tracker) {
+		if (seen_before(list, tracker))
+			continue;
+		if (i++)
+			fprintf(file, ", ");
+		print_json_str(file, tracker->name);
 	} END_FOR_EACH_PTR(tracker);
-
-	if (i > 0)
-		sm_printf("]\n");
+	fprintf(file, "]");
 }
 
-static void print_arg_list(void)
+/*
+ * One line of JSON per syscall so the scripts can read it with a JSON
+ * parser instead of picking apart "[a, b, ]" lists.  The line is built in
+ * memory and printed at once.
+ */
+static void print_syscall_record(void)
 {
-	struct tracker *tracker;
-	int i = 0;
+	FILE *file;
+	char *buf;
+	size_t size;
 
-	FOR_EACH_PTR(write_list, tracker) {
-		if (i == 0)
-			sm_printf("%s arg_list: [", syscall_name);
-		sm_printf("%s, ", tracker->name);
-		i++;
-	} END_FOR_EACH_PTR(tracker);
+	if (!read_list && !write_list)
+		return;
 
-	if (i > 0)
-		sm_printf("]\n");
+	file = open_memstream(&buf, &size);
+	if (!file)
+		return;
+	fprintf(file, "{\"syscall\": ");
+	print_json_str(file, syscall_name);
+	print_json_list(file, "read_list", read_list);
+	print_json_list(file, "write_list", write_list);
+	fprintf(file, "}");
+	fclose(file);
+
+	sm_printf("%s\n", buf);
+	free(buf);
 }
 
 static void match_after_syscall(struct symbol *sym)
@@ -131,9 +141,7 @@ static void match_after_syscall(struct symbol *sym)
 	// printf("\n"); prefix();
 	// printf("exiting scope of syscall %s\n", get_function());
 	// printf("-------------------------\n");
-	print_read_list();
-	print_write_list();
-	print_arg_list();
+	print_syscall_record();
 	free_trackers_and_list(&read_list);
 	free_trackers_and_list(&write_list);
 	free_trackers_and_list(&arg_list);
@@ -138,9 +138,6 @@ static void match_condition(struct expression *expr)
 	char *name;
 	int op;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
-
 	type = get_type(expr);
 	if (!type)
 		return;
@@ -194,5 +191,5 @@ void check_impossible_compare(int id)
 	if (option_project == PROJ_KERNEL)
 		allowed_macros = kernel_macros;
 
-	add_hook(&match_condition, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 }
@@ -54,167 +54,149 @@ static bool is_EINTR(struct range_list *rl)
 	return sval.value == -4;
 }
 
-static void check_lock_bool(const char *name, struct symbol *sym)
-{
-	struct range_list *locked_true = NULL, *locked_false = NULL;
-	struct range_list *unlocked_true = NULL, *unlocked_false = NULL;
-	struct stree *stree, *orig;
-	struct sm_state *return_sm;
+#define NUM_BUCKETS (RET_UNKNOWN + 1)
+struct lock_returns {
 	struct sm_state *sm;
-	sval_t line = sval_type_val(&int_ctype, 0);
-	sval_t sval;
+	struct range_list *locked_lines, *unlocked_lines;
+	int locked_buckets[NUM_BUCKETS];
+	int unlocked_buckets[NUM_BUCKETS];
+	/* for functions which return bool */
+	struct range_list *locked_true, *locked_false;
+	struct range_list *unlocked_true, *unlocked_false;
+};
+
+struct lock_sweep {
+	struct lock_returns *locks;
+	int nr;
+	bool returns_bool;
+};
+
+static int cmp_lock_returns(const void *key, const void *member)
+{
+	const struct lock_returns *lr = member;
 
-	FOR_EACH_PTR(get_all_return_strees(), stree) {
-		orig = __swap_cur_stree(stree);
-
-		if (is_impossible_path())
-			goto swap_stree;
-
-		return_sm = get_sm_state(RETURN_ID, "return_ranges", NULL);
-		if (!return_sm)
-			goto swap_stree;
-		line.value = return_sm->line;
-
-		sm = get_sm_state(my_id, name, sym);
-		if (!sm)
-			goto swap_stree;
-
-		if (parent_is_gone_var_sym(sm->name, sm->sym))
-			goto swap_stree;
-
-		if (sm->state != &locked && sm->state != &unlocked)
-			goto swap_stree;
-
-		if (sm->state == &unlocked && is_EINTR(estate_rl(return_sm->state)))
-			goto swap_stree;
-
-		if (estate_get_single_value(return_sm->state, &sval)) {
-			if (sm->state == &locked) {
-				if (sval.value)
-					add_range(&locked_true, line, line);
-				else
-					add_range(&locked_false, line, line);
-			} else {
-				if (sval.value)
-					add_range(&unlocked_true, line, line);
-				else
-					add_range(&unlocked_false, line, line);
-			}
-		}
-swap_stree:
-		__swap_cur_stree(orig);
-	} END_FOR_EACH_PTR(stree);
-
-	if (locked_true && unlocked_true) {
-		sm_warning("inconsistent returns '%s'.", name);
-		sm_printf("  Locked on  : %s\n", show_rl(locked_true));
-		sm_printf("  Unlocked on: %s\n", show_rl(unlocked_true));
-	}
-	if (locked_false && unlocked_false) {
-		sm_warning("inconsistent returns '%s'.", name);
-		sm_printf("  Locked on  : %s\n", show_rl(locked_false));
-		sm_printf("  Unlocked on: %s\n", show_rl(unlocked_false));
-	}
+	return cmp_tracker(key, lr->sm);
 }
 
-#define NUM_BUCKETS (RET_UNKNOWN + 1)
-static void check_lock(const char *name, struct symbol *sym)
+static void add_line(struct range_list **rl, sval_t line)
 {
-	struct range_list *locked_lines = NULL;
-	struct range_list *unlocked_lines = NULL;
-	int locked_buckets[NUM_BUCKETS] = {};
-	int unlocked_buckets[NUM_BUCKETS] = {};
-	struct stree *stree, *orig;
-	struct sm_state *return_sm;
-	struct sm_state *sm;
-	sval_t line = sval_type_val(&int_ctype, 0);
-	int bucket;
-	int i;
+	add_range(rl, line, line);
+}
 
-	if (is_locking_primitive_sym(cur_func_sym))
+static void sweep_lock(struct return_path *path, struct sm_state *sm, void *data)
+{
+	struct lock_sweep *sweep = data;
+	struct lock_returns *lr;
+	sval_t sval;
+
+	lr = bsearch(sm, sweep->locks, sweep->nr, sizeof(*lr), cmp_lock_returns);
+	if (!lr)
+		return;
+
+	if (parent_is_gone_var_sym(sm->name, sm->sym))
+		return;
+
+	if (sm->state != &locked && sm->state != &unlocked)
 		return;
 
-	if (strchr(name, '$'))
+	if (sm->state == &unlocked && is_EINTR(path->rl))
 		return;
 
-	if (cur_func_return_type() == &bool_ctype) {
-		check_lock_bool(name, sym);
+	if (sweep->returns_bool) {
+		if (!estate_get_single_value(path->return_sm->state, &sval))
+			return;
+		if (sm->state == &locked)
+			add_line(sval.value ? &lr->locked_true : &lr->locked_false, path->line);
+		else
+			add_line(sval.value ? &lr->unlocked_true : &lr->unlocked_false, path->line);
 		return;
 	}
 
-	FOR_EACH_PTR(get_all_return_strees(), stree) {
-		orig = __swap_cur_stree(stree);
-
-		if (is_impossible_path())
-			goto swap_stree;
-
-		return_sm = get_sm_state(RETURN_ID, "return_ranges", NULL);
-		if (!return_sm)
-			goto swap_stree;
-		line.value = return_sm->line;
-
-		sm = get_sm_state(my_id, name, sym);
-		if (!sm)
-			goto swap_stree;
-
-		if (parent_is_gone_var_sym(sm->name, sm->sym))
-			goto swap_stree;
-
-#if 0
-		if (sm_both_locked_and_unlocked(sm) && !both_warned) {
-			sm_printf("%s:%lld %s() warn: XXX '%s' both locked and unlocked.\n",
-				  get_filename(), line.value, get_function(), sm->name);
-			sm_msg("%s: sm = '%s'", __func__, show_sm(sm));
-			both_warned = 1;
-			goto swap_stree;
-		}
-#endif
-
-		if (sm->state != &locked && sm->state != &unlocked)
-			goto swap_stree;
-
-		if (sm->state == &unlocked && is_EINTR(estate_rl(return_sm->state)))
-			goto swap_stree;
-
-		bucket = success_fail_return(estate_rl(return_sm->state));
-		if (sm->state == &locked) {
-			add_range(&locked_lines, line, line);
-			locked_buckets[bucket] = true;
-		} else {
-			add_range(&unlocked_lines, line, line);
-			unlocked_buckets[bucket] = true;
-		}
-swap_stree:
-		__swap_cur_stree(orig);
-	} END_FOR_EACH_PTR(stree);
-
-
-	if (!locked_lines || !unlocked_lines)
+	if (sm->state == &locked) {
+		add_line(&lr->locked_lines, path->line);
+		lr->locked_buckets[path->bucket] = true;
+	} else {
+		add_line(&lr->unlocked_lines, path->line);
+		lr->unlocked_buckets[path->bucket] = true;
+	}
+}
+
+static void print_inconsistent(const char *name, struct range_list *locked_lines,
+			       struct range_list *unlocked_lines)
+{
+	sm_warning("inconsistent returns '%s'.", name);
+	sm_printf("  Locked on  : %s\n", show_rl(locked_lines));
+	sm_printf("  Unlocked on: %s\n", show_rl(unlocked_lines));
+}
+
+static void check_lock_bool(struct lock_returns *lr)
+{
+	if (lr->locked_true && lr->unlocked_true)
+		print_inconsistent(lr->sm->name, lr->locked_true, lr->unlocked_true);
+	if (lr->locked_false && lr->unlocked_false)
+		print_inconsistent(lr->sm->name, lr->locked_false, lr->unlocked_false);
+}
+
+static void check_lock(struct lock_returns *lr)
+{
+	int i;
+
+	if (!lr->locked_lines || !lr->unlocked_lines)
 		return;
 
 	for (i = 0; i < NUM_BUCKETS; i++) {
-		if (locked_buckets[i] && unlocked_buckets[i])
+		if (lr->locked_buckets[i] && lr->unlocked_buckets[i])
 			goto complain;
 	}
 
-	if (locked_buckets[RET_FAIL])
+	if (lr->locked_buckets[RET_FAIL])
 		goto complain;
 
 	return;
 
 complain:
-	sm_warning("inconsistent returns '%s'.", name);
-	sm_printf("  Locked on  : %s\n", show_rl(locked_lines));
-	sm_printf("  Unlocked on: %s\n", show_rl(unlocked_lines));
+	print_inconsistent(lr->sm->name, lr->locked_lines, lr->unlocked_lines);
 }
 
+/*
+ * Collect what each lock looks like on every return in one sweep over the
+ * returns instead of going through all the returns again for each lock.
+ */
 static void match_func_end(struct symbol *sym)
 {
+	struct lock_sweep sweep = {};
+	struct stree *all_returns;
 	struct sm_state *sm;
+	int i;
+
+	if (is_locking_primitive_sym(cur_func_sym))
+		return;
 
-	FOR_EACH_MY_SM(my_id, get_all_return_states(), sm) {
-		check_lock(sm->name, sm->sym);
+	all_returns = get_all_return_states();
+	FOR_EACH_MY_SM(my_id, all_returns, sm) {
+		sweep.nr++;
 	} END_FOR_EACH_SM(sm);
+	if (!sweep.nr)
+		return;
+
+	sweep.locks = calloc(sweep.nr, sizeof(*sweep.locks));
+	sweep.nr = 0;
+	FOR_EACH_MY_SM(my_id, all_returns, sm) {
+		if (strchr(sm->name, '$'))
+			continue;
+		sweep.locks[sweep.nr++].sm = sm;
+	} END_FOR_EACH_SM(sm);
+	sweep.returns_bool = cur_func_return_type() == &bool_ctype;
+
+	sweep_return_states(my_id, &sweep_lock, &sweep);
+
+	for (i = 0; i < sweep.nr; i++) {
+		if (sweep.returns_bool)
+			check_lock_bool(&sweep.locks[i]);
+		else
+			check_lock(&sweep.locks[i]);
+	}
+	free(sweep.locks);
 }
 
 void check_inconsistent_locking(int id)
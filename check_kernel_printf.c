@@ -22,6 +22,7 @@
 #include <string.h>
 #include "smatch.h"
 #include "smatch_slist.h"
+#include "smatch_function_hashtable.h"
 
 #define spam(args...) do {			\
 	if (option_spammy)			\
@@ -1051,15 +1052,89 @@ free:
 	free_string(name);
 }
 
+/*
+ * The same format strings are used over and over, especially the ones from
+ * dev_err() and pr_*() macros, so only decode each one once.  It's saved as
+ * the list of specifiers format_decode() returns.
+ */
+struct decoded_spec {
+	int start;
+	int read;
+	struct printf_spec spec;
+};
+
+struct decoded_format {
+	int nr;
+	struct decoded_spec specs[];
+};
+
+static DEFINE_HASHTABLE_INSERT(insert_format, char, struct decoded_format);
+static DEFINE_HASHTABLE_SEARCH(search_format, char, struct decoded_format);
+static struct hashtable *format_hash;
+
+static struct decoded_format *decode_format(const char *orig_fmt)
+{
+	struct printf_spec spec = {0};
+	struct decoded_format *ret;
+	const char *fmt = orig_fmt;
+	int max = 8;
+
+	ret = malloc(sizeof(*ret) + max * sizeof(ret->specs[0]));
+	ret->nr = 0;
+	while (*fmt) {
+		const char *old_fmt = fmt;
+		int read = format_decode(fmt, &spec);
+
+		fmt += read;
+		/* the %p extensions are checked by pointer() */
+		if (spec.type == FORMAT_TYPE_PTR) {
+			while (isalnum(*fmt))
+				fmt++;
+		}
+
+		if (ret->nr == max) {
+			max *= 2;
+			ret = realloc(ret, sizeof(*ret) + max * sizeof(ret->specs[0]));
+		}
+		ret->specs[ret->nr].start = old_fmt - orig_fmt;
+		ret->specs[ret->nr].read = read;
+		ret->specs[ret->nr].spec = spec;
+		ret->nr++;
+
+		/* the checking stops at these */
+		if (spec.type == FORMAT_TYPE_INVALID ||
+		    spec.type == FORMAT_TYPE_FLOAT ||
+		    spec.type == FORMAT_TYPE_NRCHARS)
+			break;
+	}
+	return ret;
+}
+
+static struct decoded_format *get_decoded_format(const char *fmt)
+{
+	struct decoded_format *ret;
+
+	if (!format_hash)
+		format_hash = create_function_hashtable(1000);
+	ret = search_format(format_hash, (char *)fmt);
+	if (ret)
+		return ret;
+	ret = decode_format(fmt);
+	insert_format(format_hash, alloc_string(fmt), ret);
+	return ret;
+}
+
 static void
 do_check_printf_call(const char *caller, const char *name, struct expression *callexpr, struct expression *fmtexpr, int vaidx)
 {
+	struct decoded_format *decoded;
 	struct printf_spec spec = {0};
 	struct printf_spec prev_spec = {0};
 	struct expression *arg;
 	struct expression *prev_arg = NULL;
 	const char *fmt, *orig_fmt;
 	int caller_in_fmt;
+	int i;
 
 	fmtexpr = strip_parens(fmtexpr);
 	if (fmtexpr->type == EXPR_CONDITIONAL) {
@@ -1100,14 +1175,16 @@ do_check_printf_call(const char *caller, const char *name, struct expression *ca
 		return;
 	}
 
-	orig_fmt = fmt = fmtexpr->string->data;
-	caller_in_fmt = check_format_string(fmt, caller);
+	orig_fmt = fmtexpr->string->data;
+	caller_in_fmt = check_format_string(orig_fmt, caller);
+	decoded = get_decoded_format(orig_fmt);
 
-	while (*fmt) {
-		const char *old_fmt = fmt;
-		int read = format_decode(fmt, &spec);
+	for (i = 0; i < decoded->nr; i++) {
+		const char *old_fmt = orig_fmt + decoded->specs[i].start;
+		int read = decoded->specs[i].read;
 
-		fmt += read;
+		spec = decoded->specs[i].spec;
+		fmt = old_fmt + read;
 		if (spec.type == FORMAT_TYPE_NONE ||
 		    spec.type == FORMAT_TYPE_PERCENT_CHAR) {
 			prev_spec = spec;
@@ -1187,8 +1264,6 @@ do_check_printf_call(const char *caller, const char *name, struct expression *ca
 		case FORMAT_TYPE_PTR:
 			/* This is the most important part: Checking %p extensions. */
 			pointer(fmt, arg, vaidx);
-			while (isalnum(*fmt))
-				fmt++;
 			break;
 
 		case FORMAT_TYPE_CHAR:
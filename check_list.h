@@ -92,6 +92,7 @@ CK(register_refcount)
 CK(register_refcount_info)
 CK(register_kernel_atomic_dec_test_path)
 CK(register_leaf_fn)
+CK(register_fn_traits)
 
 CK(register_kernel_user_data)
 CK(register_kernel_user_data2)
@@ -293,6 +294,7 @@ CK(register_definition_db_callbacks_late) /* has to come after register_function
 CK(check_kernel)  /* this is overwriting stuff from smatch_extra_late */
 CK(check_wine)
 CK(register_returns)
+CK(register_mem_tracker)
 
 #ifdef __undo_CK_def
 #undef CK
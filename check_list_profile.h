@@ -0,0 +1 @@
+/* no CHECK_PROFILE */
@@ -69,9 +69,6 @@ static void match_logic(struct expression *expr)
 {
 	struct range_list *rl;
 
-	if (expr->type != EXPR_LOGICAL)
-		return;
-
 	if (warn_if_both_known_values(expr))
 		return;
 
@@ -151,7 +148,7 @@ void check_logical_instead_of_bitwise(int id)
 {
 	my_id = id;
 
-	add_hook(&match_logic, LOGIC_HOOK);
+	add_expr_type_hook(&match_logic, LOGIC_HOOK, EXPR_TYPE_BIT(EXPR_LOGICAL));
 	add_hook(&match_logical_negate, OP_HOOK);
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_hook(&match_assign_mask, ASSIGNMENT_HOOK);
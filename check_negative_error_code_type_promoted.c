@@ -54,9 +54,6 @@ static void match_condition(struct expression *expr)
 	char *name;
 	int op;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
-
 	if (!flip_order(expr, &left, &op, &right))
 		return;
 
@@ -79,5 +76,5 @@ void check_negative_error_code_type_promoted(int id)
 	if (option_project != PROJ_KERNEL)
 		return;
 
-	add_hook(&match_condition, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 }
@@ -121,9 +121,6 @@ static void check_and(struct expression *expr)
 
 static void match_logic(struct expression *expr)
 {
-	if (expr->type != EXPR_LOGICAL)
-		return;
-
 	if (expr->op == SPECIAL_LOGICAL_OR)
 		check_or(expr);
 	if (expr->op == SPECIAL_LOGICAL_AND)
@@ -134,8 +131,6 @@ static void match_condition(struct expression *expr)
 {
 	sval_t sval;
 
-	if (expr->type != EXPR_BINOP)
-		return;
 	if (expr->op == '|') {
 		if (get_value(expr->left, &sval) || get_value(expr->right, &sval))
 			sm_warning("suspicious bitop condition");
@@ -174,8 +169,8 @@ void check_or_vs_and(int id)
 {
 	my_id = id;
 
-	add_hook(&match_logic, LOGIC_HOOK);
-	add_hook(&match_condition, CONDITION_HOOK);
+	add_expr_type_hook(&match_logic, LOGIC_HOOK, EXPR_TYPE_BIT(EXPR_LOGICAL));
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_BINOP));
 	if (option_spammy)
 		add_hook(&match_binop, BINOP_HOOK);
 }
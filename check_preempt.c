@@ -219,26 +219,12 @@ static void match_preempt_count_non_zero(const char *fn, struct expression *call
 	set_state(my_id, "preempt", NULL, alloc_state_num(1));
 }
 
-static int set_sleeps(void *_sleeps, int argc, char **argv, char **azColName)
-{
-	int *fn_sleeps = _sleeps;
-
-	*fn_sleeps = 1;
-	return 0;
-}
-
 static void silence_duplicates(struct symbol *sym)
 {
-	int fn_sleeps = 0;
-
 	if (!sym || !sym->ident)
 		return;
 
-	run_sql(set_sleeps, &fn_sleeps,
-		"select * from return_implies where %s and type = %d;",
-		get_static_filter(sym), SLEEP);
-
-	if (fn_sleeps)
+	if (get_fn_traits(sym)->sleeps)
 		set_state(my_id, "preempt", NULL, alloc_state_num(0));
 }
 
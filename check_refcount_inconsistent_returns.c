@@ -44,32 +44,25 @@ static void match_dec(struct expression *expr, const char *name, struct symbol *
 
 static void check_count(const char *name, struct symbol *sym)
 {
-	struct stree *stree, *orig;
-	struct sm_state *return_sm;
+	struct return_path *paths;
+	struct stree *orig;
 	struct range_list *dec_lines = NULL;
 	struct range_list *inc_lines = NULL;
 	struct sm_state *sm;
-	sval_t line = sval_type_val(&int_ctype, 0);
 	int success_path_increments = 0;
 	int success_path_unknown = 0;
+	int nr, i;
 
-	FOR_EACH_PTR(get_all_return_strees(), stree) {
-		orig = __swap_cur_stree(stree);
-
-		if (is_impossible_path())
-			goto swap_stree;
+	nr = get_return_paths(&paths);
+	for (i = 0; i < nr; i++) {
+		orig = __swap_cur_stree(paths[i].stree);
 
 		if (parent_is_gone_var_sym(name, sym))
 			goto swap_stree;
 
-		return_sm = get_sm_state(RETURN_ID, "return_ranges", NULL);
-		if (!return_sm)
-			goto swap_stree;
-		line.value = return_sm->line;
-
 		sm = get_sm_state(my_id, name, sym);
 
-		if (success_fail_return(estate_rl(return_sm->state)) == RET_SUCCESS) {
+		if (paths[i].bucket == RET_SUCCESS) {
 			if (sm && strcmp(sm->state->name, "inc") == 0)
 				success_path_increments++;
 			else
@@ -81,13 +74,13 @@ static void check_count(const char *name, struct symbol *sym)
 			goto swap_stree;
 
 		if (sm->state == &inc)
-			add_range(&inc_lines, line, line);
+			add_range(&inc_lines, paths[i].line, paths[i].line);
 		else if (sm->state == &dec)
-			add_range(&dec_lines, line, line); /* dec or &undefined */
+			add_range(&dec_lines, paths[i].line, paths[i].line); /* dec or &undefined */
 
 swap_stree:
 		__swap_cur_stree(orig);
-	} END_FOR_EACH_PTR(stree);
+	}
 
 	if (!success_path_increments || success_path_unknown)
 		return;
@@ -110,27 +103,20 @@ static void process_states(void)
 
 static void warn_on_leaks(const char *name, struct symbol *sym)
 {
-	struct stree *stree, *orig;
-	struct sm_state *return_sm;
+	struct return_path *paths;
+	struct stree *orig;
 	struct range_list *inc_lines = NULL;
 	struct sm_state *sm;
-	sval_t line = sval_type_val(&int_ctype, 0);
 	bool has_dec = false;
+	int nr, i;
 
-	FOR_EACH_PTR(get_all_return_strees(), stree) {
-		orig = __swap_cur_stree(stree);
-
-		if (is_impossible_path())
-			goto swap_stree;
+	nr = get_return_paths(&paths);
+	for (i = 0; i < nr; i++) {
+		orig = __swap_cur_stree(paths[i].stree);
 
 		if (parent_is_gone_var_sym(name, sym))
 			goto swap_stree;
 
-		return_sm = get_sm_state(RETURN_ID, "return_ranges", NULL);
-		if (!return_sm)
-			goto swap_stree;
-		line.value = return_sm->line;
-
 		sm = get_sm_state(my_id, name, sym);
 		if (!sm)
 			goto swap_stree;
@@ -140,12 +126,11 @@ static void warn_on_leaks(const char *name, struct symbol *sym)
 			goto swap_stree;
 		}
 
-		if (success_fail_return(estate_rl(return_sm->state)) == RET_FAIL &&
-		    sm->state == &inc)
-			add_range(&inc_lines, line, line);
+		if (paths[i].bucket == RET_FAIL && sm->state == &inc)
+			add_range(&inc_lines, paths[i].line, paths[i].line);
 swap_stree:
 		__swap_cur_stree(orig);
-	} END_FOR_EACH_PTR(stree);
+	}
 
 	if (!has_dec || !inc_lines)
 		return;
@@ -74,8 +74,6 @@ static void match_assign(struct expression *expr)
 
 static void match_condition(struct expression *expr)
 {
-	if (expr->type != EXPR_COMPARE)
-		return;
 	if (expr->op != '<' && expr->op != SPECIAL_LTE)
 		return;
 	if (!expr_is_zero(expr->right))
@@ -148,7 +146,7 @@ void check_returns_negative_error_code(int id)
 		return;
 
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
-	add_hook(&match_condition, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 	add_modification_hook(my_id, &set_undefined);
 	add_pre_merge_hook(my_id, &pre_merge_hook);
 	add_split_return_callback(&match_return);
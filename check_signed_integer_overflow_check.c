@@ -33,8 +33,6 @@ static void match_condition(struct expression *expr)
 	char *right_name;
 	char *left_name;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
 	if (expr->op != '<')
 		return;
 
@@ -105,7 +103,7 @@ void check_signed_integer_overflow_check(int id)
 		return;
 	}
 
-	add_hook(&match_condition, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 	add_hook(&match_binop, BINOP_HOOK);
 }
 
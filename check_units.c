@@ -79,9 +79,6 @@ static void match_condition_check(struct expression *expr)
 	struct smatch_state *left, *right;
 	char *str;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
-
 	left = get_units(expr->left);
 	right = get_units(expr->right);
 
@@ -103,5 +100,5 @@ void check_units(int id)
 		return;
 
 	add_hook(&match_binop_check, BINOP_HOOK);
-	add_hook(&match_condition_check, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition_check, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 }
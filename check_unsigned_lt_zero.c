@@ -152,9 +152,6 @@ static void match_condition(struct expression *expr)
 	char *name;
 	int op;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
-
 	if (!flip_order(expr, &left, &op, &right))
 		return;
 
@@ -238,8 +235,6 @@ static void match_condition_lte(struct expression *expr)
 	struct sm_state *sm;
 	char *name;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
 	if (expr->op != SPECIAL_UNSIGNED_LTE &&
 	    expr->op != SPECIAL_LTE)
 		return;
@@ -270,6 +265,6 @@ void check_unsigned_lt_zero(int id)
 {
 	my_id = id;
 
-	add_hook(&match_condition, CONDITION_HOOK);
-	add_hook(&match_condition_lte, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
+	add_expr_type_hook(&match_condition_lte, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 }
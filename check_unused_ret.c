@@ -196,6 +196,7 @@ void check_unused_ret(int id)
 	/* It turns out that this test is worthless unless you use --two-passes.  */
 	if (!option_two_passes)
 		return;
+	add_two_pass_check(my_id);
 	add_hook(&match_assign_call, CALL_ASSIGNMENT_HOOK);
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_hook(&match_symbol, SYM_HOOK);
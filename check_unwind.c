@@ -333,29 +333,22 @@ static void check_balance(const char *name, struct symbol *sym)
 {
 	struct range_list *inc_lines = NULL;
 	int inc_buckets[RET_UNKNOWN + 1] = {};
-	struct stree *stree, *orig_stree;
+	struct return_path *paths;
+	struct stree *orig_stree;
 	struct smatch_state *state;
-	struct sm_state *return_sm;
 	struct sm_state *sm;
-	sval_t line = sval_type_val(&int_ctype, 0);
 	const char *tmp_name, *fn_name = NULL;
-	int bucket;
+	int nr, i;
 
-	FOR_EACH_PTR(get_all_return_strees(), stree) {
-		orig_stree = __swap_cur_stree(stree);
+	nr = get_return_paths(&paths);
+	for (i = 0; i < nr; i++) {
+		orig_stree = __swap_cur_stree(paths[i].stree);
 
-		if (is_impossible_path())
-			goto swap_stree;
 		if (db_incomplete())
 			goto swap_stree;
 		if (has_devm_cleanup())
 			goto swap_stree;
 
-		return_sm = get_sm_state(RETURN_ID, "return_ranges", NULL);
-		if (!return_sm)
-			goto swap_stree;
-		line.value = return_sm->line;
-
 		sm = get_sm_state(my_id, name, sym);
 		if (!sm)
 			goto swap_stree;
@@ -374,17 +367,16 @@ static void check_balance(const char *name, struct symbol *sym)
 		    state != &release)
 			goto swap_stree;
 
-		bucket = success_fail_return(estate_rl(return_sm->state));
-		if (bucket != RET_FAIL)
+		if (paths[i].bucket != RET_FAIL)
 			goto swap_stree;
 
 		if (state == &alloc) {
-			add_range(&inc_lines, line, line);
-			inc_buckets[bucket] = true;
+			add_range(&inc_lines, paths[i].line, paths[i].line);
+			inc_buckets[RET_FAIL] = true;
 		}
 swap_stree:
 		__swap_cur_stree(orig_stree);
-	} END_FOR_EACH_PTR(stree);
+	}
 
 	if (inc_buckets[RET_FAIL])
 		goto complain;
@@ -19,6 +19,13 @@
  */
 #define CHUNK 32768
 
+/*
+ * If hugepage_blobs is set then the blobs are allocated from 2MB regions
+ * which can use transparent hugepages where the OS supports it.
+ */
+extern int hugepage_blobs;
+extern unsigned long hugepage_regions;
+
 void *blob_alloc(unsigned long size);
 void blob_free(void *addr, unsigned long size);
 long double string_to_ld(const char *nptr, char **endptr);
@@ -1,5 +1,6 @@
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <string.h>
 
 /*
  * Allow old BSD naming too, it would be a pity to have to make a
@@ -9,6 +10,185 @@
 #define MAP_ANONYMOUS MAP_ANON
 #endif
 
+/*
+ * With hugepage_blobs the CHUNK sized blobs are carved out of 2MB aligned
+ * regions which are madvise()d for transparent hugepages.  The first chunk
+ * of each region holds the header.  A region is unmapped again when all of
+ * its chunks are freed.
+ */
+#define HUGE_REGION (2UL * 1024 * 1024)
+#define REGION_CHUNKS (HUGE_REGION / CHUNK)
+#define REGION_HASH 256
+
+struct huge_region {
+	struct huge_region *prev, *next;	/* regions with free chunks */
+	struct huge_region *hash_next;
+	unsigned long long used, dirty;		/* one bit per chunk */
+};
+
+static struct huge_region *partial_regions;
+static struct huge_region *region_hash[REGION_HASH];
+
+static unsigned int region_hash_idx(void *base)
+{
+	return ((unsigned long)base / HUGE_REGION) % REGION_HASH;
+}
+
+static struct huge_region *find_region(void *addr)
+{
+	struct huge_region *region;
+	void *base;
+
+	base = (void *)((unsigned long)addr & ~(HUGE_REGION - 1));
+	if (base == addr)
+		return NULL;
+	for (region = region_hash[region_hash_idx(base)]; region; region = region->hash_next) {
+		if ((void *)region == base)
+			return region;
+	}
+	return NULL;
+}
+
+static void add_partial(struct huge_region *region)
+{
+	region->prev = NULL;
+	region->next = partial_regions;
+	if (partial_regions)
+		partial_regions->prev = region;
+	partial_regions = region;
+}
+
+static void del_partial(struct huge_region *region)
+{
+	if (region->prev)
+		region->prev->next = region->next;
+	else
+		partial_regions = region->next;
+	if (region->next)
+		region->next->prev = region->prev;
+}
+
+static struct huge_region *new_region(void)
+{
+	struct huge_region *region;
+	char *ptr, *aligned;
+	unsigned int idx;
+
+	ptr = mmap(NULL, 2 * HUGE_REGION, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	aligned = (char *)(((unsigned long)ptr + HUGE_REGION - 1) & ~(HUGE_REGION - 1));
+	if (aligned != ptr)
+		munmap(ptr, aligned - ptr);
+	munmap(aligned + HUGE_REGION, ptr + HUGE_REGION - aligned);
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, HUGE_REGION, MADV_HUGEPAGE);
+#endif
+
+	region = (struct huge_region *)aligned;
+	region->used = 1;
+	region->dirty = 1;
+	idx = region_hash_idx(region);
+	region->hash_next = region_hash[idx];
+	region_hash[idx] = region;
+	add_partial(region);
+	hugepage_regions++;
+	return region;
+}
+
+static void free_region(struct huge_region *region)
+{
+	struct huge_region **p;
+
+	del_partial(region);
+	for (p = &region_hash[region_hash_idx(region)]; *p != region; p = &(*p)->hash_next)
+		;
+	*p = region->hash_next;
+	hugepage_regions--;
+	munmap(region, HUGE_REGION);
+}
+
+static void *region_alloc(void)
+{
+	struct huge_region *region;
+	unsigned long long bit;
+	char *ptr;
+
+	region = partial_regions;
+	if (!region)
+		region = new_region();
+	if (!region)
+		return NULL;
+
+	bit = ~region->used & (region->used + 1);
+	region->used |= bit;
+	if (region->used == ~0ULL)
+		del_partial(region);
+
+	ptr = (char *)region + __builtin_ctzll(bit) * CHUNK;
+	/* blobs have to be zeroed the same as when they come from mmap() */
+	if (region->dirty & bit)
+		memset(ptr, 0, CHUNK);
+	region->dirty |= bit;
+	return ptr;
+}
+
+static int region_free(void *addr)
+{
+	struct huge_region *region;
+	unsigned long long bit;
+
+	region = find_region(addr);
+	if (!region)
+		return 0;
+
+	bit = 1ULL << (((unsigned long)addr & (HUGE_REGION - 1)) / CHUNK);
+	if (region->used == ~0ULL)
+		add_partial(region);
+	region->used &= ~bit;
+	if (region->used == 1)
+		free_region(region);
+	return 1;
+}
+
+/*
+ * Most blobs are freed together at the end of a function and the next
+ * function wants about as many again.  Unmapping them one at a time was
+ * most of the end of function teardown and the new blobs then take a page
+ * fault for every page.  Keep up to SPARE_BLOBS of them instead.
+ */
+#define SPARE_BLOBS 2048
+
+struct spare_blob {
+	struct spare_blob *next;
+};
+
+static struct spare_blob *spare_blobs;
+static int nr_spare_blobs;
+
+static void *spare_alloc(void)
+{
+	struct spare_blob *blob = spare_blobs;
+
+	spare_blobs = blob->next;
+	nr_spare_blobs--;
+	/* blobs have to be zeroed the same as when they come from mmap() */
+	memset(blob, 0, CHUNK);
+	return blob;
+}
+
+static int spare_free(void *addr)
+{
+	struct spare_blob *blob = addr;
+
+	if (nr_spare_blobs >= SPARE_BLOBS)
+		return 0;
+	blob->next = spare_blobs;
+	spare_blobs = blob;
+	nr_spare_blobs++;
+	return 1;
+}
+
 /*
  * Our blob allocator enforces the strict CHUNK size
  * requirement, as a portability check.
@@ -19,6 +199,10 @@ void *blob_alloc(unsigned long size)
 
 	if (size & ~CHUNK)
 		die("internal error: bad allocation size (%lu bytes)", size);
+	if (hugepage_blobs && size == CHUNK)
+		return region_alloc();
+	if (spare_blobs && size == CHUNK)
+		return spare_alloc();
 	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (ptr == MAP_FAILED)
 		ptr = NULL;
@@ -29,7 +213,11 @@ void blob_free(void *addr, unsigned long size)
 {
 	if (!size || (size & ~CHUNK) || ((unsigned long) addr & 512))
 		die("internal error: bad blob free (%lu bytes at %p)", size, addr);
+	if (hugepage_regions && region_free(addr))
+		return;
 #ifndef DEBUG
+	if (size == CHUNK && spare_free(addr))
+		return;
 	munmap(addr, size);
 #else
 	mprotect(addr, size, PROT_NONE);
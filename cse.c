@@ -22,6 +22,9 @@
 #define INSN_HASH_SIZE 256
 static struct instruction_list *insn_hash_table[INSN_HASH_SIZE];
 
+// the instructions are collected in the order of their BB
+static unsigned int insn_nr;
+
 static int phi_compare(pseudo_t phi1, pseudo_t phi2)
 {
 	const struct instruction *def1 = phi1->def;
@@ -127,6 +130,7 @@ void cse_collect(struct instruction *insn)
 	}
 	hash += hash >> 16;
 	hash &= INSN_HASH_SIZE-1;
+	insn->cse_nr = ++insn_nr;
 	add_instruction(insn_hash_table + hash, insn);
 }
 
@@ -314,15 +318,9 @@ static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction
 	 * the CSE is inside one basic-block.
 	 */
 	if (b1 == b2) {
-		struct instruction *insn;
-		FOR_EACH_PTR(b1->insns, insn) {
-			if (insn == i1)
-				return cse_one_instruction(i2, i1);
-			if (insn == i2)
-				return cse_one_instruction(i1, i2);
-		} END_FOR_EACH_PTR(insn);
-		warning(b1->pos, "Whaa? unable to find CSE instructions");
-		return i1;
+		if (i1->cse_nr < i2->cse_nr)
+			return cse_one_instruction(i2, i1);
+		return cse_one_instruction(i1, i2);
 	}
 	if (domtree_dominates(b1, b2))
 		return cse_one_instruction(i2, i1);
@@ -336,6 +334,7 @@ static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction
 		i1 = cse_one_instruction(i2, i1);
 		remove_instruction(&b1->insns, i1, 1);
 		insert_last_instruction(common, i1);
+		i1->cse_nr = ++insn_nr;
 	} else {
 		i1 = i2;
 	}
@@ -369,4 +368,5 @@ void cse_eliminate(struct entrypoint *ep)
 			free_ptr_list(list);
 		}
 	}
+	insn_nr = 0;
 }
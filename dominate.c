@@ -69,20 +69,38 @@ static struct basic_block *bank_get(struct piggy *bank)
 #define	ALPHA	0x4
 #define	FLAGS	0x7
 
+//
+// The flags are only valid when the rest of ::generation is the one of
+// the current computation.  The nodes don't need to be reset each time,
+// which would cost a walk over all of them for each variable.
+static unsigned long idf_generation;
+
+static inline unsigned get_flags(struct basic_block *bb)
+{
+	if ((bb->generation & ~FLAGS) != idf_generation)
+		return 0;
+	return bb->generation & FLAGS;
+}
+
+static inline void set_flags(struct basic_block *bb, unsigned flags)
+{
+	bb->generation = idf_generation | get_flags(bb) | flags;
+}
+
 static void visit(struct piggy *bank, struct basic_block_list **idf, struct basic_block *x, int curr_level)
 {
 	struct basic_block *y;
 
-	x->generation |= 1;
+	set_flags(x, VISITED);
 	FOR_EACH_PTR(x->children, y) {
-		unsigned flags = y->generation & FLAGS;
+		unsigned flags = get_flags(y);
 		if (y->idom == x)	// J-edges will be processed later
 			continue;
 		if (y->dom_level > curr_level)
 			continue;
 		if (flags & INPHI)
 			continue;
-		y->generation |= INPHI;
+		set_flags(y, INPHI);
 		add_bb(idf, y);
 		if (flags & ALPHA)
 			continue;
@@ -90,7 +108,7 @@ static void visit(struct piggy *bank, struct basic_block_list **idf, struct basi
 	} END_FOR_EACH_PTR(y);
 
 	FOR_EACH_PTR(x->doms, y) {
-		if (y->generation & VISITED)
+		if (get_flags(y) & VISITED)
 			continue;
 		visit(bank, idf, y, curr_level);
 	} END_FOR_EACH_PTR(y);
@@ -103,16 +121,9 @@ void idf_compute(struct entrypoint *ep, struct basic_block_list **idf, struct ba
 	struct basic_block *bb;
 	unsigned long generation = bb_generation;
 
-	generation = bb_generation;
 	generation += -generation & FLAGS;
 	bb_generation = generation + (FLAGS + 1);
-
-	// init all the nodes
-	FOR_EACH_PTR(ep->bbs, bb) {
-		// FIXME: this should be removed and the tests for
-		//	  visited/in_phi/alpha should use a sparse set
-		bb->generation = generation;
-	} END_FOR_EACH_PTR(bb);
+	idf_generation = generation;
 
 	FOR_EACH_PTR(alpha, bb) {
 		bb->generation = generation | ALPHA;
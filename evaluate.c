@@ -42,6 +42,7 @@
 #include "symbol.h"
 #include "target.h"
 #include "expression.h"
+#include "cwchash/hashtable.h"
 
 struct symbol *current_fn;
 
@@ -1994,7 +1995,44 @@ static struct symbol *evaluate_preop(struct expression *expr)
 	return ctype;
 }
 
-struct symbol *find_identifier(struct ident *ident, struct symbol_list *_list, int *offset)
+/*
+ * Big structs are accessed all over the place so remember where each member
+ * was found (or that it wasn't), keyed by the member list and the name.  The
+ * anonymous structs and unions on the way are kept instead of the offset
+ * because the struct might not have been examined yet.
+ */
+#define MEMBER_MAX_DEPTH 4
+
+struct member_key {
+	struct symbol_list *list;
+	struct ident *ident;
+};
+
+struct member_entry {
+	struct member_key key;
+	struct symbol *sym;
+	int nr_anon;
+	struct symbol *anon[MEMBER_MAX_DEPTH];
+};
+
+static struct hashtable *member_cache;
+
+static unsigned int member_hash(void *_key)
+{
+	struct member_key *key = _key;
+
+	return ((unsigned long)key->list >> 4) * 31 + ((unsigned long)key->ident >> 4);
+}
+
+static int member_equal(void *_one, void *_two)
+{
+	struct member_key *one = _one, *two = _two;
+
+	return one->list == two->list && one->ident == two->ident;
+}
+
+static struct symbol *lookup_member(struct ident *ident, struct symbol_list *_list,
+				    struct member_entry *entry, int depth, int *offset)
 {
 	struct ptr_list *head = (struct ptr_list *)_list;
 	struct ptr_list *list = head;
@@ -2008,6 +2046,7 @@ struct symbol *find_identifier(struct ident *ident, struct symbol_list *_list, i
 			if (sym->ident) {
 				if (sym->ident != ident)
 					continue;
+				entry->nr_anon = depth;
 				*offset = sym->offset;
 				return sym;
 			} else {
@@ -2017,17 +2056,53 @@ struct symbol *find_identifier(struct ident *ident, struct symbol_list *_list, i
 					continue;
 				if (ctype->type != SYM_UNION && ctype->type != SYM_STRUCT)
 					continue;
-				sub = find_identifier(ident, ctype->symbol_list, offset);
+				sub = lookup_member(ident, ctype->symbol_list, entry, depth + 1, offset);
 				if (!sub)
 					continue;
 				*offset += sym->offset;
+				if (depth < MEMBER_MAX_DEPTH)
+					entry->anon[depth] = sym;
 				return sub;
-			}	
+			}
 		}
 	} while ((list = list->next) != head);
 	return NULL;
 }
 
+struct symbol *find_identifier(struct ident *ident, struct symbol_list *_list, int *offset)
+{
+	struct member_key key = { _list, ident };
+	struct member_entry *entry;
+	struct symbol *sym;
+	int i;
+
+	if (!_list)
+		return NULL;
+	if (!member_cache)
+		member_cache = create_hashtable(1000, member_hash, member_equal);
+
+	entry = hashtable_search(member_cache, &key);
+	if (!entry) {
+		entry = calloc(1, sizeof(*entry));
+		entry->key = key;
+		sym = lookup_member(ident, _list, entry, 0, offset);
+		entry->sym = sym;
+		/* too deep to remember, this doesn't happen in real code */
+		if (entry->nr_anon > MEMBER_MAX_DEPTH)
+			free(entry);
+		else
+			hashtable_insert(member_cache, &entry->key, entry);
+		return sym;
+	}
+
+	if (!entry->sym)
+		return NULL;
+	*offset = entry->sym->offset;
+	for (i = 0; i < entry->nr_anon; i++)
+		*offset += entry->anon[i]->offset;
+	return entry->sym;
+}
+
 static struct expression *evaluate_offset(struct expression *expr, unsigned long offset)
 {
 	struct expression *add;
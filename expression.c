@@ -495,6 +495,8 @@ struct token *primary_expression(struct token *token, struct expression **tree)
 			sparse_error(token->pos, "typename in expression");
 			sym = NULL;
 		}
+		if (sym)
+			sym->referenced = 1;
 		expr->symbol_name = token->ident;
 		expr->symbol = sym;
 
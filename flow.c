@@ -403,6 +403,8 @@ void convert_instruction_target(struct instruction *insn, pseudo_t src)
 		if (*pu->userp != VOID) {
 			assert(*pu->userp == target);
 			*pu->userp = src;
+			if (optimizing)
+				requeue_insn(pu->insn);
 		}
 	} END_FOR_EACH_PTR(pu);
 	if (has_use_list(src))
@@ -114,6 +114,18 @@ static void debug_domtree(struct entrypoint *ep)
 	} END_FOR_EACH_PTR(bb);
 }
 
+static int domtree_number(struct basic_block *bb, int nr)
+{
+	struct basic_block *child;
+
+	bb->dom_in = ++nr;
+	FOR_EACH_PTR(bb->doms, child) {
+		nr = domtree_number(child, nr);
+	} END_FOR_EACH_PTR(child);
+	bb->dom_out = ++nr;
+	return nr;
+}
+
 void domtree_build(struct entrypoint *ep)
 {
 	struct basic_block *entry = ep->entry->bb;
@@ -193,6 +205,9 @@ void domtree_build(struct entrypoint *ep)
 	} END_FOR_EACH_PTR(bb);
 	ep->dom_levels = max_level + 1;
 
+	// number the BBs, a BB dominates the ones numbered inside its range
+	domtree_number(entry, 0);
+
 	free(doms);
 	if (dbg_domtree)
 		debug_domtree(ep);
@@ -212,12 +227,8 @@ bool domtree_dominates(struct basic_block *a, struct basic_block *b)
 	if (a->dom_level >= b->dom_level)
 		return false;
 
-	// FIXME: can be faster if we have the DFS in-out numbers
-
-	// walk up the dominator tree
-	for (b = b->idom; b; b = b->idom) {
-		if (b == a)
-			return true;
-	}
-	return false;
+	// BBs created after the DT was built are not in it
+	if (!a->dom_in || !b->dom_in)
+		return false;
+	return a->dom_in < b->dom_in && b->dom_out < a->dom_out;
 }
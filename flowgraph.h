@@ -21,6 +21,7 @@ int cfg_postorder(struct entrypoint *ep);
 //	- a link to its immediate dominator (::idom)
 //	- the list of BB it immediately dominates (::doms)
 //	- its level in the dominance tree (::dom_level)
+//	- its DFS numbers in the dominance tree (::dom_in & ::dom_out)
 void domtree_build(struct entrypoint *ep);
 
 ///
@@ -145,11 +145,13 @@ static void do_warn(const char *type, struct position pos, const char * fmt, va_
 }
 
 static int show_info = 1;
+unsigned int diagnostic_count;
 
 void info(struct position pos, const char * fmt, ...)
 {
 	va_list args;
 
+	diagnostic_count++;
 	if (!show_info)
 		return;
 	va_start(args, fmt);
@@ -161,6 +163,7 @@ static void do_error(struct position pos, const char * fmt, va_list args)
 {
 	static int errors = 0;
 
+	diagnostic_count++;
 	parse_error = 1;
         die_if_error = 1;
 	show_info = 1;
@@ -186,6 +189,7 @@ void warning(struct position pos, const char * fmt, ...)
 {
 	va_list args;
 
+	diagnostic_count++;
 	if (Wsparse_error) {
 		va_start(args, fmt);
 		do_error(pos, fmt, args);
@@ -298,12 +302,20 @@ static void create_builtin_stream(void)
 	add_pre_buffer("#define __builtin_va_arg_pack()\n");
 }
 
+/*
+ * If this is set it is called with every preprocessed token stream before
+ * it is parsed.
+ */
+void (*preprocessed_hook)(struct token *token);
+
 static struct symbol_list *sparse_tokenstream(struct token *token)
 {
 	int builtin = token && !token->pos.stream;
 
 	// Preprocess the stream
 	token = preprocess(token);
+	if (preprocessed_hook)
+		preprocessed_hook(token);
 
 	if (dump_macro_defs || dump_macros_only) {
 		if (!builtin)
@@ -336,9 +348,67 @@ static struct symbol_list *sparse_tokenstream(struct token *token)
 	// Parse the resulting C code
 	while (!eof_token(token))
 		token = external_declaration(token, &translation_unit_used_list, NULL);
+	parse_deferred_bodies();
+	return translation_unit_used_list;
+}
+
+/*
+ * sparse_prefix() parses a buffer of #include lines in a new file scope.
+ * The next sparse_keep_tokens() carries on in that scope instead of
+ * starting a new one and it skips the same #include lines at the start of
+ * the file.  smatch --batch-prefix parses the #include lines which several
+ * files start with once and then forks for each of the files.
+ */
+static int prefix_includes = -1;
+static int skip_includes;
+
+struct symbol_list *sparse_prefix(const char *buf, int nr_includes)
+{
+	struct token *token, *end;
+
+	translation_unit_used_list = NULL;
+	new_file_scope();
+
+	token = tokenize_buffer((void *)buf, strlen(buf), &end);
+	token = preprocess(token);
+
+	/*
+	 * No parse_deferred_bodies() here, the file might use bodies which
+	 * the prefix doesn't.
+	 */
+	while (!eof_token(token))
+		token = external_declaration(token, &translation_unit_used_list, NULL);
+
+	prefix_includes = nr_includes;
 	return translation_unit_used_list;
 }
 
+static bool is_include_directive(struct token *token)
+{
+	if (!match_op(token, '#') || !token->pos.newline)
+		return false;
+	token = token->next;
+	return token_type(token) == TOKEN_IDENT &&
+	       strcmp(show_ident(token->ident), "include") == 0;
+}
+
+/* drop the first "nr" #include directives, they were in the prefix */
+static void drop_include_directives(struct token *begin, int nr)
+{
+	struct token *token;
+	int i;
+
+	token = begin->next;
+	for (i = 0; i < nr; i++) {
+		if (!is_include_directive(token))
+			return;
+		token = token->next->next;
+		while (!eof_token(token) && !token->pos.newline)
+			token = token->next;
+	}
+	begin->next = token;
+}
+
 static struct symbol_list *sparse_file(const char *filename)
 {
 	int fd;
@@ -356,6 +426,8 @@ static struct symbol_list *sparse_file(const char *filename)
 	// Tokenize the input stream
 	token = tokenize(NULL, filename, fd, NULL, includepath);
 	store_all_tokens(token);
+	if (skip_includes)
+		drop_include_directives(token, skip_includes);
 
 	close(fd);
 
@@ -457,15 +529,57 @@ struct symbol_list *sparse_initialize(int argc, char **argv, struct string_list
 	return list;
 }
 
+/*
+ * Apply the options for one more translation unit on top of what
+ * sparse_initialize() already set up.  The defines and include paths are
+ * added to the existing ones.  The target can't be changed here because
+ * the types are already set up.
+ */
+struct symbol_list *sparse_add_options(int argc, char **argv, struct string_list **filelist)
+{
+	struct symbol_list *list;
+	char **args;
+
+	pre_buffer_begin = NULL;
+	pre_buffer_next = &pre_buffer_begin;
+	cmdline_include_nr = 0;
+
+	args = argv;
+	for (;;) {
+		char *arg = *++args;
+		if (!arg)
+			break;
+
+		if (arg[0] == '-' && arg[1]) {
+			args = handle_switch(arg+1, args);
+			continue;
+		}
+		add_ptr_list(filelist, arg);
+	}
+	handle_switch_finalize();
+
+	/* with no -D or -include options there is nothing to preprocess */
+	if (!pre_buffer_begin)
+		return NULL;
+	list = sparse_initial();
+	evaluate_symbol_list(list);
+	return list;
+}
+
 struct symbol_list * sparse_keep_tokens(char *filename)
 {
 	struct symbol_list *res;
 
-	/* Clear previous symbol list */
-	translation_unit_used_list = NULL;
-
-	new_file_scope();
+	if (prefix_includes >= 0) {
+		skip_includes = prefix_includes;
+		prefix_includes = -1;
+	} else {
+		/* Clear previous symbol list */
+		translation_unit_used_list = NULL;
+		new_file_scope();
+	}
 	res = sparse_file(filename);
+	skip_includes = 0;
 
 	/* And return it */
 	return res;
@@ -58,7 +58,8 @@ struct position {
 		     newline:1,
 		     whitespace:1,
 		     pos:10;
-	unsigned int line:31,
+	unsigned int line:30,
+		     macro:1,	/* the token came from a macro, see store_macro_pos() */
 		     noexpand:1;
 };
 
@@ -111,6 +112,7 @@ extern void expression_error(struct expression *, const char *, ...) FORMAT_ATTR
 #define	ERROR_CURR_PHASE	(1 << 0)
 #define	ERROR_PREV_PHASE	(1 << 1)
 extern int has_error;
+extern unsigned int diagnostic_count;	/* bumped for every warning, error and info */
 
 
 enum phase {
@@ -138,9 +140,12 @@ extern void predefined_macros(void);
 
 extern void dump_macro_definitions(void);
 extern struct symbol_list *sparse_initialize(int argc, char **argv, struct string_list **files);
+extern struct symbol_list *sparse_add_options(int argc, char **argv, struct string_list **files);
 extern struct symbol_list *__sparse(char *filename);
 extern struct symbol_list *sparse_keep_tokens(char *filename);
+extern struct symbol_list *sparse_prefix(const char *buf, int nr_includes);
 extern struct symbol_list *sparse(char *filename);
+extern void (*preprocessed_hook)(struct token *token);
 extern void report_stats(void);
 
 static inline int symbol_list_size(struct symbol_list *list)
@@ -15,6 +15,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "parse.h"
 #include "expression.h"
@@ -2594,6 +2596,135 @@ struct entrypoint *linearize_symbol(struct symbol *sym)
 	return NULL;
 }
 
+/*
+ * With -fjobs=N the symbols are split between N forked processes.  Each
+ * one has its stdout and stderr going to temporary files and notes where
+ * the output of each symbol starts and ends.  The parent then copies the
+ * output back in the order of the symbols.
+ */
+struct symbol_output {
+	off_t out_start, out_end;
+	off_t err_start, err_end;
+};
+
+struct symbol_job {
+	pid_t pid;
+	FILE *out, *err, *index;
+};
+
+static void __attribute__((noreturn)) run_symbol_job(struct symbol_job *job, int nr,
+	struct symbol_list *list, void (*fn)(struct symbol *sym))
+{
+	struct symbol_output rec = { 0, 0, 0, 0 };
+	struct symbol *sym;
+	int idx = 0;
+
+	if (dup2(fileno(job->out), STDOUT_FILENO) < 0 ||
+	    dup2(fileno(job->err), STDERR_FILENO) < 0)
+		_exit(127);
+
+	FOR_EACH_PTR(list, sym) {
+		if (idx++ % fjobs != nr)
+			continue;
+		expand_symbol(sym);
+		fn(sym);
+		fflush(stdout);
+		fflush(stderr);
+		rec.out_end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+		rec.err_end = lseek(STDERR_FILENO, 0, SEEK_CUR);
+		fwrite(&rec, sizeof(rec), 1, job->index);
+		rec.out_start = rec.out_end;
+		rec.err_start = rec.err_end;
+	} END_FOR_EACH_PTR(sym);
+	fflush(job->index);
+	_exit(has_error | (die_if_error << 2));
+}
+
+static void copy_output(FILE *from, off_t start, off_t end, FILE *to)
+{
+	char buf[4096];
+	ssize_t ret;
+
+	while (start < end) {
+		ret = pread(fileno(from), buf, end - start < sizeof(buf) ? end - start : sizeof(buf), start);
+		if (ret <= 0)
+			break;
+		fwrite(buf, 1, ret, to);
+		start += ret;
+	}
+}
+
+static void process_symbols_parallel(struct symbol_list *list, void (*fn)(struct symbol *sym))
+{
+	struct symbol_job *jobs;
+	struct symbol_output rec;
+	int nr = symbol_list_size(list);
+	int status;
+	int i;
+
+	jobs = calloc(fjobs, sizeof(*jobs));
+	if (!jobs)
+		die("out of memory");
+	fflush(NULL);
+	for (i = 0; i < fjobs; i++) {
+		jobs[i].out = tmpfile();
+		jobs[i].err = tmpfile();
+		jobs[i].index = tmpfile();
+		if (!jobs[i].out || !jobs[i].err || !jobs[i].index)
+			die("tmpfile() failed");
+		jobs[i].pid = fork();
+		if (jobs[i].pid < 0)
+			die("fork() failed");
+		if (!jobs[i].pid)
+			run_symbol_job(&jobs[i], i, list, fn);
+	}
+
+	for (i = 0; i < fjobs; i++) {
+		if (waitpid(jobs[i].pid, &status, 0) < 0 || !WIFEXITED(status))
+			die("job %d failed", i);
+		status = WEXITSTATUS(status);
+		if (status == 127)
+			die("job %d failed", i);
+		has_error |= status & (ERROR_CURR_PHASE | ERROR_PREV_PHASE);
+		die_if_error |= status >> 2;
+		rewind(jobs[i].index);
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct symbol_job *job = &jobs[i % fjobs];
+
+		if (fread(&rec, sizeof(rec), 1, job->index) != 1)
+			break;
+		copy_output(job->err, rec.err_start, rec.err_end, stderr);
+		copy_output(job->out, rec.out_start, rec.out_end, stdout);
+	}
+
+	for (i = 0; i < fjobs; i++) {
+		fclose(jobs[i].out);
+		fclose(jobs[i].err);
+		fclose(jobs[i].index);
+	}
+	free(jobs);
+}
+
+///
+// Expand each symbol of the list and call @fn on it, which is expected to
+// linearize it.  With -fjobs=N this is done in N processes.
+void process_symbols(struct symbol_list *list, void (*fn)(struct symbol *sym))
+{
+	struct symbol *sym;
+
+	if (fjobs > 1 && symbol_list_size(list) > 1) {
+		process_symbols_parallel(list, fn);
+		return;
+	}
+
+	FOR_EACH_PTR(list, sym) {
+		expand_symbol(sym);
+		fn(sym);
+	} END_FOR_EACH_PTR(sym);
+}
+
 /*
  * Builtin functions
  */
@@ -91,6 +91,8 @@ struct instruction {
 	unsigned opcode:7,
 		 tainted:1,
 		 size:24;
+	unsigned clean:1,		// see requeue_insn()
+		 cse_nr:31;		// order in the BB, see cse_collect()
 	struct basic_block *bb;
 	struct position pos;
 	struct symbol *type;
@@ -137,8 +139,9 @@ struct instruction {
 			struct expression *val;
 		};
 		struct /* setfval */ {
+			// don't let its alignment pad the whole struct
 			long double fvalue;
-		};
+		} __attribute__((packed, aligned(8)));
 		struct /* call */ {
 			pseudo_t func;
 			struct pseudo_list *arguments;
@@ -171,8 +174,10 @@ struct basic_block {
 	struct basic_block *idom;	/* link to the immediate dominator */
 	unsigned int nr;		/* unique id for label's names */
 	int dom_level;			/* level in the dominance tree */
+	int dom_in, dom_out;		/* DFS numbers in the dominance tree */
 	struct basic_block_list *doms;	/* list of BB idominated by this one */
 	struct pseudo_list *needs, *defines;
+	unsigned long *live_maps;	/* needs & defines bitmaps, see liveness.c */
 	union {
 		struct phi_map *phi_map;/* needed during SSA conversion */
 		int postorder_nr;	/* postorder number */
@@ -297,11 +302,18 @@ static inline struct pseudo_user *alloc_pseudo_user(struct instruction *insn, ps
 	return user;
 }
 
+/* optimize.c */
+extern int optimizing;
+void requeue_insn(struct instruction *insn);
+void requeue_users(pseudo_t p);
+
 static inline void use_pseudo(struct instruction *insn, pseudo_t p, pseudo_t *pp)
 {
 	*pp = p;
 	if (has_use_list(p))
 		add_pseudo_user_ptr(alloc_pseudo_user(insn, pp), &p->users);
+	if (optimizing)
+		requeue_insn(insn);
 }
 
 static inline void link_phi(struct instruction *node, pseudo_t phi)
@@ -344,6 +356,7 @@ pseudo_t value_pseudo(long long val);
 pseudo_t undef_pseudo(void);
 
 struct entrypoint *linearize_symbol(struct symbol *sym);
+void process_symbols(struct symbol_list *list, void (*fn)(struct symbol *sym));
 int unssa(struct entrypoint *ep);
 void show_entry(struct entrypoint *ep);
 void show_insn_entry(struct instruction *insn);
@@ -6,12 +6,15 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "liveness.h"
 #include "parse.h"
 #include "expression.h"
 #include "linearize.h"
 #include "flow.h"
+#include "bitmap.h"
 
 static void phi_defines(struct instruction * phi_node, pseudo_t target,
 	void (*defines)(struct basic_block *, pseudo_t))
@@ -140,17 +143,107 @@ static void track_instruction_usage(struct basic_block *bb, struct instruction *
 
 static int liveness_changed;
 
-static void add_pseudo_exclusive(struct pseudo_list **list, pseudo_t pseudo)
+static inline int trackable_pseudo(pseudo_t pseudo)
 {
-	if (!pseudo_in_list(*list, pseudo)) {
-		liveness_changed = 1;
-		add_pseudo(list, pseudo);
+	return pseudo && (pseudo->type == PSEUDO_REG || pseudo->type == PSEUDO_ARG);
+}
+
+/*
+ * While the liveness is calculated, the trackable pseudos of the function
+ * are numbered and each BB has a bitmap for its needs and one for its
+ * defines, so that the membership tests don't have to walk the lists.
+ * The lists are still what is left afterwards.
+ */
+struct pseudo_index {
+	pseudo_t pseudo;
+	unsigned int nr;
+};
+static struct pseudo_index *pseudo_index;
+static unsigned int index_size, nr_pseudos, map_longs;
+static struct basic_block_list *mapped_bbs;
+
+static unsigned int index_slot(pseudo_t pseudo)
+{
+	unsigned long hash = hashval(pseudo) >> 4;
+
+	return (hash ^ (hash >> 12)) & (index_size - 1);
+}
+
+static void grow_index(void)
+{
+	struct pseudo_index *old = pseudo_index;
+	unsigned int old_size = index_size;
+	unsigned int i, slot;
+
+	index_size = index_size ? index_size * 2 : 256;
+	pseudo_index = calloc(index_size, sizeof(*pseudo_index));
+	for (i = 0; i < old_size; i++) {
+		if (!old[i].pseudo)
+			continue;
+		slot = index_slot(old[i].pseudo);
+		while (pseudo_index[slot].pseudo)
+			slot = (slot + 1) & (index_size - 1);
+		pseudo_index[slot] = old[i];
 	}
+	free(old);
 }
 
-static inline int trackable_pseudo(pseudo_t pseudo)
+static unsigned int pseudo_nr(pseudo_t pseudo)
 {
-	return pseudo && (pseudo->type == PSEUDO_REG || pseudo->type == PSEUDO_ARG);
+	unsigned int slot;
+
+	if (nr_pseudos * 2 >= index_size)
+		grow_index();
+	slot = index_slot(pseudo);
+	while (pseudo_index[slot].pseudo) {
+		if (pseudo_index[slot].pseudo == pseudo)
+			return pseudo_index[slot].nr;
+		slot = (slot + 1) & (index_size - 1);
+	}
+	pseudo_index[slot].pseudo = pseudo;
+	pseudo_index[slot].nr = nr_pseudos;
+	return nr_pseudos++;
+}
+
+static void number_pseudo(struct basic_block *bb, pseudo_t pseudo)
+{
+	if (trackable_pseudo(pseudo))
+		pseudo_nr(pseudo);
+}
+
+static unsigned long *needs_map(struct basic_block *bb)
+{
+	if (!bb->live_maps) {
+		bb->live_maps = calloc(map_longs * 2, sizeof(unsigned long));
+		add_bb(&mapped_bbs, bb);
+	}
+	return bb->live_maps;
+}
+
+static unsigned long *defines_map(struct basic_block *bb)
+{
+	return needs_map(bb) + map_longs;
+}
+
+static void free_live_maps(void)
+{
+	struct basic_block *bb;
+
+	FOR_EACH_PTR(mapped_bbs, bb) {
+		free(bb->live_maps);
+		bb->live_maps = NULL;
+	} END_FOR_EACH_PTR(bb);
+	free_ptr_list(&mapped_bbs);
+	memset(pseudo_index, 0, index_size * sizeof(*pseudo_index));
+	nr_pseudos = 0;
+}
+
+static void add_need(struct basic_block *bb, pseudo_t pseudo)
+{
+	if (!test_and_set_bit(pseudo_nr(pseudo), needs_map(bb))) {
+		liveness_changed = 1;
+		add_pseudo(&bb->needs, pseudo);
+	}
 }
 
 static void insn_uses(struct basic_block *bb, pseudo_t pseudo)
@@ -158,13 +251,14 @@ static void insn_uses(struct basic_block *bb, pseudo_t pseudo)
 	if (trackable_pseudo(pseudo)) {
 		struct instruction *def = pseudo->def;
 		if (pseudo->type != PSEUDO_REG || def->bb != bb || def->opcode == OP_PHI)
-			add_pseudo_exclusive(&bb->needs, pseudo);
+			add_need(bb, pseudo);
 	}
 }
 
 static void insn_defines(struct basic_block *bb, pseudo_t pseudo)
 {
 	assert(trackable_pseudo(pseudo));
+	set_bit(pseudo_nr(pseudo), defines_map(bb));
 	add_pseudo(&bb->defines, pseudo);
 }
 
@@ -174,10 +268,11 @@ static void track_bb_liveness(struct basic_block *bb)
 
 	FOR_EACH_PTR(bb->needs, needs) {
 		struct basic_block *parent;
+		unsigned int nr = pseudo_nr(needs);
+
 		FOR_EACH_PTR(bb->parents, parent) {
-			if (!pseudo_in_list(parent->defines, needs)) {
-				add_pseudo_exclusive(&parent->needs, needs);
-			}
+			if (!test_bit(nr, defines_map(parent)))
+				add_need(parent, needs);
 		} END_FOR_EACH_PTR(parent);
 	} END_FOR_EACH_PTR(needs);
 }
@@ -204,6 +299,16 @@ void track_pseudo_liveness(struct entrypoint *ep)
 {
 	struct basic_block *bb;
 
+	/* Number the pseudos, the bitmaps need to know how many there are */
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (insn->bb)
+				track_instruction_usage(bb, insn, number_pseudo, number_pseudo);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	map_longs = (nr_pseudos + BITS_IN_LONG - 1) / BITS_IN_LONG;
+
 	/* Add all the bb pseudo usage */
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct instruction *insn;
@@ -228,8 +333,10 @@ void track_pseudo_liveness(struct entrypoint *ep)
 		pseudo_t def;
 		FOR_EACH_PTR(bb->defines, def) {
 			struct basic_block *child;
+			unsigned int nr = pseudo_nr(def);
+
 			FOR_EACH_PTR(bb->children, child) {
-				if (pseudo_in_list(child->needs, def))
+				if (test_bit(nr, needs_map(child)))
 					goto is_used;
 			} END_FOR_EACH_PTR(child);
 			DELETE_CURRENT_PTR(def);
@@ -238,13 +345,16 @@ is_used:
 		} END_FOR_EACH_PTR(def);
 		PACK_PTR_LIST(&bb->defines);
 	} END_FOR_EACH_PTR(bb);
+
+	free_live_maps();
 }
 
 static void merge_pseudo_list(struct pseudo_list *src, struct pseudo_list **dest)
 {
 	pseudo_t pseudo;
 	FOR_EACH_PTR(src, pseudo) {
-		add_pseudo_exclusive(dest, pseudo);
+		if (!pseudo_in_list(*dest, pseudo))
+			add_pseudo(dest, pseudo);
 	} END_FOR_EACH_PTR(pseudo);
 }
 
@@ -30,6 +30,8 @@
 #include "cwchash/hashtable.h"
 
 static struct hashtable *macro_table;
+static struct position last_pos;
+static struct string_list *last_list;
 
 static DEFINE_HASHTABLE_INSERT(do_insert_macro, struct position, struct string_list);
 static DEFINE_HASHTABLE_SEARCH(do_search_macro, struct position, struct string_list);
@@ -65,42 +67,62 @@ static void insert_macro_string(struct string_list **str_list, char *new)
 	add_ptr_list(str_list, new);
 }
 
+/*
+ * The tokens which a macro expands to get the position of the macro's
+ * name, and the pre-processor copies the ->macro bit along with the rest of
+ * the position.  Expressions and statements take their position from the
+ * tokens so ->macro says if it's worth looking in the table at all.  Most
+ * positions are not from a macro and the lookup is just a bit test.
+ */
 void store_macro_pos(struct token *token)
 {
 	struct string_list *list;
+	struct position *key;
+
+	token->pos.macro = 1;
+	last_list = NULL;
+	last_pos.macro = 0;
 
 	if (!macro_table)
 		macro_table = create_hashtable(5000, position_hash, equalkeys);
 
 	list = do_search_macro(macro_table, &token->pos);
+	if (list) {
+		insert_macro_string(&list, token->ident->name);
+		return;
+	}
 	insert_macro_string(&list, token->ident->name);
 
-	do_insert_macro(macro_table, &token->pos, list);
+	key = malloc(sizeof(*key));
+	if (!key)
+		return;
+	*key = token->pos;
+	do_insert_macro(macro_table, key, list);
 }
 
-char *get_macro_name(struct position pos)
+/* the same position is often asked about several times in a row */
+static struct string_list *lookup_macros(struct position pos)
 {
-	struct string_list *list;
-
-	if (!macro_table)
+	if (!pos.macro || !macro_table)
 		return NULL;
-	list = do_search_macro(macro_table, &pos);
-	return first_ptr_list((struct ptr_list *)list);
+	if (last_pos.macro && equalkeys(&pos, &last_pos))
+		return last_list;
+	last_list = do_search_macro(macro_table, &pos);
+	last_pos = pos;
+	return last_list;
 }
 
-char *get_inner_macro(struct position pos)
+char *get_macro_name(struct position pos)
 {
-	struct string_list *list;
+	return first_ptr_list((struct ptr_list *)lookup_macros(pos));
+}
 
-	if (!macro_table)
-		return NULL;
-	list = do_search_macro(macro_table, &pos);
-	return last_ptr_list((struct ptr_list *)list);
+char *get_inner_macro(struct position pos)
+{
+	return last_ptr_list((struct ptr_list *)lookup_macros(pos));
 }
 
 struct string_list *get_all_macros(struct position pos)
 {
-	if (!macro_table)
-		return NULL;
-	return do_search_macro(macro_table, &pos);
+	return lookup_macros(pos);
 }
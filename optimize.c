@@ -20,6 +20,96 @@
 
 int repeat_phase;
 
+///
+// An instruction is clean when simplify_instruction() had nothing to do
+// with it.  Only the instructions which aren't clean are simplified again
+// in the next pass, so a simplification no longer costs a pass over the
+// whole function.  While optimizing, an instruction is made dirty again when
+// one of its operands changes or when the users of a pseudo it uses or
+// defines change; the instructions defining the operands of a simplified
+// instruction are made dirty too since they may have been rewritten in
+// place.  The CFG changes make everything dirty.
+int optimizing;
+
+void requeue_insn(struct instruction *insn)
+{
+	if (!insn)
+		return;
+	insn->clean = 0;
+	if (has_use_list(insn->target) && insn->target->def == insn)
+		requeue_users(insn->target);
+}
+
+void requeue_users(pseudo_t p)
+{
+	struct pseudo_user *pu;
+
+	if (!has_use_list(p))
+		return;
+	if (has_definition(p))
+		p->def->clean = 0;
+	FOR_EACH_PTR(p->users, pu) {
+		pu->insn->clean = 0;
+	} END_FOR_EACH_PTR(pu);
+}
+
+static void requeue_def(pseudo_t p)
+{
+	if (has_use_list(p) && has_definition(p))
+		p->def->clean = 0;
+}
+
+static void requeue_operands(struct instruction *insn)
+{
+	pseudo_t p;
+
+	switch (insn->opcode) {
+	case OP_SEL:
+	case OP_RANGE:
+		requeue_def(insn->src3);
+		/* fall through */
+
+	case OP_BINARY ... OP_BINCMP_END:
+		requeue_def(insn->src2);
+		/* fall through */
+
+	case OP_UNOP ... OP_UNOP_END:
+	case OP_SLICE:
+	case OP_PHISOURCE:
+	case OP_SYMADDR:
+	case OP_CBR:
+	case OP_SWITCH:
+	case OP_COMPUTEDGOTO:
+	case OP_LOAD:
+	case OP_RET:
+		requeue_def(insn->src1);
+		break;
+
+	case OP_STORE:
+		requeue_def(insn->src);
+		requeue_def(insn->target);
+		break;
+
+	case OP_PHI:
+		FOR_EACH_PTR(insn->phi_list, p) {
+			requeue_def(p);
+		} END_FOR_EACH_PTR(p);
+		break;
+	}
+}
+
+static void requeue_all(struct entrypoint *ep)
+{
+	struct basic_block *bb;
+	struct instruction *insn;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		FOR_EACH_PTR(bb->insns, insn) {
+			insn->clean = 0;
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+}
+
 static void clear_symbol_pseudos(struct entrypoint *ep)
 {
 	pseudo_t pseudo;
@@ -37,9 +127,19 @@ static void clean_up_insns(struct entrypoint *ep)
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct instruction *insn;
 		FOR_EACH_PTR(bb->insns, insn) {
+			int changed;
+
 			if (!insn->bb)
 				continue;
-			repeat_phase |= simplify_instruction(insn);
+			if (!insn->clean) {
+				insn->clean = 1;
+				changed = simplify_instruction(insn);
+				if (changed && insn->bb) {
+					requeue_insn(insn);
+					requeue_operands(insn);
+				}
+				repeat_phase |= changed;
+			}
 			if (!insn->bb)
 				continue;
 			assert(insn->bb == bb);
@@ -86,6 +186,7 @@ void optimize(struct entrypoint *ep)
 
 	if (!(fpasses & PASS_OPTIM))
 		return;
+	optimizing = 1;
 repeat:
 	/*
 	 * Remove trivial instructions, and try to CSE
@@ -96,8 +197,10 @@ repeat:
 		do {
 			repeat_phase = 0;
 			clean_up_insns(ep);
-			if (repeat_phase & REPEAT_CFG_CLEANUP)
+			if (repeat_phase & REPEAT_CFG_CLEANUP) {
 				kill_unreachable_bbs(ep);
+				requeue_all(ep);
+			}
 
 			cse_eliminate(ep);
 			simplify_memops(ep);
@@ -105,6 +208,7 @@ repeat:
 		pack_basic_blocks(ep);
 		if (repeat_phase & REPEAT_CFG_CLEANUP)
 			cleanup_cfg(ep);
+		requeue_all(ep);
 	} while (repeat_phase);
 
 	vrfy_flow(ep);
@@ -125,8 +229,10 @@ repeat:
 		clear_liveness(ep);
 		if (repeat_phase & REPEAT_CFG_CLEANUP)
 			cleanup_cfg(ep);
+		requeue_all(ep);
 		goto repeat;
 	}
+	optimizing = 0;
 
 	/* Finally, add deathnotes to pseudos now that we have them */
 	if (dbg_dead)
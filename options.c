@@ -74,6 +74,7 @@ int dissect_show_all_symbols = 0;
 
 unsigned long fdump_ir;
 int fhosted = 1;
+unsigned int fjobs = 1;
 unsigned int fmax_errors = 100;
 unsigned int fmax_warnings = 100;
 int fmem_report = 0;
@@ -501,6 +502,14 @@ static int handle_fmemcpy_max_count(const char *arg, const char *opt, const stru
 	return 1;
 }
 
+static int handle_fjobs(const char *arg, const char *opt, const struct flag *flag, int options)
+{
+	opt_uint(arg, opt, &fjobs, 0);
+	if (!fjobs)
+		fjobs = 1;
+	return 1;
+}
+
 static int handle_fmax_errors(const char *arg, const char *opt, const struct flag *flag, int options)
 {
 	opt_uint(arg, opt, &fmax_errors, OPTNUM_UNLIMITED);
@@ -518,6 +527,7 @@ static struct flag fflags[] = {
 	{ "dump-ir",		NULL,	handle_fdump_ir },
 	{ "freestanding",	&fhosted, NULL, OPT_INVERSE },
 	{ "hosted",		&fhosted },
+	{ "jobs=",		NULL,	handle_fjobs },
 	{ "linearize",		NULL,	handle_fpasses,	PASS_LINEARIZE },
 	{ "max-errors=",	NULL,	handle_fmax_errors },
 	{ "max-warnings=",	NULL,	handle_fmax_warnings },
@@ -74,6 +74,7 @@ extern int dissect_show_all_symbols;
 
 extern unsigned long fdump_ir;
 extern int fhosted;
+extern unsigned int fjobs;
 extern unsigned int fmax_errors;
 extern unsigned int fmax_warnings;
 extern int fmem_report;
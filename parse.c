@@ -46,6 +46,27 @@
 
 static struct symbol_list **function_symbol_list;
 struct symbol_list *function_computed_target_list;
+
+/*
+ * If this is set it is asked before each function body is parsed.  When it
+ * returns true the body is skipped and the function gets an empty one.
+ */
+int (*skip_function_body)(struct symbol *decl, struct token *lbrace, struct token *rbrace);
+
+/*
+ * If this returns true for a function the body is only kept as a token
+ * range and it is parsed at the end of the translation unit, and then only
+ * if something referred to the function.  See parse_deferred_bodies().
+ */
+int (*defer_function_body)(struct symbol *decl);
+static struct symbol_list *deferred_bodies;
+
+/*
+ * If this is set the expressions and statements of function bodies come from
+ * their own allocators and retire_function_bodies() can free them.
+ */
+int retire_bodies;
+static struct symbol_list *body_symbols, *retired_body_symbols;
 struct statement_list *function_computed_goto_list;
 
 static struct token *statement(struct token *token, struct statement **tree);
@@ -2841,12 +2862,41 @@ static int is_syscall(struct symbol *sym)
 }
     
 
+static struct token *matching_brace(struct token *token)
+{
+	int depth = 0;
+
+	for (; !eof_token(token); token = token->next) {
+		if (match_op(token, '{'))
+			depth++;
+		else if (match_op(token, '}') && --depth == 0)
+			return token;
+	}
+	return NULL;
+}
+
+static void resolve_computed_gotos(struct symbol *decl)
+{
+	struct statement *stmt;
+
+	if (!function_computed_goto_list)
+		return;
+	if (!function_computed_target_list) {
+		warning(decl->pos, "function '%s' has computed goto but no targets?", show_ident(decl->ident));
+		return;
+	}
+	FOR_EACH_PTR(function_computed_goto_list, stmt) {
+		stmt->target_list = function_computed_target_list;
+	} END_FOR_EACH_PTR(stmt);
+}
+
 static struct token *parse_function_body(struct token *token, struct symbol *decl,
 	struct symbol_list **list)
 {
 	struct symbol_list **old_symbol_list;
 	struct symbol *base_type = decl->ctype.base_type;
 	struct statement *stmt, **p;
+	struct token *end;
 	struct symbol *prev;
 	struct symbol *arg;
 
@@ -2868,6 +2918,10 @@ static struct token *parse_function_body(struct token *token, struct symbol *dec
 	if (!(decl->ctype.modifiers & MOD_STATIC))
 		decl->ctype.modifiers |= MOD_EXTERN;
 
+	if (retire_bodies) {
+		use_body_allocators(1);
+		add_symbol(&body_symbols, decl);
+	}
 	stmt = start_function(decl);
 	*p = stmt;
 
@@ -2875,8 +2929,23 @@ static struct token *parse_function_body(struct token *token, struct symbol *dec
 		declare_argument(arg, base_type);
 	} END_FOR_EACH_PTR(arg);
 
-	token = statement_list(token->next, &stmt->stmts);
+	if (defer_function_body && defer_function_body(decl) &&
+	    (end = matching_brace(token))) {
+		decl->lazy_body = token;
+		decl->lazy_horizon = current_bind_nr();
+		add_symbol(&deferred_bodies, decl);
+		token = end;
+	} else if (skip_function_body) {
+		end = matching_brace(token);
+		if (end && skip_function_body(decl, token, end))
+			token = end;
+		else
+			token = statement_list(token->next, &stmt->stmts);
+	} else {
+		token = statement_list(token->next, &stmt->stmts);
+	}
 	end_function(decl);
+	use_body_allocators(0);
 
 	if (!(decl->ctype.modifiers & MOD_INLINE))
 		add_symbol(list, decl);
@@ -2903,18 +2972,115 @@ static struct token *parse_function_body(struct token *token, struct symbol *dec
 		}
 	}
 	function_symbol_list = old_symbol_list;
-	if (function_computed_goto_list) {
-		if (!function_computed_target_list)
-			warning(decl->pos, "function '%s' has computed goto but no targets?", show_ident(decl->ident));
-		else {
-			FOR_EACH_PTR(function_computed_goto_list, stmt) {
-				stmt->target_list = function_computed_target_list;
-			} END_FOR_EACH_PTR(stmt);
-		}
-	}
+	resolve_computed_gotos(decl);
 	return expect(token, '}', "at end of function");
 }
 
+static void rebind_symbol(struct symbol *sym, struct ident *ident, enum namespace ns)
+{
+	sym->bound = 0;
+	bind_symbol(sym, ident, ns);
+}
+
+static void parse_lazy_body(struct symbol *decl)
+{
+	struct symbol_list **old_symbol_list = function_symbol_list;
+	struct symbol *base_type = decl->ctype.base_type;
+	struct statement *stmt = base_type->inline_stmt;
+	struct token *token = decl->lazy_body;
+	struct symbol *arg;
+
+	decl->lazy_body = NULL;
+	function_symbol_list = &decl->inline_symbol_list;
+	function_computed_target_list = NULL;
+	function_computed_goto_list = NULL;
+
+	/* the return symbol and the arguments were allocated by start_function() */
+	start_function_scope(decl->pos);
+	rebind_symbol(stmt->ret, &return_ident, NS_ITERATOR);
+	current_fn = decl;
+	FOR_EACH_PTR(base_type->arguments, arg) {
+		if (arg->ident)
+			rebind_symbol(arg, arg->ident, NS_SYMBOL);
+	} END_FOR_EACH_PTR(arg);
+
+	lookup_horizon = decl->lazy_horizon;
+	use_body_allocators(retire_bodies);
+	statement_list(token->next, &stmt->stmts);
+	use_body_allocators(0);
+	lookup_horizon = 0;
+	end_function(decl);
+
+	function_symbol_list = old_symbol_list;
+	resolve_computed_gotos(decl);
+}
+
+static bool body_referenced(struct symbol *decl)
+{
+	struct symbol *sym;
+
+	for (sym = decl->ident->symbols; sym; sym = sym->next_id) {
+		if (sym->namespace == NS_SYMBOL && sym->referenced)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Parse the deferred function bodies which are used.  Parsing a body can
+ * make other functions used so keep going until nothing changes.  The rest
+ * are left without a body, the same as a function which is only declared.
+ *
+ * This is called at the end of the translation unit, while the file scope
+ * is still open.  The lookup_horizon hides the file scope declarations which
+ * came after the body.
+ */
+void parse_deferred_bodies(void)
+{
+	struct symbol *decl;
+	bool progress;
+
+	do {
+		progress = false;
+		FOR_EACH_PTR(deferred_bodies, decl) {
+			if (!decl->lazy_body || !body_referenced(decl))
+				continue;
+			parse_lazy_body(decl);
+			progress = true;
+		} END_FOR_EACH_PTR(decl);
+	} while (progress);
+
+	FOR_EACH_PTR(deferred_bodies, decl) {
+		if (!decl->lazy_body)
+			continue;
+		decl->lazy_body = NULL;
+		decl->ctype.base_type->inline_stmt = NULL;
+	} END_FOR_EACH_PTR(decl);
+	free_ptr_list(&deferred_bodies);
+}
+
+/*
+ * Called when the caller is done with the bodies of the last file.  Those
+ * are freed when this is called again, and the functions from then on look
+ * like they were only declared.
+ */
+void retire_function_bodies(void)
+{
+	struct symbol *sym, *base_type;
+
+	FOR_EACH_PTR(retired_body_symbols, sym) {
+		base_type = sym->ctype.base_type;
+		base_type->stmt = NULL;
+		base_type->inline_stmt = NULL;
+		sym->symbol_list = NULL;
+		sym->inline_symbol_list = NULL;
+	} END_FOR_EACH_PTR(sym);
+	free_ptr_list(&retired_body_symbols);
+	retired_body_symbols = body_symbols;
+	body_symbols = NULL;
+	retire_body_allocations();
+}
+
 static void promote_k_r_types(struct symbol *arg)
 {
 	struct symbol *base = arg->ctype.base_type;
@@ -123,6 +123,11 @@ struct statement {
 };
 
 extern struct symbol_list *function_computed_target_list;
+extern int (*skip_function_body)(struct symbol *decl, struct token *lbrace, struct token *rbrace);
+extern int (*defer_function_body)(struct symbol *decl);
+extern void parse_deferred_bodies(void);
+extern int retire_bodies;
+extern void retire_function_bodies(void);
 extern struct statement_list *function_computed_goto_list;
 
 extern struct token *parse_expression(struct token *, struct expression **);
@@ -36,6 +36,7 @@
 #include <limits.h>
 #include <time.h>
 #include <dirent.h>
+#include <errno.h>
 #include <sys/stat.h>
 #include <sys/utsname.h>
 
@@ -53,6 +54,17 @@ static int counter_macro = 0;		// __COUNTER__ expansion
 static int include_level = 0;
 static int expanding = 0;
 
+/* See expand_cached() */
+struct macro_recording {
+	bool failed;
+	int nr_deps, max_deps;
+	struct symbol **deps;
+};
+
+static unsigned int macro_generation = 1;
+static struct macro_recording *macro_recording;
+static void record_macro_dep(struct symbol *sym);
+
 #define INCLUDEPATHS 300
 const char *includepath[INCLUDEPATHS+1] = {
 	"",
@@ -101,6 +113,7 @@ static struct token *alloc_token(struct position *pos)
 	token->pos.stream = pos->stream;
 	token->pos.line = pos->line;
 	token->pos.pos = pos->pos;
+	token->pos.macro = pos->macro;
 	token->pos.whitespace = 1;
 	return token;
 }
@@ -220,6 +233,11 @@ static int expand_one_symbol(struct token **list)
 	sym = lookup_macro(token->ident);
 	if (!sym)
 		return 1;
+	if (macro_recording) {
+		record_macro_dep(sym);
+		if (macro_recording->failed)
+			return 1;
+	}
 	store_macro_pos(token);
 	if (sym->expand_simple) {
 		sym->expand_simple(token);
@@ -301,6 +319,7 @@ static struct token *collect_arg(struct token *prev, int vararg, struct position
 		next->pos.stream = pos->stream;
 		next->pos.line = pos->line;
 		next->pos.pos = pos->pos;
+		next->pos.macro = pos->macro;
 		next->pos.newline = 0;
 		p = &next->next;
 	}
@@ -746,6 +765,188 @@ static struct token **substitute(struct token **list, struct token *body, struct
 	return list;
 }
 
+/*
+ * Object-like macros such as GFP_KERNEL expand through a chain of other
+ * object-like macros and the whole chain is redone at every use.  The
+ * first time such a macro is used, it is expanded completely on its own
+ * list and the result is saved.  Later uses copy the saved tokens instead.
+ *
+ * This only works when nothing in the chain looks past the end of its own
+ * expansion, so any function-like or magic macro anywhere in the chain
+ * makes the macro uncacheable.  A saved expansion is thrown away on any
+ * #define or #undef, and between files, by bumping macro_generation.  The
+ * macros the chain went through are kept in deps[].  If one of them is
+ * being expanded further out (tainted), the saved result can't be used
+ * and we expand the normal way.
+ *
+ * The newline and whitespace flags of the macro's name token end up on
+ * the first token of the result, so there is a saved copy for each
+ * combination of the two.
+ */
+struct macro_expansion {
+	unsigned int generation;
+	int nr_tokens, nr_deps;
+	struct token *tokens;
+	struct symbol **deps;
+};
+
+struct macro_cache {
+	unsigned int generation;	/* when it was found to be uncacheable */
+	struct macro_expansion variant[4];
+};
+
+static void record_macro_dep(struct symbol *sym)
+{
+	struct macro_recording *rec = macro_recording;
+
+	if (sym->arglist || sym->expand || sym->expand_simple)
+		rec->failed = true;
+	if (rec->failed)
+		return;
+	if (rec->nr_deps == rec->max_deps) {
+		rec->max_deps = rec->max_deps * 2 + 8;
+		rec->deps = realloc(rec->deps, rec->max_deps * sizeof(*rec->deps));
+		if (!rec->deps)
+			die("out of memory");
+	}
+	rec->deps[rec->nr_deps++] = sym;
+}
+
+static bool same_place(struct position a, struct position b)
+{
+	return a.stream == b.stream && a.line == b.line && a.pos == b.pos;
+}
+
+static void save_macro_expansion(struct macro_expansion *exp,
+				 struct macro_recording *rec,
+				 struct token *token, struct token *result)
+{
+	struct token *t;
+	int nr = 0;
+
+	for (t = result; !eof_token(t); t = t->next) {
+		if (token_type(t) == TOKEN_IDENT && t->pos.noexpand)
+			return;
+		if (!same_place(t->pos, token->pos))
+			return;
+		nr++;
+	}
+
+	free(exp->tokens);
+	free(exp->deps);
+	exp->tokens = malloc(nr * sizeof(*exp->tokens) + 1);
+	exp->deps = malloc(rec->nr_deps * sizeof(*exp->deps) + 1);
+	if (!exp->tokens || !exp->deps)
+		die("out of memory");
+	nr = 0;
+	for (t = result; !eof_token(t); t = t->next)
+		exp->tokens[nr++] = *t;
+	memcpy(exp->deps, rec->deps, rec->nr_deps * sizeof(*exp->deps));
+	exp->nr_tokens = nr;
+	exp->nr_deps = rec->nr_deps;
+	exp->generation = macro_generation;
+}
+
+static struct token *replay_macro_expansion(struct macro_expansion *exp,
+					    struct token *token)
+{
+	struct token *res = &eof_token_entry;
+	struct token **p = &res;
+	int i;
+
+	for (i = 0; i < exp->nr_deps; i++) {
+		struct symbol *dep = exp->deps[i];
+
+		if (dep->ident->tainted)
+			return NULL;
+	}
+	/*
+	 * store_macro_pos() keeps a pointer to the token's position so it
+	 * has to be a real token, not one on the stack.
+	 */
+	for (i = 0; i < exp->nr_deps; i++) {
+		struct symbol *dep = exp->deps[i];
+		struct ident *ident = token->ident;
+
+		token->ident = dep->ident;
+		store_macro_pos(token);
+		token->ident = ident;
+		dep->used_in = file_scope;
+	}
+	for (i = 0; i < exp->nr_tokens; i++) {
+		struct token *newtok = __alloc_token(0);
+
+		*newtok = exp->tokens[i];
+		newtok->pos.stream = token->pos.stream;
+		newtok->pos.line = token->pos.line;
+		newtok->pos.pos = token->pos.pos;
+		newtok->pos.macro = token->pos.macro;
+		*p = newtok;
+		p = &newtok->next;
+	}
+	*p = &eof_token_entry;
+	return res;
+}
+
+/*
+ * Expand the object-like macro at *list from the cache, or fill the cache.
+ * Returns 0 when *list has been replaced by the complete expansion, 1 if
+ * the caller has to expand it the normal way.
+ */
+static int expand_cached(struct token **list, struct symbol *sym)
+{
+	struct token *token = *list;
+	struct macro_recording rec = {};
+	struct macro_expansion *exp;
+	struct macro_cache *cache;
+	struct token *res, *copy, **tail;
+	unsigned int diagnostics;
+
+	cache = sym->expansion_cache;
+	if (!cache) {
+		cache = calloc(1, sizeof(*cache));
+		if (!cache)
+			return 1;
+		sym->expansion_cache = cache;
+	}
+	if (cache->generation == macro_generation)
+		return 1;
+	exp = &cache->variant[token->pos.newline << 1 | token->pos.whitespace];
+
+	if (exp->generation == macro_generation) {
+		res = replay_macro_expansion(exp, token);
+		if (!res)
+			return 1;
+	} else {
+		copy = __alloc_token(0);
+		*copy = *token;
+		copy->next = &eof_token_entry;
+		res = copy;
+
+		diagnostics = diagnostic_count;
+		macro_recording = &rec;
+		expand_list(&res);
+		macro_recording = NULL;
+
+		if (rec.failed) {
+			free(rec.deps);
+			cache->generation = macro_generation;
+			return 1;
+		}
+		/* Warnings have to be given again at every use. */
+		if (diagnostics == diagnostic_count)
+			save_macro_expansion(exp, &rec, token, res);
+		free(rec.deps);
+	}
+
+	tail = list;
+	*list = res;
+	while (!eof_token(*tail))
+		tail = &(*tail)->next;
+	*tail = token->next;
+	return 0;
+}
+
 static int expand(struct token **list, struct symbol *sym)
 {
 	struct token *last;
@@ -761,6 +962,11 @@ static int expand(struct token **list, struct symbol *sym)
 		return 1;
 	}
 
+	if (!macro_recording && !sym->arglist && !sym->expand) {
+		if (!expand_cached(list, sym))
+			return 0;
+	}
+
 	if (sym->arglist) {
 		if (!match_op(scan_next(&token->next), '('))
 			return 1;
@@ -900,6 +1106,133 @@ static void set_stream_include_path(struct stream *stream)
 	includepath[0] = path;
 }
 
+/*
+ * Most of the open() calls for a #include <...> fail with ENOENT because
+ * the header is in one of the later -I directories.  The first time a
+ * directory is looked at it is read with readdir() and its names are kept
+ * in a hash table, after that a name which isn't listed is skipped without
+ * a syscall.  A directory which can't be listed for any reason other than
+ * not existing is marked unknown and we fall back to open().
+ */
+#define INCLUDE_DIR_HASH_BITS 10
+#define INCLUDE_NAME_HASH_BITS 16
+
+enum include_dir_state {
+	INCLUDE_DIR_LISTED,
+	INCLUDE_DIR_MISSING,
+	INCLUDE_DIR_UNKNOWN,
+};
+
+struct include_dir {
+	struct include_dir *next;
+	enum include_dir_state state;
+	char name[];
+};
+
+struct include_name {
+	struct include_name *next;
+	struct include_dir *dir;
+	char name[];
+};
+
+static struct include_dir *include_dirs[1 << INCLUDE_DIR_HASH_BITS];
+static struct include_name *include_names[1 << INCLUDE_NAME_HASH_BITS];
+
+static unsigned int include_hash(unsigned int hash, const char *name, int len, int bits)
+{
+	while (len--)
+		hash = (hash + (unsigned char)*name++) * 0x9e3779b1;
+	return hash >> (32 - bits);
+}
+
+static unsigned int include_name_hash(struct include_dir *dir, const char *name, int len)
+{
+	return include_hash((unsigned long)dir >> 4, name, len, INCLUDE_NAME_HASH_BITS);
+}
+
+static void list_include_dir(struct include_dir *dir)
+{
+	struct include_name *entry;
+	struct dirent *de;
+	unsigned int hash;
+	DIR *dp;
+	int len;
+
+	dp = opendir(dir->name[0] ? dir->name : ".");
+	if (!dp) {
+		if (errno == ENOENT || errno == ENOTDIR)
+			dir->state = INCLUDE_DIR_MISSING;
+		else
+			dir->state = INCLUDE_DIR_UNKNOWN;
+		return;
+	}
+	while ((de = readdir(dp))) {
+		len = strlen(de->d_name);
+		entry = malloc(sizeof(*entry) + len + 1);
+		if (!entry)
+			die("out of memory");
+		entry->dir = dir;
+		memcpy(entry->name, de->d_name, len + 1);
+		hash = include_name_hash(dir, entry->name, len);
+		entry->next = include_names[hash];
+		include_names[hash] = entry;
+	}
+	closedir(dp);
+	dir->state = INCLUDE_DIR_LISTED;
+}
+
+static struct include_dir *lookup_include_dir(const char *name, int len)
+{
+	struct include_dir *dir;
+	unsigned int hash;
+
+	hash = include_hash(0, name, len, INCLUDE_DIR_HASH_BITS);
+	for (dir = include_dirs[hash]; dir; dir = dir->next) {
+		if (strncmp(dir->name, name, len) == 0 && !dir->name[len])
+			return dir;
+	}
+	dir = malloc(sizeof(*dir) + len + 1);
+	if (!dir)
+		die("out of memory");
+	memcpy(dir->name, name, len);
+	dir->name[len] = '\0';
+	list_include_dir(dir);
+	dir->next = include_dirs[hash];
+	include_dirs[hash] = dir;
+	return dir;
+}
+
+/*
+ * Returns 0 only if the directory listing says that 'fullname' can't
+ * exist.  Anything we aren't sure about gets passed on to open().
+ */
+static int include_file_may_exist(const char *fullname)
+{
+	const char *base = strrchr(fullname, '/');
+	struct include_name *entry;
+	struct include_dir *dir;
+	int len;
+
+	if (base) {
+		dir = lookup_include_dir(fullname, base - fullname + 1);
+		base++;
+	} else {
+		dir = lookup_include_dir("", 0);
+		base = fullname;
+	}
+	if (dir->state == INCLUDE_DIR_MISSING)
+		return 0;
+	if (dir->state == INCLUDE_DIR_UNKNOWN)
+		return 1;
+
+	len = strlen(base);
+	for (entry = include_names[include_name_hash(dir, base, len)]; entry; entry = entry->next) {
+		if (entry->dir == dir && strcmp(entry->name, base) == 0)
+			return 1;
+	}
+	return 0;
+}
+
 static int try_include(struct position pos, const char *path, const char *filename, int flen, struct token **where, const char **next_path)
 {
 	int fd;
@@ -912,6 +1245,8 @@ static int try_include(struct position pos, const char *path, const char *filena
 		plen++;
 	}
 	memcpy(fullname+plen, filename, flen);
+	if (!include_file_may_exist(fullname))
+		return 0;
 	if (already_tokenized(fullname))
 		return 1;
 	fd = open(fullname, O_RDONLY);
@@ -1483,6 +1818,7 @@ static int do_define(struct position pos, struct token *token, struct ident *nam
 	struct symbol *sym;
 	int ret = 1;
 
+	macro_generation++;
 	expansion = parse_expansion(expansion, arglist, name);
 	if (!expansion)
 		return 1;
@@ -1657,6 +1993,8 @@ static int do_handle_undef(struct stream *stream, struct token **line, struct to
 		return 1;
 	}
 
+	macro_generation++;
+
 	sym = lookup_symbol(left->ident, NS_MACRO | NS_UNDEF);
 	if (sym) {
 		if (attr < sym->attr)
@@ -2433,7 +2771,9 @@ struct token * preprocess(struct token *token)
 {
 	preprocessing = 1;
 	init_preprocessor();
+	macro_generation++;
 	do_preprocess(&token);
+	macro_generation++;
 
 	// Drop all expressions from preprocessing, they're not used any more.
 	// This is not true when we have multiple files, though ;/
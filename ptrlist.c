@@ -21,6 +21,7 @@
 //   but VOID is also used for invalid types and in case of errors.
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 
@@ -31,6 +32,50 @@
 __DECLARE_ALLOCATOR(struct ptr_list, ptrlist);
 __ALLOCATOR(struct ptr_list, "ptr list", ptrlist);
 __ALLOCATOR(struct ptr_list, "rl ptr list", rl_ptrlist);
+__ALLOCATOR(struct ptr_list, "sm ptr list", sm_ptrlist);
+__DO_ALLOCATOR(struct ptr_list, offsetof(struct ptr_list, list[LIST_NODE_SMALL_NR]),
+	       __alignof__(struct ptr_list), "small rl ptr list", small_rl_ptrlist);
+__DO_ALLOCATOR(struct ptr_list, offsetof(struct ptr_list, list[LIST_NODE_SMALL_NR]),
+	       __alignof__(struct ptr_list), "small sm ptr list", small_sm_ptrlist);
+
+int rl_ptrlist_hack;
+int sm_ptrlist_hack;
+
+/*
+ * The range lists and the sm_state ->possible lists only live until the end
+ * of the function so they come from their own allocators which are cleared
+ * all at once.  Those blocks can't go on the normal freelist.
+ *
+ * Most of those lists only ever hold one or two entries so the first block
+ * is a small one.
+ */
+static struct ptr_list *alloc_ptrlist_block(bool first)
+{
+	struct ptr_list *list;
+
+	if (rl_ptrlist_hack) {
+		if (!first)
+			return __alloc_rl_ptrlist(0);
+		list = __alloc_small_rl_ptrlist(0);
+		list->small = 1;
+		return list;
+	}
+	if (sm_ptrlist_hack) {
+		if (!first)
+			return __alloc_sm_ptrlist(0);
+		list = __alloc_small_sm_ptrlist(0);
+		list->small = 1;
+		return list;
+	}
+	return __alloc_ptrlist(0);
+}
+
+static void free_ptrlist_block(struct ptr_list *list)
+{
+	if (rl_ptrlist_hack || sm_ptrlist_hack || list->small)
+		return;
+	__free_ptrlist(list);
+}
 
 ///
 // get the size of a ptrlist
@@ -206,14 +251,14 @@ restart:
 			if (!entry->nr) {
 				struct ptr_list *prev;
 				if (next == entry) {
-					__free_ptrlist(entry);
+					free_ptrlist_block(entry);
 					*listp = NULL;
 					return;
 				}
 				prev = entry->prev;
 				prev->next = next;
 				next->prev = prev;
-				__free_ptrlist(entry);
+				free_ptrlist_block(entry);
 				if (entry == head) {
 					*listp = next;
 					head = next;
@@ -236,7 +281,7 @@ restart:
 void split_ptr_list_head(struct ptr_list *head)
 {
 	int old = head->nr, nr = old / 2;
-	struct ptr_list *newlist = __alloc_ptrlist(0);
+	struct ptr_list *newlist = alloc_ptrlist_block(false);
 	struct ptr_list *next = head->next;
 
 	old -= nr;
@@ -250,7 +295,6 @@ void split_ptr_list_head(struct ptr_list *head)
 	memset(head->list + old, 0xf0, nr * sizeof(void *));
 }
 
-int rl_ptrlist_hack;
 ///
 // add an entry to a ptrlist
 // @listp: a pointer to the list
@@ -266,13 +310,14 @@ void **__add_ptr_list(struct ptr_list **listp, void *ptr)
 	void **ret;
 	int nr;
 
-	if (!list || (nr = (last = list->prev)->nr) >= LIST_NODE_NR) {
+	if (list) {
+		last = list->prev;
+		nr = last->nr;
+	}
+	if (!list || nr >= PTR_LIST_NODE_NR(last)) {
 		struct ptr_list *newlist;
 
-		if (rl_ptrlist_hack)
-			newlist = __alloc_rl_ptrlist(0);
-		else
-			newlist = __alloc_ptrlist(0);
+		newlist = alloc_ptrlist_block(!list);
 		if (!list) {
 			newlist->next = newlist;
 			newlist->prev = newlist;
@@ -424,7 +469,7 @@ void * delete_ptr_list_last(struct ptr_list **head)
 		last->prev->next = first;
 		if (last == first)
 			*head = NULL;
-		__free_ptrlist(last);
+		free_ptrlist_block(last);
 	}
 	return ptr;
 }
@@ -470,9 +515,9 @@ void copy_ptr_list(struct ptr_list **listp, struct ptr_list *src)
 			void *ptr = cur->list[i++];
 			if (!ptr)
 				continue;
-			if (idx >= LIST_NODE_NR) {
+			if (idx >= PTR_LIST_NODE_NR(tail)) {
 				struct ptr_list *prev = tail;
-				tail = __alloc_ptrlist(0);
+				tail = alloc_ptrlist_block(false);
 				prev->next = tail;
 				tail->prev = prev;
 				prev->nr = idx;
@@ -482,7 +527,7 @@ void copy_ptr_list(struct ptr_list **listp, struct ptr_list *src)
 		}
 
 		next = cur->next;
-		__free_ptrlist(cur);
+		free_ptrlist_block(cur);
 		cur = next;
 	} while (cur != src);
 
@@ -510,7 +555,7 @@ void __free_ptr_list(struct ptr_list **listp)
 	while (list) {
 		tmp = list;
 		list = list->next;
-		__free_ptrlist(tmp);
+		free_ptrlist_block(tmp);
 	}
 
 	*listp = NULL;
@@ -16,11 +16,14 @@
 #define VRFY_PTR_LIST(head)		(void)(sizeof((head)->list[0]))
 
 #define LIST_NODE_NR (13)
+/* The first block of a short lived list only has room for a few entries */
+#define LIST_NODE_SMALL_NR (3)
 
 #define DECLARE_PTR_LIST(listname, type)	\
 	struct listname {			\
 		int nr:8;			\
 		int rm:8;			\
+		unsigned int small:1;		\
 		struct listname *prev;		\
 		struct listname *next;		\
 		type *list[LIST_NODE_NR];	\
@@ -28,6 +31,8 @@
 
 DECLARE_PTR_LIST(ptr_list, void);
 
+#define PTR_LIST_NODE_NR(list) ((list)->small ? LIST_NODE_SMALL_NR : LIST_NODE_NR)
+
 
 void * undo_ptr_list_last(struct ptr_list **head);
 void * delete_ptr_list_last(struct ptr_list **head);
@@ -264,7 +269,7 @@ extern void split_ptr_list_head(struct ptr_list *);
 
 #define DO_INSERT_CURRENT(new, __head, __list, __nr) do {		\
 	PTRLIST_TYPE(__head) *__this, *__last;				\
-	if (__list->nr == LIST_NODE_NR) {				\
+	if (__list->nr >= PTR_LIST_NODE_NR(__list)) {			\
 		split_ptr_list_head((struct ptr_list*)__list);		\
 		if (__nr >= __list->nr) {				\
 			__nr -= __list->nr;				\
@@ -1,6 +1,6 @@
 // SPDX-License-Identifier: MIT
 /*
- * Stupid implementation of pointer -> pointer map.
+ * Pointer -> pointer map, as an open-addressing hash table.
  *
  * Copyright (c) 2017 Luc Van Oostenryck.
  *
@@ -24,86 +24,101 @@
  */
 
 #include "ptrmap.h"
-#include "allocate.h"
+#include "lib.h"
+#include <stdlib.h>
 #include <stddef.h>
 
-#define	MAP_NR	7
+//
+// The size of the table is a power of two and it's kept at most half
+// full, so that the linear probing stays short.  Nothing is ever deleted.
+#define	MAP_MIN	8
 
 struct ptrpair {
 	void *key;
 	void *val;
 };
 struct ptrmap {
-	struct ptrmap *next;
-	int nr;
-	struct ptrpair pairs[MAP_NR];
+	unsigned int size;
+	unsigned int nr;
+	struct ptrpair pairs[];
 };
 
-DECLARE_ALLOCATOR(ptrmap);
-ALLOCATOR(ptrmap, "ptrmap");
+static inline unsigned int map_hash(struct ptrmap *map, void *key)
+{
+	unsigned long hash = hashval(key) >> 4;
 
-void __ptrmap_add(struct ptrmap **mapp, void *key, void *val)
+	hash ^= hash >> 16;
+	return hash & (map->size - 1);
+}
+
+static struct ptrpair *map_slot(struct ptrmap *map, void *key)
+{
+	unsigned int i = map_hash(map, key);
+
+	while (map->pairs[i].key && map->pairs[i].key != key)
+		i = (i + 1) & (map->size - 1);
+	return &map->pairs[i];
+}
+
+static struct ptrmap *alloc_map(unsigned int size)
 {
-	struct ptrmap *head = *mapp;
-	struct ptrmap *newmap;
 	struct ptrmap *map;
-	struct ptrpair *pair;
-	int nr;
-
-	if ((map = head)) {
-		struct ptrmap *next = map->next;
-		if (next)		// head is full
-			map = next;
-		if ((nr = map->nr) < MAP_NR)
-			goto oldmap;
-	}
 
-	// need a new block
-	newmap = __alloc_ptrmap(0);
-	if (!head) {
-		*mapp = newmap;
-	} else {
-		newmap->next = head->next;
-		head->next = newmap;
+	map = calloc(1, sizeof(*map) + size * sizeof(map->pairs[0]));
+	if (!map)
+		die("out of memory");
+	map->size = size;
+	return map;
+}
+
+static struct ptrmap *grow_map(struct ptrmap *old)
+{
+	struct ptrmap *map;
+	unsigned int i;
+
+	if (!old)
+		return alloc_map(MAP_MIN);
+	if ((old->nr + 1) * 2 <= old->size)
+		return old;
+
+	map = alloc_map(old->size * 2);
+	for (i = 0; i < old->size; i++) {
+		struct ptrpair *pair = &old->pairs[i];
+		if (pair->key)
+			*map_slot(map, pair->key) = *pair;
 	}
-	map = newmap;
-	nr = 0;
+	map->nr = old->nr;
+	free(old);
+	return map;
+}
 
-oldmap:
-	pair = &map->pairs[nr];
-	pair->key = key;
-	pair->val = val;
-	map->nr = ++nr;
+void __ptrmap_add(struct ptrmap **mapp, void *key, void *val)
+{
+	__ptrmap_update(mapp, key, val);
 }
 
 void *__ptrmap_lookup(struct ptrmap *map, void *key)
 {
-	for (; map; map = map->next) {
-		int i, n = map->nr;
-		for (i = 0; i < n; i++) {
-			struct ptrpair *pair = &map->pairs[i];
-			if (pair->key == key)
-				return pair->val;
-		}
-	}
-	return NULL;
+	if (!map)
+		return NULL;
+	return map_slot(map, key)->val;
 }
 
 void __ptrmap_update(struct ptrmap **mapp, void *key, void *val)
 {
-	struct ptrmap *map = *mapp;
-
-	for (; map; map = map->next) {
-		int i, n = map->nr;
-		for (i = 0; i < n; i++) {
-			struct ptrpair *pair = &map->pairs[i];
-			if (pair->key == key) {
-				if (pair->val != val)
-					pair->val = val;
-				return;
-			}
-		}
+	struct ptrpair *pair;
+
+	*mapp = grow_map(*mapp);
+	pair = map_slot(*mapp, key);
+	if (!pair->key) {
+		pair->key = key;
+		(*mapp)->nr++;
 	}
+	pair->val = val;
+}
 
-	__ptrmap_add(mapp, key, val);
+void __ptrmap_free(struct ptrmap **mapp)
+{
+	free(*mapp);
+	*mapp = NULL;
 }
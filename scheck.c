@@ -341,19 +341,19 @@ out:
 	return rc;
 }
 
-static void check_functions(struct symbol_list *list)
+static void check_symbol(struct symbol *sym)
 {
-	struct symbol *sym;
+	struct entrypoint *ep;
 
-	FOR_EACH_PTR(list, sym) {
-		struct entrypoint *ep;
+	ep = linearize_symbol(sym);
+	if (!ep || !ep->entry)
+		return;
+	check_function(ep);
+}
 
-		expand_symbol(sym);
-		ep = linearize_symbol(sym);
-		if (!ep || !ep->entry)
-			continue;
-		check_function(ep);
-	} END_FOR_EACH_PTR(sym);
+static void check_functions(struct symbol_list *list)
+{
+	process_symbols(list, check_symbol);
 }
 
 int main(int argc, char **argv)
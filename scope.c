@@ -102,11 +102,19 @@ void start_function_scope(struct position pos)
 
 static void remove_symbol_scope(struct symbol *sym)
 {
-	struct symbol **ptr = &sym->ident->symbols;
+	struct ident *ident = sym->ident;
+	struct symbol **ptr = &ident->symbols;
+	unsigned int mask = 0;
+	struct symbol *p;
 
-	while (*ptr != sym)
+	while (*ptr != sym) {
+		mask |= ns_mask_bits((*ptr)->namespace);
 		ptr = &(*ptr)->next_id;
+	}
 	*ptr = sym->next_id;
+	for (p = sym->next_id; p; p = p->next_id)
+		mask |= ns_mask_bits(p->namespace);
+	ident->ns_mask = mask;
 }
 
 static void end_scope(struct scope **s)
@@ -120,6 +128,7 @@ static void end_scope(struct scope **s)
 	FOR_EACH_PTR(symbols, sym) {
 		remove_symbol_scope(sym);
 	} END_FOR_EACH_PTR(sym);
+	free_ptr_list(&symbols);
 }
 
 void end_file_scope(void)
@@ -7,6 +7,8 @@
 #define _GNU_SOURCE
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include <unistd.h>
 #include <limits.h>
@@ -16,6 +18,7 @@
 #include <getopt.h>
 #include <ctype.h>
 #include <errno.h>
+#include <time.h>
 #include <sqlite3.h>
 
 #include "dissect.h"
@@ -37,6 +40,13 @@ static size_t n_cwd;
 // 'add' command options
 static struct string_list *semind_filelist = NULL;
 static int semind_include_local_syms = 0;
+static int semind_jobs = 1;
+static int semind_bulk = 0;	// files per transaction with --bulk
+static unsigned long semind_nr_records = 0;
+
+// in an 'add -j' worker, the pipe to the process which writes the index
+static int semind_worker = -1;
+static int semind_worker_fd = -1;
 
 struct semind_streams {
 	sqlite3_int64 id;
@@ -121,9 +131,12 @@ static void show_help_add(int ret)
 	    "Usage: %1$s add [options] [--] [compiler options] files...\n"
 	    "\n"
 	    "Utility creates or updates a symbol index.\n"
+	    "Files which have not changed since they were indexed are skipped.\n"
 	    "\n"
 	    "Options:\n"
 	    "  --include-local-syms   Include into the index local symbols;\n"
+	    "  -j, --jobs=N           Parse the files in N worker processes;\n"
+	    "  --bulk[=N]             Load a new index fast, N files per transaction;\n"
 	    "  -v, --verbose          Show information about what is being done;\n"
 	    "  -h, --help             Show this text and exit.\n"
 	    "\n"
@@ -294,6 +307,8 @@ static void parse_cmdline_add(int argc, char **argv)
 {
 	static const struct option long_options[] = {
 		{ "include-local-syms", no_argument, NULL, 1 },
+		{ "jobs", required_argument, NULL, 'j' },
+		{ "bulk", optional_argument, NULL, 2 },
 		{ "verbose", no_argument, NULL, 'v' },
 		{ "help", no_argument, NULL, 'h' },
 		{ NULL }
@@ -302,11 +317,21 @@ static void parse_cmdline_add(int argc, char **argv)
 
 	opterr = 0;
 
-	while ((c = getopt_long(argc, argv, "+vh", long_options, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "+j:vh", long_options, NULL)) != -1) {
 		switch (c) {
 			case 1:
 				semind_include_local_syms = 1;
 				break;
+			case 2:
+				semind_bulk = optarg ? atoi(optarg) : 100;
+				if (semind_bulk < 1)
+					semind_error(1, 0, "invalid number of files: %s", optarg);
+				break;
+			case 'j':
+				semind_jobs = atoi(optarg);
+				if (semind_jobs < 1)
+					semind_error(1, 0, "invalid number of jobs: %s", optarg);
+				break;
 			case 'v':
 				semind_verbose++;
 				break;
@@ -553,6 +578,12 @@ static void open_temp_database(void)
 		sqlite_command(database_schema[i]);
 }
 
+static const char *semind_index_schema[] = {
+	"CREATE UNIQUE INDEX IF NOT EXISTS semind_0 ON semind (symbol, kind, mode, file, line, column)",
+	"CREATE INDEX IF NOT EXISTS semind_1 ON semind (file)",
+	NULL,
+};
+
 static void open_database(const char *filename, int flags)
 {
 	static const char *database_schema[] = {
@@ -570,8 +601,6 @@ static void open_database(const char *filename, int flags)
 			" context TEXT,"
 			" mode INTEGER NOT NULL"
 		")",
-		"CREATE UNIQUE INDEX semind_0 ON semind (symbol, kind, mode, file, line, column)",
-		"CREATE INDEX semind_1 ON semind (file)",
 		NULL,
 	};
 
@@ -596,6 +625,33 @@ static void open_database(const char *filename, int flags)
 
 	for (int i = 0; database_schema[i]; i++)
 		sqlite_command(database_schema[i]);
+	for (int i = 0; semind_index_schema[i]; i++)
+		sqlite_command(semind_index_schema[i]);
+}
+
+/*
+ * With --bulk there is no journal and no indexes while the records are
+ * loaded.  The duplicates which semind_0 would have ignored are deleted
+ * before it's created again.  If the load is interrupted, running it again
+ * with --bulk puts the indexes back.
+ */
+static void bulk_load_start(void)
+{
+	sqlite_command("PRAGMA journal_mode = OFF");
+	sqlite_command("DROP INDEX IF EXISTS semind_0");
+	sqlite_command("DROP INDEX IF EXISTS semind_1");
+}
+
+static void bulk_load_finish(void)
+{
+	sqlite_command("BEGIN IMMEDIATE");
+	sqlite_command("DELETE FROM semind WHERE rowid NOT IN ("
+	               "SELECT min(rowid) FROM semind"
+	               " GROUP BY symbol, kind, mode, file, line, column)");
+	for (int i = 0; semind_index_schema[i]; i++)
+		sqlite_command(semind_index_schema[i]);
+	sqlite_command("COMMIT");
+	sqlite_command("PRAGMA journal_mode = WAL");
 }
 
 struct index_record {
@@ -613,8 +669,87 @@ struct index_record {
 	int col;
 };
 
+/*
+ * With 'add -j' the workers only parse.  They send the new streams and the
+ * records to the main process down one pipe and it does all the database
+ * work.  Each write to the pipe is one chunk of at most PIPE_BUF bytes so the
+ * chunks from the different workers don't get mixed up.
+ */
+struct semind_chunk {
+	int worker;
+	int len;
+};
+
+struct semind_msg {
+	int type;	/* 's' for a new stream, 'r' for a record, 'f' after a file */
+	int stream;
+	int kind;
+	unsigned int mode;
+	int line;
+	int col;
+	long long mtime;
+	int len1;	/* the file name or the context */
+	int len2;	/* the symbol */
+};
+
+#define SEMIND_CHUNK_MAX (PIPE_BUF - sizeof(struct semind_chunk))
+#define SEMIND_BATCH 50000
+
+static char semind_out[PIPE_BUF];
+static int semind_out_len;
+
+static void worker_flush(void)
+{
+	struct semind_chunk chunk = { semind_worker, semind_out_len };
+	char buf[PIPE_BUF];
+	size_t len = sizeof(chunk) + semind_out_len;
+
+	if (!semind_out_len)
+		return;
+
+	memcpy(buf, &chunk, sizeof(chunk));
+	memcpy(buf + sizeof(chunk), semind_out, semind_out_len);
+	semind_out_len = 0;
+
+	while (write(semind_worker_fd, buf, len) < 0) {
+		if (errno != EINTR)
+			semind_error(1, errno, "write");
+	}
+}
+
+static void worker_send(struct semind_msg *msg, const char *str1, const char *str2)
+{
+	size_t len = sizeof(*msg) + msg->len1 + msg->len2;
+
+	if (len > SEMIND_CHUNK_MAX)
+		semind_error(1, 0, "name too long: %.*s", msg->len1, str1);
+	if (semind_out_len + len > SEMIND_CHUNK_MAX)
+		worker_flush();
+
+	memcpy(semind_out + semind_out_len, msg, sizeof(*msg));
+	memcpy(semind_out + semind_out_len + sizeof(*msg), str1, msg->len1);
+	memcpy(semind_out + semind_out_len + sizeof(*msg) + msg->len1, str2, msg->len2);
+	semind_out_len += len;
+}
+
 static void insert_record(struct index_record *rec)
 {
+	if (semind_worker >= 0) {
+		struct semind_msg msg = {
+			.type   = 'r',
+			.stream = rec->file,
+			.kind   = rec->kind,
+			.mode   = rec->mode,
+			.line   = rec->line,
+			.col    = rec->col,
+			.len1   = rec->ctx_len,
+			.len2   = rec->sym_len,
+		};
+
+		worker_send(&msg, rec->context, rec->symbol);
+		return;
+	}
+
 	sqlite_bind_text(insert_rec_stmt,  "@context", rec->context, rec->ctx_len);
 	sqlite_bind_text(insert_rec_stmt,  "@symbol",  rec->symbol, rec->sym_len);
 	sqlite_bind_int64(insert_rec_stmt, "@kind",    rec->kind);
@@ -624,6 +759,62 @@ static void insert_record(struct index_record *rec)
 	sqlite_bind_int64(insert_rec_stmt, "@column",  rec->col);
 	sqlite_run(insert_rec_stmt);
 	sqlite_reset_stmt(insert_rec_stmt);
+	semind_nr_records++;
+}
+
+/*
+ * Returns the file name relative to the project directory and its mtime, or
+ * NULL if the file is outside of the project.
+ */
+static const char *project_file(const char *name, char *fullname, sqlite3_int64 *mtime)
+{
+	struct stat st;
+
+	/*
+	 * FIXME: Files in the input_streams may be duplicated.
+	 */
+	if (stat(name, &st) < 0)
+		semind_error(1, errno, "stat: %s", name);
+
+	*mtime = st.st_mtime;
+
+	if (!realpath(name, fullname))
+		semind_error(1, errno, "realpath: %s", name);
+
+	if (!strncmp(fullname, cwd, n_cwd) && fullname[n_cwd] == '/')
+		return fullname + n_cwd + 1;
+	return NULL;
+}
+
+// The caller holds the lock.
+static sqlite3_int64 get_file_id(const char *filename, int len, sqlite3_int64 cur_mtime)
+{
+	sqlite_bind_text(select_file_stmt, "@name", filename, len);
+
+	if (sqlite_run(select_file_stmt) == SQLITE_ROW) {
+		sqlite3_int64 id, old_mtime;
+
+		id = sqlite3_column_int64(select_file_stmt, 0);
+		old_mtime = sqlite3_column_int64(select_file_stmt, 1);
+
+		sqlite_reset_stmt(select_file_stmt);
+
+		if (cur_mtime == old_mtime)
+			return id;
+
+		sqlite_bind_text(delete_file_stmt, "@name", filename, len);
+		sqlite_run(delete_file_stmt);
+		sqlite_reset_stmt(delete_file_stmt);
+	}
+
+	sqlite_reset_stmt(select_file_stmt);
+
+	sqlite_bind_text(insert_file_stmt,  "@name",  filename, len);
+	sqlite_bind_int64(insert_file_stmt, "@mtime", cur_mtime);
+	sqlite_run(insert_file_stmt);
+	sqlite_reset_stmt(insert_file_stmt);
+
+	return sqlite3_last_insert_rowid(semind_db);
 }
 
 static void update_stream(void)
@@ -635,70 +826,46 @@ static void update_stream(void)
 	if (!semind_streams)
 		semind_error(1, errno, "realloc");
 
-	sqlite_run(lock_stmt);
+	// with --bulk the transaction is already open
+	if (semind_worker < 0 && !semind_bulk)
+		sqlite_run(lock_stmt);
 
 	for (int i = semind_streams_nr; i < input_stream_nr; i++) {
-		struct stat st;
 		const char *filename;
 		char fullname[PATH_MAX];
 		sqlite3_int64 cur_mtime = 0;
 
-		if (input_streams[i].fd != -1) {
-			/*
-			 * FIXME: Files in the input_streams may be duplicated.
-			 */
-			if (stat(input_streams[i].name, &st) < 0)
-				semind_error(1, errno, "stat: %s", input_streams[i].name);
-
-			cur_mtime = st.st_mtime;
+		semind_streams[i].id = -1;
 
-			if (!realpath(input_streams[i].name, fullname))
-				semind_error(1, errno, "realpath: %s", input_streams[i].name);
+		if (input_streams[i].fd == -1)
+			continue;
 
-			if (!strncmp(fullname, cwd, n_cwd) && fullname[n_cwd] == '/') {
-				filename = fullname + n_cwd + 1;
-				semind_streams[i].id = 0;
-			} else {
-				semind_streams[i].id = -1;
-				continue;
-			}
-		} else {
-			semind_streams[i].id = -1;
+		filename = project_file(input_streams[i].name, fullname, &cur_mtime);
+		if (!filename)
 			continue;
-		}
 
 		if (semind_verbose > 1)
 			message("filename: %s", filename);
 
-		sqlite_bind_text(select_file_stmt, "@name", filename, -1);
-
-		if (sqlite_run(select_file_stmt) == SQLITE_ROW) {
-			sqlite3_int64 old_mtime;
-
-			semind_streams[i].id = sqlite3_column_int64(select_file_stmt, 0);
-			old_mtime = sqlite3_column_int64(select_file_stmt, 1);
-
-			sqlite_reset_stmt(select_file_stmt);
-
-			if (cur_mtime == old_mtime)
-				continue;
-
-			sqlite_bind_text(delete_file_stmt, "@name", filename, -1);
-			sqlite_run(delete_file_stmt);
-			sqlite_reset_stmt(delete_file_stmt);
+		if (semind_worker >= 0) {
+			// the main process maps the stream number to the file id
+			struct semind_msg msg = {
+				.type   = 's',
+				.stream = i,
+				.mtime  = cur_mtime,
+				.len1   = strlen(filename),
+			};
+
+			worker_send(&msg, filename, "");
+			semind_streams[i].id = i;
+			continue;
 		}
 
-		sqlite_reset_stmt(select_file_stmt);
-
-		sqlite_bind_text(insert_file_stmt,  "@name",  filename, -1);
-		sqlite_bind_int64(insert_file_stmt, "@mtime", cur_mtime);
-		sqlite_run(insert_file_stmt);
-		sqlite_reset_stmt(insert_file_stmt);
-
-		semind_streams[i].id = sqlite3_last_insert_rowid(semind_db);
+		semind_streams[i].id = get_file_id(filename, -1, cur_mtime);
 	}
 
-	sqlite_run(unlock_stmt);
+	if (semind_worker < 0 && !semind_bulk)
+		sqlite_run(unlock_stmt);
 
 	semind_streams_nr = input_stream_nr;
 }
@@ -787,16 +954,255 @@ static void r_memdef(struct symbol *sym, struct symbol *mem)
 	r_member(U_DEF, &mem->pos, sym, mem);
 }
 
+static struct reporter semind_reporter = {
+	.r_symdef = r_symdef,
+	.r_symbol = r_symbol,
+	.r_memdef = r_memdef,
+	.r_member = r_member,
+};
+
+static int file_is_unchanged(const char *name)
+{
+	const char *filename;
+	char fullname[PATH_MAX];
+	sqlite3_int64 mtime;
+	int ret = 0;
+
+	// sparse reports the missing files
+	if (access(name, F_OK))
+		return 0;
+
+	filename = project_file(name, fullname, &mtime);
+	if (!filename)
+		return 0;
+
+	sqlite_bind_text(select_file_stmt, "@name", filename, -1);
+	if (sqlite_run(select_file_stmt) == SQLITE_ROW)
+		ret = sqlite3_column_int64(select_file_stmt, 1) == mtime;
+	sqlite_reset_stmt(select_file_stmt);
+
+	return ret;
+}
+
+static void run_worker(char **files, int nr_files, int *next)
+{
+	int i;
+
+	while ((i = __atomic_fetch_add(next, 1, __ATOMIC_RELAXED)) < nr_files) {
+		struct string_list *one = NULL;
+
+		struct semind_msg msg = { .type = 'f' };
+
+		add_ptr_list(&one, files[i]);
+		dissect(&semind_reporter, one);
+		free_ptr_list(&one);
+
+		worker_send(&msg, "", "");
+	}
+
+	worker_flush();
+}
+
+static void read_workers(int fd, int nr_workers)
+{
+	struct semind_chunk chunk;
+	struct index_record rec;
+	char buf[PIPE_BUF];
+	sqlite3_int64 **ids;
+	int *nr_ids;
+	int nr_records = 0;
+	int nr_files = 0;
+	FILE *in;
+
+	ids = calloc(nr_workers, sizeof(*ids));
+	nr_ids = calloc(nr_workers, sizeof(*nr_ids));
+	in = fdopen(fd, "r");
+	if (!ids || !nr_ids || !in)
+		semind_error(1, errno, "unable to read from the workers");
+
+	sqlite_run(lock_stmt);
+
+	while (fread(&chunk, sizeof(chunk), 1, in) == 1) {
+		int w = chunk.worker;
+
+		if (w < 0 || w >= nr_workers || chunk.len < 0 || chunk.len > SEMIND_CHUNK_MAX ||
+		    fread(buf, chunk.len, 1, in) != 1)
+			semind_error(1, 0, "bad data from a worker");
+
+		for (int pos = 0; pos < chunk.len;) {
+			struct semind_msg msg;
+			char *str = buf + pos + sizeof(msg);
+
+			memcpy(&msg, buf + pos, sizeof(msg));
+			pos += sizeof(msg) + msg.len1 + msg.len2;
+
+			if (msg.type == 's') {
+				if (msg.stream >= nr_ids[w]) {
+					int nr = msg.stream + 64;
+
+					ids[w] = realloc(ids[w], nr * sizeof(**ids));
+					if (!ids[w])
+						semind_error(1, errno, "realloc");
+					nr_ids[w] = nr;
+				}
+				ids[w][msg.stream] = get_file_id(str, msg.len1, msg.mtime);
+				continue;
+			}
+
+			if (msg.type == 'f') {
+				if (semind_bulk && ++nr_files == semind_bulk) {
+					sqlite_run(unlock_stmt);
+					sqlite_run(lock_stmt);
+					nr_files = 0;
+				}
+				continue;
+			}
+
+			rec.context = str;
+			rec.ctx_len = msg.len1;
+			rec.symbol  = str + msg.len1;
+			rec.sym_len = msg.len2;
+			rec.kind    = msg.kind;
+			rec.mode    = msg.mode;
+			rec.file    = ids[w][msg.stream];
+			rec.line    = msg.line;
+			rec.col     = msg.col;
+
+			insert_record(&rec);
+
+			if (!semind_bulk && ++nr_records == SEMIND_BATCH) {
+				sqlite_run(unlock_stmt);
+				sqlite_run(lock_stmt);
+				nr_records = 0;
+			}
+		}
+	}
+
+	sqlite_run(unlock_stmt);
+
+	fclose(in);
+	for (int w = 0; w < nr_workers; w++)
+		free(ids[w]);
+	free(ids);
+	free(nr_ids);
+}
+
+/*
+ * The workers take the next file from a counter they share so that one slow
+ * file doesn't hold up the rest of the list.
+ */
+static void add_parallel(struct string_list *filelist)
+{
+	int nr_files = ptr_list_size((struct ptr_list *)filelist);
+	int nr_workers = semind_jobs < nr_files ? semind_jobs : nr_files;
+	int failed = 0;
+	char **files;
+	char *file;
+	pid_t *pids;
+	int *next;
+	int fds[2];
+	int i = 0;
+
+	if (!nr_files)
+		return;
+
+	files = malloc(nr_files * sizeof(*files));
+	pids = malloc(nr_workers * sizeof(*pids));
+	if (!files || !pids)
+		semind_error(1, errno, "malloc");
+
+	FOR_EACH_PTR(filelist, file) {
+		files[i++] = file;
+	} END_FOR_EACH_PTR(file);
+
+	next = mmap(NULL, sizeof(*next), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (next == MAP_FAILED)
+		semind_error(1, errno, "mmap");
+	*next = 0;
+
+	if (pipe(fds) < 0)
+		semind_error(1, errno, "pipe");
+
+	fflush(stdout);
+	fflush(stderr);
+
+	for (int w = 0; w < nr_workers; w++) {
+		pids[w] = fork();
+		if (pids[w] < 0)
+			semind_error(1, errno, "fork");
+		if (!pids[w]) {
+			close(fds[0]);
+			semind_worker = w;
+			semind_worker_fd = fds[1];
+			run_worker(files, nr_files, next);
+			_exit(0);
+		}
+	}
+	close(fds[1]);
+
+	read_workers(fds[0], nr_workers);
+
+	for (int w = 0; w < nr_workers; w++) {
+		int status;
+
+		if (waitpid(pids[w], &status, 0) < 0 ||
+		    !WIFEXITED(status) || WEXITSTATUS(status))
+			failed = 1;
+	}
+
+	munmap(next, sizeof(*next));
+	free(pids);
+	free(files);
+
+	if (failed)
+		semind_error(1, 0, "a worker failed");
+}
+
+static void add_bulk(struct string_list *filelist)
+{
+	char *file;
+	int nr = 0;
+
+	sqlite_run(lock_stmt);
+
+	FOR_EACH_PTR(filelist, file) {
+		struct string_list *one = NULL;
+
+		add_ptr_list(&one, file);
+		dissect(&semind_reporter, one);
+		free_ptr_list(&one);
+
+		if (++nr == semind_bulk) {
+			sqlite_run(unlock_stmt);
+			sqlite_run(lock_stmt);
+			nr = 0;
+		}
+	} END_FOR_EACH_PTR(file);
+
+	sqlite_run(unlock_stmt);
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
 static void command_add(int argc, char **argv)
 {
-	static struct reporter reporter = {
-		.r_symdef = r_symdef,
-		.r_symbol = r_symbol,
-		.r_memdef = r_memdef,
-		.r_member = r_member,
-	};
+	struct string_list *filelist = NULL;
+	struct timespec start;
+	double secs;
+	char *file;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
 
-	open_temp_database();
+	if (semind_bulk)
+		bulk_load_start();
+	else if (semind_jobs == 1)
+		open_temp_database();
 
 	sqlite_prepare_persistent(
 		"BEGIN IMMEDIATE",
@@ -806,11 +1212,19 @@ static void command_add(int argc, char **argv)
 		"COMMIT",
 		&unlock_stmt);
 
-	sqlite_prepare_persistent(
-		"INSERT OR IGNORE INTO tempdb.semind "
-		"(context, symbol, kind, mode, file, line, column) "
-		"VALUES (@context, @symbol, @kind, @mode, @file, @line, @column)",
-		&insert_rec_stmt);
+	// the workers' and --bulk records are written straight into the index
+	if (semind_jobs > 1 || semind_bulk)
+		sqlite_prepare_persistent(
+			"INSERT OR IGNORE INTO semind "
+			"(context, symbol, kind, mode, file, line, column) "
+			"VALUES (@context, @symbol, @kind, @mode, @file, @line, @column)",
+			&insert_rec_stmt);
+	else
+		sqlite_prepare_persistent(
+			"INSERT OR IGNORE INTO tempdb.semind "
+			"(context, symbol, kind, mode, file, line, column) "
+			"VALUES (@context, @symbol, @kind, @mode, @file, @line, @column)",
+			&insert_rec_stmt);
 
 	sqlite_prepare_persistent(
 		"SELECT id, mtime FROM file WHERE name == @name",
@@ -824,11 +1238,26 @@ static void command_add(int argc, char **argv)
 		"DELETE FROM file WHERE name == @name",
 		&delete_file_stmt);
 
-	dissect(&reporter, semind_filelist);
-
-	sqlite_run(lock_stmt);
-	sqlite_command("INSERT OR IGNORE INTO semind SELECT * FROM tempdb.semind");
-	sqlite_run(unlock_stmt);
+	FOR_EACH_PTR(semind_filelist, file) {
+		if (file_is_unchanged(file)) {
+			if (semind_verbose)
+				message("unchanged: %s", file);
+			continue;
+		}
+		add_ptr_list(&filelist, file);
+	} END_FOR_EACH_PTR(file);
+
+	if (semind_jobs > 1) {
+		add_parallel(filelist);
+	} else if (semind_bulk) {
+		add_bulk(filelist);
+	} else {
+		dissect(&semind_reporter, filelist);
+
+		sqlite_run(lock_stmt);
+		sqlite_command("INSERT OR IGNORE INTO semind SELECT * FROM tempdb.semind");
+		sqlite_run(unlock_stmt);
+	}
 
 	sqlite3_finalize(insert_rec_stmt);
 	sqlite3_finalize(select_file_stmt);
@@ -837,6 +1266,17 @@ static void command_add(int argc, char **argv)
 	sqlite3_finalize(lock_stmt);
 	sqlite3_finalize(unlock_stmt);
 	free(semind_streams);
+
+	if (semind_bulk)
+		bulk_load_finish();
+
+	if (semind_verbose) {
+		secs = elapsed(&start);
+		message("%lu records from %d files in %.2fs (%.0f records/s)",
+		        semind_nr_records, ptr_list_size((struct ptr_list *)filelist),
+		        secs, secs > 0 ? semind_nr_records / secs : 0.0);
+	}
+	free_ptr_list(&filelist);
 }
 
 static void command_rm(int argc, char **argv)
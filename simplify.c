@@ -273,6 +273,8 @@ static inline void rem_usage(pseudo_t p, pseudo_t *usep, int kill)
 		delete_pseudo_user_list_entry(&p->users, usep, 1);
 		if (kill && !p->users && has_definition(p))
 			kill_instruction(p->def);
+		else if (optimizing)
+			requeue_users(p);
 	}
 }
 
@@ -0,0 +1,294 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * Micro benchmarks for the data structures under Smatch.  This links
+ * against all the Smatch objects and sets things up the same way as smatch
+ * does, but then runs the benchmarks instead of parsing anything.
+ *
+ *   sm_bench [--sizes=10,100,1000] [--time=<ms>] [<benchmark>...]
+ *
+ * Each benchmark runs for at least --time ms (default 200) at each size and
+ * prints the fastest run in ns per operation.  Everything is freed between
+ * runs the same way it is at the end of a function.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "smatch.h"
+#include "smatch_slist.h"
+#include "smatch_extra.h"
+
+static int time_ms = 200;
+
+static char **names;
+static int nr_names;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the variable names look like the ones Smatch makes */
+static void make_names(int size)
+{
+	char buf[64];
+	int i;
+
+	if (size <= nr_names)
+		return;
+	names = realloc(names, size * sizeof(*names));
+	for (i = nr_names; i < size; i++) {
+		snprintf(buf, sizeof(buf), "$->member%d->field%d", i / 7, i % 7);
+		names[i] = strdup(buf);
+	}
+	nr_names = size;
+}
+
+static struct smatch_state *num_state(int i, int salt)
+{
+	sval_t min = sval_type_val(&int_ctype, i * 10);
+	sval_t max = sval_type_val(&int_ctype, i * 10 + (i + salt) % 8);
+
+	return alloc_estate_rl(alloc_rl(min, max));
+}
+
+static struct stree *fill_stree(int size, int salt)
+{
+	struct stree *stree = NULL;
+	int i;
+
+	for (i = 0; i < size; i++)
+		set_state_stree(&stree, SMATCH_EXTRA, alloc_sname(names[i]), NULL,
+				num_state(i, salt));
+	return stree;
+}
+
+static unsigned long bench_stree_insert(int size)
+{
+	struct stree *stree;
+
+	stree = fill_stree(size, 0);
+	free_stree(&stree);
+	return size;
+}
+
+static unsigned long bench_stree_lookup(int size)
+{
+	struct stree *stree;
+	int i, j;
+
+	stree = fill_stree(size, 0);
+	for (j = 0; j < 10; j++) {
+		for (i = 0; i < size; i++) {
+			if (!get_state_stree(stree, SMATCH_EXTRA, names[i], NULL))
+				sm_fatal("sm_bench: lost '%s'", names[i]);
+		}
+	}
+	free_stree(&stree);
+	return size * 10;
+}
+
+/* half the states are the same on both sides, half have to be merged */
+static unsigned long bench_stree_merge(int size)
+{
+	struct stree *one, *two;
+	int i;
+
+	one = fill_stree(size, 0);
+	two = clone_stree(one);
+	for (i = 0; i < size; i += 2)
+		set_state_stree(&two, SMATCH_EXTRA, alloc_sname(names[i]), NULL,
+				num_state(i, 3));
+	merge_stree(&one, two);
+	free_stree(&one);
+	free_stree(&two);
+	return size;
+}
+
+/* "size" ranges like 0-3,10-15,20-22 */
+static struct range_list *make_rl(int size, int offset)
+{
+	struct range_list *rl = NULL;
+	int i;
+
+	for (i = 0; i < size; i++)
+		add_range(&rl, sval_type_val(&int_ctype, i * 10 + offset),
+			  sval_type_val(&int_ctype, i * 10 + offset + i % 5));
+	return rl;
+}
+
+static unsigned long bench_rl_union(int size)
+{
+	struct range_list *one = make_rl(size, 0);
+	struct range_list *two = make_rl(size, 4);
+	int i;
+
+	for (i = 0; i < 10; i++)
+		rl_union(one, two);
+	return 10;
+}
+
+static unsigned long bench_rl_intersection(int size)
+{
+	struct range_list *one = make_rl(size, 0);
+	struct range_list *two = make_rl(size, 4);
+	int i;
+
+	for (i = 0; i < 10; i++)
+		rl_intersection(one, two);
+	return 10;
+}
+
+static unsigned long bench_rl_binop(int size)
+{
+	struct range_list *one = make_rl(size, 0);
+	struct range_list *two = make_rl(size, 4);
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		rl_binop(one, '+', two);
+		rl_binop(one, '&', two);
+	}
+	return 20;
+}
+
+static unsigned long bench_str_to_rl(int size)
+{
+	struct range_list *rl;
+	char *str;
+	int i;
+
+	str = strdup(show_rl(make_rl(size, 0)));
+	for (i = 0; i < 10; i++)
+		str_to_rl(&int_ctype, str, &rl);
+	free(str);
+	return 10;
+}
+
+static unsigned long bench_alloc_sname(int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		alloc_sname(names[i]);
+	return size;
+}
+
+static struct bench {
+	const char *name;
+	unsigned long (*fn)(int size);
+} benches[] = {
+	{ "stree_insert", bench_stree_insert },
+	{ "stree_lookup", bench_stree_lookup },
+	{ "stree_merge", bench_stree_merge },
+	{ "rl_union", bench_rl_union },
+	{ "rl_intersection", bench_rl_intersection },
+	{ "rl_binop", bench_rl_binop },
+	{ "str_to_rl", bench_str_to_rl },
+	{ "alloc_sname", bench_alloc_sname },
+};
+
+static void free_everything(void)
+{
+	free_every_single_sm_state();
+	free_data_info_allocs();
+}
+
+static void run_bench(struct bench *bench, int size)
+{
+	unsigned long long start, stop, end, best = 0;
+	unsigned long ops = 0;
+	int runs = 0;
+
+	make_names(size);
+	end = now_ns() + time_ms * 1000000ULL;
+	do {
+		start = now_ns();
+		ops = bench->fn(size);
+		stop = now_ns();
+		free_everything();
+		if (!best || stop - start < best)
+			best = stop - start;
+		runs++;
+	} while (stop < end);
+
+	printf("%-16s %8d %8d %12.1f\n", bench->name, size, runs,
+	       (double)best / ops);
+}
+
+static int parse_sizes(char *str, int *sizes, int max)
+{
+	int nr = 0;
+
+	while (*str && nr < max) {
+		sizes[nr++] = strtol(str, &str, 10);
+		if (*str == ',')
+			str++;
+	}
+	return nr;
+}
+
+int main(int argc, char **argv)
+{
+	char *sparse_argv[] = { argv[0], NULL };
+	struct string_list *filelist = NULL;
+	int sizes[16] = { 10, 100, 1000 };
+	int nr_sizes = 3;
+	bool found;
+	int i, j, k;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strncmp(argv[i], "--sizes=", 8)) {
+			nr_sizes = parse_sizes(argv[i] + 8, sizes, ARRAY_SIZE(sizes));
+		} else if (!strncmp(argv[i], "--time=", 7)) {
+			time_ms = atoi(argv[i] + 7);
+		} else {
+			printf("Usage: sm_bench [--sizes=10,100,1000] [--time=<ms>] [<benchmark>...]\n");
+			printf("benchmarks:");
+			for (j = 0; j < ARRAY_SIZE(benches); j++)
+				printf(" %s", benches[j].name);
+			printf("\n");
+			return 1;
+		}
+	}
+
+	sm_outfd = stdout;
+	sql_outfd = stdout;
+	caller_info_fd = stdout;
+	option_no_db = 1;
+	smatch_initialize(1, sparse_argv, &filelist);
+	final_pass = 0;
+
+	printf("%-16s %8s %8s %12s\n", "benchmark", "size", "runs", "ns/op");
+	for (j = 0; j < ARRAY_SIZE(benches); j++) {
+		found = i == argc;
+		for (k = i; k < argc; k++) {
+			if (!strcmp(argv[k], benches[j].name))
+				found = true;
+		}
+		if (!found)
+			continue;
+		for (k = 0; k < nr_sizes; k++)
+			run_bench(&benches[j], sizes[k]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,663 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * This is cgcc in C.  A kernel build with CC=cgcc starts cgcc for every
+ * file and cgcc is a Perl script which runs the compiler three times to
+ * find the target, the gcc base dir and the multiarch dir.  sm_cgcc takes
+ * the same options and builds the same command lines, but it asks the
+ * compiler once and saves the answers in
+ * $XDG_CACHE_HOME/smatch/cgcc-<hash> (or ~/.cache/smatch/).  The hash is
+ * of $REAL_CC and the inode, size and mtime of the compiler binary, so a
+ * new compiler gets asked again.  Set SM_CGCC_NO_CACHE to skip the cache.
+ *
+ * The commands are still run with "sh -c" the same way Perl runs them,
+ * so the quoting works the same.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <regex.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct buf {
+	char *str;
+	size_t len, size;
+};
+
+static const char *progname;
+
+static struct buf cc, check;
+static const char *ccom;
+
+static void die(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	exit(1);
+}
+
+static void append(struct buf *buf, const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+
+	if (buf->len + len + 1 > buf->size) {
+		buf->size = (buf->len + len + 1) * 2;
+		buf->str = realloc(buf->str, buf->size);
+		if (!buf->str)
+			die("%s: out of memory\n", progname);
+	}
+
+	va_start(args, fmt);
+	vsnprintf(buf->str + buf->len, buf->size - buf->len, fmt, args);
+	va_end(args);
+	buf->len += len;
+}
+
+static bool match(const char *pattern, const char *str, int flags)
+{
+	regex_t re;
+	bool ret;
+
+	if (regcomp(&re, pattern, REG_EXTENDED | REG_NOSUB | flags))
+		die("%s: bad regex '%s'\n", progname, pattern);
+	ret = regexec(&re, str, 0, NULL, 0) == 0;
+	regfree(&re);
+	return ret;
+}
+
+/* Check if an option is for "check" only. */
+static bool check_only_option(const char *arg)
+{
+	if (arg[0] != '-')
+		return false;
+	if (match("^-W(no-?)?(address-space|bitwise|cast-to-as|cast-truncate|constant-suffix|context|decl|default-bitfield-sign|designated-init|do-while|enum-mismatch|external-function-has-definition|init-cstring|memcpy-max-count|non-pointer-null|old-initializer|one-bit-signed-bitfield|override-init-all|paren-string|ptr-subtraction-blows|return-void|sizeof-bool|sparse-all|sparse-error|transparent-union|typesign|undef|unknown-attribute)$", arg, 0))
+		return true;
+	if (match("^-v(no-?)?(entry|dead)$", arg, 0))
+		return true;
+	if (match("^-f(dump-ir|memcpy-max-count|diagnostic-prefix)(=[^[:space:]]*)?$", arg, 0))
+		return true;
+	if (match("^-f(mem2reg|optim)(-enable|-disable|=last)?$", arg, 0))
+		return true;
+	if (match("^-msize-(long|llp64)$", arg, 0))
+		return true;
+	return false;
+}
+
+/* Simple arg-quoting function.  Just adds backslashes when needed. */
+static void quote_arg(struct buf *buf, const char *arg)
+{
+	const char *p;
+
+	if (!arg[0]) {
+		append(buf, "''");
+		return;
+	}
+	for (p = arg; *p; p++) {
+		if (isalnum((unsigned char)*p) || strchr("-._/,=", *p))
+			append(buf, "%c", *p);
+		else
+			append(buf, "\\%c", *p);
+	}
+}
+
+struct float_constants {
+	int mant_bits;
+	/* sorted by name the same as cgcc */
+	const char *denorm_min, *epsilon, *max, *min;
+};
+
+static const struct float_constants float_constants[] = {
+	{ 24, "1.40129846e-45", "1.19209290e-7", "3.40282347e+38", "1.17549435e-38" },
+	{ 53, "4.9406564584124654e-324", "2.2204460492503131e-16",
+	  "1.7976931348623157e+308", "2.2250738585072014e-308" },
+	{ 64, "3.64519953188247460253e-4951", "1.08420217248550443401e-19",
+	  "1.18973149535723176502e+4932", "3.36210314311209350626e-4932" },
+	{ 113, "6.47517511943802511092443895822764655e-4966",
+	  "1.92592994438723585305597794258492732e-34",
+	  "1.18973149535723176508575932662800702e+4932",
+	  "3.36210314311209350626267781732175260e-4932" },
+};
+
+static void float_types(struct buf *buf, int has_inf, int has_qnan, int dec_dig,
+			int flt_mant, int flt_exp, int dbl_mant, int dbl_exp,
+			int ldbl_mant, int ldbl_exp)
+{
+	const char *names[] = { "FLT", "DBL", "LDBL" };
+	const char *suffixes[] = { "F", "", "L" };
+	int mant[] = { flt_mant, dbl_mant, ldbl_mant };
+	int exp[] = { flt_exp, dbl_exp, ldbl_exp };
+	const struct float_constants *h;
+	int mant_dig, max_exp, min_exp, max_10_exp, min_10_exp;
+	int i, j;
+
+	append(buf, " -D__FLT_RADIX__=2");
+	append(buf, " -D__FINITE_MATH_ONLY__=%d", has_inf || has_qnan ? 0 : 1);
+	append(buf, " -D__DECIMAL_DIG__=%d", dec_dig);
+
+	for (i = 0; i < 3; i++) {
+		h = NULL;
+		for (j = 0; j < sizeof(float_constants) / sizeof(float_constants[0]); j++) {
+			if (float_constants[j].mant_bits == mant[i])
+				h = &float_constants[j];
+		}
+		if (!h)
+			die("%s: weird number of mantissa bits.\n", progname);
+
+		mant_dig = (int)((mant[i] - 1) * log(2) / log(10));
+		max_exp = 1 << (exp[i] - 1);
+		min_exp = 3 - max_exp;
+		max_10_exp = (int)(max_exp * log(2) / log(10));
+		min_10_exp = -(int)(-min_exp * log(2) / log(10));
+
+		append(buf, " -D__%s_MANT_DIG__=%d", names[i], mant[i]);
+		append(buf, " -D__%s_DIG__=%d", names[i], mant_dig);
+		append(buf, " -D__%s_MIN_EXP__='(%d)'", names[i], min_exp);
+		append(buf, " -D__%s_MAX_EXP__=%d", names[i], max_exp);
+		append(buf, " -D__%s_MIN_10_EXP__='(%d)'", names[i], min_10_exp);
+		append(buf, " -D__%s_MAX_10_EXP__=%d", names[i], max_10_exp);
+		append(buf, " -D__%s_HAS_INFINITY__=%d", names[i], has_inf ? 1 : 0);
+		append(buf, " -D__%s_HAS_QUIET_NAN__=%d", names[i], has_qnan ? 1 : 0);
+
+		append(buf, " -D__%s_DENORM_MIN__=%s%s", names[i], h->denorm_min, suffixes[i]);
+		append(buf, " -D__%s_EPSILON__=%s%s", names[i], h->epsilon, suffixes[i]);
+		append(buf, " -D__%s_MAX__=%s%s", names[i], h->max, suffixes[i]);
+		append(buf, " -D__%s_MIN__=%s%s", names[i], h->min, suffixes[i]);
+	}
+}
+
+/*
+ * The answers from the compiler.  These are what cgcc gets from
+ * "$cc -dumpmachine", "$cc -print-file-name=" and "$cc -print-multiarch".
+ */
+static char *machine, *base_dir, *multiarch;
+
+static char *run_ccom(const char *opt)
+{
+	struct buf cmd = {};
+	struct buf out = {};
+	char line[4096];
+	FILE *p;
+
+	append(&cmd, "%s %s", ccom, opt);
+	append(&out, "%s", "");
+	p = popen(cmd.str, "r");
+	if (p) {
+		while (fgets(line, sizeof(line), p))
+			append(&out, "%s", line);
+		pclose(p);
+	}
+	free(cmd.str);
+
+	/* chomp */
+	if (out.len && out.str[out.len - 1] == '\n')
+		out.str[--out.len] = '\0';
+	return out.str;
+}
+
+static bool find_ccom_binary(struct stat *st)
+{
+	char name[4096], path[4096];
+	const char *env, *start, *end;
+	size_t len;
+
+	len = strcspn(ccom, " \t");
+	if (len == 0 || len >= sizeof(name))
+		return false;
+	memcpy(name, ccom, len);
+	name[len] = '\0';
+
+	if (strchr(name, '/'))
+		return stat(name, st) == 0;
+
+	env = getenv("PATH");
+	if (!env)
+		return false;
+	for (start = env; ; start = end + 1) {
+		end = strchr(start, ':');
+		if (!end)
+			end = start + strlen(start);
+		if (end == start)
+			len = snprintf(path, sizeof(path), "./%s", name);
+		else
+			len = snprintf(path, sizeof(path), "%.*s/%s",
+				       (int)(end - start), start, name);
+		if (len < sizeof(path) && access(path, X_OK) == 0 &&
+		    stat(path, st) == 0)
+			return true;
+		if (!*end)
+			return false;
+	}
+}
+
+static bool get_cache_name(char *buf, int size)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const char *dir, *home, *p;
+	char key[512];
+	struct stat st;
+
+	if (getenv("SM_CGCC_NO_CACHE"))
+		return false;
+	if (!find_ccom_binary(&st))
+		return false;
+
+	snprintf(key, sizeof(key), "%llu %llu %lld %lld",
+		 (unsigned long long)st.st_dev, (unsigned long long)st.st_ino,
+		 (long long)st.st_size, (long long)st.st_mtime);
+	for (p = ccom; *p; p++)
+		hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+	for (p = key; *p; p++)
+		hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir && dir[0]) {
+		snprintf(buf, size, "%s/smatch", dir);
+	} else {
+		home = getenv("HOME");
+		if (!home || !home[0])
+			return false;
+		snprintf(buf, size, "%s/.cache", home);
+		mkdir(buf, 0755);
+		snprintf(buf, size, "%s/.cache/smatch", home);
+	}
+	mkdir(buf, 0755);
+	snprintf(buf + strlen(buf), size - strlen(buf), "/cgcc-%016llx", hash);
+	return true;
+}
+
+static char *read_line(FILE *f)
+{
+	char line[4096];
+	size_t len;
+
+	if (!fgets(line, sizeof(line), f))
+		return NULL;
+	len = strlen(line);
+	if (len && line[len - 1] == '\n')
+		line[len - 1] = '\0';
+	return strdup(line);
+}
+
+static void load_compiler_info(void)
+{
+	char name[4096], tmp[4200];
+	FILE *f;
+
+	if (machine)
+		return;
+
+	if (get_cache_name(name, sizeof(name))) {
+		f = fopen(name, "r");
+		if (f) {
+			machine = read_line(f);
+			base_dir = read_line(f);
+			multiarch = read_line(f);
+			fclose(f);
+			if (machine && base_dir && multiarch)
+				return;
+		}
+	} else {
+		name[0] = '\0';
+	}
+
+	machine = run_ccom("-dumpmachine");
+	base_dir = run_ccom("-print-file-name=");
+	multiarch = run_ccom("-print-multiarch");
+
+	if (!name[0] || strchr(machine, '\n') || strchr(base_dir, '\n') ||
+	    strchr(multiarch, '\n'))
+		return;
+
+	/* other builds run at the same time so write it and rename it */
+	snprintf(tmp, sizeof(tmp), "%s.%d", name, getpid());
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+	fprintf(f, "%s\n%s\n%s\n", machine, base_dir, multiarch);
+	if (fclose(f) == 0)
+		rename(tmp, name);
+	else
+		unlink(tmp);
+}
+
+static void add_specs(struct buf *buf, const char *spec);
+
+/*
+ * fall back to uname -m to determine the specifics.
+ * Note: this is only meaningful when using natively
+ *       since information about the host is used to
+ *       guess characteristics of the target.
+ */
+static void add_host_machine_specs(struct buf *buf)
+{
+	struct utsname uts;
+
+	if (uname(&uts))
+		die("%s: uname: %s\n", progname, strerror(errno));
+	if (match("^(i.?86|athlon)$", uts.machine, REG_ICASE))
+		add_specs(buf, "i386");
+	else if (match("^(sun4u)$", uts.machine, REG_ICASE))
+		add_specs(buf, "sparc");
+	else if (match("^(x86_64)$", uts.machine, REG_ICASE))
+		add_specs(buf, "x86_64");
+	else if (match("^(ppc)$", uts.machine, REG_ICASE))
+		add_specs(buf, "ppc");
+	else if (match("^(ppc64)$", uts.machine, REG_ICASE))
+		add_specs(buf, "ppc64be");
+	else if (match("^(ppc64le)$", uts.machine, REG_ICASE))
+		add_specs(buf, "ppc64le");
+	else if (match("^(s390x)$", uts.machine, REG_ICASE))
+		add_specs(buf, "s390x");
+	else if (match("^(sparc64)$", uts.machine, REG_ICASE))
+		add_specs(buf, "sparc64");
+	else if (match("^arm(v[78]l)?$", uts.machine, REG_ICASE))
+		add_specs(buf, "arm");
+	else if (match("^(aarch64)$", uts.machine, REG_ICASE))
+		add_specs(buf, "aarch64");
+	else if (match("^(xtensa)$", uts.machine, REG_ICASE))
+		add_specs(buf, "xtensa");
+}
+
+static void add_specs(struct buf *buf, const char *spec)
+{
+	struct utsname uts;
+	char os[sizeof(uts.sysname)];
+	int i;
+
+	if (strcmp(spec, "sunos") == 0) {
+		append(buf, " --os=%s -DSVR4=1 -D__STDC__=0 -D_REENTRANT -D_SOLARIS_THREADS -DNULL=\"((void *)0)\"", spec);
+	} else if (strcmp(spec, "linux") == 0 ||
+		   strcmp(spec, "openbsd") == 0 ||
+		   strcmp(spec, "freebsd") == 0 ||
+		   strcmp(spec, "netbsd") == 0 ||
+		   strcmp(spec, "darwin") == 0) {
+		append(buf, " --os=%s", spec);
+	} else if (strcmp(spec, "gnu/kfreebsd") == 0) {
+		add_specs(buf, "unix");
+		append(buf, " -D__FreeBSD_kernel__=1");
+	} else if (strcmp(spec, "gnu") == 0) {
+		add_specs(buf, "unix");
+		append(buf, " -D__GNU__=1 -D__gnu_hurd__=1 -D__MACH__=1");
+	} else if (strcmp(spec, "unix") == 0) {
+		append(buf, " -Dunix=1 -D__unix=1 -D__unix__=1");
+	} else if (strncmp(spec, "cygwin", 6) == 0) {
+		append(buf, " --os=cygwin");
+	} else if (strcmp(spec, "i386") == 0) {
+		append(buf, " --arch=i386");
+		float_types(buf, 1, 1, 21, 24, 8, 53, 11, 64, 15);
+	} else if (strcmp(spec, "sparc") == 0) {
+		append(buf, " --arch=sparc");
+		float_types(buf, 1, 1, 33, 24, 8, 53, 11, 113, 15);
+	} else if (strcmp(spec, "sparc64") == 0) {
+		append(buf, " --arch=sparc64");
+		float_types(buf, 1, 1, 33, 24, 8, 53, 11, 113, 15);
+	} else if (strcmp(spec, "x86_64") == 0) {
+		append(buf, " --arch=x86_64");
+		float_types(buf, 1, 1, 33, 24, 8, 53, 11, 113, 15);
+	} else if (strcmp(spec, "ppc") == 0) {
+		append(buf, " --arch=ppc");
+		float_types(buf, 1, 1, 21, 24, 8, 53, 11, 113, 15);
+	} else if (strcmp(spec, "ppc64") == 0) {
+		append(buf, " --arch=ppc64");
+		float_types(buf, 1, 1, 21, 24, 8, 53, 11, 113, 15);
+	} else if (strcmp(spec, "ppc64be") == 0) {
+		add_specs(buf, "ppc64");
+		append(buf, " -mbig-endian -D_CALL_ELF=1");
+	} else if (strcmp(spec, "ppc64le") == 0) {
+		add_specs(buf, "ppc64");
+		append(buf, " -mlittle-endian -D_CALL_ELF=2");
+	} else if (strcmp(spec, "s390x") == 0) {
+		append(buf, " -D_BIG_ENDIAN --arch=s390x");
+		float_types(buf, 1, 1, 36, 24, 8, 53, 11, 113, 15);
+	} else if (strcmp(spec, "riscv32") == 0) {
+		append(buf, " --arch=riscv32");
+		float_types(buf, 1, 1, 33, 24, 8, 53, 11, 53, 11);
+	} else if (strcmp(spec, "riscv64") == 0) {
+		append(buf, " --arch=riscv64");
+		float_types(buf, 1, 1, 33, 24, 8, 53, 11, 113, 15);
+	} else if (strcmp(spec, "arm") == 0) {
+		append(buf, " --arch=arm");
+		float_types(buf, 1, 1, 36, 24, 8, 53, 11, 53, 11);
+	} else if (strcmp(spec, "arm+hf") == 0) {
+		add_specs(buf, "arm");
+		append(buf, " -mfloat-abi=hard");
+	} else if (strcmp(spec, "aarch64") == 0) {
+		append(buf, " --arch=aarch64");
+		float_types(buf, 1, 1, 36, 24, 8, 53, 11, 113, 15);
+	} else if (strcmp(spec, "xtensa") == 0) {
+		append(buf, " --arch=xtensa");
+		float_types(buf, 1, 1, 21, 24, 8, 53, 11, 53, 11);
+	} else if (strcmp(spec, "host_os_specs") == 0) {
+		if (uname(&uts))
+			die("%s: uname: %s\n", progname, strerror(errno));
+		for (i = 0; uts.sysname[i]; i++)
+			os[i] = tolower((unsigned char)uts.sysname[i]);
+		os[i] = '\0';
+		add_specs(buf, os);
+	} else if (strcmp(spec, "host_arch_specs") == 0) {
+		load_compiler_info();
+
+		if (match("^aarch64-", machine, 0)) {
+			add_specs(buf, "aarch64");
+		} else if (match("^arm-.*eabihf$", machine, 0)) {
+			add_specs(buf, "arm+hf");
+		} else if (match("^arm-", machine, 0)) {
+			add_specs(buf, "arm");
+		} else if (match("^i[23456]86-", machine, 0)) {
+			add_specs(buf, "i386");
+		} else if (match("^(powerpc|ppc)64le-", machine, 0)) {
+			add_specs(buf, "ppc64le");
+		} else if (match("^s390x-", machine, 0)) {
+			add_specs(buf, "s390x");
+		} else if (strcmp(machine, "x86_64-linux-gnux32") == 0) {
+			add_specs(buf, "x86_64");
+			append(buf, " -mx32");
+		} else if (match("^x86_64-", machine, 0)) {
+			add_specs(buf, "x86_64");
+		} else if (match("^xtensa-", machine, 0)) {
+			add_specs(buf, "xtensa");
+		} else {
+			add_host_machine_specs(buf);
+		}
+	} else {
+		die("%s: invalid specs: %s\n", progname, spec);
+	}
+}
+
+static void run_sh(const char *cmd, bool do_exec)
+{
+	int status;
+	pid_t pid;
+
+	if (do_exec) {
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		die("%s: exec /bin/sh: %s\n", progname, strerror(errno));
+	}
+
+	pid = fork();
+	if (pid < 0)
+		die("%s: fork: %s\n", progname, strerror(errno));
+	if (pid == 0) {
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+	waitpid(pid, &status, 0);
+}
+
+static bool ends_with_dot_c(const char *arg)
+{
+	size_t len = strlen(arg);
+
+	return arg[0] != '-' && len > 2 && strcmp(arg + len - 2, ".c") == 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *gcc_base_dir = NULL;
+	const char *multiarch_dir = NULL;
+	bool has_specs = false;
+	bool gendeps = false;
+	bool do_check = false;
+	bool do_compile = true;
+	bool verbose = false;
+	int nargs = 0;
+	const char *arg;
+	int i;
+
+	progname = argv[0];
+	ccom = getenv("REAL_CC");
+	if (!ccom || !ccom[0])
+		ccom = "cc";
+	arg = getenv("CHECK");
+	append(&cc, "%s", ccom);
+	append(&check, "%s", arg && arg[0] ? arg : "sparse");
+
+	for (i = 1; i < argc; i++) {
+		arg = argv[i];
+
+		if (nargs) {
+			nargs--;
+			goto add_option;
+		}
+
+		/*
+		 * Look for a .c file.  We don't want to run the checker on
+		 * .o or .so files in the link run.  Ditto for stdin.
+		 */
+		if (ends_with_dot_c(arg) || strcmp(arg, "-") == 0)
+			do_check = true;
+
+		if (strcmp(arg, "-o") == 0 || strcmp(arg, "-MF") == 0 ||
+		    strcmp(arg, "-MT") == 0 || strcmp(arg, "-MQ") == 0) {
+			/*
+			 * Need to be checked explicitly since otherwise the
+			 * argument would be processed as a (non-existant)
+			 * source file or as an option.
+			 */
+			if (i + 1 >= argc)
+				die("%s: missing argument for %s", progname, arg);
+			nargs = 1;
+		}
+
+		/* We don't want to run the checker on non-C files. */
+		if (strcmp(arg, "-x") == 0) {
+			if (i + 1 >= argc)
+				die("%s: missing argument for %s", progname, arg);
+			do_check = strcmp(argv[i + 1], "c") == 0;
+			nargs = 1;
+		}
+
+		if (strcmp(arg, "-M") == 0 || strcmp(arg, "-MM") == 0)
+			gendeps = true;
+
+		if (strncmp(arg, "-target=", 8) == 0) {
+			add_specs(&check, arg + 8);
+			has_specs = true;
+			continue;
+		}
+
+		if (strcmp(arg, "-no-compile") == 0) {
+			do_compile = false;
+			continue;
+		}
+
+		if (strcmp(arg, "-gcc-base-dir") == 0) {
+			if (i + 1 >= argc || !argv[i + 1][0])
+				die("%s: missing argument for -gcc-base-dir option", progname);
+			gcc_base_dir = argv[++i];
+			continue;
+		}
+
+		if (strcmp(arg, "-multiarch-dir") == 0) {
+			if (i + 1 >= argc || !argv[i + 1][0])
+				die("%s: missing argument for -multiarch-dir option", progname);
+			multiarch_dir = argv[++i];
+			continue;
+		}
+
+		/* If someone adds "-E", don't pre-process twice. */
+		if (strcmp(arg, "-E") == 0)
+			do_compile = false;
+
+		if (strcmp(arg, "-v") == 0)
+			verbose = true;
+
+add_option:
+		if (!check_only_option(arg)) {
+			append(&cc, " ");
+			quote_arg(&cc, arg);
+		}
+		append(&check, " ");
+		quote_arg(&check, arg);
+	}
+
+	if (gendeps) {
+		do_compile = true;
+		do_check = false;
+	}
+
+	if (do_check) {
+		if (!has_specs) {
+			add_specs(&check, "host_arch_specs");
+			add_specs(&check, "host_os_specs");
+		}
+
+		if (!gcc_base_dir) {
+			load_compiler_info();
+			gcc_base_dir = base_dir;
+		}
+		if (gcc_base_dir[0])
+			append(&check, " -gcc-base-dir %s", gcc_base_dir);
+
+		if (!multiarch_dir) {
+			load_compiler_info();
+			multiarch_dir = multiarch;
+		}
+		if (multiarch_dir[0])
+			append(&check, " -multiarch-dir %s", multiarch_dir);
+
+		if (verbose)
+			printf("%s\n", check.str);
+		fflush(stdout);
+		run_sh(check.str, !do_compile);
+	}
+
+	if (do_compile) {
+		if (verbose)
+			printf("%s\n", cc.str);
+		fflush(stdout);
+		run_sh(cc.str, true);
+	}
+
+	return 0;
+}
@@ -0,0 +1,1186 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * This is a faster replacement for fill_db_sql.pl.  It loads the "SQL:" and
+ * "SQL_late:" lines as well as the "SQL_row:" and "SQL_rows:" records from
+ * --sql-rows.  The
+ * inserts go through prepared statements and everything is done in one
+ * transaction.  Rows for the same table are saved up and inserted BATCH_ROWS
+ * at a time with one multi-row statement.
+ *
+ * "sm_fill_db --caller-info <project> <db_file> <smatch_warns.txt>" does the
+ * same for fill_db_caller_info.pl and "sm_fill_db --type-value <db_file>"
+ * replaces fill_db_type_value.pl.  "sm_fill_db --merge" loads the SQLite
+ * files from "smatch --info-shard" in place of the text.  The DB always comes
+ * before the files which are loaded into it.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+#include "smatch_sql_values.h"
+
+#define BATCH_ROWS 64
+/* older SQLite versions only allow 999 "?" parameters in a statement */
+#define MAX_PARAMS 999
+
+struct pending_row {
+	char *buf;
+	const char *orig;
+	struct sql_value vals[SQL_MAX_VALUES];
+};
+
+struct insert_stmt {
+	char *table;
+	int ignore;
+	int cnt;
+	sqlite3_stmt *stmt;
+	sqlite3_stmt *batch;
+	int batch_rows;
+	int pending;
+	struct pending_row rows[BATCH_ROWS];
+	struct insert_stmt *next;
+};
+
+static sqlite3 *db;
+static struct insert_stmt *insert_stmts;
+static unsigned long rows, errors;
+
+static void sql_error(const char *sql)
+{
+	errors++;
+	fprintf(stderr, "sm_fill_db: %s\n", sqlite3_errmsg(db));
+	fprintf(stderr, "sm_fill_db: SQL: '%s'\n", sql);
+}
+
+static void flush_all_rows(void);
+
+static void exec_sql(const char *sql)
+{
+	char *err = NULL;
+
+	/* the saved up inserts have to go in first */
+	flush_all_rows();
+
+	if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+		errors++;
+		fprintf(stderr, "sm_fill_db: %s\n", err);
+		fprintf(stderr, "sm_fill_db: SQL: '%s'\n", sql);
+		sqlite3_free(err);
+	}
+}
+
+static sqlite3_stmt *prepare_insert(struct insert_stmt *ins, int nr_rows)
+{
+	sqlite3_stmt *stmt;
+	char *sql, *p;
+	size_t size;
+	int i, j;
+
+	size = 64 + strlen(ins->table) + nr_rows * (ins->cnt * 3 + 4);
+	sql = p = malloc(size);
+	p += snprintf(p, sql + size - p, "insert %sinto %s values ",
+		      ins->ignore ? "or ignore " : "", ins->table);
+	for (i = 0; i < nr_rows; i++) {
+		p += snprintf(p, sql + size - p, "%s(", i ? ", " : "");
+		for (j = 0; j < ins->cnt; j++)
+			p += snprintf(p, sql + size - p, "%s?", j ? ", " : "");
+		p += snprintf(p, sql + size - p, ")");
+	}
+	snprintf(p, sql + size - p, ";");
+
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+		sql_error(sql);
+		stmt = NULL;
+	}
+	free(sql);
+	return stmt;
+}
+
+static int check_constraint(void *_found, int argc, char **argv, char **azColName)
+{
+	int *found = _found;
+
+	*found = 1;
+	return 0;
+}
+
+/*
+ * The journal is turned off so a multi-row insert which fails part way
+ * through leaves the earlier rows in the table.  Only tables where a plain
+ * insert can't fail get batched.
+ */
+static int can_batch(struct insert_stmt *ins)
+{
+	int found = 0;
+	char *sql;
+
+	if (ins->ignore)
+		return 1;
+
+	sql = sqlite3_mprintf("select 1 from pragma_index_list('%q') where \"unique\" "
+			      "union all select 1 from pragma_table_info('%q') where pk or \"notnull\";",
+			      ins->table, ins->table);
+	if (sqlite3_exec(db, sql, check_constraint, &found, NULL) != SQLITE_OK)
+		found = 1;
+	sqlite3_free(sql);
+	return !found;
+}
+
+static struct insert_stmt *get_insert_stmt(const char *table, int len, int ignore, int cnt)
+{
+	struct insert_stmt *tmp;
+
+	for (tmp = insert_stmts; tmp; tmp = tmp->next) {
+		if (tmp->ignore == ignore && tmp->cnt == cnt &&
+		    strncmp(tmp->table, table, len) == 0 &&
+		    tmp->table[len] == '\0')
+			return tmp;
+	}
+
+	tmp = calloc(1, sizeof(*tmp));
+	tmp->table = strndup(table, len);
+	tmp->ignore = ignore;
+	tmp->cnt = cnt;
+
+	tmp->stmt = prepare_insert(tmp, 1);
+	if (!tmp->stmt) {
+		free(tmp->table);
+		free(tmp);
+		return NULL;
+	}
+	tmp->batch_rows = MAX_PARAMS / cnt;
+	if (tmp->batch_rows > BATCH_ROWS)
+		tmp->batch_rows = BATCH_ROWS;
+	if (tmp->batch_rows > 1 && can_batch(tmp))
+		tmp->batch = prepare_insert(tmp, tmp->batch_rows);
+
+	tmp->next = insert_stmts;
+	insert_stmts = tmp;
+	return tmp;
+}
+
+/*
+ * If the multi-row insert fails then nothing from it was inserted, so the
+ * rows are tried one at a time to find and print the bad one.
+ */
+static void flush_rows(struct insert_stmt *ins)
+{
+	struct pending_row *row;
+	int i, j;
+
+	if (!ins->pending)
+		return;
+
+	if (ins->pending == ins->batch_rows && ins->batch) {
+		for (i = 0; i < ins->pending; i++) {
+			for (j = 0; j < ins->cnt; j++)
+				sql_bind_value(ins->batch, i * ins->cnt + j + 1,
+					   &ins->rows[i].vals[j]);
+		}
+		if (sqlite3_step(ins->batch) == SQLITE_DONE) {
+			rows += ins->pending;
+			i = ins->pending;
+		} else {
+			i = 0;
+		}
+		sqlite3_reset(ins->batch);
+		sqlite3_clear_bindings(ins->batch);
+	} else {
+		i = 0;
+	}
+
+	for (; i < ins->pending; i++) {
+		row = &ins->rows[i];
+		for (j = 0; j < ins->cnt; j++)
+			sql_bind_value(ins->stmt, j + 1, &row->vals[j]);
+		if (sqlite3_step(ins->stmt) != SQLITE_DONE)
+			sql_error(row->orig);
+		else
+			rows++;
+		sqlite3_reset(ins->stmt);
+	}
+
+	for (i = 0; i < ins->pending; i++)
+		free(ins->rows[i].buf);
+	ins->pending = 0;
+}
+
+static void flush_all_rows(void)
+{
+	struct insert_stmt *tmp;
+
+	for (tmp = insert_stmts; tmp; tmp = tmp->next)
+		flush_rows(tmp);
+}
+
+static void insert_values(const char *table, int len, int ignore,
+			  struct sql_value *vals, int cnt, const char *orig)
+{
+	struct insert_stmt *ins;
+	struct pending_row *row;
+	size_t size;
+	char *p;
+	int i;
+
+	ins = get_insert_stmt(table, len, ignore, cnt);
+	if (!ins)
+		return;
+
+	/* the values point into the line buffer so they need a copy */
+	size = strlen(orig) + 1;
+	for (i = 0; i < cnt; i++)
+		size += vals[i].len + 1;
+	row = &ins->rows[ins->pending++];
+	row->buf = p = malloc(size);
+	for (i = 0; i < cnt; i++) {
+		row->vals[i] = vals[i];
+		memcpy(p, vals[i].str, vals[i].len);
+		p[vals[i].len] = '\0';
+		row->vals[i].str = p;
+		p += vals[i].len + 1;
+	}
+	strcpy(p, orig);
+	row->orig = p;
+
+	if (ins->pending == ins->batch_rows || !ins->batch)
+		flush_rows(ins);
+}
+
+/*
+ * Handle "insert [or ignore] into table values(...);".  Anything else is
+ * passed to sqlite3_exec().
+ */
+static void load_sql(char *sql)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	char *orig = strdup(sql);
+	const char *table;
+	int ignore, len, cnt;
+
+	cnt = sql_split_insert(sql, &table, &len, &ignore, vals, SQL_MAX_VALUES);
+	if (cnt > 0)
+		insert_values(table, len, ignore, vals, cnt, orig);
+	else
+		exec_sql(orig);
+	free(orig);
+}
+
+/* "<table> <flags> <count> <type><len>:<value> ..." */
+static void load_row(char *row, int late)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *table;
+	int len, cnt, ignore, row_late;
+	char *orig;
+
+	/* the late rows are loaded on the second pass */
+	len = strcspn(row, " ");
+	if (row[len] == ' ' && row[len + 1] && (row[len + 2] == 'l') != late)
+		return;
+
+	orig = strdup(row);
+	cnt = sql_split_row(row, &table, &len, &ignore, &row_late, vals, SQL_MAX_VALUES);
+	if (cnt > 0) {
+		insert_values(table, len, ignore, vals, cnt, orig);
+	} else {
+		errors++;
+		fprintf(stderr, "sm_fill_db: bad row: '%s'\n", orig);
+	}
+	free(orig);
+}
+
+/* "<table> <flags> <count> <shared> <shared values> <row values>..." */
+static void load_rows(char *row, int late)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *table;
+	int len, cnt, ignore, row_late, shared, ret = 0;
+	char *orig, *head, *next;
+
+	len = strcspn(row, " ");
+	if (row[len] == ' ' && row[len + 1] && (row[len + 2] == 'l') != late)
+		return;
+
+	orig = strdup(row);
+	cnt = sql_split_rows(row, &table, &len, &ignore, &row_late, vals,
+			     SQL_MAX_VALUES, &shared, &next);
+	if (cnt > 0) {
+		/* the SQL errors only print the shared part of the record */
+		head = strndup(orig, next - row);
+		while ((ret = sql_next_row(&next, vals, shared, cnt)) > 0)
+			insert_values(table, len, ignore, vals, cnt, head);
+		free(head);
+	}
+	if (cnt <= 0 || ret < 0) {
+		errors++;
+		fprintf(stderr, "sm_fill_db: bad rows: '%s'\n", orig);
+	}
+	free(orig);
+}
+
+/*
+ * Matches what fill_db_sql.pl does: the SQL starts after the second ':'
+ * on lines that look like "file.c:123 func() SQL: ...".
+ */
+static void load_file(const char *name, int late)
+{
+	const char *marker = late ? "() SQL_late: " : "() SQL: ";
+	size_t size = 0;
+	char *line = NULL;
+	ssize_t len;
+	FILE *file;
+	char *p;
+
+	file = fopen(name, "r");
+	if (!file) {
+		fprintf(stderr, "sm_fill_db: cannot open %s\n", name);
+		exit(1);
+	}
+
+	while ((len = getline(&line, &size, file)) > 0) {
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+
+		p = strstr(line, "() SQL_row: ");
+		if (p) {
+			load_row(p + strlen("() SQL_row: "), late);
+			continue;
+		}
+		p = strstr(line, "() SQL_rows: ");
+		if (p) {
+			load_rows(p + strlen("() SQL_rows: "), late);
+			continue;
+		}
+
+		if (!strstr(line, marker))
+			continue;
+		p = strchr(line, ':');
+		if (p)
+			p = strchr(p + 1, ':');
+		if (!p)
+			continue;
+		load_sql(p + 1);
+	}
+
+	free(line);
+	fclose(file);
+}
+
+struct func_count {
+	char *name;
+	int count;
+};
+
+static struct func_count *func_counts;
+static int func_counts_size, nr_func_counts;
+
+static unsigned int hash_name(const char *name, int len)
+{
+	unsigned int hash = 5381;
+	int i;
+
+	for (i = 0; i < len; i++)
+		hash = hash * 33 + (unsigned char)name[i];
+	return hash;
+}
+
+static void count_function(const char *name, int len)
+{
+	struct func_count *old = func_counts;
+	int old_size = func_counts_size;
+	unsigned int h;
+	int i;
+
+	if (nr_func_counts * 2 >= func_counts_size) {
+		func_counts_size = func_counts_size ? func_counts_size * 2 : 4096;
+		func_counts = calloc(func_counts_size, sizeof(*func_counts));
+		nr_func_counts = 0;
+		for (i = 0; i < old_size; i++) {
+			if (!old[i].name)
+				continue;
+			h = hash_name(old[i].name, strlen(old[i].name));
+			while (func_counts[h % func_counts_size].name)
+				h++;
+			func_counts[h % func_counts_size] = old[i];
+			nr_func_counts++;
+		}
+		free(old);
+	}
+
+	h = hash_name(name, len);
+	while (func_counts[h % func_counts_size].name) {
+		struct func_count *fc = &func_counts[h % func_counts_size];
+
+		if (strncmp(fc->name, name, len) == 0 && fc->name[len] == '\0') {
+			fc->count++;
+			return;
+		}
+		h++;
+	}
+	func_counts[h % func_counts_size].name = strndup(name, len);
+	func_counts[h % func_counts_size].count = 1;
+	nr_func_counts++;
+}
+
+/* The nth field of the line if it were split on "'" like the Perl did */
+static const char *quote_field(const char *line, int nr, int *len)
+{
+	const char *p = line;
+	const char *end;
+
+	while (nr--) {
+		p = strchr(p, '\'');
+		if (!p)
+			return NULL;
+		p++;
+	}
+	end = strchrnul(p, '\'');
+	*len = end - p;
+	return p;
+}
+
+static bool skip_caller_info(const char *fn, int len)
+{
+	static const char *skip[] = {
+		"printk", "memset", "memcpy", "kfree", "printf", "dev_err", "writel",
+	};
+	int i;
+
+	if (memmem(fn, len, "__builtin_", 10))
+		return true;
+	for (i = 0; i < sizeof(skip) / sizeof(skip[0]); i++) {
+		if (strlen(skip[i]) == len && strncmp(fn, skip[i], len) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Functions which are called from more than 200 places are listed in
+ * smatch_data/<project>.common_functions and common_caller_info.
+ */
+static void save_common_functions(const char *dir, const char *project, const char *table)
+{
+	char path[4096];
+	char *common;
+	FILE *out;
+	int i;
+
+	snprintf(path, sizeof(path), "%s/../%s.common_functions", dir, project);
+	out = fopen(path, "w");
+	for (i = 0; i < func_counts_size; i++) {
+		struct func_count *fc = &func_counts[i];
+
+		if (!fc->name || fc->count <= 200)
+			continue;
+		if (out && !strchr(fc->name, ' '))
+			fprintf(out, "%s\n", fc->name);
+		common = sqlite3_mprintf("insert into %s values ('unknown', 'too common', '%q', 0, 0, 0, -1, '', '');",
+					 table, fc->name);
+		load_sql(common);
+		sqlite3_free(common);
+	}
+	if (out)
+		fclose(out);
+}
+
+/*
+ * This does what fill_db_caller_info.pl does.  The %call_marker% row starts
+ * a new call and the %CALL_ID% in each row is filled in with the call
+ * number.
+ */
+static void load_caller_info(const char *dir, const char *project, const char *name)
+{
+	const char *marker = "() SQL_caller_info: ";
+	unsigned long call_id = 0;
+	size_t size = 0, sql_size = 0;
+	char *line = NULL, *sql = NULL;
+	const char *fn, *p, *m;
+	FILE *file;
+	ssize_t len;
+	int fn_len;
+
+	file = fopen(name, "r");
+	if (!file) {
+		fprintf(stderr, "sm_fill_db: cannot open %s\n", name);
+		exit(1);
+	}
+
+	while ((len = getline(&line, &size, file)) > 0) {
+		if (strstr(line, "SQL_caller_info: ") && strstr(line, "%call_marker%")) {
+			fn = quote_field(line, 3, &fn_len);
+			if (fn)
+				count_function(fn, fn_len);
+		}
+
+		m = strstr(line, marker);
+		if (!m)
+			continue;
+		for (p = m; p > line && (isalnum(p[-1]) || p[-1] == '_'); p--)
+			;
+		if (p == m || p == line || p[-1] != ' ')
+			continue;
+		/* this is the key column and not the function but it's what the Perl did */
+		fn = quote_field(line, 5, &fn_len);
+		if (fn && skip_caller_info(fn, fn_len))
+			continue;
+
+		p = strchr(line, ':');
+		if (p)
+			p = strchr(p + 1, ':');
+		if (!p)
+			continue;
+		p++;
+
+		if (sql_size < len + 32) {
+			sql_size = len + 32;
+			sql = realloc(sql, sql_size);
+		}
+		strcpy(sql, p);
+		m = strstr(sql, "%call_marker%");
+		if (m) {
+			memmove((char *)m, m + 13, strlen(m + 13) + 1);
+			call_id++;
+		}
+		m = strstr(sql, "%CALL_ID%");
+		if (m) {
+			char id[32];
+			int id_len = snprintf(id, sizeof(id), "%lu", call_id);
+
+			memmove((char *)m + id_len, m + 9, strlen(m + 9) + 1);
+			memcpy((char *)m, id, id_len);
+		}
+		load_sql(sql);
+	}
+	free(line);
+	free(sql);
+	fclose(file);
+
+	save_common_functions(dir, project, "common_caller_info");
+}
+
+/*
+ * This does what fill_db_type_value.pl does.  The function_type_value rows
+ * for each type are merged into one range list in type_value.  The values
+ * go from s64min to u64max so they're kept in an __int128.  Overlapping
+ * ranges are merged but ranges which only touch are left apart.  A type
+ * with a value that isn't a number is skipped and so is one which ends up
+ * with more than 101 ranges.
+ */
+struct type_range {
+	__int128 min, max;
+};
+
+static struct type_range *type_ranges;
+static int nr_type_ranges, type_ranges_size;
+
+static bool text_to_int(const char *text, int len, __int128 *val)
+{
+	static const struct {
+		const char *name;
+		__int128 val;
+	} names[] = {
+		{ "s64min", -(((__int128)1) << 63) },
+		{ "s32min", -(1LL << 31) },
+		{ "s16min", -(1 << 15) },
+		{ "s64max", (((__int128)1) << 63) - 1 },
+		{ "s32max", (1LL << 31) - 1 },
+		{ "s16max", (1 << 15) - 1 },
+		{ "u64max", (((__int128)1) << 64) - 1 },
+		{ "u32max", (1LL << 32) - 1 },
+		{ "u16max", (1 << 16) - 1 },
+	};
+	const char *open, *close;
+	unsigned long long num;
+	bool neg = false;
+	int i;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (memmem(text, len, names[i].name, strlen(names[i].name))) {
+			*val = names[i].val;
+			return true;
+		}
+	}
+
+	open = memchr(text, '(', len);
+	if (open) {
+		close = memchr(open, ')', text + len - open);
+		if (close) {
+			text = open + 1;
+			len = close - text;
+		}
+	}
+	if (!len || (*text != '-' && !isdigit(*text)))
+		return false;
+
+	if (*text == '-') {
+		neg = true;
+		text++;
+		len--;
+	}
+	num = 0;
+	for (i = 0; i < len && isdigit(text[i]); i++)
+		num = num * 10 + text[i] - '0';
+	*val = neg ? -(__int128)num : num;
+	return true;
+}
+
+static bool add_type_range(const char *text, int len)
+{
+	struct type_range *r;
+	int i;
+
+	if (nr_type_ranges == type_ranges_size) {
+		type_ranges_size = type_ranges_size ? type_ranges_size * 2 : 64;
+		type_ranges = realloc(type_ranges, type_ranges_size * sizeof(*type_ranges));
+	}
+	r = &type_ranges[nr_type_ranges];
+
+	/* the last '-' which isn't part of a "(-1)" splits min from max */
+	for (i = len - 1; i > 0; i--) {
+		if (text[i] == '-' && text[i - 1] != '(')
+			break;
+	}
+	if (i > 0) {
+		if (!text_to_int(text, i, &r->min) ||
+		    !text_to_int(text + i + 1, len - i - 1, &r->max))
+			return false;
+	} else {
+		if (!text_to_int(text, len, &r->min))
+			return false;
+		r->max = r->min;
+	}
+	nr_type_ranges++;
+	return true;
+}
+
+static int cmp_type_range(const void *_a, const void *_b)
+{
+	const struct type_range *a = _a;
+	const struct type_range *b = _b;
+
+	if (a->min != b->min)
+		return a->min < b->min ? -1 : 1;
+	return 0;
+}
+
+static int print_type_val(char *buf, __int128 val)
+{
+	if (val < 0)
+		return sprintf(buf, "(%lld)", (long long)val);
+	return sprintf(buf, "%llu", (unsigned long long)val);
+}
+
+static void save_type_value(sqlite3_stmt *stmt, const char *type)
+{
+	char *buf, *p;
+	int i, nr = 0;
+
+	qsort(type_ranges, nr_type_ranges, sizeof(*type_ranges), cmp_type_range);
+	for (i = 0; i < nr_type_ranges; i++) {
+		if (nr && type_ranges[i].min <= type_ranges[nr - 1].max) {
+			if (type_ranges[i].max > type_ranges[nr - 1].max)
+				type_ranges[nr - 1].max = type_ranges[i].max;
+			continue;
+		}
+		type_ranges[nr++] = type_ranges[i];
+	}
+
+	if (nr > 101) {
+		printf("%s %d\n", type, nr);
+		return;
+	}
+
+	/* two numbers of 20 digits, the "()" around negatives, "-" and "," */
+	p = buf = malloc(nr * 48 + 1);
+	*p = '\0';
+	for (i = 0; i < nr; i++) {
+		if (i)
+			*p++ = ',';
+		p += print_type_val(p, type_ranges[i].min);
+		if (type_ranges[i].min != type_ranges[i].max) {
+			*p++ = '-';
+			p += print_type_val(p, type_ranges[i].max);
+		}
+	}
+
+	sqlite3_bind_text(stmt, 1, type, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, buf, -1, SQLITE_STATIC);
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		sql_error("insert into type_value");
+	else
+		rows++;
+	sqlite3_reset(stmt);
+	free(buf);
+}
+
+static void fill_type_value(void)
+{
+	sqlite3_stmt *select, *insert;
+	const char *value, *end;
+	char *cur_type = NULL;
+	const char *type;
+	bool skip = false;
+
+	if (sqlite3_prepare_v2(db, "select type, value from function_type_value order by type;",
+			       -1, &select, NULL) != SQLITE_OK ||
+	    sqlite3_prepare_v2(db, "insert into type_value values (?1, ?2);",
+			       -1, &insert, NULL) != SQLITE_OK) {
+		sql_error("type_value");
+		return;
+	}
+
+	while (sqlite3_step(select) == SQLITE_ROW) {
+		type = (const char *)sqlite3_column_text(select, 0);
+		value = (const char *)sqlite3_column_text(select, 1);
+		if (!type || !value)
+			continue;
+
+		if (!cur_type || strcmp(cur_type, type) != 0) {
+			if (cur_type && !skip)
+				save_type_value(insert, cur_type);
+			free(cur_type);
+			cur_type = strdup(type);
+			nr_type_ranges = 0;
+			skip = false;
+		}
+		if (skip)
+			continue;
+
+		for (; *value; value = *end ? end + 1 : end) {
+			end = strchrnul(value, ',');
+			if (memmem(value, end - value, "ignore", 6))
+				continue;
+			if (!add_type_range(value, end - value)) {
+				skip = true;
+				break;
+			}
+		}
+	}
+	if (cur_type && !skip)
+		save_type_value(insert, cur_type);
+	free(cur_type);
+
+	sqlite3_finalize(select);
+	sqlite3_finalize(insert);
+}
+
+static void open_db(const char *db_file)
+{
+	if (sqlite3_open_v2(db_file, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+			    SQLITE_OPEN_URI, NULL) != SQLITE_OK) {
+		fprintf(stderr, "sm_fill_db: cannot open %s\n", db_file);
+		exit(1);
+	}
+
+	exec_sql("PRAGMA cache_size = 800000;");
+	exec_sql("PRAGMA journal_mode = OFF;");
+	exec_sql("PRAGMA count_changes = OFF;");
+	exec_sql("PRAGMA temp_store = MEMORY;");
+	exec_sql("PRAGMA locking = EXCLUSIVE;");
+}
+
+static void start_transaction(const char *db_file)
+{
+	open_db(db_file);
+	exec_sql("BEGIN;");
+}
+
+static void end_transaction(void)
+{
+	exec_sql("COMMIT;");
+	sqlite3_close(db);
+
+	fprintf(stderr, "sm_fill_db: %lu rows, %lu errors\n", rows, errors);
+}
+
+/*
+ * "sm_fill_db --merge <project> <db_file> <shard>..." loads the files which
+ * "smatch --info-shard=<dir>" wrote.  The rows were split into values
+ * when smatch saved them so there is no text to read and parse here.  The
+ * caller_info call numbers of each shard are moved past the ones of the
+ * earlier shards.  Like create_db.sh does, return_states and
+ * caller_info are put together in a staging DB first and copied over
+ * sorted by function at the end.  The SQL_late rows of every shard go in
+ * after the normal rows of every shard.
+ */
+enum shard_kind {
+	SHARD_NORMAL,
+	SHARD_LATE,
+	SHARD_CALLER_INFO,
+	SHARD_CALL_MARKER,
+};
+
+/* the columns of the shard "rows" table after seq */
+enum {
+	COL_KIND,
+	COL_TBL,
+	COL_CNT,
+	COL_CALL,
+	COL_SQL,
+	COL_VALS,
+};
+
+static const char *big_tables[] = {
+	"return_states", "caller_info", "common_caller_info",
+};
+
+static sqlite3_stmt *late_insert;
+
+static bool is_big_table(const char *table, int len)
+{
+	int i;
+
+	for (i = 0; i < sizeof(big_tables) / sizeof(big_tables[0]); i++) {
+		if (strlen(big_tables[i]) == len && strncmp(table, big_tables[i], len) == 0)
+			return true;
+	}
+	return false;
+}
+
+static char *merge_table(const char *table, int len)
+{
+	return sqlite3_mprintf("%s%.*s", is_big_table(table, len) ? "staging." : "",
+			       len, table);
+}
+
+static void merge_values(const char *table, int len, int ignore,
+			 struct sql_value *vals, int cnt, const char *orig)
+{
+	char *name = merge_table(table, len);
+
+	insert_values(name, strlen(name), ignore, vals, cnt, orig);
+	sqlite3_free(name);
+}
+
+/* the statements which smatch saved as text */
+static void merge_sql(const char *text, long long call_id)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *table;
+	int ignore, len, cnt;
+	char *orig, *sql, *p;
+
+	orig = malloc(strlen(text) + 32);
+	strcpy(orig, text);
+	p = strstr(orig, "%CALL_ID%");
+	if (p) {
+		char id[32];
+		int id_len = snprintf(id, sizeof(id), "%lld", call_id);
+
+		memmove(p + id_len, p + 9, strlen(p + 9) + 1);
+		memcpy(p, id, id_len);
+	}
+
+	sql = strdup(orig);
+	cnt = sql_split_insert(sql, &table, &len, &ignore, vals, SQL_MAX_VALUES);
+	if (cnt > 0)
+		merge_values(table, len, ignore, vals, cnt, orig);
+	else
+		exec_sql(orig);
+	free(sql);
+	free(orig);
+}
+
+static void merge_row(sqlite3_stmt *row, long long call_offset, bool late_pass)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	struct insert_stmt *ins;
+	const char *table;
+	int kind, cnt, i;
+	bool exact = false;
+	long long call;
+	char id[32];
+	char *name;
+
+	kind = sqlite3_column_int(row, COL_KIND);
+	if (kind == SHARD_LATE && !late_pass) {
+		for (i = COL_KIND; i < COL_VALS + SQL_MAX_VALUES; i++)
+			sqlite3_bind_value(late_insert, i + 1, sqlite3_column_value(row, i));
+		if (sqlite3_step(late_insert) != SQLITE_DONE)
+			sql_error("insert into late_rows");
+		sqlite3_reset(late_insert);
+		return;
+	}
+
+	call = sqlite3_column_int64(row, COL_CALL) + call_offset;
+	if (sqlite3_column_type(row, COL_SQL) != SQLITE_NULL) {
+		merge_sql((const char *)sqlite3_column_text(row, COL_SQL), call);
+		return;
+	}
+
+	table = (const char *)sqlite3_column_text(row, COL_TBL);
+	cnt = sqlite3_column_int(row, COL_CNT);
+	if (!table || cnt <= 0 || cnt > SQL_MAX_VALUES) {
+		errors++;
+		fprintf(stderr, "sm_fill_db: bad shard row\n");
+		return;
+	}
+	if (kind == SHARD_CALL_MARKER && cnt > 2)
+		count_function((const char *)sqlite3_column_text(row, COL_VALS + 2),
+			       sqlite3_column_bytes(row, COL_VALS + 2));
+
+	/*
+	 * The values go through insert_values() as text so they can be
+	 * batched.  SQLite only prints 15 digits of a REAL so those rows are
+	 * bound as they are.
+	 */
+	for (i = 0; i < cnt; i++) {
+		switch (sqlite3_column_type(row, COL_VALS + i)) {
+		case SQLITE_INTEGER:
+			vals[i].type = SQL_VAL_INT;
+			break;
+		case SQLITE_FLOAT:
+			exact = true;
+			break;
+		default:
+			vals[i].type = SQL_VAL_TEXT;
+		}
+		vals[i].str = (const char *)sqlite3_column_text(row, COL_VALS + i) ?: "";
+		vals[i].len = sqlite3_column_bytes(row, COL_VALS + i);
+	}
+	/* the call_id was saved as zero */
+	if ((kind == SHARD_CALLER_INFO || kind == SHARD_CALL_MARKER) && cnt > 3) {
+		vals[3].type = SQL_VAL_INT;
+		vals[3].len = snprintf(id, sizeof(id), "%lld", call);
+		vals[3].str = id;
+	}
+
+	if (!exact) {
+		merge_values(table, strlen(table), 1, vals, cnt, table);
+		return;
+	}
+
+	flush_all_rows();
+	name = merge_table(table, strlen(table));
+	ins = get_insert_stmt(name, strlen(name), 1, cnt);
+	sqlite3_free(name);
+	if (!ins)
+		return;
+	for (i = 0; i < cnt; i++)
+		sqlite3_bind_value(ins->stmt, i + 1, sqlite3_column_value(row, COL_VALS + i));
+	if (kind == SHARD_CALLER_INFO || kind == SHARD_CALL_MARKER)
+		sqlite3_bind_int64(ins->stmt, 4, call);
+	if (sqlite3_step(ins->stmt) != SQLITE_DONE)
+		sql_error(table);
+	else
+		rows++;
+	sqlite3_reset(ins->stmt);
+}
+
+static void merge_rows(sqlite3 *from, const char *sql, long long call_offset, bool late_pass)
+{
+	sqlite3_stmt *row;
+
+	if (sqlite3_prepare_v2(from, sql, -1, &row, NULL) != SQLITE_OK) {
+		errors++;
+		fprintf(stderr, "sm_fill_db: %s\n", sqlite3_errmsg(from));
+		return;
+	}
+	while (sqlite3_step(row) == SQLITE_ROW)
+		merge_row(row, call_offset, late_pass);
+	sqlite3_finalize(row);
+}
+
+/* returns the number of calls in the shard */
+static long long merge_shard(const char *shard, long long call_offset)
+{
+	sqlite3_stmt *stmt;
+	long long calls = 0;
+	sqlite3 *from;
+	char *uri;
+
+	/* the shards are finished so there is no need to lock them */
+	uri = sqlite3_mprintf("file:%s?immutable=1", shard);
+	if (sqlite3_open_v2(uri, &from, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI,
+			    NULL) != SQLITE_OK) {
+		errors++;
+		fprintf(stderr, "sm_fill_db: cannot open %s\n", shard);
+		sqlite3_close(from);
+		sqlite3_free(uri);
+		return 0;
+	}
+	sqlite3_free(uri);
+
+	merge_rows(from, "select kind, tbl, cnt, call, sql, v1, v2, v3, v4, v5, v6, v7, v8, "
+		   "v9, v10, v11, v12, v13, v14, v15, v16 from rows order by seq;",
+		   call_offset, false);
+
+	if (sqlite3_prepare_v2(from, "select max(call) from rows;", -1, &stmt, NULL) == SQLITE_OK &&
+	    sqlite3_step(stmt) == SQLITE_ROW)
+		calls = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	sqlite3_close(from);
+	return calls;
+}
+
+static void merge_shards(const char *dir, const char *project, const char *db_file,
+			 int nr, char **shards)
+{
+	long long call_offset = 0;
+	char *staging, *sql;
+	int i;
+
+	open_db(db_file);
+	exec_sql("PRAGMA synchronous = OFF;");
+
+	staging = sqlite3_mprintf("%s.staging", db_file);
+	unlink(staging);
+	sql = sqlite3_mprintf("ATTACH %Q AS staging;", staging);
+	exec_sql(sql);
+	sqlite3_free(sql);
+	exec_sql("PRAGMA staging.journal_mode = OFF;");
+	for (i = 0; i < sizeof(big_tables) / sizeof(big_tables[0]); i++) {
+		sql = sqlite3_mprintf("create table staging.%s as select * from main.%s where 0;",
+				      big_tables[i], big_tables[i]);
+		exec_sql(sql);
+		sqlite3_free(sql);
+	}
+	exec_sql("create temp table late_rows (kind, tbl, cnt, call, sql, v1, v2, v3, v4, v5, "
+		 "v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16);");
+	if (sqlite3_prepare_v2(db, "insert into temp.late_rows values (?, ?, ?, ?, ?, ?, ?, ?, ?, "
+			       "?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);", -1, &late_insert,
+			       NULL) != SQLITE_OK) {
+		sql_error("late_rows");
+		exit(1);
+	}
+
+	exec_sql("BEGIN;");
+	for (i = 0; i < nr; i++)
+		call_offset += merge_shard(shards[i], call_offset);
+	merge_rows(db, "select * from temp.late_rows order by rowid;", 0, true);
+	save_common_functions(dir, project, "staging.common_caller_info");
+	sqlite3_finalize(late_insert);
+
+	/* see create_db.sh for why these are sorted */
+	for (i = 0; i < sizeof(big_tables) / sizeof(big_tables[0]); i++) {
+		sql = sqlite3_mprintf("insert into main.%s select * from staging.%s order by function, rowid;",
+				      big_tables[i], big_tables[i]);
+		exec_sql(sql);
+		sqlite3_free(sql);
+	}
+	exec_sql("COMMIT;");
+	exec_sql("DETACH staging;");
+	unlink(staging);
+	sqlite3_free(staging);
+
+	sqlite3_close(db);
+	fprintf(stderr, "sm_fill_db: %lu rows, %lu errors\n", rows, errors);
+}
+
+static void __attribute__((noreturn)) usage(void)
+{
+	fprintf(stderr, "Usage: sm_fill_db <db_file> <smatch_warns.txt>...\n");
+	fprintf(stderr, "       sm_fill_db --caller-info <project> <db_file> <smatch_warns.txt>\n");
+	fprintf(stderr, "       sm_fill_db --type-value <db_file>\n");
+	fprintf(stderr, "       sm_fill_db --merge <project> <db_file> <info-shard.sqlite>...\n");
+	exit(1);
+}
+
+static bool is_sqlite_file(const char *name)
+{
+	char buf[16];
+	bool ret;
+	FILE *file;
+
+	file = fopen(name, "r");
+	if (!file)
+		return false;
+	ret = fread(buf, sizeof(buf), 1, file) == 1 &&
+	      memcmp(buf, "SQLite format 3", sizeof(buf)) == 0;
+	fclose(file);
+	return ret;
+}
+
+/*
+ * Catch the DB and the warns file being swapped.  Otherwise SQLite says the
+ * warns file is not a database or, worse, the DB is read as text and there
+ * are no rows.
+ */
+static void check_args(const char *db_file, int nr, char **files, bool text)
+{
+	struct stat st;
+	int i;
+
+	if (stat(db_file, &st) == 0 && st.st_size && !is_sqlite_file(db_file)) {
+		fprintf(stderr, "sm_fill_db: %s is not a SQLite DB\n", db_file);
+		usage();
+	}
+	for (i = 0; i < nr; i++) {
+		if (is_sqlite_file(files[i]) == text) {
+			fprintf(stderr, "sm_fill_db: %s is %s SQLite file\n",
+				files[i], text ? "a" : "not a");
+			usage();
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	if (argc < 2)
+		usage();
+
+	if (strcmp(argv[1], "--merge") == 0) {
+		if (argc < 5)
+			usage();
+		check_args(argv[3], argc - 4, argv + 4, false);
+		merge_shards(dirname(strdup(argv[0])), argv[2], argv[3], argc - 4, argv + 4);
+		return 0;
+	}
+
+	if (strcmp(argv[1], "--caller-info") == 0) {
+		if (argc != 5)
+			usage();
+		check_args(argv[3], 1, argv + 4, true);
+		start_transaction(argv[3]);
+		load_caller_info(dirname(strdup(argv[0])), argv[2], argv[4]);
+		end_transaction();
+		return 0;
+	}
+
+	if (strcmp(argv[1], "--type-value") == 0) {
+		if (argc != 3)
+			usage();
+		check_args(argv[2], 0, NULL, true);
+		start_transaction(argv[2]);
+		fill_type_value();
+		end_transaction();
+		return 0;
+	}
+
+	if (argc < 3 || argv[1][0] == '-')
+		usage();
+
+	check_args(argv[1], argc - 2, argv + 2, true);
+	start_transaction(argv[1]);
+	for (i = 2; i < argc; i++)
+		load_file(argv[i], 0);
+	for (i = 2; i < argc; i++)
+		load_file(argv[i], 1);
+	end_transaction();
+
+	return 0;
+}
@@ -0,0 +1,296 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * Writes the tables which smatch looks up by function name out to a file
+ * which can be mmapped.  See smatch_db_mmap.h for the format.  The rows in
+ * each group are in the same order as the queries in smatch_db.c return
+ * them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+#include "smatch_db_mmap.h"
+
+static struct table_info {
+	const char *name;
+	const char *key;
+	int has_static;
+	const char *order;
+} table_info[] = {
+	{ "return_states", "function", 1, "file, return_id, type, " },
+	{ "caller_info", "function", 1, "call_id, " },
+	{ "common_caller_info", "function", 1, "call_id, " },
+	{ "call_implies", "function", 1, "" },
+	{ "return_implies", "function", 1, "" },
+	{ "type_size", "type", 0, "" },
+};
+
+static sqlite3 *db;
+
+static char *strings;
+static uint64_t strings_size, strings_alloc;
+static uint32_t *string_hash;
+static uint64_t string_hash_size, nr_strings;
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		fprintf(stderr, "sm_mmap_db: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static uint64_t hash_str(const char *str)
+{
+	return mmap_db_hash(str, 0, 0);
+}
+
+static void grow_string_hash(void)
+{
+	uint32_t *old = string_hash;
+	uint64_t old_size = string_hash_size;
+	uint64_t i, j;
+
+	string_hash_size = old_size ? old_size * 2 : 1 << 16;
+	string_hash = xrealloc(NULL, string_hash_size * sizeof(*string_hash));
+	memset(string_hash, 0xff, string_hash_size * sizeof(*string_hash));
+
+	for (i = 0; i < old_size; i++) {
+		if (old[i] == MMAP_DB_NULL)
+			continue;
+		j = hash_str(strings + old[i]) & (string_hash_size - 1);
+		while (string_hash[j] != MMAP_DB_NULL)
+			j = (j + 1) & (string_hash_size - 1);
+		string_hash[j] = old[i];
+	}
+	free(old);
+}
+
+static uint32_t add_string(const char *str)
+{
+	uint64_t len, i;
+
+	if (!str)
+		return MMAP_DB_NULL;
+
+	if (nr_strings * 2 >= string_hash_size)
+		grow_string_hash();
+
+	i = hash_str(str) & (string_hash_size - 1);
+	while (string_hash[i] != MMAP_DB_NULL) {
+		if (strcmp(strings + string_hash[i], str) == 0)
+			return string_hash[i];
+		i = (i + 1) & (string_hash_size - 1);
+	}
+
+	len = strlen(str) + 1;
+	if (strings_size + len >= MMAP_DB_NULL) {
+		fprintf(stderr, "sm_mmap_db: too much data\n");
+		exit(1);
+	}
+	if (strings_size + len > strings_alloc) {
+		strings_alloc = (strings_alloc + len) * 2;
+		strings = xrealloc(strings, strings_alloc);
+	}
+	memcpy(strings + strings_size, str, len);
+	string_hash[i] = strings_size;
+	strings_size += len;
+	nr_strings++;
+
+	return string_hash[i];
+}
+
+static void write_padded(FILE *file, const void *buf, uint64_t size, uint64_t *offset)
+{
+	static const char zeroes[8];
+
+	if (size && fwrite(buf, size, 1, file) != 1)
+		goto fail;
+	*offset += size;
+	if (*offset % 8) {
+		if (fwrite(zeroes, 8 - *offset % 8, 1, file) != 1)
+			goto fail;
+		*offset += 8 - *offset % 8;
+	}
+	return;
+fail:
+	fprintf(stderr, "sm_mmap_db: write failed\n");
+	exit(1);
+}
+
+static void write_table(FILE *file, struct table_info *info, uint64_t *offset)
+{
+	struct mmap_db_bucket *groups = NULL, *buckets;
+	uint64_t nr_groups = 0, groups_alloc = 0;
+	uint32_t *rows = NULL, *col_names;
+	uint64_t nr_rows = 0, rows_alloc = 0;
+	struct mmap_db_table table = {};
+	sqlite3_stmt *stmt;
+	char sql[1024];
+	int i, nr_cols;
+
+	snprintf(sql, sizeof(sql),
+		 "select %s, %s, %s, * from %s where %s is not null%s order by 1, 2, 3, %srowid;",
+		 info->key,
+		 info->has_static ? "static" : "0",
+		 info->has_static ? "case when static = 1 then file else 0 end" : "0",
+		 info->name, info->key,
+		 info->has_static ? " and static in (0, 1)" : "",
+		 info->order);
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+		fprintf(stderr, "sm_mmap_db: %s\n", sqlite3_errmsg(db));
+		exit(1);
+	}
+
+	nr_cols = sqlite3_column_count(stmt) - 3;
+	col_names = xrealloc(NULL, nr_cols * sizeof(*col_names));
+	for (i = 0; i < nr_cols; i++)
+		col_names[i] = add_string(sqlite3_column_name(stmt, i + 3));
+
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		const char *key = (const char *)sqlite3_column_text(stmt, 0);
+		int is_static = sqlite3_column_int(stmt, 1);
+		int64_t file_id = sqlite3_column_int64(stmt, 2);
+		struct mmap_db_bucket *group = nr_groups ? &groups[nr_groups - 1] : NULL;
+
+		if (!group || group->is_static != is_static || group->file != file_id ||
+		    strcmp(strings + group->key, key) != 0) {
+			if (nr_groups == groups_alloc) {
+				groups_alloc = groups_alloc ? groups_alloc * 2 : 1024;
+				groups = xrealloc(groups, groups_alloc * sizeof(*groups));
+			}
+			group = &groups[nr_groups++];
+			group->hash = mmap_db_hash(key, is_static, file_id);
+			group->file = file_id;
+			group->key = add_string(key);
+			group->is_static = is_static;
+			group->first_row = nr_rows;
+			group->nr_rows = 0;
+		}
+
+		if (nr_rows == rows_alloc) {
+			rows_alloc = rows_alloc ? rows_alloc * 2 : 1024;
+			rows = xrealloc(rows, rows_alloc * nr_cols * sizeof(*rows));
+		}
+		for (i = 0; i < nr_cols; i++)
+			rows[nr_rows * nr_cols + i] = add_string((const char *)sqlite3_column_text(stmt, i + 3));
+		nr_rows++;
+		group->nr_rows++;
+	}
+	sqlite3_finalize(stmt);
+
+	table.nr_buckets = 1;
+	while (table.nr_buckets < nr_groups * 2)
+		table.nr_buckets *= 2;
+	buckets = calloc(table.nr_buckets, sizeof(*buckets));
+	for (i = 0; i < nr_groups; i++) {
+		uint32_t j = groups[i].hash & (table.nr_buckets - 1);
+
+		while (buckets[j].hash)
+			j = (j + 1) & (table.nr_buckets - 1);
+		buckets[j] = groups[i];
+	}
+
+	snprintf(table.name, sizeof(table.name), "%s", info->name);
+	table.nr_cols = nr_cols;
+	table.nr_rows = nr_rows;
+	table.col_names = *offset + sizeof(table);
+	table.buckets = table.col_names + (nr_cols * sizeof(*col_names) + 7) / 8 * 8;
+	table.rows = table.buckets + table.nr_buckets * sizeof(*buckets);
+
+	write_padded(file, &table, sizeof(table), offset);
+	write_padded(file, col_names, nr_cols * sizeof(*col_names), offset);
+	write_padded(file, buckets, table.nr_buckets * sizeof(*buckets), offset);
+	write_padded(file, rows, nr_rows * nr_cols * sizeof(*rows), offset);
+
+	fprintf(stderr, "sm_mmap_db: %s: %lu rows %lu functions\n", info->name,
+		(unsigned long)nr_rows, (unsigned long)nr_groups);
+
+	free(col_names);
+	free(buckets);
+	free(groups);
+	free(rows);
+}
+
+int main(int argc, char **argv)
+{
+	struct mmap_db_header header = {};
+	char out_name[4096], tmp_name[4096];
+	uint64_t offset = 0;
+	struct stat st;
+	FILE *file;
+	int i;
+
+	if (argc != 2 && argc != 3) {
+		printf("Usage: sm_mmap_db <db_file> [<mmap_file>]\n");
+		return 1;
+	}
+
+	if (stat(argv[1], &st) ||
+	    sqlite3_open_v2(argv[1], &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+		fprintf(stderr, "sm_mmap_db: cannot open %s\n", argv[1]);
+		return 1;
+	}
+
+	if (argc == 3)
+		snprintf(out_name, sizeof(out_name), "%s", argv[2]);
+	else
+		snprintf(out_name, sizeof(out_name), "%s.mmap", argv[1]);
+	snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", out_name);
+
+	file = fopen(tmp_name, "w");
+	if (!file) {
+		fprintf(stderr, "sm_mmap_db: cannot create %s\n", tmp_name);
+		return 1;
+	}
+
+	write_padded(file, &header, sizeof(header), &offset);
+	for (i = 0; i < sizeof(table_info) / sizeof(table_info[0]); i++) {
+		header.tables[i] = offset;
+		write_table(file, &table_info[i], &offset);
+	}
+
+	memcpy(header.magic, MMAP_DB_MAGIC, sizeof(header.magic));
+	header.nr_tables = i;
+	header.db_ino = st.st_ino;
+	header.db_size = st.st_size;
+	header.db_mtime = st.st_mtim.tv_sec;
+	header.db_mtime_nsec = st.st_mtim.tv_nsec;
+	header.db_ctime = st.st_ctim.tv_sec;
+	header.db_ctime_nsec = st.st_ctim.tv_nsec;
+	header.strings = offset;
+	header.strings_size = strings_size;
+	write_padded(file, strings, strings_size, &offset);
+
+	if (fseek(file, 0, SEEK_SET) != 0 ||
+	    fwrite(&header, sizeof(header), 1, file) != 1 ||
+	    fclose(file) != 0) {
+		fprintf(stderr, "sm_mmap_db: write failed\n");
+		return 1;
+	}
+	if (rename(tmp_name, out_name) != 0) {
+		fprintf(stderr, "sm_mmap_db: cannot rename %s\n", tmp_name);
+		return 1;
+	}
+
+	sqlite3_close(db);
+	return 0;
+}
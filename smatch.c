@@ -16,15 +16,30 @@
  */
 
 #include <stdio.h>
+#include <stdio_ext.h>
 #include <unistd.h>
 #include <libgen.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
 #include "smatch.h"
 #include "smatch_slist.h"
+#ifdef CHECK_PROFILE
+#include "check_list_profile.h"
+#else
 #include "check_list.h"
+#endif
 
 char *option_debug_check;
 char *option_debug_var;
 char *option_state_cnt;
+char *option_state_profile;
+char *option_hook_profile;
+char *option_sql_profile;
+char *option_stats;
+char *option_profile;
+char *option_spool;
+char *option_result_cache;
 char *option_process_function;
 char *option_project_str = (char *)"smatch_generic";
 static char *option_db_file = (char *)"smatch_db.sqlite";
@@ -36,15 +51,37 @@ int option_spammy = 0;
 int option_pedantic;
 int option_print_names;
 int option_info = 0;
+int option_sql_rows;
 int option_full_path = 0;
 int option_call_tree = 0;
 int option_no_db = 0;
+int option_no_mmap_db;
+int option_db_cache_size = 1000;
+long long option_db_mmap_size;
+int option_db_immutable;
+int option_db_prefetch;
+static char *option_db_serve;
+static char *option_batch;
+static int option_batch_prefix;
+static int option_numa;
+char *option_db_remote;
+char *option_db_capture;
+char *option_db_replay;
 int option_enable = 0;
 int option_disable = 0;
 int option_file_output;
 int option_time;
 int option_time_stmt;
 int option_mem;
+int option_hugepages;
+int option_lazy_inline;
+int option_fast;
+int option_gzip;
+int option_mem_budget = 3000;
+int option_state_budget = 500000;
+int option_func_budget = 300;
+int option_file_budget;
+int option_jobs = 1;
 char *option_datadir_str;
 int option_fatal_checks;
 int option_succeed;
@@ -54,6 +91,21 @@ FILE *sm_outfd;
 FILE *sql_outfd;
 FILE *caller_info_fd;
 
+/*
+ * An --info run prints a line for every return state and every call, so
+ * the output streams get a big buffer and are written out in large chunks.
+ * Only the main thread prints so the locking stdio does around every call
+ * isn't needed either.  A terminal stays line buffered.
+ */
+#define OUTPUT_BUF_SIZE (1024 * 1024)
+void sm_buffer_output(FILE *fd)
+{
+	__fsetlocking(fd, FSETLOCKING_BYCALLER);
+	if (isatty(fileno(fd)))
+		return;
+	setvbuf(fd, malloc(OUTPUT_BUF_SIZE), _IOFBF, OUTPUT_BUF_SIZE);
+}
+
 int sm_nr_errors;
 int sm_nr_checks;
 int __cur_check_id;
@@ -68,7 +120,11 @@ static struct reg_func_info {
 	int enabled;
 } reg_funcs[] = {
 	{"internal", NULL},
+#ifdef CHECK_PROFILE
+#include "check_list_profile.h"
+#else
 #include "check_list.h"
+#endif
 };
 #undef CK
 int num_checks = ARRAY_SIZE(reg_funcs);
@@ -81,6 +137,12 @@ const char *check_name(unsigned short id)
 	return reg_funcs[id].name;
 }
 
+/* the register_* modules track things for the DB, the check_* ones warn */
+bool is_check_module(int id)
+{
+	return strncmp(check_name(id), "check_", 6) == 0;
+}
+
 int id_from_name(const char *name)
 {
 	int i;
@@ -92,6 +154,101 @@ int id_from_name(const char *name)
 	return 0;
 }
 
+/*
+ * Most of the register_* modules are the core of Smatch and everything
+ * depends on them.  These ones are only there for a few checks.  They
+ * only track their own states and nothing outside of those checks calls
+ * into them.  With --enable=X they are skipped unless X needs them and
+ * with --disable=X they are skipped if X was the only user.
+ * When building the DB (--info) everything is registered, except for the
+ * modules whose checks were left out by "make CHECK_PROFILE=<file>".
+ */
+static const struct {
+	const char *module;
+	const char *users[10];
+} module_users[] = {
+	{ "register_dereferences", { "check_check_deref", "check_deref_check",
+	  "check_dereferences_param", "check_err_ptr_deref", "check_free",
+	  "check_free_strict", "check_no_null_check_on_mixed",
+	  "check_unchecked_allocation" } },
+	{ "register_smatch_ignore", { "check_check_deref", "check_deref",
+	  "check_shift_to_zero", "check_spectre", "check_unchecked_allocation" } },
+	{ "register_simple_no_overflow", { "check_integer_overflow_sizeof" } },
+	{ "register_statement_count", { "check_spectre_second_half" } },
+	{ "register_unconstant_macros", { "check_always_true", "check_or_vs_and" } },
+	{ "register_units", { "check_units", "check_debug" } },
+	{ "register_goto_tracker", { "check_missing_error_code" } },
+	{ "register_refcount", { "check_free_strict" } },
+	{ "register_kernel_atomic_dec_test_path", { "check_frees_param_strict" } },
+	{ "register_kernel_err_ptr", { "check_checking_for_null_instead_of_err_ptr",
+	  "check_err_ptr_deref" } },
+	{ "register_kernel_has_devm_cleanup", { "check_unwind" } },
+};
+
+static bool module_is_needed(int id)
+{
+	const char *user;
+	int i, j, user_id;
+
+	for (i = 0; i < ARRAY_SIZE(module_users); i++) {
+		if (strcmp(reg_funcs[id].name, module_users[i].module) != 0)
+			continue;
+		for (j = 0; j < ARRAY_SIZE(module_users[i].users); j++) {
+			user = module_users[i].users[j];
+			if (!user)
+				break;
+			user_id = id_from_name(user);
+			if (!user_id)
+				continue;
+			if (!option_enable || option_info)
+				return true;
+			if (reg_funcs[user_id].enabled == 1 ||
+			    (option_disable && reg_funcs[user_id].enabled != -1))
+				return true;
+		}
+		return false;
+	}
+	return true;
+}
+
+/*
+ * These checks take the most time in the --hook-profile of the validation
+ * tests and of Smatch's own source.  --fast leaves them out.
+ */
+static const char *expensive_checks[] = {
+	"check_unwind",
+	"check_spectre_second_half",
+	"check_leaks",
+};
+
+/*
+ * --fast is for when the answer is needed in a second, for example from a
+ * pre-commit hook, and it is fine to miss some bugs.  There are no
+ * implications, nothing is inlined, calls with a lot of return states in
+ * the DB are treated as unknown, there is only one pass, the global
+ * initializers are not tracked and the expensive checks are left out
+ * unless they are asked for with --enable.  It doesn't print --info.
+ */
+static void set_fast_options(void)
+{
+	int i, id;
+
+	option_info = 0;
+	option_sql_rows = 0;
+	option_two_passes = 0;
+	option_lazy_inline = 1;
+
+	if (option_enable && !option_disable)
+		return;
+	for (i = 0; i < ARRAY_SIZE(expensive_checks); i++) {
+		id = id_from_name(expensive_checks[i]);
+		if (id && reg_funcs[id].enabled == 0)
+			reg_funcs[id].enabled = -1;
+	}
+	option_enable = 1;
+	option_disable = 1;
+}
+
 static void show_checks(void)
 {
 	int i;
@@ -144,14 +301,52 @@ static void help(void)
 	printf("--spammy:  print superfluous crap.\n");
 	printf("--pedantic:  intended for reviewing new drivers.\n");
 	printf("--info:  print info used to fill smatch_data/.\n");
+	printf("--sql-rows:  print --info SQL as rows for sm_fill_db.\n");
+	printf("--info-shard=<dir>:  write the --info SQL to a SQLite file per process in <dir> for \"sm_fill_db --merge\".\n");
 	printf("--debug:  print lots of debug output.\n");
 	printf("--no-data:  do not use the /smatch_data/ directory.\n");
+	printf("--no-mmap-db:  ignore smatch_db.sqlite.mmap and always use SQL.\n");
+	printf("--db-cache-size=<n>:  SQLite cache_size for smatch_db.sqlite (default 1000 pages).\n");
+	printf("--db-mmap-size=<bytes>:  let SQLite mmap this much of smatch_db.sqlite.\n");
+	printf("--db-immutable:  promise that smatch_db.sqlite won't change during the run.\n");
+	printf("--db-prefetch:  read the DB rows for the called functions in a background thread (not with --jobs).\n");
+	printf("--db-serve=<path>:  serve the --db-file to --db-remote clients of the same user on a Unix socket.  Their --info rows go to <db>.info.\n");
+	printf("--db-remote=<path>:  use a --db-serve server instead of a local DB.  --info rows are sent to it.\n");
+	printf("--db-capture=<file>:  save every DB query and the rows it returned to <file>.\n");
+	printf("--db-replay=<file>:  answer DB queries from a --db-capture file instead of the DB.\n");
 	printf("--data=<dir>: overwrite path to default smatch data directory.\n");
+	printf("--data-cache=<dir>:  keep a pre-tokenized copy of the smatch_data/ files in <dir>.\n");
+	printf("--header-cache=<dir>:  share the tokenized source and headers between runs through <dir>.\n");
 	printf("--full-path:  print the full pathname.\n");
+	printf("--lazy-inline:  only parse the inline functions from headers which are used.\n");
+	printf("--fast:  quicker and less precise, for checking a few files from a pre-commit hook.\n");
+	printf("--hugepages:  allocate memory in 2MB regions which can use transparent hugepages.\n");
+	printf("--mem-budget=<MB>:  give up on a function when Smatch is using more than this (default 3000).\n");
+	printf("--mem-pool[=<name>]:  share the cgroup memory limit with the other Smatch processes instead.\n");
+	printf("--func-budget=<seconds>:  give up on a function after this long (default 300).\n");
+	printf("--file-budget=<seconds>:  share this much time between all the functions (default no limit).\n");
+	printf("--state-budget=<n>:  turn a check off for the rest of a function after it allocates this many states (default 500000).\n");
+	printf("--return-budget=<n>:  stop splitting returns after a function has this many return_states (default 1000).\n");
+	printf("--jobs=<n>:  split the functions in a file between <n> worker processes.\n");
+	printf("--batch=<file>:  start up once and then check each compile command in <file>.\n");
+	printf("--batch-prefix:  with --batch, parse the #include lines which files start with once.\n");
+	printf("--numa:  with --batch, keep each worker on the CPUs and memory of one NUMA node.\n");
+	printf("--state-profile=<file>:  write how many states each check uses in each function to <file>.\n");
+	printf("--hook-profile=<file>:  write how many hook calls and cycles each check used to <file> at exit.\n");
+	printf("--sql-profile=<file>:  write how often each kind of DB query ran and how long it took to <file> at exit.\n");
+	printf("--sql-slow=<ms>:  list the queries which took longer than this in the --sql-profile file (default 50).\n");
+	printf("--stats=<file>:  append the time, peak memory, sm_states and merges for each file to <file> as JSON.\n");
+	printf("--time-stmt[=<n>]:  print the <n> slowest statements in each file with the source (default 10).\n");
+	printf("--profile=<file>:  append the time, statements, states, merges, pools and DB queries for each function to <file> as JSON.\n");
 	printf("--debug-implied:  print debug output about implications.\n");
 	printf("--assume-loops:  assume loops always go through at least once.\n");
 	printf("--two-passes:  use a two pass system for each function.\n");
 	printf("--file-output:  instead of printing stdout, print to \"file.c.smatch_out\".\n");
+	printf("--spool=<file>:  append the output of each file to <file>, <file>.sql and <file>.caller_info.\n");
+	printf("--gzip:  gzip the --spool and --file-output files.\n");
+	printf("--result-cache=<dir>:  save the output for each file in <dir> and reuse it if nothing changed.\n");
+	printf("--function-cache:  with --result-cache, only analyze the functions which changed in a changed file.\n");
+	printf("--inline-cache=<dir>:  share what the inline functions from headers return between files through <dir>.\n");
 	printf("--fatal-checks: check output is treated as an error.\n");
 	printf("--help:  print this helpful message.\n");
 	exit(1);
@@ -210,11 +405,101 @@ void parse_args(int *argcp, char ***argvp)
 			(*argvp)[1] = (*argvp)[0];
 			found = 1;
 		}
+		if (!found && !strncmp((*argvp)[1], "--db-serve=", 11)) {
+			option_db_serve = (*argvp)[1] + 11;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--db-remote=", 12)) {
+			option_db_remote = (*argvp)[1] + 12;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--db-capture=", 13)) {
+			option_db_capture = (*argvp)[1] + 13;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--db-replay=", 12)) {
+			option_db_replay = (*argvp)[1] + 12;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--db-cache-size=", 16)) {
+			option_db_cache_size = strtol((*argvp)[1] + 16, NULL, 0);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--db-mmap-size=", 15)) {
+			option_db_mmap_size = strtoll((*argvp)[1] + 15, NULL, 0);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--info-shard=", 13)) {
+			option_info_shard = (*argvp)[1] + 13;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strcmp((*argvp)[1], "--mem-pool")) {
+			option_mem_pool = (char *)"";
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--mem-pool=", 11)) {
+			option_mem_pool = (*argvp)[1] + 11;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--mem-budget=", 13)) {
+			option_mem_budget = strtol((*argvp)[1] + 13, NULL, 0);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--func-budget=", 14)) {
+			option_func_budget = strtol((*argvp)[1] + 14, NULL, 0);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--file-budget=", 14)) {
+			option_file_budget = strtol((*argvp)[1] + 14, NULL, 0);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--state-budget=", 15)) {
+			option_state_budget = strtol((*argvp)[1] + 15, NULL, 0);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--return-budget=", 16)) {
+			option_return_budget = strtol((*argvp)[1] + 16, NULL, 0);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--batch=", 8)) {
+			option_batch = (*argvp)[1] + 8;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--jobs=", 7)) {
+			option_jobs = strtol((*argvp)[1] + 7, NULL, 0);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
 		if (!found && !strncmp((*argvp)[1], "--data=", 7)) {
 			option_datadir_str = (*argvp)[1] + 7;
 			(*argvp)[1] = (*argvp)[0];
 			found = 1;
 		}
+		if (!found && !strncmp((*argvp)[1], "--data-cache=", 13)) {
+			option_data_cache = (*argvp)[1] + 13;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--header-cache=", 15)) {
+			tokenize_cache_dir = (*argvp)[1] + 15;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
 		if (!found && !strncmp((*argvp)[1], "--debug=", 8)) {
 			option_debug_check = (*argvp)[1] + 8;
 			(*argvp)[1] = (*argvp)[0];
@@ -225,6 +510,56 @@ void parse_args(int *argcp, char ***argvp)
 			(*argvp)[1] = (*argvp)[0];
 			found = 1;
 		}
+		if (!found && !strncmp((*argvp)[1], "--state-profile=", 16)) {
+			option_state_profile = (*argvp)[1] + 16;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--stats=", 8)) {
+			option_stats = (*argvp)[1] + 8;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--time-stmt=", 12)) {
+			option_time_stmt = atoi((*argvp)[1] + 12);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--profile=", 10)) {
+			option_profile = (*argvp)[1] + 10;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--spool=", 8)) {
+			option_spool = (*argvp)[1] + 8;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--result-cache=", 15)) {
+			option_result_cache = (*argvp)[1] + 15;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--inline-cache=", 15)) {
+			option_inline_cache = (*argvp)[1] + 15;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--sql-profile=", 14)) {
+			option_sql_profile = (*argvp)[1] + 14;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--sql-slow=", 11)) {
+			option_sql_slow_ms = atoi((*argvp)[1] + 11);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--hook-profile=", 15)) {
+			option_hook_profile = (*argvp)[1] + 15;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
 		if (!found && strncmp((*argvp)[1], "--trace=", 8) == 0) {
 			trace_variable = (*argvp)[1] + 8;
 			(*argvp)[1] = (*argvp)[0];
@@ -250,9 +585,12 @@ void parse_args(int *argcp, char ***argvp)
 		}
 
 		OPTION(fatal_checks);
+		OPTION(batch_prefix);
+		OPTION(numa);
 		OPTION(spammy);
 		OPTION(pedantic);
 		OPTION(info);
+		OPTION(sql_rows);
 		OPTION(debug);
 		OPTION(assume_loops);
 		OPTION(no_data);
@@ -261,17 +599,34 @@ void parse_args(int *argcp, char ***argvp)
 		OPTION(call_tree);
 		OPTION(file_output);
 		OPTION(time);
-		OPTION(time_stmt);
+		if (!found && match_option((*argvp)[1], "time_stmt")) {
+			option_time_stmt = 10;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
 		OPTION(mem);
 		OPTION(no_db);
+		OPTION(no_mmap_db);
+		OPTION(db_immutable);
+		OPTION(db_prefetch);
 		OPTION(succeed);
 		OPTION(print_names);
+		OPTION(hugepages);
+		OPTION(lazy_inline);
+		OPTION(fast);
+		OPTION(function_cache);
+		OPTION(gzip);
 		if (!found)
 			break;
 		(*argcp)--;
 		(*argvp)++;
 	}
 
+	hugepage_blobs = option_hugepages;
+
+	if (option_fast)
+		set_fast_options();
+
 	if (strcmp(option_project_str, "smatch_generic") != 0)
 		option_project = PROJ_UNKNOWN;
 
@@ -346,22 +701,646 @@ static char *get_data_dir(char *arg0)
 	return NULL;
 }
 
-int main(int argc, char **argv)
+static int exit_status(void)
+{
+	if (option_succeed)
+		return 0;
+	if (sm_nr_errors > 0)
+		return 1;
+	if (sm_nr_checks > 0 && option_fatal_checks)
+		return 1;
+	return 0;
+}
+
+/*
+ * The --batch file has one compile command per line.  The fields are
+ * separated by tabs.  The first field is the directory to run in and the
+ * rest are the sparse options and the .c file.  Use
+ * smatch_scripts/compile_commands_to_batch.pl to make this file from a
+ * compile_commands.json.  A line without a tab is just a .c file which is
+ * checked in the current directory, so a plain list of files works too.
+ */
+struct batch_job {
+	char *dir;
+	char **argv;
+	int argc;
+	char **includes;
+	int nr_includes;
+};
+
+static int read_batch_file(const char *filename, struct batch_job **jobs)
+{
+	struct batch_job *job;
+	char *line = NULL;
+	size_t size = 0;
+	int nr = 0, max = 0;
+	char *p, *field;
+	FILE *file;
+
+	file = fopen(filename, "r");
+	if (!file)
+		sm_fatal("cannot open batch file '%s'", filename);
+
+	while (getline(&line, &size, file) >= 0) {
+		line[strcspn(line, "\n")] = '\0';
+		if (!line[0] || line[0] == '#')
+			continue;
+		if (nr == max) {
+			max = max ? max * 2 : 64;
+			*jobs = realloc(*jobs, max * sizeof(**jobs));
+		}
+		job = &(*jobs)[nr++];
+		p = strdup(line);
+		job->dir = strchr(p, '\t') ? strsep(&p, "\t") : (char *)".";
+		job->argv = malloc((strlen(line) / 2 + 3) * sizeof(char *));
+		job->argc = 0;
+		job->argv[job->argc++] = (char *)"smatch";
+		while ((field = strsep(&p, "\t"))) {
+			if (field[0])
+				job->argv[job->argc++] = field;
+		}
+		job->argv[job->argc] = NULL;
+	}
+	free(line);
+	fclose(file);
+
+	return nr;
+}
+
+static void set_batch_output(FILE *out)
+{
+	sm_buffer_output(out);
+	if (sm_outfd == stdout)
+		sm_outfd = out;
+	if (sql_outfd == stdout)
+		sql_outfd = out;
+	if (caller_info_fd == stdout)
+		caller_info_fd = out;
+	info_shard_start();
+}
+
+static void __attribute__((noreturn)) check_batch_files(struct string_list *filelist)
+{
+	smatch(filelist);
+	if (option_hook_profile)
+		print_hook_profile();
+	if (option_sql_profile)
+		print_sql_profile();
+	info_shard_close();
+	fflush(NULL);
+	_exit(exit_status());
+}
+
+static void __attribute__((noreturn)) run_batch_job(struct batch_job *job, FILE *out)
 {
 	struct string_list *filelist = NULL;
+
+	if (chdir(job->dir)) {
+		sm_ierror("cannot chdir to '%s'", job->dir);
+		_exit(1);
+	}
+	set_batch_output(out);
+	sparse_add_options(job->argc, job->argv, &filelist);
+	check_batch_files(filelist);
+}
+
+static void copy_batch_output(FILE *out)
+{
+	char buf[4096];
+	size_t len;
+
+	rewind(out);
+	while ((len = fread(buf, 1, sizeof(buf), out)) > 0)
+		fwrite(buf, 1, len, stdout);
+	fclose(out);
+}
+
+/*
+ * Near the end of the batch there are fewer files left than --jobs so the
+ * last few files are given the spare workers to split their functions
+ * between.  This overcommits a bit while the earlier files finish, but
+ * otherwise the last big file runs on one core while the rest are idle.
+ */
+static int batch_job_workers(int left)
+{
+	int workers = option_jobs / left;
+
+	return workers > 1 ? workers : 1;
+}
+
+/* the index of the .c file in job->argv or zero */
+static int batch_job_file_idx(struct batch_job *job)
+{
+	int i, len, idx = 0;
+
+	for (i = 1; i < job->argc; i++) {
+		len = strlen(job->argv[i]);
+		if (len > 2 && strcmp(job->argv[i] + len - 2, ".c") == 0)
+			idx = i;
+	}
+	return idx;
+}
+
+static char *batch_job_file(struct batch_job *job)
+{
+	int idx = batch_job_file_idx(job);
+
+	return idx ? job->argv[idx] : NULL;
+}
+
+static int save_batch_cost(void *_cost, int argc, char **argv, char **azColName)
+{
+	long long *cost = _cost;
+
+	if (argv[0])
+		*cost = strtoll(argv[0], NULL, 10);
+	return 0;
+}
+
+/*
+ * Returns how many milliseconds the functions in the .c file of the job
+ * took last time according to the FUNC_TIME rows in the DB, or -1 if the
+ * file isn't there.  The file id is the hash of the name as it was passed
+ * or of the full path for --full-path so try both.
+ */
+static long long batch_job_cost(struct batch_job *job)
+{
+	char path[PATH_MAX];
+	long long cost = -1;
+	const char *file;
+
+	file = batch_job_file(job);
+	if (!file)
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/%s", job->dir, file);
+	run_sql(save_batch_cost, &cost,
+		"select sum(value) from return_implies where type = %d and file in (%lld, %lld);",
+		FUNC_TIME, str_to_llu_hash(file), str_to_llu_hash(path));
+	return cost;
+}
+
+static long long *batch_costs;
+
+static int cmp_batch_cost(const void *_a, const void *_b)
+{
+	int a = *(const int *)_a;
+	int b = *(const int *)_b;
+
+	if (batch_costs[a] != batch_costs[b])
+		return batch_costs[a] > batch_costs[b] ? -1 : 1;
+	return a - b;
+}
+
+/*
+ * Start the files which took longest last time first so a big file doesn't
+ * start at the end and hold everything up.  Files which aren't in the DB
+ * are counted as average.
+ */
+static int *get_batch_order(struct batch_job *jobs, int nr)
+{
+	long long total = 0;
+	int known = 0;
+	int *order;
 	int i;
-	reg_func func;
 
-	/* Ignore the "-o io.o" option.  That's for the compiler. */
-	do_output = 0;
-	sm_outfd = stdout;
-	sql_outfd = stdout;
-	caller_info_fd = stdout;
+	order = malloc(nr * sizeof(*order));
+	batch_costs = malloc(nr * sizeof(*batch_costs));
+	for (i = 0; i < nr; i++) {
+		order[i] = i;
+		batch_costs[i] = batch_job_cost(&jobs[i]);
+		if (batch_costs[i] >= 0) {
+			total += batch_costs[i];
+			known++;
+		}
+	}
+	for (i = 0; i < nr; i++) {
+		if (batch_costs[i] < 0)
+			batch_costs[i] = known ? total / known : 0;
+	}
+	qsort(order, nr, sizeof(*order), cmp_batch_cost);
+	free(batch_costs);
+	batch_costs = NULL;
 
-	parse_args(&argc, &argv);
+	return order;
+}
 
-	if (argc < 2)
-		help();
+/*
+ * Returns the next thing on the line which isn't a space or a comment, or
+ * NULL at the end of the line.  "comment" says if the line starts inside a
+ * block comment and it is updated for the next line.
+ */
+static char *skip_c_blanks(char *p, bool *comment)
+{
+	while (1) {
+		if (*comment) {
+			p = strstr(p, "*/");
+			if (!p)
+				return NULL;
+			p += 2;
+			*comment = false;
+		}
+		p += strspn(p, " \t\r\n");
+		if (strncmp(p, "/*", 2) == 0) {
+			*comment = true;
+			p += 2;
+			continue;
+		}
+		if (!*p || strncmp(p, "//", 2) == 0)
+			return NULL;
+		return p;
+	}
+}
+
+/*
+ * Saves the #include <...> lines which the .c file starts with.  Blank
+ * lines and comments are skipped and anything else ends the list.  Only
+ * the <...> includes are used because they are found the same way from
+ * any file in the directory.
+ */
+static void read_batch_includes(struct batch_job *job)
+{
+	char path[PATH_MAX];
+	char *line = NULL;
+	bool comment = false;
+	size_t size = 0;
+	const char *file;
+	char *p, *end;
+	int max = 0;
+	FILE *f;
+
+	file = batch_job_file(job);
+	if (!file)
+		return;
+	if (file[0] == '/')
+		snprintf(path, sizeof(path), "%s", file);
+	else
+		snprintf(path, sizeof(path), "%s/%s", job->dir, file);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+
+	while (getline(&line, &size, f) >= 0) {
+		p = skip_c_blanks(line, &comment);
+		if (!p)
+			continue;
+		if (strncmp(p, "#include", 8) != 0)
+			break;
+		p += 8;
+		p += strspn(p, " \t");
+		end = strchr(p, '>');
+		if (*p != '<' || !end)
+			break;
+		end++;
+		if (skip_c_blanks(end, &comment) || comment)
+			break;
+		if (job->nr_includes == max) {
+			max = max ? max * 2 : 16;
+			job->includes = realloc(job->includes, max * sizeof(char *));
+		}
+		job->includes[job->nr_includes++] = strndup(p, end - p);
+	}
+	free(line);
+	fclose(f);
+}
+
+/*
+ * With --batch-prefix the jobs which have the same directory and options
+ * and which start with the same #include are put together in a unit.  The
+ * unit parses the #include lines they all start with and then forks for
+ * each of the files.  The units are kept small enough that the --jobs
+ * still have something to share out.
+ */
+struct batch_unit {
+	int *jobs;
+	int nr;
+	int nr_includes;
+};
+
+static char **batch_keys;
+static int *batch_pos;
+
+static char *batch_job_key(struct batch_job *job)
+{
+	char *key, *p;
+	int i, idx, len;
+
+	if (!job->nr_includes)
+		return NULL;
+
+	idx = batch_job_file_idx(job);
+	len = strlen(job->dir) + strlen(job->includes[0]) + 2;
+	for (i = 1; i < job->argc; i++)
+		len += strlen(job->argv[i]) + 1;
+
+	key = malloc(len);
+	p = key + sprintf(key, "%s\t%s", job->dir, job->includes[0]);
+	for (i = 1; i < job->argc; i++) {
+		if (i != idx)
+			p += sprintf(p, "\t%s", job->argv[i]);
+	}
+	return key;
+}
+
+static int cmp_batch_key(const void *_a, const void *_b)
+{
+	int a = *(const int *)_a;
+	int b = *(const int *)_b;
+	int ret;
+
+	if (!batch_keys[a] || !batch_keys[b]) {
+		if (batch_keys[a] != batch_keys[b])
+			return batch_keys[a] ? -1 : 1;
+	} else {
+		ret = strcmp(batch_keys[a], batch_keys[b]);
+		if (ret)
+			return ret;
+	}
+	return batch_pos[a] - batch_pos[b];
+}
+
+static int cmp_batch_unit(const void *_a, const void *_b)
+{
+	const struct batch_unit *a = _a;
+	const struct batch_unit *b = _b;
+
+	return batch_pos[a->jobs[0]] - batch_pos[b->jobs[0]];
+}
+
+static int common_includes(struct batch_job *a, struct batch_job *b, int max)
+{
+	int i;
+
+	for (i = 0; i < max && i < b->nr_includes; i++) {
+		if (strcmp(a->includes[i], b->includes[i]) != 0)
+			break;
+	}
+	return i;
+}
+
+static int get_batch_units(struct batch_job *jobs, int nr, int *order,
+			   struct batch_unit **units)
+{
+	struct batch_unit *unit = NULL;
+	int i, j, max_size, nr_units = 0;
+	int *idx;
+
+	max_size = nr / (option_jobs * 4);
+	if (max_size < 2)
+		max_size = 2;
+
+	batch_keys = calloc(nr, sizeof(*batch_keys));
+	batch_pos = malloc(nr * sizeof(*batch_pos));
+	idx = malloc(nr * sizeof(*idx));
+	for (i = 0; i < nr; i++) {
+		batch_pos[order[i]] = i;
+		idx[i] = i;
+		if (option_batch_prefix && !option_result_cache) {
+			read_batch_includes(&jobs[i]);
+			batch_keys[i] = batch_job_key(&jobs[i]);
+		}
+	}
+	qsort(idx, nr, sizeof(*idx), cmp_batch_key);
+
+	*units = calloc(nr, sizeof(**units));
+	for (i = 0; i < nr; i++) {
+		j = idx[i];
+		if (!unit || unit->nr == max_size || !batch_keys[j] ||
+		    strcmp(batch_keys[j], batch_keys[unit->jobs[0]]) != 0) {
+			unit = &(*units)[nr_units++];
+			unit->jobs = malloc(max_size * sizeof(int));
+			unit->nr_includes = jobs[j].nr_includes;
+		} else {
+			unit->nr_includes = common_includes(&jobs[unit->jobs[0]], &jobs[j],
+							    unit->nr_includes);
+		}
+		unit->jobs[unit->nr++] = j;
+		if (!batch_keys[j])
+			unit = NULL;
+	}
+	qsort(*units, nr_units, sizeof(**units), cmp_batch_unit);
+
+	for (i = 0; i < nr; i++)
+		free(batch_keys[i]);
+	free(batch_keys);
+	free(batch_pos);
+	free(idx);
+	batch_keys = NULL;
+	batch_pos = NULL;
+
+	return nr_units;
+}
+
+static void __attribute__((noreturn)) run_batch_unit(struct batch_job *jobs,
+						     struct batch_unit *unit,
+						     FILE **outs)
+{
+	struct string_list *filelist = NULL;
+	struct batch_job *job;
+	int i, len = 0, wstatus, ret = 0;
+	char *buf, *p, *file;
+	pid_t pid;
+
+	if (unit->nr == 1 || !unit->nr_includes)
+		run_batch_job(&jobs[unit->jobs[0]], outs[unit->jobs[0]]);
+
+	job = &jobs[unit->jobs[0]];
+	if (chdir(job->dir)) {
+		sm_ierror("cannot chdir to '%s'", job->dir);
+		_exit(1);
+	}
+	sparse_add_options(job->argc, job->argv, &filelist);
+
+	for (i = 0; i < unit->nr_includes; i++)
+		len += strlen("#include \n") + strlen(job->includes[i]);
+	buf = p = malloc(len + 1);
+	for (i = 0; i < unit->nr_includes; i++)
+		p += sprintf(p, "#include %s\n", job->includes[i]);
+	smatch_prefix(buf, unit->nr_includes);
+
+	for (i = 0; i < unit->nr; i++) {
+		job = &jobs[unit->jobs[i]];
+		fflush(NULL);
+		pid = fork();
+		if (pid < 0)
+			sm_fatal("fork() failed");
+		if (pid == 0) {
+			filelist = NULL;
+			file = batch_job_file(job);
+			add_ptr_list(&filelist, file);
+			set_batch_output(outs[unit->jobs[i]]);
+			check_batch_files(filelist);
+		}
+		if (waitpid(pid, &wstatus, 0) < 0 ||
+		    !WIFEXITED(wstatus) || WEXITSTATUS(wstatus))
+			ret = 1;
+	}
+	_exit(ret);
+}
+
+/*
+ * With --numa each batch worker is put on the node with the fewest workers
+ * running.  How many files each node did and how long its workers took is
+ * printed at the end so the nodes can be compared.
+ */
+struct numa_stats {
+	int running;
+	int files;
+	unsigned long long busy_ns;
+};
+
+static unsigned long long batch_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int pick_numa_node(struct numa_stats *stats, int nodes)
+{
+	int i, best = 0;
+
+	for (i = 1; i < nodes; i++) {
+		if (stats[i].running < stats[best].running)
+			best = i;
+	}
+	return best;
+}
+
+static void print_numa_stats(struct numa_stats *stats, int nodes,
+			     unsigned long long elapsed_ns)
+{
+	double secs = elapsed_ns / 1e9;
+	int i;
+
+	for (i = 0; i < nodes; i++) {
+		fprintf(stderr, "numa node %d: %d files, %.1fs busy, %.2f files/s\n",
+			numa_node_id(i), stats[i].files, stats[i].busy_ns / 1e9,
+			secs > 0 ? stats[i].files / secs : 0);
+	}
+}
+
+/*
+ * Everything up to the first file is done once and then each file is
+ * checked in a forked child so it starts from a clean copy of the state.
+ * The --jobs option says how many children to run at once.  They are
+ * started longest first but their output is printed in the same order as
+ * the batch file.
+ */
+static int run_batch(const char *filename)
+{
+	struct batch_job *jobs = NULL;
+	struct batch_unit *units, *unit;
+	FILE **outs;
+	pid_t *pids;
+	int *status;
+	bool *done;
+	int nr, nr_units, running = 0, next = 0, printed = 0;
+	struct numa_stats *node_stats = NULL;
+	unsigned long long *unit_start = NULL;
+	unsigned long long start = 0;
+	int *unit_node = NULL;
+	int nodes = 0;
+	int *order;
+	int ret = 0;
+	pid_t pid;
+	int i, j, wstatus;
+
+	nr = read_batch_file(filename, &jobs);
+	order = get_batch_order(jobs, nr);
+	nr_units = get_batch_units(jobs, nr, order, &units);
+	outs = calloc(nr, sizeof(*outs));
+	pids = calloc(nr_units, sizeof(*pids));
+	status = calloc(nr, sizeof(*status));
+	done = calloc(nr, sizeof(*done));
+
+	if (option_numa && numa_nr_nodes() > 1) {
+		nodes = numa_nr_nodes();
+		node_stats = calloc(nodes, sizeof(*node_stats));
+		unit_node = calloc(nr_units, sizeof(*unit_node));
+		unit_start = calloc(nr_units, sizeof(*unit_start));
+		start = batch_now();
+	}
+
+	if (data_dir)
+		data_dir = realpath(data_dir, NULL) ?: data_dir;
+	if (option_data_cache)
+		option_data_cache = realpath(option_data_cache, NULL) ?: option_data_cache;
+	if (tokenize_cache_dir)
+		tokenize_cache_dir = realpath(tokenize_cache_dir, NULL) ?: tokenize_cache_dir;
+	bin_dir = realpath(bin_dir, NULL) ?: bin_dir;
+
+	while (printed < nr) {
+		while (next < nr_units && running < option_jobs) {
+			unit = &units[next];
+			for (i = 0; i < unit->nr; i++) {
+				j = unit->jobs[i];
+				outs[j] = tmpfile();
+				if (!outs[j])
+					sm_fatal("tmpfile() failed");
+			}
+			if (nodes) {
+				unit_node[next] = pick_numa_node(node_stats, nodes);
+				node_stats[unit_node[next]].running++;
+				unit_start[next] = batch_now();
+			}
+			fflush(NULL);
+			pids[next] = fork();
+			if (pids[next] < 0)
+				sm_fatal("fork() failed");
+			if (pids[next] == 0) {
+				if (nodes)
+					numa_bind_node(unit_node[next]);
+				option_jobs = batch_job_workers(nr_units - next);
+				run_batch_unit(jobs, unit, outs);
+			}
+			running++;
+			next++;
+		}
+
+		pid = waitpid(-1, &wstatus, 0);
+		if (pid < 0)
+			break;
+		for (i = 0; i < nr_units; i++) {
+			if (pids[i] != pid)
+				continue;
+			unit = &units[i];
+			for (j = 0; j < unit->nr; j++) {
+				done[unit->jobs[j]] = true;
+				status[unit->jobs[j]] = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 1;
+			}
+			if (nodes) {
+				node_stats[unit_node[i]].running--;
+				node_stats[unit_node[i]].files += unit->nr;
+				node_stats[unit_node[i]].busy_ns += batch_now() - unit_start[i];
+			}
+			running--;
+		}
+		while (printed < nr && done[printed]) {
+			copy_batch_output(outs[printed]);
+			if (status[printed])
+				ret = 1;
+			printed++;
+		}
+	}
+	fflush(stdout);
+	if (nodes)
+		print_numa_stats(node_stats, nodes, batch_now() - start);
+
+	if (option_succeed)
+		return 0;
+	return ret;
+}
+
+/*
+ * This is everything after the Smatch options are parsed, up to the point
+ * where the files can be checked.  sm_bench uses it as well.
+ */
+void smatch_initialize(int argc, char **argv, struct string_list **filelist)
+{
+	reg_func func;
+	int i;
 
 	/* this gets set back to zero when we parse the first function */
 	final_pass = 1;
@@ -370,11 +1349,16 @@ int main(int argc, char **argv)
 	data_dir = get_data_dir(argv[0]);
 
 	allocate_hook_memory();
+	if (option_hook_profile)
+		atexit(print_hook_profile);
+	if (option_sql_profile)
+		atexit(print_sql_profile);
 	allocate_dynamic_states_array(num_checks);
 	allocate_tracker_array(num_checks);
 	create_function_hook_hash();
 	open_smatch_db(option_db_file);
-	sparse_initialize(argc, argv, &filelist);
+	result_cache_hash_db(option_db_file);
+	sparse_initialize(argc, argv, filelist);
 	alloc_ptr_constants();
 	SMATCH_EXTRA = id_from_name("register_smatch_extra");
 	allocate_modification_hooks();
@@ -386,19 +1370,66 @@ int main(int argc, char **argv)
 		   0 is used for internal stuff. */
 		if (!option_enable || reg_funcs[i].enabled == 1 ||
 		    (option_disable && reg_funcs[i].enabled != -1) ||
-		    strncmp(reg_funcs[i].name, "register_", 9) == 0)
+		    (strncmp(reg_funcs[i].name, "register_", 9) == 0 &&
+		     module_is_needed(i)))
 			func(i);
 	}
 	__cur_check_id = 0;
+}
+
+/* the preprocessed_hook, the caches both want to see the tokens */
+static void preprocessed(struct token *token)
+{
+	if (option_result_cache)
+		result_cache_hash_tokens(token);
+	if (option_inline_cache)
+		inline_cache_save_tokens(token);
+}
+
+/* weak so that sm_bench can link against smatch.o with its own main() */
+__attribute__((weak)) int main(int argc, char **argv)
+{
+	struct string_list *filelist = NULL;
+
+	/* Ignore the "-o io.o" option.  That's for the compiler. */
+	do_output = 0;
+	sm_outfd = stdout;
+	sql_outfd = stdout;
+	caller_info_fd = stdout;
+	sm_buffer_output(stdout);
+
+	result_cache_hash_args(argc, argv);
+	inline_cache_hash_args(argc, argv);
+	parse_args(&argc, &argv);
+
+	if (option_db_serve)
+		return db_serve(option_db_file, option_db_serve);
+
+	if (argc < 2 && !option_batch)
+		help();
+
+	mem_pool_open(option_db_file);
+	if (option_inline_cache) {
+		mkdir(option_inline_cache, 0777);
+		option_inline_cache = realpath(option_inline_cache, NULL) ?: option_inline_cache;
+	}
+	if (option_info_shard) {
+		mkdir(option_info_shard, 0777);
+		option_info_shard = realpath(option_info_shard, NULL) ?: option_info_shard;
+	}
+	if (option_result_cache)
+		mkdir(option_result_cache, 0777);
+	if (option_result_cache || option_inline_cache)
+		preprocessed_hook = preprocessed;
+
+	smatch_initialize(argc, argv, &filelist);
 
+	if (option_batch)
+		return run_batch(option_batch);
+
+	info_shard_start();
 	smatch(filelist);
 	free_string(data_dir);
 
-	if (option_succeed)
-		return 0;
-	if (sm_nr_errors > 0)
-		return 1;
-	if (sm_nr_checks > 0 && option_fatal_checks)
-		return 1;
-	return 0;
+	return exit_status();
 }
@@ -31,6 +31,7 @@
 #include "expression.h"
 #include "avl.h"
 #include "smatch_constants.h"
+#include "smatch_sql_values.h"
 
 typedef long long mtag_t;
 
@@ -80,6 +81,7 @@ struct sm_state {
 	unsigned short owner;
 	unsigned short merged:1;
 	unsigned short leaf:1;
+	unsigned short possible_bits:14;
 	unsigned int line;
   	struct smatch_state *state;
 	struct stree *pool;
@@ -112,6 +114,54 @@ struct bit_info {
 	unsigned long long possible;
 };
 
+/*
+ * The bits in ->set are known to be one and the bits which aren't in
+ * ->possible are known to be zero.  These work on the values so the callers
+ * only allocate a bit_info for what they keep.
+ */
+static inline struct bit_info binfo_and(struct bit_info one, struct bit_info two)
+{
+	return (struct bit_info){ one.set & two.set, one.possible & two.possible };
+}
+
+static inline struct bit_info binfo_or(struct bit_info one, struct bit_info two)
+{
+	return (struct bit_info){ one.set | two.set, one.possible | two.possible };
+}
+
+static inline struct bit_info binfo_xor(struct bit_info one, struct bit_info two)
+{
+	unsigned long long known;
+	struct bit_info ret;
+
+	known = (one.set | ~one.possible) & (two.set | ~two.possible);
+	ret.set = (one.set ^ two.set) & known;
+	ret.possible = ret.set | ~known;
+	return ret;
+}
+
+static inline struct bit_info binfo_shl(struct bit_info binfo, int shift)
+{
+	return (struct bit_info){ binfo.set << shift, binfo.possible << shift };
+}
+
+/* This is an unsigned shift */
+static inline struct bit_info binfo_shr(struct bit_info binfo, int shift)
+{
+	return (struct bit_info){ binfo.set >> shift, binfo.possible >> shift };
+}
+
+/* What is true on either path */
+static inline struct bit_info binfo_merge(struct bit_info one, struct bit_info two)
+{
+	return (struct bit_info){ one.set & two.set, one.possible | two.possible };
+}
+
+static inline struct bit_info binfo_mask(struct bit_info binfo, unsigned long long mask)
+{
+	return (struct bit_info){ binfo.set & mask, binfo.possible & mask };
+}
+
 enum hook_type {
 	EXPR_HOOK,
 	EXPR_HOOK_AFTER,
@@ -201,6 +251,11 @@ void add_allocation_hook_early(alloc_hook *hook);
 void add_allocation_hook(alloc_hook *func);
 
 void add_hook(void *func, enum hook_type type);
+#define EXPR_TYPE_BIT(type) (1ULL << (type))
+void add_expr_type_hook(void *func, enum hook_type type, unsigned long long expr_types);
+void add_two_pass_check(int owner);
+bool __has_two_pass_checks(void);
+extern bool __first_pass;
 typedef struct smatch_state *(merge_func_t)(struct smatch_state *s1, struct smatch_state *s2);
 typedef struct smatch_state *(unmatched_func_t)(struct sm_state *state);
 void add_merge_hook(int client_id, merge_func_t *func);
@@ -294,10 +349,13 @@ extern struct symbol *cur_func_sym;
 extern int option_debug;
 extern int local_debug;
 extern int debug_db;
+extern unsigned long sql_query_count;
+extern unsigned long long sql_query_ns;
 extern bool implied_debug;
 bool debug_implied(void);
 bool debug_on(const char *check_name, const char *var);
 extern int option_info;
+extern int option_sql_rows;
 extern int option_spammy;
 extern int option_pedantic;
 extern int option_print_names;
@@ -305,6 +363,7 @@ extern char *trace_variable;
 extern struct stree *global_states;
 void set_function_skipped(void);
 int is_skipped_function(void);
+int is_skipped_function_name(const char *func);
 int is_silenced_function(void);
 extern bool implications_off;
 
@@ -317,6 +376,7 @@ void set_path_impossible(void);
 extern FILE *sm_outfd;
 extern FILE *sql_outfd;
 extern FILE *caller_info_fd;
+void sm_buffer_output(FILE *fd);
 extern int sm_nr_checks;
 extern int sm_nr_errors;
 
@@ -481,7 +541,12 @@ struct stree *get_all_states_from_stree(int owner, struct stree *source);
 struct stree *get_all_states_stree(int id);
 struct stree *__get_cur_stree(void);
 int is_reachable(void);
-void add_get_state_hook(void (*fn)(int owner, const char *name, struct symbol *sym));
+enum get_state_filter {
+	GET_STATE_ALL,
+	GET_STATE_PARAMS,	/* only the parameters of cur_func_sym */
+};
+void add_get_state_hook(void (*fn)(int owner, const char *name, struct symbol *sym),
+			enum get_state_filter filter);
 
 static inline void set_undefined(struct sm_state *sm, struct expression *mod_expr)
 {
@@ -522,6 +587,15 @@ char *expr_to_str_sym(struct expression *expr,
 				     struct symbol **sym_ptr);
 char *expr_to_var_sym(struct expression *expr,
 			     struct symbol **sym_ptr);
+/*
+ * The _buf() versions write the name into buf instead of allocating it.
+ * They return buf or NULL.
+ */
+#define VAR_LEN 512
+char *expr_to_str_sym_buf(struct expression *expr, struct symbol **sym_ptr,
+			  char *buf, int len);
+char *expr_to_var_sym_buf(struct expression *expr, struct symbol **sym_ptr,
+			  char *buf, int len);
 char *expr_to_known_chunk_sym(struct expression *expr, struct symbol **sym);
 char *expr_to_chunk_sym_vsl(struct expression *expr, struct symbol **sym, struct var_sym_list **vsl);
 int get_complication_score(struct expression *expr);
@@ -551,6 +625,9 @@ int implied_condition_false(struct expression *expr);
 int can_integer_overflow(struct symbol *type, struct expression *expr);
 void clear_math_cache(void);
 void clear_strip_cache(void);
+void clear_recurse_cache(void);
+int get_sym_nr(struct symbol *sym);
+void clear_sym_nrs(void);
 void set_fast_math_only(void);
 void clear_fast_math_only(void);
 
@@ -696,6 +773,8 @@ int in_condition(void);
 
 /* smatch_flow.c */
 
+void print_json_str(FILE *file, const char *str);
+
 extern int __in_fake_assign;
 extern unsigned long __in_fake_parameter_assign;
 extern int __in_fake_struct_assign;
@@ -707,6 +786,7 @@ extern int __debug_skip;
 extern int in_fake_env;
 bool is_fake_var_assign(struct expression *expr);
 struct expression *get_fake_return_variable(struct expression *expr);
+void smatch_prefix(const char *buf, int nr_includes);
 void smatch (struct string_list *filelist);
 int inside_loop(void);
 int definitely_inside_loop(void);
@@ -722,7 +802,24 @@ extern int __in_function_def;
 extern int __in_unmatched_hook;
 extern int option_assume_loops;
 extern int option_two_passes;
+extern int option_lazy_inline;
+extern int option_fast;
+extern int option_gzip;
 extern int option_no_db;
+extern int option_no_mmap_db;
+extern int option_db_cache_size;
+extern int option_mem_budget;
+extern int option_state_budget;
+extern int option_func_budget;
+extern int option_file_budget;
+extern int option_jobs;
+extern int option_return_budget;
+extern long long option_db_mmap_size;
+extern int option_db_immutable;
+extern int option_db_prefetch;
+extern char *option_db_remote;
+extern char *option_db_capture;
+extern char *option_db_replay;
 extern int option_file_output;
 extern int option_time;
 extern int option_time_stmt;
@@ -739,13 +836,16 @@ extern bool __reparsing_code;
 extern struct expression *__inline_fn;
 extern int __in_pre_condition;
 extern int __bail_on_rest_of_function;
+extern int __degraded_pass;
 extern struct statement *__prev_stmt;
 extern struct statement *__cur_stmt;
 extern struct statement *__next_stmt;
 void init_fake_env(void);
 void end_fake_env(void);
 int time_parsing_function(void);
+int func_budget_ms(void);
 bool taking_too_long(void);
+void __use_up_func_budget(void);
 struct statement *get_last_stmt(void);
 int is_last_stmt(struct statement *cur_stmt);
 
@@ -771,12 +871,10 @@ int __handle_select_assigns(struct expression *expr);
 int __handle_expr_statement_assigns(struct expression *expr);
 
 /* smatch_implied.c */
-struct range_list_stack;
 void turn_off_implications(int id);
 void param_limit_implications(struct expression *expr, int param, char *key, char *value, struct stree **implied);
 struct stree *__implied_case_stree(struct expression *switch_expr,
 				   struct range_list *case_rl,
-				   struct range_list_stack **remaining_cases,
 				   struct stree **raw_stree);
 void overwrite_states_using_pool(struct sm_state *gate_sm, struct sm_state *pool_sm);
 int assume(struct expression *expr);
@@ -909,6 +1007,15 @@ void add_check_tracker(const char *check_name, check_tracker_hook *fn);
 
 /* smatch_hooks.c */
 void __pass_to_client(void *data, enum hook_type type);
+unsigned long long __hook_profile_start(void);
+void __hook_profile_stop(int owner, unsigned long long start);
+void print_hook_profile(void);
+
+/* smatch_stmt_profile.c */
+void stmt_profile_start(struct statement *stmt);
+void stmt_profile_stop(void);
+void stmt_profile_hook(int owner, unsigned long long cycles);
+void print_stmt_profile(void);
 void __pass_case_to_client(struct expression *switch_expr,
 			   struct range_list *rl);
 int __has_merge_function(int client_id);
@@ -1061,7 +1168,6 @@ enum info_type {
 };
 
 extern struct sqlite3 *smatch_db;
-extern struct sqlite3 *mem_db;
 extern struct sqlite3 *cache_db;
 
 bool db_incomplete(void);
@@ -1102,8 +1208,13 @@ char *get_data_info_name(struct expression *expr);
 char *sm_to_arg_name(struct expression *expr, struct sm_state *sm);
 int is_recursive_member(const char *param_name);
 
+void sql_print_insert(const char *table, int ignore, int late, char *values);
+void sql_flush_rows(void);
+void sql_group_rows_start(void);
+void sql_group_rows_end(void);
 char *escape_newlines(const char *str);
 void sql_exec(struct sqlite3 *db, int (*callback)(void*, int, char**, char**), void *data, const char *sql);
+void print_sql_profile(void);
 
 #define sql_helper(db, call_back, data, sql...)					\
 do {										\
@@ -1122,18 +1233,62 @@ do {										\
 	sql_helper(smatch_db, call_back, data, sql);				\
 } while (0)
 
-#define mem_sql(call_back, data, sql...)					\
-	sql_helper(mem_db, call_back, data, sql)
-
 #define cache_sql(call_back, data, sql...)					\
 	sql_helper(cache_db, call_back, data, sql)
 
+void sql_exec_bound(struct sqlite3 *db, int (*callback)(void*, int, char**, char**),
+		    void *data, const char *sql, const char *types, ...);
+void sql_exec_static(struct sqlite3 *db, int (*callback)(void*, int, char**, char**),
+		     void *data, struct symbol *sym, const char *sql);
+
+#define run_sql_bound(call_back, data, sql, types, args...)			\
+do {										\
+	if (option_no_db)							\
+		break;								\
+	sql_exec_bound(smatch_db, call_back, data, sql, types, args);		\
+} while (0)
+
+/* smatch_mem_db.c: the rows saved while inlining a function */
+void mem_db_insert(const char *table, int ignore, const char *values);
+void mem_db_select(const char *table, const char *cols, bool distinct,
+		   unsigned long long call_id,
+		   int (*callback)(void*, int, char**, char**), void *data);
+void mem_db_clear(void);
+bool mem_db_load_inline(struct symbol *fn, unsigned long long call_id);
+void mem_db_save_inline(struct symbol *fn, unsigned long long call_id);
+void mem_db_clear_inline_cache(void);
+void inline_cache_hash_args(int argc, char **argv);
+void inline_cache_save_tokens(struct token *token);
+extern char *option_inline_cache;
+
+/*
+ * Same as run_sql() except that the SQL is expected to contain
+ * get_static_filter_bound(sym) and it goes through the prepared statement
+ * cache.
+ */
+#define run_sql_static(call_back, data, sym, sql...)				\
+do {										\
+	char sql_txt[1024];							\
+										\
+	if (option_no_db)							\
+		break;								\
+	sqlite3_snprintf(sizeof(sql_txt), sql_txt, sql);			\
+	sql_exec_static(smatch_db, call_back, data, sym, sql_txt);		\
+} while (0)
+
 #define sql_insert_helper(table, db, ignore, late, values...)			\
 do {										\
 	struct sqlite3 *_db = db;						\
 										\
-	if (__inline_fn && !_db)						\
-		_db = mem_db;							\
+	if (__inline_fn && !_db) {						\
+		char buf[1024];							\
+										\
+		snprintf(buf, sizeof(buf), values);				\
+		db_debug("mem-db: insert %sinto %s values (%s);\n",		\
+			 ignore ? "or ignore " : "", #table, buf);		\
+		mem_db_insert(#table, ignore, buf);				\
+		break;								\
+	}									\
 	if (_db) {								\
 		char buf[1024];							\
 		char *err, *p = buf;						\
@@ -1155,6 +1310,13 @@ do {										\
 	}									\
 	if (option_info) {							\
 		FILE *tmp_fd = sm_outfd;					\
+		char row[4096];							\
+										\
+		if (snprintf(row, sizeof(row), values) < sizeof(row)) {	\
+			sql_print_insert(#table, ignore, late, row);		\
+			break;							\
+		}								\
+		sql_flush_rows();						\
 		sm_outfd = sql_outfd;						\
 		sm_prefix();							\
 	        sm_printf("SQL%s: insert %sinto " #table " values(",		\
@@ -1172,6 +1334,7 @@ do {										\
 #define sql_insert_cache_or_ignore(table, values...) sql_insert_helper(table, cache_db, 1, 0, values);
 
 char *get_static_filter(struct symbol *sym);
+const char *get_static_filter_bound(struct symbol *sym);
 
 void sql_insert_return_states(int return_id, const char *return_ranges,
 		int type, int param, const char *key, const char *value);
@@ -1211,6 +1374,56 @@ void sql_select_call_implies(const char *cols, struct expression *call,
 
 void open_smatch_db(char *db_file);
 
+/* smatch_db_mmap.c */
+void open_mmap_db(const char *db_file);
+bool mmap_db_select(const char *table_name, const char *cols, bool distinct,
+		    const char *key, int is_static, long long file,
+		    int (*callback)(void*, int, char**, char**), void *data);
+bool mmap_db_count(const char *table_name, const char *key, int is_static,
+		   long long file, int *count);
+bool mmap_db_has_table(const char *table_name);
+
+/* smatch_db_server.c */
+int db_serve(const char *db_file, const char *addr);
+bool db_remote_open(const char *addr);
+bool db_remote_connected(void);
+bool db_remote_exec_needed(void);
+void db_remote_exec(const char *sql, int (*callback)(void*, int, char**, char**), void *data);
+FILE *db_remote_info_file(void);
+bool db_capture_open(const char *file);
+bool db_replay_open(const char *file);
+
+/* smatch_db_prefetch.c */
+void db_prefetch_open(const char *name, int flags);
+void db_prefetch_symbols(struct symbol_list *sym_list);
+
+/* smatch_info_shard.c */
+extern char *option_info_shard;
+void info_shard_start(void);
+void info_shard_close(void);
+
+/* smatch_numa.c */
+int numa_nr_nodes(void);
+int numa_node_id(int idx);
+void numa_bind_node(int idx);
+
+/* smatch_mem_pool.c */
+extern char *option_mem_pool;
+void mem_pool_open(const char *db_file);
+unsigned long mem_budget_kb(void);
+bool mem_pool_low(void);
+
+/* smatch_result_cache.c */
+void result_cache_hash_args(int argc, char **argv);
+void result_cache_hash_db(const char *db_file);
+void result_cache_hash_data_file(int fd);
+void result_cache_hash_tokens(struct token *token);
+bool result_cache_lookup(struct symbol_list *sym_list);
+bool result_cache_function_lookup(struct symbol *sym);
+void result_cache_function_save(void);
+void result_cache_save(void);
+extern int option_function_cache;
+
 /* smatch_files.c */
 int open_data_file(const char *filename);
 int open_schema_file(const char *schema);
@@ -1221,15 +1434,29 @@ struct string_list *load_strings_from_file(const char *project, const char *file
 extern char *option_debug_check;
 extern char *option_debug_var;
 extern char *option_state_cnt;
+extern char *option_state_profile;
+extern char *option_hook_profile;
+extern char *option_sql_profile;
+extern int option_sql_slow_ms;
+extern char *option_spool;
+extern char *option_result_cache;
+extern char *option_stats;
+extern char *option_profile;
 extern char *option_process_function;
 extern char *option_project_str;
 extern char *bin_dir;
 extern char *data_dir;
 extern int option_no_data;
+extern char *option_data_cache;
 extern int option_full_path;
 extern int option_call_tree;
 extern int num_checks;
 
+static inline bool hook_profiling(void)
+{
+	return option_hook_profile || option_time_stmt;
+}
+
 enum project_type {
 	PROJ_NONE,
 	PROJ_KERNEL,
@@ -1240,7 +1467,9 @@ enum project_type {
 };
 extern enum project_type option_project;
 const char *check_name(unsigned short id);
+bool is_check_module(int id);
 int id_from_name(const char *name);
+void smatch_initialize(int argc, char **argv, struct string_list **filelist);
 
 
 /* smatch_buf_size.c */
@@ -1546,6 +1775,39 @@ int get_address_rl(struct expression *expr, struct range_list **rl);
 int get_member_offset(struct symbol *type, const char *member_name);
 int get_member_offset_from_deref(struct expression *expr);
 
+/* smatch_struct_layout.c */
+struct layout_member {
+	struct symbol *sym;
+	int offset;
+};
+
+struct struct_layout {
+	struct symbol *type;
+	int nr;
+	struct layout_member *members;
+	/* the member before the first hole and where the hole is */
+	struct symbol *hole_after;
+	bool hole_at_end;
+	int end_align;
+	/* members on the way to the hole with no alignment */
+	int unaligned;
+	bool resizable;
+	struct struct_layout *next;
+};
+const struct struct_layout *get_struct_layout(struct symbol *type);
+
+/* smatch_fn_traits.c */
+struct fn_traits {
+	struct symbol *sym;
+	bool fresh_alloc;
+	bool leaf;
+	bool sleeps;
+	/* milliseconds it took to parse last time */
+	unsigned long time;
+	struct fn_traits *next;
+};
+const struct fn_traits *get_fn_traits(struct symbol *sym);
+
 /* for now this is in smatch_used_parameter.c */
 void __get_state_hook(int owner, const char *name, struct symbol *sym);
 extern int __ignore_param_used;
@@ -1561,6 +1823,19 @@ struct range_list *get_fs(void);
 
 struct stree *get_all_return_states(void);
 struct stree_stack *get_all_return_strees(void);
+
+struct return_path {
+	struct stree *stree;
+	struct sm_state *return_sm;
+	struct range_list *rl;
+	sval_t line;
+	int bucket;	/* success_fail_return() */
+};
+int get_return_paths(struct return_path **paths);
+void sweep_return_states(int owner,
+			 void (*callback)(struct return_path *path, struct sm_state *sm, void *data),
+			 void *data);
+
 int on_atomic_dec_path(void);
 int was_inced(const char *name, struct symbol *sym);
 int refcount_was_inced_name_sym(const char *name, struct symbol *sym, const char *counter_str);
@@ -1617,10 +1892,12 @@ void __set_param_modified_helper_sym_clear(const char *name, struct symbol *sym,
 struct bit_info *rl_to_binfo(struct range_list *rl);
 struct bit_info *get_bit_info(struct expression *expr);
 struct bit_info *get_bit_info_var_sym(const char *name, struct symbol *sym);
+bool get_bits_state(struct expression *expr, struct bit_info *res);
 
 /* smatch_mem_tracker.c */
 extern int option_mem;
 unsigned long get_mem_kb(void);
+unsigned long get_allocated_kb(void);
 unsigned long get_max_memory(void);
 
 /* smatch_goto_tracker.c */
@@ -1802,4 +2079,25 @@ static inline int sval_cmp(sval_t one, sval_t two)
 	return 1;
 }
 
+/*
+ * True if "one" and "two" are the same type and would print the same.  For
+ * floating point types .uvalue is only the low bits (the mantissa of a long
+ * double) so the value has to be compared as a float.  Zero and minus zero
+ * compare equal as floats so the sign is checked as well.
+ */
+static inline bool sval_identical(sval_t one, sval_t two)
+{
+	if (one.type != two.type)
+		return false;
+	if (!sval_is_fp(one))
+		return one.uvalue == two.uvalue;
+	if (fp_cmp(one, two) != 0)
+		return false;
+	if (one.type == &float_ctype)
+		return !__builtin_signbit(one.fvalue) == !__builtin_signbit(two.fvalue);
+	if (one.type == &double_ctype)
+		return !__builtin_signbit(one.dvalue) == !__builtin_signbit(two.dvalue);
+	return !__builtin_signbit(one.ldvalue) == !__builtin_signbit(two.ldvalue);
+}
+
 #endif 	    /* !SMATCH_H_ */
@@ -84,32 +84,22 @@ static bool matches_anonymous_union(struct symbol *sym, const char *member_name)
 
 int get_member_offset(struct symbol *type, const char *member_name)
 {
+	const struct struct_layout *layout;
 	struct symbol *tmp;
-	int offset;
-	int bits;
+	int i;
 
-	if (!type || type->type != SYM_STRUCT)
+	layout = get_struct_layout(type);
+	if (!layout)
 		return -1;
 
-	bits = 0;
-	offset = 0;
-	FOR_EACH_PTR(type->symbol_list, tmp) {
-		if (bits_to_bytes(bits + type_bits(tmp)) > tmp->ctype.alignment) {
-			offset += bits_to_bytes(bits);
-			bits = 0;
-		}
-		offset = ALIGN(offset, tmp->ctype.alignment);
+	for (i = 0; i < layout->nr; i++) {
+		tmp = layout->members[i].sym;
 		if (tmp->ident &&
-		    strcmp(member_name, tmp->ident->name) == 0) {
-			return offset;
-		}
+		    strcmp(member_name, tmp->ident->name) == 0)
+			return layout->members[i].offset;
 		if (matches_anonymous_union(tmp, member_name))
-			return offset;
-		if (!(type_bits(tmp) % 8) && type_bits(tmp) / 8 == type_bytes(tmp))
-			offset += type_bytes(tmp);
-		else
-			bits += type_bits(tmp);
-	} END_FOR_EACH_PTR(tmp);
+			return layout->members[i].offset;
+	}
 	return -1;
 }
 
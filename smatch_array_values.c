@@ -105,19 +105,175 @@ static char *get_array_name(struct expression *array)
 	return NULL;
 }
 
+/*
+ * The DB doesn't change while a file is parsed so the rows for an array are
+ * kept until the end of the file.  The values of the static arrays of the
+ * file are read with one query the first time one is needed.  The range
+ * lists are allocated per function so only the text is kept and the
+ * ranges are remade in each function.
+ */
+struct array_rows {
+	char *name;
+	bool is_static;
+	int nr, max;
+	char **values;
+	struct array_rows *next;
+};
+
+struct sym_rows {
+	struct symbol *sym;
+	struct array_rows *rows;
+	struct sym_rows *next;
+};
+
+#define ARRAY_HASH_SIZE 256
+static struct array_rows *rows_hash[ARRAY_HASH_SIZE];
+static struct sym_rows *sym_hash[ARRAY_HASH_SIZE];
+static bool static_rows_loaded;
+
+static unsigned int rows_hashval(const char *name, bool is_static)
+{
+	return (str_to_llu_hash(name) + is_static) % ARRAY_HASH_SIZE;
+}
+
+static struct array_rows *find_rows(const char *name, bool is_static, bool create)
+{
+	struct array_rows *rows;
+	unsigned int hash;
+
+	hash = rows_hashval(name, is_static);
+	for (rows = rows_hash[hash]; rows; rows = rows->next) {
+		if (rows->is_static == is_static && strcmp(rows->name, name) == 0)
+			return rows;
+	}
+	if (!create)
+		return NULL;
+
+	rows = calloc(1, sizeof(*rows));
+	rows->name = strdup(name);
+	rows->is_static = is_static;
+	rows->next = rows_hash[hash];
+	rows_hash[hash] = rows;
+	return rows;
+}
+
+static void add_row(struct array_rows *rows, const char *value)
+{
+	if (rows->nr == rows->max) {
+		rows->max = rows->max ? rows->max * 2 : 4;
+		rows->values = realloc(rows->values, rows->max * sizeof(*rows->values));
+	}
+	rows->values[rows->nr++] = strdup(value);
+}
+
+static int get_row(void *_rows, int argc, char **argv, char **azColName)
+{
+	add_row(_rows, argv[0]);
+	return 0;
+}
+
+static int get_static_row(void *unused, int argc, char **argv, char **azColName)
+{
+	add_row(find_rows(argv[0], true, true), argv[1]);
+	return 0;
+}
+
+static void load_static_rows(void)
+{
+	if (static_rows_loaded)
+		return;
+	static_rows_loaded = true;
+
+	run_sql(&get_static_row, NULL,
+		"select sink_name, value from sink_info where file = '%s' and static = 1 and type = %d;",
+		get_filename(), DATA_VALUE);
+}
+
+static struct array_rows *get_static_rows(struct expression *array)
+{
+	struct sym_rows *sr;
+	struct symbol *sym;
+	unsigned int hash;
+	char *name;
+
+	sym = array->symbol;
+	hash = ((unsigned long)sym >> 4) % ARRAY_HASH_SIZE;
+	for (sr = sym_hash[hash]; sr; sr = sr->next) {
+		if (sr->sym == sym)
+			return sr->rows;
+	}
+
+	name = get_toplevel_name(array);
+	if (!name)
+		return NULL;
+	load_static_rows();
+
+	sr = calloc(1, sizeof(*sr));
+	sr->sym = sym;
+	sr->rows = find_rows(name, true, true);
+	sr->next = sym_hash[hash];
+	sym_hash[hash] = sr;
+	return sr->rows;
+}
+
+static struct array_rows *get_member_rows(struct expression *array)
+{
+	struct array_rows *rows;
+	char *name;
+
+	name = get_member_array(array);
+	if (!name)
+		return NULL;
+
+	rows = find_rows(name, false, false);
+	if (rows)
+		return rows;
+
+	rows = find_rows(name, false, true);
+	run_sql(&get_row, rows,
+		"select value from sink_info where sink_name = '%s' and type = %d limit 10;",
+		name, DATA_VALUE);
+	return rows;
+}
+
+static void free_array_rows(void)
+{
+	struct array_rows *rows, *next;
+	struct sym_rows *sr, *sr_next;
+	int i, j;
+
+	for (i = 0; i < ARRAY_HASH_SIZE; i++) {
+		for (rows = rows_hash[i]; rows; rows = next) {
+			next = rows->next;
+			for (j = 0; j < rows->nr; j++)
+				free(rows->values[j]);
+			free(rows->values);
+			free(rows->name);
+			free(rows);
+		}
+		rows_hash[i] = NULL;
+		for (sr = sym_hash[i]; sr; sr = sr_next) {
+			sr_next = sr->next;
+			free(sr);
+		}
+		sym_hash[i] = NULL;
+	}
+	static_rows_loaded = false;
+}
+
 static struct {
-	const char *name;
+	struct array_rows *rows;
+	struct symbol *type;
 	struct range_list *rl;
 } cached_results[4];
 
-static bool get_cached_select(const char *name, struct range_list **rl)
+static bool get_cached_rl(struct array_rows *rows, struct symbol *type, struct range_list **rl)
 {
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(cached_results); i++) {
-		if (!cached_results[i].name)
-			continue;
-		if (strcmp(name, cached_results[i].name) == 0) {
+		if (cached_results[i].rows == rows &&
+		    cached_results[i].type == type) {
 			*rl = cached_results[i].rl;
 			return true;
 		}
@@ -125,13 +281,14 @@ static bool get_cached_select(const char *name, struct range_list **rl)
 	return false;
 }
 
-static void store_result(const char *name, struct range_list *rl)
+static void store_result(struct array_rows *rows, struct symbol *type, struct range_list *rl)
 {
 	static int idx;
 
 	idx = (idx + 1) % ARRAY_SIZE(cached_results);
 
-	cached_results[idx].name = name;
+	cached_results[idx].rows = rows;
+	cached_results[idx].type = type;
 	cached_results[idx].rl = rl;
 }
 
@@ -143,39 +300,39 @@ void clear_array_values_cache(void)
 int get_array_rl(struct expression *expr, struct range_list **rl)
 {
 	struct expression *array;
+	struct array_rows *rows;
 	struct symbol *type;
-	struct db_info db_info = {};
-	char *name;
+	struct range_list *tmp, *ret = NULL;
+	int i;
 
 	type = get_type(expr);
 	if (!type || type->type != SYM_BASETYPE)
 		return 0;
-	db_info.type = type;
 
 	array = get_array_base(expr);
-	name = get_array_name(array);
-	if (!name)
+	type = get_type(array);
+	if (!type || type->type != SYM_ARRAY)
 		return 0;
+	type = get_type(expr);
 
-	if (get_cached_select(name, rl))
-		return 1;
+	if (array->type == EXPR_SYMBOL && is_file_local(array))
+		rows = get_static_rows(array);
+	else
+		rows = get_member_rows(array);
+	if (!rows)
+		return 0;
 
-	if (is_file_local(array)) {
-		run_sql(&get_vals, &db_info,
-			"select value from sink_info where file = '%s' and static = 1 and sink_name = '%s' and type = %d;",
-			get_filename(), name, DATA_VALUE);
-	} else {
-		run_sql(&get_vals, &db_info,
-			"select value from sink_info where sink_name = '%s' and type = %d limit 10;",
-			name, DATA_VALUE);
+	if (!get_cached_rl(rows, type, &ret)) {
+		for (i = 0; i < rows->nr; i++) {
+			str_to_rl(type, rows->values[i], &tmp);
+			ret = rl_union(ret, tmp);
+		}
+		store_result(rows, type, ret);
 	}
-	if (db_info.count >= 10)
-		db_info.rl = NULL;
-	store_result(name, db_info.rl);
-	if (!db_info.rl)
+	if (!ret)
 		return 0;
 
-	*rl = db_info.rl;
+	*rl = ret;
 	return 1;
 }
 
@@ -196,6 +353,54 @@ static void update_cache(char *name, int is_static, struct range_list *rl)
 		  get_filename(), is_static, name, DATA_VALUE, show_rl(rl));
 }
 
+/*
+ * A global initializer can set thousands of elements of the same array.
+ * Instead of reading back and rewriting the cached row for each one, the
+ * values are collected here and written once when the declaration is done.
+ */
+struct pending_array {
+	char *name;
+	int is_static;
+	struct symbol *type;
+	struct range_list *rl;
+};
+static struct pending_array *pending;
+static int nr_pending, max_pending;
+
+static void add_pending(char *name, int is_static, struct symbol *type, struct range_list *rl)
+{
+	int i;
+
+	for (i = 0; i < nr_pending; i++) {
+		if (strcmp(pending[i].name, name) == 0) {
+			pending[i].rl = rl_union(pending[i].rl, rl);
+			return;
+		}
+	}
+	if (nr_pending == max_pending) {
+		max_pending = max_pending ? max_pending * 2 : 8;
+		pending = realloc(pending, max_pending * sizeof(*pending));
+	}
+	pending[nr_pending].name = name;
+	pending[nr_pending].is_static = is_static;
+	pending[nr_pending].type = type;
+	pending[nr_pending].rl = rl;
+	nr_pending++;
+}
+
+static void flush_pending(struct symbol *sym)
+{
+	struct range_list *rl;
+	int i;
+
+	for (i = 0; i < nr_pending; i++) {
+		rl = get_saved_rl(pending[i].type, pending[i].name);
+		rl = rl_union(rl, pending[i].rl);
+		update_cache(pending[i].name, pending[i].is_static, rl);
+	}
+	nr_pending = 0;
+}
+
 static void match_assign(struct expression *expr)
 {
 	struct expression *left, *array;
@@ -215,6 +420,12 @@ static void match_assign(struct expression *expr)
 	if (!name)
 		return;
 
+	if (expr->op == '=' && outside_of_function()) {
+		get_absolute_rl(expr->right, &rl);
+		add_pending(name, is_file_local(array), type, cast_rl(type, rl));
+		return;
+	}
+
 	if (expr->op != '=') {
 		rl = alloc_whole_rl(get_type(expr->right));
 		rl = cast_rl(type, rl);
@@ -253,6 +464,8 @@ void register_array_values(int id)
 
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_hook(&match_assign, GLOBAL_ASSIGNMENT_HOOK);
+	add_hook(&flush_pending, DECLARATION_HOOK_AFTER);
+	add_hook(&free_array_rows, END_FILE_HOOK);
 
 	add_function_hook("sprintf", &mark_strings_unknown, INT_PTR(0));
 	add_function_hook("snprintf", &mark_strings_unknown, INT_PTR(0));
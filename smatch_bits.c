@@ -77,34 +77,32 @@ static unsigned long long get_type_possible(struct symbol *type)
 	return (1ULL << type_bits(type)) - 1;
 }
 
-static struct bit_info *alloc_unknown_binfo(struct symbol *type)
+static struct bit_info rl_to_bits(struct range_list *rl)
 {
-	struct bit_info *ret;
-
-	ret = __alloc_bit_info(0);
-	ret->possible = get_type_possible(type);
-	return ret;
-}
-
-struct bit_info *rl_to_binfo(struct range_list *rl)
-{
-	struct bit_info *ret = __alloc_bit_info(0);
+	struct bit_info ret;
 	sval_t sval;
 
 	if (rl_to_sval(rl, &sval)) {
-		ret->set = sval.uvalue;
-		ret->possible = sval.uvalue;
+		ret.set = sval.uvalue;
+		ret.possible = sval.uvalue;
 
 		return ret;
 	}
 
-	ret->set = 0;
-	ret->possible = sval_fls_mask(rl_max(rl));
+	ret.set = 0;
+	ret.possible = sval_fls_mask(rl_max(rl));
 	// FIXME: what about negatives?
 
 	return ret;
 }
 
+struct bit_info *rl_to_binfo(struct range_list *rl)
+{
+	struct bit_info bits = rl_to_bits(rl);
+
+	return alloc_bit_info(bits.set, bits.possible);
+}
+
 static bool is_unknown_binfo(struct symbol *type, struct bit_info *binfo)
 {
 	if (!type)
@@ -123,12 +121,12 @@ static struct smatch_state *unmatched_state(struct sm_state *sm)
 	struct smatch_state *estate;
 	struct symbol *type;
 	unsigned long long possible;
-	struct bit_info *p;
+	struct bit_info bits;
 
 	estate = get_state(SMATCH_EXTRA, sm->name, sm->sym);
 	if (estate_rl(estate)) {
-		p = rl_to_binfo(estate_rl(estate));
-		return alloc_bstate(p->set, p->possible);
+		bits = rl_to_bits(estate_rl(estate));
+		return alloc_bstate(bits.set, bits.possible);
 	}
 
 	type = estate_type(estate);
@@ -199,6 +197,7 @@ struct smatch_state *merge_bstates(struct smatch_state *one_state,
 				   struct smatch_state *two_state)
 {
 	struct bit_info *one, *two;
+	struct bit_info bits;
 
 	one = one_state->data;
 	two = two_state->data;
@@ -206,7 +205,8 @@ struct smatch_state *merge_bstates(struct smatch_state *one_state,
 	if (binfo_equiv(one, two))
 		return one_state;
 
-	return alloc_bstate(one->set & two->set, one->possible | two->possible);
+	bits = binfo_merge(*one, *two);
+	return alloc_bstate(bits.set, bits.possible);
 }
 
 /*
@@ -218,148 +218,164 @@ struct smatch_state *merge_bstates(struct smatch_state *one_state,
  * set bits, which is the opposite of what merge_bstates() does.
  *
  */
-static struct bit_info *combine_bit_info(struct bit_info *one,
-					 struct bit_info *two)
+static struct bit_info combine_bit_info(struct bit_info one,
+					struct bit_info two)
 {
-	struct bit_info *ret = __alloc_bit_info(0);
+	struct bit_info ret;
 
-	if ((one->set & two->possible) != one->set)
-		return alloc_bit_info(0, -1ULL);
-	if ((two->set & one->possible) != two->set)
-		return alloc_bit_info(0, -1ULL);
+	if ((one.set & two.possible) != one.set ||
+	    (two.set & one.possible) != two.set) {
+		ret.set = 0;
+		ret.possible = -1ULL;
+		return ret;
+	}
 
-	ret->set = one->set | two->set;
-	ret->possible = one->possible & two->possible;
+	ret.set = one.set | two.set;
+	ret.possible = one.possible & two.possible;
 
 	return ret;
 }
 
-static struct bit_info *binfo_AND(struct bit_info *left,
-				  struct bit_info *right)
-{
-	unsigned long long set = 0;
-	unsigned long long possible = -1ULL;
-
-	if (!left && !right) {
-		/* nothing */
-	} else if (!left) {
-		possible = right->possible;
-	} else if (!right) {
-		possible = left->possible;
-	} else {
-		set = left->set & right->set;
-		possible = left->possible & right->possible;
-	}
-
-	return alloc_bit_info(set, possible);
-}
+static struct bit_info get_bits(struct expression *expr);
 
-static struct bit_info *binfo_OR(struct bit_info *left, struct bit_info *right)
+static bool get_shift(struct expression *expr, int *shift)
 {
-	unsigned long long set = 0;
-	unsigned long long possible = -1ULL;
-
-	if (!left && !right) {
-		/* nothing */
-	} else if (!left) {
-		set = right->set;
-	} else if (!right) {
-		set = left->set;
-	} else {
-		set = left->set | right->set;
-		possible = left->possible | right->possible;
-	}
+	sval_t sval;
 
-	return alloc_bit_info(set, possible);
+	if (!get_implied_value(expr, &sval))
+		return false;
+	if (sval_is_negative(sval) || sval.uvalue >= 64)
+		return false;
+	*shift = sval.uvalue;
+	return true;
 }
 
-static struct bit_info *binfo_LEFTSHIFT(struct expression *left, struct expression *right)
+static bool binfo_LEFTSHIFT(struct expression *left, struct expression *right,
+			    struct bit_info *res)
 {
-	struct bit_info *bit_info;
 	struct symbol *type;
-	unsigned long long set;
-	unsigned long long possible;
-	sval_t sval;
+	int shift;
 
 	type = get_type(left);
 	if (!type)
-		return NULL;
+		return false;
+	if (!get_shift(right, &shift))
+		return false;
 
-	bit_info = get_bit_info(left);
-	if (!bit_info)
-		bit_info = alloc_unknown_binfo(type);
+	*res = binfo_mask(binfo_shl(get_bits(left), shift), get_type_possible(type));
+	return true;
+}
 
-	if (!get_implied_value(right, &sval))
-		return NULL;
+static bool binfo_RIGHTSHIFT(struct expression *left, struct expression *right,
+			     struct bit_info *res)
+{
+	struct bit_info bits;
+	struct symbol *type;
+	int shift;
 
-	set = bit_info->set << sval.uvalue;
-	possible = bit_info->possible << sval.uvalue;
+	type = get_type(left);
+	if (!type)
+		return false;
+	if (!get_shift(right, &shift))
+		return false;
 
-	set &= get_type_possible(type); 
-	possible &= get_type_possible(type);
+	bits = binfo_mask(get_bits(left), get_type_possible(type));
+	/* a negative number shifts in ones */
+	if (!type_unsigned(type) &&
+	    (bits.possible & (1ULL << (type_bits(type) - 1))))
+		return false;
 
-	return alloc_bit_info(set, possible);
+	*res = binfo_shr(bits, shift);
+	return true;
 }
 
-static struct bit_info *handle_binop(struct expression *expr)
+static bool handle_binop(struct expression *expr, struct bit_info *res)
 {
 	if (expr->type != EXPR_BINOP)
-		return NULL;
+		return false;
 
 	switch (expr->op) {
 	case '&':
-		return binfo_AND(get_bit_info(expr->left),
-				 get_bit_info(expr->right));
+		*res = binfo_and(get_bits(expr->left), get_bits(expr->right));
+		return true;
 	case '|':
-		return binfo_OR(get_bit_info(expr->left),
-				get_bit_info(expr->right));
+		*res = binfo_or(get_bits(expr->left), get_bits(expr->right));
+		return true;
+	case '^':
+		*res = binfo_mask(binfo_xor(get_bits(expr->left), get_bits(expr->right)),
+				  get_type_possible(get_type(expr)));
+		return true;
 	case SPECIAL_LEFTSHIFT:
-		return binfo_LEFTSHIFT(expr->left, expr->right);
+		return binfo_LEFTSHIFT(expr->left, expr->right, res);
+	case SPECIAL_RIGHTSHIFT:
+		return binfo_RIGHTSHIFT(expr->left, expr->right, res);
 	}
 
-	return NULL;
+	return false;
 }
 
-struct bit_info *get_bit_info(struct expression *expr)
+static struct bit_info get_bits(struct expression *expr)
 {
 	struct range_list *rl;
 	struct smatch_state *bstate;
-	struct bit_info *extra_info;
-	struct bit_info *bit_info;
+	struct bit_info extra_info;
+	struct bit_info bit_info;
 	struct bit_info unknown_bit_info = { };
 	sval_t known;
 
 	expr = strip_parens(expr);
 
-	if (get_implied_value(expr, &known))
-		return alloc_bit_info(known.value, known.value);
+	if (get_implied_value(expr, &known)) {
+		bit_info.set = known.value;
+		bit_info.possible = known.value;
+		return bit_info;
+	}
 
-	bit_info = handle_binop(expr);
-	if (bit_info)
+	if (handle_binop(expr, &bit_info))
 		return bit_info;
 
 	unknown_bit_info.possible = get_type_possible(get_type(expr));
 
 	if (get_implied_rl(expr, &rl))
-		extra_info = rl_to_binfo(rl);
+		extra_info = rl_to_bits(rl);
 	else
-		extra_info = &unknown_bit_info;
+		extra_info = unknown_bit_info;
 
 	bstate = get_state_expr(my_id, expr);
 	if (bstate)
-		bit_info = bstate->data;
+		bit_info = *(struct bit_info *)bstate->data;
 	else
-		bit_info = &unknown_bit_info;
+		bit_info = unknown_bit_info;
 
 	return combine_bit_info(extra_info, bit_info);
 }
 
+struct bit_info *get_bit_info(struct expression *expr)
+{
+	struct bit_info bits = get_bits(expr);
+
+	return alloc_bit_info(bits.set, bits.possible);
+}
+
+/*
+ * This only looks at what was recorded for "expr" so smatch_math.c can use
+ * it without recursing back into itself.
+ */
+bool get_bits_state(struct expression *expr, struct bit_info *res)
+{
+	struct smatch_state *bstate;
+
+	bstate = get_state_expr(my_id, expr);
+	if (!bstate || !bstate->data)
+		return false;
+	*res = *(struct bit_info *)bstate->data;
+	return true;
+}
+
 static void match_compare(struct expression *expr)
 {
 	sval_t val;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
 	if (expr->op != SPECIAL_EQUAL &&
 	    expr->op != SPECIAL_NOTEQUAL)
 		return;
@@ -374,33 +390,18 @@ static void match_compare(struct expression *expr)
 
 static void match_assign(struct expression *expr)
 {
-	struct bit_info *start, *binfo;
 	struct bit_info new;
-	unsigned long long mask;
 
 	if (!handled_by_assign_hook(expr))
 		return;
 
-	binfo = get_bit_info(expr->right);
-	if (expr->op == '=') {
-		new.set = binfo->set;
-		new.possible = binfo->possible;
-	} else if (expr->op == SPECIAL_OR_ASSIGN) {
-		start = get_bit_info(expr->left);
-		new.set = start->set | binfo->set;
-		new.possible = start->possible | binfo->possible;
-		goto done;
-	} else if (expr->op == SPECIAL_AND_ASSIGN) {
-		start = get_bit_info(expr->left);
-		new.set = start->set & binfo->set;
-		new.possible = start->possible & binfo->possible;
-		goto done;
-	}
+	new = get_bits(expr->right);
+	if (expr->op == SPECIAL_OR_ASSIGN)
+		new = binfo_or(get_bits(expr->left), new);
+	else if (expr->op == SPECIAL_AND_ASSIGN)
+		new = binfo_and(get_bits(expr->left), new);
 
-done:
-	mask = get_type_possible(get_type(expr->left));
-	new.set &= mask;
-	new.possible &= mask;
+	new = binfo_mask(new, get_type_possible(get_type(expr->left)));
 
 	if (is_unknown_binfo(get_type(expr->left), &new) &&
 	    !get_state_expr(my_id, expr->left))
@@ -411,7 +412,7 @@ done:
 
 static void match_condition(struct expression *expr)
 {
-	struct bit_info *orig;
+	struct bit_info orig;
 	struct bit_info true_info;
 	struct bit_info false_info;
 	sval_t right;
@@ -423,11 +424,11 @@ static void match_condition(struct expression *expr)
 	if (!get_value(expr->right, &right))
 		return;
 
-	orig = get_bit_info(expr->left);
-	true_info = *orig;
-	false_info = *orig;
+	orig = get_bits(expr->left);
+	true_info = orig;
+	false_info = orig;
 
-	if (sval_is_power_of_two(right) && (orig->possible & right.uvalue))
+	if (sval_is_power_of_two(right) && (orig.possible & right.uvalue))
 		true_info.set |= right.uvalue;
 	false_info.possible &= ~right.uvalue;
 
@@ -438,7 +439,7 @@ static void match_condition(struct expression *expr)
 
 static void match_call_info(struct expression *expr)
 {
-	struct bit_info *binfo, *rl_binfo;
+	struct bit_info binfo, rl_binfo;
 	struct expression *arg;
 	struct range_list *rl;
 	char buf[64];
@@ -447,19 +448,17 @@ static void match_call_info(struct expression *expr)
 	i = -1;
 	FOR_EACH_PTR(expr->args, arg) {
 		i++;
-		binfo = get_bit_info(arg);
-		if (!binfo)
-			continue;
-		if (is_unknown_binfo(get_type(arg), binfo))
+		binfo = get_bits(arg);
+		if (is_unknown_binfo(get_type(arg), &binfo))
 			continue;
 		if (get_implied_rl(arg, &rl)) {
-			rl_binfo = rl_to_binfo(rl);
-			if (binfo_equiv(rl_binfo, binfo))
+			rl_binfo = rl_to_bits(rl);
+			if (binfo_equiv(&rl_binfo, &binfo))
 				continue;
 		}
 		// If is just non-negative continue
 		// If ->set == ->possible continue
-		snprintf(buf, sizeof(buf), "0x%llx,0x%llx", binfo->set, binfo->possible);
+		snprintf(buf, sizeof(buf), "0x%llx,0x%llx", binfo.set, binfo.possible);
 		sql_insert_caller_info(expr, BIT_INFO, i, "$", buf);
 	} END_FOR_EACH_PTR(arg);
 }
@@ -468,7 +467,7 @@ static void struct_member_callback(struct expression *call, int param, char *pri
 {
 	struct bit_info *binfo = sm->state->data;
 	struct smatch_state *estate;
-	struct bit_info *implied_binfo;
+	struct bit_info implied_binfo;
 	char buf[64];
 
 	if (!binfo)
@@ -488,8 +487,8 @@ static void struct_member_callback(struct expression *call, int param, char *pri
 		if (estate_get_single_value(estate, &sval))
 			return;
 
-		implied_binfo = rl_to_binfo(estate_rl(estate));
-		if (binfo_equiv(implied_binfo, binfo))
+		implied_binfo = rl_to_bits(estate_rl(estate));
+		if (binfo_equiv(&implied_binfo, binfo))
 			return;
 	}
 
@@ -538,19 +537,16 @@ static void returns_bit_clear(struct expression *expr, int param, char *key, cha
 {
 	char *name;
 	struct symbol *sym;
-	unsigned long long possible;
 	char *pEnd;
-	struct bit_info *binfo;
+	struct bit_info binfo;
 
 	name = get_name_sym_from_param_key(expr, param, key, &sym);
 
 	if (!name)
 		return;
 
-	binfo = get_bit_info(expr);
-	possible = strtoull(value, &pEnd, 16);
-	set_state(my_id, name, sym, alloc_bstate(possible & binfo->set,
-						 possible & binfo->possible));
+	binfo = binfo_mask(get_bits(expr), strtoull(value, &pEnd, 16));
+	set_state(my_id, name, sym, alloc_bstate(binfo.set, binfo.possible));
 }
 
 void register_bits(int id)
@@ -563,7 +559,7 @@ void register_bits(int id)
 	add_merge_hook(my_id, &merge_bstates);
 
 	add_hook(&match_condition, CONDITION_HOOK);
-	add_hook(&match_compare, CONDITION_HOOK);
+	add_expr_type_hook(&match_compare, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_modification_hook(my_id, &match_modify);
 
@@ -187,15 +187,39 @@ static int db_size_callback(void *unused, int argc, char **argv, char **azColNam
 	return 0;
 }
 
-static struct expression *cached_type_expr, *cached_sym_expr;
-static struct range_list *cached_type_rl, *cached_sym_rl;
+/*
+ * The buffer overflow checks ask about the same struct members and globals
+ * over and over and the DB doesn't change while we're running, so remember
+ * what it said.  The sizes are saved as strings because the range lists are
+ * freed at the end of every function.  An empty string means the DB didn't
+ * know.
+ */
+static DEFINE_HASHTABLE_INSERT(insert_db_size, char, char);
+static DEFINE_HASHTABLE_SEARCH(search_db_size, char, char);
+static struct hashtable *db_size_cache;
 
-static void match_clear_cache(struct symbol *sym)
+static bool get_cached_db_size(const char *key, struct range_list **rl)
 {
-	cached_type_expr = NULL;
-	cached_type_rl = NULL;
-	cached_sym_expr = NULL;
-	cached_sym_rl = NULL;
+	char *size;
+
+	*rl = NULL;
+	if (!db_size_cache)
+		return false;
+	size = search_db_size(db_size_cache, (char *)key);
+	if (!size)
+		return false;
+	if (size[0])
+		str_to_rl(&int_ctype, size, rl);
+	return true;
+}
+
+static struct range_list *save_cached_db_size(const char *key, struct range_list *rl)
+{
+	if (!db_size_cache)
+		db_size_cache = create_function_hashtable(1000);
+	insert_db_size(db_size_cache, alloc_string(key),
+		       alloc_string(rl ? show_rl(rl) : ""));
+	return rl;
 }
 
 static char *get_stored_buffer_name(struct expression *buffer, bool *add_static)
@@ -232,38 +256,43 @@ static char *get_stored_buffer_name(struct expression *buffer, bool *add_static)
 
 static struct range_list *size_from_db_type(struct expression *expr)
 {
+	struct range_list *rl;
 	bool this_file_only;
+	char key[128];
 	char *name;
 
 	name = get_stored_buffer_name(expr, &this_file_only);
 	if (!name)
 		return NULL;
 
-	if (expr == cached_type_expr)
-		return clone_rl(cached_type_rl);
-	cached_type_expr = expr;
-	cached_type_rl = NULL;
+	if (this_file_only)
+		snprintf(key, sizeof(key), "file %llx %s", get_file_id(), name);
+	else
+		snprintf(key, sizeof(key), "type %s", name);
+	if (get_cached_db_size(key, &rl))
+		goto free;
 
+	db_size_rl = NULL;
 	if (this_file_only) {
-		db_size_rl = NULL;
 		run_sql(db_size_callback, NULL,
 			"select size from function_type_size where type = '%s' and file = %d;",
 			name, get_file_id());
-		cached_type_rl = clone_rl(db_size_rl);
-		return db_size_rl;
+	} else if (!mmap_db_select("type_size", "size", false, name, 0, 0, db_size_callback, NULL)) {
+		run_sql(db_size_callback, NULL,
+			"select size from type_size where type = '%s';",
+			name);
 	}
-
-	db_size_rl = NULL;
-	run_sql(db_size_callback, NULL,
-		"select size from type_size where type = '%s';",
-		name);
-	cached_type_rl = clone_rl(db_size_rl);
-	return db_size_rl;
+	rl = save_cached_db_size(key, db_size_rl);
+free:
+	free_string(name);
+	return rl;
 }
 
 static struct range_list *size_from_db_symbol(struct expression *expr)
 {
+	struct range_list *rl;
 	struct symbol *sym;
+	char key[128];
 
 	if (expr->type != EXPR_SYMBOL)
 		return NULL;
@@ -273,17 +302,15 @@ static struct range_list *size_from_db_symbol(struct expression *expr)
 	    sym->ctype.modifiers & MOD_STATIC)
 		return NULL;
 
-	if (expr == cached_sym_expr)
-		return clone_rl(cached_sym_rl);
-	cached_sym_expr = expr;
-	cached_sym_rl = NULL;
+	snprintf(key, sizeof(key), "global %s", sym->ident->name);
+	if (get_cached_db_size(key, &rl))
+		return rl;
 
 	db_size_rl = NULL;
 	run_sql(db_size_callback, NULL,
 		"select value from data_info where file = 0 and data = '%s' and type = %d;",
 		sym->ident->name, BUF_SIZE);
-	cached_sym_rl = clone_rl(db_size_rl);
-	return db_size_rl;
+	return save_cached_db_size(key, db_size_rl);
 }
 
 static struct range_list *size_from_db(struct expression *expr)
@@ -429,33 +456,10 @@ static int is_last_member_of_struct(struct symbol *sym, struct ident *member)
 
 int last_member_is_resizable(struct symbol *sym)
 {
-	struct symbol *last_member;
-	struct symbol *type;
-	sval_t sval;
+	const struct struct_layout *layout;
 
-	if (!sym || sym->type != SYM_STRUCT)
-		return 0;
-
-	last_member = last_ptr_list((struct ptr_list *)sym->symbol_list);
-	if (!last_member || !last_member->ident)
-		return 0;
-
-	type = get_real_base_type(last_member);
-	if (type->type == SYM_STRUCT)
-		return last_member_is_resizable(type);
-	if (type->type != SYM_ARRAY)
-		return 0;
-
-	if (!type->array_size)
-		return 1;
-
-	if (!get_implied_value(type->array_size, &sval))
-		return 0;
-
-	if (sval.value != 0 && sval.value != 1)
-		return 0;
-
-	return 1;
+	layout = get_struct_layout(sym);
+	return layout && layout->resizable;
 }
 
 static struct range_list *get_stored_size_end_struct_bytes(struct expression *expr)
@@ -1180,7 +1184,6 @@ void register_buf_size(int id)
 	if (option_info)
 		add_hook(record_global_size, BASE_HOOK);
 
-	add_hook(&match_clear_cache, AFTER_FUNC_HOOK);
 }
 
 void register_buf_size_late(int id)
@@ -1012,6 +1012,22 @@ static int have_common_var_sym(struct var_sym_list *left_vsl, struct var_sym_lis
  * "a < b < c".
  *
  */
+/*
+ * The link states are the edges of a graph of which variables are compared
+ * to each other.  When a variable is modified, reset_sm() sets the
+ * comparisons in its links to unknown but the variables on the other end
+ * still link to them.  Combining a new comparison with one of those dead
+ * edges only gives back what get_orig_comparison() already has, so skip
+ * them.  The modification hooks still have to look at the dead edges
+ * because resetting them clears the old possible states.
+ */
+static bool is_live_link(struct smatch_state *state)
+{
+	if (!state || !state->data)
+		return false;
+	return state_to_comparison(state) != UNKNOWN_COMPARISON;
+}
+
 static void update_tf_links(struct stree *pre_stree,
 			    struct expression *left_expr,
 			    const char *left_var, struct var_sym_list *left_vsl,
@@ -1037,7 +1053,7 @@ static void update_tf_links(struct stree *pre_stree,
 
 	FOR_EACH_PTR(links, tmp) {
 		state = get_state_stree(pre_stree, comparison_id, tmp, NULL);
-		if (!state || !state->data)
+		if (!is_live_link(state))
 			continue;
 		left_var = left_var_orig;
 		left_vsl = left_vsl_orig;
@@ -2832,7 +2848,7 @@ static struct sm_state *clone_partial_sm(struct sm_state *sm, int comparison)
 	clone->state = alloc_compare_state(data->left, data->left_var, data->left_vsl,
 					   comparison,
 					   data->right, data->right_var, data->right_vsl);
-	free_slist(&clone->possible);
+	clear_possibles(clone);
 	add_possible_sm(clone, clone);
 
 	stree = clone_stree(sm->pool);
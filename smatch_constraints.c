@@ -44,6 +44,7 @@
 #include "smatch.h"
 #include "smatch_extra.h"
 #include "smatch_slist.h"
+#include "smatch_function_hashtable.h"
 
 static int my_id;
 
@@ -99,13 +100,17 @@ static struct constraint_list *merge_constraint_lists(struct constraint_list *on
 	return ret;
 }
 
+/*
+ * The lists are already sorted and a constraint is never changed once it's
+ * on a list (add_constraint() replaces it) so they can be shared.
+ */
 static struct constraint_list *clone_constraint_list(struct constraint_list *list)
 {
 	struct constraint_list *ret = NULL;
 	struct constraint *tmp;
 
 	FOR_EACH_PTR(list, tmp) {
-		add_constraint(&ret, tmp->op, tmp->id);
+		add_ptr_list(&ret, tmp);
 	} END_FOR_EACH_PTR(tmp);
 
 	return ret;
@@ -210,125 +215,217 @@ char *get_constraint_str(struct expression *expr)
 	return alloc_string(name);
 }
 
-static int save_int_callback(void *_p, int argc, char **argv, char **azColName)
-{
-	int *p = _p;
+/*
+ * Nothing writes to the constraints tables while Smatch is running (new
+ * constraints are only printed for create_db.sh) so the constraints table is
+ * loaded the first time it's needed and the ids are looked up in memory after
+ * that.  The constraints_required rows are cached the same way, one lookup
+ * for each data string.
+ */
+struct constraint_str {
+	int id;
+	char *str;
+};
+
+DEFINE_STRING_HASHTABLE_STATIC(constraint_ids);
+static struct constraint_str **constraint_strs;
+static int max_constraint_id;
+static bool constraints_loaded;
+
+struct required_bound {
+	int id;
+	int op;
+};
 
-	*p = atoi(argv[0]);
-	return 0;
-}
+struct required_info {
+	char *required;
+	int nr;
+	struct required_bound bounds[];
+};
 
-static int constraint_str_to_id(const char *str)
+static DEFINE_HASHTABLE_INSERT(insert_required, char, struct required_info);
+static DEFINE_HASHTABLE_SEARCH(search_required, char, struct required_info);
+static struct hashtable *required_cache;
+
+static int load_constraint_callback(void *unused, int argc, char **argv, char **azColName)
 {
-	int id = -1;
+	struct constraint_str *con;
+	int id = atoi(argv[0]);
 
-	run_sql(save_int_callback, &id,
-		"select id from constraints where str = '%q'", str);
+	if (id < 0 || !argv[1] || search_constraint_ids(constraint_ids, argv[1]))
+		return 0;
 
-	return id;
-}
+	con = malloc(sizeof(*con));
+	con->id = id;
+	con->str = alloc_string(argv[1]);
+	insert_constraint_ids(constraint_ids, con->str, &con->id);
 
-static int save_constraint_str(void *_str, int argc, char **argv, char **azColName)
-{
-	char **str = _str;
+	if (id >= max_constraint_id) {
+		int old = max_constraint_id;
 
-	*str = alloc_string(argv[0]);
+		max_constraint_id = id + 1024;
+		constraint_strs = realloc(constraint_strs, max_constraint_id * sizeof(*constraint_strs));
+		memset(constraint_strs + old, 0, (max_constraint_id - old) * sizeof(*constraint_strs));
+	}
+	constraint_strs[id] = con;
 	return 0;
 }
 
-static char *constraint_id_to_str(int id)
+static void load_constraints(void)
 {
-	char *str = NULL;
-
-	run_sql(save_constraint_str, &str,
-		"select str from constraints where id = '%d'", id);
+	if (constraints_loaded)
+		return;
+	constraints_loaded = true;
 
-	return str;
+	constraint_ids = create_function_hashtable(4096);
+	run_sql(load_constraint_callback, NULL,
+		"select id, str from constraints");
 }
 
-static int save_op_callback(void *_p, int argc, char **argv, char **azColName)
+static int constraint_str_to_id(const char *str)
 {
-	int *p = _p;
+	int *id;
 
-	if (argv[0][0] == '<' && argv[0][1] == '=')
-		*p = SPECIAL_LTE;
-	else
-		*p = '<';
-	return 0;
+	load_constraints();
+	id = search_constraint_ids(constraint_ids, (char *)str);
+	if (!id)
+		return -1;
+	return *id;
 }
 
-static int save_str_callback(void *_p, int argc, char **argv, char **azColName)
+static const char *constraint_id_to_str(int id)
 {
-	char **p = _p;
+	load_constraints();
+	if (id < 0 || id >= max_constraint_id || !constraint_strs[id])
+		return NULL;
+	return constraint_strs[id]->str;
+}
+
+struct required_rows {
+	char *required;
+	int nr, max;
+	struct required_bound *bounds;
+};
 
-	if (!*p) {
-		*p = alloc_string(argv[0]);
+static int save_required_callback(void *_rows, int argc, char **argv, char **azColName)
+{
+	struct required_rows *rows = _rows;
+	int op, id, i;
+
+	if (!rows->required) {
+		rows->required = alloc_string(argv[0]);
 	} else {
 		char buf[256];
 
-		snprintf(buf, sizeof(buf), "%s, %s", *p, argv[0]);
-		*p = alloc_string(buf);
+		snprintf(buf, sizeof(buf), "%s, %s", rows->required, argv[0]);
+		free_string(rows->required);
+		rows->required = alloc_string(buf);
+	}
+
+	/* bounds which aren't in the constraints table can't match an id */
+	id = constraint_str_to_id(argv[0]);
+	if (id < 0)
+		return 0;
+	if (argv[1][0] == '<' && argv[1][1] == '=')
+		op = SPECIAL_LTE;
+	else
+		op = '<';
+
+	/* if a bound is listed twice, the last op wins */
+	for (i = 0; i < rows->nr; i++) {
+		if (rows->bounds[i].id == id) {
+			rows->bounds[i].op = op;
+			return 0;
+		}
+	}
+	if (rows->nr == rows->max) {
+		rows->max = rows->max ? rows->max * 2 : 8;
+		rows->bounds = realloc(rows->bounds, rows->max * sizeof(*rows->bounds));
 	}
+	rows->bounds[rows->nr].id = id;
+	rows->bounds[rows->nr].op = op;
+	rows->nr++;
 	return 0;
 }
 
-char *get_required_constraint(const char *data_str)
+static int cmp_required_bound(const void *_a, const void *_b)
 {
-	char *required = NULL;
-
-	run_sql(save_str_callback, &required,
-		"select bound from constraints_required where data = '%q'", data_str);
+	const struct required_bound *a = _a;
+	const struct required_bound *b = _b;
 
-	return required;
+	return a->id - b->id;
 }
 
-static int get_required_op(char *data_str, char *con_str)
+static struct required_info *get_required_info(const char *data_str)
 {
-	int op = 0;
-
-	run_sql(save_op_callback, &op,
-		"select op from constraints_required where data = '%q' and bound = '%q'", data_str, con_str);
+	struct required_rows rows = {};
+	struct required_info *info;
+
+	if (!required_cache)
+		required_cache = create_function_hashtable(1000);
+	info = search_required(required_cache, (char *)data_str);
+	if (info)
+		return info;
+
+	run_sql(save_required_callback, &rows,
+		"select bound, op from constraints_required where data = '%q'", data_str);
+
+	qsort(rows.bounds, rows.nr, sizeof(*rows.bounds), cmp_required_bound);
+	info = malloc(sizeof(*info) + rows.nr * sizeof(*rows.bounds));
+	info->required = rows.required;
+	info->nr = rows.nr;
+	if (rows.nr)
+		memcpy(info->bounds, rows.bounds, rows.nr * sizeof(*rows.bounds));
+	free(rows.bounds);
+
+	insert_required(required_cache, alloc_string(data_str), info);
+	return info;
+}
 
-	return op;
+char *get_required_constraint(const char *data_str)
+{
+	return alloc_string(get_required_info(data_str)->required);
 }
 
 char *unmet_constraint(struct expression *data, struct expression *offset)
 {
+	struct required_info *info;
 	struct smatch_state *state;
 	struct constraint_list *list;
 	struct constraint *con;
 	char *data_str;
-	char *required;
-	int req_op;
+	char *required = NULL;
+	int i = 0;
 
 	data_str = get_constraint_str(data);
 	if (!data_str)
 		return NULL;
 
-	required = get_required_constraint(data_str);
-	if (!required)
+	info = get_required_info(data_str);
+	if (!info->required)
 		goto free_data;
+	required = alloc_string(info->required);
 
 	state = get_state_expr(my_id, offset);
 	if (!state)
 		goto free_data;
 	list = state->data;
 
-	/* check the list of bounds on our index against the list that work */
+	/*
+	 * check the list of bounds on our index against the list that work.
+	 * Both are sorted by id.
+	 */
 	FOR_EACH_PTR(list, con) {
-		char *con_str;
-
-		con_str = constraint_id_to_str(con->id);
-		if (!con_str) {
+		if (!constraint_id_to_str(con->id)) {
 			sm_msg("constraint %d not found", con->id);
 			continue;
 		}
 
-		req_op = get_required_op(data_str, con_str);
-		free_string(con_str);
-		if (!req_op)
+		while (i < info->nr && info->bounds[i].id < con->id)
+			i++;
+		if (i == info->nr || info->bounds[i].id != con->id)
 			continue;
-		if (con->op == '<' || con->op == req_op) {
+		if (con->op == '<' || con->op == info->bounds[i].op) {
 			free_string(required);
 			required = NULL;
 			goto free_data;
@@ -385,9 +482,6 @@ static void handle_comparison(struct expression *left, int op, struct expression
 
 static void match_condition(struct expression *expr)
 {
-	if (expr->type != EXPR_COMPARE)
-		return;
-
 	if (expr->op == SPECIAL_EQUAL ||
 	    expr->op == SPECIAL_NOTEQUAL)
 		return;
@@ -519,7 +613,7 @@ void register_constraints(int id)
 
 	set_dynamic_states(my_id);
 	add_merge_hook(my_id, &merge_func);
-	add_hook(&match_condition, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 
 	add_hook(&match_caller_info, FUNCTION_CALL_HOOK);
 	add_member_info_callback(my_id, struct_member_callback);
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+set -e
+
+# smdb.py call_tree and friends walk up from a function to its callers, and
+# from a function to the pointers it is stored in.  Doing that with a query
+# per edge is slow on a big DB.  This gives every function and function
+# pointer a number and saves, for each one, the space separated numbers of
+# the functions which call it (the INTERNAL caller_info rows) and of the
+# pointers it is stored in (function_ptr).  That's small enough for smdb.py
+# to read all at once and walk in memory.
+
+db_file=$1
+
+cat << EOF | sqlite3 $db_file
+PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA count_changes = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+BEGIN;
+
+DELETE FROM call_graph;
+
+-- type 0 is INTERNAL
+INSERT INTO call_graph (name)
+    SELECT function FROM caller_info WHERE type = 0
+    UNION SELECT caller FROM caller_info WHERE type = 0
+    UNION SELECT function FROM function_ptr
+    UNION SELECT ptr FROM function_ptr;
+
+CREATE TEMP TABLE caller_edges AS
+    SELECT DISTINCT f.id AS id, c.id AS other
+    FROM caller_info
+    JOIN call_graph f ON f.name = caller_info.function
+    JOIN call_graph c ON c.name = caller_info.caller
+    WHERE caller_info.type = 0;
+CREATE INDEX caller_edges_idx ON caller_edges (id);
+
+CREATE TEMP TABLE ptr_edges AS
+    SELECT DISTINCT f.id AS id, p.id AS other
+    FROM function_ptr
+    JOIN call_graph f ON f.name = function_ptr.function
+    JOIN call_graph p ON p.name = function_ptr.ptr;
+CREATE INDEX ptr_edges_idx ON ptr_edges (id);
+
+UPDATE call_graph SET
+    callers = (SELECT group_concat(other, ' ') FROM caller_edges WHERE caller_edges.id = call_graph.id),
+    ptrs = (SELECT group_concat(other, ' ') FROM ptr_edges WHERE ptr_edges.id = call_graph.id);
+
+COMMIT;
+EOF
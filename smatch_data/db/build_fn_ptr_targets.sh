@@ -0,0 +1,36 @@
+#!/bin/bash
+
+set -e
+
+# An indirect call looks up the functions which were stored in the pointer
+# and then their return_states.  Before that it has to know how many
+# return_states there are, to decide if the pointer is too noisy to split
+# on.  This saves that count, and the number of functions, for each
+# searchable pointer so Smatch can skip the counting query.  Pointers which
+# aren't listed here don't have any searchable functions.  Run it after
+# mark_function_ptrs_searchable.sh.
+
+db_file=$1
+
+cat << EOF | sqlite3 $db_file
+PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA count_changes = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+BEGIN;
+
+DELETE FROM fn_ptr_targets;
+
+-- type 0 is INTERNAL
+INSERT INTO fn_ptr_targets
+    SELECT function_ptr.ptr, count(DISTINCT function_ptr.function),
+           sum(return_states.type = 0)
+    FROM function_ptr
+    JOIN return_states ON return_states.function = function_ptr.function
+    WHERE function_ptr.searchable = 1
+    GROUP BY function_ptr.ptr;
+
+COMMIT;
+EOF
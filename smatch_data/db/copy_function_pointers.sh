@@ -0,0 +1,39 @@
+#!/bin/bash
+
+set -e
+
+# If a function is stored in a function pointer and that function pointer is
+# in turn stored in another one ("(struct foo)->bar" is stored in
+# "(struct baz)->frob"), then the function can be called through the second
+# pointer too.  This follows those chains to the end and adds the rows.
+
+db_file=$1
+if [ "$db_file" == "" ] ; then
+    echo "usage: copy_function_pointers.sh <db file>"
+    exit 0
+fi
+
+cat << EOF | sqlite3 $db_file
+PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA count_changes = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+BEGIN;
+
+CREATE TEMP TABLE ptr_links AS
+    SELECT DISTINCT function, ptr FROM function_ptr WHERE function LIKE '% %';
+CREATE INDEX temp.ptr_links_idx ON ptr_links (function);
+
+INSERT OR IGNORE INTO function_ptr
+    WITH RECURSIVE copies(file, function, ptr) AS (
+        SELECT file, function, ptr FROM function_ptr WHERE function NOT LIKE '% %'
+        UNION
+        SELECT copies.file, copies.function, ptr_links.ptr
+        FROM copies JOIN ptr_links ON ptr_links.function = copies.ptr
+    )
+    SELECT file, function, ptr, 1 FROM copies;
+
+COMMIT;
+EOF
@@ -11,6 +11,7 @@ info_file=$1
 
 if [[ "$info_file" = "" ]] ; then
     echo "Usage:  $0 -p=<project> <file with smatch messages>"
+    echo "        $0 -p=<project> <smatch --info-shard directory>"
     exit 1
 fi
 
@@ -28,41 +29,116 @@ for i in ${bin_dir}/*.schema ; do
     cat $i | sqlite3 $db_file
 done
 
-${bin_dir}/init_constraints.pl "$PROJ" $info_file $db_file
-${bin_dir}/init_constraints_required.pl "$PROJ" $info_file $db_file
-${bin_dir}/fill_db_sql.pl "$PROJ" $info_file $db_file
-if [ -e ${info_file}.sql ] ; then
-    ${bin_dir}/fill_db_sql.pl "$PROJ" ${info_file}.sql $db_file
-fi
-${bin_dir}/fill_db_caller_info.pl "$PROJ" $info_file $db_file
-if [ -e ${info_file}.caller_info ] ; then
-    ${bin_dir}/fill_db_caller_info.pl "$PROJ" ${info_file}.caller_info $db_file
+# Runs a step of the fixup stage and says how long it took
+timed()
+{
+    local start=$(date +%s)
+
+    "$@"
+    echo "$(basename $1): $(( $(date +%s) - start ))s"
+}
+
+# "smatch --info-shard=<dir>" wrote the SQL to a SQLite file per process so
+# there is no text to split and parse.
+if [ -d "$info_file" ] ; then
+    ${bin_dir}/init_constraints.pl "$PROJ" $info_file $db_file
+    ${bin_dir}/init_constraints_required.pl "$PROJ" $info_file $db_file
+    timed ${bin_dir}/sm_fill_db --merge "$PROJ" $db_file $info_file/*.sqlite
+else
+    shard_dir=$(mktemp -d smatch_db_shards.XXXXXX)
+    trap 'rm -rf "${shard_dir:?}"' EXIT
+
+    # Read the warns file once and route each line to the loader which wants it.
+    # return_states and caller_info are the big tables so they get their own
+    # shard databases and are loaded at the same time as everything else.  The
+    # files can be gzipped (smatch --gzip), "gzip -dcf" passes plain text through.
+    sql_files=$info_file
+    if [ -e ${info_file}.sql ] ; then
+        sql_files="$sql_files ${info_file}.sql"
+    fi
+    if [ -e ${info_file}.caller_info ] ; then
+        sql_files="$sql_files ${info_file}.caller_info"
+    fi
+
+    gzip -dcf $sql_files | LC_ALL=C awk -v dir=$shard_dir '
+    /\(\) SQL_caller_info: / { print > (dir "/caller_info.txt"); next }
+    /\(\) SQL(_late)?: insert (or ignore )?into return_states / ||
+    /\(\) SQL_rows?: return_states / { print > (dir "/return_states.txt"); next }
+    /\(\) SQL(_late|_rows?)?: / { print > (dir "/main.txt") }
+    '
+    touch $shard_dir/main.txt $shard_dir/return_states.txt $shard_dir/caller_info.txt
+
+    load_sql()
+    {
+        if [ -x ${bin_dir}/sm_fill_db ] ; then
+            ${bin_dir}/sm_fill_db $1 $2
+        else
+            ${bin_dir}/fill_db_sql.pl "$PROJ" $2 $1
+        fi
+    }
+
+    load_caller_info()
+    {
+        if [ -x ${bin_dir}/sm_fill_db ] ; then
+            ${bin_dir}/sm_fill_db --caller-info "$PROJ" $1 $2
+        else
+            ${bin_dir}/fill_db_caller_info.pl "$PROJ" $2 $1
+        fi
+    }
+
+    for shard in return_states caller_info ; do
+        for i in ${bin_dir}/*.schema ; do
+            cat $i | sqlite3 $shard_dir/$shard.sqlite
+        done
+    done
+
+    (
+        ${bin_dir}/init_constraints.pl "$PROJ" $info_file $db_file
+        ${bin_dir}/init_constraints_required.pl "$PROJ" $info_file $db_file
+        load_sql $db_file $shard_dir/main.txt
+    ) &
+    main_pid=$!
+    load_sql $shard_dir/return_states.sqlite $shard_dir/return_states.txt &
+    return_states_pid=$!
+    load_caller_info $shard_dir/caller_info.sqlite $shard_dir/caller_info.txt &
+    caller_info_pid=$!
+
+    wait $main_pid
+    wait $return_states_pid
+    wait $caller_info_pid
+
+    # The big tables are looked up by function name.  Copying them over sorted
+    # by function puts the rows for a function next to each other, so a lookup
+    # reads a few pages instead of one page per row.  Ordering by rowid second
+    # keeps the rows for each function in the order they were inserted.
+    cat << EOF | sqlite3 $db_file
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA temp_store = MEMORY;
+ATTACH '$shard_dir/return_states.sqlite' AS return_states_shard;
+ATTACH '$shard_dir/caller_info.sqlite' AS caller_info_shard;
+BEGIN;
+INSERT INTO return_states SELECT * FROM return_states_shard.return_states
+    ORDER BY function, rowid;
+INSERT INTO caller_info SELECT * FROM caller_info_shard.caller_info
+    ORDER BY function, rowid;
+INSERT INTO common_caller_info SELECT * FROM caller_info_shard.common_caller_info
+    ORDER BY function, rowid;
+COMMIT;
+EOF
 fi
 ${bin_dir}/build_early_index.sh $db_file
 
-${bin_dir}/fill_db_type_value.pl "$PROJ" $info_file $db_file
+if [ -x ${bin_dir}/sm_fill_db ] ; then
+    ${bin_dir}/sm_fill_db --type-value $db_file
+else
+    ${bin_dir}/fill_db_type_value.pl "$PROJ" $info_file $db_file
+fi
 ${bin_dir}/fill_db_type_size.pl "$PROJ" $info_file $db_file
 ${bin_dir}/copy_required_constraints.pl "$PROJ" $info_file $db_file
 ${bin_dir}/build_late_index.sh $db_file
 
-${bin_dir}/fixup_all.sh $db_file
-if [ "$PROJ" != "" ] ; then
-    # Run the fixup script only if it exists and is executable
-    test -x ${bin_dir}/fixup_${PROJ}.sh && ${bin_dir}/fixup_${PROJ}.sh $db_file
-fi
-
-${bin_dir}/copy_function_pointers.pl $db_file
-${bin_dir}/remove_mixed_up_pointer_params.pl $db_file
-${bin_dir}/delete_too_common_fn_ptr.sh $db_file
-${bin_dir}/mark_function_ptrs_searchable.pl $db_file
-
-# delete duplicate entrees and speed things up
-echo "delete from function_ptr where rowid not in (select min(rowid) from function_ptr group by file, function, ptr, searchable);" | sqlite3 $db_file
-
-${bin_dir}/apply_return_fixes.sh -p=${PROJ} $db_file
-if [ "$PROJ" != "" ] ; then
-    ${bin_dir}/insert_manual_states.pl ${PROJ} $db_file
-fi
+${bin_dir}/post_process_db.sh -p=${PROJ} $db_file
 
 # test the new DB
 if ! echo "select * from return_states where type = 0 limit 1;" | \
@@ -72,3 +148,7 @@ if ! echo "select * from return_states where type = 0 limit 1;" | \
 fi
 
 mv $db_file smatch_db.sqlite
+
+if [ -x ${bin_dir}/sm_mmap_db ] ; then
+    ${bin_dir}/sm_mmap_db smatch_db.sqlite
+fi
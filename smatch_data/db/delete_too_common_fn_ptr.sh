@@ -4,13 +4,16 @@ set -e
 
 db_file=$1
 
-IFS="|"
-echo "select count(function), function from function_ptr group by function;" | \
-    sqlite3 $db_file  | sort -n | tail -n 100 | \
-
-while read cnt func ; do
-    if [ $cnt -lt 200 ] ; then
-        continue
-    fi
-    echo "delete from function_ptr where function = '$func';" | sqlite3 $db_file
-done
+# Functions which are stored in 200 or more function pointers, like the
+# generic helpers, make every pointer look like it calls everything.  Only
+# the top 100 are deleted.
+cat << EOF | sqlite3 $db_file
+PRAGMA synchronous = OFF;
+PRAGMA journal_mode = OFF;
+DELETE FROM function_ptr WHERE function IN (
+    SELECT function FROM function_ptr
+    GROUP BY function
+    HAVING count(function) >= 200
+    ORDER BY count(function) DESC
+    LIMIT 100);
+EOF
@@ -10,6 +10,17 @@ DRIVERS_PCI_ACCESS=$(${bin_dir}/sm_hash 'drivers/pci/access.c')
 DRIVERS_RAPIDIO_ACCESS=$(${bin_dir}/sm_hash 'drivers/rapidio/rio-access.c')
 
 cat << EOF | sqlite3 $db_file
+PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA count_changes = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+BEGIN;
+
+/* a lot of the deletes below only look at the caller, dropped at the end */
+CREATE INDEX caller_info_caller_idx on caller_info (caller, function);
+
 /* we only care about the main ->read/write() functions. */
 delete from caller_info where function = '(struct file_operations)->read' and caller != 'vfs_read';
 delete from caller_info where function = '(struct file_operations)->write' and caller != 'vfs_write';
@@ -77,9 +88,9 @@ delete from caller_info where function = '(struct inet6_protocol)->handler' and
 delete from caller_info where function = 'do_dentry_open param 2' and type = 8017;
 delete from caller_info where function = 'do_dentry_open param 2' and type = 9018;
 delete from caller_info where function = 'param_array param 7' and type = 9018;
-# this is just too complicated for Smatch.  See how snd_ctl_find_id() is called.
+/* this is just too complicated for Smatch.  See how snd_ctl_find_id() is called. */
 delete from caller_info where function = 'snd_ctl_notify_one' and type = 8017;
-#temporary.  Just to fix recursion
+/* temporary.  Just to fix recursion */
 delete from caller_info where caller = 'ecryptfs_mkdir' and type = 8017;
 delete from caller_info where caller = 'rpm_suspend' and type = 8017;
 delete from return_states where function = 'rpm_resume' and type = 8017;
@@ -242,10 +253,16 @@ delete from caller_info where caller = 'sctp_inq_push' and function = '(struct w
 /* dev_err() stores that dev->[class,bus,driver] is not an error pointer (useless info). */
 delete from return_states where function = '__dev_printk' and type = 103;
 
+DROP INDEX caller_info_caller_idx;
+COMMIT;
 EOF
 
+# The rest needs to look things up first.  The lookups are all done before
+# anything is changed and the changes are applied in one transaction.
+late_fixups()
+{
 for i in $(echo "select distinct return from return_states where function = 'clear_user';" | sqlite3 $db_file | grep -v '\[' ) ; do
-    echo "update return_states set return = '$i[<=\$1]' where return = '$i' and function = 'clear_user';" | sqlite3 $db_file
+    echo "update return_states set return = '$i[<=\$1]' where return = '$i' and function = 'clear_user';"
 done
 
 echo "select distinct file, function from function_ptr where ptr='(struct rtl_hal_ops)->set_hw_reg';" \
@@ -258,15 +275,13 @@ echo "select distinct file, function from function_ptr where ptr='(struct rtl_ha
 
     echo "update caller_info
           set function = '$drv (struct rtl_hal_ops)->set_hw_reg'
-          where function = '(struct rtl_hal_ops)->set_hw_reg' and file like 'drivers/net/wireless/rtlwifi/$drv/%';" \
-         | sqlite3 $db_file
+          where function = '(struct rtl_hal_ops)->set_hw_reg' and file like 'drivers/net/wireless/rtlwifi/$drv/%';"
 
-    echo "insert into function_ptr values ('$file', '$function', '$drv (struct rtl_hal_ops)->set_hw_reg', 1);" \
-         | sqlite3 $db_file
+    echo "insert into function_ptr values ('$file', '$function', '$drv (struct rtl_hal_ops)->set_hw_reg', 1);"
 done
 
 for func in __kmalloc __kmalloc_track_caller __do_kmalloc_node __kmalloc_node_track_caller kmalloc_noprof ; do
-    cat << EOF | sqlite3 $db_file
+    cat << EOF
 delete from return_states where function = '$func';
 insert into return_states values (0, '$func', 0, 1, '16', 0,    0,  -1, '', '');
 insert into return_states values (0, '$func', 0, 1, '16', 0, 103,   0, '\$', '0');
@@ -280,6 +295,16 @@ done
 
 # it's easiest to pretend that invalid kobjects don't exist
 ID=$(echo "select distinct(return_id) from return_states where function = 'kobject_init' order by return_id desc limit 1;" | sqlite3 $db_file)
-echo "delete from return_states where function = 'kobject_init' and return_id = '$ID';" | sqlite3 $db_file
+echo "delete from return_states where function = 'kobject_init' and return_id = '$ID';"
+}
+
+sql=$(late_fixups)
+cat << EOF | sqlite3 $db_file
+PRAGMA synchronous = OFF;
+PRAGMA journal_mode = OFF;
+BEGIN;
+$sql
+COMMIT;
+EOF
 
 
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+set -e
+
+# Function pointers are only worth looking up if the functions they point to
+# have some return_states, but not so many that it's all noise.
+
+db_file=$1
+
+cat << EOF | sqlite3 $db_file
+PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA count_changes = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+BEGIN;
+
+CREATE TEMP TABLE searchable_ptrs AS
+    SELECT function_ptr.ptr AS ptr FROM function_ptr
+    JOIN return_states ON return_states.function = function_ptr.function
+    GROUP BY function_ptr.ptr
+    HAVING count(*) <= 1000;
+
+UPDATE function_ptr SET searchable = 1
+WHERE ptr IN (SELECT ptr FROM searchable_ptrs);
+
+COMMIT;
+EOF
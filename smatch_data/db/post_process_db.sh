@@ -0,0 +1,50 @@
+#!/bin/bash
+
+set -e
+
+# The fixups and the derived tables which have to be redone after rows are
+# loaded into the DB.  create_db.sh and reload_partial.sh both run this so a
+# partial reload leaves the DB the same as a full build would.
+
+if echo $1 | grep -q '^-p' ; then
+    PROJ=$(echo $1 | cut -d = -f 2)
+    shift
+fi
+
+bin_dir=$(dirname $0)
+db_file=$1
+if [ "$db_file" == "" ] ; then
+    echo "usage: $0 -p=<project> <db_file>"
+    exit 1
+fi
+
+# Runs a step and says how long it took
+timed()
+{
+    local start=$(date +%s)
+
+    "$@"
+    echo "$(basename $1): $(( $(date +%s) - start ))s"
+}
+
+timed ${bin_dir}/fixup_all.sh $db_file
+if [ "$PROJ" != "" ] ; then
+    # Run the fixup script only if it exists and is executable
+    if [ -x ${bin_dir}/fixup_${PROJ}.sh ] ; then
+        timed ${bin_dir}/fixup_${PROJ}.sh $db_file
+    fi
+fi
+
+# function_ptr is UNIQUE (file, function, ptr) so there are no duplicate
+# rows to delete afterwards.
+timed ${bin_dir}/copy_function_pointers.sh $db_file
+timed ${bin_dir}/remove_mixed_up_pointer_params.sh $db_file
+timed ${bin_dir}/delete_too_common_fn_ptr.sh $db_file
+timed ${bin_dir}/mark_function_ptrs_searchable.sh $db_file
+
+timed ${bin_dir}/apply_return_fixes.sh -p=${PROJ} $db_file
+if [ "$PROJ" != "" ] ; then
+    ${bin_dir}/insert_manual_states.pl ${PROJ} $db_file
+fi
+timed ${bin_dir}/build_fn_ptr_targets.sh $db_file
+timed ${bin_dir}/build_call_graph.sh $db_file
@@ -1,5 +1,7 @@
 #!/bin/bash
 
+set -e
+
 if echo $1 | grep -q '^-p' ; then
     PROJ=$(echo $1 | cut -d = -f 2)
     shift
@@ -9,42 +11,116 @@ info_file=$1
 
 if [[ "$info_file" = "" ]] ; then
     echo "Usage:  $0 -p=<project> <file with smatch messages>"
+    echo "Replaces the rows for the files in <file with smatch messages>"
+    echo "in smatch_db.sqlite and leaves everything else alone."
+    exit 1
+fi
+
+if [ ! -e "$info_file" ] ; then
+    echo "no such file: $info_file"
     exit 1
 fi
 
 bin_dir=$(dirname $0)
 db_file=smatch_db.sqlite
 
-files=$(grep "insert into caller_info" $info_file | cut -d : -f 1 | sort -u)
-for c_file in $files; do
-    HASH=$(${bin_dir}/sm_hash $c_file)
-    echo "FILE '$c_file' HASH $HASH"
+if [ ! -e $db_file ] ; then
+    echo "$db_file does not exist.  Use create_db.sh."
+    exit 1
+fi
 
-    echo "delete from caller_info where file = '${HASH}';" | sqlite3 $db_file
-    echo "delete from return_states where file = '${HASH}';" | sqlite3 $db_file
-    echo "delete from call_implies where file = '${HASH}';" | sqlite3 $db_file
-    echo "delete from return_implies where file = '${HASH}';" | sqlite3 $db_file
+tmp_dir=$(mktemp -d smatch_db_partial.XXXXXX)
+trap 'rm -rf "${tmp_dir:?}"' EXIT
+new_db=$tmp_dir/new.sqlite
+
+# The loaders want plain text
+if gzip -t $info_file 2> /dev/null ; then
+    gzip -dc $info_file > $tmp_dir/info.txt
+    info_file=$tmp_dir/info.txt
+fi
+
+# Load the new messages into a scratch DB first.  The file ids of the
+# re-analyzed files are whatever shows up in the file columns there.
+for i in ${bin_dir}/*.schema ; do
+    cat $i | sqlite3 $new_db
 done
 
-tmp_file=$(mktemp)
+if [ -x ${bin_dir}/sm_fill_db ] ; then
+    ${bin_dir}/sm_fill_db $new_db $info_file
+else
+    ${bin_dir}/fill_db_sql.pl "$PROJ" $info_file $new_db
+fi
+if [ -x ${bin_dir}/sm_fill_db ] ; then
+    ${bin_dir}/sm_fill_db --caller-info "$PROJ" $new_db $info_file
+else
+    ${bin_dir}/fill_db_caller_info.pl "$PROJ" $info_file $new_db
+fi
+
+# These are the tables where "file" is the get_base_file_id() of the file
+# which generated the row.  Global symbols are recorded with a file of zero
+# so those rows can't be traced back and are de-duplicated instead.
+file_tables="caller_info return_states call_implies return_implies
+	function_type_size function_type_value function_type_info type_info
+	local_values parameter_name function_type param_map sink_info
+	function_ptr data_info fn_data_link mtag_about"
+other_tables="constraints_required fn_ptr_data_link hash_string mtag_data
+	mtag_info mtag_map mtag_alias"
 
-grep "insert into caller_info" $info_file > $tmp_file
-${bin_dir}/fill_db_caller_info.pl "$PROJ" $tmp_file $db_file
+(
+    cat << EOF
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA temp_store = MEMORY;
+ATTACH '$new_db' AS new;
+BEGIN;
+CREATE TEMP TABLE changed_files (file big int PRIMARY KEY);
+INSERT OR IGNORE INTO changed_files
+	SELECT file FROM new.return_states WHERE file != 0
+	UNION SELECT file FROM new.caller_info WHERE file != 0;
+EOF
 
-grep "insert into return_states" $info_file > $tmp_file
-${bin_dir}/fill_db_sql.pl "$PROJ" $tmp_file $db_file
+    for table in $file_tables ; do
+        echo "DELETE FROM $table WHERE file IN (SELECT file FROM changed_files);"
+    done
 
-grep "into call_implies" $info_file > $tmp_file
-${bin_dir}/fill_db_sql.pl "$PROJ" $tmp_file $db_file
+    # The call ids are only unique within one load so move them past the old ones
+    cat << EOF
+INSERT INTO caller_info
+	SELECT file, caller, function,
+	       call_id + (SELECT ifnull(max(call_id), 0) + 1 FROM main.caller_info),
+	       static, type, parameter, key, value
+	FROM new.caller_info;
+INSERT OR IGNORE INTO constraints (str) SELECT str FROM new.constraints;
+EOF
 
-grep "into return_implies" $info_file > $tmp_file
-${bin_dir}/fill_db_sql.pl "$PROJ" $tmp_file $db_file
+    for table in $file_tables $other_tables ; do
+        [ "$table" = "caller_info" ] && continue
+        echo "INSERT OR IGNORE INTO $table SELECT * FROM new.$table;"
+    done
 
-rm $tmp_file
+    for table in $file_tables ; do
+        cols=$(sqlite3 $db_file "PRAGMA table_info($table);" | cut -d '|' -f 2 | paste -sd ,)
+        echo "DELETE FROM $table WHERE file = 0 AND rowid NOT IN (SELECT min(rowid) FROM $table WHERE file = 0 GROUP BY $cols);"
+    done
 
-${bin_dir}/fixup_all.sh $db_file
-if [ "$PROJ" != "" ] ; then
-    # Run the fixup script only if it exists and is executable
-    test -x ${bin_dir}/fixup_${PROJ}.sh && ${bin_dir}/fixup_${PROJ}.sh $db_file
+    # Rebuilt by sm_fill_db --type-value and fill_db_type_size.pl below
+    echo "DELETE FROM type_value;"
+    echo "DELETE FROM type_size;"
+    echo "COMMIT;"
+) | sqlite3 $db_file
+
+if [ -x ${bin_dir}/sm_fill_db ] ; then
+    ${bin_dir}/sm_fill_db --type-value $db_file
+else
+    ${bin_dir}/fill_db_type_value.pl "$PROJ" $info_file $db_file
 fi
+${bin_dir}/fill_db_type_size.pl "$PROJ" $info_file $db_file
+${bin_dir}/copy_required_constraints.pl "$PROJ" $info_file $db_file
+
+# The same fixups as create_db.sh, and the derived tables like call_graph
+# and fn_ptr_targets are made again from the new rows.
+${bin_dir}/post_process_db.sh -p=${PROJ} $db_file
 
+if [ -x ${bin_dir}/sm_mmap_db ] ; then
+    ${bin_dir}/sm_mmap_db $db_file
+fi
@@ -0,0 +1,39 @@
+#!/bin/bash
+
+set -e
+
+# The "p <param>" rows (type 1014) say that a function pointer parameter was
+# passed straight through from the caller's parameter.  If the caller's
+# parameter is a void * or an unsigned long then it might be anything, so
+# the other caller_info rows for that parameter are deleted.
+
+db_file=$1
+
+cat << EOF | sqlite3 $db_file
+PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA count_changes = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+BEGIN;
+
+CREATE TEMP TABLE mixed_up AS
+    SELECT DISTINCT file, caller, function, parameter FROM caller_info
+    WHERE function LIKE '% param %' AND type = 1014 AND value LIKE 'p %' AND
+          (SELECT value FROM function_type
+           WHERE function_type.file = caller_info.file AND
+                 function_type.function = caller_info.caller AND
+                 function_type.parameter = substr(caller_info.value, 3)
+           LIMIT 1) IN ('void*', 'ulong');
+
+DELETE FROM caller_info WHERE rowid IN (
+    SELECT caller_info.rowid FROM mixed_up JOIN caller_info
+    ON caller_info.file = mixed_up.file AND
+       caller_info.function = mixed_up.function AND
+       caller_info.caller = mixed_up.caller AND
+       caller_info.parameter = mixed_up.parameter
+    WHERE caller_info.type != 1014);
+
+COMMIT;
+EOF
@@ -9,9 +9,40 @@ import sys
 import re
 import subprocess
 import io
+import os
+import socket
+import contextlib
+import signal
+
+# "smdb.py serve" keeps the DB open and answers the queries sent to this
+# socket.  The other commands are passed to the server when it's running so
+# they don't pay for opening the DB and reading the call graph each time.
+SOCKET_NAME = 'smatch_db.sqlite.sock'
+
+def query_server(argv):
+    if not os.path.exists(SOCKET_NAME):
+        return False
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        sock.connect(SOCKET_NAME)
+    except OSError:
+        # the server died and left the socket behind
+        return False
+    sock.sendall("\0".join(argv).encode())
+    sock.shutdown(socket.SHUT_WR)
+    while True:
+        data = sock.recv(65536)
+        if not data:
+            break
+        sys.stdout.buffer.write(data)
+    sock.close()
+    return True
+
+if len(sys.argv) >= 2 and sys.argv[1] != "serve" and query_server(sys.argv[1:]):
+    sys.exit(0)
 
 try:
-    con = sqlite3.connect('smatch_db.sqlite')
+    con = sqlite3.connect('smatch_db.sqlite', cached_statements=256)
 except sqlite3.Error as e:
     print("Error %s:" % e.args[0])
     sys.exit(1)
@@ -31,29 +62,61 @@ def usage():
     print("find_tagged <function> <param> - find the source of a tagged value (arm64)")
     print("parse_warns_tagged <smatch_warns.txt> - parse warns file for summary of tagged issues (arm64)")
     print("locals <file> - print the local values in a file.")
+    print("serve - keep the DB open and answer the queries from the other smdb commands")
     sys.exit(1)
 
-function_ptrs = []
-searched_ptrs = []
-def get_function_pointers_helper(func):
+# The call_graph table is made by build_call_graph.sh, which create_db.sh and
+# reload_partial.sh run (through post_process_db.sh) after they load the rows.  It's read the first
+# time it's needed and then the callers and function pointers are looked up
+# in memory instead of with a query each.  Older DBs don't have it.
+graph_ids = None
+graph_names = []
+graph_callers = []
+graph_ptrs = []
+def load_call_graph():
+    global graph_ids
+    if graph_ids is not None:
+        return len(graph_ids) != 0
+    graph_ids = {}
     cur = con.cursor()
-    cur.execute("select distinct ptr from function_ptr where function = '%s';" %(func))
-    for row in cur:
-        ptr = row[0]
-        if ptr in function_ptrs:
-            continue
-        function_ptrs.append(ptr)
-        if not ptr in searched_ptrs:
-            searched_ptrs.append(ptr)
-            get_function_pointers_helper(ptr)
+    try:
+        cur.execute("select id, name, callers, ptrs from call_graph;")
+    except sqlite3.Error:
+        return False
+    for (id, name, callers, ptrs) in cur:
+        while len(graph_names) <= id:
+            graph_names.append("")
+            graph_callers.append([])
+            graph_ptrs.append([])
+        graph_ids[name] = id
+        graph_names[id] = name
+        if callers:
+            graph_callers[id] = [int(x) for x in callers.split()]
+        if ptrs:
+            graph_ptrs[id] = [int(x) for x in ptrs.split()]
+    return len(graph_ids) != 0
 
 def get_function_pointers(func):
-    global function_ptrs
-    global searched_ptrs
-    function_ptrs = [func]
-    searched_ptrs = [func]
-    get_function_pointers_helper(func)
-    return function_ptrs
+    if load_call_graph():
+        if func not in graph_ids:
+            return [func]
+        seen = set([graph_ids[func]])
+        todo = [graph_ids[func]]
+        ret = [func]
+        while todo:
+            for ptr in graph_ptrs[todo.pop(0)]:
+                if ptr in seen:
+                    continue
+                seen.add(ptr)
+                todo.append(ptr)
+                ret.append(graph_names[ptr])
+        return ret
+
+    cur = con.cursor()
+    cur.execute("""with recursive ptrs(name) as (select ? union
+                   select function_ptr.ptr from function_ptr join ptrs on function_ptr.function = ptrs.name)
+                   select name from ptrs;""", (func,))
+    return [row[0] for row in cur]
 
 db_types = {   0: "INTERNAL",
              103: "PARAM_LIMIT",
@@ -405,7 +468,7 @@ def display_caller_info(printed, cur, param_names):
         print(" %2d | %15s | %s" %(parameter, key, txt[8]))
     return printed
 
-def get_caller_info(filename, ptrs, my_type):
+def get_caller_info(filename, func, ptrs, my_type):
     cur = con.cursor()
     param_names = get_param_names(filename, func)
     printed = 0
@@ -418,7 +481,7 @@ def get_caller_info(filename, ptrs, my_type):
 
 def print_caller_info(filename, func, my_type = ""):
     ptrs = get_function_pointers(func)
-    get_caller_info(filename, ptrs, my_type)
+    get_caller_info(filename, func, ptrs, my_type)
 
 def merge_values(param_names, vals, cur):
     for txt in cur:
@@ -623,6 +686,13 @@ class CallTree:
         return t
 
 def get_callers(func, restrict = ""):
+    if restrict == "" and load_call_graph():
+        ret = []
+        for ptr in get_function_pointers(func):
+            if ptr in graph_ids:
+                ret += [graph_names[c] for c in graph_callers[graph_ids[ptr]]]
+        return ret
+
     if restrict == "":
         restrict = "and type = 0"
     ret = []
@@ -869,104 +939,150 @@ def constraint(struct_type, member):
     for txt in cur:
         print("%-30s | %-30s | %s | %s" %(txt[0], txt[1], txt[2], txt[3]))
 
-if len(sys.argv) < 2:
-    usage()
-
-if len(sys.argv) == 2:
-    func = sys.argv[1]
-    print_caller_info("", func)
-elif sys.argv[1] == "info":
-    my_type = ""
-    if len(sys.argv) == 4:
-        my_type = sys.argv[3]
-    func = sys.argv[2]
-    print_caller_info("", func, my_type)
-elif sys.argv[1] == "call_info":
-    if len(sys.argv) != 4:
+def run_command(argv):
+    if len(argv) < 2:
         usage()
-    filename = sys.argv[2]
-    func = sys.argv[3]
-    caller_info_values(filename, func)
-    print_caller_info(filename, func)
-elif sys.argv[1] == "function_ptr" or sys.argv[1] == "fn_ptr":
-    func = sys.argv[2]
-    print_fn_ptrs(func)
-elif sys.argv[1] == "return_states":
-    func = sys.argv[2]
-    print_return_states(func)
-    print("================================================")
-    print_return_implies(func)
-elif sys.argv[1] == "return_implies":
-    func = sys.argv[2]
-    print_return_implies(func)
-elif sys.argv[1] == "type_size" or sys.argv[1] == "buf_size":
-    struct_type = sys.argv[2]
-    member = sys.argv[3]
-    print_type_size(struct_type, member)
-elif sys.argv[1] == "type_info":
-    struct_type = sys.argv[2]
-    member = sys.argv[3]
-    print_type_info(struct_type, member)
-elif sys.argv[1] == "data_info":
-    struct_type = sys.argv[2]
-    member = sys.argv[3]
-    print_data_info(struct_type, member)
-elif sys.argv[1] == "call_tree":
-    func = sys.argv[2]
-    print_call_tree(func)
-elif sys.argv[1] == "preempt":
-    func = sys.argv[2]
-    print_preempt_tree(func)
-elif sys.argv[1] == "irq":
-    func = sys.argv[2]
-    print_irq_tree(func)
-elif sys.argv[1] == "find_tagged":
-    func = sys.argv[2]
-    param = int(sys.argv[3])
-    find_tagged(func, param, 0, [])
-elif sys.argv[1] == "parse_warns_tagged":
-    filename = sys.argv[2]
-    parse_warns_tagged(filename)
-elif sys.argv[1] == "where":
-    if len(sys.argv) == 3:
-        struct_type = "%"
-        member = sys.argv[2]
-    elif len(sys.argv) == 4:
-        struct_type = sys.argv[2]
-        member = sys.argv[3]
-    function_type_value(struct_type, member)
-elif sys.argv[1] == "local":
-    filename = sys.argv[2]
-    variable = ""
-    if len(sys.argv) == 4:
-        variable = sys.argv[3]
-    local_values(filename, variable)
-elif sys.argv[1] == "functions":
-    if len(sys.argv) == 4:
-        struct = sys.argv[2]
-        member = sys.argv[3]
+
+    if len(argv) == 2:
+        func = argv[1]
+        print_caller_info("", func)
+    elif argv[1] == "info":
+        my_type = ""
+        if len(argv) == 4:
+            my_type = argv[3]
+        func = argv[2]
+        print_caller_info("", func, my_type)
+    elif argv[1] == "call_info":
+        if len(argv) != 4:
+            usage()
+        filename = argv[2]
+        func = argv[3]
+        caller_info_values(filename, func)
+        print_caller_info(filename, func)
+    elif argv[1] == "function_ptr" or argv[1] == "fn_ptr":
+        func = argv[2]
+        print_fn_ptrs(func)
+    elif argv[1] == "return_states":
+        func = argv[2]
+        print_return_states(func)
+        print("================================================")
+        print_return_implies(func)
+    elif argv[1] == "return_implies":
+        func = argv[2]
+        print_return_implies(func)
+    elif argv[1] == "type_size" or argv[1] == "buf_size":
+        struct_type = argv[2]
+        member = argv[3]
+        print_type_size(struct_type, member)
+    elif argv[1] == "type_info":
+        struct_type = argv[2]
+        member = argv[3]
+        print_type_info(struct_type, member)
+    elif argv[1] == "data_info":
+        struct_type = argv[2]
+        member = argv[3]
+        print_data_info(struct_type, member)
+    elif argv[1] == "call_tree":
+        func = argv[2]
+        print_call_tree(func)
+    elif argv[1] == "preempt":
+        func = argv[2]
+        print_preempt_tree(func)
+    elif argv[1] == "irq":
+        func = argv[2]
+        print_irq_tree(func)
+    elif argv[1] == "find_tagged":
+        func = argv[2]
+        param = int(argv[3])
+        find_tagged(func, param, 0, [])
+    elif argv[1] == "parse_warns_tagged":
+        filename = argv[2]
+        parse_warns_tagged(filename)
+    elif argv[1] == "where":
+        if len(argv) == 3:
+            struct_type = "%"
+            member = argv[2]
+        elif len(argv) == 4:
+            struct_type = argv[2]
+            member = argv[3]
+        function_type_value(struct_type, member)
+    elif argv[1] == "local":
+        filename = argv[2]
+        variable = ""
+        if len(argv) == 4:
+            variable = argv[3]
+        local_values(filename, variable)
+    elif argv[1] == "functions":
+        if len(argv) == 4:
+            struct = argv[2]
+            member = argv[3]
+        else:
+            struct = ""
+            member = argv[2]
+        print_functions(struct, member)
+    elif argv[1] == "trace_param":
+        if len(argv) != 4:
+            usage()
+        func = argv[2]
+        param = int(argv[3])
+        trace_param(func, param)
+    elif argv[1] == "locals":
+        if len(argv) != 3:
+            usage()
+        filename = argv[2]
+        print_locals(filename);
+    elif argv[1] == "constraint":
+        if len(argv) == 3:
+            struct_type = "%"
+            member = argv[2]
+        elif len(argv) == 4:
+            struct_type = argv[2]
+            member = argv[3]
+        constraint(struct_type, member)
     else:
-        struct = ""
-        member = sys.argv[2]
-    print_functions(struct, member)
-elif sys.argv[1] == "trace_param":
-    if len(sys.argv) != 4:
         usage()
-    func = sys.argv[2]
-    param = int(sys.argv[3])
-    trace_param(func, param)
-elif sys.argv[1] == "locals":
-    if len(sys.argv) != 3:
-        usage()
-    filename = sys.argv[2]
-    print_locals(filename);
-elif sys.argv[1] == "constraint":
-    if len(sys.argv) == 3:
-        struct_type = "%"
-        member = sys.argv[2]
-    elif len(sys.argv) == 4:
-        struct_type = sys.argv[2]
-        member = sys.argv[3]
-    constraint(struct_type, member)
+
+def serve():
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+    load_call_graph()
+    try:
+        os.unlink(SOCKET_NAME)
+    except OSError:
+        pass
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    server.bind(SOCKET_NAME)
+    server.listen(16)
+    print("smdb: listening on %s" % SOCKET_NAME)
+    try:
+        while True:
+            conn, addr = server.accept()
+            request = b""
+            while True:
+                data = conn.recv(65536)
+                if not data:
+                    break
+                request += data
+            argv = [sys.argv[0]] + request.decode().split("\0")
+            out = io.StringIO()
+            with contextlib.redirect_stdout(out):
+                try:
+                    run_command(argv)
+                except SystemExit:
+                    pass
+                except Exception as e:
+                    print("Error: %s" % e)
+            try:
+                conn.sendall(out.getvalue().encode())
+            except OSError:
+                pass
+            conn.close()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.close()
+        os.unlink(SOCKET_NAME)
+
+if len(sys.argv) == 2 and sys.argv[1] == "serve":
+    serve()
 else:
-    usage()
+    run_command(sys.argv)
@@ -19,24 +19,287 @@
 #include <errno.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <time.h>
 #include "smatch.h"
 #include "smatch_slist.h"
 #include "smatch_extra.h"
+#include "smatch_function_hashtable.h"
 
 struct sqlite3 *smatch_db;
-struct sqlite3 *mem_db;
 struct sqlite3 *cache_db;
 
 int debug_db;
 
+/*
+ * For --profile and --sql-profile.  A callback can run more queries so the
+ * time of the inner queries is taken away from the outer query and each
+ * query is only charged for its own time.
+ */
+unsigned long sql_query_count;
+unsigned long long sql_query_ns;
+static struct {
+	unsigned long long start;
+	unsigned long long child_ns;
+} sql_frames[16];
+static int sql_depth;
+
+/*
+ * --sql-profile=<file> groups the queries by their text with the strings
+ * and numbers taken out and writes how many times each one ran, the rows
+ * it returned and the time it took at exit.  Queries which take longer
+ * than --sql-slow=<ms> are listed separately with the full SQL.
+ */
+int option_sql_slow_ms = 50;
+
+struct sql_stat {
+	char *sql;
+	unsigned long count;
+	unsigned long long rows;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+	struct sql_stat *next;
+};
+static DEFINE_HASHTABLE_INSERT(insert_sql_stat, char, struct sql_stat);
+static DEFINE_HASHTABLE_SEARCH(search_sql_stat, char, struct sql_stat);
+static struct hashtable *sql_stat_hash;
+static struct sql_stat *sql_stats;
+
+#define MAX_SLOW_QUERIES 1000
+struct slow_query {
+	char *sql;
+	char *where;
+	unsigned long long rows;
+	unsigned long long ns;
+};
+static struct slow_query slow_queries[MAX_SLOW_QUERIES];
+static int nr_slow_queries;
+static unsigned long dropped_slow_queries;
+
+struct counted_rows {
+	int (*callback)(void*, int, char**, char**);
+	void *data;
+	unsigned long long rows;
+};
+
+static int count_rows(void *_counted, int argc, char **argv, char **names)
+{
+	struct counted_rows *counted = _counted;
+
+	counted->rows++;
+	if (!counted->callback)
+		return 0;
+	return counted->callback(counted->data, argc, argv, names);
+}
+
+static unsigned long long sql_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* "where function = 'foo' and file = 12" becomes "where function = ? and file = ?" */
+static char *sql_template(const char *sql)
+{
+	char *ret, *p;
+	bool ident = false;
+
+	ret = p = malloc(strlen(sql) + 1);
+	while (*sql) {
+		if (*sql == '\'') {
+			sql++;
+			while (*sql) {
+				if (sql[0] == '\'' && sql[1] == '\'')
+					sql++;
+				else if (sql[0] == '\'')
+					break;
+				sql++;
+			}
+			if (*sql)
+				sql++;
+			*p++ = '?';
+			ident = false;
+			continue;
+		}
+		if (!ident && (isdigit(*sql) ||
+			       (*sql == '-' && isdigit(sql[1])))) {
+			sql++;
+			while (isalnum(*sql))
+				sql++;
+			*p++ = '?';
+			continue;
+		}
+		ident = isalnum(*sql) || *sql == '_' || *sql == '?';
+		*p++ = *sql++;
+	}
+	*p = '\0';
+	return ret;
+}
+
+static void record_sql_stat(const char *sql, unsigned long long rows, unsigned long long ns)
+{
+	struct sql_stat *stat;
+	char *template;
+
+	if (!sql_stat_hash)
+		sql_stat_hash = create_function_hashtable(256);
+	template = sql_template(sql);
+	stat = search_sql_stat(sql_stat_hash, template);
+	if (stat) {
+		free(template);
+	} else {
+		stat = calloc(1, sizeof(*stat));
+		stat->sql = template;
+		stat->next = sql_stats;
+		sql_stats = stat;
+		insert_sql_stat(sql_stat_hash, template, stat);
+	}
+	stat->count++;
+	stat->rows += rows;
+	stat->total_ns += ns;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
+}
+
+static void record_slow_query(const char *sql, struct sqlite3_stmt *stmt,
+			      unsigned long long rows, unsigned long long ns)
+{
+	struct slow_query *slow;
+	char *expanded;
+	char buf[256];
+
+	if (nr_slow_queries >= MAX_SLOW_QUERIES) {
+		dropped_slow_queries++;
+		return;
+	}
+	slow = &slow_queries[nr_slow_queries++];
+	expanded = stmt ? sqlite3_expanded_sql(stmt) : NULL;
+	slow->sql = strdup(expanded ? expanded : sql);
+	sqlite3_free(expanded);
+	if (get_filename())
+		snprintf(buf, sizeof(buf), "%s:%d %s()", get_filename(), get_lineno(),
+			 get_function() ? get_function() : "");
+	else
+		snprintf(buf, sizeof(buf), "-");
+	slow->where = strdup(buf);
+	slow->rows = rows;
+	slow->ns = ns;
+}
+
+static void sql_profile_start(void)
+{
+	if (!option_profile && !option_sql_profile)
+		return;
+	sql_query_count++;
+	if (sql_depth < ARRAY_SIZE(sql_frames)) {
+		sql_frames[sql_depth].start = sql_now();
+		sql_frames[sql_depth].child_ns = 0;
+	}
+	sql_depth++;
+}
+
+static void sql_profile_stop(const char *sql, struct sqlite3_stmt *stmt, unsigned long long rows)
+{
+	unsigned long long total, self;
+
+	if (!option_profile && !option_sql_profile)
+		return;
+	if (--sql_depth >= ARRAY_SIZE(sql_frames))
+		return;
+	total = sql_now() - sql_frames[sql_depth].start;
+	self = total - sql_frames[sql_depth].child_ns;
+	if (sql_depth)
+		sql_frames[sql_depth - 1].child_ns += total;
+	else
+		sql_query_ns += total;
+
+	if (!option_sql_profile)
+		return;
+	record_sql_stat(sql, rows, self);
+	if (self >= option_sql_slow_ms * 1000000ULL)
+		record_slow_query(sql, stmt, rows, self);
+}
+
+static int cmp_sql_stat(const void *a, const void *b)
+{
+	const struct sql_stat *one = *(const struct sql_stat **)a;
+	const struct sql_stat *two = *(const struct sql_stat **)b;
+
+	if (one->total_ns > two->total_ns)
+		return -1;
+	if (one->total_ns < two->total_ns)
+		return 1;
+	return 0;
+}
+
+void print_sql_profile(void)
+{
+	struct sql_stat **sorted, *stat;
+	int nr = 0, i;
+	FILE *fd;
+
+	fd = fopen(option_sql_profile, "a");
+	if (!fd) {
+		sm_ierror("cannot open '%s': %m", option_sql_profile);
+		return;
+	}
+
+	for (stat = sql_stats; stat; stat = stat->next)
+		nr++;
+	sorted = malloc((nr + 1) * sizeof(*sorted));
+	i = 0;
+	for (stat = sql_stats; stat; stat = stat->next)
+		sorted[i++] = stat;
+	qsort(sorted, nr, sizeof(*sorted), cmp_sql_stat);
+
+	fprintf(fd, "count\trows\ttotal_ms\tmax_ms\tquery\n");
+	for (i = 0; i < nr; i++) {
+		stat = sorted[i];
+		fprintf(fd, "%lu\t%llu\t%.3f\t%.3f\t%s\n", stat->count, stat->rows,
+			stat->total_ns / 1000000.0, stat->max_ns / 1000000.0, stat->sql);
+	}
+	free(sorted);
+
+	if (nr_slow_queries) {
+		fprintf(fd, "\nslow queries (over %d ms)\n", option_sql_slow_ms);
+		fprintf(fd, "ms\trows\twhere\tquery\n");
+	}
+	for (i = 0; i < nr_slow_queries; i++) {
+		fprintf(fd, "%.3f\t%llu\t%s\t%s\n", slow_queries[i].ns / 1000000.0,
+			slow_queries[i].rows, slow_queries[i].where, slow_queries[i].sql);
+	}
+	if (dropped_slow_queries)
+		fprintf(fd, "... and %lu more\n", dropped_slow_queries);
+	fclose(fd);
+}
+
 static int my_id;
 
 static int return_id;
 
+/*
+ * The splitters in call_return_state_hooks() can turn a function with a lot
+ * of returns into thousands of return_states rows.  Each function gets a
+ * budget of rows.  Once half of it is used, the splits which tell the
+ * callers least (the param and impossible splits at the end of the chain)
+ * are skipped.  Once it is all used every return is recorded as one vanilla
+ * row.  The number of returns which weren't split is printed with --info.
+ */
+int option_return_budget = 1000;
+static unsigned long fn_return_rows;
+static unsigned long fn_unsplit_returns;
+
 static void call_return_state_hooks(struct expression *expr);
 static void call_return_states_callbacks(const char *return_ranges, struct expression *expr);
 
-#define SQLITE_CACHE_PAGES 1000
+
+/*
+ * The caller_info hooks are hashed on the type so that each row only looks
+ * at the callbacks which might want it.
+ */
+#define CALLER_INFO_HOOK_BITS 6
+#define CALLER_INFO_HOOK_HASH(type) ((type) & ((1 << CALLER_INFO_HOOK_BITS) - 1))
 
 struct def_callback {
 	int hook_type;
@@ -44,7 +307,7 @@ struct def_callback {
 };
 ALLOCATOR(def_callback, "definition db hook callbacks");
 DECLARE_PTR_LIST(callback_list, struct def_callback);
-static struct callback_list *select_caller_info_callbacks;
+static struct callback_list *select_caller_info_callbacks[1 << CALLER_INFO_HOOK_BITS];
 
 struct def_name_sym_callback {
 	int hook_type;
@@ -52,7 +315,7 @@ struct def_name_sym_callback {
 };
 ALLOCATOR(def_name_sym_callback, "definition db hook callbacks");
 DECLARE_PTR_LIST(name_sym_callback_list, struct def_name_sym_callback);
-static struct name_sym_callback_list *select_caller_name_sym_callbacks;
+static struct name_sym_callback_list *select_caller_name_sym_callbacks[1 << CALLER_INFO_HOOK_BITS];
 
 struct member_info_callback {
 	int owner;
@@ -109,7 +372,10 @@ struct split_data {
 static struct split_data **forced_splits;
 static int split_count;
 
-/* silently truncates if needed. */
+/*
+ * Silently truncates if needed.  If there is nothing to escape then it
+ * returns "str" itself instead of a copy.
+ */
 char *escape_newlines(const char *str)
 {
 	char buf[1024] = "";
@@ -130,13 +396,183 @@ char *escape_newlines(const char *str)
 	}
 
 	if (!found)
-		return alloc_sname(str);
+		return (char *)str;
 
 	if (j == sizeof(buf))
 		buf[j - 1] = '\0';
 	return alloc_sname(buf);
 }
 
+/*
+ * With --sql-rows the sql_insert() macros print the rows as:
+ * "SQL_row: <table> <flags> <count> <type><len>:<value> ..."
+ * The values are length prefixed so sm_fill_db can load them with a
+ * prepared statement without parsing SQL.
+ *
+ * The return_states and return_implies rows are printed by every
+ * param_used, param_set etc module for every return and only the last few
+ * columns change.  An ops struct initializer prints a function_ptr row for
+ * every member.  Between sql_group_rows_start() and sql_group_rows_end()
+ * rows which only differ in those columns are printed as one record:
+ * "SQL_rows: <table> <flags> <count> <shared> <shared values> <row values>..."
+ * where the shared values are printed once and then the other
+ * <count> - <shared> values are printed for each row.
+ */
+static const struct {
+	const char *table;
+	int shared;
+} group_tables[] = {
+	/* file, function, call_id, return_id, return, static */
+	{ "return_states", 6 },
+	/* file, function, call_id, static */
+	{ "return_implies", 4 },
+	/* file */
+	{ "function_ptr", 1 },
+};
+
+static int group_depth;
+static const char *group_table;
+static int group_flags, group_cnt;
+static char group_head[4096];
+static char group_body[16384];
+static int group_body_len;
+
+static int sql_group_shared(const char *table)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(group_tables); i++) {
+		if (strcmp(table, group_tables[i].table) == 0)
+			return group_tables[i].shared;
+	}
+	return 0;
+}
+
+void sql_flush_rows(void)
+{
+	if (!group_table)
+		return;
+	fprintf(sql_outfd, "%s%s\n", group_head, group_body);
+	group_table = NULL;
+}
+
+void sql_group_rows_start(void)
+{
+	group_depth++;
+}
+
+void sql_group_rows_end(void)
+{
+	if (--group_depth == 0)
+		sql_flush_rows();
+}
+
+static int print_values(char *buf, int size, struct sql_value *vals, int start, int end)
+{
+	const char *types = "ifs";
+	int len = 0;
+	int i;
+
+	for (i = start; i < end && len < size; i++)
+		len += snprintf(buf + len, size - len, " %c%d:%.*s",
+				types[vals[i].type], vals[i].len, vals[i].len,
+				vals[i].str);
+	return len;
+}
+
+static bool group_row(const char *table, int flags, struct sql_value *vals, int cnt)
+{
+	char head[4096];
+	int shared, len;
+
+	if (!group_depth)
+		return false;
+	shared = sql_group_shared(table);
+	if (!shared || cnt <= shared)
+		return false;
+
+	len = snprintf(head, sizeof(head), "%s:%d %s() SQL_rows: %s %c%c %d %d",
+		       get_filename(), get_lineno(), get_function(), table,
+		       flags & 1 ? 'i' : '-', flags & 2 ? 'l' : '-', cnt, shared);
+	len += print_values(head + len, sizeof(head) - len, vals, 0, shared);
+	if (len >= sizeof(head))
+		return false;
+
+	/* the file:line prefix is from the first row, only the rest has to match */
+	if (group_table &&
+	    (strcmp(group_table, table) != 0 || group_flags != flags ||
+	     group_cnt != cnt ||
+	     strcmp(strstr(group_head, "() SQL_rows: "), strstr(head, "() SQL_rows: ")) != 0))
+		sql_flush_rows();
+
+	if (!group_table) {
+		memcpy(group_head, head, len + 1);
+		group_body[0] = '\0';
+		group_body_len = 0;
+		group_table = table;
+		group_flags = flags;
+		group_cnt = cnt;
+	}
+
+	len = print_values(group_body + group_body_len,
+			   sizeof(group_body) - group_body_len, vals, shared, cnt);
+	if (group_body_len + len >= sizeof(group_body)) {
+		group_body[group_body_len] = '\0';
+		sql_flush_rows();
+		return group_row(table, flags, vals, cnt);
+	}
+	group_body_len += len;
+	return true;
+}
+
+/*
+ * Returns false if the values are too complicated and the caller should
+ * print the normal SQL instead.  sql_split_values() unescapes the values
+ * in place so it works on a copy.
+ */
+static bool sql_print_row(const char *table, int ignore, int late, const char *values)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	char buf[4096];
+	char out[8192];
+	int cnt;
+
+	snprintf(buf, sizeof(buf), "%s", values);
+	cnt = sql_split_values(buf, vals, ARRAY_SIZE(vals));
+	if (cnt <= 0)
+		return false;
+
+	if (group_row(table, (ignore ? 1 : 0) | (late ? 2 : 0), vals, cnt))
+		return true;
+
+	sql_flush_rows();
+	print_values(out, sizeof(out), vals, 0, cnt);
+	fprintf(sql_outfd, "%s:%d %s() SQL_row: %s %c%c %d%s\n", get_filename(),
+		get_lineno(), get_function(), table, ignore ? 'i' : '-',
+		late ? 'l' : '-', cnt, out);
+	return true;
+}
+
+/*
+ * The sql_insert() macros format the values into a buffer and this prints
+ * the row with one call instead of going through sm_printf() for every
+ * piece of it.
+ */
+void sql_print_insert(const char *table, int ignore, int late, char *values)
+{
+	if (!final_pass && !option_debug && !local_debug && !debug_db)
+		return;
+
+	if (option_sql_rows && sql_print_row(table, ignore, late, values))
+		return;
+
+	sql_flush_rows();
+
+	fprintf(sql_outfd, "%s:%d %s() SQL%s: insert %sinto %s values(%s);\n",
+		get_filename(), get_lineno(), get_function(), late ? "_late" : "",
+		ignore ? "or ignore " : "", table, values);
+}
+
 static int print_sql_output(void *unused, int argc, char **argv, char **azColName)
 {
 	int i;
@@ -152,9 +588,27 @@ static int print_sql_output(void *unused, int argc, char **argv, char **azColNam
 
 void sql_exec(struct sqlite3 *db, int (*callback)(void*, int, char**, char**), void *data, const char *sql)
 {
+	struct counted_rows counted = { callback, data, 0 };
 	char *err = NULL;
 	int rc;
 
+	if (option_sql_profile) {
+		callback = count_rows;
+		data = &counted;
+	}
+
+	if (db == smatch_db && db_remote_exec_needed()) {
+		if (option_debug || debug_db) {
+			sm_msg("%s", sql);
+			if (strncasecmp(sql, "select", strlen("select")) == 0)
+				db_remote_exec(sql, print_sql_output, NULL);
+		}
+		sql_profile_start();
+		db_remote_exec(sql, callback, data);
+		sql_profile_stop(sql, NULL, counted.rows);
+		return;
+	}
+
 	if (!db)
 		return;
 
@@ -164,7 +618,9 @@ void sql_exec(struct sqlite3 *db, int (*callback)(void*, int, char**, char**), v
 			sqlite3_exec(db, sql, print_sql_output, NULL, NULL);
 	}
 
+	sql_profile_start();
 	rc = sqlite3_exec(db, sql, callback, data, &err);
+	sql_profile_stop(sql, NULL, counted.rows);
 	if (rc != SQLITE_OK && !parse_error) {
 		sm_ierror("%s:%d SQL error #2: %s\n", get_filename(), get_lineno(), err);
 		sm_ierror("%s:%d SQL: '%s'\n", get_filename(), get_lineno(), sql);
@@ -172,6 +628,216 @@ void sql_exec(struct sqlite3 *db, int (*callback)(void*, int, char**, char**), v
 	}
 }
 
+/*
+ * The hot queries only differ by the function name and the file id so
+ * re-parsing the SQL every time is a waste.  Cache the prepared statements
+ * keyed on the SQL text (with "?" place holders) and bind the parameters.
+ */
+struct stmt_cache {
+	struct sqlite3 *db;
+	char *sql;
+	struct sqlite3_stmt *stmt;
+	bool busy;
+	struct stmt_cache *next;
+};
+
+#define STMT_CACHE_BITS 7
+#define STMT_CACHE_SIZE (1 << STMT_CACHE_BITS)
+static struct stmt_cache *stmt_cache_table[STMT_CACHE_SIZE];
+
+static unsigned int stmt_hash(struct sqlite3 *db, const char *sql)
+{
+	unsigned long hash = 5381 + (unsigned long)db;
+	int c;
+
+	while ((c = *sql++))
+		hash = ((hash << 5) + hash) + c;
+
+	return hash & (STMT_CACHE_SIZE - 1);
+}
+
+static struct stmt_cache *get_stmt_cache(struct sqlite3 *db, const char *sql)
+{
+	struct stmt_cache *cache;
+	unsigned int hash;
+	int rc;
+
+	hash = stmt_hash(db, sql);
+	for (cache = stmt_cache_table[hash]; cache; cache = cache->next) {
+		if (cache->db == db && strcmp(cache->sql, sql) == 0)
+			return cache;
+	}
+
+	cache = calloc(1, sizeof(*cache));
+	rc = sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT,
+				&cache->stmt, NULL);
+	if (rc != SQLITE_OK) {
+		if (!parse_error) {
+			sm_ierror("%s:%d SQL error #3: %s\n", get_filename(), get_lineno(), sqlite3_errmsg(db));
+			sm_ierror("%s:%d SQL: '%s'\n", get_filename(), get_lineno(), sql);
+			parse_error = 1;
+		}
+		free(cache);
+		return NULL;
+	}
+	cache->db = db;
+	cache->sql = strdup(sql);
+	cache->next = stmt_cache_table[hash];
+	stmt_cache_table[hash] = cache;
+
+	return cache;
+}
+
+/*
+ * The DB server doesn't have our prepared statements so the parameters are
+ * put back into the SQL text for it.
+ */
+static char *expand_bound_sql(const char *sql, const char *types, va_list args)
+{
+	char *params[16];
+	sqlite3_str *str;
+	const char *p;
+	bool quoted = false;
+	int nr = 0, n;
+	char *end;
+
+	for (; types[nr] && nr < ARRAY_SIZE(params); nr++) {
+		if (types[nr] == 's')
+			params[nr] = sqlite3_mprintf("%Q", va_arg(args, const char *));
+		else if (types[nr] == 'd')
+			params[nr] = sqlite3_mprintf("%d", va_arg(args, int));
+		else
+			params[nr] = sqlite3_mprintf("%lld", va_arg(args, long long));
+	}
+
+	str = sqlite3_str_new(NULL);
+	for (p = sql; *p; p++) {
+		if (*p == '\'')
+			quoted = !quoted;
+		if (quoted || *p != '?' || !isdigit(p[1])) {
+			sqlite3_str_appendchar(str, 1, *p);
+			continue;
+		}
+		n = strtol(p + 1, &end, 10);
+		sqlite3_str_appendall(str, n >= 1 && n <= nr ? params[n - 1] : "NULL");
+		p = end - 1;
+	}
+
+	while (nr--)
+		sqlite3_free(params[nr]);
+	return sqlite3_str_finish(str);
+}
+
+/*
+ * The "types" string says what the variable arguments are: 's' is a string,
+ * 'd' is an int and 'l' is a long long.  They are bound to ?1, ?2, etc. and
+ * parameters which the SQL doesn't use are skipped.  The callback is called
+ * the same way as sqlite3_exec() would call it.
+ */
+void sql_exec_bound(struct sqlite3 *db, int (*callback)(void*, int, char**, char**),
+		    void *data, const char *sql, const char *types, ...)
+{
+	struct stmt_cache *cache;
+	struct sqlite3_stmt *stmt;
+	char *argv[32], *names[32];
+	unsigned long long rows = 0;
+	int argc, params, i, rc;
+	va_list args;
+
+	if (db == smatch_db && db_remote_exec_needed()) {
+		char *expanded;
+
+		va_start(args, types);
+		expanded = expand_bound_sql(sql, types, args);
+		va_end(args);
+		sql_exec(db, callback, data, expanded);
+		sqlite3_free(expanded);
+		return;
+	}
+
+	if (!db)
+		return;
+
+	cache = get_stmt_cache(db, sql);
+	if (!cache)
+		return;
+
+	/* a callback can recurse back into the same query */
+	if (cache->busy) {
+		rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+		if (rc != SQLITE_OK)
+			return;
+	} else {
+		stmt = cache->stmt;
+		cache->busy = true;
+	}
+
+	params = sqlite3_bind_parameter_count(stmt);
+	va_start(args, types);
+	for (i = 0; types[i]; i++) {
+		const char *str = NULL;
+		long long ll = 0;
+
+		switch (types[i]) {
+		case 's':
+			str = va_arg(args, const char *);
+			break;
+		case 'd':
+			ll = va_arg(args, int);
+			break;
+		case 'l':
+			ll = va_arg(args, long long);
+			break;
+		}
+		if (i >= params)
+			continue;
+		if (types[i] == 's')
+			sqlite3_bind_text(stmt, i + 1, str, -1, SQLITE_STATIC);
+		else
+			sqlite3_bind_int64(stmt, i + 1, ll);
+	}
+	va_end(args);
+
+	if (option_debug || debug_db) {
+		char *expanded = sqlite3_expanded_sql(stmt);
+
+		sm_msg("%s", expanded);
+		if (strncasecmp(sql, "select", strlen("select")) == 0)
+			sqlite3_exec(db, expanded, print_sql_output, NULL, NULL);
+		sqlite3_free(expanded);
+	}
+
+	argc = sqlite3_column_count(stmt);
+	if (argc > ARRAY_SIZE(argv))
+		argc = ARRAY_SIZE(argv);
+	for (i = 0; i < argc; i++)
+		names[i] = (char *)sqlite3_column_name(stmt, i);
+
+	sql_profile_start();
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		rows++;
+		if (!callback)
+			continue;
+		for (i = 0; i < argc; i++)
+			argv[i] = (char *)sqlite3_column_text(stmt, i);
+		if (callback(data, argc, argv, names))
+			break;
+	}
+	sql_profile_stop(sql, stmt, rows);
+	if (rc != SQLITE_ROW && rc != SQLITE_DONE && !parse_error) {
+		sm_ierror("%s:%d SQL error #2: %s\n", get_filename(), get_lineno(), sqlite3_errmsg(db));
+		sm_ierror("%s:%d SQL: '%s'\n", get_filename(), get_lineno(), sql);
+		parse_error = 1;
+	}
+
+	if (stmt == cache->stmt) {
+		sqlite3_reset(stmt);
+		cache->busy = false;
+	} else {
+		sqlite3_finalize(stmt);
+	}
+}
+
 static int replace_count;
 static char **replace_table;
 static const char *replace_return_ranges(const char *return_ranges)
@@ -325,6 +991,62 @@ static char *function_signature(void)
 	return type_to_str(get_real_base_type(cur_func_sym));
 }
 
+/*
+ * The caller_info rows for a call are saved up until the next call marker.
+ * If the function already printed a call with exactly the same rows then
+ * they are thrown away.  Calls which are the same as an earlier call add
+ * nothing when the callee merges its callers.
+ */
+DEFINE_STRING_HASHTABLE_STATIC(seen_calls);
+static FILE *call_rows_fd;
+static char *call_rows;
+static size_t call_rows_size;
+
+static void flush_call_rows(void)
+{
+	char *key, *k;
+	const char *p, *line;
+
+	if (!call_rows_fd)
+		return;
+	fclose(call_rows_fd);
+	call_rows_fd = NULL;
+
+	/* the "file:line func()" prefix is left out of the key */
+	key = k = malloc(call_rows_size + 1);
+	for (line = call_rows; *line; line = p + 1) {
+		p = strstr(line, "SQL_caller_info: ");
+		if (!p)
+			p = line;
+		while (*p && *p != '\n')
+			*k++ = *p++;
+		*k++ = '\n';
+		if (!*p)
+			break;
+	}
+	*k = '\0';
+
+	if (!seen_calls)
+		seen_calls = create_function_hashtable(256);
+	if (search_seen_calls(seen_calls, key)) {
+		free(key);
+	} else {
+		insert_seen_calls(seen_calls, key, (void *)1);
+		fwrite(call_rows, 1, call_rows_size, caller_info_fd);
+	}
+	free(call_rows);
+	call_rows = NULL;
+}
+
+static void clear_seen_calls(void)
+{
+	flush_call_rows();
+	if (!seen_calls)
+		return;
+	hashtable_destroy(seen_calls, 0);
+	seen_calls = NULL;
+}
+
 void sql_insert_caller_info(struct expression *call, int type,
 		int param, const char *key, const char *value)
 {
@@ -344,10 +1066,12 @@ void sql_insert_caller_info(struct expression *call, int type,
 		return;
 
 	if (__inline_call) {
-		mem_sql(NULL, NULL,
-			"insert into caller_info values (0x%llx, '%s', '%s', %lu, %d, %d, %d, '%s', '%s');",
-			get_base_file_id(), get_function(), fn, (unsigned long)call,
-			is_static(call->fn), type, param, key, value);
+		char buf[1024];
+
+		snprintf(buf, sizeof(buf), "0x%llx, '%s', '%s', %lu, %d, %d, %d, '%s', '%s'",
+			 get_base_file_id(), get_function(), fn, (unsigned long)call,
+			 is_static(call->fn), type, param, key, value);
+		mem_db_insert("caller_info", 0, buf);
 	}
 
 	if (!option_info)
@@ -358,7 +1082,15 @@ void sql_insert_caller_info(struct expression *call, int type,
 	if (type != INTERNAL && is_common_function(fn))
 		return;
 
-	sm_outfd = caller_info_fd;
+	if (type == INTERNAL && key && strcmp(key, "%call_marker%") == 0)
+		flush_call_rows();
+	if (!call_rows_fd) {
+		call_rows_fd = open_memstream(&call_rows, &call_rows_size);
+		if (!call_rows_fd)
+			sm_fatal("open_memstream() failed");
+	}
+
+	sm_outfd = call_rows_fd;
 	sm_msg("SQL_caller_info: insert into caller_info values ("
 	       "0x%llx, '%s', '%s', %%CALL_ID%%, %d, %d, %d, '%s', '%s');",
 	       get_base_file_id(), get_function(), fn, is_static(call->fn),
@@ -368,8 +1100,46 @@ void sql_insert_caller_info(struct expression *call, int type,
 	free_string(fn);
 }
 
+/*
+ * The same function pointer rows are printed over and over.  The ops structs
+ * are seen from both the BASE_HOOK and the DECLARATION_HOOK and the same
+ * callbacks are passed around in every function of a file.  Print each row
+ * once per file.
+ */
+DEFINE_STRING_HASHTABLE_STATIC(seen_fn_ptrs);
+
+static bool fn_ptr_printed(const char *fn, const char *struct_name)
+{
+	char buf[512];
+
+	/* inline rows go to the mem-db and not printing a row isn't seeing it */
+	if (__inline_fn || !option_info)
+		return false;
+	if (!final_pass && !option_debug && !local_debug && !debug_db)
+		return false;
+
+	if (snprintf(buf, sizeof(buf), "%s %s", fn, struct_name) >= sizeof(buf))
+		return false;
+	if (!seen_fn_ptrs)
+		seen_fn_ptrs = create_function_hashtable(256);
+	if (search_seen_fn_ptrs(seen_fn_ptrs, buf))
+		return true;
+	insert_seen_fn_ptrs(seen_fn_ptrs, strdup(buf), (void *)1);
+	return false;
+}
+
+static void clear_seen_fn_ptrs(struct symbol_list *sym_list)
+{
+	if (!seen_fn_ptrs)
+		return;
+	hashtable_destroy(seen_fn_ptrs, 0);
+	seen_fn_ptrs = NULL;
+}
+
 void sql_insert_function_ptr(const char *fn, const char *struct_name)
 {
+	if (fn_ptr_printed(fn, struct_name))
+		return;
 	sql_insert_or_ignore(function_ptr, "0x%llx, '%s', '%s', 0",
 			     get_base_file_id(), fn, struct_name);
 }
@@ -528,14 +1298,58 @@ static int save_mtag(void *_tag, int argc, char **argv, char **azColName)
 	return 0;
 }
 
-int mtag_map_select_container(mtag_t tag, int container_offset, mtag_t *container)
+/*
+ * The container_of() code asks about the same mtags over and over and the
+ * DB doesn't change while we're running, so remember the answers.
+ */
+struct mtag_map_result {
+	bool container;
+	mtag_t tag;
+	int offset;
+	mtag_t result;
+	struct mtag_map_result *hash_next;
+};
+
+#define MTAG_MAP_HASH 1024
+static struct mtag_map_result *mtag_map_hash[MTAG_MAP_HASH];
+
+static mtag_t select_mtag_map(bool container, mtag_t tag, int offset)
 {
+	struct mtag_map_result **p, *res;
 	mtag_t tmp = 0;
 
-	run_sql(save_mtag, &tmp,
-		"select container from mtag_map where tag = %lld and container_offset = %d and tag_offset = 0;",
-		tag, container_offset);
+	/* the low bits of a tag are always zero, they're for the offset */
+	p = &mtag_map_hash[((((unsigned long long)tag / (MTAG_OFFSET_MASK + 1)) ^ offset) * 2 + container) % MTAG_MAP_HASH];
+	while (*p && ((*p)->container != container || (*p)->tag != tag ||
+		      (*p)->offset != offset))
+		p = &(*p)->hash_next;
+	if (*p)
+		return (*p)->result;
+
+	if (container)
+		run_sql(save_mtag, &tmp,
+			"select container from mtag_map where tag = %lld and container_offset = %d and tag_offset = 0;",
+			tag, offset);
+	else
+		run_sql(save_mtag, &tmp,
+			"select tag from mtag_map where container = %lld and container_offset = %d;",
+			tag, offset);
+
+	res = malloc(sizeof(*res));
+	res->container = container;
+	res->tag = tag;
+	res->offset = offset;
+	res->result = tmp;
+	res->hash_next = NULL;
+	*p = res;
+	return tmp;
+}
 
+int mtag_map_select_container(mtag_t tag, int container_offset, mtag_t *container)
+{
+	mtag_t tmp;
+
+	tmp = select_mtag_map(true, tag, container_offset);
 	if (tmp == 0 || tmp == -1ULL)
 		return 0;
 	*container = tmp;
@@ -544,12 +1358,9 @@ int mtag_map_select_container(mtag_t tag, int container_offset, mtag_t *containe
 
 int mtag_map_select_tag(mtag_t container, int offset, mtag_t *tag)
 {
-	mtag_t tmp = 0;
-
-	run_sql(save_mtag, &tmp,
-		"select tag from mtag_map where container = %lld and container_offset = %d;",
-		container, offset);
+	mtag_t tmp;
 
+	tmp = select_mtag_map(false, container, offset);
 	if (tmp == 0 || tmp == -1ULL)
 		return 0;
 	*tag = tmp;
@@ -578,6 +1389,62 @@ char *get_static_filter(struct symbol *sym)
 	return sql_filter;
 }
 
+/*
+ * The prepared statement version of get_static_filter().  The function name
+ * is bound to ?1 and the file id to ?2.  Use it with run_sql_static().
+ */
+const char *get_static_filter_bound(struct symbol *sym)
+{
+	/* This can only happen on buggy code.  Return invalid SQL. */
+	if (!sym || !sym->ident)
+		return "";
+
+	if (is_local(sym))
+		return "file = ?2 and function = ?1 and static = '1'";
+	return "function = ?1 and static = '0'";
+}
+
+void sql_exec_static(struct sqlite3 *db, int (*callback)(void*, int, char**, char**),
+		     void *data, struct symbol *sym, const char *sql)
+{
+	if (!sym || !sym->ident) {
+		sql_exec_bound(db, callback, data, sql, "");
+		return;
+	}
+
+	if (is_local(sym))
+		sql_exec_bound(db, callback, data, sql, "sl", sym->ident->name,
+			       (long long)get_base_file_id());
+	else
+		sql_exec_bound(db, callback, data, sql, "s", sym->ident->name);
+}
+
+/*
+ * These look up the same rows as get_static_filter() in the mmap copy of
+ * the DB.  They return false if the caller has to use SQL.
+ */
+static bool mmap_select_static(const char *table, const char *cols, bool distinct,
+			       struct symbol *sym,
+			       int (*callback)(void*, int, char**, char**), void *data)
+{
+	if (!sym || !sym->ident)
+		return false;
+	if (is_local(sym))
+		return mmap_db_select(table, cols, distinct, sym->ident->name, 1,
+				      get_base_file_id(), callback, data);
+	return mmap_db_select(table, cols, distinct, sym->ident->name, 0, 0,
+			      callback, data);
+}
+
+static bool mmap_count_static(const char *table, struct symbol *sym, int *count)
+{
+	if (!sym || !sym->ident)
+		return false;
+	if (is_local(sym))
+		return mmap_db_count(table, sym->ident->name, 1, get_base_file_id(), count);
+	return mmap_db_count(table, sym->ident->name, 0, 0, count);
+}
+
 int get_row_count(void *_row_count, int argc, char **argv, char **azColName)
 {
 	int *row_count = _row_count;
@@ -600,61 +1467,107 @@ static int save_string(void *_list, int argc, char **argv, char **azColName)
 	return 0;
 }
 
-struct string_list *get_caller_ptrs(struct symbol *sym)
+struct string_list *get_caller_ptrs(struct symbol *sym)
+{
+	struct string_list *list = NULL;
+
+	if (!sym || !sym->ident)
+		return NULL;
+
+	if (is_local(sym)) {
+		run_sql_bound(save_string, &list,
+			      "select distinct(ptr) from function_ptr where file = ?2 and function = ?1;",
+			      "sl", sym->ident->name, (long long)get_base_file_id());
+	} else {
+		run_sql_bound(save_string, &list,
+			      "select distinct(ptr) from function_ptr where function = ?1;",
+			      "s", sym->ident->name);
+	}
+
+	return list;
+}
+
+/*
+ * build_fn_ptr_targets.sh saves how many INTERNAL return_states each
+ * searchable function pointer leads to.  Older DBs don't have the table and
+ * the count has to be done with a join.  The table is only built by
+ * create_db.sh so a pointer without a row might just be newer than the
+ * table.  That has to be counted with the join as well.  The counts are saved in
+ * fn_ptr_counts (plus one, so zero isn't NULL) since the same ops pointers
+ * get called over and over.
+ */
+DEFINE_STRING_HASHTABLE_STATIC(fn_ptr_counts);
+static int have_fn_ptr_targets = -1;
+
+static int get_fn_ptr_return_count(const char *ptr)
 {
-	struct string_list *list = NULL;
-	const char *file_filter = "";
-	char buf[256];
+	int return_count = -1;
+	int *saved;
 
-	if (!sym || !sym->ident)
-		return NULL;
+	if (have_fn_ptr_targets == -1)
+		run_sql(get_row_count, &have_fn_ptr_targets,
+			"select count(*) from sqlite_master where type = 'table' and name = 'fn_ptr_targets';");
 
-	if (is_local(sym)) {
-		snprintf(buf, sizeof(buf),
-			 "file = 0x%llx and ",
-			 get_base_file_id());
-		file_filter = buf;
-	}
+	if (!fn_ptr_counts)
+		fn_ptr_counts = create_function_hashtable(1000);
+	saved = search_fn_ptr_counts(fn_ptr_counts, (char *)ptr);
+	if (saved)
+		return PTR_INT(saved) - 1;
 
-	run_sql(save_string, &list,
-		"select distinct(ptr) from function_ptr where %s function = '%s';",
-		file_filter, sym->ident->name);
+	if (have_fn_ptr_targets > 0)
+		run_sql_bound(get_row_count, &return_count,
+			      "select return_count from fn_ptr_targets where ptr = ?1;",
+			      "s", ptr);
+	if (return_count < 0)
+		run_sql_bound(get_row_count, &return_count,
+			      "select count(*) from return_states join function_ptr "
+			      "where return_states.function == function_ptr.function and "
+			      "ptr = ?1 and searchable = 1 and type = ?2;",
+			      "sd", ptr, INTERNAL);
+	if (return_count < 0)
+		return_count = 0;
 
-	return list;
+	insert_fn_ptr_counts(fn_ptr_counts, alloc_string(ptr), INT_PTR(return_count + 1));
+	return return_count;
 }
 
 static void sql_select_return_states_pointer(const char *cols,
 	struct expression *call, int (*callback)(void*, int, char**, char**), void *info)
 {
+	char sql[1024];
 	char *ptr;
-	int return_count = 0;
+	int return_count;
 
 	ptr = get_fnptr_name(call->fn);
 	if (!ptr)
 		return;
 
-	run_sql(get_row_count, &return_count,
-		"select count(*) from return_states join function_ptr "
-		"where return_states.function == function_ptr.function and "
-		"ptr = '%s' and searchable = 1 and type = %d;", ptr, INTERNAL);
+	return_count = get_fn_ptr_return_count(ptr);
+	/* There aren't any INTERNAL rows for the query to find */
+	if (return_count == 0) {
+		mark_call_params_untracked(call);
+		return;
+	}
 	/* The magic number 100 is just from testing on the kernel. */
-	if (return_count == 0 || return_count > 100) {
-		run_sql(callback, info,
+	if (return_count > 100) {
+		sqlite3_snprintf(sizeof(sql), sql,
 			"select distinct %s from return_states join function_ptr where "
-			"return_states.function == function_ptr.function and ptr = '%s' "
-			"and searchable = 1 and type = %d "
+			"return_states.function == function_ptr.function and ptr = ?1 "
+			"and searchable = 1 and type = ?2 "
 			"order by function_ptr.file, return_states.file, return_id, type;",
-			cols, ptr, INTERNAL);
+			cols);
+		run_sql_bound(callback, info, sql, "sd", ptr, INTERNAL);
 		mark_call_params_untracked(call);
 		return;
 	}
 
-	run_sql(callback, info,
+	sqlite3_snprintf(sizeof(sql), sql,
 		"select %s from return_states join function_ptr where "
-		"return_states.function == function_ptr.function and ptr = '%s' "
+		"return_states.function == function_ptr.function and ptr = ?1 "
 		"and searchable = 1 "
 		"order by function_ptr.file, return_states.file, return_id, type;",
-		cols, ptr);
+		cols);
+	run_sql_bound(callback, info, sql, "s", ptr);
 }
 
 static int is_local_symbol(struct expression *expr)
@@ -701,24 +1614,28 @@ void sql_select_return_states(const char *cols, struct expression *call,
 	}
 
 	if (inlinable(fn)) {
-		mem_sql(callback, info,
-			"select %s from return_states where call_id = '%lu' order by return_id, type;",
-			cols, (unsigned long)call);
+		mem_db_select("return_states", cols, false, (unsigned long)call,
+			      callback, info);
 		return;
 	}
 
-	run_sql(get_row_count, &row_count, "select count(*) from return_states where %s;",
-		get_static_filter(fn->symbol));
+	if (!mmap_count_static("return_states", fn->symbol, &row_count))
+		run_sql_static(get_row_count, &row_count, fn->symbol,
+			       "select count(*) from return_states where %s;",
+			       get_static_filter_bound(fn->symbol));
 	if (row_count == 0 && fn->symbol && fn->symbol->definition &&
 	    !(fn->symbol->ident && strncmp(fn->symbol->ident->name, "__smatch", 8)))
 		__db_incomplete = true;
-	if (row_count == 0 || row_count > 3000) {
+	if (row_count == 0 || row_count > (option_fast ? 300 : 3000)) {
 		mark_call_params_untracked(call);
 		return;
 	}
 
-	run_sql(callback, info, "select %s from return_states where %s order by file, return_id, type;",
-		cols, get_static_filter(fn->symbol));
+	if (mmap_select_static("return_states", cols, false, fn->symbol, callback, info))
+		return;
+	run_sql_static(callback, info, fn->symbol,
+		       "select %s from return_states where %s order by file, return_id, type;",
+		       cols, get_static_filter_bound(fn->symbol));
 }
 
 bool db_incomplete(void)
@@ -740,36 +1657,81 @@ void sql_select_implies(const char *cols, struct implies_info *info,
 	int (*callback)(void*, int, char**, char**))
 {
 	if (info->type == RETURN_IMPLIES && inlinable(info->expr->fn)) {
-		mem_sql(callback, info,
-			"select %s from return_implies where call_id = '%lu';",
-			cols, (unsigned long)info->expr);
+		mem_db_select("return_implies", cols, false,
+			      (unsigned long)info->expr, callback, info);
 		return;
 	}
 
-	run_sql(callback, info, "select %s from %s_implies where %s;",
-		cols,
-		info->type == CALL_IMPLIES ? "call" : "return",
-		get_static_filter(info->sym));
+	if (mmap_select_static(info->type == CALL_IMPLIES ? "call_implies" : "return_implies",
+			   cols, false, info->sym, callback, info))
+		return;
+	run_sql_static(callback, info, info->sym,
+		       "select %s from %s_implies where %s;",
+		       cols,
+		       info->type == CALL_IMPLIES ? "call" : "return",
+		       get_static_filter_bound(info->sym));
 }
 
+/*
+ * The caller_info rows for a function are loaded into memory first and
+ * then the hooks are called.  Each call_id is one caller and a lot of the
+ * callers pass exactly the same information so those groups of rows are
+ * only run through the hooks once.  The strings are offsets into ->strings
+ * because that gets realloc()ed.
+ */
+struct caller_info_row {
+	int call_id;
+	int type;
+	int param;
+	unsigned int key;
+	unsigned int value;
+};
+
+struct caller_info_group {
+	unsigned long hash;
+	int first_row;
+	int nr_rows;
+	int next;
+};
+
+#define CALLER_INFO_GROUP_BITS 10
+
 struct select_caller_info_data {
 	struct stree *final_states;
 	struct timeval start_time;
-	int prev_func_id;
-	int ignore;
 	int results;
+
+	struct caller_info_row *rows;
+	int nr_rows, max_rows;
+	char *strings;
+	unsigned int strings_size, strings_max;
+	struct caller_info_group *groups;
+	int nr_groups, max_groups;
+	int group_hash[1 << CALLER_INFO_GROUP_BITS];
 };
 
+/*
+ * The old limit was 5000 rows but now it's 5000 rows after the duplicate
+ * callers are removed.  This limit is just to keep the memory sane.
+ */
+#define MAX_CALLER_INFO_ROWS 5000
+#define MAX_CALLER_INFO_LOAD 100000
+
 static int caller_info_callback(void *_data, int argc, char **argv, char **azColName);
+static void process_caller_info(struct select_caller_info_data *data, int first_row);
+static void run_caller_info_groups(struct select_caller_info_data *data, int first_group);
+static int index_caller_info_groups(struct select_caller_info_data *data, int first_row);
+static void unindex_caller_info_groups(struct select_caller_info_data *data, int first_group);
 
 static bool too_much_caller_info_data(struct symbol *sym)
 {
 	int count = 0;
 
-	run_sql(get_row_count, &count,
-		"select count(*) from caller_info where %s;",
-		get_static_filter(sym));
-	if (count > 5000)
+	if (!mmap_count_static("caller_info", sym, &count))
+		run_sql_static(get_row_count, &count, sym,
+			       "select count(*) from caller_info where %s;",
+			       get_static_filter_bound(sym));
+	if (count > MAX_CALLER_INFO_LOAD)
 		return true;
 	return false;
 }
@@ -777,27 +1739,42 @@ static bool too_much_caller_info_data(struct symbol *sym)
 static void sql_select_caller_info(struct select_caller_info_data *data,
 	const char *cols, struct symbol *sym)
 {
+	int first_row = data->nr_rows;
+	int first_group = data->nr_groups;
+
 	if (__inline_fn) {
-		mem_sql(caller_info_callback, data,
-			"select %s from caller_info where call_id = %lu;",
-			cols, (unsigned long)__inline_fn);
+		mem_db_select("caller_info", cols, false, (unsigned long)__inline_fn,
+			      caller_info_callback, data);
+		process_caller_info(data, first_row);
 		return;
 	}
 
 	if (is_common_function(sym->ident->name))
 		return;
-	run_sql(caller_info_callback, data,
-		"select %s from common_caller_info where %s order by call_id;",
-		cols, get_static_filter(sym));
-	if (data->results)
+	if (!mmap_select_static("common_caller_info", cols, false, sym,
+			    caller_info_callback, data))
+		run_sql_static(caller_info_callback, data, sym,
+			       "select %s from common_caller_info where %s order by call_id;",
+			       cols, get_static_filter_bound(sym));
+	if (data->results) {
+		process_caller_info(data, first_row);
 		return;
+	}
 
 	if (too_much_caller_info_data(sym))
 		return;
 
-	run_sql(caller_info_callback, data,
-		"select %s from caller_info where %s order by call_id;",
-		cols, get_static_filter(sym));
+	if (!mmap_select_static("caller_info", cols, false, sym, caller_info_callback, data))
+		run_sql_static(caller_info_callback, data, sym,
+			       "select %s from caller_info where %s order by call_id;",
+			       cols, get_static_filter_bound(sym));
+
+	if (index_caller_info_groups(data, first_row) > MAX_CALLER_INFO_ROWS) {
+		unindex_caller_info_groups(data, first_group);
+		data->nr_rows = first_row;
+		return;
+	}
+	run_caller_info_groups(data, first_group);
 }
 
 void select_caller_info_hook(void (*callback)(const char *name, struct symbol *sym, char *key, char *value), int type)
@@ -806,7 +1783,7 @@ void select_caller_info_hook(void (*callback)(const char *name, struct symbol *s
 
 	def_callback->hook_type = type;
 	def_callback->callback = callback;
-	add_ptr_list(&select_caller_info_callbacks, def_callback);
+	add_ptr_list(&select_caller_info_callbacks[CALLER_INFO_HOOK_HASH(type)], def_callback);
 }
 
 void select_caller_name_sym(void (*fn)(const char *name, struct symbol *sym, char *value), int type)
@@ -815,7 +1792,7 @@ void select_caller_name_sym(void (*fn)(const char *name, struct symbol *sym, cha
 
 	callback->hook_type = type;
 	callback->callback = fn;
-	add_ptr_list(&select_caller_name_sym_callbacks, callback);
+	add_ptr_list(&select_caller_name_sym_callbacks[CALLER_INFO_HOOK_HASH(type)], callback);
 }
 
 /*
@@ -918,6 +1895,82 @@ static int db_return_callback(void *_ret_info, int argc, char **argv, char **azC
 	return 0;
 }
 
+/*
+ * The distinct return strings for a function don't depend on the caller so
+ * they are saved for the whole run instead of just the current function.
+ * The DB doesn't change while we are running.  The inline data in
+ * smatch_mem_db.c does but that's looked up by call_id and not cached here.
+ */
+struct returns_cache {
+	struct string_list *returns;
+};
+static DEFINE_HASHTABLE_INSERT(insert_returns_cache, char, struct returns_cache);
+static DEFINE_HASHTABLE_SEARCH(search_returns_cache, char, struct returns_cache);
+static struct hashtable *returns_cache_table;
+
+static int save_return_str(void *_cache, int argc, char **argv, char **azColName)
+{
+	struct returns_cache *cache = _cache;
+
+	if (argc != 1)
+		return 0;
+	insert_string(&cache->returns, argv[0]);
+	return 0;
+}
+
+/*
+ * If "sym" is NULL then this is every return for "fn_name" regardless of
+ * whether it's static.
+ */
+static struct string_list *get_distinct_returns(struct symbol *sym, const char *fn_name)
+{
+	struct returns_cache *cache;
+	char buf[256];
+
+	if (sym) {
+		if (!sym->ident)
+			return NULL;
+		fn_name = sym->ident->name;
+		if (is_local(sym))
+			snprintf(buf, sizeof(buf), "1:%llx:%s", get_base_file_id(), fn_name);
+		else
+			snprintf(buf, sizeof(buf), "0:%s", fn_name);
+	} else {
+		snprintf(buf, sizeof(buf), "*:%s", fn_name);
+	}
+
+	if (!returns_cache_table)
+		returns_cache_table = create_function_hashtable(4000);
+	cache = search_returns_cache(returns_cache_table, buf);
+	if (cache)
+		return cache->returns;
+
+	cache = malloc(sizeof(*cache));
+	cache->returns = NULL;
+	if (!sym) {
+		run_sql_bound(save_return_str, cache,
+			      "select distinct return from return_states where function = ?1;",
+			      "s", fn_name);
+	} else if (!mmap_select_static("return_states", "return", true, sym,
+				       save_return_str, cache)) {
+		run_sql_static(save_return_str, cache, sym,
+			       "select distinct return from return_states where %s;",
+			       get_static_filter_bound(sym));
+	}
+	insert_returns_cache(returns_cache_table, alloc_string(buf), cache);
+
+	return cache->returns;
+}
+
+static void db_returns_to_rl(struct return_info *ret_info, struct string_list *returns)
+{
+	char *str;
+
+	FOR_EACH_PTR(returns, str) {
+		db_return_callback(ret_info, 1, &str, NULL);
+	} END_FOR_EACH_PTR(str);
+}
+
 static struct expression *cached_expr, *cached_no_args;
 static const char *cached_str;
 static struct range_list *cached_rl, *cached_str_rl, *cached_no_args_rl;
@@ -964,13 +2017,10 @@ struct range_list *db_return_vals(struct expression *expr)
 
 	ret_info.return_range_list = NULL;
 	if (inlinable(expr->fn)) {
-		mem_sql(db_return_callback, &ret_info,
-			"select distinct return from return_states where call_id = '%lu';",
-			(unsigned long)expr);
+		mem_db_select("return_states", "return", true, (unsigned long)expr,
+			      db_return_callback, &ret_info);
 	} else {
-		run_sql(db_return_callback, &ret_info,
-			"select distinct return from return_states where %s;",
-			get_static_filter(expr->fn->symbol));
+		db_returns_to_rl(&ret_info, get_distinct_returns(expr->fn->symbol, NULL));
 	}
 	cached_rl = clone_rl(ret_info.return_range_list);
 	return ret_info.return_range_list;
@@ -991,9 +2041,7 @@ struct range_list *db_return_vals_from_str(const char *fn_name)
 	ret_info.return_type = &llong_ctype;
 	ret_info.return_range_list = NULL;
 
-	run_sql(db_return_callback, &ret_info,
-		"select distinct return from return_states where function = '%s';",
-		fn_name);
+	db_returns_to_rl(&ret_info, get_distinct_returns(NULL, fn_name));
 	cached_str_rl = clone_rl(ret_info.return_range_list);
 	return ret_info.return_range_list;
 }
@@ -1023,9 +2071,7 @@ struct range_list *db_return_vals_no_args(struct expression *expr)
 	if (!ret_info.return_type)
 		return NULL;
 
-	run_sql(db_return_callback, &ret_info,
-		"select distinct return from return_states where %s;",
-		get_static_filter(expr->symbol));
+	db_returns_to_rl(&ret_info, get_distinct_returns(expr->symbol, NULL));
 
 	cached_no_args_rl = clone_rl(ret_info.return_range_list);
 	return ret_info.return_range_list;
@@ -1162,8 +2208,8 @@ static void print_struct_members(struct expression *call, struct expression *exp
 		goto free;
 
 	len = strlen(name);
-	FOR_EACH_SM(__get_cur_stree(), sm) {
-		if (sm->owner != owner || sm->sym != sym)
+	FOR_EACH_MY_SM(owner, __get_cur_stree(), sm) {
+		if (sm->sym != sym)
 			continue;
 
 		sm_name = sm->name;
@@ -1309,67 +2355,164 @@ static int function_signature_matches(const char *sig)
 	return 0;
 }
 
+static unsigned int add_caller_info_string(struct select_caller_info_data *data,
+					   const char *str)
+{
+	unsigned int len = strlen(str) + 1;
+	unsigned int ret;
+
+	if (data->strings_size + len > data->strings_max) {
+		data->strings_max = (data->strings_max + len) * 2;
+		data->strings = realloc(data->strings, data->strings_max);
+	}
+	ret = data->strings_size;
+	memcpy(data->strings + ret, str, len);
+	data->strings_size += len;
+
+	return ret;
+}
+
 static int caller_info_callback(void *_data, int argc, char **argv, char **azColName)
 {
 	struct select_caller_info_data *data = _data;
-	int func_id;
-	long type;
-	long param;
-	char *key;
-	char *value;
-	char *name = NULL;
-	struct symbol *sym = NULL;
-	struct def_callback *def_callback;
-	struct def_name_sym_callback *ns_callback;
-	struct stree *stree;
-	struct timeval cur_time;
-	char fullname[256];
-	char *p;
+	struct caller_info_row *row;
+	long type, param;
 
 	data->results = 1;
 
 	if (argc != 5)
 		return 0;
-
-	gettimeofday(&cur_time, NULL);
-	if (cur_time.tv_sec - data->start_time.tv_sec > 10)
+	if (data->nr_rows >= MAX_CALLER_INFO_LOAD)
 		return 0;
 
-	func_id = atoi(argv[0]);
 	errno = 0;
 	type = strtol(argv[1], NULL, 10);
 	param = strtol(argv[2], NULL, 10);
 	if (errno)
 		return 0;
-	key = argv[3];
-	value = argv[4];
 
-	if (data->prev_func_id == -1)
-		data->prev_func_id = func_id;
-	if (func_id != data->prev_func_id) {
-		stree = __pop_fake_cur_stree();
-		if (!data->ignore)
-			merge_stree(&data->final_states, stree);
-		free_stree(&stree);
-		__push_fake_cur_stree();
-		__unnullify_path();
-		data->prev_func_id = func_id;
-		data->ignore = 0;
+	if (data->nr_rows == data->max_rows) {
+		data->max_rows = data->max_rows ? data->max_rows * 2 : 64;
+		data->rows = realloc(data->rows, data->max_rows * sizeof(*data->rows));
 	}
+	row = &data->rows[data->nr_rows++];
+	row->call_id = atoi(argv[0]);
+	row->type = type;
+	row->param = param;
+	row->key = add_caller_info_string(data, argv[3]);
+	row->value = add_caller_info_string(data, argv[4]);
 
-	if (data->ignore)
-		return 0;
-	if (type == INTERNAL &&
-	    !function_signature_matches(value)) {
-		data->ignore = 1;
-		return 0;
+	return 0;
+}
+
+static unsigned long hash_caller_info_row(struct select_caller_info_data *data,
+					  struct caller_info_row *row)
+{
+	unsigned long hash;
+
+	hash = str_to_llu_hash_helper(data->strings + row->key);
+	hash ^= str_to_llu_hash_helper(data->strings + row->value) * 31;
+	hash ^= ((unsigned long)row->type << 16) ^ row->param;
+
+	return hash;
+}
+
+static bool caller_info_groups_equal(struct select_caller_info_data *data,
+				     struct caller_info_group *one,
+				     struct caller_info_group *two)
+{
+	struct caller_info_row *a, *b;
+	int i;
+
+	if (one->hash != two->hash || one->nr_rows != two->nr_rows)
+		return false;
+
+	for (i = 0; i < one->nr_rows; i++) {
+		a = &data->rows[one->first_row + i];
+		b = &data->rows[two->first_row + i];
+		if (a->type != b->type || a->param != b->param ||
+		    strcmp(data->strings + a->key, data->strings + b->key) != 0 ||
+		    strcmp(data->strings + a->value, data->strings + b->value) != 0)
+			return false;
 	}
+	return true;
+}
 
-	if (param >= 0 && !get_param(param, &name, &sym))
-		return 0;
+/*
+ * Split the rows starting at first_row into call_id groups.  The groups
+ * which are the same as an earlier group get ->nr_rows set to zero.
+ * Returns the number of rows which are left.
+ */
+static int index_caller_info_groups(struct select_caller_info_data *data, int first_row)
+{
+	struct caller_info_group *group, *tmp;
+	int start, end, bucket, i;
+	int total = 0;
+
+	for (start = first_row; start < data->nr_rows; start = end) {
+		if (data->nr_groups == data->max_groups) {
+			data->max_groups = data->max_groups ? data->max_groups * 2 : 64;
+			data->groups = realloc(data->groups,
+					       data->max_groups * sizeof(*data->groups));
+		}
+		group = &data->groups[data->nr_groups];
+		group->hash = 0;
+		for (end = start; end < data->nr_rows &&
+		     data->rows[end].call_id == data->rows[start].call_id; end++)
+			group->hash = group->hash * 47 + hash_caller_info_row(data, &data->rows[end]);
+		group->first_row = start;
+		group->nr_rows = end - start;
+
+		bucket = group->hash & ((1 << CALLER_INFO_GROUP_BITS) - 1);
+		for (i = data->group_hash[bucket] - 1; i >= 0; i = tmp->next) {
+			tmp = &data->groups[i];
+			if (caller_info_groups_equal(data, tmp, group))
+				break;
+		}
+		if (i >= 0)
+			group->nr_rows = 0;
+		total += group->nr_rows;
+
+		group->next = data->group_hash[bucket] - 1;
+		data->group_hash[bucket] = ++data->nr_groups;
+	}
+
+	return total;
+}
+
+static void unindex_caller_info_groups(struct select_caller_info_data *data, int first_group)
+{
+	struct caller_info_group *group;
+	int bucket;
+
+	while (data->nr_groups > first_group) {
+		group = &data->groups[--data->nr_groups];
+		bucket = group->hash & ((1 << CALLER_INFO_GROUP_BITS) - 1);
+		data->group_hash[bucket] = group->next + 1;
+	}
+}
+
+static void free_caller_info_data(struct select_caller_info_data *data)
+{
+	free(data->rows);
+	free(data->strings);
+	free(data->groups);
+}
+
+static void caller_info_hooks(struct caller_info_row *row, char *key, char *value)
+{
+	char *name = NULL;
+	struct symbol *sym = NULL;
+	struct def_callback *def_callback;
+	struct def_name_sym_callback *ns_callback;
+	char fullname[256];
+	char *p;
+
+	if (row->param >= 0 && !get_param(row->param, &name, &sym))
+		return;
 
-	FOR_EACH_PTR(select_caller_info_callbacks, def_callback) {
-		if (def_callback->hook_type == type)
+	FOR_EACH_PTR(select_caller_info_callbacks[CALLER_INFO_HOOK_HASH(row->type)], def_callback) {
+		if (def_callback->hook_type == row->type)
 			def_callback->callback(name, sym, key, value);
 	} END_FOR_EACH_PTR(def_callback);
 
@@ -1379,12 +2522,61 @@ static int caller_info_callback(void *_data, int argc, char **argv, char **azCol
 	else
 		snprintf(fullname, sizeof(fullname), "%s", key);
 
-	FOR_EACH_PTR(select_caller_name_sym_callbacks, ns_callback) {
-		if (ns_callback->hook_type == type)
+	FOR_EACH_PTR(select_caller_name_sym_callbacks[CALLER_INFO_HOOK_HASH(row->type)], ns_callback) {
+		if (ns_callback->hook_type == row->type)
 			ns_callback->callback(fullname, sym, value);
 	} END_FOR_EACH_PTR(ns_callback);
+}
 
-	return 0;
+/*
+ * Each caller is run through the hooks on its own fake stree and then all
+ * the callers are merged together into ->final_states.
+ */
+static void run_caller_info_groups(struct select_caller_info_data *data, int first_group)
+{
+	struct caller_info_group *group;
+	struct caller_info_row *row;
+	struct timeval cur_time;
+	struct stree *stree;
+	bool ignore;
+	int i, j;
+
+	for (i = first_group; i < data->nr_groups; i++) {
+		group = &data->groups[i];
+		if (!group->nr_rows)
+			continue;
+
+		gettimeofday(&cur_time, NULL);
+		if (cur_time.tv_sec - data->start_time.tv_sec > 10)
+			return;
+
+		ignore = false;
+		for (j = 0; j < group->nr_rows; j++) {
+			row = &data->rows[group->first_row + j];
+			if (row->type == INTERNAL &&
+			    !function_signature_matches(data->strings + row->value)) {
+				ignore = true;
+				break;
+			}
+			caller_info_hooks(row, data->strings + row->key,
+					  data->strings + row->value);
+		}
+
+		stree = __pop_fake_cur_stree();
+		if (!ignore)
+			merge_stree(&data->final_states, stree);
+		free_stree(&stree);
+		__push_fake_cur_stree();
+		__unnullify_path();
+	}
+}
+
+static void process_caller_info(struct select_caller_info_data *data, int first_row)
+{
+	int first_group = data->nr_groups;
+
+	index_caller_info_groups(data, first_row);
+	run_caller_info_groups(data, first_group);
 }
 
 static struct string_list *ptr_names_done;
@@ -1410,22 +2602,20 @@ static char *get_next_ptr_name(void)
 
 static void get_ptr_names(unsigned long long file, const char *name)
 {
-	char sql_filter[1024];
 	int before, after;
 
+	before = ptr_list_size((struct ptr_list *)ptr_names);
+
 	if (file) {
-		snprintf(sql_filter, 1024, "file = 0x%llx and function = '%s';",
-			 file, name);
+		run_sql_bound(get_ptr_name, NULL,
+			      "select distinct ptr from function_ptr where file = ?2 and function = ?1;",
+			      "sl", name, (long long)file);
 	} else {
-		snprintf(sql_filter, 1024, "function = '%s';", name);
+		run_sql_bound(get_ptr_name, NULL,
+			      "select distinct ptr from function_ptr where function = ?1;",
+			      "s", name);
 	}
 
-	before = ptr_list_size((struct ptr_list *)ptr_names);
-
-	run_sql(get_ptr_name, NULL,
-		"select distinct ptr from function_ptr where %s",
-		sql_filter);
-
 	after = ptr_list_size((struct ptr_list *)ptr_names);
 	if (before == after)
 		return;
@@ -1436,7 +2626,7 @@ static void get_ptr_names(unsigned long long file, const char *name)
 
 static void match_data_from_db(struct symbol *sym)
 {
-	struct select_caller_info_data data = { .prev_func_id = -1 };
+	struct select_caller_info_data data = {};
 	struct sm_state *sm;
 	struct stree *stree;
 	struct timeval end_time;
@@ -1469,22 +2659,17 @@ static void match_data_from_db(struct symbol *sym)
 				       "call_id, type, parameter, key, value",
 				       sym);
 
-
-		stree = __pop_fake_cur_stree();
-		if (!data.ignore)
-			merge_stree(&data.final_states, stree);
-		free_stree(&stree);
-		__push_fake_cur_stree();
-		__unnullify_path();
-		data.prev_func_id = -1;
-		data.ignore = 0;
 		data.results = 0;
 
+		/* A call_id is only one caller within one query */
 		FOR_EACH_PTR(ptr_names, ptr) {
-			run_sql(caller_info_callback, &data,
-				"select call_id, type, parameter, key, value"
-				" from common_caller_info where function = '%s' order by call_id",
-				ptr);
+			int first_row = data.nr_rows;
+
+			run_sql_bound(caller_info_callback, &data,
+				      "select call_id, type, parameter, key, value"
+				      " from common_caller_info where function = ?1 order by call_id",
+				      "s", ptr);
+			process_caller_info(&data, first_row);
 		} END_FOR_EACH_PTR(ptr);
 
 		if (data.results) {
@@ -1495,10 +2680,13 @@ static void match_data_from_db(struct symbol *sym)
 		}
 
 		FOR_EACH_PTR(ptr_names, ptr) {
-			run_sql(caller_info_callback, &data,
-				"select call_id, type, parameter, key, value"
-				" from caller_info where function = '%s' order by call_id",
-				ptr);
+			int first_row = data.nr_rows;
+
+			run_sql_bound(caller_info_callback, &data,
+				      "select call_id, type, parameter, key, value"
+				      " from caller_info where function = ?1 order by call_id",
+				      "s", ptr);
+			process_caller_info(&data, first_row);
 			free_string(ptr);
 		} END_FOR_EACH_PTR(ptr);
 
@@ -1512,9 +2700,8 @@ free_ptr_names:
 	}
 
 	stree = __pop_fake_cur_stree();
-	if (!data.ignore)
-		merge_stree(&data.final_states, stree);
 	free_stree(&stree);
+	free_caller_info_data(&data);
 
 	gettimeofday(&end_time, NULL);
 	if (end_time.tv_sec - data.start_time.tv_sec <= 10) {
@@ -1895,9 +3082,12 @@ static void call_return_states_callbacks(const char *return_ranges, struct expre
 		return;
 
 	return_id++;
+	fn_return_rows++;
+	sql_group_rows_start();
 	FOR_EACH_PTR(returned_state_callbacks, cb) {
 		cb->callback(return_id, (char *)return_ranges, expr);
 	} END_FOR_EACH_PTR(cb);
+	sql_group_rows_end();
 }
 
 static void call_return_state_hooks_compare(struct expression *expr)
@@ -2009,6 +3199,9 @@ static int split_possible_helper(struct sm_state *sm, struct expression *expr)
 	nr_states = get_db_state_count();
 	if (nr_states * nr_possible >= 2000 && !is_implies_function(expr))
 		return 0;
+	if (fn_return_rows + nr_possible > option_return_budget &&
+	    !is_implies_function(expr))
+		return 0;
 
 	FOR_EACH_PTR(sm->possible, tmp) {
 		if (!is_leaf(tmp))
@@ -2601,6 +3794,11 @@ static void call_return_state_hooks(struct expression *expr)
 	if (is_impossible_path())
 		goto vanilla;
 
+	if (fn_return_rows >= option_return_budget) {
+		fn_unsplit_returns++;
+		goto vanilla;
+	}
+
 	if (expr && (expr->type == EXPR_COMPARE ||
 		     !get_implied_value(expr, &sval)) &&
 	    (is_condition(expr) || is_boolean_return(expr))) {
@@ -2628,6 +3826,9 @@ static void call_return_state_hooks(struct expression *expr)
 		if (debug_db)
 			sm_msg("%s: positive negative", __func__);
 		return;
+	} else if (fn_return_rows >= option_return_budget / 2) {
+		fn_unsplit_returns++;
+		goto vanilla;
 	} else if (call_return_state_hooks_split_null_non_null_zero(expr)) {
 		if (debug_db)
 			sm_msg("%s: split zero non-zero", __func__);
@@ -2752,92 +3953,22 @@ static void print_return_info(int return_id, char *return_ranges, struct express
 	} END_FOR_EACH_PTR(cb);
 }
 
-static void reset_memdb(struct symbol *sym)
-{
-	mem_sql(NULL, NULL, "delete from caller_info;");
-	mem_sql(NULL, NULL, "delete from return_states;");
-	mem_sql(NULL, NULL, "delete from call_implies;");
-	mem_sql(NULL, NULL, "delete from return_implies;");
-}
-
 static void match_end_func_info(struct symbol *sym)
 {
-	if (__path_is_null())
-		return;
-	call_return_state_hooks(NULL);
+	if (!__path_is_null())
+		call_return_state_hooks(NULL);
+
+	if (fn_unsplit_returns)
+		sm_info("return budget: %lu rows, %lu returns not split",
+			fn_return_rows, fn_unsplit_returns);
 }
 
 static void match_after_func(struct symbol *sym)
 {
 	clear_cached_return_vals();
-	if (!__inline_fn)
-		reset_memdb(sym);
-}
-
-static void init_memdb(void)
-{
-	char *err = NULL;
-	int rc;
-	const char *schema_files[] = {
-		"db/db.schema",
-		"db/caller_info.schema",
-		"db/common_caller_info.schema",
-		"db/return_states.schema",
-		"db/function_type_size.schema",
-		"db/type_size.schema",
-		"db/function_type_info.schema",
-		"db/type_info.schema",
-		"db/call_implies.schema",
-		"db/return_implies.schema",
-		"db/function_ptr.schema",
-		"db/local_values.schema",
-		"db/function_type_value.schema",
-		"db/type_value.schema",
-		"db/function_type.schema",
-		"db/data_info.schema",
-		"db/parameter_name.schema",
-		"db/constraints.schema",
-		"db/constraints_required.schema",
-		"db/fn_ptr_data_link.schema",
-		"db/fn_data_link.schema",
-		"db/mtag_about.schema",
-		"db/mtag_info.schema",
-		"db/mtag_map.schema",
-		"db/mtag_data.schema",
-		"db/mtag_alias.schema",
-	};
-	static char buf[4096];
-	int fd;
-	int ret;
-	int i;
-
-	rc = sqlite3_open(":memory:", &mem_db);
-	if (rc != SQLITE_OK) {
-		sm_ierror("starting In-Memory database.");
-		return;
-	}
-
-	for (i = 0; i < ARRAY_SIZE(schema_files); i++) {
-		fd = open_schema_file(schema_files[i]);
-		if (fd < 0)
-			continue;
-		ret = read(fd, buf, sizeof(buf));
-		if (ret < 0) {
-			sm_ierror("failed to read: %s", schema_files[i]);
-			continue;
-		}
-		close(fd);
-		if (ret == sizeof(buf)) {
-			sm_ierror("Schema file too large:  %s (limit %zd bytes)",
-			       schema_files[i], sizeof(buf));
-			continue;
-		}
-		buf[ret] = '\0';
-		rc = sqlite3_exec(mem_db, buf, NULL, NULL, &err);
-		if (rc != SQLITE_OK) {
-			sm_ierror("SQL error #2: %s", err);
-			sm_ierror("%s", buf);
-		}
+	if (!__inline_fn) {
+		mem_db_clear();
+		clear_seen_calls();
 	}
 }
 
@@ -2860,7 +3991,9 @@ static void init_cachedb(void)
 	int ret;
 	int i;
 
-	rc = sqlite3_open(":memory:", &cache_db);
+	rc = sqlite3_open_v2(":memory:", &cache_db,
+			     SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX,
+			     NULL);
 	if (rc != SQLITE_OK) {
 		sm_ierror("starting In-Memory database.");
 		return;
@@ -2933,27 +4066,95 @@ static void dump_cache(struct symbol_list *sym_list)
 	}
 }
 
+static const char *uri_escape(const char *path)
+{
+	static char buf[PATH_MAX * 3];
+	char *p = buf;
+
+	while (*path && p < buf + sizeof(buf) - 4) {
+		if (*path == '%' || *path == '?' || *path == '#')
+			p += sprintf(p, "%%%02x", (unsigned char)*path);
+		else
+			*p++ = *path;
+		path++;
+	}
+	*p = '\0';
+
+	return buf;
+}
+
+/*
+ * Only the main thread uses smatch_db and cache_db.  The --db-prefetch
+ * thread has its own connection and the --jobs workers are forked.  So the
+ * handles are opened with SQLITE_OPEN_NOMUTEX and SQLite doesn't take a lock
+ * on every sqlite3_step() and sqlite3_column_*() call.  Anything which
+ * wants to read the DB from another thread has to open its own connection
+ * the way smatch_db_prefetch.c does.
+ */
 void open_smatch_db(char *db_file)
 {
+	int flags = SQLITE_OPEN_READONLY;
+	const char *name = db_file;
+	char *uri = NULL;
 	int rc;
 
-	if (option_no_db)
-		return;
-
+	/* db_ignore_states() is called even with --no-db */
 	use_states = malloc(num_checks);
 	memset(use_states, 0xff, num_checks);
 
-	init_memdb();
+	if (option_no_db)
+		return;
+
 	init_cachedb();
 
-	rc = sqlite3_open_v2(db_file, &smatch_db, SQLITE_OPEN_READONLY, NULL);
+	if (option_db_replay) {
+		if (!db_replay_open(option_db_replay))
+			option_no_db = 1;
+		return;
+	}
+
+	if (option_db_remote) {
+		if (!db_remote_open(option_db_remote)) {
+			option_no_db = 1;
+			return;
+		}
+		/* the server only takes rows */
+		if (option_info) {
+			option_sql_rows = 1;
+			sql_outfd = caller_info_fd = db_remote_info_file();
+		}
+		return;
+	}
+
+	/*
+	 * With immutable=1 SQLite doesn't do any locking or check whether the
+	 * file changed so the pages can be shared through mmap without each
+	 * process re-reading them.
+	 */
+	if (option_db_immutable) {
+		uri = sqlite3_mprintf("file:%s?immutable=1", uri_escape(db_file));
+		name = uri;
+		flags |= SQLITE_OPEN_URI;
+	}
+	rc = sqlite3_open_v2(name, &smatch_db, flags | SQLITE_OPEN_NOMUTEX, NULL);
 	if (rc != SQLITE_OK) {
+		sqlite3_free(uri);
 		option_no_db = 1;
 		return;
 	}
 	run_sql(NULL, NULL,
-		"PRAGMA cache_size = %d;", SQLITE_CACHE_PAGES);
-	return;
+		"PRAGMA cache_size = %d;", option_db_cache_size);
+	if (option_db_mmap_size)
+		run_sql(NULL, NULL,
+			"PRAGMA mmap_size = %lld;", option_db_mmap_size);
+	/* the mmap lookups don't go through SQL so they can't be captured */
+	if (option_db_capture && db_capture_open(option_db_capture)) {
+		sqlite3_free(uri);
+		return;
+	}
+	open_mmap_db(db_file);
+	db_prefetch_open(name, flags);
+	sqlite3_free(uri);
 }
 
 static char *get_next_string(char **str)
@@ -3168,6 +4369,9 @@ void register_definition_db_callbacks(int id)
 	add_hook(&match_end_func_info, END_FUNC_HOOK);
 	add_hook(&match_after_func, AFTER_FUNC_HOOK);
 
+	add_function_data(&fn_return_rows);
+	add_function_data(&fn_unsplit_returns);
+
 	add_hook(&match_data_from_db, FUNC_DEF_HOOK);
 	add_hook(&match_call_implies, FUNC_DEF_HOOK);
 	add_hook(&clear_incomplete, FUNC_DEF_HOOK);
@@ -3179,6 +4383,7 @@ void register_definition_db_callbacks(int id)
 	register_forced_return_splits();
 
 	add_hook(&dump_cache, END_FILE_HOOK);
+	add_hook(&clear_seen_fn_ptrs, END_FILE_HOOK);
 }
 
 void register_definition_db_callbacks_late(int id)
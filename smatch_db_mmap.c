@@ -0,0 +1,273 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * If sm_mmap_db has been run then smatch_db.sqlite.mmap has a copy of the
+ * tables we look up by function name.  Reading that is just a hash lookup
+ * and all the smatch processes share the same page cache instead of having
+ * their own SQLite caches.
+ *
+ * The callbacks are called the same way that sqlite3_exec() would call them
+ * so the callers can fall back to SQL if the file isn't there.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "smatch.h"
+#include "smatch_db_mmap.h"
+
+static char *mmap_db;
+static struct mmap_db_header *header;
+
+void open_mmap_db(const char *db_file)
+{
+	struct stat db_st, st;
+	char name[PATH_MAX];
+	uint64_t end;
+	void *p;
+	int fd, i;
+
+	if (option_no_mmap_db || stat(db_file, &db_st))
+		return;
+
+	snprintf(name, sizeof(name), "%s.mmap", db_file);
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) || st.st_size < sizeof(*header))
+		goto close;
+
+	/*
+	 * The callbacks are allowed to modify the strings so this is a private
+	 * writable mapping.  The pages are only copied if someone writes.
+	 */
+	p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED)
+		goto close;
+
+	header = p;
+	end = header->strings + header->strings_size;
+	if (memcmp(header->magic, MMAP_DB_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->nr_tables > MMAP_DB_MAX_TABLES ||
+	    end > st.st_size || end < header->strings)
+		goto unmap;
+	for (i = 0; i < header->nr_tables; i++) {
+		struct mmap_db_table *table;
+
+		if (header->tables[i] + sizeof(*table) > header->strings)
+			goto unmap;
+		table = (struct mmap_db_table *)((char *)p + header->tables[i]);
+		if (table->nr_buckets == 0 ||
+		    (table->nr_buckets & (table->nr_buckets - 1)) ||
+		    table->rows + (uint64_t)table->nr_rows * table->nr_cols * 4 > header->strings)
+			goto unmap;
+	}
+
+	/*
+	 * The DB was rebuilt or reloaded without running sm_mmap_db.  A reload
+	 * can finish in the same second and leave the size alone, so the times
+	 * are compared with their nanoseconds.
+	 */
+	if (header->db_ino != db_st.st_ino ||
+	    header->db_size != db_st.st_size ||
+	    header->db_mtime != db_st.st_mtim.tv_sec ||
+	    header->db_mtime_nsec != db_st.st_mtim.tv_nsec ||
+	    header->db_ctime != db_st.st_ctim.tv_sec ||
+	    header->db_ctime_nsec != db_st.st_ctim.tv_nsec)
+		goto unmap;
+
+	mmap_db = p;
+	goto close;
+
+unmap:
+	munmap(p, st.st_size);
+	header = NULL;
+close:
+	close(fd);
+}
+
+static char *get_string(uint32_t offset)
+{
+	if (offset == MMAP_DB_NULL)
+		return NULL;
+	return mmap_db + header->strings + offset;
+}
+
+static struct mmap_db_table *get_table(const char *name)
+{
+	struct mmap_db_table *table;
+	int i;
+
+	if (!mmap_db)
+		return NULL;
+
+	for (i = 0; i < header->nr_tables; i++) {
+		table = (struct mmap_db_table *)(mmap_db + header->tables[i]);
+		if (strcmp(table->name, name) == 0)
+			return table;
+	}
+	return NULL;
+}
+
+static struct mmap_db_bucket *find_bucket(struct mmap_db_table *table,
+					  const char *key, int is_static,
+					  int64_t file)
+{
+	struct mmap_db_bucket *buckets, *bucket;
+	uint64_t hash;
+	uint32_t mask, i;
+
+	buckets = (struct mmap_db_bucket *)(mmap_db + table->buckets);
+	hash = mmap_db_hash(key, is_static, file);
+	mask = table->nr_buckets - 1;
+
+	for (i = hash & mask; buckets[i].hash; i = (i + 1) & mask) {
+		bucket = &buckets[i];
+		if (bucket->hash == hash &&
+		    bucket->is_static == is_static &&
+		    bucket->file == file &&
+		    strcmp(get_string(bucket->key), key) == 0)
+			return bucket;
+	}
+	return NULL;
+}
+
+/* "cols" is a list of column names like "return_id, return, type" */
+static int get_col_idx(struct mmap_db_table *table, const char *cols,
+		       int *idx, int max)
+{
+	uint32_t *col_names = (uint32_t *)(mmap_db + table->col_names);
+	const char *p = cols;
+	int cnt = 0;
+	int len, i;
+
+	while (*p) {
+		while (*p == ' ')
+			p++;
+		len = strcspn(p, ", ");
+		if (len == 0 || cnt == max)
+			return -1;
+		for (i = 0; i < table->nr_cols; i++) {
+			const char *name = get_string(col_names[i]);
+
+			if (strncmp(name, p, len) == 0 && name[len] == '\0')
+				break;
+		}
+		if (i == table->nr_cols)
+			return -1;
+		idx[cnt++] = i;
+		p += len;
+		while (*p == ' ')
+			p++;
+		if (*p == ',')
+			p++;
+	}
+
+	return cnt;
+}
+
+static bool select_bucket(struct mmap_db_table *table, struct mmap_db_bucket *bucket,
+			  const char *cols, bool distinct,
+			  int (*callback)(void*, int, char**, char**), void *data)
+{
+	uint32_t *col_names = (uint32_t *)(mmap_db + table->col_names);
+	uint32_t *rows = (uint32_t *)(mmap_db + table->rows);
+	char *argv[32], *names[32];
+	uint32_t *seen = NULL;
+	int nr_seen = 0;
+	int idx[32];
+	uint32_t *row;
+	int argc, i, j;
+
+	argc = get_col_idx(table, cols, idx, ARRAY_SIZE(idx));
+	if (argc <= 0 || (distinct && argc != 1))
+		return false;
+	if (!bucket)
+		return true;
+
+	for (i = 0; i < argc; i++)
+		names[i] = get_string(col_names[idx[i]]);
+	if (distinct)
+		seen = malloc(bucket->nr_rows * sizeof(*seen));
+
+	for (j = 0; j < bucket->nr_rows; j++) {
+		row = &rows[(uint64_t)(bucket->first_row + j) * table->nr_cols];
+
+		/* the strings are de-duplicated so the offsets are unique */
+		if (distinct) {
+			for (i = 0; i < nr_seen; i++) {
+				if (seen[i] == row[idx[0]])
+					break;
+			}
+			if (i < nr_seen)
+				continue;
+			seen[nr_seen++] = row[idx[0]];
+		}
+
+		for (i = 0; i < argc; i++)
+			argv[i] = get_string(row[idx[i]]);
+		if (callback(data, argc, argv, names))
+			break;
+	}
+
+	free(seen);
+	return true;
+}
+
+/*
+ * These return false if the table isn't in the mmap file and the caller
+ * should use SQL instead.  The rows are the same as what you would get from
+ * "select <cols> from <table> where <key column> = key and static = is_static"
+ * with "file = file" as well for static functions.
+ */
+bool mmap_db_has_table(const char *table_name)
+{
+	return get_table(table_name);
+}
+
+bool mmap_db_select(const char *table_name, const char *cols, bool distinct,
+		    const char *key, int is_static, long long file,
+		    int (*callback)(void*, int, char**, char**), void *data)
+{
+	struct mmap_db_table *table;
+
+	if (option_debug || debug_db)
+		return false;
+	table = get_table(table_name);
+	if (!table)
+		return false;
+
+	return select_bucket(table, find_bucket(table, key, is_static, file),
+			     cols, distinct, callback, data);
+}
+
+bool mmap_db_count(const char *table_name, const char *key, int is_static,
+		   long long file, int *count)
+{
+	struct mmap_db_table *table;
+	struct mmap_db_bucket *bucket;
+
+	if (option_debug || debug_db)
+		return false;
+	table = get_table(table_name);
+	if (!table)
+		return false;
+
+	bucket = find_bucket(table, key, is_static, file);
+	*count = bucket ? bucket->nr_rows : 0;
+	return true;
+}
@@ -0,0 +1,86 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * The layout of the smatch_db.sqlite.mmap file written by sm_mmap_db.  It is
+ * a read only copy of the tables which smatch looks up by function name.
+ * The rows are grouped by (key, static, file) where file is zero for non
+ * static functions, which is exactly what get_static_filter() selects.
+ *
+ * Everything is in host byte order.  Offsets are from the start of the file
+ * except for the row values which are offsets into the string pool.
+ */
+
+#ifndef SMATCH_DB_MMAP_H
+#define SMATCH_DB_MMAP_H
+
+#include <stdint.h>
+
+#define MMAP_DB_MAGIC "SMDBMAP2"
+#define MMAP_DB_MAX_TABLES 8
+#define MMAP_DB_NULL 0xffffffffU
+
+struct mmap_db_header {
+	char magic[8];
+	uint32_t nr_tables;
+	uint32_t pad;
+	/* the stat() of the DB it was made from, to notice when it changes */
+	uint64_t db_ino;
+	int64_t db_size;
+	int64_t db_mtime;
+	int64_t db_mtime_nsec;
+	int64_t db_ctime;
+	int64_t db_ctime_nsec;
+	uint64_t strings;
+	uint64_t strings_size;
+	uint64_t tables[MMAP_DB_MAX_TABLES];
+};
+
+struct mmap_db_table {
+	char name[32];
+	uint32_t nr_cols;
+	uint32_t nr_rows;
+	uint32_t nr_buckets;
+	uint32_t pad;
+	uint64_t col_names;
+	uint64_t buckets;
+	uint64_t rows;
+};
+
+struct mmap_db_bucket {
+	uint64_t hash;
+	int64_t file;
+	uint32_t key;
+	uint32_t is_static;
+	uint32_t first_row;
+	uint32_t nr_rows;
+};
+
+static inline uint64_t mmap_db_hash(const char *key, int is_static, int64_t file)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	while (*key) {
+		hash ^= (unsigned char)*key++;
+		hash *= 1099511628211ULL;
+	}
+	hash ^= (uint64_t)file + is_static;
+	hash *= 1099511628211ULL;
+
+	/* zero marks an empty bucket */
+	return hash ? hash : 1;
+}
+
+#endif
@@ -0,0 +1,292 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * "smatch --db-prefetch" starts a thread with its own read only connection
+ * to smatch_db.sqlite.  When a file has been parsed, the names of the
+ * functions it calls are queued up in the order they are called and the
+ * thread reads their return_states, return_implies and call_implies rows.
+ * The rows are thrown away.  The point is that the DB pages have been read
+ * from the disk by the time the analysis gets to the call.  That matters
+ * when the DB isn't cached yet, for example the first run after rebuilding
+ * it or when it lives on slow storage.
+ *
+ * Tables which the mmap copy of the DB has are skipped, those don't go
+ * through SQL.
+ *
+ * Nothing else in Smatch is thread safe.  The thread only touches its own
+ * connection and the queue.  With --jobs the thread isn't started at all.
+ * The workers are forked while the thread would be busy in SQLite and a
+ * child which inherits one of SQLite's mutexes held hangs the first time
+ * it uses the DB.  The --batch children are forked while the thread is
+ * idle and they don't queue anything.
+ */
+
+#include <pthread.h>
+#include <sqlite3.h>
+#include <unistd.h>
+#include "smatch.h"
+#include "smatch_function_hashtable.h"
+
+struct prefetch_name {
+	char *name;
+	struct prefetch_name *next;
+};
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static struct prefetch_name *queue_head, *queue_tail;
+
+static const char *tables[] = { "return_states", "return_implies", "call_implies" };
+static struct sqlite3 *prefetch_db;
+static struct sqlite3_stmt *stmts[ARRAY_SIZE(tables)];
+static pid_t prefetch_pid;
+
+DEFINE_STRING_HASHTABLE_STATIC(queued_names);
+
+static void read_rows(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(stmts); i++) {
+		if (!stmts[i])
+			continue;
+		sqlite3_bind_text(stmts[i], 1, name, -1, SQLITE_STATIC);
+		while (sqlite3_step(stmts[i]) == SQLITE_ROW)
+			;
+		sqlite3_reset(stmts[i]);
+	}
+}
+
+static void *prefetch_thread(void *unused)
+{
+	struct prefetch_name *p;
+
+	while (1) {
+		pthread_mutex_lock(&queue_lock);
+		while (!queue_head)
+			pthread_cond_wait(&queue_cond, &queue_lock);
+		p = queue_head;
+		queue_head = p->next;
+		if (!queue_head)
+			queue_tail = NULL;
+		pthread_mutex_unlock(&queue_lock);
+
+		read_rows(p->name);
+		free(p->name);
+		free(p);
+	}
+	return NULL;
+}
+
+/* "name" and "flags" are what smatch_db.sqlite was opened with */
+void db_prefetch_open(const char *name, int flags)
+{
+	pthread_t thread;
+	char sql[128];
+	int i, rc;
+
+	if (!option_db_prefetch || option_jobs > 1)
+		return;
+
+	rc = sqlite3_open_v2(name, &prefetch_db, flags | SQLITE_OPEN_NOMUTEX, NULL);
+	if (rc != SQLITE_OK)
+		goto close;
+
+	for (i = 0; i < ARRAY_SIZE(tables); i++) {
+		if (mmap_db_has_table(tables[i]))
+			continue;
+		snprintf(sql, sizeof(sql), "select * from %s where function = ?1;", tables[i]);
+		if (sqlite3_prepare_v2(prefetch_db, sql, -1, &stmts[i], NULL) != SQLITE_OK)
+			stmts[i] = NULL;
+	}
+
+	queued_names = create_function_hashtable(4000);
+	prefetch_pid = getpid();
+	if (pthread_create(&thread, NULL, prefetch_thread, NULL) == 0) {
+		pthread_detach(thread);
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(stmts); i++) {
+		sqlite3_finalize(stmts[i]);
+		stmts[i] = NULL;
+	}
+	prefetch_pid = 0;
+close:
+	sqlite3_close(prefetch_db);
+	prefetch_db = NULL;
+}
+
+static void queue_name(const char *name)
+{
+	struct prefetch_name *p;
+
+	if (search_queued_names(queued_names, (char *)name))
+		return;
+	insert_queued_names(queued_names, alloc_string(name), INT_PTR(1));
+
+	p = malloc(sizeof(*p));
+	p->name = strdup(name);
+	p->next = NULL;
+
+	pthread_mutex_lock(&queue_lock);
+	if (queue_tail)
+		queue_tail->next = p;
+	else
+		queue_head = p;
+	queue_tail = p;
+	pthread_cond_signal(&queue_cond);
+	pthread_mutex_unlock(&queue_lock);
+}
+
+static void prefetch_stmt(struct statement *stmt);
+
+static void prefetch_expr(struct expression *expr)
+{
+	struct expression *tmp;
+	struct expression *fn;
+
+	if (!expr)
+		return;
+
+	switch (expr->type) {
+	case EXPR_CALL:
+		fn = strip_expr(expr->fn);
+		if (fn && fn->type == EXPR_SYMBOL && fn->symbol && fn->symbol->ident)
+			queue_name(fn->symbol->ident->name);
+		else
+			prefetch_expr(expr->fn);
+		FOR_EACH_PTR(expr->args, tmp) {
+			prefetch_expr(tmp);
+		} END_FOR_EACH_PTR(tmp);
+		break;
+	case EXPR_ASSIGNMENT:
+	case EXPR_BINOP:
+	case EXPR_COMPARE:
+	case EXPR_LOGICAL:
+	case EXPR_COMMA:
+		prefetch_expr(expr->left);
+		prefetch_expr(expr->right);
+		break;
+	case EXPR_PREOP:
+	case EXPR_POSTOP:
+		prefetch_expr(expr->unop);
+		break;
+	case EXPR_DEREF:
+		prefetch_expr(expr->deref);
+		break;
+	case EXPR_CAST:
+	case EXPR_FORCE_CAST:
+	case EXPR_IMPLIED_CAST:
+		prefetch_expr(expr->cast_expression);
+		break;
+	case EXPR_CONDITIONAL:
+	case EXPR_SELECT:
+		prefetch_expr(expr->conditional);
+		prefetch_expr(expr->cond_true);
+		prefetch_expr(expr->cond_false);
+		break;
+	case EXPR_STATEMENT:
+		prefetch_stmt(expr->statement);
+		break;
+	case EXPR_INITIALIZER:
+		FOR_EACH_PTR(expr->expr_list, tmp) {
+			prefetch_expr(tmp);
+		} END_FOR_EACH_PTR(tmp);
+		break;
+	case EXPR_POS:
+		prefetch_expr(expr->init_expr);
+		break;
+	case EXPR_IDENTIFIER:
+		prefetch_expr(expr->ident_expression);
+		break;
+	case EXPR_INDEX:
+		prefetch_expr(expr->idx_expression);
+		break;
+	default:
+		break;
+	}
+}
+
+static void prefetch_stmt(struct statement *stmt)
+{
+	struct statement *tmp;
+	struct symbol *sym;
+
+	if (!stmt)
+		return;
+
+	switch (stmt->type) {
+	case STMT_DECLARATION:
+		FOR_EACH_PTR(stmt->declaration, sym) {
+			prefetch_expr(sym->initializer);
+		} END_FOR_EACH_PTR(sym);
+		break;
+	case STMT_EXPRESSION:
+		prefetch_expr(stmt->expression);
+		break;
+	case STMT_RETURN:
+		prefetch_expr(stmt->ret_value);
+		break;
+	case STMT_COMPOUND:
+		FOR_EACH_PTR(stmt->stmts, tmp) {
+			prefetch_stmt(tmp);
+		} END_FOR_EACH_PTR(tmp);
+		break;
+	case STMT_IF:
+		prefetch_expr(stmt->if_conditional);
+		prefetch_stmt(stmt->if_true);
+		prefetch_stmt(stmt->if_false);
+		break;
+	case STMT_ITERATOR:
+		prefetch_stmt(stmt->iterator_pre_statement);
+		prefetch_expr(stmt->iterator_pre_condition);
+		prefetch_stmt(stmt->iterator_statement);
+		prefetch_stmt(stmt->iterator_post_statement);
+		prefetch_expr(stmt->iterator_post_condition);
+		break;
+	case STMT_SWITCH:
+		prefetch_expr(stmt->switch_expression);
+		prefetch_stmt(stmt->switch_statement);
+		break;
+	case STMT_CASE:
+		prefetch_stmt(stmt->case_statement);
+		break;
+	case STMT_LABEL:
+		prefetch_stmt(stmt->label_statement);
+		break;
+	case STMT_GOTO:
+		prefetch_expr(stmt->goto_expression);
+		break;
+	default:
+		break;
+	}
+}
+
+void db_prefetch_symbols(struct symbol_list *sym_list)
+{
+	struct symbol *sym, *base;
+
+	if (!prefetch_db || getpid() != prefetch_pid)
+		return;
+
+	FOR_EACH_PTR(sym_list, sym) {
+		base = get_base_type(sym);
+		if (!base || base->type != SYM_FN)
+			continue;
+		prefetch_stmt(base->stmt);
+	} END_FOR_EACH_PTR(sym);
+}
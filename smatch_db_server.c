@@ -0,0 +1,957 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * "smatch --db-serve=<addr>" holds smatch_db.sqlite open and answers queries
+ * from other smatch processes started with "--db-remote=<addr>".  That way a
+ * bunch of machines can share one DB instead of copying it around.  The
+ * address is the path of a Unix socket.  Other machines reach it through
+ * "ssh -L <local path>:<server path>".
+ *
+ * The protocol is one line per message.  Tabs, newlines and backslashes are
+ * escaped as \t, \n and \\ and a NULL value is \N.
+ *
+ *   client: Q <select statement>
+ *   server: C <col name>\t<col name>...
+ *           R <value>\t<value>...   (once per row)
+ *           E                       (or "X <error message>")
+ *
+ *   client: I <line of --info output>
+ *
+ * The DB is opened read only and only single SELECT statements are allowed.
+ * An authorizer turns down everything else, such as ATTACH and PRAGMA.
+ * The --info output from the clients is appended to <db file>.info and
+ * there is no reply.  That file is the same as what the clients would have
+ * printed with --sql-rows so it can be fed to create_db.sh or
+ * reload_partial.sh.  When the DB file is replaced the server starts using
+ * the new one, so the workers never need a copy of it.
+ *
+ * The socket is made 0600 and connections from other users are closed, so
+ * only the user who started the server can use it.  The lines in the .info
+ * file are loaded when the DB is rebuilt, so the server only keeps "I"
+ * lines which can't be anything but rows: --sql-rows records and inserts
+ * of plain values into tables which the DB has.  The rest are dropped.
+ *
+ * Nothing blocks on a client.  The replies are queued and written when the
+ * socket has room.  A client whose request line, reply or queue gets too
+ * big is stopped: the line is MAX_LINE, one reply is MAX_REPLY and we stop
+ * reading from a client when MAX_QUEUED bytes are waiting to go out.
+ *
+ * "smatch --db-capture=<file>" writes each different query and its reply to
+ * <file> in the same format.  "smatch --db-replay=<file>" answers queries
+ * from that file instead of smatch_db.sqlite.  That way a slow file can be
+ * sent to someone else along with just the rows it looked at.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "smatch.h"
+#include "smatch_function_hashtable.h"
+#include "smatch_sql_values.h"
+
+#define MAX_LINE (1 << 20)
+#define MAX_REPLY (64 << 20)
+#define MAX_QUEUED (16 << 20)
+
+struct strbuf {
+	char *buf;
+	size_t len, alloc;
+};
+
+static void strbuf_add(struct strbuf *sb, const char *str, size_t len)
+{
+	if (sb->len + len + 1 > sb->alloc) {
+		sb->alloc = (sb->len + len + 1) * 2;
+		sb->buf = realloc(sb->buf, sb->alloc);
+	}
+	memcpy(sb->buf + sb->len, str, len);
+	sb->len += len;
+	sb->buf[sb->len] = '\0';
+}
+
+static void strbuf_add_escaped(struct strbuf *sb, const char *str)
+{
+	const char *p;
+
+	if (!str) {
+		strbuf_add(sb, "\\N", 2);
+		return;
+	}
+
+	for (p = str; *p; p++) {
+		switch (*p) {
+		case '\t':
+			strbuf_add(sb, "\\t", 2);
+			break;
+		case '\n':
+			strbuf_add(sb, "\\n", 2);
+			break;
+		case '\\':
+			strbuf_add(sb, "\\\\", 2);
+			break;
+		default:
+			strbuf_add(sb, p, 1);
+		}
+	}
+}
+
+/*
+ * Splits "line" on tabs and unescapes it in place.  Returns the number of
+ * fields.
+ */
+static int split_fields(char *line, char **fields, int max)
+{
+	char *p = line, *out = line;
+	int cnt = 0;
+
+	if (max == 0)
+		return 0;
+	fields[cnt++] = out;
+	while (*p) {
+		if (*p == '\t') {
+			*out++ = '\0';
+			p++;
+			if (cnt == max)
+				break;
+			fields[cnt++] = out;
+			continue;
+		}
+		if (*p == '\\' && p[1]) {
+			p++;
+			switch (*p) {
+			case 't':
+				*out++ = '\t';
+				break;
+			case 'n':
+				*out++ = '\n';
+				break;
+			case 'N':
+				fields[cnt - 1] = NULL;
+				break;
+			default:
+				*out++ = *p;
+			}
+			p++;
+			continue;
+		}
+		*out++ = *p++;
+	}
+	*out = '\0';
+
+	return cnt;
+}
+
+static int open_socket(const char *addr, bool server)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX };
+	mode_t old_umask;
+	int fd, ret;
+
+	if (strlen(addr) >= sizeof(sun.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(sun.sun_path, addr);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	if (!server) {
+		if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) == 0)
+			return fd;
+		close(fd);
+		return -1;
+	}
+
+	unlink(addr);
+	old_umask = umask(077);
+	ret = bind(fd, (struct sockaddr *)&sun, sizeof(sun));
+	umask(old_umask);
+	if (ret == 0 && chmod(addr, 0600) == 0 && listen(fd, 64) == 0)
+		return fd;
+	close(fd);
+	return -1;
+}
+
+static bool write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, buf, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		buf += ret;
+		len -= ret;
+	}
+	return true;
+}
+
+/* The server side */
+
+struct client {
+	int fd;
+	struct strbuf in;
+	struct strbuf out;
+	size_t sent;
+};
+
+static struct sqlite3 *server_db;
+static struct sqlite3_stmt *table_stmt;
+static const char *server_db_file;
+static struct stat server_db_st;
+static time_t last_check;
+static FILE *info_file;
+static unsigned long dropped_info;
+static volatile sig_atomic_t stop_server;
+
+static void handle_stop(int sig)
+{
+	stop_server = 1;
+}
+
+/* the clients only ever need to read rows */
+static int server_authorizer(void *unused, int action, const char *arg1,
+			     const char *arg2, const char *db_name,
+			     const char *trigger)
+{
+	switch (action) {
+	case SQLITE_SELECT:
+	case SQLITE_READ:
+	case SQLITE_FUNCTION:
+	case SQLITE_RECURSIVE:
+		return SQLITE_OK;
+	}
+	return SQLITE_DENY;
+}
+
+static bool open_server_db(void)
+{
+	struct sqlite3_stmt *stmt;
+	struct stat st;
+	struct sqlite3 *db;
+
+	if (stat(server_db_file, &st) != 0)
+		return false;
+	if (sqlite3_open_v2(server_db_file, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+		sqlite3_close(db);
+		return false;
+	}
+	sqlite3_exec(db, "PRAGMA cache_size = 800000;", NULL, NULL, NULL);
+	if (sqlite3_prepare_v2(db, "select 1 from sqlite_master where type = 'table' and name = ?1;",
+			       -1, &stmt, NULL) != SQLITE_OK) {
+		sqlite3_close(db);
+		return false;
+	}
+	sqlite3_set_authorizer(db, server_authorizer, NULL);
+	if (server_db) {
+		sqlite3_finalize(table_stmt);
+		sqlite3_close(server_db);
+	}
+	server_db = db;
+	table_stmt = stmt;
+	server_db_st = st;
+	return true;
+}
+
+/* create_db.sh writes a new file and renames it over the old one */
+static void check_for_new_db(void)
+{
+	struct stat st;
+
+	if (time(NULL) == last_check)
+		return;
+	last_check = time(NULL);
+
+	if (stat(server_db_file, &st) != 0)
+		return;
+	if (st.st_ino == server_db_st.st_ino &&
+	    st.st_mtim.tv_sec == server_db_st.st_mtim.tv_sec &&
+	    st.st_mtim.tv_nsec == server_db_st.st_mtim.tv_nsec &&
+	    st.st_size == server_db_st.st_size)
+		return;
+	if (open_server_db())
+		fprintf(stderr, "smatch db server: reloaded %s\n", server_db_file);
+}
+
+static void reply_error(struct strbuf *out, const char *msg)
+{
+	strbuf_add(out, "X ", 2);
+	strbuf_add_escaped(out, msg);
+	strbuf_add(out, "\n", 1);
+}
+
+/* a reply which would go over "max" bytes is turned into an error */
+static void query_reply(struct sqlite3 *db, const char *sql, struct strbuf *out,
+			size_t max)
+{
+	struct sqlite3_stmt *stmt;
+	const char *tail;
+	size_t start = out->len;
+	int argc, i, rc;
+
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, &tail) != SQLITE_OK) {
+		reply_error(out, sqlite3_errmsg(db));
+		return;
+	}
+	if (!stmt || !sqlite3_stmt_readonly(stmt) || tail[strspn(tail, " ;")]) {
+		sqlite3_finalize(stmt);
+		reply_error(out, "only single read only statements are allowed");
+		return;
+	}
+
+	argc = sqlite3_column_count(stmt);
+	strbuf_add(out, "C ", 2);
+	for (i = 0; i < argc; i++) {
+		if (i)
+			strbuf_add(out, "\t", 1);
+		strbuf_add_escaped(out, sqlite3_column_name(stmt, i));
+	}
+	strbuf_add(out, "\n", 1);
+
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		strbuf_add(out, "R ", 2);
+		for (i = 0; i < argc; i++) {
+			if (i)
+				strbuf_add(out, "\t", 1);
+			strbuf_add_escaped(out, (const char *)sqlite3_column_text(stmt, i));
+		}
+		strbuf_add(out, "\n", 1);
+		if (out->len - start > max)
+			break;
+	}
+	if (out->len - start > max) {
+		out->len = start;
+		reply_error(out, "the reply is too big");
+	} else if (rc != SQLITE_DONE) {
+		reply_error(out, sqlite3_errmsg(db));
+	} else {
+		strbuf_add(out, "E\n", 2);
+	}
+	sqlite3_finalize(stmt);
+}
+
+static void server_query(const char *sql, struct strbuf *out)
+{
+	check_for_new_db();
+	query_reply(server_db, sql, out, MAX_REPLY);
+}
+
+static bool server_has_table(const char *table, int len)
+{
+	bool ret;
+
+	sqlite3_bind_text(table_stmt, 1, table, len, SQLITE_STATIC);
+	ret = sqlite3_step(table_stmt) == SQLITE_ROW;
+	sqlite3_reset(table_stmt);
+	return ret;
+}
+
+/* the same thing sm_fill_db sees: the SQL starts after the second ':' */
+static char *info_sql(char *line)
+{
+	char *p;
+
+	p = strchr(line, ':');
+	if (p)
+		p = strchr(p + 1, ':');
+	return p ? p + 1 : NULL;
+}
+
+static bool valid_info_insert(char *sql)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *table;
+	int len, ignore;
+	char *p;
+
+	p = strstr(sql, "%call_marker%");
+	if (p)
+		memmove(p, p + 13, strlen(p + 13) + 1);
+	p = strstr(sql, "%CALL_ID%");
+	if (p) {
+		memmove(p + 1, p + 9, strlen(p + 9) + 1);
+		*p = '0';
+	}
+	if (sql_split_insert(sql, &table, &len, &ignore, vals, SQL_MAX_VALUES) <= 0)
+		return false;
+	return server_has_table(table, len);
+}
+
+static bool valid_info_rows(char *rows, bool grouped)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *table;
+	int len, ignore, late, cnt, shared, ret;
+	char *next;
+
+	if (!grouped) {
+		cnt = sql_split_row(rows, &table, &len, &ignore, &late, vals,
+				    SQL_MAX_VALUES);
+		return cnt > 0 && server_has_table(table, len);
+	}
+	cnt = sql_split_rows(rows, &table, &len, &ignore, &late, vals,
+			     SQL_MAX_VALUES, &shared, &next);
+	if (cnt <= 0 || !server_has_table(table, len))
+		return false;
+	while ((ret = sql_next_row(&next, vals, shared, cnt)) > 0)
+		;
+	return ret == 0;
+}
+
+/*
+ * The loaders look for the first "() SQL" marker so a line with two of
+ * them is turned down.  The splitting is done on a copy.
+ */
+static bool valid_info_line(const char *line)
+{
+	char *copy, *p;
+	bool ret = false;
+
+	p = strstr(line, "() SQL");
+	if (!p || strstr(p + 1, "() SQL"))
+		return false;
+
+	copy = strdup(line);
+	p = copy + (p - line);
+	if (strncmp(p, "() SQL_row: ", 12) == 0)
+		ret = valid_info_rows(p + 12, false);
+	else if (strncmp(p, "() SQL_rows: ", 13) == 0)
+		ret = valid_info_rows(p + 13, true);
+	else if (strncmp(p, "() SQL: ", 8) == 0 ||
+		 strncmp(p, "() SQL_late: ", 13) == 0 ||
+		 strncmp(p, "() SQL_caller_info: ", 20) == 0)
+		ret = (p = info_sql(copy)) && valid_info_insert(p);
+	free(copy);
+	return ret;
+}
+
+static void server_info(const char *line)
+{
+	if (!valid_info_line(line)) {
+		dropped_info++;
+		return;
+	}
+	fprintf(info_file, "%s\n", line);
+}
+
+/* returns false if the client should be disconnected */
+static bool read_client(struct client *client)
+{
+	char buf[65536];
+	ssize_t ret;
+
+	ret = read(client->fd, buf, sizeof(buf));
+	if (ret < 0 && (errno == EINTR || errno == EAGAIN))
+		return true;
+	if (ret <= 0)
+		return false;
+	strbuf_add(&client->in, buf, ret);
+
+	if (client->in.len > MAX_LINE &&
+	    !memchr(client->in.buf, '\n', client->in.len)) {
+		fprintf(stderr, "smatch db server: request line too long\n");
+		return false;
+	}
+	return true;
+}
+
+static size_t queued(struct client *client)
+{
+	return client->out.len - client->sent;
+}
+
+/*
+ * Handles the complete lines which have come in.  Returns true if it
+ * stopped because too much output is queued and there are lines left.
+ */
+static bool run_client(struct client *client)
+{
+	char *line, *nl;
+	size_t used = 0;
+	bool more = false;
+
+	while ((nl = memchr(client->in.buf + used, '\n', client->in.len - used))) {
+		char *fields[1];
+
+		if (queued(client) >= MAX_QUEUED) {
+			more = true;
+			break;
+		}
+
+		*nl = '\0';
+		line = client->in.buf + used;
+		used = nl + 1 - client->in.buf;
+
+		if (strlen(line) < 2 || line[1] != ' ')
+			continue;
+		/* the statement is sent as a single escaped field */
+		split_fields(line + 2, fields, 1);
+
+		if (line[0] == 'Q')
+			server_query(fields[0], &client->out);
+		else if (line[0] == 'I' && fields[0])
+			server_info(fields[0]);
+	}
+
+	if (used) {
+		memmove(client->in.buf, client->in.buf + used, client->in.len - used);
+		client->in.len -= used;
+	}
+	return more;
+}
+
+/* writes what the socket takes, returns false if the client is gone */
+static bool flush_client(struct client *client)
+{
+	ssize_t ret;
+
+	while (queued(client)) {
+		ret = write(client->fd, client->out.buf + client->sent, queued(client));
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && errno == EAGAIN)
+			return true;
+		if (ret <= 0)
+			return false;
+		client->sent += ret;
+	}
+	client->out.len = 0;
+	client->sent = 0;
+	return true;
+}
+
+static void free_client(struct client *client)
+{
+	close(client->fd);
+	free(client->in.buf);
+	free(client->out.buf);
+}
+
+/* only the user who started the server gets in */
+static int accept_client(int listen_fd)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	int fd;
+
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+		return -1;
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 ||
+	    cred.uid != geteuid() ||
+	    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int db_serve(const char *db_file, const char *addr)
+{
+	struct pollfd *pfds = NULL;
+	struct client *clients = NULL;
+	int nr_clients = 0;
+	char name[PATH_MAX];
+	bool more = false;
+	int listen_fd;
+	int i, fd, ret;
+
+	server_db_file = db_file;
+	if (!open_server_db()) {
+		fprintf(stderr, "smatch db server: cannot open %s\n", db_file);
+		return 1;
+	}
+
+	snprintf(name, sizeof(name), "%s.info", db_file);
+	info_file = fopen(name, "a");
+	if (!info_file) {
+		fprintf(stderr, "smatch db server: cannot open %s\n", name);
+		return 1;
+	}
+
+	listen_fd = open_socket(addr, true);
+	if (listen_fd < 0) {
+		fprintf(stderr, "smatch db server: cannot listen on %s: %s\n",
+			addr, strerror(errno));
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGTERM, handle_stop);
+	signal(SIGINT, handle_stop);
+
+	while (1) {
+		pfds = realloc(pfds, (nr_clients + 1) * sizeof(*pfds));
+		pfds[0].fd = listen_fd;
+		pfds[0].events = POLLIN;
+		for (i = 0; i < nr_clients; i++) {
+			pfds[i + 1].fd = clients[i].fd;
+			pfds[i + 1].events = 0;
+			if (queued(&clients[i]) < MAX_QUEUED)
+				pfds[i + 1].events |= POLLIN;
+			if (queued(&clients[i]))
+				pfds[i + 1].events |= POLLOUT;
+		}
+
+		/*
+		 * When we're told to stop, finish reading what was sent first.
+		 * Lines which were held back because of a full queue are
+		 * handled without waiting.
+		 */
+		ret = poll(pfds, nr_clients + 1, stop_server || more ? 0 : 1000);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			break;
+		if (ret == 0 && !more) {
+			fflush(info_file);
+			if (stop_server)
+				break;
+			continue;
+		}
+
+		more = false;
+		for (i = nr_clients - 1; i >= 0; i--) {
+			if ((pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) &&
+			    !read_client(&clients[i]))
+				goto drop;
+			if (run_client(&clients[i]))
+				more = true;
+			if (flush_client(&clients[i]))
+				continue;
+drop:
+			free_client(&clients[i]);
+			clients[i] = clients[--nr_clients];
+			fflush(info_file);
+		}
+
+		if (pfds[0].revents & POLLIN) {
+			fd = accept_client(listen_fd);
+			if (fd < 0)
+				continue;
+			clients = realloc(clients, (nr_clients + 1) * sizeof(*clients));
+			clients[nr_clients] = (struct client){ .fd = fd };
+			nr_clients++;
+		}
+	}
+
+	if (dropped_info)
+		fprintf(stderr, "smatch db server: dropped %lu --info lines which weren't rows\n",
+			dropped_info);
+	fclose(info_file);
+	sqlite3_finalize(table_stmt);
+	sqlite3_close(server_db);
+	return stop_server ? 0 : 1;
+}
+
+/* The client side */
+
+static int remote_fd = -1;
+static FILE *remote_in;
+static FILE *remote_info;
+static struct strbuf remote_out;
+
+static void remote_send(char type, const char *sql)
+{
+	char prefix[2] = { type, ' ' };
+
+	strbuf_add(&remote_out, prefix, 2);
+	strbuf_add_escaped(&remote_out, sql);
+	strbuf_add(&remote_out, "\n", 1);
+}
+
+static void remote_flush(void)
+{
+	if (!remote_out.len)
+		return;
+	if (!write_all(remote_fd, remote_out.buf, remote_out.len)) {
+		sm_ierror("lost connection to DB server");
+		close(remote_fd);
+		remote_fd = -1;
+	}
+	remote_out.len = 0;
+}
+
+static void remote_exit(void)
+{
+	/* atexit() handlers run before stdio is flushed */
+	if (remote_info)
+		fflush(remote_info);
+	remote_flush();
+}
+
+bool db_remote_open(const char *addr)
+{
+	remote_fd = open_socket(addr, false);
+	if (remote_fd < 0) {
+		sm_ierror("cannot connect to DB server %s", addr);
+		return false;
+	}
+	remote_in = fdopen(dup(remote_fd), "r");
+	signal(SIGPIPE, SIG_IGN);
+	atexit(remote_exit);
+	return true;
+}
+
+/* --db-capture and --db-replay */
+static FILE *capture_file;
+static struct hashtable *replay_hash;
+static const char *replay_name;
+static unsigned long replay_misses;
+static DEFINE_HASHTABLE_INSERT(insert_reply, char, char);
+static DEFINE_HASHTABLE_SEARCH(search_reply, char, char);
+
+bool db_remote_connected(void)
+{
+	return remote_fd >= 0;
+}
+
+/* the smatch_db queries have to go through db_remote_exec() */
+bool db_remote_exec_needed(void)
+{
+	return remote_fd >= 0 || capture_file || replay_hash;
+}
+
+/* "reply" is a whole server reply and it's split up in place */
+static void reply_callbacks(const char *sql, char *reply,
+			    int (*callback)(void*, int, char**, char**), void *data)
+{
+	char *argv[32], *names[32];
+	char *line, *next;
+	int argc;
+
+	for (line = reply; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		if (line[0] == 'E')
+			return;
+		if (line[0] == 'X') {
+			if (!parse_error) {
+				sm_ierror("%s:%d SQL error #2: %s\n", get_filename(), get_lineno(), line + 2);
+				sm_ierror("%s:%d SQL: '%s'\n", get_filename(), get_lineno(), sql);
+				parse_error = 1;
+			}
+			return;
+		}
+		if (strlen(line) < 2)
+			continue;
+		if (line[0] == 'C') {
+			split_fields(line + 2, names, ARRAY_SIZE(names));
+		} else if (line[0] == 'R' && callback) {
+			argc = split_fields(line + 2, argv, ARRAY_SIZE(argv));
+			if (callback(data, argc, argv, names))
+				return;
+		}
+	}
+}
+
+static void capture_exec(const char *sql, int (*callback)(void*, int, char**, char**), void *data)
+{
+	static struct hashtable *seen;
+	struct strbuf reply = {};
+
+	query_reply(smatch_db, sql, &reply, SIZE_MAX);
+
+	if (!seen)
+		seen = create_function_hashtable(4096);
+	if (!search_reply(seen, (char *)sql)) {
+		struct strbuf out = {};
+
+		insert_reply(seen, strdup(sql), (char *)"");
+		strbuf_add(&out, "Q ", 2);
+		strbuf_add_escaped(&out, sql);
+		strbuf_add(&out, "\n", 1);
+		fputs(out.buf, capture_file);
+		fputs(reply.buf, capture_file);
+		free(out.buf);
+	}
+
+	reply_callbacks(sql, reply.buf, callback, data);
+	free(reply.buf);
+}
+
+static void replay_exec(const char *sql, int (*callback)(void*, int, char**, char**), void *data)
+{
+	char *reply;
+
+	reply = search_reply(replay_hash, (char *)sql);
+	if (!reply) {
+		replay_misses++;
+		return;
+	}
+	/* the callbacks can run the same query again */
+	reply = strdup(reply);
+	reply_callbacks(sql, reply, callback, data);
+	free(reply);
+}
+
+/*
+ * The callbacks can do their own queries so the whole reply is read before
+ * any of them are called.
+ */
+void db_remote_exec(const char *sql, int (*callback)(void*, int, char**, char**), void *data)
+{
+	struct strbuf reply = {};
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len = -1;
+
+	if (replay_hash) {
+		replay_exec(sql, callback, data);
+		return;
+	}
+	if (capture_file) {
+		capture_exec(sql, callback, data);
+		return;
+	}
+	if (remote_fd < 0)
+		return;
+
+	remote_send('Q', sql);
+	remote_flush();
+
+	while (remote_fd >= 0 && (len = getline(&line, &size, remote_in)) > 0) {
+		strbuf_add(&reply, line, len);
+		if (line[0] == 'E' || line[0] == 'X')
+			break;
+	}
+	if (remote_fd >= 0 && len <= 0) {
+		sm_ierror("lost connection to DB server");
+		close(remote_fd);
+		remote_fd = -1;
+	}
+	free(line);
+
+	reply_callbacks(sql, reply.buf, callback, data);
+	free(reply.buf);
+}
+
+static void capture_exit(void)
+{
+	fflush(capture_file);
+}
+
+bool db_capture_open(const char *file)
+{
+	capture_file = fopen(file, "w");
+	if (!capture_file) {
+		sm_ierror("cannot open %s: %s", file, strerror(errno));
+		return false;
+	}
+	atexit(capture_exit);
+	return true;
+}
+
+static void replay_exit(void)
+{
+	if (replay_misses)
+		fprintf(stderr, "smatch: %lu queries were not in %s\n",
+			replay_misses, replay_name);
+}
+
+bool db_replay_open(const char *file)
+{
+	struct strbuf reply = {};
+	char *line = NULL, *sql = NULL;
+	char *fields[1];
+	size_t size = 0;
+	ssize_t len;
+	FILE *in;
+
+	in = fopen(file, "r");
+	if (!in) {
+		sm_ierror("cannot open %s: %s", file, strerror(errno));
+		return false;
+	}
+
+	replay_hash = create_function_hashtable(4096);
+	while ((len = getline(&line, &size, in)) > 0) {
+		if (line[0] == 'Q' && len > 2) {
+			if (line[len - 1] == '\n')
+				line[--len] = '\0';
+			free(sql);
+			sql = strdup(line + 2);
+			/* the statement is a single escaped field */
+			split_fields(sql, fields, 1);
+			reply.len = 0;
+			continue;
+		}
+		strbuf_add(&reply, line, len);
+		if (sql && (line[0] == 'E' || line[0] == 'X')) {
+			if (!search_reply(replay_hash, sql))
+				insert_reply(replay_hash, strdup(sql),
+					     strdup(reply.buf));
+			free(sql);
+			sql = NULL;
+		}
+	}
+	free(sql);
+	free(line);
+	free(reply.buf);
+	fclose(in);
+
+	replay_name = file;
+	atexit(replay_exit);
+	return true;
+}
+
+static struct strbuf info_line;
+
+static ssize_t write_info(void *cookie, const char *buf, size_t size)
+{
+	const char *nl;
+	size_t len;
+	size_t left = size;
+
+	while (left && (nl = memchr(buf, '\n', left))) {
+		len = nl - buf;
+		strbuf_add(&info_line, buf, len);
+		remote_send('I', info_line.buf ? info_line.buf : "");
+		info_line.len = 0;
+		buf += len + 1;
+		left -= len + 1;
+	}
+	if (left)
+		strbuf_add(&info_line, buf, left);
+
+	if (remote_out.len > 65536)
+		remote_flush();
+	return size;
+}
+
+/*
+ * The --info output is sent to the server instead of stdout.  It's given to
+ * the server a line at a time so partial lines are held back.
+ */
+FILE *db_remote_info_file(void)
+{
+	static cookie_io_functions_t funcs = { .write = write_info };
+
+	remote_info = fopencookie(NULL, "w", funcs);
+	return remote_info;
+}
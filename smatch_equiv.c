@@ -25,6 +25,10 @@
  * When a variable gets modified all the old relationships are
  * deleted.  remove_equiv(expr);
  *
+ * All the variables which are equivalent point to the same related_list.
+ * The lists are never changed after they are set, a new list is built
+ * instead, so the estates can share them without cloning.
+ *
  */
 
 #include "smatch.h"
@@ -81,6 +85,10 @@ struct related_list *get_shared_relations(struct related_list *one,
 	struct relation *one_rel;
 	struct relation *two_rel;
 
+	/* everything in a set of equivalent variables shares the same list */
+	if (one == two)
+		return one;
+
 	PREPARE_PTR_LIST(one, one_rel);
 	PREPARE_PTR_LIST(two, two_rel);
 	for (;;) {
@@ -30,9 +30,162 @@
 #include "smatch_slist.h"
 #include "smatch_extra.h"
 
+static int rlists_equiv(struct related_list *one, struct related_list *two);
+
+/*
+ * The same merges happen over and over so merge_estates() hands out one
+ * smatch_state for each distinct result.  The table is cleared with the
+ * rest of the data_info allocations at the end of the function.
+ */
+static struct smatch_state **estate_table;
+static unsigned int estate_table_size;
+static unsigned int estate_table_used;
+
+static unsigned long hash_estate(struct smatch_state *state)
+{
+	struct data_info *dinfo = get_dinfo(state);
+	struct data_range *range;
+	unsigned long hash = 5381;
+
+	FOR_EACH_PTR(dinfo->value_ranges, range) {
+		hash = hash * 33 + range->min.uvalue;
+		hash = hash * 33 + range->max.uvalue;
+		hash = hash * 33 + (unsigned long)range->max.type;
+	} END_FOR_EACH_PTR(range);
+	hash = hash * 33 + ptr_list_size((struct ptr_list *)dinfo->related);
+	hash = hash * 33 + dinfo->fuzzy_max.uvalue;
+	hash = hash * 33 + (dinfo->hard_max | dinfo->capped << 1 |
+			    dinfo->treat_untagged << 2 | dinfo->assigned << 3 |
+			    dinfo->set << 4);
+	return hash;
+}
+
+static bool estates_identical(struct smatch_state *one, struct smatch_state *two)
+{
+	struct data_info *a = get_dinfo(one);
+	struct data_info *b = get_dinfo(two);
+	struct data_range *one_range, *two_range;
+
+	if (a->hard_max != b->hard_max || a->capped != b->capped ||
+	    a->treat_untagged != b->treat_untagged ||
+	    a->assigned != b->assigned || a->set != b->set)
+		return false;
+	if (!sval_identical(a->fuzzy_max, b->fuzzy_max))
+		return false;
+	if (!rlists_equiv(a->related, b->related))
+		return false;
+
+	PREPARE_PTR_LIST(a->value_ranges, one_range);
+	PREPARE_PTR_LIST(b->value_ranges, two_range);
+	for (;;) {
+		if (!one_range || !two_range)
+			break;
+		if (!sval_identical(one_range->min, two_range->min) ||
+		    !sval_identical(one_range->max, two_range->max))
+			break;
+		NEXT_PTR_LIST(one_range);
+		NEXT_PTR_LIST(two_range);
+	}
+	FINISH_PTR_LIST(two_range);
+	FINISH_PTR_LIST(one_range);
+
+	return !one_range && !two_range;
+}
+
+static void grow_estate_table(void)
+{
+	struct smatch_state **old = estate_table;
+	unsigned int old_size = estate_table_size;
+	unsigned int i, idx;
+
+	estate_table_size = old_size ? old_size * 2 : 1024;
+	estate_table = calloc(estate_table_size, sizeof(*estate_table));
+	for (i = 0; i < old_size; i++) {
+		if (!old[i])
+			continue;
+		idx = hash_estate(old[i]) & (estate_table_size - 1);
+		while (estate_table[idx])
+			idx = (idx + 1) & (estate_table_size - 1);
+		estate_table[idx] = old[i];
+	}
+	free(old);
+}
+
+/*
+ * "state" is on the stack.  Return the matching estate from the table or
+ * allocate a copy of it.
+ */
+static struct smatch_state *intern_estate(struct smatch_state *state)
+{
+	struct smatch_state *ret;
+	struct data_info *dinfo;
+	unsigned int idx;
+
+	if ((estate_table_used + 1) * 2 > estate_table_size)
+		grow_estate_table();
+
+	idx = hash_estate(state) & (estate_table_size - 1);
+	while ((ret = estate_table[idx])) {
+		if (estates_identical(ret, state))
+			return ret;
+		idx = (idx + 1) & (estate_table_size - 1);
+	}
+
+	dinfo = __alloc_data_info(0);
+	*dinfo = *get_dinfo(state);
+	ret = __alloc_smatch_state(0);
+	ret->name = dinfo->value_ranges ? show_rl(dinfo->value_ranges) : "empty";
+	ret->data = dinfo;
+
+	estate_table[idx] = ret;
+	estate_table_used++;
+	return ret;
+}
+
+/*
+ * The same pairs of estates are merged over and over.  The range lists in
+ * an estate are never modified so the unions can be remembered by pointer.
+ */
+#define UNION_CACHE_SIZE 4096
+static struct {
+	struct range_list *one, *two, *ret;
+} union_cache[UNION_CACHE_SIZE];
+static bool union_cache_used;
+
+static struct range_list *union_estate_rls(struct range_list *one, struct range_list *two)
+{
+	unsigned long hash;
+	int idx;
+
+	hash = (unsigned long)one * 31 + (unsigned long)two;
+	idx = (hash >> 6) % UNION_CACHE_SIZE;
+	if (union_cache[idx].one == one && union_cache[idx].two == two)
+		return union_cache[idx].ret;
+
+	union_cache[idx].one = one;
+	union_cache[idx].two = two;
+	union_cache[idx].ret = rl_union(one, two);
+	union_cache_used = true;
+	return union_cache[idx].ret;
+}
+
+void clear_estate_table(void)
+{
+	if (union_cache_used) {
+		memset(union_cache, 0, sizeof(union_cache));
+		union_cache_used = false;
+	}
+	if (!estate_table_used)
+		return;
+	memset(estate_table, 0, estate_table_size * sizeof(*estate_table));
+	estate_table_used = 0;
+}
+
 struct smatch_state *merge_estates(struct smatch_state *s1, struct smatch_state *s2)
 {
-	struct smatch_state *tmp;
+	struct data_info dinfo = {};
+	struct smatch_state state = { .data = &dinfo };
+	struct smatch_state *tmp = &state;
 	struct range_list *value_ranges;
 	struct related_list *rlist;
 	bool capped = false;
@@ -40,8 +193,8 @@ struct smatch_state *merge_estates(struct smatch_state *s1, struct smatch_state
 	if (estates_equiv(s1, s2))
 		return s1;
 
-	value_ranges = rl_union(estate_rl(s1), estate_rl(s2));
-	tmp = alloc_estate_rl(value_ranges);
+	value_ranges = union_estate_rls(estate_rl(s1), estate_rl(s2));
+	dinfo.value_ranges = value_ranges;
 	rlist = get_shared_relations(estate_related(s1), estate_related(s2));
 	set_related(tmp, rlist);
 
@@ -71,7 +224,7 @@ struct smatch_state *merge_estates(struct smatch_state *s1, struct smatch_state
 	if (estate_new(s1) || estate_new(s2))
 		estate_set_new(tmp);
 
-	return tmp;
+	return intern_estate(tmp);
 }
 
 struct data_info *get_dinfo(struct smatch_state *state)
@@ -242,6 +395,9 @@ static int rlists_equiv(struct related_list *one, struct related_list *two)
 	struct relation *one_rel;
 	struct relation *two_rel;
 
+	if (one == two)
+		return 1;
+
 	PREPARE_PTR_LIST(one, one_rel);
 	PREPARE_PTR_LIST(two, two_rel);
 	for (;;) {
@@ -350,7 +506,7 @@ static struct data_info *clone_dinfo(struct data_info *dinfo)
 	struct data_info *ret;
 
 	ret = alloc_dinfo();
-	ret->related = clone_related_list(dinfo->related);
+	ret->related = dinfo->related;
 	ret->value_ranges = clone_rl(dinfo->value_ranges);
 	ret->hard_max = dinfo->hard_max;
 	ret->fuzzy_max = dinfo->fuzzy_max;
@@ -380,7 +536,7 @@ struct smatch_state *clone_partial_estate(struct smatch_state *state, struct ran
 	rl = cast_rl(estate_type(state), rl);
 
 	ret = alloc_estate_rl(rl);
-	set_related(ret, clone_related_list(estate_related(state)));
+	set_related(ret, estate_related(state));
 	if (estate_has_hard_max(state))
 		estate_set_hard_max(ret);
 	if (estate_has_fuzzy_max(state))
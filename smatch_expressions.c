@@ -538,62 +538,6 @@ void expr_set_parent_stmt(struct expression *expr, struct statement *parent)
 	expr->parent = (unsigned long)parent;
 }
 
-struct expression *expr_get_parent_expr(struct expression *expr)
-{
-	struct expression *parent;
-
-	if (!expr)
-		return NULL;
-	if (!(expr->parent & 0x1UL))
-		return NULL;
-
-	parent = (struct expression *)(expr->parent & ~0x1UL);
-	if (parent && (parent->smatch_flags & Fake))
-		return expr_get_parent_expr(parent);
-	return parent;
-}
-
-struct expression *expr_get_fake_parent_expr(struct expression *expr)
-{
-	struct expression *parent;
-
-	if (!expr)
-		return NULL;
-	if (!(expr->parent & 0x1UL))
-		return NULL;
-
-	parent = (struct expression *)(expr->parent & ~0x1UL);
-	if (parent && (parent->smatch_flags & Fake))
-		return parent;
-	return NULL;
-}
-
-struct expression *expr_get_fake_or_real_parent_expr(struct expression *expr)
-{
-	struct expression *parent;
-
-	parent = expr_get_fake_parent_expr(expr);
-	if (parent)
-		return parent;
-	return expr_get_parent_expr(expr);
-
-}
-
-struct statement *expr_get_parent_stmt(struct expression *expr)
-{
-	struct expression *parent;
-
-	if (!expr)
-		return NULL;
-	if (expr->parent & 0x1UL) {
-		parent = (struct expression *)(expr->parent & ~0x1UL);
-		if (parent->smatch_flags & Fake)
-			return expr_get_parent_stmt(parent);
-		return NULL;
-	}
-	return (struct statement *)expr->parent;
-}
-
 struct statement *get_parent_stmt(struct expression *expr)
 {
 	struct expression *tmp;
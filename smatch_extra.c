@@ -1417,8 +1417,6 @@ static void check_dereference(struct expression *expr)
 
 static void match_dereferences(struct expression *expr)
 {
-	if (expr->type != EXPR_PREOP)
-		return;
 	if (getting_address(expr))
 		return;
 	/* it's saying that foo[1] = bar dereferences foo[1] */
@@ -3196,7 +3194,7 @@ void register_smatch_extra_late(int id)
 {
 	add_merge_hook(link_id, &merge_link_states);
 	add_modification_hook(link_id, &match_link_modify);
-	add_hook(&match_dereferences, DEREF_HOOK);
+	add_expr_type_hook(&match_dereferences, DEREF_HOOK, EXPR_TYPE_BIT(EXPR_PREOP));
 	add_hook(&match_pointer_as_array, OP_HOOK);
 	select_return_implies_hook_early(DEREFERENCE, &set_param_dereferenced);
 	add_hook(&match_function_call, FUNCTION_CALL_HOOK);
@@ -98,6 +98,7 @@ struct symbol *rl_type(struct range_list *rl);
 struct range_list *rl_filter(struct range_list *rl, struct range_list *filter);
 struct range_list *rl_intersection(struct range_list *one, struct range_list *two);
 struct range_list *rl_union(struct range_list *one, struct range_list *two);
+struct range_list *rl_union_stack(struct range_list_stack *stack);
 struct range_list *rl_binop(struct range_list *left, int op, struct range_list *right);
 
 void push_rl(struct range_list_stack **rl_stack, struct range_list *rl);
@@ -171,6 +172,7 @@ struct smatch_state *get_implied_estate(struct expression *expr);
 struct smatch_state *estate_filter_sval(struct smatch_state *orig, sval_t filter);
 struct data_info *clone_dinfo_perm(struct data_info *dinfo);
 struct smatch_state *clone_estate_perm(struct smatch_state *state);
+void clear_estate_table(void);
 
 /* smatch_extra.c */
 bool is_impossible_variable(struct expression *expr);
@@ -245,12 +247,61 @@ struct expression *fake_variable_perm(struct symbol *type, const char *name);
 void free_tmp_expressions(void);
 void expr_set_parent_expr(struct expression *expr, struct expression *parent);
 void expr_set_parent_stmt(struct expression *expr, struct statement *parent);
-struct expression *expr_get_parent_expr(struct expression *expr);
-struct expression *expr_get_fake_parent_expr(struct expression *expr);
-struct expression *expr_get_fake_or_real_parent_expr(struct expression *expr);
-struct statement *expr_get_parent_stmt(struct expression *expr);
 struct statement *get_parent_stmt(struct expression *expr);
 
+/*
+ * expr->parent is the parent expression with the low bit set or the parent
+ * statement.  The checks walk up several levels for each expression so the
+ * walkers are inline.  Fake parents are skipped unless you ask for them.
+ */
+static inline struct expression *expr_get_parent_expr(struct expression *expr)
+{
+	struct expression *parent;
+
+	while (expr && (expr->parent & 0x1UL)) {
+		parent = (struct expression *)(expr->parent & ~0x1UL);
+		if (!parent || !(parent->smatch_flags & Fake))
+			return parent;
+		expr = parent;
+	}
+	return NULL;
+}
+
+static inline struct expression *expr_get_fake_parent_expr(struct expression *expr)
+{
+	struct expression *parent;
+
+	if (!expr || !(expr->parent & 0x1UL))
+		return NULL;
+
+	parent = (struct expression *)(expr->parent & ~0x1UL);
+	if (parent && (parent->smatch_flags & Fake))
+		return parent;
+	return NULL;
+}
+
+static inline struct expression *expr_get_fake_or_real_parent_expr(struct expression *expr)
+{
+	struct expression *parent;
+
+	parent = expr_get_fake_parent_expr(expr);
+	if (parent)
+		return parent;
+	return expr_get_parent_expr(expr);
+}
+
+static inline struct statement *expr_get_parent_stmt(struct expression *expr)
+{
+	while (expr && (expr->parent & 0x1UL)) {
+		expr = (struct expression *)(expr->parent & ~0x1UL);
+		if (!(expr->smatch_flags & Fake))
+			return NULL;
+	}
+	if (!expr)
+		return NULL;
+	return (struct statement *)expr->parent;
+}
+
 /* smatch_param_limit.c */
 struct smatch_state *get_orig_estate(const char *name, struct symbol *sym);
 
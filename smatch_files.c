@@ -16,23 +16,61 @@
  */
 
 #include <string.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "parse.h"
 #include "smatch.h"
 
+/*
+ * With --data-cache=<dir> the token stream for each smatch_data/ file is
+ * saved in <dir> the first time it is read.  After that it is mmapped and
+ * turned back into tokens without going through the tokenizer.  The cache
+ * is thrown away if the data file's size, inode, mtime or ctime change.  The
+ * times include the nanoseconds, so an edit in the same second is noticed.
+ *
+ * Only identifiers, numbers, strings and specials are cached.  A file with
+ * anything else in it just isn't cached.
+ */
+#define TOKEN_CACHE_MAGIC "SMTOKC02"
+
+struct token_cache_header {
+	char magic[8];
+	uint64_t dev;
+	uint64_t ino;
+	int64_t size;
+	int64_t mtime;
+	int64_t mtime_nsec;
+	int64_t ctime;
+	int64_t ctime_nsec;
+	uint32_t nr_tokens;
+	uint32_t pad;
+};
+
+struct token_cache_rec {
+	struct position pos;
+	uint32_t len;
+	uint32_t val;
+	char data[];
+};
+
+char *option_data_cache;
+
 int open_data_file(const char *filename)
 {
 	char buf[256];
 	int fd;
 
 	fd = open(filename, O_RDONLY);
+	if (fd < 0 && data_dir) {
+		snprintf(buf, 256, "%s/%s", data_dir, filename);
+		fd = open(buf, O_RDONLY);
+	}
 	if (fd >= 0)
-		return fd;
-	if (!data_dir)
-		return -1;
-	snprintf(buf, 256, "%s/%s", data_dir, filename);
-	return open(buf, O_RDONLY);
+		result_cache_hash_data_file(fd);
+	return fd;
 }
 
 int open_schema_file(const char *schema)
@@ -47,8 +85,185 @@ int open_schema_file(const char *schema)
 	return open(buf, O_RDONLY);
 }
 
+static void get_token_cache_name(const char *filename, char *buf, int size)
+{
+	snprintf(buf, size, "%s/%s.tokens", option_data_cache, filename);
+}
+
+static bool token_cache_matches(struct token_cache_header *hdr, struct stat *st)
+{
+	return memcmp(hdr->magic, TOKEN_CACHE_MAGIC, 8) == 0 &&
+	       hdr->dev == st->st_dev && hdr->ino == st->st_ino &&
+	       hdr->size == st->st_size &&
+	       hdr->mtime == st->st_mtim.tv_sec &&
+	       hdr->mtime_nsec == st->st_mtim.tv_nsec &&
+	       hdr->ctime == st->st_ctim.tv_sec &&
+	       hdr->ctime_nsec == st->st_ctim.tv_nsec;
+}
+
+static int rec_size(int len)
+{
+	return (sizeof(struct token_cache_rec) + len + 8) & ~7;
+}
+
+static struct token *load_token_cache(const char *filename, struct stat *st)
+{
+	struct token_cache_header *hdr;
+	struct token_cache_rec *rec;
+	struct token *begin, *token, **next;
+	struct string *string;
+	struct stat cache_st;
+	char buf[PATH_MAX];
+	char *p, *end;
+	void *map;
+	int stream;
+	int fd, i;
+
+	get_token_cache_name(filename, buf, sizeof(buf));
+	fd = open(buf, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &cache_st) || cache_st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+	hdr = map;
+	if (!token_cache_matches(hdr, st)) {
+		munmap(map, cache_st.st_size);
+		return NULL;
+	}
+
+	/*
+	 * The numbers point straight into the mapping so it is never
+	 * unmapped.
+	 */
+	stream = init_stream(NULL, filename, -1, NULL);
+	begin = __alloc_token(0);
+	token_type(begin) = TOKEN_STREAMBEGIN;
+	begin->pos.stream = stream;
+	begin->pos.line = 1;
+	begin->pos.newline = 1;
+	next = &begin->next;
+
+	p = (char *)(hdr + 1);
+	end = (char *)map + cache_st.st_size;
+	for (i = 0; i < hdr->nr_tokens; i++) {
+		rec = (struct token_cache_rec *)p;
+		if (p + sizeof(*rec) > end || p + rec_size(rec->len) > end)
+			sm_fatal("corrupt token cache '%s'", buf);
+		token = __alloc_token(0);
+		token->pos = rec->pos;
+		token->pos.stream = stream;
+		switch (token_type(token)) {
+		case TOKEN_IDENT:
+			token->ident = built_in_ident(rec->data);
+			break;
+		case TOKEN_NUMBER:
+			token->number = rec->data;
+			break;
+		case TOKEN_STRING:
+			string = __alloc_string(rec->len + 1);
+			memcpy(string->data, rec->data, rec->len + 1);
+			string->length = rec->len + 1;
+			token->string = string;
+			break;
+		case TOKEN_SPECIAL:
+			token->special = rec->val;
+			break;
+		case TOKEN_STREAMEND:
+			token->next = &eof_token_entry;
+			break;
+		}
+		*next = token;
+		next = &token->next;
+		p += rec_size(rec->len);
+	}
+	if (token_type(containing_token(next)) != TOKEN_STREAMEND)
+		sm_fatal("corrupt token cache '%s'", buf);
+
+	return begin;
+}
+
+static void save_token_cache(const char *filename, struct stat *st, struct token *begin)
+{
+	struct token_cache_header hdr = {};
+	struct token_cache_rec *rec;
+	struct token *token;
+	char buf[PATH_MAX];
+	char tmp[PATH_MAX + 16];
+	char recbuf[sizeof(*rec) + MAX_STRING + 8];
+	const char *str;
+	FILE *f;
+
+	rec = (struct token_cache_rec *)recbuf;
+
+	get_token_cache_name(filename, buf, sizeof(buf));
+	snprintf(tmp, sizeof(tmp), "%s.%d", buf, getpid());
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+
+	memcpy(hdr.magic, TOKEN_CACHE_MAGIC, 8);
+	hdr.dev = st->st_dev;
+	hdr.ino = st->st_ino;
+	hdr.size = st->st_size;
+	hdr.mtime = st->st_mtim.tv_sec;
+	hdr.mtime_nsec = st->st_mtim.tv_nsec;
+	hdr.ctime = st->st_ctim.tv_sec;
+	hdr.ctime_nsec = st->st_ctim.tv_nsec;
+	fwrite(&hdr, sizeof(hdr), 1, f);
+
+	for (token = begin->next; ; token = token->next) {
+		memset(recbuf, 0, sizeof(*rec));
+		rec->pos = token->pos;
+		str = "";
+		switch (token_type(token)) {
+		case TOKEN_IDENT:
+			str = show_ident(token->ident);
+			break;
+		case TOKEN_NUMBER:
+			str = token->number;
+			break;
+		case TOKEN_STRING:
+			str = token->string->data;
+			break;
+		case TOKEN_SPECIAL:
+			rec->val = token->special;
+			break;
+		case TOKEN_STREAMEND:
+			break;
+		default:
+			goto fail;
+		}
+		rec->len = strlen(str);
+		if (rec->len > MAX_STRING)
+			goto fail;
+		memset(rec->data, 0, rec_size(rec->len) - sizeof(*rec));
+		memcpy(rec->data, str, rec->len);
+		fwrite(recbuf, rec_size(rec->len), 1, f);
+		hdr.nr_tokens++;
+		if (token_type(token) == TOKEN_STREAMEND)
+			break;
+	}
+
+	rewind(f);
+	fwrite(&hdr, sizeof(hdr), 1, f);
+	if (fclose(f) == 0 && rename(tmp, buf) == 0)
+		return;
+	unlink(tmp);
+	return;
+fail:
+	fclose(f);
+	unlink(tmp);
+}
+
 struct token *get_tokens_file(const char *filename)
 {
+	struct stat st;
 	int fd;
 	struct token *token;
 
@@ -57,7 +272,16 @@ struct token *get_tokens_file(const char *filename)
 	fd = open_data_file(filename);
 	if (fd < 0)
 		return NULL;
+	if (option_data_cache && fstat(fd, &st) == 0) {
+		token = load_token_cache(filename, &st);
+		if (token) {
+			close(fd);
+			return token;
+		}
+	}
 	token = tokenize(NULL, filename, fd, NULL, NULL);
+	if (option_data_cache && token)
+		save_token_cache(filename, &st, token);
 	close(fd);
 	return token;
 }
@@ -17,13 +17,18 @@
 
 #define _GNU_SOURCE 1
 #include <unistd.h>
+#include <fcntl.h>
+#include <zlib.h>
 #include <stdio.h>
+#include <time.h>
+#include <sys/wait.h>
 #include "token.h"
 #include "scope.h"
 #include "smatch.h"
 #include "smatch_expression_stacks.h"
 #include "smatch_extra.h"
 #include "smatch_slist.h"
+#include "cwchash/hashtable.h"
 
 int __in_fake_assign;
 int __in_fake_struct_assign;
@@ -67,8 +72,13 @@ static struct expression_list *parsed_calls;
 static int indent_cnt;
 int __in_pre_condition = 0;
 int __bail_on_rest_of_function = 0;
+int __degraded_pass;
 static struct timeval fn_start_time;
+static unsigned long nr_statements;
+static unsigned long nr_inlines;
 static struct timeval outer_fn_start_time;
+static struct timeval smatch_start_time;
+static int fn_budget_ms;
 char *get_function(void) { return cur_func; }
 int get_lineno(void) { return __smatch_lineno; }
 int inside_loop(void) { return !!loop_count; }
@@ -246,27 +256,63 @@ static int is_noreturn_func(struct expression *expr)
 	return 0;
 }
 
-static int save_func_time(void *_rl, int argc, char **argv, char **azColName)
+/* returns how many milliseconds the function took last time */
+static int get_func_time(struct symbol *sym)
 {
-	unsigned long *rl = _rl;
-
-	*rl = strtoul(argv[0], NULL, 10);
-	return 0;
+	return get_fn_traits(sym)->time;
 }
 
-static int get_func_time(struct symbol *sym)
+static int inline_budget = 20;
+
+/*
+ * With --function=<name> there is no point parsing the bodies of the other
+ * functions, unless they are small enough that inlinable() might want them.
+ * The same goes for the skipped_functions.  To decide that without parsing,
+ * walk the top level of the body and find where the last statement starts.
+ * Statements start after a ';', or after a '}' which closes a block, except
+ * for "else" and the "while" of a do while loop.
+ */
+static int skip_body(struct symbol *decl, struct token *lbrace, struct token *rbrace)
 {
-	unsigned long time = 0;
+	struct token *token, *last = NULL;
+	bool stmt_start = true;
+	int braces = 0, parens = 0;
+
+	if (!decl->ident || (decl->ctype.modifiers & MOD_INLINE))
+		return 0;
+	if (option_process_function) {
+		if (strcmp(decl->ident->name, option_process_function) == 0)
+			return 0;
+	} else if (!is_skipped_function_name(decl->ident->name)) {
+		return 0;
+	}
 
-	run_sql(&save_func_time, &time,
-		"select key from return_implies where %s and type = %d;",
-		get_static_filter(sym), FUNC_TIME);
+	for (token = lbrace->next; token != rbrace; token = token->next) {
+		if (stmt_start && braces == 0 && parens == 0 &&
+		    !match_op(token, ';') &&
+		    !(token_type(token) == TOKEN_IDENT &&
+		      (token->ident == &else_ident || token->ident == &while_ident)))
+			last = token;
+		stmt_start = false;
+		if (match_op(token, '(')) {
+			parens++;
+		} else if (match_op(token, ')')) {
+			parens--;
+		} else if (match_op(token, '{')) {
+			braces++;
+		} else if (match_op(token, '}')) {
+			if (--braces == 0 && parens == 0)
+				stmt_start = true;
+		} else if (match_op(token, ';') && braces == 0 && parens == 0) {
+			stmt_start = true;
+		}
+	}
 
-	return time;
+	if (!last)
+		return 0;
+	return last->pos.line > decl->pos.line + inline_budget;
 }
 
-static int inline_budget = 20;
-
 int inlinable(struct expression *expr)
 {
 	struct symbol *sym;
@@ -274,6 +320,8 @@ int inlinable(struct expression *expr)
 
 	if (__inline_fn)  /* don't nest */
 		return 0;
+	if (option_fast)
+		return 0;
 
 	if (expr->type != EXPR_SYMBOL || !expr->symbol)
 		return 0;
@@ -302,7 +350,7 @@ int inlinable(struct expression *expr)
 	if (last_stmt->pos.line > sym->pos.line + inline_budget)
 		return 0;
 
-	if (get_func_time(expr->symbol) >= 2)
+	if (get_func_time(expr->symbol) >= 2000)
 		return 0;
 
 	return 1;
@@ -1245,6 +1293,7 @@ out:
 
 static void split_case(struct statement *stmt)
 {
+	struct range_list_stack *labels = NULL;
 	struct range_list *rl = NULL;
 
 	expr_set_parent_stmt(stmt->case_expression, stmt);
@@ -1252,6 +1301,8 @@ static void split_case(struct statement *stmt)
 
 	rl = get_case_rl(top_expression(switch_expr_stack),
 			 stmt->case_expression, stmt->case_to);
+	if (rl)
+		push_rl(&labels, rl);
 	while (stmt->case_statement->type == STMT_CASE) {
 		struct range_list *tmp;
 
@@ -1260,12 +1311,14 @@ static void split_case(struct statement *stmt)
 				  stmt->case_statement->case_to);
 		if (!tmp)
 			goto next;
-		rl = rl_union(rl, tmp);
+		push_rl(&labels, tmp);
 		if (!stmt->case_expression)
 			__set_default();
 next:
 		stmt = stmt->case_statement;
 	}
+	rl = rl_union_stack(labels);
+	__free_ptr_list((struct ptr_list **)&labels);
 
 	__merge_switches(top_expression(switch_expr_stack), rl);
 
@@ -1276,14 +1329,48 @@ next:
 	__split_stmt(stmt->case_statement);
 }
 
+/* returns milliseconds */
 int time_parsing_function(void)
 {
-	return ms_since(&fn_start_time) / 1000;
+	return ms_since(&fn_start_time);
+}
+
+/*
+ * Each function gets --func-budget seconds.  With --file-budget the functions
+ * share a total as well so once most of it is spent the rest of the functions
+ * only get what's left.  They always get at least a second.
+ */
+#define MIN_FUNC_BUDGET_MS 1000
+
+static void set_func_budget(void)
+{
+	long long left;
+
+	fn_budget_ms = option_func_budget * 1000;
+	if (!option_file_budget)
+		return;
+
+	left = option_file_budget * 1000LL - ms_since(&smatch_start_time);
+	if (left < MIN_FUNC_BUDGET_MS)
+		left = MIN_FUNC_BUDGET_MS;
+	if (left < fn_budget_ms)
+		fn_budget_ms = left;
+}
+
+int func_budget_ms(void)
+{
+	return fn_budget_ms;
+}
+
+/* for __smatch_over_budget() in the tests */
+void __use_up_func_budget(void)
+{
+	fn_budget_ms = -1;
 }
 
 bool taking_too_long(void)
 {
-	if ((ms_since(&outer_fn_start_time) / 1000) > 60 * 5) /* five minutes */
+	if (ms_since(&outer_fn_start_time) > fn_budget_ms)
 		return 1;
 	return 0;
 }
@@ -1541,11 +1628,9 @@ static void free_parsed_call_stuff(bool free_fake_states)
 void __split_stmt(struct statement *stmt)
 {
 	sval_t sval;
-	struct timeval start, stop;
+	struct timeval start;
 	bool skip_after = false;
 
-	gettimeofday(&start, NULL);
-
 	if (!stmt)
 		goto out;
 
@@ -1555,6 +1640,8 @@ void __split_stmt(struct statement *stmt)
 	if (__bail_on_rest_of_function || is_skipped_function())
 		return;
 
+	nr_statements++;
+
 	if (out_of_memory() || taking_too_long()) {
 		gettimeofday(&start, NULL);
 
@@ -1567,6 +1654,8 @@ void __split_stmt(struct statement *stmt)
 		return;
 	}
 
+	if (option_time_stmt)
+		stmt_profile_start(stmt);
 	indent_cnt++;
 
 	add_ptr_list(&big_statement_stack, stmt);
@@ -1693,11 +1782,8 @@ void __split_stmt(struct statement *stmt)
 out:
 	__process_post_op_stack();
 
-	gettimeofday(&stop, NULL);
 	if (option_time_stmt && stmt)
-		sm_msg("stmt_time%s: %ld",
-		       stmt->type == STMT_COMPOUND ? "_block" : "",
-		       stop.tv_sec - start.tv_sec);
+		stmt_profile_stop();
 }
 
 static void split_expr_list(struct expression_list *expr_list, struct expression *parent)
@@ -1751,6 +1837,86 @@ static bool cast_arg(struct symbol *type, struct expression *arg)
 	return true;
 }
 
+/*
+ * The fake parameter and return assignments are allocated with the _perm
+ * allocators.  The same ones get created again for the --two-passes pass,
+ * for every inline re-parse and whenever a loop is parsed twice, so save
+ * them for each (call, expr, nr) and reuse them.  The cache is cleared
+ * for each file.
+ */
+struct fake_assign_key {
+	struct expression *call;
+	struct expression *expr;
+	int nr;
+};
+
+struct fake_assign_entry {
+	struct symbol *type;
+	struct expression *assign;
+};
+
+static struct hashtable *fake_assign_cache;
+
+static unsigned int fake_assign_hash(void *_key)
+{
+	struct fake_assign_key *key = _key;
+	unsigned long hash;
+
+	hash = ((unsigned long)key->call >> 4) * 31 + ((unsigned long)key->expr >> 4);
+	return hash * 31 + key->nr;
+}
+
+static int fake_assign_equal(void *_one, void *_two)
+{
+	struct fake_assign_key *one = _one, *two = _two;
+
+	return one->call == two->call && one->expr == two->expr && one->nr == two->nr;
+}
+
+static void clear_fake_assign_cache(void)
+{
+	if (!fake_assign_cache)
+		return;
+	hashtable_destroy(fake_assign_cache, 1);
+	fake_assign_cache = NULL;
+}
+
+static struct expression *cached_fake_assign(const char *name, struct symbol *type,
+					     struct expression *call,
+					     struct expression *expr, int nr)
+{
+	struct fake_assign_key *key, lookup = { call, expr, nr };
+	struct fake_assign_entry *entry;
+	struct expression *assign;
+
+	if (!fake_assign_cache)
+		fake_assign_cache = create_hashtable(1000, fake_assign_hash, fake_assign_equal);
+
+	entry = hashtable_search(fake_assign_cache, &lookup);
+	if (entry && entry->type == type && entry->assign->right == expr) {
+		assign = entry->assign;
+		if (expr_get_fake_parent_expr(expr) != assign) {
+			assign->parent = expr->parent;
+			expr_set_parent_expr(expr, assign);
+		}
+		__fake_state_cnt++;
+		return assign;
+	}
+
+	assign = create_fake_assign(name, type, expr);
+	if (!assign || entry)
+		return assign;
+
+	key = malloc(sizeof(*key));
+	*key = lookup;
+	entry = malloc(sizeof(*entry));
+	entry->type = type;
+	entry->assign = assign;
+	hashtable_insert(fake_assign_cache, key, entry);
+
+	return assign;
+}
+
 static struct expression *fake_a_variable_assign(struct symbol *type, struct expression *call, struct expression *expr, int nr)
 {
 	char buf[64];
@@ -1795,7 +1961,7 @@ static struct expression *fake_a_variable_assign(struct symbol *type, struct exp
 	else
 		snprintf(buf, sizeof(buf), "__fake_param_%p_%d", call, nr);
 
-	return create_fake_assign(buf, type, expr);
+	return cached_fake_assign(buf, type, call, expr, nr);
 }
 
 struct expression *get_fake_return_variable(struct expression *expr)
@@ -2220,71 +2386,270 @@ static void clear_function_data(void)
 
 static void record_func_time(void)
 {
-	struct timeval stop;
 	int func_time;
 	char buf[32];
 
-	gettimeofday(&stop, NULL);
-	func_time = stop.tv_sec - fn_start_time.tv_sec;
+	func_time = ms_since(&fn_start_time);
 	snprintf(buf, sizeof(buf), "%d", func_time);
 	sql_insert_return_implies(FUNC_TIME, 0, "", buf);
-	if (option_time && func_time > 2) {
+	if (option_time && func_time > 2000) {
 		final_pass++;
-		sm_msg("func_time: %d", func_time);
+		sm_msg("func_time: %d", func_time / 1000);
 		final_pass--;
 	}
 }
 
+static unsigned long nr_functions;
+
+/*
+ * --profile=<file> appends a line of JSON for each function.  The counts
+ * include the inlined functions and both passes of --two-passes.
+ */
+struct fn_profile {
+	struct timespec cpu;
+	unsigned long statements;
+	unsigned long states;
+	unsigned long merges;
+	unsigned long pools;
+	unsigned long inlines;
+	unsigned long queries;
+	unsigned long long query_ns;
+};
+
+static FILE *profile_fd;
+
+static void start_fn_profile(struct fn_profile *prof)
+{
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &prof->cpu);
+	prof->statements = nr_statements;
+	prof->states = sm_state_total;
+	prof->merges = sm_merge_total;
+	prof->pools = sm_pool_total;
+	prof->inlines = nr_inlines;
+	prof->queries = sql_query_count;
+	prof->query_ns = sql_query_ns;
+}
+
+void print_json_str(FILE *file, const char *str)
+{
+	const char *p;
+
+	fputc('"', file);
+	for (p = str; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			fputc('\\', file);
+		fputc(*p, file);
+	}
+	fputc('"', file);
+}
+
+static void write_fn_profile(struct symbol *sym, struct fn_profile *prof)
+{
+	struct timespec cpu;
+
+	if (!profile_fd) {
+		profile_fd = fopen(option_profile, "a");
+		if (!profile_fd) {
+			sm_ierror("cannot open '%s': %m", option_profile);
+			option_profile = NULL;
+			return;
+		}
+		/* one write() per line so the --jobs workers don't mix lines */
+		setvbuf(profile_fd, NULL, _IOLBF, 0);
+	}
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+	fprintf(profile_fd, "{\"file\": ");
+	print_json_str(profile_fd, get_filename());
+	fprintf(profile_fd, ", \"function\": ");
+	print_json_str(profile_fd, sym->ident ? sym->ident->name : "");
+	fprintf(profile_fd, ", \"line\": %d, \"wall_ms\": %d, \"cpu_ms\": %lld, \"statements\": %lu, \"sm_states\": %lu, \"merges\": %lu, \"pools\": %lu, \"inlines\": %lu, \"db_queries\": %lu, \"db_us\": %llu}\n",
+		sym->pos.line, ms_since(&outer_fn_start_time),
+		(cpu.tv_sec - prof->cpu.tv_sec) * 1000LL +
+		(cpu.tv_nsec - prof->cpu.tv_nsec) / 1000000,
+		nr_statements - prof->statements,
+		sm_state_total - prof->states,
+		sm_merge_total - prof->merges,
+		sm_pool_total - prof->pools,
+		nr_inlines - prof->inlines,
+		sql_query_count - prof->queries,
+		(sql_query_ns - prof->query_ns) / 1000);
+}
+
+/*
+ * With --info the DB rows for a function are held back until the function
+ * is done.  If it runs out of time or memory the return_states it printed
+ * are only for the paths it got to, so they're thrown away and the function
+ * is parsed again in degraded mode: no implications, no states for the
+ * check_* modules and a quarter of the time and memory.  The register_*
+ * modules still run because they're what fills in the return_states.  That
+ * gives the callers a less precise summary instead of a wrong one.
+ *
+ * Only sql_outfd and caller_info_fd are held back.  The warnings from the
+ * first pass are printed as they happen and they're kept.  The degraded pass
+ * can't find the state based ones so everything it prints to sm_outfd is
+ * dropped.  Otherwise the other warnings would be printed twice.
+ */
+static FILE **fn_fds[2] = { &sql_outfd, &caller_info_fd };
+static FILE *fn_orig[2];
+static FILE *fn_mem[2];
+static char *fn_buf[2];
+static size_t fn_size[2];
+
+static int fn_stream(int i)
+{
+	int j;
+
+	for (j = 0; j < i; j++) {
+		if (fn_orig[j] == fn_orig[i])
+			return j;
+	}
+	return i;
+}
+
+static void start_fn_capture(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fn_fds); i++)
+		fn_orig[i] = *fn_fds[i];
+	for (i = 0; i < ARRAY_SIZE(fn_fds); i++) {
+		if (fn_stream(i) != i)
+			continue;
+		fn_mem[i] = open_memstream(&fn_buf[i], &fn_size[i]);
+		if (!fn_mem[i])
+			sm_fatal("open_memstream() failed");
+	}
+	for (i = 0; i < ARRAY_SIZE(fn_fds); i++)
+		*fn_fds[i] = fn_mem[fn_stream(i)];
+}
+
+static void end_fn_capture(bool keep)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fn_fds); i++)
+		*fn_fds[i] = fn_orig[i];
+	for (i = 0; i < ARRAY_SIZE(fn_fds); i++) {
+		if (!fn_mem[i])
+			continue;
+		fclose(fn_mem[i]);
+		fn_mem[i] = NULL;
+		if (keep)
+			fwrite(fn_buf[i], 1, fn_size[i], fn_orig[i]);
+		free(fn_buf[i]);
+		fn_buf[i] = NULL;
+	}
+}
+
+static void parse_function_body(struct symbol *sym)
+{
+	__unnullify_path();
+	loop_num = 0;
+	final_pass = 1;
+	start_function_definition(sym);
+	parse_fn_statements(get_base_type(sym));
+	if (!__path_is_null() &&
+	    cur_func_return_type() == &void_ctype &&
+	    !__bail_on_rest_of_function) {
+		__call_all_scope_hooks();
+		__pass_to_client(NULL, RETURN_HOOK);
+		nullify_path();
+	}
+	__pass_to_client(sym, END_FUNC_HOOK);
+	__free_scope_hooks();
+	__pass_to_client(sym, AFTER_FUNC_HOOK);
+}
+
+static void parse_degraded(struct symbol *sym)
+{
+	FILE *orig_outfd = sm_outfd;
+	char *buf = NULL;
+	size_t size = 0;
+
+	end_fn_capture(false);
+	final_pass = 1;
+	sm_perror("Function too hairy.  Parsing it again without implications.");
+
+	clear_all_states();
+	clear_function_data();
+	free_data_info_allocs();
+	free_expression_stack(&switch_expr_stack);
+	__free_ptr_list((struct ptr_list **)&big_statement_stack);
+	loop_count = 0;
+	last_goto_statement_handled = 0;
+	__stree_id = 0;
+	__bail_on_rest_of_function = 0;
+
+	__degraded_pass = 1;
+	gettimeofday(&outer_fn_start_time, NULL);
+	gettimeofday(&fn_start_time, NULL);
+	fn_budget_ms /= 4;
+	if (fn_budget_ms < MIN_FUNC_BUDGET_MS)
+		fn_budget_ms = MIN_FUNC_BUDGET_MS;
+	sm_outfd = open_memstream(&buf, &size);
+	if (!sm_outfd)
+		sm_fatal("open_memstream() failed");
+	parse_function_body(sym);
+	fclose(sm_outfd);
+	free(buf);
+	sm_outfd = orig_outfd;
+	__degraded_pass = 0;
+}
+
 static void split_function(struct symbol *sym)
 {
 	struct symbol *base_type = get_base_type(sym);
+	struct fn_profile prof;
+	bool capture;
 
 	if (!base_type->stmt && !base_type->inline_stmt)
 		return;
+	if (option_process_function && sym->ident &&
+	    strcmp(option_process_function, sym->ident->name) != 0)
+		return;
 
+	nr_functions++;
+	if (option_profile)
+		start_fn_profile(&prof);
 	gettimeofday(&outer_fn_start_time, NULL);
 	gettimeofday(&fn_start_time, NULL);
+	set_func_budget();
 	cur_func_sym = sym;
 	if (sym->ident)
 		cur_func = sym->ident->name;
-	if (option_process_function && cur_func &&
-	    strcmp(option_process_function, cur_func) != 0)
-		return;
 	set_position(sym->pos);
 	clear_function_data();
 	loop_count = 0;
 	last_goto_statement_handled = 0;
 	sm_debug("new function:  %s\n", cur_func);
 	__stree_id = 0;
-	if (option_two_passes) {
+	capture = option_info && !__inline_fn;
+	if (capture)
+		start_fn_capture();
+	if (option_two_passes && __has_two_pass_checks()) {
 		__unnullify_path();
 		loop_num = 0;
 		final_pass = 0;
+		__first_pass = true;
 		start_function_definition(sym);
 		parse_fn_statements(base_type);
 		do_scope_hooks();
 		nullify_path();
+		__first_pass = false;
 	}
-	__unnullify_path();
-	loop_num = 0;
-	final_pass = 1;
-	start_function_definition(sym);
-	parse_fn_statements(base_type);
-	if (!__path_is_null() &&
-	    cur_func_return_type() == &void_ctype &&
-	    !__bail_on_rest_of_function) {
-		__call_all_scope_hooks();
-		__pass_to_client(NULL, RETURN_HOOK);
-		nullify_path();
-	}
-	__pass_to_client(sym, END_FUNC_HOOK);
-	__free_scope_hooks();
-	__pass_to_client(sym, AFTER_FUNC_HOOK);
+	parse_function_body(sym);
+	if (capture && __bail_on_rest_of_function)
+		parse_degraded(sym);
+	if (capture)
+		end_fn_capture(true);
 	sym->parsed = true;
 
 	clear_all_states();
 
 	record_func_time();
+	if (option_profile)
+		write_fn_profile(sym, &prof);
 
 	cur_func_sym = NULL;
 	cur_func = NULL;
@@ -2367,8 +2732,14 @@ void parse_inline(struct expression *call)
 	if (already_parsed_call(call))
 		return;
 
+	if (mem_db_load_inline(call->fn->symbol, (unsigned long)call)) {
+		call->fn->symbol->parsed = true;
+		return;
+	}
+
 	save_flow_state();
 
+	nr_inlines++;
 	gettimeofday(&fn_start_time, NULL);
 	__pass_to_client(call, INLINE_FN_START);
 	final_pass = 0;  /* don't print anything */
@@ -2409,6 +2780,8 @@ void parse_inline(struct expression *call)
 	__free_scope_hooks();
 	__pass_to_client(call->fn->symbol, AFTER_FUNC_HOOK);
 	call->fn->symbol->parsed = true;
+	if (!__bail_on_rest_of_function)
+		mem_db_save_inline(call->fn->symbol, (unsigned long)call);
 
 	free_expression_stack(&switch_expr_stack);
 	__free_ptr_list((struct ptr_list **)&big_statement_stack);
@@ -2492,6 +2865,11 @@ static bool interesting_function(struct symbol *sym)
 	return prev_answer;
 }
 
+static int defer_body(struct symbol *decl)
+{
+	return decl->ident && !interesting_function(decl);
+}
+
 static void split_inlines_in_scope(struct symbol *sym)
 {
 	struct symbol *base;
@@ -2547,29 +2925,272 @@ static struct stree *clone_estates_perm(struct stree *orig)
 }
 
 struct position last_pos;
+/*
+ * With --jobs=<n> the functions in the file are split between <n> forked
+ * workers.  Worker "w" does every function where "idx % n == w".  The output
+ * of each function is caught in memory streams and written to the worker's
+ * tmpfile() as records.  Afterwards the parent puts the records back in
+ * source order so the output doesn't depend on which worker finished first.
+ *
+ * The inline functions are passed back to the parent and parsed there once.
+ * Each worker runs the END_FILE_HOOK for the data it collected.
+ */
+enum {
+	JOB_STREAMS = 3,
+	JOB_INLINE = JOB_STREAMS,
+	JOB_COUNTS,
+};
+
+struct job_record {
+	int idx;
+	int stream;
+	int len;
+};
+
+struct job_output {
+	struct job_record rec;
+	int seq;
+	char *data;
+};
+
+static FILE *job_file;
+static FILE **job_fds[JOB_STREAMS] = { &sm_outfd, &sql_outfd, &caller_info_fd };
+static FILE *job_orig[JOB_STREAMS];
+static FILE *job_mem[JOB_STREAMS];
+static char *job_buf[JOB_STREAMS];
+static size_t job_size[JOB_STREAMS];
+
+/* sm_outfd, sql_outfd and caller_info_fd are often all stdout */
+static int job_stream(FILE *fd)
+{
+	int i;
+
+	for (i = 0; i < JOB_STREAMS; i++) {
+		if (job_orig[i] == fd)
+			return i;
+	}
+	return -1;
+}
+
+static void write_job_record(int idx, int stream, const void *data, int len)
+{
+	struct job_record rec = { .idx = idx, .stream = stream, .len = len };
+
+	fwrite(&rec, sizeof(rec), 1, job_file);
+	fwrite(data, len, 1, job_file);
+}
+
+static void start_job_capture(void)
+{
+	int i;
+
+	for (i = 0; i < JOB_STREAMS; i++) {
+		if (job_stream(job_orig[i]) != i)
+			continue;
+		job_mem[i] = open_memstream(&job_buf[i], &job_size[i]);
+		if (!job_mem[i])
+			sm_fatal("open_memstream() failed");
+	}
+	for (i = 0; i < JOB_STREAMS; i++)
+		*job_fds[i] = job_mem[job_stream(job_orig[i])];
+}
+
+static void end_job_capture(int idx)
+{
+	int i;
+
+	for (i = 0; i < JOB_STREAMS; i++)
+		*job_fds[i] = job_orig[i];
+	for (i = 0; i < JOB_STREAMS; i++) {
+		if (!job_mem[i])
+			continue;
+		fclose(job_mem[i]);
+		job_mem[i] = NULL;
+		if (job_size[i])
+			write_job_record(idx, i, job_buf[i], job_size[i]);
+		free(job_buf[i]);
+		job_buf[i] = NULL;
+	}
+	fflush(job_file);
+}
+
+static void __attribute__((noreturn)) run_job(struct symbol_list *sym_list, int job, int nr)
+{
+	int counts[2] = { sm_nr_errors, sm_nr_checks };
+	struct symbol *sym, *inline_sym;
+	int idx = 0;
+
+	FOR_EACH_PTR(sym_list, sym) {
+		set_position(sym->pos);
+		if (!interesting_function(sym))
+			continue;
+		if (sym->type != SYM_NODE || get_base_type(sym)->type != SYM_FN)
+			continue;
+		if (idx++ % option_jobs != job)
+			continue;
+
+		start_job_capture();
+		split_function(sym);
+		end_job_capture(idx - 1);
+
+		FOR_EACH_PTR(inlines_called, inline_sym) {
+			write_job_record(idx - 1, JOB_INLINE, &inline_sym, sizeof(inline_sym));
+		} END_FOR_EACH_PTR(inline_sym);
+		free_ptr_list(&inlines_called);
+	} END_FOR_EACH_PTR(sym);
+
+	start_job_capture();
+	__pass_to_client(sym_list, END_FILE_HOOK);
+	end_job_capture(nr + job);
+
+	counts[0] = sm_nr_errors - counts[0];
+	counts[1] = sm_nr_checks - counts[1];
+	write_job_record(nr + job, JOB_COUNTS, counts, sizeof(counts));
+	fflush(job_file);
+	_exit(0);
+}
+
+static int cmp_job_output(const void *_a, const void *_b)
+{
+	const struct job_output *a = _a;
+	const struct job_output *b = _b;
+
+	if (a->rec.idx != b->rec.idx)
+		return a->rec.idx < b->rec.idx ? -1 : 1;
+	return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+static void merge_job_output(FILE **files, int jobs)
+{
+	struct job_output *out = NULL;
+	struct job_record rec;
+	struct symbol *sym;
+	int *counts;
+	int nr = 0, max = 0;
+	int i;
+
+	for (i = 0; i < jobs; i++) {
+		rewind(files[i]);
+		while (fread(&rec, sizeof(rec), 1, files[i]) == 1) {
+			if (nr == max) {
+				max = max ? max * 2 : 1024;
+				out = realloc(out, max * sizeof(*out));
+			}
+			out[nr].rec = rec;
+			out[nr].seq = nr;
+			out[nr].data = malloc(rec.len);
+			if (fread(out[nr].data, rec.len, 1, files[i]) != 1) {
+				free(out[nr].data);
+				break;
+			}
+			nr++;
+		}
+		fclose(files[i]);
+	}
+
+	qsort(out, nr, sizeof(*out), cmp_job_output);
+
+	for (i = 0; i < nr; i++) {
+		switch (out[i].rec.stream) {
+		case JOB_INLINE:
+			memcpy(&sym, out[i].data, sizeof(sym));
+			add_inline_function(sym);
+			break;
+		case JOB_COUNTS:
+			counts = (int *)out[i].data;
+			sm_nr_errors += counts[0];
+			sm_nr_checks += counts[1];
+			break;
+		default:
+			fwrite(out[i].data, out[i].rec.len, 1, job_orig[out[i].rec.stream]);
+		}
+		free(out[i].data);
+	}
+	free(out);
+}
+
+static void split_functions_parallel(struct symbol_list *sym_list)
+{
+	FILE *files[option_jobs];
+	pid_t pids[option_jobs];
+	struct symbol *sym;
+	int status;
+	int nr = 0;
+	int i;
+
+	FOR_EACH_PTR(sym_list, sym) {
+		if (!interesting_function(sym))
+			continue;
+		if (sym->type == SYM_NODE && get_base_type(sym)->type == SYM_FN)
+			nr++;
+		last_pos = sym->pos;
+	} END_FOR_EACH_PTR(sym);
+
+	for (i = 0; i < JOB_STREAMS; i++)
+		job_orig[i] = *job_fds[i];
+	fflush(NULL);
+
+	for (i = 0; i < option_jobs; i++) {
+		files[i] = tmpfile();
+		if (!files[i])
+			sm_fatal("tmpfile() failed");
+		pids[i] = fork();
+		if (pids[i] < 0)
+			sm_fatal("fork() failed");
+		if (pids[i] == 0) {
+			job_file = files[i];
+			run_job(sym_list, i, nr);
+		}
+	}
+
+	for (i = 0; i < option_jobs; i++) {
+		if (waitpid(pids[i], &status, 0) < 0 ||
+		    !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			sm_ierror("worker %d failed", i);
+	}
+
+	merge_job_output(files, option_jobs);
+	process_inlines();
+}
+
 static void split_c_file_functions(struct symbol_list *sym_list)
 {
 	struct symbol *sym;
 
+	mem_db_clear_inline_cache();
+	clear_fake_assign_cache();
+	db_prefetch_symbols(sym_list);
 	__unnullify_path();
 	FOR_EACH_PTR(sym_list, sym) {
 		set_position(sym->pos);
 		if (sym->type != SYM_NODE || get_base_type(sym)->type != SYM_FN) {
 			__pass_to_client(sym, BASE_HOOK);
-			fake_global_assign(sym);
+			if (!option_fast)
+				fake_global_assign(sym);
 			__pass_to_client(sym, DECLARATION_HOOK_AFTER);
 		}
 	} END_FOR_EACH_PTR(sym);
 	global_states = clone_estates_perm(get_all_states_stree(SMATCH_EXTRA));
 	nullify_path();
 
+	/* the forked jobs can't share the connection or the capture file */
+	if (option_jobs > 1 && !db_remote_connected() && !option_db_capture) {
+		split_functions_parallel(sym_list);
+		split_inlines(sym_list);
+		__pass_to_client(sym_list, END_FILE_HOOK);
+		return;
+	}
+
 	FOR_EACH_PTR(sym_list, sym) {
 		set_position(sym->pos);
 		last_pos = sym->pos;
 		if (!interesting_function(sym))
 			continue;
 		if (sym->type == SYM_NODE && get_base_type(sym)->type == SYM_FN) {
-			split_function(sym);
+			if (!result_cache_function_lookup(sym)) {
+				split_function(sym);
+				result_cache_function_save();
+			}
 			process_inlines();
 		}
 		last_pos = sym->pos;
@@ -2604,31 +3225,190 @@ static void open_output_files(char *base_file)
 	sm_outfd = fopen(buf, "w");
 	if (!sm_outfd)
 		sm_fatal("Cannot open %s", buf);
+	sm_buffer_output(sm_outfd);
 
-	if (!option_info)
+	if (!option_info || db_remote_connected())
 		return;
 
 	snprintf(buf, sizeof(buf), "%s.smatch.sql", base_file);
 	sql_outfd = fopen(buf, "w");
 	if (!sql_outfd)
 		sm_fatal("Error:  Cannot open %s", buf);
+	sm_buffer_output(sql_outfd);
 
 	snprintf(buf, sizeof(buf), "%s.smatch.caller_info", base_file);
 	caller_info_fd = fopen(buf, "w");
 	if (!caller_info_fd)
 		sm_fatal("Error:  Cannot open %s", buf);
+	sm_buffer_output(caller_info_fd);
+}
+
+/*
+ * With --spool the output for a file is collected in memory and then
+ * appended to the shared files in one go while holding a lock.  That way
+ * all the smatch processes of a parallel build can write to the same three
+ * files instead of leaving a .smatch file next to every source file.
+ *
+ * --gzip compresses each of those chunks as a separate gzip member.  The
+ * members can be concatenated and "gzip -dc" reads them back as one file.
+ * --file-output --gzip goes through here as well, it just truncates the
+ * per source files instead of appending.
+ */
+static const char *spool_suffix[JOB_STREAMS] = { "", ".sql", ".caller_info" };
+static char *spool_prefix;
+static int spool_append;
+static FILE *spool_orig[JOB_STREAMS];
+static FILE *spool_mem[JOB_STREAMS];
+static char *spool_buf[JOB_STREAMS];
+static size_t spool_size[JOB_STREAMS];
+
+static void start_spool(const char *prefix, int append)
+{
+	int i;
+
+	spool_prefix = alloc_string(prefix);
+	spool_append = append;
+	for (i = 0; i < JOB_STREAMS; i++) {
+		spool_orig[i] = *job_fds[i];
+		if (i != 0 && (!option_info || db_remote_connected()))
+			continue;
+		spool_mem[i] = open_memstream(&spool_buf[i], &spool_size[i]);
+		if (!spool_mem[i])
+			sm_fatal("open_memstream() failed");
+		*job_fds[i] = spool_mem[i];
+	}
+}
+
+static char *gzip_buffer(const char *data, size_t len, size_t *out_len)
+{
+	z_stream strm = {};
+	size_t max;
+	char *out;
+
+	/* 16 + 15 is a 32k window with a gzip header instead of a zlib one */
+	if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + 15, 8,
+			 Z_DEFAULT_STRATEGY) != Z_OK)
+		sm_fatal("deflateInit2() failed");
+	max = deflateBound(&strm, len);
+	out = malloc(max);
+	strm.next_in = (unsigned char *)data;
+	strm.avail_in = len;
+	strm.next_out = (unsigned char *)out;
+	strm.avail_out = max;
+	if (deflate(&strm, Z_FINISH) != Z_STREAM_END)
+		sm_fatal("deflate() failed");
+	*out_len = max - strm.avail_out;
+	deflateEnd(&strm);
+	return out;
+}
+
+static void write_to_spool(const char *suffix, const char *data, size_t len)
+{
+	struct flock lock = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+	char buf[PATH_MAX];
+	char *gz = NULL;
+	ssize_t ret;
+	int fd;
+
+	if (option_gzip)
+		data = gz = gzip_buffer(data, len, &len);
+
+	snprintf(buf, sizeof(buf), "%s%s", spool_prefix, suffix);
+	fd = open(buf, O_WRONLY | O_CREAT | (spool_append ? O_APPEND : O_TRUNC), 0666);
+	if (fd < 0)
+		sm_fatal("Cannot open %s", buf);
+	if (fcntl(fd, F_SETLKW, &lock) < 0)
+		sm_fatal("Cannot lock %s", buf);
+	while (len) {
+		ret = write(fd, data, len);
+		if (ret < 0)
+			sm_fatal("Cannot write to %s", buf);
+		data += ret;
+		len -= ret;
+	}
+	close(fd);
+	free(gz);
+}
+
+static void flush_spool(void)
+{
+	int i;
+
+	for (i = 0; i < JOB_STREAMS; i++)
+		*job_fds[i] = spool_orig[i];
+	for (i = 0; i < JOB_STREAMS; i++) {
+		if (!spool_mem[i])
+			continue;
+		fclose(spool_mem[i]);
+		spool_mem[i] = NULL;
+		if (spool_size[i] || !spool_append)
+			write_to_spool(spool_suffix[i], spool_buf[i], spool_size[i]);
+		free(spool_buf[i]);
+		spool_buf[i] = NULL;
+	}
+	free_string(spool_prefix);
+	spool_prefix = NULL;
+}
+
+/*
+ * --stats=<file> appends a line of JSON for each file.  The
+ * validation/bench-suite script uses it to compare one smatch with another.
+ */
+static void write_stats(struct timeval *start, unsigned long functions,
+			unsigned long states, unsigned long merges)
+{
+	struct timeval stop;
+	FILE *file;
+
+	file = fopen(option_stats, "a");
+	if (!file) {
+		sm_ierror("cannot open '%s': %m", option_stats);
+		return;
+	}
+	gettimeofday(&stop, NULL);
+
+	fprintf(file, "{\"file\": ");
+	print_json_str(file, base_file);
+	fprintf(file, ", \"wall_ms\": %d, \"max_rss_kb\": %lu, \"functions\": %lu, \"sm_states\": %lu, \"merges\": %lu}\n",
+		ms_since(start), get_max_memory(), nr_functions - functions,
+		sm_state_total - states, sm_merge_total - merges);
+	fclose(file);
+}
+
+/*
+ * Parses the #include lines which the next file starts with, see
+ * sparse_prefix().  The function bodies are skipped or deferred the same
+ * as they would be if the lines were parsed as part of the file.
+ */
+void smatch_prefix(const char *buf, int nr_includes)
+{
+	skip_function_body = &skip_body;
+	if (option_lazy_inline)
+		defer_function_body = &defer_body;
+	sparse_prefix(buf, nr_includes);
+	skip_function_body = NULL;
+	defer_function_body = NULL;
 }
 
 void smatch(struct string_list *filelist)
 {
 	struct symbol_list *sym_list;
-	struct timeval stop, start;
+	struct timeval stop, start, file_start;
+	unsigned long functions, states, merges;
+	char buf[PATH_MAX];
 	char *path;
 	int len;
 
 	gettimeofday(&start, NULL);
+	smatch_start_time = start;
 
+	retire_bodies = 1;
 	FOR_EACH_PTR_NOTAG(filelist, base_file) {
+		gettimeofday(&file_start, NULL);
+		functions = nr_functions;
+		states = sm_state_total;
+		merges = sm_merge_total;
+		retire_function_bodies();
 		path = getcwd(NULL, 0);
 		free(full_base_file);
 		if (path) {
@@ -2638,11 +3418,35 @@ void smatch(struct string_list *filelist)
 		} else {
 			full_base_file = alloc_string(base_file);
 		}
-		if (option_file_output)
+		if (option_spool) {
+			start_spool(option_spool, 1);
+		} else if (option_file_output && option_gzip) {
+			snprintf(buf, sizeof(buf), "%s.smatch", base_file);
+			start_spool(buf, 0);
+		} else if (option_file_output) {
 			open_output_files(base_file);
+		}
 		base_file_stream = input_stream_nr;
+		skip_function_body = &skip_body;
+		if (option_lazy_inline)
+			defer_function_body = &defer_body;
 		sym_list = sparse_keep_tokens(base_file);
-		split_c_file_functions(sym_list);
+		skip_function_body = NULL;
+		defer_function_body = NULL;
+		if (!option_result_cache || !result_cache_lookup(sym_list)) {
+			split_c_file_functions(sym_list);
+			result_cache_save();
+		}
+		if (spool_prefix)
+			flush_spool();
+		if (option_stats)
+			write_stats(&file_start, functions, states, merges);
+		if (option_time_stmt)
+			print_stmt_profile();
+		if (option_mem) {
+			final_pass = 1;
+			show_owner_peak_mem();
+		}
 	} END_FOR_EACH_PTR_NOTAG(base_file);
 
 	gettimeofday(&stop, NULL);
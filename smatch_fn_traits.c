@@ -0,0 +1,127 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * Some modules want to know a simple fact about a function, such as does it
+ * return fresh memory or does it sleep.  They used to ask the DB each time
+ * they saw a call.  The answer doesn't change during a run so it is looked
+ * up once per function and then it is just a struct member.
+ *
+ * Static functions with the same name in other files are different
+ * functions, and the symbols are only good for one file, so the cache is
+ * thrown away at the end of each file.
+ */
+
+#include "smatch.h"
+
+static int my_id;
+
+#define TRAITS_HASH_BITS 9
+#define TRAITS_HASH_SIZE (1 << TRAITS_HASH_BITS)
+static struct fn_traits *traits_hash[TRAITS_HASH_SIZE];
+
+static unsigned int traits_hashval(struct symbol *sym)
+{
+	unsigned long hash = (unsigned long)sym;
+
+	hash ^= hash >> 7;
+	hash ^= hash >> 17;
+	return hash & (TRAITS_HASH_SIZE - 1);
+}
+
+static int return_implies_callback(void *_traits, int argc, char **argv, char **azColName)
+{
+	struct fn_traits *traits = _traits;
+
+	switch (atoi(argv[0])) {
+	case SLEEP:
+		traits->sleeps = true;
+		break;
+	case LEAF_FN:
+		traits->leaf = true;
+		break;
+	case FUNC_TIME:
+		traits->time = strtoul(argv[1], NULL, 10);
+		break;
+	}
+	return 0;
+}
+
+static int fresh_callback(void *_traits, int argc, char **argv, char **azColName)
+{
+	struct fn_traits *traits = _traits;
+
+	traits->fresh_alloc = true;
+	return 0;
+}
+
+static void load_traits(struct fn_traits *traits)
+{
+	const char *filter;
+
+	filter = get_static_filter(traits->sym);
+
+	run_sql(&return_implies_callback, traits,
+		"select type, value from return_implies where %s and type in (%d, %d, %d);",
+		filter, SLEEP, LEAF_FN, FUNC_TIME);
+	run_sql(&fresh_callback, traits,
+		"select 1 from return_states where %s and type = %d and parameter = -1 and key = '$' limit 1;",
+		filter, FRESH_ALLOC);
+}
+
+const struct fn_traits *get_fn_traits(struct symbol *sym)
+{
+	static const struct fn_traits no_traits;
+	struct fn_traits *traits;
+	unsigned int hash;
+
+	if (!sym || !sym->ident)
+		return &no_traits;
+
+	hash = traits_hashval(sym);
+	for (traits = traits_hash[hash]; traits; traits = traits->next) {
+		if (traits->sym == sym)
+			return traits;
+	}
+
+	traits = calloc(1, sizeof(*traits));
+	traits->sym = sym;
+	load_traits(traits);
+
+	traits->next = traits_hash[hash];
+	traits_hash[hash] = traits;
+	return traits;
+}
+
+static void free_traits(struct symbol_list *sym_list)
+{
+	struct fn_traits *traits, *next;
+	int i;
+
+	for (i = 0; i < TRAITS_HASH_SIZE; i++) {
+		for (traits = traits_hash[i]; traits; traits = next) {
+			next = traits->next;
+			free(traits);
+		}
+		traits_hash[i] = NULL;
+	}
+}
+
+void register_fn_traits(int id)
+{
+	my_id = id;
+
+	add_hook(&free_traits, END_FILE_HOOK);
+}
@@ -75,37 +75,16 @@ static void pre_merge_hook(struct sm_state *cur, struct sm_state *other)
 		set_state(my_id, cur->name, cur->sym, &undefined);
 }
 
-static int fresh_callback(void *fresh, int argc, char **argv, char **azColName)
-{
-	*(int *)fresh = 1;
-	return 0;
-}
-
 static int fresh_from_db(struct expression *call)
 {
-	static struct expression *prev_call;
-	static int prev_ret;
-	int fresh = 0;
-
 	if (is_fake_call(call))
 		return 0;
 
-	if (call == prev_call)
-		return prev_ret;
-	prev_call = call;
-
 	/* for function pointers assume everything is used */
-	if (call->fn->type != EXPR_SYMBOL) {
-		prev_ret = 0;
+	if (call->fn->type != EXPR_SYMBOL)
 		return 0;
-	}
-
-	run_sql(&fresh_callback, &fresh,
-		"select * from return_states where %s and type = %d and parameter = -1 and key = '$' limit 1;",
-		get_static_filter(call->fn->symbol), FRESH_ALLOC);
 
-	prev_ret = fresh;
-	return fresh;
+	return get_fn_traits(call->fn->symbol)->fresh_alloc;
 }
 
 bool is_fresh_alloc_var_sym(const char *var, struct symbol *sym)
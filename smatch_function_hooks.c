@@ -68,6 +68,7 @@
 
 struct fcall_back {
 	int type;
+	int owner;
 	struct data_range *range;
 	union {
 		func_hook *call_back;
@@ -79,10 +80,16 @@ struct fcall_back {
 };
 
 ALLOCATOR(fcall_back, "call backs");
+extern int __cur_check_id;
 DECLARE_PTR_LIST(call_back_list, struct fcall_back);
 
 DEFINE_FUNCTION_HASHTABLE_STATIC(callback, struct fcall_back, struct call_back_list);
 static struct hashtable *func_hash;
+/*
+ * The lookups for plain function calls are cached on the ident.  Adding a
+ * hook bumps the generation so the cached lists are looked up again.
+ */
+static unsigned int func_hash_gen = 1;
 
 unsigned long __in_fake_parameter_assign;
 
@@ -115,6 +122,7 @@ struct param_data {
 
 struct return_implies_callback {
 	int type;
+	int owner;
 	bool param_key;
 	union {
 		return_implies_hook *callback;
@@ -123,7 +131,12 @@ struct return_implies_callback {
 };
 ALLOCATOR(return_implies_callback, "return_implies callbacks");
 DECLARE_PTR_LIST(db_implies_list, struct return_implies_callback);
-static struct db_implies_list *db_return_states_list;
+/*
+ * The return_states callbacks hashed by type.  Every return_states row
+ * looks this up so it only has to look at the callbacks for its type.
+ */
+#define RETURN_STATES_HASH_SIZE 256
+static struct db_implies_list *db_return_states_hash[RETURN_STATES_HASH_SIZE];
 
 static struct void_fn_list *return_states_before;
 static struct void_fn_list *return_states_after;
@@ -136,8 +149,8 @@ struct db_callback_info {
 	struct range_list *rl;
 	int left;
 	struct stree *stree;
+	struct stree_stack *row_strees;
 	struct stree *implied;
-	struct db_implies_list *callbacks;
 	struct db_implies_list *called;
 	int prev_return_id;
 	int cull;
@@ -179,6 +192,7 @@ static struct fcall_back *alloc_fcall_back(int type, void *call_back,
 
 	cb = __alloc_fcall_back(0);
 	cb->type = type;
+	cb->owner = __cur_check_id;
 	cb->u.call_back = call_back;
 	cb->info = info;
 	return cb;
@@ -194,11 +208,29 @@ const char *get_fn_name(struct expression *fn)
 	return get_member_name(fn);
 }
 
-static struct call_back_list *get_call_backs(const char *fn_name)
+static void add_fn_callback(const char *look_for, struct fcall_back *cb)
 {
+	add_callback(func_hash, look_for, cb);
+	func_hash_gen++;
+}
+
+static struct call_back_list *get_call_backs(struct expression *fn, const char *fn_name)
+{
+	struct ident *ident;
+
 	if (!fn_name)
 		return NULL;
-	return search_callback(func_hash, (char *)fn_name);
+
+	fn = strip_expr(fn);
+	if (!fn || fn->type != EXPR_SYMBOL || !fn->symbol || !fn->symbol->ident)
+		return search_callback(func_hash, (char *)fn_name);
+
+	ident = fn->symbol->ident;
+	if (ident->fn_hooks_gen != func_hash_gen) {
+		ident->fn_hooks = search_callback(func_hash, (char *)fn_name);
+		ident->fn_hooks_gen = func_hash_gen;
+	}
+	return ident->fn_hooks;
 }
 
 void add_function_hook(const char *look_for, func_hook *call_back, void *info)
@@ -206,7 +238,7 @@ void add_function_hook(const char *look_for, func_hook *call_back, void *info)
 	struct fcall_back *cb;
 
 	cb = alloc_fcall_back(REGULAR_CALL, call_back, info);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 void add_function_hook_early(const char *look_for, func_hook *call_back, void *info)
@@ -214,7 +246,7 @@ void add_function_hook_early(const char *look_for, func_hook *call_back, void *i
 	struct fcall_back *cb;
 
 	cb = alloc_fcall_back(REGULAR_CALL_EARLY, call_back, info);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 void add_function_hook_late(const char *look_for, func_hook *call_back, void *info)
@@ -222,7 +254,7 @@ void add_function_hook_late(const char *look_for, func_hook *call_back, void *in
 	struct fcall_back *cb;
 
 	cb = alloc_fcall_back(REGULAR_CALL_LATE, call_back, info);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 void add_function_assign_hook(const char *look_for, func_hook *call_back,
@@ -231,7 +263,7 @@ void add_function_assign_hook(const char *look_for, func_hook *call_back,
 	struct fcall_back *cb;
 
 	cb = alloc_fcall_back(ASSIGN_CALL, call_back, info);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 static void register_funcs_from_file_helper(const char *file,
@@ -281,7 +313,7 @@ void add_implied_return_hook(const char *look_for,
 	struct fcall_back *cb;
 
 	cb = alloc_fcall_back(IMPLIED_RETURN, call_back, info);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 void add_cull_hook(const char *look_for, cull_hook *call_back, void *info)
@@ -289,7 +321,7 @@ void add_cull_hook(const char *look_for, cull_hook *call_back, void *info)
 	struct fcall_back *cb;
 
 	cb = alloc_fcall_back(CULL_HOOK, call_back, info);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 static void db_helper(struct expression *expr, param_key_hook *call_back, int param, const char *key, void *info)
@@ -485,7 +517,7 @@ void add_macro_assign_hook(const char *look_for, func_hook *call_back,
 	struct fcall_back *cb;
 
 	cb = alloc_fcall_back(MACRO_ASSIGN, call_back, info);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 void add_macro_assign_hook_extra(const char *look_for, func_hook *call_back,
@@ -494,7 +526,7 @@ void add_macro_assign_hook_extra(const char *look_for, func_hook *call_back,
 	struct fcall_back *cb;
 
 	cb = alloc_fcall_back(MACRO_ASSIGN_EXTRA, call_back, info);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 void return_implies_state(const char *look_for, long long start, long long end,
@@ -504,7 +536,7 @@ void return_implies_state(const char *look_for, long long start, long long end,
 
 	cb = alloc_fcall_back(RANGED_CALL, call_back, info);
 	cb->range = alloc_range_perm(ll_to_sval(start), ll_to_sval(end));
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 void return_implies_state_sval(const char *look_for, sval_t start, sval_t end,
@@ -514,7 +546,7 @@ void return_implies_state_sval(const char *look_for, sval_t start, sval_t end,
 
 	cb = alloc_fcall_back(RANGED_CALL, call_back, info);
 	cb->range = alloc_range_perm(start, end);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 void return_implies_exact(const char *look_for, sval_t start, sval_t end,
@@ -524,7 +556,7 @@ void return_implies_exact(const char *look_for, sval_t start, sval_t end,
 
 	cb = alloc_fcall_back(RANGED_EXACT, call_back, info);
 	cb->range = alloc_range_perm(start, end);
-	add_callback(func_hash, look_for, cb);
+	add_fn_callback(look_for, cb);
 }
 
 static struct return_implies_callback *alloc_db_return_callback(int type, bool param_key, void *callback)
@@ -533,6 +565,7 @@ static struct return_implies_callback *alloc_db_return_callback(int type, bool p
 
 	cb = __alloc_return_implies_callback(0);
 	cb->type = type;
+	cb->owner = __cur_check_id;
 	cb->param_key = param_key;
 	cb->callback = callback;
 
@@ -544,19 +577,39 @@ void select_return_states_hook(int type, return_implies_hook *callback)
 	struct return_implies_callback *cb;
 
 	cb = alloc_db_return_callback(type, false, callback);
-	add_ptr_list(&db_return_states_list, cb);
+	add_ptr_list(&db_return_states_hash[type % RETURN_STATES_HASH_SIZE], cb);
 }
 
 static void call_db_return_callback(struct db_callback_info *db_info,
 				    struct return_implies_callback *cb,
 				    int param, char *key, char *value)
 {
+	unsigned long long start = 0;
+
+	if (hook_profiling())
+		start = __hook_profile_start();
 	if (cb->param_key) {
 		db_helper(db_info->expr, cb->pk_callback, param, key, NULL);
 		add_ptr_list(&db_info->called, cb);
 	} else {
 		cb->callback(db_info->expr, param, key, value);
 	}
+	if (hook_profiling())
+		__hook_profile_stop(cb->owner, start);
+}
+
+static void call_db_return_callbacks(struct db_callback_info *db_info,
+				     int type, int param, char *key, char *value)
+{
+	struct return_implies_callback *tmp;
+
+	if (type < 0)
+		return;
+
+	FOR_EACH_PTR(db_return_states_hash[type % RETURN_STATES_HASH_SIZE], tmp) {
+		if (tmp->type == type)
+			call_db_return_callback(db_info, tmp, param, key, value);
+	} END_FOR_EACH_PTR(tmp);
 }
 
 void select_return_param_key(int type, param_key_hook *callback)
@@ -564,7 +617,7 @@ void select_return_param_key(int type, param_key_hook *callback)
 	struct return_implies_callback *cb;
 
 	cb = alloc_db_return_callback(type, true, callback);
-	add_ptr_list(&db_return_states_list, cb);
+	add_ptr_list(&db_return_states_hash[type % RETURN_STATES_HASH_SIZE], cb);
 }
 
 void select_return_states_before(void_fn *fn)
@@ -586,11 +639,16 @@ static bool call_call_backs(struct call_back_list *list, int type,
 			    const char *fn, struct expression *expr)
 {
 	struct fcall_back *tmp;
+	unsigned long long start = 0;
 	bool handled = false;
 
 	FOR_EACH_PTR(list, tmp) {
 		if (tmp->type == type) {
+			if (hook_profiling())
+				start = __hook_profile_start();
 			(tmp->u.call_back)(fn, expr, tmp->info);
+			if (hook_profiling())
+				__hook_profile_stop(tmp->owner, start);
 			handled = true;
 		}
 	} END_FOR_EACH_PTR(tmp);
@@ -609,7 +667,7 @@ static void call_function_hooks(struct expression *expr, enum fn_hook_type type)
 		return;
 
 	fn_name = get_fn_name(expr->fn);
-	call_backs = get_call_backs(fn_name);
+	call_backs = get_call_backs(expr->fn, fn_name);
 	if (!call_backs)
 		return;
 
@@ -672,8 +730,8 @@ static bool assign_ranged_funcs(const char *fn, struct expression *expr,
 	char *var_name;
 	struct symbol *sym;
 	struct smatch_state *estate;
-	struct stree *tmp_stree;
-	struct stree *final_states = NULL;
+	struct stree_stack *range_strees = NULL;
+	struct stree *final_states;
 	struct range_list *handled_ranges = NULL;
 	struct range_list *unhandled_rl;
 	struct call_back_list *same_range_call_backs = NULL;
@@ -709,9 +767,7 @@ static bool assign_ranged_funcs(const char *fn, struct expression *expr,
 		estate = alloc_estate_rl(rl);
 		set_extra_mod(var_name, sym, expr->left, estate);
 
-		tmp_stree = __pop_fake_cur_stree();
-		merge_fake_stree(&final_states, tmp_stree);
-		free_stree(&tmp_stree);
+		push_stree(&range_strees, __pop_fake_cur_stree());
 		handled = true;
 	} END_FOR_EACH_PTR(tmp);
 
@@ -721,11 +777,10 @@ static bool assign_ranged_funcs(const char *fn, struct expression *expr,
 		rl = cast_rl(get_type(expr->left), unhandled_rl);
 		estate = alloc_estate_rl(rl);
 		set_extra_mod(var_name, sym, expr->left, estate);
-		tmp_stree = __pop_fake_cur_stree();
-		merge_fake_stree(&final_states, tmp_stree);
-		free_stree(&tmp_stree);
+		push_stree(&range_strees, __pop_fake_cur_stree());
 	}
 
+	final_states = merge_fake_stree_stack(&range_strees);
 	FOR_EACH_SM(final_states, sm) {
 		__set_sm(sm);
 	} END_FOR_EACH_SM(sm);
@@ -749,7 +804,7 @@ static void call_implies_callbacks(int comparison, struct expression *expr, sval
 	*implied_true = NULL;
 	*implied_false = NULL;
 	fn_name = get_fn_name(expr->fn);
-	call_backs = get_call_backs(fn_name);
+	call_backs = get_call_backs(expr->fn, fn_name);
 	if (!call_backs)
 		return;
 	value_range = alloc_range(sval, sval);
@@ -812,7 +867,7 @@ static void call_cull_hooks(struct db_callback_info *db_info, struct range_list
 	fn_name = get_fn_name(expr->fn);
 	if (!fn_name)
 		return;
-	call_backs = search_callback(func_hash, (char *)fn_name);
+	call_backs = get_call_backs(expr->fn, fn_name);
 
 	FOR_EACH_PTR(call_backs, tmp) {
 		if (tmp->type != CULL_HOOK)
@@ -1199,15 +1254,22 @@ static void process_return_states(struct db_callback_info *db_info)
 	}
 
 	if (!db_info->cull) {
-		merge_fake_stree(&db_info->stree, stree);
+		push_stree(&db_info->row_strees, stree);
 		db_info->states_merged = true;
+	} else {
+		free_stree(&stree);
 	}
-	free_stree(&stree);
 
 	db_info->ret_state = NULL;
 	db_info->ret_str = NULL;
 }
 
+/* the rows are merged together at the end, see merge_fake_stree_stack() */
+static void merge_return_states(struct db_callback_info *db_info)
+{
+	db_info->stree = merge_fake_stree_stack(&db_info->row_strees);
+}
+
 static int db_compare_callback(void *_info, int argc, char **argv, char **azColName)
 {
 	struct db_callback_info *db_info = _info;
@@ -1215,7 +1277,6 @@ static int db_compare_callback(void *_info, int argc, char **argv, char **azColN
 	struct range_list *ret_range;
 	int type, param;
 	char *ret_str, *key, *value;
-	struct return_implies_callback *tmp;
 	int return_id;
 	int comparison;
 
@@ -1290,10 +1351,7 @@ static int db_compare_callback(void *_info, int argc, char **argv, char **azColN
 		store_return_state(db_info, ret_str, alloc_estate_rl(clone_rl(var_rl)));
 	}
 
-	FOR_EACH_PTR(db_info->callbacks, tmp) {
-		if (tmp->type == type)
-			call_db_return_callback(db_info, tmp, param, key, value);
-	} END_FOR_EACH_PTR(tmp);
+	call_db_return_callbacks(db_info, type, param, key, value);
 
 	fake_return_assignment(db_info, type, param, key, value);
 
@@ -1330,7 +1388,6 @@ static void compare_db_return_states_callbacks(struct expression *left, int comp
 	db_info.expr = call_expr;
 	db_info.rl = rl;
 	db_info.left = call_on_left;
-	db_info.callbacks = db_return_states_list;
 	db_info.var_expr = var_expr;
 
 	call_void_fns(return_states_before);
@@ -1343,6 +1400,7 @@ static void compare_db_return_states_callbacks(struct expression *left, int comp
 				 call_expr, db_compare_callback, &db_info);
 	set_other_side_state(&db_info);
 	process_return_states(&db_info);
+	merge_return_states(&db_info);
 	true_states = db_info.stree;
 	if (!true_states && db_info.has_states) {
 		__push_fake_cur_stree();
@@ -1365,6 +1423,7 @@ static void compare_db_return_states_callbacks(struct expression *left, int comp
 			db_compare_callback, &db_info);
 	set_other_side_state(&db_info);
 	process_return_states(&db_info);
+	merge_return_states(&db_info);
 	false_states = db_info.stree;
 	if (!false_states && db_info.has_states) {
 		__push_fake_cur_stree();
@@ -1455,7 +1514,7 @@ static void call_ranged_return_hooks(struct db_callback_info *db_info)
 		return;
 
 	fn_name = get_fn_name(expr->fn);
-	call_backs = get_call_backs(fn_name);
+	call_backs = get_call_backs(expr->fn, fn_name);
 	FOR_EACH_PTR(call_backs, tmp) {
 		if (tmp->type != RANGED_CALL)
 			continue;
@@ -1493,7 +1552,6 @@ static int db_assign_return_states_callback(void *_info, int argc, char **argv,
 	struct range_list *ret_range;
 	int type, param;
 	char *ret_str, *key, *value;
-	struct return_implies_callback *tmp;
 	int return_id;
 
 	if (argc != 6)
@@ -1547,10 +1605,7 @@ static int db_assign_return_states_callback(void *_info, int argc, char **argv,
 		store_return_state(db_info, ret_str, alloc_estate_rl(ret_range));
 	}
 
-	FOR_EACH_PTR(db_return_states_list, tmp) {
-		if (tmp->type == type)
-			call_db_return_callback(db_info, tmp, param, key, value);
-	} END_FOR_EACH_PTR(tmp);
+	call_db_return_callbacks(db_info, type, param, key, value);
 
 	fake_return_assignment(db_info, type, param, key, value);
 
@@ -1585,6 +1640,7 @@ static int db_return_states_assign(struct expression *expr)
 		call_ranged_return_hooks(&db_info);
 	set_return_assign_state(&db_info);
 	process_return_states(&db_info);
+	merge_return_states(&db_info);
 
 	if (!db_info.stree && db_info.cull) { /* this means we culled everything */
 		set_extra_expr_mod(expr->left, alloc_estate_whole(get_type(expr->left)));
@@ -1634,7 +1690,7 @@ static void match_assign_call(struct expression *expr)
 		return;
 
 	fn_name = get_fn_name(right->fn);
-	call_backs = get_call_backs(fn_name);
+	call_backs = get_call_backs(right->fn, fn_name);
 
 	/*
 	 * The ordering here is sort of important.
@@ -1674,7 +1730,6 @@ static int db_return_states_callback(void *_info, int argc, char **argv, char **
 	struct range_list *ret_range;
 	int type, param;
 	char *ret_str, *key, *value;
-	struct return_implies_callback *tmp;
 	int return_id;
 
 	if (argc != 6)
@@ -1727,10 +1782,7 @@ static int db_return_states_callback(void *_info, int argc, char **argv, char **
 		store_return_state(db_info, ret_str, state);
 	}
 
-	FOR_EACH_PTR(db_return_states_list, tmp) {
-		if (tmp->type == type)
-			call_db_return_callback(db_info, tmp, param, key, value);
-	} END_FOR_EACH_PTR(tmp);
+	call_db_return_callbacks(db_info, type, param, key, value);
 
 	fake_return_assignment(db_info, type, param, key, value);
 
@@ -1757,6 +1809,7 @@ static void db_return_states(struct expression *expr)
 			expr, db_return_states_callback, &db_info);
 	call_ranged_return_hooks(&db_info);
 	process_return_states(&db_info);
+	merge_return_states(&db_info);
 
 	FOR_EACH_SM(db_info.stree, sm) {
 		__set_sm(sm);
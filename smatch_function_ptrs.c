@@ -451,7 +451,9 @@ static void global_variable(struct symbol *sym)
 	}
 	if (struct_type->type != SYM_STRUCT || !struct_type->ident)
 		return;
+	sql_group_rows_start();
 	print_initializer_list(sym->initializer->expr_list, struct_type);
+	sql_group_rows_end();
 }
 
 void register_function_ptrs(int id)
@@ -26,7 +26,6 @@
 #include "smatch_extra.h"
 #include "smatch_slist.h"
 
-#define VAR_LEN 512
 
 static struct expression *strip_expr_helper(struct expression *expr, bool set_parent, bool cast, int *nest);
 
@@ -458,30 +457,36 @@ static void get_variable_from_expr(struct symbol **sym_ptr, char *buf,
  * This is returns a stylized "c looking" representation of the
  * variable name.
  *
- * It uses the same buffer every time so you have to save the result
- * yourself if you want to keep it.
+ * expr_to_str_sym() returns an allocated string which you have to free.
+ * expr_to_str_sym_buf() writes it to buf so there is nothing to free.
  *
  */
 
-char *expr_to_str_sym(struct expression *expr, struct symbol **sym_ptr)
+char *expr_to_str_sym_buf(struct expression *expr, struct symbol **sym_ptr,
+			  char *buf, int len)
 {
-	static char var_name[VAR_LEN];
 	int complicated = 0;
 
 	if (sym_ptr)
 		*sym_ptr = NULL;
-	var_name[0] = '\0';
+	buf[0] = '\0';
 
 	if (!expr)
 		return NULL;
-	get_variable_from_expr(sym_ptr, var_name, expr, sizeof(var_name),
-			       &complicated);
+	get_variable_from_expr(sym_ptr, buf, expr, len, &complicated);
 	if (complicated < 2)
-		return alloc_string(var_name);
+		return buf;
 	else
 		return NULL;
 }
 
+char *expr_to_str_sym(struct expression *expr, struct symbol **sym_ptr)
+{
+	char buf[VAR_LEN];
+
+	return alloc_string(expr_to_str_sym_buf(expr, sym_ptr, buf, sizeof(buf)));
+}
+
 char *expr_to_str(struct expression *expr)
 {
 	return expr_to_str_sym(expr, NULL);
@@ -492,28 +497,34 @@ char *expr_to_str(struct expression *expr)
  * If it's a complicated variable like a->foo[x] instead of just 'a->foo'
  * then it returns NULL.
  */
-char *expr_to_var_sym(struct expression *expr,
-				    struct symbol **sym_ptr)
+char *expr_to_var_sym_buf(struct expression *expr, struct symbol **sym_ptr,
+			  char *buf, int len)
 {
-	static char var_name[VAR_LEN];
 	int complicated = 0;
 
 	if (sym_ptr)
 		*sym_ptr = NULL;
-	var_name[0] = '\0';
+	buf[0] = '\0';
 
 	if (!expr)
 		return NULL;
 	expr = strip_expr(expr);
-	get_variable_from_expr(sym_ptr, var_name, expr, sizeof(var_name),
-			       &complicated);
+	get_variable_from_expr(sym_ptr, buf, expr, len, &complicated);
 
 	if (complicated) {
 		if (sym_ptr)
 			*sym_ptr = NULL;
 		return NULL;
 	}
-	return alloc_string(var_name);
+	return buf;
+}
+
+char *expr_to_var_sym(struct expression *expr,
+				    struct symbol **sym_ptr)
+{
+	char buf[VAR_LEN];
+
+	return alloc_string(expr_to_var_sym_buf(expr, sym_ptr, buf, sizeof(buf)));
 }
 
 char *expr_to_var(struct expression *expr)
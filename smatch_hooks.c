@@ -15,6 +15,7 @@
  * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
  */
 
+#include <time.h>
 #include "smatch.h"
 
 enum data_type {
@@ -29,6 +30,7 @@ struct hook_container {
 	int hook_type;
 	int owner;
 	void *fn;
+	unsigned long long expr_types;
 };
 ALLOCATOR(hook_container, "hook functions");
 DECLARE_PTR_LIST(hook_func_list, struct hook_container);
@@ -36,10 +38,14 @@ DECLARE_PTR_LIST(hook_func_list, struct hook_container);
 typedef void (sym_list_func)(struct symbol_list *sym_list);
 typedef void (array_init_hook)(struct expression *array, int nr);
 
-static struct hook_func_list *merge_funcs;
-static struct hook_func_list *unmatched_state_funcs;
+/* indexed by owner.  These are called for every merge. */
+static merge_func_t **merge_funcs;
+static unmatched_func_t **unmatched_state_funcs;
 static struct hook_func_list *array_init_hooks;
 static struct hook_func_list *hook_array[NUM_HOOKS] = {};
+static bool *two_pass_checks;
+static bool has_two_pass_checks;
+bool __first_pass;
 static const enum data_type data_types[NUM_HOOKS] = {
 	[EXPR_HOOK] = EXPR_PTR,
 	[EXPR_HOOK_AFTER] = EXPR_PTR,
@@ -84,16 +90,52 @@ static const enum data_type data_types[NUM_HOOKS] = {
 	[END_FILE_HOOK] = SYM_LIST_PTR,
 };
 
+/*
+ * hook_array[] is what add_hook() builds.  Before the hooks are called it
+ * is compiled into flat arrays of typed function pointers, one set for
+ * normal passes and one for the first pass of --two-passes.
+ */
+typedef void (case_func)(struct expression *switch_expr, struct range_list *rl);
+
+struct hook_entry {
+	union {
+		void *fn;
+		expr_func *expr_fn;
+		stmt_func *stmt_fn;
+		sym_func *sym_fn;
+		sym_list_func *sym_list_fn;
+		case_func *case_fn;
+	};
+	int owner;
+};
+
+struct hook_table {
+	struct hook_entry *entries;
+	int nr;
+};
+
+static struct hook_table hook_tables[2][NUM_HOOKS];
+/* EXPR_PTR hooks also get a table for each expression type */
+#define NUM_EXPR_TYPES (EXPR_GENERIC + 1)
+static struct hook_table expr_hook_tables[2][NUM_HOOKS][NUM_EXPR_TYPES];
+static bool hook_tables_built;
+
 void (**pre_merge_hooks)(struct sm_state *cur, struct sm_state *other);
 
+/*
+ * Most scopes don't have any scope hooks so __push_scope_hooks() just
+ * bumps scope_depth.  The hooks are kept in one list, with the innermost
+ * scope at the end, and each one records the depth it was added at.
+ */
 struct scope_container {
 	void *fn;
 	void *data;
+	unsigned long depth;
 };
 ALLOCATOR(scope_container, "scope hook functions");
 DECLARE_PTR_LIST(scope_hook_list, struct scope_container);
-DECLARE_PTR_LIST(scope_hook_stack, struct scope_hook_list);
-static struct scope_hook_stack *scope_hooks;
+static struct scope_hook_list *scope_hooks;
+static unsigned long scope_depth;
 int my_id;
 
 extern int __cur_check_id;
@@ -106,22 +148,37 @@ void add_hook(void *func, enum hook_type type)
 	container->fn = func;
 
 	add_ptr_list(&hook_array[type], container);
+	hook_tables_built = false;
+}
+
+/*
+ * The same as add_hook() but the hook is only called for expressions
+ * where the type is in the expr_types mask.  For example,
+ * EXPR_TYPE_BIT(EXPR_COMPARE) for a CONDITION_HOOK which only looks at
+ * comparisons.
+ */
+void add_expr_type_hook(void *func, enum hook_type type, unsigned long long expr_types)
+{
+	struct hook_container *container;
+
+	if (data_types[type] != EXPR_PTR)
+		sm_fatal("hook type %d doesn't pass expressions", type);
+
+	add_hook(func, type);
+	container = last_ptr_list((struct ptr_list *)hook_array[type]);
+	container->expr_types = expr_types;
 }
 
 void add_merge_hook(int client_id, merge_func_t *func)
 {
-	struct hook_container *container = __alloc_hook_container(0);
-	container->owner = client_id;
-	container->fn = func;
-	add_ptr_list(&merge_funcs, container);
+	if (!merge_funcs[client_id])
+		merge_funcs[client_id] = func;
 }
 
 void add_unmatched_state_hook(int client_id, unmatched_func_t *func)
 {
-	struct hook_container *container = __alloc_hook_container(0);
-	container->owner = client_id;
-	container->fn = func;
-	add_ptr_list(&unmatched_state_funcs, container);
+	if (!unmatched_state_funcs[client_id])
+		unmatched_state_funcs[client_id] = func;
 }
 
 void add_pre_merge_hook(int client_id, void (*hook)(struct sm_state *cur, struct sm_state *other))
@@ -129,82 +186,272 @@ void add_pre_merge_hook(int client_id, void (*hook)(struct sm_state *cur, struct
 	pre_merge_hooks[client_id] = hook;
 }
 
-static void pass_expr_to_client(void *fn, void *data)
+/*
+ * With --two-passes the first pass is only there to collect data for the
+ * checks which asked for it with add_two_pass_check().  The other check_*
+ * hooks are left out of it.  Everything else is the core of Smatch and the
+ * two pass checks depend on it, so it always runs.
+ */
+void add_two_pass_check(int owner)
 {
-	((expr_func *)fn)((struct expression *)data);
+	two_pass_checks[owner] = true;
+	has_two_pass_checks = true;
 }
 
-static void pass_stmt_to_client(void *fn, void *data)
+bool __has_two_pass_checks(void)
 {
-	((stmt_func *)fn)((struct statement *)data);
+	return has_two_pass_checks;
 }
 
-static void pass_sym_to_client(void *fn, void *data)
+static bool skip_in_first_pass(int owner)
 {
-	((sym_func *)fn)((struct symbol *)data);
+	if (owner <= 0 || owner >= num_checks)
+		return false;
+	if (two_pass_checks[owner])
+		return false;
+	return strncmp(check_name(owner), "check_", 6) == 0;
 }
 
-static void pass_sym_list_to_client(void *fn, void *data)
+static void build_hook_table(struct hook_table *table, struct hook_func_list *list,
+			     bool first_pass, int expr_type)
 {
-	((sym_list_func *)fn)((struct symbol_list *)data);
+	struct hook_container *container;
+
+	/*
+	 * Don't free the old array.  add_hook() could be called from inside
+	 * a hook and then the caller is still looping over it.
+	 */
+	table->entries = malloc((ptr_list_size((struct ptr_list *)list) + 1) * sizeof(*table->entries));
+	table->nr = 0;
+
+	FOR_EACH_PTR(list, container) {
+		if (first_pass && skip_in_first_pass(container->owner))
+			continue;
+		if (container->expr_types &&
+		    !(container->expr_types & EXPR_TYPE_BIT(expr_type)))
+			continue;
+		table->entries[table->nr].fn = container->fn;
+		table->entries[table->nr].owner = container->owner;
+		table->nr++;
+	} END_FOR_EACH_PTR(container);
 }
 
-void __pass_to_client(void *data, enum hook_type type)
+static void build_hook_tables(void)
 {
-	struct hook_container *container;
+	int type, expr_type;
+
+	for (type = 0; type < NUM_HOOKS; type++) {
+		build_hook_table(&hook_tables[0][type], hook_array[type], false, 0);
+		build_hook_table(&hook_tables[1][type], hook_array[type], true, 0);
+		if (data_types[type] != EXPR_PTR)
+			continue;
+		for (expr_type = 1; expr_type < NUM_EXPR_TYPES; expr_type++) {
+			build_hook_table(&expr_hook_tables[0][type][expr_type],
+					 hook_array[type], false, expr_type);
+			build_hook_table(&expr_hook_tables[1][type][expr_type],
+					 hook_array[type], true, expr_type);
+		}
+	}
+	hook_tables_built = true;
+}
 
-	if (__debug_skip)
+static struct hook_table *get_hook_table(enum hook_type type, void *data)
+{
+	struct expression *expr = data;
+
+	if (!hook_tables_built)
+		build_hook_tables();
+	if (data_types[type] == EXPR_PTR && expr &&
+	    expr->type > 0 && expr->type < NUM_EXPR_TYPES)
+		return &expr_hook_tables[__first_pass][type][expr->type];
+	return &hook_tables[__first_pass][type];
+}
+
+/*
+ * --hook-profile counts the calls and the cycles spent in each check's
+ * hooks.  The totals are written out at exit.  --time-stmt uses the same
+ * timing to say which checks were slow in each statement.
+ */
+struct hook_profile {
+	unsigned long long calls;
+	unsigned long long cycles;
+};
+static struct hook_profile *hook_profile;
+
+unsigned long long __hook_profile_start(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+void __hook_profile_stop(int owner, unsigned long long start)
+{
+	unsigned long long now = __hook_profile_start();
+
+	if (owner < 0 || owner >= num_checks)
+		owner = num_checks;
+	if (option_time_stmt)
+		stmt_profile_hook(owner, now - start);
+	if (!option_hook_profile)
+		return;
+	if (!hook_profile)
+		hook_profile = calloc(num_checks + 1, sizeof(*hook_profile));
+	hook_profile[owner].calls++;
+	hook_profile[owner].cycles += now - start;
+}
+
+static int cmp_hook_profile(const void *a, const void *b)
+{
+	const struct hook_profile *one = &hook_profile[*(const int *)a];
+	const struct hook_profile *two = &hook_profile[*(const int *)b];
+
+	if (one->cycles > two->cycles)
+		return -1;
+	if (one->cycles < two->cycles)
+		return 1;
+	return 0;
+}
+
+void print_hook_profile(void)
+{
+	FILE *fd;
+	int *order;
+	int i;
+
+	if (!hook_profile)
+		return;
+
+	fd = fopen(option_hook_profile, "a");
+	if (!fd) {
+		sm_ierror("cannot open '%s': %m", option_hook_profile);
 		return;
+	}
+
+	order = malloc((num_checks + 1) * sizeof(*order));
+	for (i = 0; i <= num_checks; i++)
+		order[i] = i;
+	qsort(order, num_checks + 1, sizeof(*order), cmp_hook_profile);
+
+	fprintf(fd, "check\tcalls\tcycles\n");
+	for (i = 0; i <= num_checks; i++) {
+		if (!hook_profile[order[i]].calls)
+			continue;
+		fprintf(fd, "%s\t%llu\t%llu\n", check_name(order[i]),
+			hook_profile[order[i]].calls,
+			hook_profile[order[i]].cycles);
+	}
+	fclose(fd);
+	free(order);
+	free(hook_profile);
+	hook_profile = NULL;
+}
 
-	FOR_EACH_PTR(hook_array[type], container) {
+static void pass_to_client_profiled(struct hook_table *table, void *data, enum hook_type type)
+{
+	struct hook_entry *entry;
+	unsigned long long start;
+	int i;
+
+	for (i = 0; i < table->nr; i++) {
+		entry = &table->entries[i];
+		start = __hook_profile_start();
 		switch (data_types[type]) {
 		case EXPR_PTR:
-			pass_expr_to_client(container->fn, data);
+			entry->expr_fn(data);
 			break;
 		case STMT_PTR:
-			pass_stmt_to_client(container->fn, data);
+			entry->stmt_fn(data);
 			break;
 		case SYMBOL_PTR:
-			pass_sym_to_client(container->fn, data);
+			entry->sym_fn(data);
 			break;
 		case SYM_LIST_PTR:
-			pass_sym_list_to_client(container->fn, data);
+			entry->sym_list_fn(data);
 			break;
 		default:
 			sm_warning("internal error. Unhandled hook type: %d", type);
 		}
-	} END_FOR_EACH_PTR(container);
+		__hook_profile_stop(entry->owner, start);
+	}
+}
+
+void __pass_to_client(void *data, enum hook_type type)
+{
+	struct hook_table *table;
+	int i;
+
+	if (__debug_skip)
+		return;
+
+	table = get_hook_table(type, data);
+	if (!table->nr)
+		return;
+
+	if (hook_profiling()) {
+		pass_to_client_profiled(table, data, type);
+		return;
+	}
+
+	switch (data_types[type]) {
+	case EXPR_PTR:
+		for (i = 0; i < table->nr; i++)
+			table->entries[i].expr_fn(data);
+		break;
+	case STMT_PTR:
+		for (i = 0; i < table->nr; i++)
+			table->entries[i].stmt_fn(data);
+		break;
+	case SYMBOL_PTR:
+		for (i = 0; i < table->nr; i++)
+			table->entries[i].sym_fn(data);
+		break;
+	case SYM_LIST_PTR:
+		for (i = 0; i < table->nr; i++)
+			table->entries[i].sym_list_fn(data);
+		break;
+	default:
+		sm_warning("internal error. Unhandled hook type: %d", type);
+	}
 }
 
 void __pass_case_to_client(struct expression *switch_expr,
 			   struct range_list *rl)
 {
-	typedef void (case_func)(struct expression *switch_expr,
-				 struct range_list *rl);
-	struct hook_container *container;
-
-	FOR_EACH_PTR(hook_array[CASE_HOOK], container) {
-		((case_func *)container->fn)(switch_expr, rl);
-	} END_FOR_EACH_PTR(container);
+	struct hook_table *table = get_hook_table(CASE_HOOK, NULL);
+	unsigned long long start = 0;
+	int i;
+
+	for (i = 0; i < table->nr; i++) {
+		if (hook_profiling())
+			start = __hook_profile_start();
+		table->entries[i].case_fn(switch_expr, rl);
+		if (hook_profiling())
+			__hook_profile_stop(table->entries[i].owner, start);
+	}
 }
 
 int __has_merge_function(int client_id)
 {
-	struct hook_container *tmp;
-
-	FOR_EACH_PTR(merge_funcs, tmp) {
-		if (tmp->owner == client_id)
-			return 1;
-	} END_FOR_EACH_PTR(tmp);
-	return 0;
+	if (client_id < 0 || client_id >= num_checks)
+		return 0;
+	return !!merge_funcs[client_id];
 }
 
 struct smatch_state *__client_merge_function(int owner,
 					     struct smatch_state *s1,
 					     struct smatch_state *s2)
 {
-	struct smatch_state *tmp_state;
-	struct hook_container *tmp;
+	struct smatch_state *tmp_state, *ret;
+	unsigned long long start;
+
+	if (!__has_merge_function(owner))
+		return &undefined;
 
 	/* Pass NULL states first and the rest alphabetically by name */
 	if (!s2 || (s1 && strcmp(s2->name, s1->name) < 0)) {
@@ -213,22 +460,20 @@ struct smatch_state *__client_merge_function(int owner,
 		s2 = tmp_state;
 	}
 
-	FOR_EACH_PTR(merge_funcs, tmp) {
-		if (tmp->owner == owner)
-			return ((merge_func_t *)tmp->fn)(s1, s2);
-	} END_FOR_EACH_PTR(tmp);
-	return &undefined;
+	if (!hook_profiling())
+		return merge_funcs[owner](s1, s2);
+
+	start = __hook_profile_start();
+	ret = merge_funcs[owner](s1, s2);
+	__hook_profile_stop(owner, start);
+	return ret;
 }
 
 struct smatch_state *__client_unmatched_state_function(struct sm_state *sm)
 {
-	struct hook_container *tmp;
-
-	FOR_EACH_PTR(unmatched_state_funcs, tmp) {
-		if (tmp->owner == sm->owner)
-			return ((unmatched_func_t *)tmp->fn)(sm);
-	} END_FOR_EACH_PTR(tmp);
-	return &undefined;
+	if (sm->owner >= num_checks || !unmatched_state_funcs[sm->owner])
+		return &undefined;
+	return unmatched_state_funcs[sm->owner](sm);
 }
 
 void call_pre_merge_hook(struct sm_state *cur, struct sm_state *other)
@@ -240,36 +485,36 @@ void call_pre_merge_hook(struct sm_state *cur, struct sm_state *other)
 		pre_merge_hooks[cur->owner](cur, other);
 }
 
-static struct scope_hook_list *pop_scope_hook_list(struct scope_hook_stack **stack)
-{
-	struct scope_hook_list *hook_list;
-
-	hook_list = last_ptr_list((struct ptr_list *)*stack);
-	delete_ptr_list_last((struct ptr_list **)stack);
-	return hook_list;
-}
-
-static void push_scope_hook_list(struct scope_hook_stack **stack, struct scope_hook_list *list)
-{
-	add_ptr_list(stack, list);
-}
-
 void add_scope_hook(scope_hook *fn, void *data)
 {
-	struct scope_hook_list *hook_list;
 	struct scope_container *new;
 
-	hook_list = pop_scope_hook_list(&scope_hooks);
 	new = __alloc_scope_container(0);
 	new->fn = fn;
 	new->data = data;
-	add_ptr_list(&hook_list, new);
-	push_scope_hook_list(&scope_hooks, hook_list);
+	new->depth = scope_depth;
+	add_ptr_list(&scope_hooks, new);
 }
 
 void __push_scope_hooks(void)
 {
-	push_scope_hook_list(&scope_hooks, NULL);
+	scope_depth++;
+}
+
+static struct scope_hook_list *pop_scope_hooks(void)
+{
+	struct scope_hook_list *hook_list = NULL;
+	struct scope_container *tmp;
+
+	while ((tmp = last_ptr_list((struct ptr_list *)scope_hooks)) &&
+	       tmp->depth >= scope_depth) {
+		delete_ptr_list_last((struct ptr_list **)&scope_hooks);
+		add_ptr_list(&hook_list, tmp);
+	}
+	if (scope_depth)
+		scope_depth--;
+
+	return hook_list;
 }
 
 void __call_scope_hooks(void)
@@ -277,11 +522,19 @@ void __call_scope_hooks(void)
 	struct scope_hook_list *hook_list;
 	struct scope_container *tmp;
 
-	hook_list = pop_scope_hook_list(&scope_hooks);
-	FOR_EACH_PTR_REVERSE(hook_list, tmp) {
+	if (!scope_hooks) {
+		if (scope_depth)
+			scope_depth--;
+		return;
+	}
+
+	/* pop_scope_hooks() returns them in reverse order already */
+	hook_list = pop_scope_hooks();
+	FOR_EACH_PTR(hook_list, tmp) {
 		((scope_hook *)tmp->fn)(tmp->data);
 		__free_scope_container(tmp);
-	} END_FOR_EACH_PTR_REVERSE(tmp);
+	} END_FOR_EACH_PTR(tmp);
+	free_ptr_list(&hook_list);
 }
 
 void __free_scope_hooks(void)
@@ -289,22 +542,20 @@ void __free_scope_hooks(void)
 	struct scope_hook_list *hook_list;
 	struct scope_container *tmp;
 
-	hook_list = pop_scope_hook_list(&scope_hooks);
-	FOR_EACH_PTR_REVERSE(hook_list, tmp) {
+	hook_list = pop_scope_hooks();
+	FOR_EACH_PTR(hook_list, tmp) {
 		__free_scope_container(tmp);
-	} END_FOR_EACH_PTR_REVERSE(tmp);
+	} END_FOR_EACH_PTR(tmp);
+	free_ptr_list(&hook_list);
 }
 
 void __call_all_scope_hooks(void)
 {
-	struct scope_hook_list *tmp_scope;
 	struct scope_container *tmp;
 
-	FOR_EACH_PTR_REVERSE(scope_hooks, tmp_scope) {
-		FOR_EACH_PTR_REVERSE(tmp_scope, tmp) {
-			((scope_hook *)tmp->fn)(tmp->data);
-		} END_FOR_EACH_PTR_REVERSE(tmp);
-	} END_FOR_EACH_PTR_REVERSE(tmp_scope);
+	FOR_EACH_PTR_REVERSE(scope_hooks, tmp) {
+		((scope_hook *)tmp->fn)(tmp->data);
+	} END_FOR_EACH_PTR_REVERSE(tmp);
 }
 
 void add_array_initialized_hook(void (*hook)(struct expression *array, int nr))
@@ -329,11 +580,15 @@ void allocate_hook_memory(void)
 {
 	pre_merge_hooks = malloc(num_checks * sizeof(*pre_merge_hooks));
 	memset(pre_merge_hooks, 0, num_checks * sizeof(*pre_merge_hooks));
+	two_pass_checks = calloc(num_checks, sizeof(*two_pass_checks));
+	merge_funcs = calloc(num_checks, sizeof(*merge_funcs));
+	unmatched_state_funcs = calloc(num_checks, sizeof(*unmatched_state_funcs));
 }
 
 void register_hooks(int id)
 {
 	add_function_data((unsigned long *)&scope_hooks);
+	add_function_data(&scope_depth);
 	my_id = id;
 }
 
@@ -16,54 +16,130 @@
  */
 
 #include "smatch.h"
-#include "smatch_slist.h"
 
-STATE(ignore);
-static struct stree *ignored;
-static struct stree *ignored_from_file;
+/*
+ * The ignore lists are checked a lot more often than anything is added to
+ * them and they are nearly always empty.  Keep them in small hash tables
+ * keyed on the owner, the symbol and the name so a lookup is a few pointer
+ * compares and doesn't have to allocate the name first.
+ */
+struct ignore {
+	int owner;
+	struct symbol *sym;
+	unsigned long long hash;
+	struct ignore *next;
+	char name[];
+};
+
+#define IGNORE_HASH_SIZE 64
+struct ignore_table {
+	struct ignore *buckets[IGNORE_HASH_SIZE];
+	int count;
+};
+
+static struct ignore_table ignored;
+static struct ignore_table ignored_from_file;
+
+static unsigned long long ignore_hash(int owner, const char *name, struct symbol *sym)
+{
+	return str_to_llu_hash(name) ^ ((unsigned long long)(unsigned long)sym >> 4) ^ owner;
+}
+
+static bool table_has(struct ignore_table *table, int owner, const char *name, struct symbol *sym)
+{
+	struct ignore *tmp;
+	unsigned long long hash;
+
+	if (!table->count || !name)
+		return false;
+
+	hash = ignore_hash(owner, name, sym);
+	for (tmp = table->buckets[hash % IGNORE_HASH_SIZE]; tmp; tmp = tmp->next) {
+		if (tmp->hash == hash && tmp->owner == owner && tmp->sym == sym &&
+		    strcmp(tmp->name, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+static void table_add(struct ignore_table *table, int owner, const char *name, struct symbol *sym)
+{
+	struct ignore *new;
+	unsigned long long hash;
+
+	if (table_has(table, owner, name, sym))
+		return;
+
+	hash = ignore_hash(owner, name, sym);
+	new = malloc(sizeof(*new) + strlen(name) + 1);
+	new->owner = owner;
+	new->sym = sym;
+	new->hash = hash;
+	strcpy(new->name, name);
+	new->next = table->buckets[hash % IGNORE_HASH_SIZE];
+	table->buckets[hash % IGNORE_HASH_SIZE] = new;
+	table->count++;
+}
+
+static void table_clear(struct ignore_table *table)
+{
+	struct ignore *tmp, *next;
+	int i;
+
+	if (!table->count)
+		return;
+
+	for (i = 0; i < IGNORE_HASH_SIZE; i++) {
+		for (tmp = table->buckets[i]; tmp; tmp = next) {
+			next = tmp->next;
+			free(tmp);
+		}
+		table->buckets[i] = NULL;
+	}
+	table->count = 0;
+}
 
 void add_ignore(int owner, const char *name, struct symbol *sym)
 {
-	set_state_stree(&ignored, owner, name, sym, &ignore);
+	table_add(&ignored, owner, name, sym);
 }
 
 int is_ignored(int owner, const char *name, struct symbol *sym)
 {
-	return !!get_state_stree(ignored, owner, name, sym);
+	return table_has(&ignored, owner, name, sym);
 }
 
 void add_ignore_expr(int owner, struct expression *expr)
 {
 	struct symbol *sym;
+	char buf[VAR_LEN];
 	char *name;
 
-	name = expr_to_str_sym(expr, &sym);
+	name = expr_to_str_sym_buf(expr, &sym, buf, sizeof(buf));
 	if (!name || !sym)
 		return;
 	add_ignore(owner, name, sym);
-	free_string(name);
 }
 
 int is_ignored_expr(int owner, struct expression *expr)
 {
 	struct symbol *sym;
+	char buf[VAR_LEN];
 	char *name;
-	int ret;
 
-	name = expr_to_str_sym(expr, &sym);
+	if (!ignored.count && !ignored_from_file.count)
+		return false;
+
+	name = expr_to_str_sym_buf(expr, &sym, buf, sizeof(buf));
 	if (!name && !sym)
 		return 0;
-	ret = is_ignored(owner, name, sym);
-	free_string(name);
-	if (ret)
+	if (is_ignored(owner, name, sym))
 		return true;
 
-	name = get_macro_name(expr->pos);
-	if (name && get_state_stree(ignored_from_file, owner, name, NULL))
+	if (table_has(&ignored_from_file, owner, get_macro_name(expr->pos), NULL))
 		return true;
 
-	name = get_function();
-	if (name && get_state_stree(ignored_from_file, owner, name, NULL))
+	if (table_has(&ignored_from_file, owner, get_function(), NULL))
 		return true;
 
 	return false;
@@ -73,7 +149,7 @@ static void clear_ignores(void)
 {
 	if (__inline_fn)
 		return;
-	free_stree(&ignored);
+	table_clear(&ignored);
 }
 
 static void load_ignores(void)
@@ -102,7 +178,7 @@ static void load_ignores(void)
 		str = show_ident(token->ident);
 		token = token->next;
 
-		set_state_stree_perm(&ignored_from_file, owner, str, NULL, &ignore);
+		table_add(&ignored_from_file, owner, str, NULL);
 	}
 	clear_token_alloc();
 }
@@ -193,10 +193,10 @@ static int create_fake_history(struct sm_state *sm, int comparison, struct range
 	false_sm = clone_sm(sm);
 
 	true_sm->state = clone_partial_estate(sm->state, true_rl);
-	free_slist(&true_sm->possible);
+	clear_possibles(true_sm);
 	add_possible_sm(true_sm, true_sm);
 	false_sm->state = clone_partial_estate(sm->state, false_rl);
-	free_slist(&false_sm->possible);
+	clear_possibles(false_sm);
 	add_possible_sm(false_sm, false_sm);
 
 	true_stree = clone_stree(sm->pool);
@@ -224,6 +224,7 @@ void add_pool(struct state_list **pools, struct sm_state *new)
 {
 	struct sm_state *tmp;
 
+	touch_pool(new->pool);
 	FOR_EACH_PTR(*pools, tmp) {
 		if (tmp->pool < new->pool)
 			continue;
@@ -335,15 +336,79 @@ static void do_compare(struct sm_state *sm, int comparison, struct range_list *r
 		add_pool(maybe_stack, sm);
 }
 
-static int is_checked(struct state_list *checked, struct sm_state *sm)
+/*
+ * The merge history is a DAG and the same sm_state can be reached many times.
+ * The visited set is a pointer hash where a slot is only in use if it has
+ * the current generation, so starting a new walk doesn't need a memset.
+ */
+struct visited_slot {
+	struct sm_state *sm;
+	unsigned int gen;
+};
+
+static struct visited_slot *visited;
+static unsigned int visited_size, visited_count, visited_gen;
+
+static unsigned int hash_sm(struct sm_state *sm)
 {
-	struct sm_state *tmp;
+	unsigned long p = (unsigned long)sm;
 
-	FOR_EACH_PTR(checked, tmp) {
-		if (tmp == sm)
-			return 1;
-	} END_FOR_EACH_PTR(tmp);
-	return 0;
+	return (p >> 4) ^ (p >> 16);
+}
+
+static void start_visited(void)
+{
+	visited_count = 0;
+	if (++visited_gen == 0) {
+		/* wrapped, clear the old generations */
+		memset(visited, 0, visited_size * sizeof(*visited));
+		visited_gen = 1;
+	}
+}
+
+static void insert_visited(struct sm_state *sm)
+{
+	unsigned int h = hash_sm(sm) & (visited_size - 1);
+
+	while (visited[h].gen == visited_gen)
+		h = (h + 1) & (visited_size - 1);
+	visited[h].sm = sm;
+	visited[h].gen = visited_gen;
+}
+
+static void grow_visited(void)
+{
+	struct visited_slot *old = visited;
+	unsigned int old_size = visited_size;
+	unsigned int i;
+
+	visited_size = old_size ? old_size * 2 : 1024;
+	visited = calloc(visited_size, sizeof(*visited));
+	for (i = 0; i < old_size; i++) {
+		if (old[i].gen == visited_gen)
+			insert_visited(old[i].sm);
+	}
+	free(old);
+}
+
+/* returns true if "sm" was already visited and marks it otherwise */
+static bool test_and_set_visited(struct sm_state *sm)
+{
+	unsigned int h;
+
+	if ((visited_count + 1) * 2 > visited_size)
+		grow_visited();
+
+	h = hash_sm(sm) & (visited_size - 1);
+	while (visited[h].gen == visited_gen) {
+		if (visited[h].sm == sm)
+			return true;
+		h = (h + 1) & (visited_size - 1);
+	}
+	visited[h].sm = sm;
+	visited[h].gen = visited_gen;
+	visited_count++;
+	return false;
 }
 
 /*
@@ -351,54 +416,64 @@ static int is_checked(struct state_list *checked, struct sm_state *sm)
  * Example code:  if (foo == 99) {
  *
  * Say 'foo' is a merged state that has many possible values.  It is the combination
- * of merges.  separate_pools() iterates through the pools recursively and calls
- * do_compare() for each time 'foo' was set.
+ * of merges.  separate_pools() walks the merge history (pre-order, left before
+ * right, each sm_state once) and calls do_compare() for each time 'foo' was
+ * set.  It uses an explicit stack because the histories can be very deep.
  */
-static void __separate_pools(struct sm_state *sm, int comparison, struct range_list *rl,
+static void __separate_pools(struct sm_state *gate_sm, int comparison, struct range_list *rl,
 			struct state_list **true_stack,
 			struct state_list **maybe_stack,
 			struct state_list **false_stack,
-			struct state_list **checked, int *mixed, struct sm_state *gate_sm,
-			struct timeval *start_time)
+			int *mixed, struct timeval *start_time)
 {
-	int free_checked = 0;
-	struct state_list *checked_states = NULL;
+	static struct sm_state **stack;
+	static int stack_size;
 	struct timeval now, diff;
+	struct sm_state *sm;
+	int top = 0;
 
-	if (!sm)
-		return;
+	start_visited();
 
-	gettimeofday(&now, NULL);
-	timersub(&now, start_time, &diff);
-	if (diff.tv_sec >= 1) {
-		if (full_debug) {
-			sm_msg("debug: %s: implications taking too long.  (%s %s %s)",
-			       __func__, sm->state->name, show_comparison(comparison), show_rl(rl));
-		}
-		if (mixed)
-			*mixed = 1;
+	if (!stack_size) {
+		stack_size = 256;
+		stack = malloc(stack_size * sizeof(*stack));
 	}
+	stack[top++] = gate_sm;
 
-	if (checked == NULL) {
-		checked = &checked_states;
-		free_checked = 1;
-	}
-	if (is_checked(*checked, sm))
-		return;
-	add_ptr_list(checked, sm);
+	while (top) {
+		sm = stack[--top];
+		if (!sm)
+			continue;
 
-	do_compare(sm, comparison, rl, true_stack, maybe_stack, false_stack, mixed, gate_sm);
+		gettimeofday(&now, NULL);
+		timersub(&now, start_time, &diff);
+		if (diff.tv_sec >= 1) {
+			if (full_debug) {
+				sm_msg("debug: %s: implications taking too long.  (%s %s %s)",
+				       __func__, sm->state->name, show_comparison(comparison), show_rl(rl));
+			}
+			if (mixed)
+				*mixed = 1;
+		}
+
+		if (test_and_set_visited(sm))
+			continue;
 
-	__separate_pools(sm->left, comparison, rl, true_stack, maybe_stack, false_stack, checked, mixed, gate_sm, start_time);
-	__separate_pools(sm->right, comparison, rl, true_stack, maybe_stack, false_stack, checked, mixed, gate_sm, start_time);
-	if (free_checked)
-		free_slist(checked);
+		do_compare(sm, comparison, rl, true_stack, maybe_stack, false_stack, mixed, gate_sm);
+
+		if (top + 2 > stack_size) {
+			stack_size *= 2;
+			stack = realloc(stack, stack_size * sizeof(*stack));
+		}
+		stack[top++] = sm->right;
+		stack[top++] = sm->left;
+	}
 }
 
 static void separate_pools(struct sm_state *sm, int comparison, struct range_list *rl,
 			struct state_list **true_stack,
 			struct state_list **false_stack,
-			struct state_list **checked, int *mixed)
+			int *mixed)
 {
 	struct state_list *maybe_stack = NULL;
 	struct sm_state *tmp;
@@ -406,7 +481,7 @@ static void separate_pools(struct sm_state *sm, int comparison, struct range_lis
 
 
 	gettimeofday(&start_time, NULL);
-	__separate_pools(sm, comparison, rl, true_stack, &maybe_stack, false_stack, checked, mixed, sm, &start_time);
+	__separate_pools(sm, comparison, rl, true_stack, &maybe_stack, false_stack, mixed, &start_time);
 
 	if (full_debug) {
 		struct sm_state *sm;
@@ -457,18 +532,24 @@ static int going_too_slow(void)
 {
 	static void *printed;
 
+	if (__degraded_pass) {
+		implications_off = true;
+		return 1;
+	}
+
 	if (out_of_memory()) {
 		implications_off = true;
 		return 1;
 	}
 
-	if (time_parsing_function() < 60) {
+	if (time_parsing_function() < func_budget_ms() / 5) {
 		implications_off = false;
 		return 0;
 	}
 
 	if (!__inline_fn && printed != cur_func_sym) {
-		sm_perror("turning off implications after 60 seconds");
+		sm_perror("turning off implications after %d seconds",
+			  func_budget_ms() / 5000);
 		printed = cur_func_sym;
 	}
 	implications_off = true;
@@ -635,6 +716,85 @@ static struct stree *filter_stack(struct sm_state *gate_sm,
 	return ret;
 }
 
+/*
+ * The same gate is sometimes split several times in one statement, for
+ * example when the return states assume() the same condition more than once.
+ * Remember the last few splits.  An entry holds a reference to the stree it
+ * was filtered against and only matches if the states are still the same,
+ * which is the case when the stree still has the same root.
+ */
+#define SPLIT_CACHE_SIZE 8
+
+struct split_cache {
+	struct sm_state *sm;
+	int comparison;
+	struct range_list *rl;
+	struct stree *pre_stree;
+	struct stree *true_states;
+	struct stree *false_states;
+	int mixed;
+};
+
+static struct split_cache split_cache[SPLIT_CACHE_SIZE];
+static int split_cache_next;
+
+static void clear_split_cache(void)
+{
+	struct split_cache *entry;
+	int i;
+
+	for (i = 0; i < SPLIT_CACHE_SIZE; i++) {
+		entry = &split_cache[i];
+		if (!entry->sm)
+			continue;
+		free_stree(&entry->pre_stree);
+		free_stree(&entry->true_states);
+		free_stree(&entry->false_states);
+		entry->sm = NULL;
+	}
+	split_cache_next = 0;
+}
+
+static struct split_cache *find_split(struct sm_state *sm, int comparison,
+				      struct range_list *rl, struct stree *pre_stree)
+{
+	struct split_cache *entry;
+	int i;
+
+	for (i = 0; i < SPLIT_CACHE_SIZE; i++) {
+		entry = &split_cache[i];
+		if (entry->sm == sm &&
+		    entry->comparison == comparison &&
+		    entry->pre_stree->root == pre_stree->root &&
+		    rl_equiv(entry->rl, rl))
+			return entry;
+	}
+	return NULL;
+}
+
+static void save_split(struct sm_state *sm, int comparison, struct range_list *rl,
+		       struct stree *pre_stree, struct stree *true_states,
+		       struct stree *false_states, int mixed)
+{
+	struct split_cache *entry;
+
+	entry = &split_cache[split_cache_next];
+	split_cache_next = (split_cache_next + 1) % SPLIT_CACHE_SIZE;
+
+	if (entry->sm) {
+		free_stree(&entry->pre_stree);
+		free_stree(&entry->true_states);
+		free_stree(&entry->false_states);
+	}
+	entry->sm = sm;
+	entry->comparison = comparison;
+	entry->rl = rl;
+	entry->pre_stree = clone_stree(pre_stree);
+	entry->true_states = clone_stree(true_states);
+	entry->false_states = clone_stree(false_states);
+	entry->mixed = mixed;
+}
+
 static void separate_and_filter(struct sm_state *sm, int comparison, struct range_list *rl,
 		struct stree *pre_stree,
 		struct stree **true_states,
@@ -643,6 +803,7 @@ static void separate_and_filter(struct sm_state *sm, int comparison, struct rang
 {
 	struct state_list *true_stack = NULL;
 	struct state_list *false_stack = NULL;
+	struct split_cache *cached;
 	struct timeval time_before;
 	struct timeval time_after;
 	int sec;
@@ -657,7 +818,22 @@ static void separate_and_filter(struct sm_state *sm, int comparison, struct rang
 		return;
 	}
 
-	separate_pools(sm, comparison, rl, &true_stack, &false_stack, NULL, mixed);
+	/*
+	 * Without "mixed" separate_pools() doesn't create fake histories so
+	 * those splits are not the same and they are not cached.
+	 */
+	if (mixed && pre_stree) {
+		cached = find_split(sm, comparison, rl, pre_stree);
+		if (cached) {
+			DIMPLIED("using the cached split.\n");
+			*true_states = clone_stree(cached->true_states);
+			*false_states = clone_stree(cached->false_states);
+			*mixed = cached->mixed;
+			return;
+		}
+	}
+
+	separate_pools(sm, comparison, rl, &true_stack, &false_stack, mixed);
 
 	if (full_debug) {
 		struct sm_state *sm;
@@ -678,6 +854,9 @@ static void separate_and_filter(struct sm_state *sm, int comparison, struct rang
 	free_slist(&true_stack);
 	free_slist(&false_stack);
 
+	if (mixed && pre_stree && !going_too_slow())
+		save_split(sm, comparison, rl, pre_stree, *true_states, *false_states, *mixed);
+
 	gettimeofday(&time_after, NULL);
 	sec = time_after.tv_sec - time_before.tv_sec;
 	if (sec > 20)
@@ -894,17 +1073,15 @@ static void separate_implication_states(struct stree **implied_true,
 	struct sm_state *sm;
 
 	/* We process these states later to preserve the implications. */
-	FOR_EACH_SM(*implied_true, sm) {
-		if (sm->owner == owner)
-			overwrite_sm_state_stree(&extra_saved_implied_true, sm);
+	FOR_EACH_MY_SM(owner, *implied_true, sm) {
+		overwrite_sm_state_stree(&extra_saved_implied_true, sm);
 	} END_FOR_EACH_SM(sm);
 	FOR_EACH_SM(extra_saved_implied_true, sm) {
 		delete_state_stree(implied_true, sm->owner, sm->name, sm->sym);
 	} END_FOR_EACH_SM(sm);
 
-	FOR_EACH_SM(*implied_false, sm) {
-		if (sm->owner == owner)
-			overwrite_sm_state_stree(&extra_saved_implied_false, sm);
+	FOR_EACH_MY_SM(owner, *implied_false, sm) {
+		overwrite_sm_state_stree(&extra_saved_implied_false, sm);
 	} END_FOR_EACH_SM(sm);
 	FOR_EACH_SM(extra_saved_implied_false, sm) {
 		delete_state_stree(implied_false, sm->owner, sm->name, sm->sym);
@@ -955,7 +1132,7 @@ filter:
 
 static void save_implications_hook(struct expression *expr)
 {
-	if (going_too_slow())
+	if (option_fast || going_too_slow())
 		return;
 	get_tf_states(expr, &saved_implied_true, &saved_implied_false);
 }
@@ -1015,7 +1192,7 @@ void param_limit_implications(struct expression *expr, int param, char *key, cha
 	struct symbol *left_sym = NULL;
 	int mixed = 0;
 
-	if (time_parsing_function() > 40)
+	if (option_fast || time_parsing_function() > func_budget_ms() * 2 / 15)
 		return;
 
 	orig_expr = expr;
@@ -1086,7 +1263,6 @@ free:
 
 struct stree *__implied_case_stree(struct expression *switch_expr,
 				   struct range_list *rl,
-				   struct range_list_stack **remaining_cases,
 				   struct stree **raw_stree)
 {
 	char *name;
@@ -1100,12 +1276,7 @@ struct stree *__implied_case_stree(struct expression *switch_expr,
 
 	name = expr_to_chunk_sym_vsl(switch_expr, &sym, &vsl);
 
-	if (rl)
-		filter_top_rl(remaining_cases, rl);
-	else
-		rl = clone_rl(top_rl(*remaining_cases));
-
-	if (name) {
+	if (name && !option_fast) {
 		sm = get_sm_state_stree(*raw_stree, SMATCH_EXTRA, name, sym);
 		if (sm)
 			separate_and_filter(sm, SPECIAL_EQUAL, rl, *raw_stree, &true_states, &false_states, NULL);
@@ -1127,8 +1298,14 @@ struct stree *__implied_case_stree(struct expression *switch_expr,
 	return ret;
 }
 
+static void match_stmt(struct statement *stmt)
+{
+	clear_split_cache();
+}
+
 static void match_end_func(struct symbol *sym)
 {
+	clear_split_cache();
 	if (__inline_fn)
 		return;
 	implied_debug_msg = NULL;
@@ -1257,5 +1434,6 @@ void register_implications(int id)
 	add_hook(&__comparison_match_condition, CONDITION_HOOK);
 	add_hook(&set_extra_implied_states, CONDITION_HOOK);
 	add_hook(&__stored_condition, CONDITION_HOOK);
+	add_hook(&match_stmt, STMT_HOOK);
 	add_hook(&match_end_func, END_FUNC_HOOK);
 }
@@ -0,0 +1,434 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * With "smatch --info --info-shard=<dir>" the SQL lines are not printed.
+ * Each process writes them to its own <dir>/info-<pid>.sqlite instead and
+ * "sm_fill_db --merge" copies the rows from the shards into the DB, so the
+ * build doesn't have to write, split and parse gigabytes of text.
+ *
+ * The output streams are wrapped at the very end, after the per function
+ * and --jobs capturing, so the shard gets exactly the lines that would have
+ * been printed.  The lines are parsed the same way as sm_fill_db parses the
+ * warns file.  Everything else goes through to the real stream.
+ *
+ * The shard is one table where "seq" keeps the order the lines were printed
+ * in.  The SQL_caller_info rows keep their call number in "call" and
+ * sm_fill_db moves it past the calls of the earlier shards.  Statements
+ * which aren't a simple insert are saved as text in "sql".
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <sqlite3.h>
+#include <unistd.h>
+#include "smatch.h"
+
+enum shard_kind {
+	SHARD_NORMAL,
+	SHARD_LATE,
+	SHARD_CALLER_INFO,
+	SHARD_CALL_MARKER,
+};
+
+struct shard_stream {
+	FILE *orig;
+	FILE *fd;
+	char *line;
+	size_t len, size;
+};
+
+char *option_info_shard;
+
+static sqlite3 *shard_db;
+static sqlite3_stmt *shard_insert;
+static pid_t shard_pid;
+static long long shard_calls;
+static struct shard_stream streams[3];
+
+static bool shard_exec(const char *sql)
+{
+	char *err = NULL;
+
+	if (sqlite3_exec(shard_db, sql, NULL, NULL, &err) == SQLITE_OK)
+		return true;
+	sm_ierror("--info-shard: %s: '%s'", err, sql);
+	sqlite3_free(err);
+	return false;
+}
+
+static int get_max_call(void *_calls, int argc, char **argv, char **azColName)
+{
+	long long *calls = _calls;
+
+	if (argv[0])
+		*calls = strtoll(argv[0], NULL, 10);
+	return 0;
+}
+
+static bool open_shard(void)
+{
+	char path[PATH_MAX];
+	char sql[512];
+	char *p;
+	int i;
+
+	snprintf(path, sizeof(path), "%s/info-%d.sqlite", option_info_shard, getpid());
+	if (sqlite3_open(path, &shard_db) != SQLITE_OK) {
+		sm_ierror("--info-shard: cannot open '%s'", path);
+		sqlite3_close(shard_db);
+		shard_db = NULL;
+		return false;
+	}
+	sqlite3_busy_timeout(shard_db, 10000);
+
+	p = sql + snprintf(sql, sizeof(sql),
+			   "create table if not exists rows (seq integer primary key, "
+			   "kind integer, tbl text, cnt integer, call integer, sql text");
+	for (i = 1; i <= SQL_MAX_VALUES; i++)
+		p += snprintf(p, sql + sizeof(sql) - p, ", v%d", i);
+	snprintf(p, sql + sizeof(sql) - p, ");");
+
+	if (!shard_exec("PRAGMA journal_mode = WAL;") ||
+	    !shard_exec("PRAGMA synchronous = NORMAL;") ||
+	    !shard_exec(sql))
+		goto fail;
+
+	/* the pid was used before, carry on after its calls */
+	shard_calls = 0;
+	if (sqlite3_exec(shard_db, "select max(call) from rows;", get_max_call,
+			 &shard_calls, NULL) != SQLITE_OK)
+		goto fail;
+
+	p = sql + snprintf(sql, sizeof(sql), "insert into rows values (NULL, ?, ?, ?, ?, ?");
+	for (i = 0; i < SQL_MAX_VALUES; i++)
+		p += snprintf(p, sql + sizeof(sql) - p, ", ?");
+	snprintf(p, sql + sizeof(sql) - p, ");");
+	if (sqlite3_prepare_v2(shard_db, sql, -1, &shard_insert, NULL) != SQLITE_OK) {
+		sm_ierror("--info-shard: %s", sqlite3_errmsg(shard_db));
+		goto fail;
+	}
+
+	if (!shard_exec("BEGIN;"))
+		goto fail;
+	return true;
+
+fail:
+	sqlite3_finalize(shard_insert);
+	shard_insert = NULL;
+	sqlite3_close(shard_db);
+	shard_db = NULL;
+	return false;
+}
+
+static void insert_shard_row(enum shard_kind kind, const char *table, int table_len,
+			     struct sql_value *vals, int cnt, long long call,
+			     const char *sql)
+{
+	int i;
+
+	sqlite3_bind_int(shard_insert, 1, kind);
+	if (cnt > 0) {
+		sqlite3_bind_text(shard_insert, 2, table, table_len, SQLITE_STATIC);
+		sqlite3_bind_int(shard_insert, 3, cnt);
+	}
+	if (kind == SHARD_CALLER_INFO || kind == SHARD_CALL_MARKER)
+		sqlite3_bind_int64(shard_insert, 4, call);
+	if (sql)
+		sqlite3_bind_text(shard_insert, 5, sql, -1, SQLITE_STATIC);
+	for (i = 0; i < cnt; i++)
+		sql_bind_value(shard_insert, i + 6, &vals[i]);
+
+	if (sqlite3_step(shard_insert) != SQLITE_DONE)
+		sm_ierror("--info-shard: %s", sqlite3_errmsg(shard_db));
+	sqlite3_reset(shard_insert);
+	sqlite3_clear_bindings(shard_insert);
+}
+
+/* "insert ... values (...);" as typed values or else as text */
+static void save_sql(enum shard_kind kind, char *sql, long long call)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *table;
+	int len, ignore, cnt;
+	char *orig;
+
+	orig = strdup(sql);
+	cnt = sql_split_insert(sql, &table, &len, &ignore, vals, SQL_MAX_VALUES);
+	if (cnt > 0)
+		insert_shard_row(kind, table, len, vals, cnt, call, NULL);
+	else
+		insert_shard_row(kind, NULL, 0, NULL, 0, call, orig);
+	free(orig);
+}
+
+/* The SQL starts after the second ':' of "file.c:123 func() SQL: ..." */
+static char *sql_start(char *line)
+{
+	char *p;
+
+	p = strchr(line, ':');
+	if (p)
+		p = strchr(p + 1, ':');
+	return p ? p + 1 : NULL;
+}
+
+/* The nth field of the line if it were split on "'" */
+static const char *quote_field(const char *line, int nr, int *len)
+{
+	const char *p = line;
+
+	while (nr--) {
+		p = strchr(p, '\'');
+		if (!p)
+			return NULL;
+		p++;
+	}
+	*len = strchrnul(p, '\'') - p;
+	return p;
+}
+
+static bool skip_caller_info(const char *key, int len)
+{
+	static const char *skip[] = {
+		"printk", "memset", "memcpy", "kfree", "printf", "dev_err", "writel",
+	};
+	int i;
+
+	if (memmem(key, len, "__builtin_", 10))
+		return true;
+	for (i = 0; i < ARRAY_SIZE(skip); i++) {
+		if (strlen(skip[i]) == len && strncmp(key, skip[i], len) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * This has to match load_caller_info() in sm_fill_db.c.  The %CALL_ID% is
+ * saved as zero and sm_fill_db adds the call number and the offset.  If
+ * the statement is saved as text then the %CALL_ID% is left for sm_fill_db
+ * to replace.
+ */
+static void save_caller_info(char *line, char *marker)
+{
+	enum shard_kind kind = SHARD_CALLER_INFO;
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *key, *table;
+	int len, ignore, cnt;
+	char *p, *sql, *copy;
+
+	for (p = marker; p > line && (isalnum(p[-1]) || p[-1] == '_'); p--)
+		;
+	if (p == marker || p == line || p[-1] != ' ')
+		return;
+	key = quote_field(line, 5, &len);
+	if (key && skip_caller_info(key, len))
+		return;
+
+	sql = sql_start(line);
+	if (!sql)
+		return;
+	p = strstr(sql, "%call_marker%");
+	if (p) {
+		memmove(p, p + 13, strlen(p + 13) + 1);
+		shard_calls++;
+		kind = SHARD_CALL_MARKER;
+	}
+
+	copy = strdup(sql);
+	p = strstr(copy, "%CALL_ID%");
+	if (p) {
+		memmove(p + 1, p + 9, strlen(p + 9) + 1);
+		*p = '0';
+	}
+	cnt = sql_split_insert(copy, &table, &len, &ignore, vals, SQL_MAX_VALUES);
+	if (cnt > 0)
+		insert_shard_row(kind, table, len, vals, cnt, shard_calls, NULL);
+	else
+		insert_shard_row(kind, NULL, 0, NULL, 0, shard_calls, sql);
+	free(copy);
+}
+
+static bool save_row(char *row)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *table;
+	int len, ignore, late, cnt;
+
+	cnt = sql_split_row(row, &table, &len, &ignore, &late, vals, SQL_MAX_VALUES);
+	if (cnt <= 0)
+		return false;
+	insert_shard_row(late ? SHARD_LATE : SHARD_NORMAL, table, len, vals, cnt, 0, NULL);
+	return true;
+}
+
+static bool save_rows(char *row)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	const char *table;
+	int len, ignore, late, cnt, shared, ret;
+	char *next;
+
+	cnt = sql_split_rows(row, &table, &len, &ignore, &late, vals,
+			     SQL_MAX_VALUES, &shared, &next);
+	if (cnt <= 0)
+		return false;
+	while ((ret = sql_next_row(&next, vals, shared, cnt)) > 0)
+		insert_shard_row(late ? SHARD_LATE : SHARD_NORMAL, table, len,
+				 vals, cnt, 0, NULL);
+	return ret == 0;
+}
+
+/* returns false if the line should be printed */
+static bool save_line(char *line)
+{
+	char *p, *copy;
+	bool ret = true;
+
+	if (!strstr(line, "() SQL"))
+		return false;
+
+	copy = strdup(line);
+	if ((p = strstr(copy, "() SQL_row: "))) {
+		ret = save_row(p + strlen("() SQL_row: "));
+	} else if ((p = strstr(copy, "() SQL_rows: "))) {
+		ret = save_rows(p + strlen("() SQL_rows: "));
+	} else if ((p = strstr(copy, "() SQL_caller_info: "))) {
+		save_caller_info(copy, p);
+	} else if (strstr(copy, "() SQL: ") && (p = sql_start(copy))) {
+		save_sql(SHARD_NORMAL, p, 0);
+	} else if (strstr(copy, "() SQL_late: ") && (p = sql_start(copy))) {
+		save_sql(SHARD_LATE, p, 0);
+	} else {
+		ret = false;
+	}
+	free(copy);
+	return ret;
+}
+
+static void shard_line(struct shard_stream *s, char *line, size_t len)
+{
+	/* the --jobs children print through their own captures */
+	if (shard_pid != getpid() || !shard_db) {
+		fwrite(line, 1, len, s->orig);
+		return;
+	}
+
+	line[len - 1] = '\0';
+	if (!save_line(line)) {
+		line[len - 1] = '\n';
+		fwrite(line, 1, len, s->orig);
+	}
+}
+
+static ssize_t shard_write(void *cookie, const char *buf, size_t size)
+{
+	struct shard_stream *s = cookie;
+	const char *nl;
+	size_t len, left = size;
+
+	while (left) {
+		nl = memchr(buf, '\n', left);
+		len = nl ? nl - buf + 1 : left;
+		if (s->len + len + 1 > s->size) {
+			s->size = (s->len + len + 1) * 2;
+			s->line = realloc(s->line, s->size);
+		}
+		memcpy(s->line + s->len, buf, len);
+		s->len += len;
+		buf += len;
+		left -= len;
+		if (nl) {
+			shard_line(s, s->line, s->len);
+			s->len = 0;
+		}
+	}
+	return size;
+}
+
+static FILE *wrap_stream(FILE *orig)
+{
+	cookie_io_functions_t funcs = { .write = shard_write };
+	struct shard_stream *s;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(streams); i++) {
+		s = &streams[i];
+		if (s->orig == orig || s->fd == orig)
+			return s->fd;
+		if (s->orig)
+			continue;
+		s->fd = fopencookie(s, "w", funcs);
+		if (!s->fd)
+			return orig;
+		setvbuf(s->fd, NULL, _IOFBF, 64 * 1024);
+		s->orig = orig;
+		s->len = 0;
+		return s->fd;
+	}
+	return orig;
+}
+
+void info_shard_close(void)
+{
+	int i;
+
+	if (!shard_db || shard_pid != getpid())
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(streams); i++) {
+		if (!streams[i].fd)
+			continue;
+		fflush(streams[i].fd);
+		/* a last line without a newline */
+		if (streams[i].len)
+			fwrite(streams[i].line, 1, streams[i].len, streams[i].orig);
+		streams[i].len = 0;
+	}
+
+	shard_exec("COMMIT;");
+	sqlite3_finalize(shard_insert);
+	shard_insert = NULL;
+	sqlite3_close(shard_db);
+	shard_db = NULL;
+}
+
+/* called once in each process which prints --info output */
+void info_shard_start(void)
+{
+	static bool registered;
+
+	if (!option_info_shard || !option_info)
+		return;
+
+	/* a --batch child gets its own shard */
+	shard_db = NULL;
+	shard_insert = NULL;
+	shard_pid = getpid();
+	if (!open_shard())
+		return;
+
+	sm_outfd = wrap_stream(sm_outfd);
+	sql_outfd = wrap_stream(sql_outfd);
+	caller_info_fd = wrap_stream(caller_info_fd);
+
+	if (!registered) {
+		atexit(info_shard_close);
+		registered = true;
+	}
+}
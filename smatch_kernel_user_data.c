@@ -25,6 +25,7 @@
 #include "smatch.h"
 #include "smatch_slist.h"
 #include "smatch_extra.h"
+#include "smatch_function_hashtable.h"
 
 static int my_id;
 static int my_call_id;
@@ -115,11 +116,50 @@ static void extra_nomod_hook(const char *name, struct symbol *sym, struct expres
 	set_state(my_id, name, sym, new);
 }
 
+/*
+ * A function tends to store the same user data in the same struct member
+ * over and over so only insert each type_info row once per function.
+ */
+DEFINE_STRING_HASHTABLE_STATIC(seen_type_info);
+static int seen_degraded;
+
+static void clear_seen_type_info(struct symbol *sym)
+{
+	if (!seen_type_info)
+		return;
+	hashtable_destroy(seen_type_info, 0);
+	seen_type_info = NULL;
+}
+
+static bool type_info_seen(const char *type_str, const char *member, const char *value)
+{
+	char buf[256];
+	char *key;
+
+	/* the output from before a degraded pass is thrown away */
+	if (seen_degraded != __degraded_pass) {
+		clear_seen_type_info(NULL);
+		seen_degraded = __degraded_pass;
+	}
+
+	snprintf(buf, sizeof(buf), "%s|%s|%s", type_str, member, value);
+	if (!seen_type_info)
+		seen_type_info = create_function_hashtable(64);
+	if (search_seen_type_info(seen_type_info, buf))
+		return true;
+	key = strdup(buf);
+	insert_seen_type_info(seen_type_info, key, (void *)1);
+	return false;
+}
+
 static void store_type_info(struct expression *expr, struct smatch_state *state)
 {
 	struct symbol *type;
 	char *type_str, *member;
 
+	/* nothing reads function_type_info back, it's only for --info */
+	if (!option_info || __inline_fn)
+		return;
 	if (__in_fake_assign)
 		return;
 
@@ -141,6 +181,8 @@ static void store_type_info(struct expression *expr, struct smatch_state *state)
 	if (!member)
 		return;
 
+	if (type_info_seen(type_str, member, state->name))
+		return;
 	sql_insert_function_type_info(USER_DATA, type_str, member, state->name);
 }
 
@@ -707,9 +749,6 @@ static void handle_compare(struct expression *expr)
 
 static void match_condition(struct expression *expr)
 {
-	if (expr->type != EXPR_COMPARE)
-		return;
-
 	if (expr->op == SPECIAL_EQUAL ||
 	    expr->op == SPECIAL_NOTEQUAL) {
 		handle_eq_noteq(expr);
@@ -1396,10 +1435,11 @@ void register_kernel_user_data(int id)
 	add_function_hook("sscanf", &match_sscanf, NULL);
 
 	add_hook(&match_syscall_definition, AFTER_DEF_HOOK);
+	add_hook(&clear_seen_type_info, AFTER_FUNC_HOOK);
 
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	select_return_states_hook(PARAM_SET, &db_param_set);
-	add_hook(&match_condition, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 
 	add_caller_info_callback(my_id, caller_info_callback);
 	add_return_info_callback(my_id, return_info_callback);
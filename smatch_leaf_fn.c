@@ -29,25 +29,13 @@ static int my_id;
 
 static unsigned long has_call;
 
-static int no_calls_callback(void *leaf, int argc, char **argv, char **azColName)
-{
-	*(bool *)leaf = true;
-	return 0;
-}
-
 bool call_is_leaf_fn(struct expression *call)
 {
-	bool leaf = false;
-
 	if (call->fn->type != EXPR_SYMBOL ||
 	    !call->fn->symbol) /* to handle __builtin_mul_overflow() apparently */
 		return false;
 
-	run_sql(&no_calls_callback, &leaf,
-		"select * from return_implies where %s and type = %d;",
-		get_static_filter(call->fn->symbol), LEAF_FN);
-
-	return leaf;
+	return get_fn_traits(call->fn->symbol)->leaf;
 }
 
 static void match_caller_info(struct expression *expr)
@@ -22,6 +22,7 @@
 #include "smatch.h"
 #include "smatch_extra.h"
 #include "smatch_slist.h"
+#include "smatch_function_hashtable.h"
 
 static int my_id;
 
@@ -586,18 +587,30 @@ struct expression *get_locking_call(void)
 	return locking_call;
 }
 
-bool is_locking_primitive(const char *name)
+static DEFINE_HASHTABLE_INSERT(insert_lock_info, char, struct lock_info);
+static DEFINE_HASHTABLE_SEARCH(search_lock_info, char, struct lock_info);
+static struct hashtable *lock_info_hash;
+
+/* lock_table[] is several hundred entries and this is called for every call */
+static void hash_lock_table(void)
 {
-	int i;
+	struct lock_info *lock;
+
+	lock_info_hash = create_function_hashtable(1000);
+	for (lock = lock_table; lock->function; lock++) {
+		if (!search_lock_info(lock_info_hash, (char *)lock->function))
+			insert_lock_info(lock_info_hash, (char *)lock->function, lock);
+	}
+}
 
+bool is_locking_primitive(const char *name)
+{
 	if (!name)
 		return false;
 
-	for (i = 0; lock_table[i].function != NULL; i++) {
-		if (strcmp(lock_table[i].function, name) == 0)
-			return true;
-	}
-	return false;
+	if (!lock_info_hash)
+		hash_lock_table();
+	return !!search_lock_info(lock_info_hash, (char *)name);
 }
 
 bool is_locking_primitive_sym(struct symbol *sym)
@@ -569,10 +569,59 @@ static bool handle_mod_rl(struct expression *expr, int implied, int *recurse_cnt
 	return true;
 }
 
+/*
+ * smatch_bits.c records which bits have been set or masked away.  That is
+ * not something a range list is good at, so for & and >> the result is cut
+ * down to between the bits which are always set and the ones which might be.
+ * Only what was recorded for the variable is used, the same expression isn't
+ * looked at again.
+ */
+static bool get_math_bits(struct expression *expr, struct bit_info *res)
+{
+	struct symbol *type;
+
+	expr = strip_expr(expr);
+	type = get_type(expr);
+	if (!type || is_ptr_type(type) ||
+	    type_bits(type) <= 0 || type_bits(type) > 64)
+		return false;
+	if (!get_bits_state(expr, res))
+		return false;
+	if (type_bits(type) < 64)
+		*res = binfo_mask(*res, (1ULL << type_bits(type)) - 1);
+	/* it could be sign extended */
+	if (!type_unsigned(type) &&
+	    (res->possible & (1ULL << (type_bits(type) - 1))))
+		return false;
+	return true;
+}
+
+static struct range_list *limit_rl_by_bits(struct range_list *rl, struct bit_info bits)
+{
+	struct symbol *type = rl_type(rl);
+	struct range_list *ret;
+
+	if (!type || type_bits(type) <= 0 || type_bits(type) > 64)
+		return rl;
+	if (type_bits(type) < 64)
+		bits = binfo_mask(bits, (1ULL << type_bits(type)) - 1);
+	if (!type_unsigned(type) &&
+	    (bits.possible & (1ULL << (type_bits(type) - 1))))
+		return rl;
+
+	ret = rl_intersection(rl, alloc_rl(sval_type_val(type, bits.set),
+					   sval_type_val(type, bits.possible)));
+	if (!ret)
+		return rl;
+	return ret;
+}
+
 static bool handle_bitwise_AND(struct expression *expr, int implied, int *recurse_cnt, struct range_list **res)
 {
 	struct symbol *type;
 	struct range_list *left_rl, *right_rl;
+	struct bit_info bits;
+	sval_t mask;
 	int new_recurse;
 
 	if (implied != RL_IMPLIED && implied != RL_ABSOLUTE && implied != RL_REAL_ABSOLUTE)
@@ -593,6 +642,11 @@ static bool handle_bitwise_AND(struct expression *expr, int implied, int *recurs
 	*recurse_cnt = new_recurse;
 
 	*res = rl_binop(left_rl, '&', right_rl);
+	if (*res && get_math_bits(expr->left, &bits)) {
+		if (rl_to_sval(right_rl, &mask))
+			bits = binfo_mask(bits, mask.uvalue);
+		*res = limit_rl_by_bits(*res, bits);
+	}
 	return true;
 }
 
@@ -619,8 +673,9 @@ static bool use_rl_binop(struct expression *expr, int implied, int *recurse_cnt,
 
 static bool handle_right_shift(struct expression *expr, int implied, int *recurse_cnt, struct range_list **res)
 {
-	struct range_list *left_rl, *right_rl;
-	sval_t min, max;
+	struct range_list *left_rl, *right_rl = NULL;
+	struct bit_info bits;
+	sval_t min, max, shift;
 
 	if (implied == RL_EXACT || implied == RL_HARD)
 		return false;
@@ -647,6 +702,13 @@ static bool handle_right_shift(struct expression *expr, int implied, int *recurs
 	}
 
 	*res = alloc_rl(min, max);
+
+	if ((implied == RL_IMPLIED || implied == RL_ABSOLUTE || implied == RL_REAL_ABSOLUTE) &&
+	    right_rl && rl_to_sval(right_rl, &shift) &&
+	    !sval_is_negative(shift) && shift.value < 64 &&
+	    get_math_bits(expr->left, &bits))
+		*res = limit_rl_by_bits(*res, binfo_shr(bits, shift.value));
+
 	return true;
 }
 
@@ -784,6 +846,13 @@ static bool handle_binop_rl_helper(struct expression *expr, int implied, int *re
 
 }
 
+/*
+ * Smatch never runs expand_expression() on function bodies so things like
+ * BIT(3) | BIT(5) or sizeof(*p) * 4 stay as trees.  A binop whose sides are
+ * both constants is folded the first time it is looked at and the value is
+ * kept in expr->sval for the rest of the run.  The sides go through
+ * get_value() which is cached as well.
+ */
 static bool handle_binop_rl(struct expression *expr, int implied, int *recurse_cnt, struct range_list **res, sval_t *res_sval)
 {
 	struct smatch_state *state;
@@ -1698,15 +1767,34 @@ static bool get_rl_helper(struct expression *expr, int implied, struct range_lis
 	return true;
 }
 
+/*
+ * get_value() results are cached until the end of the function.  The table is
+ * indexed by the expression pointer and a collision just overwrites the old
+ * entry.  Clearing it only bumps the generation so it's cheap to do for every
+ * function.
+ */
+#define MATH_CACHE_SIZE 4096
+
 static struct {
 	struct expression *expr;
+	unsigned int gen;
 	sval_t sval;
-} cached_results[24];
-static int cache_idx;
+} cached_results[MATH_CACHE_SIZE];
+static unsigned int cache_gen = 1;
+
+static unsigned int math_cache_hash(struct expression *expr)
+{
+	unsigned long ptr = (unsigned long)expr;
+
+	return ((ptr >> 4) ^ (ptr >> 16)) % MATH_CACHE_SIZE;
+}
 
 void clear_math_cache(void)
 {
-	memset(cached_results, 0, sizeof(cached_results));
+	if (++cache_gen == 0) {
+		memset(cached_results, 0, sizeof(cached_results));
+		cache_gen = 1;
+	}
 }
 
 void set_fast_math_only(void)
@@ -1740,20 +1828,28 @@ int get_value(struct expression *expr, sval_t *res_sval)
 {
 	struct range_list *(*orig_custom_fn)(struct expression *expr);
 	int recurse_cnt = 0;
+	unsigned int hash = 0;
 	sval_t sval = {};
-	int i;
+	bool cache_ok;
 
 	if (get_value_literal(expr, res_sval))
 		return 1;
 
+	if (!expr)
+		return 0;
+
 	/*
 	 * This only handles RL_EXACT because other expr statements can be
 	 * different at different points.  Like the list iterator, for example.
+	 * Tmp and Fake expressions can be freed or reused so skip those.
 	 */
-	for (i = 0; i < ARRAY_SIZE(cached_results); i++) {
-		if (expr == cached_results[i].expr) {
-			if (cached_results[i].sval.type) {
-				*res_sval = cached_results[i].sval;
+	cache_ok = !(expr->smatch_flags & (Tmp | Fake));
+	if (cache_ok) {
+		hash = math_cache_hash(expr);
+		if (cached_results[hash].expr == expr &&
+		    cached_results[hash].gen == cache_gen) {
+			if (cached_results[hash].sval.type) {
+				*res_sval = cached_results[hash].sval;
 				return true;
 			}
 			return false;
@@ -1766,9 +1862,11 @@ int get_value(struct expression *expr, sval_t *res_sval)
 
 	custom_handle_variable = orig_custom_fn;
 
-	cached_results[cache_idx].expr = expr;
-	cached_results[cache_idx].sval = sval;
-	cache_idx = (cache_idx + 1) % ARRAY_SIZE(cached_results);
+	if (cache_ok) {
+		cached_results[hash].expr = expr;
+		cached_results[hash].gen = cache_gen;
+		cached_results[hash].sval = sval;
+	}
 
 	if (!sval.type)
 		return 0;
@@ -0,0 +1,891 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * When we inline a function the sql_insert() calls are recorded here instead
+ * of being printed.  After the inline pass we look the rows up again by
+ * call_id.  This used to be an in-memory SQLite database but it was only
+ * ever a handful of rows per call and parsing the SQL cost more than
+ * everything else.
+ *
+ * The only tables which are read back are return_states, return_implies and
+ * caller_info so the rest of the inserts are just dropped.  The values are
+ * stored as the same strings that sqlite3_exec() would have passed to the
+ * callbacks.
+ */
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include "smatch.h"
+#include "smatch_sql_values.h"
+
+#define MEM_DB_HASH 256
+
+struct mem_row {
+	struct mem_row *next;
+	unsigned long long call_id;
+	char *vals[];
+};
+
+struct mem_table {
+	const char *name;
+	const char *cols[SQL_MAX_VALUES];
+	bool unique;
+	int nr_cols;
+	int call_id_col;
+	int nr_rows;
+	struct mem_row *head[MEM_DB_HASH];
+	struct mem_row *tail[MEM_DB_HASH];
+};
+
+static struct mem_table mem_tables[] = {
+	{ "return_states",
+	  { "file", "function", "call_id", "return_id", "return", "static", "type", "parameter", "key", "value" } },
+	{ "return_implies",
+	  { "file", "function", "call_id", "static", "type", "parameter", "key", "value" },
+	  .unique = true },
+	{ "caller_info",
+	  { "file", "caller", "function", "call_id", "static", "type", "parameter", "key", "value" } },
+};
+
+static struct mem_table *get_mem_table(const char *name)
+{
+	struct mem_table *table;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(mem_tables); i++) {
+		table = &mem_tables[i];
+		if (strcmp(table->name, name) != 0)
+			continue;
+		if (!table->nr_cols) {
+			for (j = 0; j < SQL_MAX_VALUES && table->cols[j]; j++) {
+				if (strcmp(table->cols[j], "call_id") == 0)
+					table->call_id_col = j;
+			}
+			table->nr_cols = j;
+		}
+		return table;
+	}
+	return NULL;
+}
+
+static unsigned int call_id_hash(unsigned long long call_id)
+{
+	return (call_id >> 4) % MEM_DB_HASH;
+}
+
+/* SQLite gives integers back in decimal even if they were inserted as hex */
+static const char *value_str(struct sql_value *val, char *buf, int size)
+{
+	if (val->type != SQL_VAL_INT)
+		return val->str;
+	snprintf(buf, size, "%lld", (long long)strtoull(val->str, NULL, 0));
+	return buf;
+}
+
+static bool same_row(struct mem_table *table, struct mem_row *a, struct mem_row *b)
+{
+	int i;
+
+	for (i = 0; i < table->nr_cols; i++) {
+		if (strcmp(a->vals[i], b->vals[i]) != 0)
+			return false;
+	}
+	return true;
+}
+
+static void add_row(struct mem_table *table, struct mem_row *row, int ignore);
+
+void mem_db_insert(const char *table_name, int ignore, const char *values)
+{
+	struct sql_value vals[SQL_MAX_VALUES];
+	char num[SQL_MAX_VALUES][24];
+	const char *strs[SQL_MAX_VALUES];
+	struct mem_table *table;
+	char buf[1024];
+	struct mem_row *row;
+	size_t size;
+	char *p;
+	int cnt, i;
+
+	table = get_mem_table(table_name);
+	if (!table)
+		return;
+
+	snprintf(buf, sizeof(buf), "%s", values);
+	cnt = sql_split_values(buf, vals, ARRAY_SIZE(vals));
+	if (cnt != table->nr_cols) {
+		sm_ierror("mem-db: bad insert into %s: '%s'", table_name, values);
+		parse_error = 1;
+		return;
+	}
+
+	size = sizeof(*row) + cnt * sizeof(char *);
+	for (i = 0; i < cnt; i++) {
+		strs[i] = value_str(&vals[i], num[i], sizeof(num[i]));
+		size += strlen(strs[i]) + 1;
+	}
+	row = malloc(size);
+	p = (char *)&row->vals[cnt];
+	for (i = 0; i < cnt; i++) {
+		row->vals[i] = p;
+		p = stpcpy(p, strs[i]) + 1;
+	}
+	row->call_id = strtoull(row->vals[table->call_id_col], NULL, 10);
+	add_row(table, row, ignore);
+}
+
+static void add_row(struct mem_table *table, struct mem_row *row, int ignore)
+{
+	struct mem_row *tmp;
+	unsigned int hash;
+
+	row->next = NULL;
+	hash = call_id_hash(row->call_id);
+	if (table->unique && ignore) {
+		for (tmp = table->head[hash]; tmp; tmp = tmp->next) {
+			if (tmp->call_id == row->call_id && same_row(table, tmp, row)) {
+				free(row);
+				return;
+			}
+		}
+	}
+
+	if (table->tail[hash])
+		table->tail[hash]->next = row;
+	else
+		table->head[hash] = row;
+	table->tail[hash] = row;
+	table->nr_rows++;
+}
+
+/* "cols" is a list of column names like "return_id, return, type" */
+static int get_col_idx(struct mem_table *table, const char *cols, int *idx, int max)
+{
+	const char *p = cols;
+	int cnt = 0;
+	int len, i;
+
+	while (*p) {
+		while (*p == ' ')
+			p++;
+		len = strcspn(p, ", ");
+		if (len == 0 || cnt == max)
+			return -1;
+		for (i = 0; i < table->nr_cols; i++) {
+			if (strncmp(table->cols[i], p, len) == 0 &&
+			    table->cols[i][len] == '\0')
+				break;
+		}
+		if (i == table->nr_cols)
+			return -1;
+		idx[cnt++] = i;
+		p += len;
+		while (*p == ' ')
+			p++;
+		if (*p == ',')
+			p++;
+	}
+
+	return cnt;
+}
+
+static int cmp_rows(struct mem_row *a, struct mem_row *b, int col_a, int col_b)
+{
+	long long x, y;
+
+	x = atoll(a->vals[col_a]);
+	y = atoll(b->vals[col_a]);
+	if (x != y)
+		return x < y ? -1 : 1;
+	x = atoll(a->vals[col_b]);
+	y = atoll(b->vals[col_b]);
+	if (x != y)
+		return x < y ? -1 : 1;
+	return 0;
+}
+
+/* "order by return_id, type".  An insertion sort is stable like SQLite. */
+static void sort_return_states(struct mem_table *table, struct mem_row **rows, int nr)
+{
+	struct mem_row *tmp;
+	int col_a, col_b;
+	int i, j;
+
+	get_col_idx(table, "return_id", &col_a, 1);
+	get_col_idx(table, "type", &col_b, 1);
+
+	for (i = 1; i < nr; i++) {
+		tmp = rows[i];
+		for (j = i; j > 0 && cmp_rows(rows[j - 1], tmp, col_a, col_b) > 0; j--)
+			rows[j] = rows[j - 1];
+		rows[j] = tmp;
+	}
+}
+
+/*
+ * This is "select <cols> from <table> where call_id = <call_id>;" with the
+ * rows in the order they were inserted.  For return_states they are sorted
+ * by return_id and type the same as smatch_db does.
+ */
+void mem_db_select(const char *table_name, const char *cols, bool distinct,
+		   unsigned long long call_id,
+		   int (*callback)(void*, int, char**, char**), void *data)
+{
+	char *argv[SQL_MAX_VALUES], *names[SQL_MAX_VALUES];
+	struct mem_table *table;
+	struct mem_row **rows;
+	struct mem_row *row;
+	int idx[SQL_MAX_VALUES];
+	int argc, nr = 0;
+	int i, j;
+
+	table = get_mem_table(table_name);
+	if (!table)
+		return;
+	argc = get_col_idx(table, cols, idx, ARRAY_SIZE(idx));
+	if (argc <= 0 || (distinct && argc != 1)) {
+		sm_ierror("mem-db: unknown columns '%s' for %s", cols, table_name);
+		return;
+	}
+	db_debug("mem-db: select %s%s from %s where call_id = %llu;\n",
+		 distinct ? "distinct " : "", cols, table_name, call_id);
+
+	if (!table->nr_rows)
+		return;
+
+	rows = malloc(table->nr_rows * sizeof(*rows));
+	for (row = table->head[call_id_hash(call_id)]; row; row = row->next) {
+		if (row->call_id != call_id)
+			continue;
+		if (distinct) {
+			for (i = 0; i < nr; i++) {
+				if (strcmp(rows[i]->vals[idx[0]], row->vals[idx[0]]) == 0)
+					break;
+			}
+			if (i < nr)
+				continue;
+		}
+		rows[nr++] = row;
+	}
+
+	if (!distinct && strcmp(table->name, "return_states") == 0)
+		sort_return_states(table, rows, nr);
+
+	for (i = 0; i < argc; i++)
+		names[i] = (char *)table->cols[idx[i]];
+	for (j = 0; j < nr; j++) {
+		for (i = 0; i < argc; i++)
+			argv[i] = rows[j]->vals[idx[i]];
+		if (callback(data, argc, argv, names))
+			break;
+	}
+
+	free(rows);
+}
+
+void mem_db_clear(void)
+{
+	struct mem_table *table;
+	struct mem_row *row, *next;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(mem_tables); i++) {
+		table = &mem_tables[i];
+		if (!table->nr_rows)
+			continue;
+		for (j = 0; j < MEM_DB_HASH; j++) {
+			for (row = table->head[j]; row; row = next) {
+				next = row->next;
+				free(row);
+			}
+			table->head[j] = NULL;
+			table->tail[j] = NULL;
+		}
+		table->nr_rows = 0;
+	}
+}
+
+/*
+ * An inline function is parsed again at every call site.  What comes out
+ * of it only depends on the caller_info rows for the arguments, so if a
+ * call passes exactly the same caller_info as an earlier call to the same
+ * function, we can reuse the return_states and return_implies rows instead
+ * of parsing it again.  The file, caller and call_id columns are left out of
+ * the comparison.
+ */
+struct inline_summary {
+	struct inline_summary *next;
+	struct symbol *fn;
+	unsigned long long hash;
+	char *args;
+	struct mem_row *rows[2];
+};
+
+#define INLINE_CACHE_HASH 256
+static struct inline_summary *inline_cache[INLINE_CACHE_HASH];
+static const char *summary_tables[] = { "return_states", "return_implies" };
+
+static char *get_inline_args(unsigned long long call_id)
+{
+	struct mem_table *table;
+	struct mem_row *row;
+	size_t len = 0, size = 256;
+	char *buf, *p;
+	int i;
+
+	table = get_mem_table("caller_info");
+	buf = malloc(size);
+	buf[0] = '\0';
+	for (row = table->head[call_id_hash(call_id)]; row; row = row->next) {
+		if (row->call_id != call_id)
+			continue;
+		for (i = 0; i < table->nr_cols; i++) {
+			if (i == table->call_id_col ||
+			    strcmp(table->cols[i], "file") == 0 ||
+			    strcmp(table->cols[i], "caller") == 0)
+				continue;
+			while (len + strlen(row->vals[i]) + 2 > size) {
+				size *= 2;
+				buf = realloc(buf, size);
+			}
+			p = stpcpy(buf + len, row->vals[i]);
+			*p++ = i + 1 == table->nr_cols ? '\n' : '|';
+			*p = '\0';
+			len = p - buf;
+		}
+	}
+	return buf;
+}
+
+static unsigned long long hash_args(struct symbol *fn, const char *args)
+{
+	unsigned long long hash = 14695981039346656037ULL ^ (unsigned long)fn;
+
+	while (*args)
+		hash = (hash ^ (unsigned char)*args++) * 1099511628211ULL;
+	return hash;
+}
+
+static struct mem_row *copy_row(struct mem_table *table, struct mem_row *row,
+				unsigned long long call_id)
+{
+	char id[24];
+	struct mem_row *new;
+	size_t size;
+	char *p;
+	int i;
+
+	snprintf(id, sizeof(id), "%llu", call_id);
+	size = sizeof(*new) + table->nr_cols * sizeof(char *);
+	for (i = 0; i < table->nr_cols; i++)
+		size += strlen(i == table->call_id_col ? id : row->vals[i]) + 1;
+	new = malloc(size);
+	p = (char *)&new->vals[table->nr_cols];
+	for (i = 0; i < table->nr_cols; i++) {
+		new->vals[i] = p;
+		p = stpcpy(p, i == table->call_id_col ? id : row->vals[i]) + 1;
+	}
+	new->call_id = call_id;
+	new->next = NULL;
+	return new;
+}
+
+static void add_summary(struct inline_summary *sum)
+{
+	sum->next = inline_cache[sum->hash % INLINE_CACHE_HASH];
+	inline_cache[sum->hash % INLINE_CACHE_HASH] = sum;
+}
+
+/*
+ * "smatch --inline-cache=<dir>" keeps the summaries of the inline functions
+ * from headers in <dir> so the other files don't have to parse them again.
+ * The key is the Smatch options and binary, the DB file, the function's
+ * tokens after preprocessing, what the identifiers in them refer to and the
+ * caller_info args.  The file column of the saved rows is replaced with the
+ * current file when they are loaded.
+ *
+ * Hashing the preprocessed tokens means a -D or -include which changes a
+ * macro in the body gives a different key.  For each identifier we hash the
+ * types, struct layouts and constant values of the file scope symbols it
+ * names and the keys of the functions it calls, so a struct or enum which
+ * changes size or value from one file to the next isn't missed either.
+ */
+char *option_inline_cache;
+static unsigned char options_digest[EVP_MAX_MD_SIZE];
+
+void inline_cache_hash_args(int argc, char **argv)
+{
+	static const char *skip[] = {
+		"--inline-cache=", "--result-cache=", "--header-cache=",
+		"--data-cache=", "--spool=", "--batch=", "--jobs=", "--gzip",
+		"--stats=", "--profile=", "--file-output",
+	};
+	const char *db_file = "smatch_db.sqlite";
+	EVP_MD_CTX *ctx;
+	struct stat st;
+	int i, j;
+
+	ctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+	for (i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--", 2) != 0 &&
+		    strncmp(argv[i], "-p=", 3) != 0)
+			continue;
+		for (j = 0; j < ARRAY_SIZE(skip); j++) {
+			if (strncmp(argv[i], skip[j], strlen(skip[j])) == 0)
+				break;
+		}
+		if (j < ARRAY_SIZE(skip))
+			continue;
+		if (strncmp(argv[i], "--db-file=", 10) == 0)
+			db_file = argv[i] + 10;
+		EVP_DigestUpdate(ctx, argv[i], strlen(argv[i]) + 1);
+	}
+	if (stat("/proc/self/exe", &st) == 0) {
+		EVP_DigestUpdate(ctx, &st.st_size, sizeof(st.st_size));
+		EVP_DigestUpdate(ctx, &st.st_mtim, sizeof(st.st_mtim));
+	}
+	if (stat(db_file, &st) == 0) {
+		EVP_DigestUpdate(ctx, &st.st_ino, sizeof(st.st_ino));
+		EVP_DigestUpdate(ctx, &st.st_size, sizeof(st.st_size));
+		EVP_DigestUpdate(ctx, &st.st_mtim, sizeof(st.st_mtim));
+		EVP_DigestUpdate(ctx, &st.st_ctim, sizeof(st.st_ctim));
+	}
+	EVP_DigestFinal_ex(ctx, options_digest, NULL);
+	EVP_MD_CTX_destroy(ctx);
+}
+
+/*
+ * The function definitions in the last preprocessed token stream.  The
+ * index is built the first time we need a key in a file.
+ */
+struct fn_tokens {
+	struct fn_tokens *next;
+	struct symbol *sym;
+	struct token *token;
+	int state;
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int len;
+};
+
+#define FN_TOKENS_HASH 1024
+static struct token *file_tokens;
+static struct fn_tokens **fn_tokens;
+
+static void free_fn_tokens(void)
+{
+	struct fn_tokens *ft, *next;
+	int i;
+
+	if (!fn_tokens)
+		return;
+	for (i = 0; i < FN_TOKENS_HASH; i++) {
+		for (ft = fn_tokens[i]; ft; ft = next) {
+			next = ft->next;
+			free(ft);
+		}
+	}
+	free(fn_tokens);
+	fn_tokens = NULL;
+}
+
+/* This is the preprocessed_hook when --inline-cache is used */
+void inline_cache_save_tokens(struct token *token)
+{
+	free_fn_tokens();
+	file_tokens = token;
+}
+
+static unsigned int fn_tokens_hash(struct symbol *sym)
+{
+	return ((unsigned long)sym >> 4) % FN_TOKENS_HASH;
+}
+
+static bool same_pos(struct position a, struct position b)
+{
+	return a.stream == b.stream && a.line == b.line && a.pos == b.pos;
+}
+
+static void index_fn_tokens(void)
+{
+	struct fn_tokens *ft;
+	struct token *token;
+	struct symbol *sym;
+	unsigned int h;
+
+	fn_tokens = calloc(FN_TOKENS_HASH, sizeof(*fn_tokens));
+	if (!file_tokens)
+		return;
+	for (token = file_tokens; !eof_token(token); token = token->next) {
+		if (token_type(token) != TOKEN_IDENT)
+			continue;
+		for (sym = token->ident->symbols; sym; sym = sym->next_id) {
+			if (sym->definition != sym ||
+			    !same_pos(sym->pos, token->pos))
+				continue;
+			ft = calloc(1, sizeof(*ft));
+			ft->sym = sym;
+			ft->token = token;
+			h = fn_tokens_hash(sym);
+			ft->next = fn_tokens[h];
+			fn_tokens[h] = ft;
+		}
+	}
+}
+
+static struct fn_tokens *find_fn_tokens(struct symbol *sym)
+{
+	struct fn_tokens *ft;
+
+	if (!fn_tokens)
+		index_fn_tokens();
+	for (ft = fn_tokens[fn_tokens_hash(sym)]; ft; ft = ft->next) {
+		if (ft->sym == sym)
+			return ft;
+	}
+	return NULL;
+}
+
+static void hash_str(EVP_MD_CTX *ctx, const char *str)
+{
+	EVP_DigestUpdate(ctx, str, strlen(str) + 1);
+}
+
+static void hash_layout(EVP_MD_CTX *ctx, struct symbol *type, int depth)
+{
+	struct symbol *member;
+	char buf[64];
+
+	if (type && type->type == SYM_NODE)
+		type = type->ctype.base_type;
+	if (!type || depth > 3 ||
+	    (type->type != SYM_STRUCT && type->type != SYM_UNION))
+		return;
+	examine_symbol_type(type);
+	snprintf(buf, sizeof(buf), "%d", type->bit_size);
+	hash_str(ctx, buf);
+	FOR_EACH_PTR(type->symbol_list, member) {
+		hash_str(ctx, member->ident ? member->ident->name : "");
+		snprintf(buf, sizeof(buf), "%lu %u %d", member->offset,
+			 member->bit_offset, member->bit_size);
+		hash_str(ctx, buf);
+		hash_str(ctx, type_to_str(member));
+		hash_layout(ctx, member->ctype.base_type, depth + 1);
+	} END_FOR_EACH_PTR(member);
+}
+
+static void hash_fn_tokens(struct fn_tokens *ft);
+
+static void hash_symbol(EVP_MD_CTX *ctx, struct symbol *sym)
+{
+	struct fn_tokens *ft;
+	char buf[64];
+
+	snprintf(buf, sizeof(buf), "%d", sym->namespace);
+	hash_str(ctx, buf);
+	hash_str(ctx, type_to_str(sym));
+	hash_layout(ctx, sym, 0);
+	if (sym->initializer && sym->initializer->type == EXPR_VALUE) {
+		snprintf(buf, sizeof(buf), "%llu", sym->initializer->value);
+		hash_str(ctx, buf);
+	}
+	if (sym->definition) {
+		ft = find_fn_tokens(sym->definition);
+		/* a recursive call just hashes the name */
+		if (ft && ft->state != 1) {
+			hash_fn_tokens(ft);
+			EVP_DigestUpdate(ctx, ft->digest, ft->len);
+		}
+	}
+}
+
+/* the tokens go from the function's name to the '}' which closes the body */
+static void hash_fn_tokens(struct fn_tokens *ft)
+{
+	struct token *token;
+	struct symbol *sym;
+	EVP_MD_CTX *ctx;
+	int depth = 0;
+
+	if (ft->state == 2)
+		return;
+	ft->state = 1;
+
+	ctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+	hash_str(ctx, type_to_str(ft->sym));
+	for (token = ft->token; !eof_token(token); token = token->next) {
+		hash_str(ctx, show_token(token));
+		if (token_type(token) == TOKEN_IDENT) {
+			for (sym = token->ident->symbols; sym; sym = sym->next_id) {
+				if (toplevel(sym->scope))
+					hash_symbol(ctx, sym);
+			}
+		}
+		if (match_op(token, '{'))
+			depth++;
+		else if (match_op(token, '}') && --depth == 0)
+			break;
+	}
+	EVP_DigestFinal_ex(ctx, ft->digest, &ft->len);
+	EVP_MD_CTX_destroy(ctx);
+
+	ft->state = 2;
+}
+
+static bool get_cache_file(struct symbol *fn, const char *args, char *buf, int size)
+{
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	const char *filename;
+	struct fn_tokens *ft;
+	struct symbol *def;
+	EVP_MD_CTX *ctx;
+	unsigned int len, i;
+	int n;
+
+	if (!option_inline_cache || !fn->ident)
+		return false;
+	def = fn->definition ?: fn;
+	filename = stream_name(def->pos.stream);
+	n = strlen(filename);
+	/* functions in the .c file are different for every file */
+	if (n == 0 || filename[n - 1] == 'c')
+		return false;
+	/* the --batch-prefix headers aren't in the file's token stream */
+	ft = find_fn_tokens(def);
+	if (!ft)
+		return false;
+	hash_fn_tokens(ft);
+
+	ctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+	EVP_DigestUpdate(ctx, options_digest, sizeof(options_digest));
+	EVP_DigestUpdate(ctx, fn->ident->name, fn->ident->len);
+	EVP_DigestUpdate(ctx, ft->digest, ft->len);
+	EVP_DigestUpdate(ctx, args, strlen(args));
+	EVP_DigestFinal_ex(ctx, digest, &len);
+	EVP_MD_CTX_destroy(ctx);
+
+	n = snprintf(buf, size, "%s/", option_inline_cache);
+	for (i = 0; i < len && n + 3 < size; i++)
+		n += snprintf(buf + n, size - n, "%02x", digest[i]);
+	return true;
+}
+
+/*
+ * The file is a "smatch inline cache <rows> <rows>" line and then the values
+ * of each row, each one ending in a NUL.
+ */
+static struct inline_summary *read_cache_file(struct symbol *fn, char *args)
+{
+	char cache_file[PATH_MAX];
+	struct inline_summary *sum;
+	struct mem_table *table;
+	struct mem_row *row, **tail;
+	int nr_rows[ARRAY_SIZE(summary_tables)];
+	char file_id[24];
+	char *buf, *p, *end;
+	size_t size;
+	FILE *file;
+	long len;
+	int i, j, k;
+
+	if (!get_cache_file(fn, args, cache_file, sizeof(cache_file)))
+		return NULL;
+	file = fopen(cache_file, "r");
+	if (!file)
+		return NULL;
+	if (fscanf(file, "smatch inline cache %d %d\n", &nr_rows[0], &nr_rows[1]) != 2 ||
+	    fseek(file, 0, SEEK_END) != 0 || (len = ftell(file)) < 0) {
+		fclose(file);
+		return NULL;
+	}
+	buf = malloc(len + 1);
+	rewind(file);
+	if (fread(buf, 1, len, file) != len) {
+		fclose(file);
+		free(buf);
+		return NULL;
+	}
+	fclose(file);
+	buf[len] = '\0';
+	end = buf + len;
+	p = strchr(buf, '\n') + 1;
+
+	snprintf(file_id, sizeof(file_id), "%llu", get_base_file_id());
+	sum = calloc(1, sizeof(*sum));
+	for (i = 0; i < ARRAY_SIZE(summary_tables); i++) {
+		table = get_mem_table(summary_tables[i]);
+		tail = &sum->rows[i];
+		for (j = 0; j < nr_rows[i]; j++) {
+			size = sizeof(*row) + table->nr_cols * sizeof(char *);
+			row = calloc(1, size + end - p + sizeof(file_id));
+			size = 0;
+			for (k = 0; k < table->nr_cols; k++) {
+				if (p >= end)
+					goto bad;
+				row->vals[k] = (char *)&row->vals[table->nr_cols] + size;
+				if (strcmp(table->cols[k], "file") == 0)
+					strcpy(row->vals[k], file_id);
+				else
+					strcpy(row->vals[k], p);
+				size += strlen(row->vals[k]) + 1;
+				p += strlen(p) + 1;
+			}
+			*tail = row;
+			tail = &row->next;
+		}
+	}
+	free(buf);
+
+	sum->fn = fn;
+	sum->args = args;
+	sum->hash = hash_args(fn, args);
+	return sum;
+bad:
+	free(row);
+	for (i = 0; i < ARRAY_SIZE(summary_tables); i++) {
+		while ((row = sum->rows[i])) {
+			sum->rows[i] = row->next;
+			free(row);
+		}
+	}
+	free(sum);
+	free(buf);
+	return NULL;
+}
+
+static void write_cache_file(struct inline_summary *sum)
+{
+	char cache_file[PATH_MAX];
+	char tmp[PATH_MAX + 32];
+	struct mem_table *table;
+	struct mem_row *row;
+	int nr_rows[ARRAY_SIZE(summary_tables)];
+	FILE *file;
+	int i, k;
+
+	if (!get_cache_file(sum->fn, sum->args, cache_file, sizeof(cache_file)))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(summary_tables); i++) {
+		nr_rows[i] = 0;
+		for (row = sum->rows[i]; row; row = row->next)
+			nr_rows[i]++;
+	}
+
+	/* written to a temp file and renamed so nothing sees half a file */
+	snprintf(tmp, sizeof(tmp), "%s.%d", cache_file, getpid());
+	file = fopen(tmp, "w");
+	if (!file)
+		return;
+	fprintf(file, "smatch inline cache %d %d\n", nr_rows[0], nr_rows[1]);
+	for (i = 0; i < ARRAY_SIZE(summary_tables); i++) {
+		table = get_mem_table(summary_tables[i]);
+		for (row = sum->rows[i]; row; row = row->next) {
+			for (k = 0; k < table->nr_cols; k++)
+				fwrite(row->vals[k], 1, strlen(row->vals[k]) + 1, file);
+		}
+	}
+	if (fclose(file) == 0)
+		rename(tmp, cache_file);
+	else
+		unlink(tmp);
+}
+
+bool mem_db_load_inline(struct symbol *fn, unsigned long long call_id)
+{
+	struct inline_summary *sum;
+	struct mem_table *table;
+	struct mem_row *row;
+	unsigned long long hash;
+	char *args;
+	int i;
+
+	args = get_inline_args(call_id);
+	hash = hash_args(fn, args);
+	for (sum = inline_cache[hash % INLINE_CACHE_HASH]; sum; sum = sum->next) {
+		if (sum->fn == fn && sum->hash == hash &&
+		    strcmp(sum->args, args) == 0)
+			break;
+	}
+	if (!sum) {
+		sum = read_cache_file(fn, args);
+		if (!sum) {
+			free(args);
+			return false;
+		}
+		add_summary(sum);
+	} else {
+		free(args);
+	}
+
+	db_debug("mem-db: reusing inline summary for %s\n", fn->ident ? fn->ident->name : "");
+	for (i = 0; i < ARRAY_SIZE(summary_tables); i++) {
+		table = get_mem_table(summary_tables[i]);
+		for (row = sum->rows[i]; row; row = row->next)
+			add_row(table, copy_row(table, row, call_id), table->unique);
+	}
+	return true;
+}
+
+void mem_db_save_inline(struct symbol *fn, unsigned long long call_id)
+{
+	struct inline_summary *sum;
+	struct mem_table *table;
+	struct mem_row *row, **tail;
+	int i;
+
+	sum = calloc(1, sizeof(*sum));
+	sum->fn = fn;
+	sum->args = get_inline_args(call_id);
+	sum->hash = hash_args(fn, sum->args);
+	for (i = 0; i < ARRAY_SIZE(summary_tables); i++) {
+		table = get_mem_table(summary_tables[i]);
+		tail = &sum->rows[i];
+		for (row = table->head[call_id_hash(call_id)]; row; row = row->next) {
+			if (row->call_id != call_id)
+				continue;
+			*tail = copy_row(table, row, 0);
+			tail = &(*tail)->next;
+		}
+	}
+	add_summary(sum);
+	write_cache_file(sum);
+}
+
+void mem_db_clear_inline_cache(void)
+{
+	struct inline_summary *sum, *next;
+	struct mem_row *row, *next_row;
+	int i, j;
+
+	for (i = 0; i < INLINE_CACHE_HASH; i++) {
+		for (sum = inline_cache[i]; sum; sum = next) {
+			next = sum->next;
+			for (j = 0; j < ARRAY_SIZE(summary_tables); j++) {
+				for (row = sum->rows[j]; row; row = next_row) {
+					next_row = row->next;
+					free(row);
+				}
+			}
+			free(sum->args);
+			free(sum);
+		}
+		inline_cache[i] = NULL;
+	}
+}
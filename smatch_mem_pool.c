@@ -0,0 +1,314 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * With "smatch --mem-pool" all the Smatch processes of a build share one
+ * memory budget instead of each one giving up on a function at a fixed
+ * --mem-budget.  The budget is three quarters of the cgroup memory limit
+ * (or of the RAM if there isn't one).  The processes find each other
+ * through a small file in /dev/shm named after the DB path, or after the
+ * name in --mem-pool=<name>, which is mapped shared.  Each process has a
+ * slot where it says how much the allocators are holding.
+ *
+ * A process always gets its fair share, the limit divided by the number of
+ * processes.  On top of that it can use whatever the others are not using
+ * so a big function can take most of the memory when the rest of the build
+ * is idle or is between functions.
+ *
+ * Only claiming a slot takes the lock.  Each process writes its own slot
+ * and the others read it without locking.  The numbers only have to be
+ * roughly right.  Slots of processes which died are taken back when a new
+ * process claims a slot or when a process is about to give up.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "smatch.h"
+
+#define POOL_MAGIC 0x736d706c
+#define POOL_SLOTS 512
+/* only publish and recompute when the usage moved this much */
+#define POOL_STEP_KB (8 * 1024)
+
+struct pool_slot {
+	int pid;
+	unsigned long kb;
+};
+
+struct mem_pool {
+	int magic;
+	unsigned long limit_kb;
+	struct pool_slot slots[POOL_SLOTS];
+};
+
+char *option_mem_pool;
+
+static struct mem_pool *pool;
+static int pool_fd = -1;
+static int my_slot = -1;
+static pid_t slot_pid;
+static unsigned long last_kb;
+static unsigned long budget_kb;
+static bool pool_low;
+
+static unsigned long read_kb_file(const char *path, unsigned long scale)
+{
+	char buf[64];
+	unsigned long long val;
+	FILE *file;
+
+	file = fopen(path, "r");
+	if (!file)
+		return 0;
+	if (!fgets(buf, sizeof(buf), file) || strncmp(buf, "max", 3) == 0) {
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+	val = strtoull(buf, NULL, 10);
+	return val / scale;
+}
+
+/* the smallest limit between the cgroup in "p" and the root */
+static unsigned long smallest_limit_kb(const char *fmt, char *p, unsigned long limit)
+{
+	char path[PATH_MAX + 64];
+	unsigned long kb;
+
+	while (*p) {
+		snprintf(path, sizeof(path), fmt, p);
+		kb = read_kb_file(path, 1024);
+		/* cgroup v1 says "no limit" with a huge number */
+		if (kb && kb < (1UL << 40) && (!limit || kb < limit))
+			limit = kb;
+		*strrchr(p, '/') = '\0';
+	}
+	return limit;
+}
+
+/* the cgroup memory limit in Kb or zero */
+static unsigned long cgroup_limit_kb(void)
+{
+	char line[PATH_MAX];
+	unsigned long limit = 0;
+	FILE *file;
+	char *p;
+
+	file = fopen("/proc/self/cgroup", "r");
+	if (!file)
+		return 0;
+	while (fgets(line, sizeof(line), file)) {
+		line[strcspn(line, "\n")] = '\0';
+		if (strncmp(line, "0::", 3) == 0) {
+			limit = smallest_limit_kb("/sys/fs/cgroup%s/memory.max",
+						  line + 3, limit);
+		} else if ((p = strstr(line, ":memory:"))) {
+			limit = smallest_limit_kb("/sys/fs/cgroup/memory%s/memory.limit_in_bytes",
+						  p + 8, limit);
+		}
+	}
+	fclose(file);
+	return limit;
+}
+
+static unsigned long total_ram_kb(void)
+{
+	long pages = sysconf(_SC_PHYS_PAGES);
+
+	if (pages <= 0)
+		return option_mem_budget * 1024UL;
+	return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static bool pid_is_dead(int pid)
+{
+	return kill(pid, 0) < 0 && errno == ESRCH;
+}
+
+/* called with the lock held */
+static void free_dead_slots(void)
+{
+	int i, pid;
+
+	for (i = 0; i < POOL_SLOTS; i++) {
+		pid = __atomic_load_n(&pool->slots[i].pid, __ATOMIC_RELAXED);
+		if (!pid || !pid_is_dead(pid))
+			continue;
+		__atomic_store_n(&pool->slots[i].kb, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&pool->slots[i].pid, 0, __ATOMIC_RELAXED);
+	}
+}
+
+static void release_slot(void)
+{
+	if (my_slot < 0 || slot_pid != getpid())
+		return;
+	__atomic_store_n(&pool->slots[my_slot].kb, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&pool->slots[my_slot].pid, 0, __ATOMIC_RELAXED);
+	my_slot = -1;
+}
+
+/* forked children inherit the mapping but they need a slot of their own */
+static void claim_slot(void)
+{
+	static bool registered;
+	int i;
+
+	slot_pid = getpid();
+	my_slot = -1;
+	last_kb = 0;
+	budget_kb = 0;
+
+	flock(pool_fd, LOCK_EX);
+	free_dead_slots();
+	for (i = 0; i < POOL_SLOTS; i++) {
+		if (pool->slots[i].pid)
+			continue;
+		__atomic_store_n(&pool->slots[i].kb, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&pool->slots[i].pid, slot_pid, __ATOMIC_RELAXED);
+		my_slot = i;
+		break;
+	}
+	flock(pool_fd, LOCK_UN);
+
+	if (!registered) {
+		atexit(release_slot);
+		registered = true;
+	}
+}
+
+void mem_pool_open(const char *db_file)
+{
+	char path[PATH_MAX];
+	const char *dir;
+	char *real;
+	struct stat st;
+	void *map;
+
+	if (!option_mem_pool)
+		return;
+
+	dir = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp";
+	if (option_mem_pool[0]) {
+		snprintf(path, sizeof(path), "%s/smatch-mem-%s", dir, option_mem_pool);
+	} else {
+		real = realpath(db_file, NULL);
+		snprintf(path, sizeof(path), "%s/smatch-mem-%llx", dir,
+			 str_to_llu_hash(real ?: db_file));
+		free(real);
+	}
+
+	pool_fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (pool_fd < 0)
+		goto fail;
+
+	flock(pool_fd, LOCK_EX);
+	if (fstat(pool_fd, &st) < 0 ||
+	    (st.st_size < (off_t)sizeof(*pool) && ftruncate(pool_fd, sizeof(*pool)) < 0)) {
+		flock(pool_fd, LOCK_UN);
+		goto fail;
+	}
+	map = mmap(NULL, sizeof(*pool), PROT_READ | PROT_WRITE, MAP_SHARED, pool_fd, 0);
+	if (map == MAP_FAILED) {
+		flock(pool_fd, LOCK_UN);
+		goto fail;
+	}
+	pool = map;
+	if (pool->magic != POOL_MAGIC) {
+		memset(pool, 0, sizeof(*pool));
+		pool->limit_kb = cgroup_limit_kb() ?: total_ram_kb();
+		pool->limit_kb = pool->limit_kb / 4 * 3;
+		pool->magic = POOL_MAGIC;
+	}
+	flock(pool_fd, LOCK_UN);
+	return;
+
+fail:
+	sm_ierror("--mem-pool: cannot use '%s'.  Using --mem-budget.", path);
+	if (pool_fd >= 0)
+		close(pool_fd);
+	pool_fd = -1;
+	option_mem_pool = NULL;
+}
+
+static void calculate_budget(unsigned long kb)
+{
+	unsigned long others = 0, fair, spare;
+	int i, pid, active = 0;
+
+	for (i = 0; i < POOL_SLOTS; i++) {
+		pid = __atomic_load_n(&pool->slots[i].pid, __ATOMIC_RELAXED);
+		if (!pid)
+			continue;
+		active++;
+		if (i != my_slot)
+			others += __atomic_load_n(&pool->slots[i].kb, __ATOMIC_RELAXED);
+	}
+
+	fair = pool->limit_kb / (active ?: 1);
+	spare = pool->limit_kb > others ? pool->limit_kb - others : 0;
+	budget_kb = fair > spare ? fair : spare;
+	pool_low = others + kb > pool->limit_kb / 8 * 7;
+}
+
+static void update_pool(void)
+{
+	unsigned long kb;
+
+	if (slot_pid != getpid())
+		claim_slot();
+	if (my_slot < 0)
+		return;
+
+	kb = get_allocated_kb();
+	if (budget_kb && kb + POOL_STEP_KB > last_kb && kb < last_kb + POOL_STEP_KB &&
+	    kb + POOL_STEP_KB < budget_kb)
+		return;
+	last_kb = kb;
+	__atomic_store_n(&pool->slots[my_slot].kb, kb, __ATOMIC_RELAXED);
+	calculate_budget(kb);
+
+	if (kb > budget_kb) {
+		flock(pool_fd, LOCK_EX);
+		free_dead_slots();
+		flock(pool_fd, LOCK_UN);
+		calculate_budget(kb);
+	}
+}
+
+/* how many Kb this process may hold before it gives up on a function */
+unsigned long mem_budget_kb(void)
+{
+	if (!pool)
+		return option_mem_budget * 1024UL;
+	update_pool();
+	if (my_slot < 0)
+		return option_mem_budget * 1024UL;
+	return budget_kb;
+}
+
+/* the other processes are using most of the pool, take the cheap paths */
+bool mem_pool_low(void)
+{
+	if (!pool)
+		return false;
+	update_pool();
+	return my_slot >= 0 && pool_low;
+}
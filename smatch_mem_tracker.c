@@ -70,13 +70,22 @@ static void match_end_func(struct symbol *sym)
 {
 	unsigned long size;
 
-	if (option_mem) {
+	if (option_mem || option_stats) {
 		size = get_mem_kb();
 		if (size > max_size)
 			max_size = size;
 	}
 }
 
+/*
+ * This is the memory that Smatch is actually holding.  Unlike statm it goes
+ * down again when the states are freed at the end of a function.
+ */
+unsigned long get_allocated_kb(void)
+{
+	return (allocated_blob_bytes + stree_bytes()) / 1024;
+}
+
 unsigned long get_max_memory(void)
 {
 	return max_size;
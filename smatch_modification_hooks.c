@@ -50,16 +50,16 @@ static struct smatch_state *alloc_my_state(struct expression *expr, struct smatc
 {
 	struct smatch_state *state;
 	struct modification_data *data;
+	char buf[VAR_LEN];
 	char *name;
 
 	expr = strip_expr(expr);
-	name = expr_to_str(expr);
+	name = expr_to_str_sym_buf(expr, NULL, buf, sizeof(buf));
 	if (!name)
 		return NULL;
 
 	state = __alloc_smatch_state(0);
 	state->name = alloc_sname(name);
-	free_string(name);
 
 	data = __alloc_modification_data(0);
 	data->prev = prev;
@@ -122,26 +122,93 @@ bool is_sub_member(const char *name, struct symbol *sym, struct sm_state *sm)
 	return false;
 }
 
+/*
+ * The states are sorted by owner and then by name so the states which
+ * is_sub_member() can match are in a few short ranges.  Either the name
+ * starts with "name" or it starts with one more '*' than "name" does.
+ * Both can have an '&' in front.  After the prefix there has to be a
+ * '-', a '.' or the end of the string and nothing which sorts after '.'
+ * can lead to one of those.
+ */
+static void add_prefix_matches(struct state_list **list, struct stree *stree,
+			       int owner, const char *prefix,
+			       const char *name, struct symbol *sym)
+{
+	AvlIter iter;
+	int len = strlen(prefix);
+
+	for (avl_iter_begin_name(&iter, stree, owner, prefix);
+	     iter.sm;
+	     avl_iter_next(&iter)) {
+		if (iter.sm->owner != owner)
+			break;
+		if (strncmp(iter.sm->name, prefix, len) != 0)
+			break;
+		if ((unsigned char)iter.sm->name[len] > '.')
+			break;
+		if (is_sub_member(name, sym, iter.sm))
+			add_ptr_list(list, iter.sm);
+	}
+}
+
+static int cmp_sm_ptr(const void *one, const void *two)
+{
+	return cmp_tracker(one, two);
+}
+
 static void call_modification_hooks_name_sym(char *name, struct symbol *sym, struct expression *mod_expr, int late)
 {
-	struct sm_state *sm;
+	struct state_list *list = NULL;
+	struct stree *stree;
+	struct sm_state *sm, *last = NULL;
 	struct smatch_state *prev;
-	int match;
+	char prefix[VAR_LEN];
+	unsigned long long start = 0;
+	int stars = 0;
+	int owner;
 
 	prev = get_state(my_id, name, sym);
 
 	if (cur_func_sym && !__in_fake_assign)
 		set_state(my_id, name, sym, alloc_my_state(mod_expr, prev));
 
-	FOR_EACH_SM_SAFE(__get_cur_stree(), sm) {
-		if (sm->owner > num_checks)
+	while (name[stars] == '*' && stars < VAR_LEN - 3)
+		stars++;
+
+	/*
+	 * Collect the states first.  The hooks change the cur_stree so
+	 * this used to clone the whole thing and look at every state.
+	 */
+	stree = __get_cur_stree();
+	for (owner = 0; owner < num_checks; owner++) {
+		if (!hooks[owner] && !hooks_late[owner])
 			continue;
-		if (!hooks[sm->owner] && !hooks_late[sm->owner])
+		if (!has_states(stree, owner))
 			continue;
-		match = is_sub_member(name, sym, sm);
-		if (!match)
+
+		add_prefix_matches(&list, stree, owner, name, name, sym);
+		snprintf(prefix, sizeof(prefix), "&%s", name);
+		add_prefix_matches(&list, stree, owner, prefix, name, sym);
+
+		memset(prefix, '*', stars + 1);
+		prefix[stars + 1] = '\0';
+		add_prefix_matches(&list, stree, owner, prefix, name, sym);
+		prefix[0] = '&';
+		memset(prefix + 1, '*', stars + 1);
+		prefix[stars + 2] = '\0';
+		add_prefix_matches(&list, stree, owner, prefix, name, sym);
+	}
+
+	/* the ranges can overlap and the hooks are called in stree order */
+	sort_list((struct ptr_list **)&list, cmp_sm_ptr);
+
+	FOR_EACH_PTR(list, sm) {
+		if (sm == last)
 			continue;
+		last = sm;
 
+		if (option_hook_profile)
+			start = __hook_profile_start();
 		if (late == EARLY || late == BOTH) {
 			if (hooks[sm->owner])
 				(hooks[sm->owner])(sm, mod_expr);
@@ -150,7 +217,10 @@ static void call_modification_hooks_name_sym(char *name, struct symbol *sym, str
 			if (hooks_late[sm->owner])
 				(hooks_late[sm->owner])(sm, mod_expr);
 		}
-	} END_FOR_EACH_SM_SAFE(sm);
+		if (option_hook_profile)
+			__hook_profile_stop(sm->owner, start);
+	} END_FOR_EACH_PTR(sm);
+	free_slist(&list);
 }
 
 static void call_modification_hooks(struct expression *expr, struct expression *mod_expr, int late)
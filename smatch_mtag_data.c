@@ -28,21 +28,43 @@
 static int my_id;
 static struct stree *vals;
 
-static int save_rl(void *_rl, int argc, char **argv, char **azColName)
+/*
+ * The values we've seen so far for this file.  The list is in the order they
+ * were last updated so the output is stable.
+ */
+struct mtag_value {
+	mtag_t tag;
+	int offset;
+	struct range_list *rl;
+	struct mtag_value *hash_next;
+	struct mtag_value *prev, *next;
+};
+
+#define MTAG_VALUE_HASH 4096
+static struct mtag_value *mtag_value_hash[MTAG_VALUE_HASH];
+static struct mtag_value *mtag_values_head, *mtag_values_tail;
+
+/* the low bits of a tag are always zero, they're for the offset */
+static unsigned int mtag_hash(mtag_t tag, int offset)
 {
-	unsigned long *rl = _rl;
+	return ((unsigned long long)tag / (MTAG_OFFSET_MASK + 1)) ^ offset;
+}
 
-	*rl = strtoul(argv[0], NULL, 10);
-	return 0;
+static struct mtag_value **find_mtag_value(mtag_t tag, int offset)
+{
+	struct mtag_value **p;
+
+	p = &mtag_value_hash[mtag_hash(tag, offset) % MTAG_VALUE_HASH];
+	while (*p && ((*p)->tag != tag || (*p)->offset != offset))
+		p = &(*p)->hash_next;
+	return p;
 }
 
 static struct range_list *select_orig(mtag_t tag, int offset)
 {
-	struct range_list *rl = NULL;
+	struct mtag_value *val = *find_mtag_value(tag, offset);
 
-	mem_sql(&save_rl, &rl, "select value from mtag_data where tag = %lld and offset = %d;",
-		tag, offset);
-	return rl;
+	return val ? val->rl : NULL;
 }
 
 static int is_kernel_param(const char *name)
@@ -117,17 +139,40 @@ static bool is_ignored_tag(mtag_t tag)
 
 static void insert_mtag_data(mtag_t tag, int offset, struct range_list *rl)
 {
+	struct mtag_value **p, *val;
+
 	if (in_fake_env)
 		return;
 	if (is_ignored_tag(tag))
 		return;
 
-	rl = clone_rl_permanent(rl);
+	p = find_mtag_value(tag, offset);
+	val = *p;
+	if (val) {
+		if (val->prev)
+			val->prev->next = val->next;
+		else
+			mtag_values_head = val->next;
+		if (val->next)
+			val->next->prev = val->prev;
+		else
+			mtag_values_tail = val->prev;
+	} else {
+		val = malloc(sizeof(*val));
+		val->tag = tag;
+		val->offset = offset;
+		val->hash_next = NULL;
+		*p = val;
+	}
+	val->rl = clone_rl_permanent(rl);
 
-	mem_sql(NULL, NULL, "delete from mtag_data where tag = %lld and offset = %d and type = %d",
-		tag, offset, DATA_VALUE);
-	mem_sql(NULL, NULL, "insert into mtag_data values (%lld, %d, %d, '%lu');",
-		tag, offset, DATA_VALUE, (unsigned long)rl);
+	val->prev = mtag_values_tail;
+	val->next = NULL;
+	if (mtag_values_tail)
+		mtag_values_tail->next = val;
+	else
+		mtag_values_head = val;
+	mtag_values_tail = val;
 }
 
 static bool invalid_type(struct symbol *type)
@@ -214,28 +259,16 @@ static void match_global_assign(struct expression *expr)
 	insert_mtag_data(tag, offset, rl);
 }
 
-static int save_mtag_data(void *_unused, int argc, char **argv, char **azColName)
+static void match_end_file(struct symbol_list *sym_list)
 {
-	struct range_list *rl;
+	struct mtag_value *val;
 
-	if (argc != 4) {
-		sm_msg("Error saving mtag data");
-		return 0;
-	}
 	if (!option_info)
-		return 0;
-
-	rl = (struct range_list *)strtoul(argv[3], NULL, 10);
-	sm_msg("SQL: insert or ignore into mtag_data values ('%s', '%s', '%s', '%s');",
-	       argv[0], argv[1], argv[2], show_rl(rl));
-
-	return 0;
-}
+		return;
 
-static void match_end_file(struct symbol_list *sym_list)
-{
-	mem_sql(&save_mtag_data, NULL, "select * from mtag_data where type = %d;",
-		DATA_VALUE);
+	for (val = mtag_values_head; val; val = val->next)
+		sm_msg("SQL: insert or ignore into mtag_data values ('%lld', '%d', '%d', '%s');",
+		       val->tag, val->offset, DATA_VALUE, show_rl(val->rl));
 }
 
 struct db_info {
@@ -243,20 +276,64 @@ struct db_info {
 	struct range_list *rl;
 };
 
-static int get_vals(void *_db_info, int argc, char **argv, char **azColName)
-{
-	struct db_info *db_info = _db_info;
-	struct range_list *tmp;
+/*
+ * The mtag_data rows from the DB.  The DB doesn't change while we're running
+ * so each (tag, offset) is only selected once.  The values are saved as
+ * strings because the range lists are freed at the end of every function.
+ */
+struct mtag_db_row {
+	mtag_t tag;
+	int offset;
+	struct string_list *values;
+	struct mtag_db_row *hash_next;
+};
 
-	str_to_rl(db_info->type, argv[0], &tmp);
-	if (db_info->rl)
-		db_info->rl = rl_union(db_info->rl, tmp);
-	else
-		db_info->rl = tmp;
+#define MTAG_DB_HASH 4096
+static struct mtag_db_row *mtag_db_hash[MTAG_DB_HASH];
+
+static int save_db_value(void *_row, int argc, char **argv, char **azColName)
+{
+	struct mtag_db_row *row = _row;
+	char *value = alloc_string(argv[0]);
 
+	add_ptr_list(&row->values, value);
 	return 0;
 }
 
+static struct mtag_db_row *get_db_row(mtag_t tag, int offset)
+{
+	struct mtag_db_row **p, *row;
+
+	p = &mtag_db_hash[mtag_hash(tag, offset) % MTAG_DB_HASH];
+	while (*p && ((*p)->tag != tag || (*p)->offset != offset))
+		p = &(*p)->hash_next;
+	if (*p)
+		return *p;
+
+	row = calloc(1, sizeof(*row));
+	row->tag = tag;
+	row->offset = offset;
+	run_sql(save_db_value, row,
+		"select value from mtag_data where tag = %lld and offset = %d and type = %d;",
+		tag, offset, DATA_VALUE);
+	*p = row;
+	return row;
+}
+
+static void get_vals(struct db_info *db_info, mtag_t tag, int offset)
+{
+	struct range_list *tmp;
+	char *value;
+
+	FOR_EACH_PTR(get_db_row(tag, offset)->values, value) {
+		str_to_rl(db_info->type, value, &tmp);
+		if (db_info->rl)
+			db_info->rl = rl_union(db_info->rl, tmp);
+		else
+			db_info->rl = tmp;
+	} END_FOR_EACH_PTR(value);
+}
+
 struct db_cache_results {
 	mtag_t tag;
 	struct range_list *rl;
@@ -288,9 +365,7 @@ static int get_rl_from_mtag_offset(mtag_t tag, int offset, struct symbol *type,
 		goto update_cache;
 
 	db_info.type = type;
-	run_sql(get_vals, &db_info,
-		"select value from mtag_data where tag = %lld and offset = %d and type = %d;",
-		tag, offset, DATA_VALUE);
+	get_vals(&db_info, tag, offset);
 	if (!db_info.rl)
 		goto update_cache;
 	db_info.rl = rl_union(mem_rl, db_info.rl);
@@ -277,8 +277,6 @@ static void match_strnlen_test(struct expression *expr)
 	struct expression *left, *tmp, *arg;
 	int cnt;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
 	if (expr->op != SPECIAL_EQUAL && expr->op != SPECIAL_NOTEQUAL)
 		return;
 
@@ -318,7 +316,7 @@ void register_nul_terminator(int id)
 	select_caller_info_hook(caller_info_terminated, TERMINATED);
 	select_return_states_hook(TERMINATED, return_info_terminated);
 
-	add_hook(&match_strnlen_test, CONDITION_HOOK);
+	add_expr_type_hook(&match_strnlen_test, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 }
 
 void register_nul_terminator_param_set(int id)
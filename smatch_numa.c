@@ -0,0 +1,116 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * With "smatch --batch=<file> --jobs=<n> --numa" each worker is tied to the
+ * CPUs of one NUMA node.  Linux gives a process memory from the node it is
+ * running on when the memory is first touched, so the allocator blobs, the
+ * strees and the SQLite page cache of a worker stay on its node instead of
+ * being spread over the machine as the scheduler moves it around.  The
+ * --jobs workers of a file are forked from the batch worker so they stay on
+ * the same node.
+ *
+ * Nodes without CPUs, or without any CPUs we are allowed to run on, are left
+ * out.  With only one node left this does nothing.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include "smatch.h"
+
+#define MAX_NODES 64
+
+static int nr_nodes = -1;
+static int node_ids[MAX_NODES];
+static cpu_set_t node_cpus[MAX_NODES];
+
+static bool parse_cpulist(const char *p, cpu_set_t *set)
+{
+	long first, last;
+	char *end;
+
+	CPU_ZERO(set);
+	while (*p && *p != '\n') {
+		first = strtol(p, &end, 10);
+		if (end == p)
+			return false;
+		last = first;
+		p = end;
+		if (*p == '-') {
+			last = strtol(p + 1, &end, 10);
+			if (end == p + 1)
+				return false;
+			p = end;
+		}
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, set);
+		if (*p == ',')
+			p++;
+	}
+	return true;
+}
+
+static void load_nodes(void)
+{
+	cpu_set_t allowed, cpus;
+	char path[64], buf[4096];
+	FILE *file;
+	bool ok;
+	int node;
+
+	nr_nodes = 0;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return;
+
+	/* the node numbers can have gaps */
+	for (node = 0; node < MAX_NODES; node++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+		file = fopen(path, "r");
+		if (!file)
+			continue;
+		ok = fgets(buf, sizeof(buf), file) && parse_cpulist(buf, &cpus);
+		fclose(file);
+		if (!ok)
+			continue;
+		CPU_AND(&cpus, &cpus, &allowed);
+		if (!CPU_COUNT(&cpus))
+			continue;
+		node_ids[nr_nodes] = node;
+		node_cpus[nr_nodes] = cpus;
+		nr_nodes++;
+	}
+}
+
+/* the number of nodes a worker can be put on, less than two means don't */
+int numa_nr_nodes(void)
+{
+	if (nr_nodes < 0)
+		load_nodes();
+	return nr_nodes;
+}
+
+/* the system's number for the node at idx */
+int numa_node_id(int idx)
+{
+	return node_ids[idx];
+}
+
+void numa_bind_node(int idx)
+{
+	if (idx < 0 || idx >= numa_nr_nodes())
+		return;
+	if (sched_setaffinity(0, sizeof(node_cpus[idx]), &node_cpus[idx]) < 0)
+		sm_ierror("--numa: cannot bind to node %d", node_ids[idx]);
+}
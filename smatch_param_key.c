@@ -613,11 +613,41 @@ free:
 	return alloc_string(ret);
 }
 
+/*
+ * The return info hooks ask about every state for the same return
+ * expression so remember the name of the last one instead of building it
+ * each time.
+ */
+static struct expression *ret_name_expr;
+static char *ret_name;
+static struct symbol *ret_name_sym;
+
+static char *get_return_name_sym(struct expression *ret_expr, struct symbol **sym)
+{
+	struct expression *fake;
+
+	if (ret_expr != ret_name_expr) {
+		free_string(ret_name);
+		fake = get_fake_return_variable(ret_expr);
+		ret_name = expr_to_str_sym(fake ?: ret_expr, &ret_name_sym);
+		ret_name_expr = ret_expr;
+	}
+	*sym = ret_name_sym;
+	return ret_name;
+}
+
+static void clear_return_name(struct symbol *sym)
+{
+	free_string(ret_name);
+	ret_name = NULL;
+	ret_name_expr = NULL;
+	ret_name_sym = NULL;
+}
+
 int get_return_param_key_from_var_sym(const char *name, struct symbol *sym,
 				      struct expression *ret_expr,
 				      const char **key)
 {
-	struct expression *fake;
 	const char *param_name;
 	struct symbol *ret_sym;
 	char *ret_str;
@@ -628,21 +658,15 @@ int get_return_param_key_from_var_sym(const char *name, struct symbol *sym,
 	if (!ret_expr)
 		return -2;
 
-	fake = get_fake_return_variable(ret_expr);
-	if (fake)
-		ret_str = expr_to_str_sym(fake, &ret_sym);
-	else
-		ret_str = expr_to_str_sym(ret_expr, &ret_sym);
+	ret_str = get_return_name_sym(ret_expr, &ret_sym);
 	if (ret_str && ret_sym == sym) {
 		param_name = state_name_to_param_name(name, ret_str);
 		if (param_name) {
-			free_string(ret_str);
 			if (key)
 				*key = param_name;
 			return -1;
 		}
 	}
-	free_string(ret_str);
 
 	return -2;
 }
@@ -1089,5 +1113,6 @@ void register_param_key(int id)
 	add_hook(&match_assign, ASSIGNMENT_HOOK_AFTER);
 	add_return_string_hook(return_str_hook);
 	add_modification_hook(my_id, &set_undefined);
+	add_hook(&clear_return_name, AFTER_FUNC_HOOK);
 }
 
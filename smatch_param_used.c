@@ -125,7 +125,8 @@ void register_param_used(int id)
 	add_hook(&match_function_def, AFTER_FUNC_HOOK);
 	add_function_data((unsigned long *)&used_stree);
 
-	add_get_state_hook(&get_state_hook);
+	if (option_info)
+		add_get_state_hook(&get_state_hook, GET_STATE_PARAMS);
 
 	select_return_implies_hook(PARAM_USED, &set_param_used);
 	all_return_states_hook(&process_states);
@@ -45,6 +45,11 @@ int is_skipped_function(void)
 	return skipped;
 }
 
+int is_skipped_function_name(const char *func)
+{
+	return skipped_funcs && search_func(skipped_funcs, (char *)func);
+}
+
 static void match_function_def(struct symbol *sym)
 {
 	char *macro;
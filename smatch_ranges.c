@@ -25,6 +25,9 @@ ALLOCATOR(data_range, "data range");
 __DO_ALLOCATOR(struct data_range, sizeof(struct data_range), __alignof__(struct data_range),
 			 "permanent ranges", perm_data_range);
 __DECLARE_ALLOCATOR(struct ptr_list, rl_ptrlist);
+__DECLARE_ALLOCATOR(struct ptr_list, small_rl_ptrlist);
+
+extern int rl_ptrlist_hack;
 
 bool is_err_ptr(sval_t sval)
 {
@@ -169,6 +172,7 @@ char *show_rl(struct range_list *list)
 void free_all_rl(void)
 {
 	clear_rl_ptrlist_alloc();
+	clear_small_rl_ptrlist_alloc();
 }
 
 static int sval_too_big(struct symbol *type, sval_t sval)
@@ -673,6 +677,84 @@ static void str_to_rl_helper(struct expression *call, struct symbol *type, const
 	*endp = c;
 }
 
+/*
+ * The same range strings come back from the DB over and over.  If there
+ * isn't any call math then the range list only depends on the type and the
+ * text so remember those for the rest of the run.  The cached lists are
+ * permanent and users get a copy because they sometimes modify them.
+ */
+#define RL_CACHE_HASH 4096
+#define RL_CACHE_MAX 50000
+
+struct rl_cache_entry {
+	struct rl_cache_entry *next;
+	struct symbol *type;
+	struct range_list *rl;
+	char str[];
+};
+
+static struct rl_cache_entry *rl_cache[RL_CACHE_HASH];
+static int rl_cache_cnt;
+
+static unsigned int rl_cache_hash(struct symbol *type, const char *str)
+{
+	unsigned long hash = (unsigned long)type;
+
+	while (*str)
+		hash = hash * 33 + *str++;
+	return hash % RL_CACHE_HASH;
+}
+
+static struct range_list *copy_cached_rl(struct range_list *rl)
+{
+	struct range_list *ret = NULL;
+	struct data_range *tmp;
+
+	rl_ptrlist_hack = 1;
+	FOR_EACH_PTR(rl, tmp) {
+		add_ptr_list(&ret, tmp);
+	} END_FOR_EACH_PTR(tmp);
+	rl_ptrlist_hack = 0;
+	return ret;
+}
+
+static bool get_cached_rl(struct symbol *type, const char *str, struct range_list **rl)
+{
+	struct rl_cache_entry *entry;
+
+	for (entry = rl_cache[rl_cache_hash(type, str)]; entry; entry = entry->next) {
+		if (entry->type == type && strcmp(entry->str, str) == 0) {
+			*rl = copy_cached_rl(entry->rl);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void cache_rl(struct symbol *type, const char *str, struct range_list *rl)
+{
+	struct rl_cache_entry *entry;
+	struct data_range *tmp, *perm;
+	unsigned int hash;
+
+	if (rl_cache_cnt >= RL_CACHE_MAX)
+		return;
+
+	entry = malloc(sizeof(*entry) + strlen(str) + 1);
+	entry->type = type;
+	entry->rl = NULL;
+	FOR_EACH_PTR(rl, tmp) {
+		perm = alloc_range_perm(tmp->min, tmp->max);
+		add_ptr_list(&entry->rl, perm);
+	} END_FOR_EACH_PTR(tmp);
+	strcpy(entry->str, str);
+
+	hash = rl_cache_hash(type, str);
+	entry->next = rl_cache[hash];
+	rl_cache[hash] = entry;
+	rl_cache_cnt++;
+}
+
 static void str_to_dinfo(struct expression *call, struct symbol *type, const char *value, struct data_info *dinfo)
 {
 	struct range_list *math_rl;
@@ -686,6 +768,11 @@ static void str_to_dinfo(struct expression *call, struct symbol *type, const cha
 	if (strcmp(value, "empty") == 0)
 		return;
 
+	if (get_cached_rl(type, value, &rl)) {
+		dinfo->value_ranges = rl;
+		return;
+	}
+
 	if (strncmp(value, "[==$", 4) == 0) {
 		struct expression *arg;
 		int comparison;
@@ -698,8 +785,12 @@ static void str_to_dinfo(struct expression *call, struct symbol *type, const cha
 	}
 
 	str_to_rl_helper(call, type, value, &c, &rl);
-	if (*c == '\0')
-		goto cast;
+	if (*c == '\0') {
+		rl = cast_rl(type, rl);
+		cache_rl(type, value, rl);
+		dinfo->value_ranges = rl;
+		return;
+	}
 
 	call_math = jump_to_call_math(value);
 	if (call_math && call_math[0] == 'r') {
@@ -915,6 +1006,74 @@ struct data_range *alloc_range_perm(sval_t min, sval_t max)
 	return alloc_range_helper_sval(min, max, 1);
 }
 
+/*
+ * Most range lists are built out of the same few ranges.  Once add_range()
+ * is done with a data_range it's never modified so those are shared.  The
+ * table is cleared along with the data_range allocations.
+ */
+static struct data_range **range_table;
+static unsigned int range_table_size;
+static unsigned int range_table_used;
+
+static unsigned long hash_range(sval_t min, sval_t max)
+{
+	unsigned long hash = 5381;
+
+	hash = hash * 33 + min.uvalue;
+	hash = hash * 33 + max.uvalue;
+	hash = hash * 33 + (unsigned long)min.type;
+	hash = hash * 33 + (unsigned long)max.type;
+	return hash;
+}
+
+static void grow_range_table(void)
+{
+	struct data_range **old = range_table;
+	unsigned int old_size = range_table_size;
+	unsigned int i, idx;
+
+	range_table_size = old_size ? old_size * 2 : 1024;
+	range_table = calloc(range_table_size, sizeof(*range_table));
+	for (i = 0; i < old_size; i++) {
+		if (!old[i])
+			continue;
+		idx = hash_range(old[i]->min, old[i]->max) & (range_table_size - 1);
+		while (range_table[idx])
+			idx = (idx + 1) & (range_table_size - 1);
+		range_table[idx] = old[i];
+	}
+	free(old);
+}
+
+static struct data_range *get_shared_range(sval_t min, sval_t max)
+{
+	struct data_range *ret;
+	unsigned int idx;
+
+	if ((range_table_used + 1) * 2 > range_table_size)
+		grow_range_table();
+
+	idx = hash_range(min, max) & (range_table_size - 1);
+	while ((ret = range_table[idx])) {
+		if (sval_identical(ret->min, min) && sval_identical(ret->max, max))
+			return ret;
+		idx = (idx + 1) & (range_table_size - 1);
+	}
+
+	ret = alloc_range(min, max);
+	range_table[idx] = ret;
+	range_table_used++;
+	return ret;
+}
+
+static void clear_range_table(void)
+{
+	if (!range_table_used)
+		return;
+	memset(range_table, 0, range_table_size * sizeof(*range_table));
+	range_table_used = 0;
+}
+
 struct range_list *alloc_rl(sval_t min, sval_t max)
 {
 	struct range_list *rl = NULL;
@@ -990,7 +1149,6 @@ out:
 	return ret;
 }
 
-extern int rl_ptrlist_hack;
 void add_range(struct range_list **list, sval_t min, sval_t max)
 {
 	struct data_range *tmp;
@@ -1033,6 +1191,22 @@ void add_range(struct range_list **list, sval_t min, sval_t max)
 	if (collapse_pointer_rl(list, min, max))
 		return;
 
+	/*
+	 * The lists are sorted so if the new range is above the last range and
+	 * not touching it, then it goes on the end.  This is the common case
+	 * when a list is built up in order.
+	 */
+	tmp = last_ptr_list((struct ptr_list *)*list);
+	if (tmp && !sval_is_fp(min) && !sval_is_fp(tmp->max) &&
+	    sval_cmp(min, tmp->max) > 0 &&
+	    (sval_is_min(min) || min.value - 1 != tmp->max.value)) {
+		new = get_shared_range(min, max);
+		rl_ptrlist_hack = 1;
+		add_ptr_list(list, new);
+		rl_ptrlist_hack = 0;
+		return;
+	}
+
 	/*
 	 * FIXME:  This has a problem merging a range_list like: min-0,3-max
 	 * with a range like 1-2.  You end up with min-2,3-max instead of
@@ -1067,13 +1241,15 @@ void add_range(struct range_list **list, sval_t min, sval_t max)
 		}
 		if (!sval_is_max(max) && max.value + 1 == tmp->min.value) {
 			/* join 2 ranges into a big range */
-			new = alloc_range(min, tmp->max);
+			new = get_shared_range(min, tmp->max);
 			REPLACE_CURRENT_PTR(tmp, new);
 			return;
 		}
 		if (sval_cmp(max, tmp->min) < 0) { /* new range entirely below */
-			new = alloc_range(min, max);
+			new = get_shared_range(min, max);
+			rl_ptrlist_hack = 1;
 			INSERT_CURRENT(new, tmp);
+			rl_ptrlist_hack = 0;
 			return;
 		}
 		if (sval_cmp(min, tmp->min) < 0) { /* new range partially below */
@@ -1081,7 +1257,11 @@ void add_range(struct range_list **list, sval_t min, sval_t max)
 				max = tmp->max;
 			else
 				check_next = 1;
-			new = alloc_range(min, max);
+			/* check_next means new->max might still change */
+			if (check_next)
+				new = alloc_range(min, max);
+			else
+				new = get_shared_range(min, max);
 			REPLACE_CURRENT_PTR(tmp, new);
 			if (!check_next)
 				return;
@@ -1107,7 +1287,7 @@ void add_range(struct range_list **list, sval_t min, sval_t max)
 	} END_FOR_EACH_PTR(tmp);
 	if (check_next)
 		return;
-	new = alloc_range(min, max);
+	new = get_shared_range(min, max);
 
 	rl_ptrlist_hack = 1;
 	add_ptr_list(list, new);
@@ -1138,10 +1318,114 @@ struct range_list *clone_rl_permanent(struct range_list *list)
 	return ret;
 }
 
+/*
+ * If both lists are plain integer lists of the same type then we can merge
+ * them in one pass instead of calling add_range() for each range.  The
+ * svals are turned into u64 keys which sort the same way as sval_cmp() so
+ * the loops don't have to look at the types again.  That only works if the
+ * values already fit in the type sval_cmp() casts to, so check that first.
+ */
+static inline unsigned long long rl_key(bool uns, sval_t sval)
+{
+	if (uns)
+		return sval.uvalue;
+	return sval.uvalue ^ (1ULL << 63);
+}
+
+static inline bool fits_bits(int bits, bool uns, sval_t sval)
+{
+	if (bits >= 64)
+		return true;
+	if (uns)
+		return (sval.uvalue >> bits) == 0;
+	return sval.value >= -(1LL << (bits - 1)) && sval.value < (1LL << (bits - 1));
+}
+
+static bool fast_rl_ok(struct symbol *type, bool uns, struct range_list *rl)
+{
+	struct data_range *tmp;
+	int bits;
+
+	bits = type_bits(type) < 31 ? 32 : type_bits(type);
+	FOR_EACH_PTR(rl, tmp) {
+		if (tmp->min.type != type || tmp->max.type != type)
+			return false;
+		if (!fits_bits(bits, uns, tmp->min) || !fits_bits(bits, uns, tmp->max))
+			return false;
+		if (rl_key(uns, tmp->min) > rl_key(uns, tmp->max))
+			return false;
+	} END_FOR_EACH_PTR(tmp);
+	return true;
+}
+
+static bool fast_rl_type(struct symbol *type, bool *uns, struct range_list *one,
+			 struct range_list *two)
+{
+	if (!one || !two)
+		return false;
+	if (type_is_ptr(type) || type_is_fp(type))
+		return false;
+	*uns = type_bits(type) >= 31 && type_unsigned(type);
+	return fast_rl_ok(type, *uns, one) && fast_rl_ok(type, *uns, two);
+}
+
+static void append_range(struct range_list **list, sval_t min, sval_t max)
+{
+	struct data_range *new = get_shared_range(min, max);
+
+	rl_ptrlist_hack = 1;
+	add_ptr_list(list, new);
+	rl_ptrlist_hack = 0;
+}
+
+static struct range_list *fast_rl_union(bool uns, struct range_list *one_rl,
+					struct range_list *two_rl)
+{
+	struct data_range *one, *two, *tmp;
+	struct range_list *ret = NULL;
+	sval_t min, max;
+	bool have = false;
+
+	PREPARE_PTR_LIST(one_rl, one);
+	PREPARE_PTR_LIST(two_rl, two);
+	while (one || two) {
+		if (!two || (one && rl_key(uns, one->min) <= rl_key(uns, two->min))) {
+			tmp = one;
+			NEXT_PTR_LIST(one);
+		} else {
+			tmp = two;
+			NEXT_PTR_LIST(two);
+		}
+
+		if (have &&
+		    (rl_key(uns, tmp->min) <= rl_key(uns, max) ||
+		     (!sval_is_min(tmp->min) && tmp->min.value - 1 == max.value))) {
+			if (rl_key(uns, tmp->max) > rl_key(uns, max))
+				max = tmp->max;
+			continue;
+		}
+		if (have)
+			append_range(&ret, min, max);
+		min = tmp->min;
+		max = tmp->max;
+		have = true;
+	}
+	FINISH_PTR_LIST(two);
+	FINISH_PTR_LIST(one);
+
+	if (have)
+		append_range(&ret, min, max);
+	return ret;
+}
+
 struct range_list *rl_union(struct range_list *one, struct range_list *two)
 {
 	struct data_range *tmp;
 	struct range_list *ret = NULL;
+	bool uns;
+
+	if (fast_rl_type(rl_type(one), &uns, one, two))
+		return fast_rl_union(uns, one, two);
 
 	FOR_EACH_PTR(one, tmp) {
 		add_range(&ret, tmp->min, tmp->max);
@@ -1152,6 +1436,36 @@ struct range_list *rl_union(struct range_list *one, struct range_list *two)
 	return ret;
 }
 
+/*
+ * Union a lot of range lists at once.  They are merged in pairs so a switch
+ * statement with hundreds of cases doesn't redo the whole list for each one.
+ */
+struct range_list *rl_union_stack(struct range_list_stack *stack)
+{
+	struct range_list **rls;
+	struct range_list *rl;
+	int nr, i, step;
+
+	nr = ptr_list_size((struct ptr_list *)stack);
+	if (!nr)
+		return NULL;
+
+	rls = malloc(nr * sizeof(*rls));
+	i = 0;
+	FOR_EACH_PTR(stack, rl) {
+		rls[i++] = rl;
+	} END_FOR_EACH_PTR(rl);
+
+	for (step = 1; step < nr; step *= 2) {
+		for (i = 0; i + step < nr; i += step * 2)
+			rls[i] = rl_union(rls[i], rls[i + step]);
+	}
+
+	rl = rls[0];
+	free(rls);
+	return rl;
+}
+
 struct range_list *remove_range(struct range_list *list, sval_t min, sval_t max)
 {
 	struct data_range *tmp;
@@ -1630,12 +1944,55 @@ struct range_list *cast_rl(struct symbol *type, struct range_list *rl)
 	return ret;
 }
 
+static struct range_list *fast_rl_filter(bool uns, struct range_list *rl,
+					 struct range_list *filter)
+{
+	struct data_range *tmp, *cut;
+	struct range_list *ret = NULL;
+	sval_t min, max;
+	bool done;
+
+	PREPARE_PTR_LIST(filter, cut);
+	FOR_EACH_PTR(rl, tmp) {
+		min = tmp->min;
+		max = tmp->max;
+		done = false;
+
+		while (cut && rl_key(uns, cut->max) < rl_key(uns, min))
+			NEXT_PTR_LIST(cut);
+		while (cut && rl_key(uns, cut->min) <= rl_key(uns, max)) {
+			if (rl_key(uns, cut->min) > rl_key(uns, min)) {
+				sval_t below = cut->min;
+
+				below.value--;
+				add_range(&ret, min, below);
+			}
+			if (rl_key(uns, cut->max) >= rl_key(uns, max)) {
+				done = true;
+				break;
+			}
+			min = cut->max;
+			min.value++;
+			NEXT_PTR_LIST(cut);
+		}
+		if (!done)
+			add_range(&ret, min, max);
+	} END_FOR_EACH_PTR(tmp);
+	FINISH_PTR_LIST(cut);
+
+	return ret;
+}
+
 /*
  * This is the opposite of rl_intersection().
  */
 struct range_list *rl_filter(struct range_list *rl, struct range_list *filter)
 {
 	struct data_range *tmp;
+	bool uns;
+
+	if (fast_rl_type(rl_type(rl), &uns, rl, filter))
+		return fast_rl_filter(uns, rl, filter);
 
 	FOR_EACH_PTR(filter, tmp) {
 		rl = remove_range(rl, tmp->min, tmp->max);
@@ -2161,19 +2518,24 @@ void free_data_info_allocs(void)
 	free_all_rl();
 	clear_math_cache();
 	clear_strip_cache();
+	clear_recurse_cache();
+	clear_sym_nrs();
 
 	desc->blobs = NULL;
 	desc->allocations = 0;
 	desc->total_bytes = 0;
 	desc->useful_bytes = 0;
 	desc->freelist = NULL;
+	desc->freelist_bytes = 0;
 	while (blob) {
 		struct allocation_blob *next = blob->next;
-		blob_free(blob, desc->chunking);
+		free_allocation_blob(desc, blob);
 		blob = next;
 	}
 	clear_array_values_cache();
 	clear_type_value_cache();
+	clear_estate_table();
+	clear_range_table();
 	clear_data_range_alloc();
 }
 
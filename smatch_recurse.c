@@ -111,6 +111,76 @@ int recurse(struct expression *expr,
 	return ret;
 }
 
+/*
+ * The checks call has_symbol() and friends on the same expressions over and
+ * over.  The first time, the expression is walked once the same way recurse()
+ * walks it and the summary records what recurse() returns when nothing
+ * matches, a bloom of the symbols it saw and whether it saw a ++ or --.  A
+ * symbol which isn't in the bloom means there is no need to walk it again.
+ *
+ * The cache is direct mapped like the one in smatch_math.c and cleared for
+ * each function.  Tmp and Fake expressions can be freed or reused so those
+ * aren't cached.
+ */
+#define RECURSE_CACHE_SIZE 4096
+
+struct recurse_summary {
+	struct expression *expr;
+	unsigned int gen;
+	int nothing_ret;
+	bool inc_dec;
+	unsigned long long syms;
+};
+static struct recurse_summary summaries[RECURSE_CACHE_SIZE];
+static unsigned int summary_gen = 1;
+
+void clear_recurse_cache(void)
+{
+	if (++summary_gen == 0) {
+		memset(summaries, 0, sizeof(summaries));
+		summary_gen = 1;
+	}
+}
+
+static unsigned long long sym_bit(struct symbol *sym)
+{
+	unsigned long ptr = (unsigned long)sym;
+
+	return 1ULL << (((ptr >> 4) ^ (ptr >> 10)) % 64);
+}
+
+static int summary_helper(struct expression *expr, void *_summary)
+{
+	struct recurse_summary *summary = _summary;
+
+	if (expr->type == EXPR_SYMBOL)
+		summary->syms |= sym_bit(expr->symbol);
+	if ((expr->type == EXPR_PREOP || expr->type == EXPR_POSTOP) &&
+	    (expr->op == SPECIAL_INCREMENT || expr->op == SPECIAL_DECREMENT))
+		summary->inc_dec = true;
+	return 0;
+}
+
+static struct recurse_summary *get_summary(struct expression *expr)
+{
+	struct recurse_summary *summary;
+	unsigned long ptr = (unsigned long)expr;
+
+	if (!expr || expr->smatch_flags & (Tmp | Fake))
+		return NULL;
+
+	summary = &summaries[((ptr >> 4) ^ (ptr >> 16)) % RECURSE_CACHE_SIZE];
+	if (summary->expr == expr && summary->gen == summary_gen)
+		return summary;
+
+	summary->expr = expr;
+	summary->gen = summary_gen;
+	summary->syms = 0;
+	summary->inc_dec = false;
+	summary->nothing_ret = recurse(expr, summary_helper, summary, 0);
+	return summary;
+}
+
 static int has_symbol_helper(struct expression *expr, void *_sym)
 {
 	struct symbol *sym = _sym;
@@ -124,6 +194,16 @@ static int has_symbol_helper(struct expression *expr, void *_sym)
 
 int has_symbol(struct expression *expr, struct symbol *sym)
 {
+	struct recurse_summary *summary;
+
+	/*
+	 * The walk stops at the first thing it can't handle, so a symbol
+	 * which wasn't seen before that gets the same answer as no symbol.
+	 */
+	summary = get_summary(expr);
+	if (summary && !(summary->syms & sym_bit(sym)))
+		return summary->nothing_ret;
+
 	return recurse(expr, has_symbol_helper, sym, 0);
 }
 
@@ -160,6 +240,7 @@ free:
 
 int has_variable(struct expression *expr, struct expression *var)
 {
+	struct recurse_summary *summary;
 	struct expr_name_sym xns;
 	int ret = -1;
 
@@ -167,6 +248,19 @@ int has_variable(struct expression *expr, struct expression *var)
 	xns.name = expr_to_var_sym(var, &xns.sym);
 	if (!xns.name || !xns.sym)
 		goto free;
+
+	/*
+	 * The symbol of a matching variable can be hidden in a statement
+	 * expression or past the depth limit, so this only skips the walk if
+	 * the summary saw the whole expression.
+	 */
+	summary = get_summary(expr);
+	if (summary && summary->nothing_ret == 0 &&
+	    !(summary->syms & sym_bit(xns.sym))) {
+		ret = 0;
+		goto free;
+	}
+
 	ret = recurse(expr, has_var_helper, &xns, 0);
 free:
 	free_string(xns.name);
@@ -186,6 +280,12 @@ static int has_inc_dec_helper(struct expression *expr, void *unused)
 
 int has_inc_dec(struct expression *expr)
 {
+	struct recurse_summary *summary;
+
+	summary = get_summary(expr);
+	if (summary)
+		return summary->inc_dec ? 1 : summary->nothing_ret;
+
 	return recurse(expr, has_inc_dec_helper, NULL, 0);
 }
 
@@ -0,0 +1,799 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * "smatch --result-cache=<dir>" is ccache for smatch.  The output for a file
+ * is saved in <dir> under a key made from:
+ *
+ *   - the command line and the smatch binary
+ *   - the size, mtime and inode of the DB and of every smatch_data/ file
+ *     which was loaded
+ *   - the preprocessed tokens of the file, with their positions
+ *   - the return_states of every function the file uses and the
+ *     caller_info of every function it defines
+ *
+ * When the key is already in <dir> the saved output is printed and the
+ * functions in the file are not looked at.  The file is still parsed because
+ * the key needs the preprocessed tokens.
+ *
+ * Rebuilding the DB or editing a smatch_data/ list changes every key, so
+ * nothing stale is printed.  The rows of the two tables are in the key as
+ * well because with --db-remote there is no DB file to look at.  Then only
+ * those two tables are checked.
+ *
+ * The preprocessor options (-D, -I, -include and so on) and the options which
+ * only name dependency or object files are left out of the command line part
+ * of the key, because what they do is already in the tokens.  That way the
+ * runs for different Kconfigs or build directories can share a cache and
+ * each of them only analyzes the files which came out different.  The working
+ * directory is only part of the key with --full-path.
+ *
+ * With --function-cache the output of each function is saved as well.  When
+ * a file has changed, a function whose key is already in <dir> has its
+ * output printed from there and only the other functions are analyzed.  The
+ * key of a function is made from:
+ *
+ *   - the command line, the smatch binary and the file name
+ *   - the same DB and smatch_data/ stamps as the file key
+ *   - the tokens outside of the function bodies, without their positions
+ *   - the tokens of the function itself, with their positions
+ *   - the tokens of the functions in the file which it names, because they
+ *     might be inlined
+ *   - the return_states of every function it names and its own caller_info
+ *
+ * So an edit which adds or removes lines means the functions after it are
+ * analyzed again, because their warnings have the line numbers in them.  A
+ * check which collects something over the whole file and prints it at the
+ * end only sees the functions which were analyzed.  For the warnings that is
+ * the same as with --jobs, but --info prints tables like mtag_data at the
+ * end of the file which would lose rows, so --info always analyzes every
+ * function of a changed file.  It doesn't work with --jobs either.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include "smatch.h"
+
+#define NR_STREAMS 3
+
+static FILE **cache_fds[NR_STREAMS] = { &sm_outfd, &sql_outfd, &caller_info_fd };
+static FILE *cache_orig[NR_STREAMS];
+static FILE *cache_mem[NR_STREAMS];
+static char *cache_buf[NR_STREAMS];
+static size_t cache_size[NR_STREAMS];
+
+/* the tokens are hashed in chunks instead of one EVP_DigestUpdate() each */
+struct text_hash {
+	EVP_MD_CTX *ctx;
+	char buf[4096];
+	int len;
+	int stream;
+};
+
+static unsigned char args_digest[EVP_MAX_MD_SIZE];
+static struct text_hash file_hash = { .stream = -1 };
+
+/* the DB and the smatch_data/ files */
+static unsigned long long db_stamp, data_stamp;
+
+static char cache_file[PATH_MAX];
+static bool capturing;
+static int start_errors, start_checks;
+
+int option_function_cache;
+
+#define MAX_TOKEN_LISTS 16
+
+static struct token *token_lists[MAX_TOKEN_LISTS];
+static int nr_token_lists;
+
+struct fn_key {
+	struct symbol *sym;
+	struct ident_list *idents;
+	unsigned char body[EVP_MAX_MD_SIZE];
+	unsigned char key[EVP_MAX_MD_SIZE];
+	unsigned int len;
+	bool found;
+};
+
+static struct fn_key *fn_keys;
+static int nr_fn_keys;
+static struct fn_key *cur_fn_key;
+static size_t fn_start[NR_STREAMS];
+static int fn_start_errors, fn_start_checks;
+
+struct ident_sum {
+	struct ident *ident;
+	unsigned long long sum;
+};
+
+#define IDENT_SUMS 4096
+static struct ident_sum *ident_sums;
+
+static void hash_bytes(EVP_MD_CTX *ctx, const void *data, size_t len)
+{
+	EVP_DigestUpdate(ctx, data, len);
+}
+
+static void hash_str(EVP_MD_CTX *ctx, const char *str)
+{
+	hash_bytes(ctx, str, strlen(str) + 1);
+}
+
+/*
+ * Returns the number of argv[] entries to leave out of the key, 0 to hash
+ * argv[i].
+ */
+static int skip_args(int argc, char **argv, int i)
+{
+	static const char *with_arg[] = {
+		"-D", "-U", "-I", "-include", "-imacros", "-isystem",
+		"-idirafter", "-iquote", "-MF", "-MT", "-MQ", "-o",
+	};
+	static const char *prefixes[] = { "-D", "-U", "-I", "-Wp,-M" };
+	static const char *alone[] = {
+		"-M", "-MM", "-MD", "-MMD", "-MP", "-MG", "-nostdinc",
+	};
+	const char *arg = argv[i];
+	int j;
+
+	/* these only say where the output goes */
+	if (!strncmp(arg, "--spool=", 8) ||
+	    !strncmp(arg, "--result-cache=", 15) ||
+	    !strcmp(arg, "--gzip"))
+		return 1;
+
+	for (j = 0; j < ARRAY_SIZE(with_arg); j++) {
+		if (strcmp(arg, with_arg[j]) == 0)
+			return i + 1 < argc ? 2 : 1;
+	}
+	for (j = 0; j < ARRAY_SIZE(prefixes); j++) {
+		if (strncmp(arg, prefixes[j], strlen(prefixes[j])) == 0)
+			return 1;
+	}
+	for (j = 0; j < ARRAY_SIZE(alone); j++) {
+		if (strcmp(arg, alone[j]) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+void result_cache_hash_args(int argc, char **argv)
+{
+	EVP_MD_CTX *ctx;
+	struct stat st;
+	bool full_path = false;
+	char *cwd;
+	int skip;
+	int i;
+
+	ctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+	for (i = 0; i < argc; i++) {
+		skip = skip_args(argc, argv, i);
+		if (skip) {
+			i += skip - 1;
+			continue;
+		}
+		if (!strcmp(argv[i], "--full-path"))
+			full_path = true;
+		hash_str(ctx, argv[i]);
+	}
+	if (full_path) {
+		cwd = getcwd(NULL, 0);
+		if (cwd)
+			hash_str(ctx, cwd);
+		free(cwd);
+	}
+	if (stat("/proc/self/exe", &st) == 0) {
+		hash_bytes(ctx, &st.st_size, sizeof(st.st_size));
+		hash_bytes(ctx, &st.st_mtime, sizeof(st.st_mtime));
+	}
+	EVP_DigestFinal_ex(ctx, args_digest, NULL);
+	EVP_MD_CTX_destroy(ctx);
+}
+
+static unsigned long long stat_hash(struct stat *st)
+{
+	unsigned long long vals[] = {
+		st->st_ino, st->st_size, st->st_mtim.tv_sec, st->st_mtim.tv_nsec,
+	};
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned char *p = (unsigned char *)vals;
+	int i;
+
+	for (i = 0; i < sizeof(vals); i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/* create_db.sh writes a new DB and renames it over the old one */
+void result_cache_hash_db(const char *db_file)
+{
+	struct stat st;
+
+	if (!option_result_cache || option_no_db || option_db_remote)
+		return;
+	if (option_db_replay)
+		db_file = option_db_replay;
+	if (stat(db_file, &st) == 0)
+		db_stamp = stat_hash(&st);
+}
+
+/* called for every smatch_data/ file which is opened */
+void result_cache_hash_data_file(int fd)
+{
+	struct stat st;
+
+	if (!option_result_cache || fstat(fd, &st) != 0)
+		return;
+	data_stamp = data_stamp * 31 + stat_hash(&st);
+}
+
+static void hash_stamps(EVP_MD_CTX *ctx)
+{
+	hash_bytes(ctx, &db_stamp, sizeof(db_stamp));
+	hash_bytes(ctx, &data_stamp, sizeof(data_stamp));
+}
+
+static void flush_text(struct text_hash *th)
+{
+	if (!th->ctx) {
+		th->ctx = EVP_MD_CTX_create();
+		EVP_DigestInit_ex(th->ctx, EVP_sha1(), NULL);
+	}
+	hash_bytes(th->ctx, th->buf, th->len);
+	th->len = 0;
+}
+
+static void add_text(struct text_hash *th, const char *text)
+{
+	int len = strlen(text) + 1;
+
+	if (th->len + len > sizeof(th->buf))
+		flush_text(th);
+	if (len > sizeof(th->buf)) {
+		hash_bytes(th->ctx, text, len);
+		return;
+	}
+	memcpy(th->buf + th->len, text, len);
+	th->len += len;
+}
+
+static void add_token(struct text_hash *th, struct token *token, bool lines)
+{
+	char pos[64];
+
+	if (token->pos.stream != th->stream) {
+		th->stream = token->pos.stream;
+		add_text(th, stream_name(th->stream));
+	}
+	if (lines && token->pos.newline) {
+		snprintf(pos, sizeof(pos), "%d", token->pos.line);
+		add_text(th, pos);
+	}
+	add_text(th, show_token(token));
+}
+
+/* this starts the text_hash over again */
+static void finish_text(struct text_hash *th, unsigned char *digest, unsigned int *len)
+{
+	flush_text(th);
+	EVP_DigestFinal_ex(th->ctx, digest, len);
+	EVP_MD_CTX_destroy(th->ctx);
+	th->ctx = NULL;
+	th->stream = -1;
+}
+
+/* This is the preprocessed_hook, it sees every preprocessed stream */
+void result_cache_hash_tokens(struct token *token)
+{
+	if (nr_token_lists < MAX_TOKEN_LISTS)
+		token_lists[nr_token_lists] = token;
+	nr_token_lists++;
+
+	for (; !eof_token(token); token = token->next)
+		add_token(&file_hash, token, true);
+}
+
+/* The rows can come back in any order so the row hashes are just added up */
+static int hash_rows(void *_sum, int argc, char **argv, char **azColName)
+{
+	unsigned long long *sum = _sum;
+	unsigned long long row = 14695981039346656037ULL;
+	const char *p;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		for (p = argv[i] ? argv[i] : ""; *p; p++) {
+			row ^= (unsigned char)*p;
+			row *= 1099511628211ULL;
+		}
+		row ^= 0xff;
+		row *= 1099511628211ULL;
+	}
+	*sum += row;
+	return 0;
+}
+
+static unsigned long long db_fingerprint(struct symbol_list *sym_list)
+{
+	unsigned long long sum = 0;
+	struct symbol *sym, *base;
+
+	FOR_EACH_PTR(sym_list, sym) {
+		if (sym->type != SYM_NODE || !sym->ident)
+			continue;
+		base = get_base_type(sym);
+		if (!base || base->type != SYM_FN)
+			continue;
+		if (sym->referenced)
+			run_sql(hash_rows, &sum,
+				"select return_id, return, static, type, parameter, key, value from return_states where function = '%q';",
+				sym->ident->name);
+		if (base->stmt || base->inline_stmt)
+			run_sql(hash_rows, &sum,
+				"select caller, static, type, parameter, key, value from caller_info where function = '%q';",
+				sym->ident->name);
+	} END_FOR_EACH_PTR(sym);
+
+	return sum;
+}
+
+/* sm_outfd, sql_outfd and caller_info_fd are often all stdout */
+static int first_stream(int i)
+{
+	int j;
+
+	for (j = 0; j < i; j++) {
+		if (cache_orig[j] == cache_orig[i])
+			return j;
+	}
+	return i;
+}
+
+static void start_capture(void)
+{
+	int i;
+
+	for (i = 0; i < NR_STREAMS; i++)
+		cache_orig[i] = *cache_fds[i];
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (first_stream(i) != i)
+			continue;
+		cache_mem[i] = open_memstream(&cache_buf[i], &cache_size[i]);
+		if (!cache_mem[i])
+			sm_fatal("open_memstream() failed");
+	}
+	for (i = 0; i < NR_STREAMS; i++)
+		*cache_fds[i] = cache_mem[first_stream(i)];
+	start_errors = sm_nr_errors;
+	start_checks = sm_nr_checks;
+	capturing = true;
+}
+
+static bool replay(FILE *file)
+{
+	size_t len[NR_STREAMS];
+	int errors, checks;
+	char *buf;
+	int i;
+
+	if (fscanf(file, "smatch result cache %d %d %zu %zu %zu\n", &errors,
+		   &checks, &len[0], &len[1], &len[2]) != 5)
+		return false;
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (!len[i])
+			continue;
+		buf = malloc(len[i]);
+		if (fread(buf, 1, len[i], file) != len[i]) {
+			free(buf);
+			return false;
+		}
+		fwrite(buf, 1, len[i], *cache_fds[i]);
+		free(buf);
+	}
+	sm_nr_errors += errors;
+	sm_nr_checks += checks;
+	return true;
+}
+
+static bool replay_file(const char *path)
+{
+	FILE *file;
+	bool ret;
+
+	file = fopen(path, "r");
+	if (!file)
+		return false;
+	ret = replay(file);
+	fclose(file);
+	return ret;
+}
+
+/* written to a temp file and renamed so nothing sees half a file */
+static void write_cache_file(const char *path, int errors, int checks,
+			     char *bufs[NR_STREAMS], size_t sizes[NR_STREAMS])
+{
+	char tmp[PATH_MAX + 32];
+	FILE *file;
+	int i;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+	file = fopen(tmp, "w");
+	if (!file)
+		return;
+	fprintf(file, "smatch result cache %d %d %zu %zu %zu\n", errors, checks,
+		bufs[0] ? sizes[0] : 0, bufs[1] ? sizes[1] : 0,
+		bufs[2] ? sizes[2] : 0);
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (bufs[i])
+			fwrite(bufs[i], 1, sizes[i], file);
+	}
+	if (fclose(file) == 0)
+		rename(tmp, path);
+	else
+		unlink(tmp);
+}
+
+static void digest_path(char *path, unsigned char *digest, unsigned int len)
+{
+	unsigned int i;
+	char *p;
+
+	p = path + snprintf(path, PATH_MAX - 2 * len - 1, "%s/", option_result_cache);
+	for (i = 0; i < len; i++)
+		p += sprintf(p, "%02x", digest[i]);
+}
+
+static int cmp_fn_key(const void *_a, const void *_b)
+{
+	const struct fn_key *a = _a;
+	const struct fn_key *b = _b;
+
+	if (a->sym == b->sym)
+		return 0;
+	return a->sym < b->sym ? -1 : 1;
+}
+
+static struct fn_key *find_fn_key(struct symbol *sym)
+{
+	struct fn_key key = { .sym = sym };
+
+	if (!nr_fn_keys)
+		return NULL;
+	return bsearch(&key, fn_keys, nr_fn_keys, sizeof(*fn_keys), cmp_fn_key);
+}
+
+static bool same_pos(struct position a, struct position b)
+{
+	return a.stream == b.stream && a.line == b.line && a.pos == b.pos;
+}
+
+/* the function whose name is "token" in its definition */
+static struct fn_key *fn_starting_at(struct token *token)
+{
+	struct fn_key *key;
+	struct symbol *sym;
+
+	if (token_type(token) != TOKEN_IDENT)
+		return NULL;
+	for (sym = token->ident->symbols; sym; sym = sym->next_id) {
+		if (!same_pos(sym->pos, token->pos))
+			continue;
+		key = find_fn_key(sym);
+		if (key && !key->found)
+			return key;
+	}
+	return NULL;
+}
+
+/*
+ * A function goes from its name to the '}' which closes the body.  The rest
+ * of the tokens go into "outside" without their line numbers.
+ */
+static void hash_fn_bodies(struct text_hash *outside)
+{
+	static struct text_hash body = { .stream = -1 };
+	struct fn_key *key = NULL;
+	struct token *token;
+	char pos[64];
+	int depth = 0;
+	int i;
+
+	for (i = 0; i < nr_token_lists && i < MAX_TOKEN_LISTS; i++) {
+		for (token = token_lists[i]; !eof_token(token); token = token->next) {
+			if (!key) {
+				key = fn_starting_at(token);
+				if (!key) {
+					add_token(outside, token, false);
+					continue;
+				}
+				/* the name might not start a line */
+				snprintf(pos, sizeof(pos), "%d", token->pos.line);
+				add_text(&body, pos);
+				depth = 0;
+			}
+			add_token(&body, token, true);
+			if (token_type(token) == TOKEN_IDENT)
+				add_ident(&key->idents, token->ident);
+			if (match_op(token, '{')) {
+				depth++;
+			} else if (match_op(token, '}') && --depth == 0) {
+				finish_text(&body, key->body, &key->len);
+				key->found = true;
+				key = NULL;
+			}
+		}
+	}
+	if (key)
+		finish_text(&body, key->body, &key->len);
+}
+
+static unsigned long long return_states_sum(struct ident *ident)
+{
+	static int nr_ident_sums;
+	unsigned long long sum = 0;
+	unsigned int h;
+
+	if (!ident_sums) {
+		ident_sums = calloc(IDENT_SUMS, sizeof(*ident_sums));
+		nr_ident_sums = 0;
+	}
+
+	h = ((unsigned long)ident >> 4) & (IDENT_SUMS - 1);
+	while (ident_sums[h].ident) {
+		if (ident_sums[h].ident == ident)
+			return ident_sums[h].sum;
+		h = (h + 1) & (IDENT_SUMS - 1);
+	}
+
+	run_sql(hash_rows, &sum,
+		"select return_id, return, static, type, parameter, key, value from return_states where function = '%q';",
+		ident->name);
+	if (nr_ident_sums < IDENT_SUMS / 2) {
+		ident_sums[h].ident = ident;
+		ident_sums[h].sum = sum;
+		nr_ident_sums++;
+	}
+	return sum;
+}
+
+/* the functions which "key" names, they might be called or inlined */
+static void hash_callees(EVP_MD_CTX *ctx, struct fn_key *key)
+{
+	struct symbol *sym, *base;
+	struct fn_key *callee;
+	unsigned long long sum;
+	struct ident *ident;
+	bool is_fn;
+
+	FOR_EACH_PTR(key->idents, ident) {
+		is_fn = false;
+		for (sym = ident->symbols; sym; sym = sym->next_id) {
+			if (sym->type != SYM_NODE)
+				continue;
+			base = get_base_type(sym);
+			if (!base || base->type != SYM_FN)
+				continue;
+			is_fn = true;
+			callee = find_fn_key(sym);
+			if (callee && callee != key && callee->found)
+				hash_bytes(ctx, callee->body, callee->len);
+		}
+		if (!is_fn)
+			continue;
+		hash_str(ctx, ident->name);
+		sum = return_states_sum(ident);
+		hash_bytes(ctx, &sum, sizeof(sum));
+	} END_FOR_EACH_PTR(ident);
+}
+
+static void make_fn_keys(struct symbol_list *sym_list)
+{
+	struct text_hash outside = { .stream = -1 };
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned long long sum;
+	struct symbol *sym, *base;
+	struct fn_key *key;
+	unsigned int len;
+	EVP_MD_CTX *ctx;
+	int i;
+
+	FOR_EACH_PTR(sym_list, sym) {
+		if (sym->type != SYM_NODE || !sym->ident)
+			continue;
+		base = get_base_type(sym);
+		if (!base || base->type != SYM_FN || !base->stmt)
+			continue;
+		if (nr_fn_keys % 64 == 0)
+			fn_keys = realloc(fn_keys, (nr_fn_keys + 64) * sizeof(*fn_keys));
+		memset(&fn_keys[nr_fn_keys], 0, sizeof(*fn_keys));
+		fn_keys[nr_fn_keys++].sym = sym;
+	} END_FOR_EACH_PTR(sym);
+	if (!nr_fn_keys)
+		return;
+	qsort(fn_keys, nr_fn_keys, sizeof(*fn_keys), cmp_fn_key);
+
+	hash_fn_bodies(&outside);
+	finish_text(&outside, digest, &len);
+
+	for (i = 0; i < nr_fn_keys; i++) {
+		key = &fn_keys[i];
+		if (!key->found)
+			continue;
+		ctx = EVP_MD_CTX_create();
+		EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+		hash_bytes(ctx, args_digest, sizeof(args_digest));
+		hash_stamps(ctx);
+		hash_str(ctx, get_base_file());
+		hash_bytes(ctx, digest, len);
+		hash_bytes(ctx, key->body, key->len);
+		hash_callees(ctx, key);
+		sum = 0;
+		run_sql(hash_rows, &sum,
+			"select caller, static, type, parameter, key, value from caller_info where function = '%q';",
+			key->sym->ident->name);
+		hash_bytes(ctx, &sum, sizeof(sum));
+		EVP_DigestFinal_ex(ctx, key->key, &key->len);
+		EVP_MD_CTX_destroy(ctx);
+	}
+}
+
+static void free_fn_keys(void)
+{
+	int i;
+
+	for (i = 0; i < nr_fn_keys; i++)
+		free_ptr_list(&fn_keys[i].idents);
+	free(fn_keys);
+	fn_keys = NULL;
+	nr_fn_keys = 0;
+	cur_fn_key = NULL;
+	free(ident_sums);
+	ident_sums = NULL;
+}
+
+/*
+ * Returns true if the output for "sym" was printed from the cache.
+ * Otherwise it is saved by result_cache_function_save() after the function
+ * has been analyzed.
+ */
+bool result_cache_function_lookup(struct symbol *sym)
+{
+	char path[PATH_MAX];
+	struct fn_key *key;
+	int i;
+
+	cur_fn_key = NULL;
+	if (!capturing)
+		return false;
+	key = find_fn_key(sym);
+	if (!key || !key->found)
+		return false;
+
+	digest_path(path, key->key, key->len);
+	if (replay_file(path))
+		return true;
+
+	cur_fn_key = key;
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (!cache_mem[i])
+			continue;
+		fflush(cache_mem[i]);
+		fn_start[i] = cache_size[i];
+	}
+	fn_start_errors = sm_nr_errors;
+	fn_start_checks = sm_nr_checks;
+	return false;
+}
+
+void result_cache_function_save(void)
+{
+	char *bufs[NR_STREAMS] = {};
+	size_t sizes[NR_STREAMS] = {};
+	char path[PATH_MAX];
+	int i;
+
+	if (!cur_fn_key)
+		return;
+
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (!cache_mem[i])
+			continue;
+		fflush(cache_mem[i]);
+		bufs[i] = cache_buf[i] + fn_start[i];
+		sizes[i] = cache_size[i] - fn_start[i];
+	}
+	digest_path(path, cur_fn_key->key, cur_fn_key->len);
+	write_cache_file(path, sm_nr_errors - fn_start_errors,
+			 sm_nr_checks - fn_start_checks, bufs, sizes);
+	cur_fn_key = NULL;
+}
+
+/*
+ * Returns true if the output for the file was printed from the cache.
+ * Otherwise the output is captured until result_cache_save().
+ */
+bool result_cache_lookup(struct symbol_list *sym_list)
+{
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned long long db_sum;
+	unsigned int len;
+	EVP_MD_CTX *ctx;
+
+	db_sum = db_fingerprint(sym_list);
+
+	ctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+	hash_bytes(ctx, args_digest, sizeof(args_digest));
+	hash_stamps(ctx);
+	hash_str(ctx, get_base_file());
+	finish_text(&file_hash, digest, &len);
+	hash_bytes(ctx, digest, len);
+	hash_bytes(ctx, &db_sum, sizeof(db_sum));
+	EVP_DigestFinal_ex(ctx, digest, &len);
+	EVP_MD_CTX_destroy(ctx);
+
+	digest_path(cache_file, digest, len);
+	if (replay_file(cache_file)) {
+		nr_token_lists = 0;
+		return true;
+	}
+
+	if (option_function_cache && !option_info && option_jobs <= 1)
+		make_fn_keys(sym_list);
+	nr_token_lists = 0;
+
+	start_capture();
+	return false;
+}
+
+void result_cache_save(void)
+{
+	int i;
+
+	if (!capturing)
+		return;
+	capturing = false;
+	free_fn_keys();
+
+	for (i = 0; i < NR_STREAMS; i++)
+		*cache_fds[i] = cache_orig[i];
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (!cache_mem[i])
+			continue;
+		fclose(cache_mem[i]);
+		cache_mem[i] = NULL;
+	}
+
+	write_cache_file(cache_file, sm_nr_errors - start_errors,
+			 sm_nr_checks - start_checks, cache_buf, cache_size);
+
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (!cache_buf[i])
+			continue;
+		fwrite(cache_buf[i], 1, cache_size[i], cache_orig[i]);
+		free(cache_buf[i]);
+		cache_buf[i] = NULL;
+		cache_size[i] = 0;
+	}
+}
@@ -102,13 +102,10 @@ char *map_long_to_short_name_sym(const char *name, struct symbol *sym, struct sy
 
 	*new_sym = NULL;
 
-	FOR_EACH_SM(__get_cur_stree(), sm) {
-		if (sm->owner == my_id) {
-			ret = map_my_state_long_to_short(sm, name, sym, new_sym, use_stack);
-			if (ret)
-				return ret;
-			continue;
-		}
+	FOR_EACH_MY_SM(my_id, __get_cur_stree(), sm) {
+		ret = map_my_state_long_to_short(sm, name, sym, new_sym, use_stack);
+		if (ret)
+			return ret;
 	} END_FOR_EACH_SM(sm);
 
 	return NULL;
@@ -31,6 +31,11 @@ static struct callback_list *callback_list;
 static struct stree_stack *return_stree_stack;
 static struct stree *all_return_states;
 
+static struct {
+	int nr;
+	struct return_path paths[];
+} *return_paths;
+
 void all_return_states_hook(void (*callback)(void))
 {
 	struct return_states_callback *rs_cb = __alloc_return_states_callback(0);
@@ -39,25 +44,73 @@ void all_return_states_hook(void (*callback)(void))
 	add_ptr_list(&callback_list, rs_cb);
 }
 
+/*
+ * The stree for each return is a copy of the cur_stree at that point so they
+ * share most of their nodes.  Merging them in pairs means the merges near the
+ * bottom are between strees which are mostly the same and the pair iterator
+ * skips the shared parts.  Merging them one at a time into all_return_states
+ * would compare every state in all_return_states against every return.
+ */
+static void merge_return_strees(void)
+{
+	struct stree **strees;
+	struct stree *stree;
+	int nr, i, step;
+
+	if (all_return_states)
+		return;
+
+	nr = ptr_list_size((struct ptr_list *)return_stree_stack);
+	if (!nr)
+		return;
+
+	strees = malloc(nr * sizeof(*strees));
+	i = 0;
+	FOR_EACH_PTR(return_stree_stack, stree) {
+		strees[i++] = clone_stree(stree);
+	} END_FOR_EACH_PTR(stree);
+
+	for (step = 1; step < nr; step *= 2) {
+		for (i = 0; i + step < nr; i += step * 2) {
+			merge_stree_no_pools(&strees[i], strees[i + step]);
+			free_stree(&strees[i + step]);
+		}
+	}
+
+	all_return_states = strees[0];
+	free(strees);
+}
+
 static void call_hooks(void)
 {
 	struct return_states_callback *rs_cb;
 	struct stree *orig;
 
+	merge_return_strees();
 	orig = __swap_cur_stree(all_return_states);
+	sql_group_rows_start();
 	FOR_EACH_PTR(callback_list, rs_cb) {
 		rs_cb->callback();
 	} END_FOR_EACH_PTR(rs_cb);
+	sql_group_rows_end();
 	__swap_cur_stree(orig);
 }
 
+static void free_return_paths(void)
+{
+	free(return_paths);
+	return_paths = NULL;
+}
+
 static void match_return(int return_id, char *return_ranges, struct expression *expr)
 {
 	struct stree *stree;
 
 	stree = clone_stree(__get_cur_stree());
-	merge_stree_no_pools(&all_return_states, stree);
 	push_stree(&return_stree_stack, stree);
+	/* it's merged again when it's needed */
+	free_stree(&all_return_states);
+	free_return_paths();
 }
 
 static void match_end_func(struct symbol *sym)
@@ -67,6 +120,7 @@ static void match_end_func(struct symbol *sym)
 
 struct stree *get_all_return_states(void)
 {
+	merge_return_strees();
 	return all_return_states;
 }
 
@@ -75,8 +129,74 @@ struct stree_stack *get_all_return_strees(void)
 	return return_stree_stack;
 }
 
+/*
+ * The checks which compare the returns against each other all used to look
+ * at every return once for each variable they track and work out again if
+ * the path is possible and what it returns.  That's done once here and the
+ * impossible returns and the ones without a return_ranges are left out.
+ */
+int get_return_paths(struct return_path **paths)
+{
+	struct stree *stree, *orig;
+	struct sm_state *return_sm;
+	struct return_path *path;
+	int nr;
+
+	if (return_paths) {
+		*paths = return_paths->paths;
+		return return_paths->nr;
+	}
+
+	nr = ptr_list_size((struct ptr_list *)return_stree_stack);
+	return_paths = calloc(1, sizeof(*return_paths) + nr * sizeof(*path));
+	FOR_EACH_PTR(return_stree_stack, stree) {
+		orig = __swap_cur_stree(stree);
+		if (is_impossible_path())
+			goto swap_stree;
+		return_sm = get_sm_state(RETURN_ID, "return_ranges", NULL);
+		if (!return_sm)
+			goto swap_stree;
+
+		path = &return_paths->paths[return_paths->nr++];
+		path->stree = stree;
+		path->return_sm = return_sm;
+		path->rl = estate_rl(return_sm->state);
+		path->line = sval_type_val(&int_ctype, return_sm->line);
+		path->bucket = success_fail_return(path->rl);
+swap_stree:
+		__swap_cur_stree(orig);
+	} END_FOR_EACH_PTR(stree);
+
+	*paths = return_paths->paths;
+	return return_paths->nr;
+}
+
+/*
+ * Call @callback for each of @owner's states in each possible return.  The
+ * return's stree is the cur_stree during the callback.
+ */
+void sweep_return_states(int owner,
+			 void (*callback)(struct return_path *path, struct sm_state *sm, void *data),
+			 void *data)
+{
+	struct return_path *paths;
+	struct stree *orig;
+	struct sm_state *sm;
+	int nr, i;
+
+	nr = get_return_paths(&paths);
+	for (i = 0; i < nr; i++) {
+		orig = __swap_cur_stree(paths[i].stree);
+		FOR_EACH_MY_SM(owner, paths[i].stree, sm) {
+			callback(&paths[i], sm, data);
+		} END_FOR_EACH_SM(sm);
+		__swap_cur_stree(orig);
+	}
+}
+
 static void free_resources(struct symbol *sym)
 {
+	free_return_paths();
 	free_stree(&all_return_states);
 	free_stack_and_strees(&return_stree_stack);
 }
@@ -94,5 +214,6 @@ void register_returns(int id)
 	add_hook(&match_end_func, END_FUNC_HOOK);
 	add_function_data((unsigned long *)&all_return_states);
 	add_function_data((unsigned long *)&return_stree_stack);
+	add_function_data((unsigned long *)&return_paths);
 	add_hook(&free_resources, AFTER_FUNC_HOOK);
 }
@@ -0,0 +1,223 @@
+#!/usr/bin/perl
+
+# This times smatch over a pinned list of kernel files against a DB which
+# doesn't change, at a few fixed -j levels, so one smatch can be compared
+# with another on the same work.  It prints the numbers as JSON.
+#
+#   bench_kernel.pl --kernel=<dir> [--files=<list>] [--db=<smatch_db.sqlite>]
+#                   [--jobs=1,4,16] [--smatch=<binary>] [--build-db]
+#                   [-o <file>] [--compare <old.json>]
+#
+# The default file list is bench_kernel.files next to this script.  The
+# kernel tree has to be configured (allmodconfig) and the objects are built
+# once before anything is timed, so the timed runs are only make and smatch.
+# The time make takes on its own is measured with CHECK=true and taken off.
+#
+# For each -j level it reports files per second, the CPU time and how busy
+# the CPUs were, and the total and peak of the per file max RSS from
+# --stats.  With --build-db it also times an --info run over the files and
+# create_db.sh on the output.  The DB is the one in the kernel tree unless
+# --db says otherwise.  It is only read, so keep the same file around to
+# compare against.
+#
+# With --compare it prints the old and new numbers and exits with an error
+# if something got more than 10% worse.
+
+use strict;
+use warnings;
+use Cwd qw(abs_path);
+use File::Basename;
+use File::Temp qw(tempdir);
+use JSON::PP;
+use List::Util qw(max sum);
+use Time::HiRes qw(time);
+
+my $dir = dirname(abs_path($0));
+my $smatch = "$dir/../smatch";
+my $files_list = "$dir/bench_kernel.files";
+my $kernel;
+my $db;
+my @jobs = (1, 4, 16);
+my $build_db = 0;
+my $out_file;
+my $compare;
+
+sub usage()
+{
+    print "usage: $0 --kernel=<dir> [--files=<list>] [--db=<smatch_db.sqlite>]\n";
+    print "          [--jobs=1,4,16] [--smatch=<binary>] [--build-db] [-o <file>] [--compare <old.json>]\n";
+    exit(1);
+}
+
+while (my $arg = shift) {
+    if ($arg =~ /^--kernel=(.*)/) {
+        $kernel = $1;
+    } elsif ($arg =~ /^--files=(.*)/) {
+        $files_list = $1;
+    } elsif ($arg =~ /^--db=(.*)/) {
+        $db = $1;
+    } elsif ($arg =~ /^--jobs=([\d,]+)$/) {
+        @jobs = split(/,/, $1);
+    } elsif ($arg =~ /^--smatch=(.*)/) {
+        $smatch = $1;
+    } elsif ($arg eq "--build-db") {
+        $build_db = 1;
+    } elsif ($arg eq "-o") {
+        $out_file = shift;
+    } elsif ($arg eq "--compare") {
+        $compare = shift;
+    } else {
+        usage();
+    }
+}
+usage() if (!$kernel);
+
+$kernel = abs_path($kernel);
+$smatch = abs_path($smatch);
+$db = abs_path($db // "$kernel/smatch_db.sqlite");
+die "$db: no such file\n" if (! -e $db);
+
+my @objs;
+open(my $list, "<", $files_list) or die "$files_list: $!";
+while (<$list>) {
+    s/#.*//;
+    s/^\s+|\s+$//g;
+    next if ($_ eq "");
+    s/\.c$/.o/;
+    push @objs, $_;
+}
+close($list);
+die "$files_list: no files\n" if (!@objs);
+
+my $tmp = tempdir(CLEANUP => 1);
+my $max_jobs = max(@jobs);
+my $targets = join(" ", @objs);
+
+chdir($kernel) or die "$kernel: $!";
+
+sub run($)
+{
+    my $cmd = shift;
+
+    system("$cmd > /dev/null 2>&1");
+}
+
+# returns the wall time and the CPU time of everything it started
+sub timed($)
+{
+    my $cmd = shift;
+    my (undef, undef, $cuser, $csys) = times();
+    my $start = time();
+
+    run($cmd);
+
+    my $wall = time() - $start;
+    my (undef, undef, $cuser2, $csys2) = times();
+    return ($wall, $cuser2 + $csys2 - $cuser - $csys);
+}
+
+sub check_cmd($$)
+{
+    my ($opts, $j) = @_;
+
+    return "make -j$j -k C=2 CHECK=\"$smatch -p=kernel --succeed --db-file=$db --db-immutable $opts\" $targets";
+}
+
+print STDERR "building the objects\n";
+run("make -j$max_jobs -k $targets");
+
+my %results;
+foreach my $j (@jobs) {
+    my ($overhead) = timed("make -j$j -k C=2 CHECK=true $targets");
+
+    unlink("$tmp/stats", "$tmp/warns");
+    print STDERR "-j$j\n";
+    my ($wall, $cpu) = timed(check_cmd("--stats=$tmp/stats --spool=$tmp/warns", $j));
+
+    my @rss;
+    if (open(my $in, "<", "$tmp/stats")) {
+        while (<$in>) {
+            push @rss, decode_json($_)->{max_rss_kb};
+        }
+        close($in);
+    }
+    print STDERR "only checked " . scalar(@rss) . " of " . scalar(@objs) . " files\n"
+        if (@rss != @objs);
+
+    my $secs = $wall - $overhead;
+    $secs = $wall if ($secs <= 0);
+    $results{"j$j"} = {
+        files => scalar(@rss),
+        wall_s => sprintf("%.2f", $wall) + 0,
+        make_overhead_s => sprintf("%.2f", $overhead) + 0,
+        files_per_sec => sprintf("%.3f", @rss / $secs) + 0,
+        cpu_s => sprintf("%.2f", $cpu) + 0,
+        cpu_util_pct => sprintf("%.1f", $cpu * 100 / ($secs * $j)) + 0,
+        total_rss_mb => int((sum(@rss) // 0) / 1024),
+        peak_rss_mb => int((max(@rss) // 0) / 1024),
+    };
+}
+
+my %db_build;
+if ($build_db) {
+    my $info_tmp = "$tmp/info";
+
+    mkdir($info_tmp);
+    print STDERR "building a DB\n";
+    my ($info_s) = timed(check_cmd("--info --spool=$info_tmp/warns", $max_jobs));
+    my ($create_s) = timed("cd $info_tmp && $dir/../smatch_data/db/create_db.sh -p=kernel warns");
+    %db_build = (
+        info_s => sprintf("%.2f", $info_s) + 0,
+        create_db_s => sprintf("%.2f", $create_s) + 0,
+    );
+}
+
+my $json = JSON::PP->new->canonical->pretty;
+my $text = $json->encode({ smatch => $smatch, kernel => $kernel, db => $db,
+                           files => scalar(@objs), results => \%results,
+                           $build_db ? (db_build => \%db_build) : () });
+if ($out_file) {
+    open(my $out, ">", $out_file) or die "$out_file: $!";
+    print $out $text;
+    close($out);
+} else {
+    print $text;
+}
+
+exit(0) if (!$compare);
+
+open(my $old_fd, "<", $compare) or die "$compare: $!";
+my $old = decode_json(join("", <$old_fd>));
+close($old_fd);
+
+my $worse = 0;
+
+# files_per_sec is the only one where bigger is better
+sub compare_one($$$$)
+{
+    my ($name, $key, $before, $after) = @_;
+    my $change = $before ? ($after - $before) * 100 / $before : 0;
+    my $flag = "";
+
+    $change = -$change if ($key eq "files_per_sec");
+    if ($change > 10) {
+        $flag = "  <- worse";
+        $worse = 1;
+    }
+    printf("%-9s %-14s %12.2f %12.2f %7.1f%%%s\n", $name, $key, $before, $after, $change, $flag);
+}
+
+printf("%-9s %-14s %12s %12s %8s\n", "", "", "old", "new", "worse by");
+foreach my $j (@jobs) {
+    my $before = $old->{results}{"j$j"};
+    next if (!$before);
+    foreach my $key (qw(files_per_sec cpu_s total_rss_mb peak_rss_mb)) {
+        compare_one("-j$j", $key, $before->{$key}, $results{"j$j"}{$key});
+    }
+}
+if ($build_db && $old->{db_build}) {
+    foreach my $key (qw(info_s create_db_s)) {
+        compare_one("db", $key, $old->{db_build}{$key}, $db_build{$key});
+    }
+}
+exit($worse);
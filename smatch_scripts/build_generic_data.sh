@@ -62,13 +62,16 @@ if [[ ! -z $O ]] ; then
 	KERNEL_O="O=$O"
 fi
 
-make $KERNEL_ARCH $KERNEL_CROSS_COMPILE $KERNEL_O -j${NR_CPU} CC=$BIN_DIR/cgcc CHECK="$BIN_DIR/smatch --call-tree --info --spammy --full-path --file-output" $TARGET
+CGCC=$BIN_DIR/sm_cgcc
+if [ ! -x $CGCC ] ; then
+	CGCC=$BIN_DIR/cgcc
+fi
 
-find -name \*.c.smatch -exec cat \{\} \; -exec rm \{\} \; > smatch_warns.txt
+rm -f smatch_warns.txt
+touch smatch_warns.txt
+make $KERNEL_ARCH $KERNEL_CROSS_COMPILE $KERNEL_O -j${NR_CPU} CC=$CGCC CHECK="$BIN_DIR/smatch --call-tree --info --spammy --full-path --spool=$PWD/smatch_warns.txt" $TARGET
 
-for i in $SCRIPT_DIR/gen_* ; do
-        $i smatch_warns.txt -p=${PROJECT}
-done
+$SCRIPT_DIR/extract_data_lists.pl smatch_warns.txt -p=${PROJECT}
 
 mkdir -p $DATA_DIR
 mv $PROJECT.* $DATA_DIR
@@ -6,8 +6,13 @@ PROJECT=kernel
 
 function usage {
     echo
-    echo "Usage:  $(basename $0)"
+    echo "Usage:  $(basename $0) [--incremental <files>|--converge <files>]"
     echo "Updates the smatch_data/ directory and builds the smatch database"
+    echo "With --incremental only the listed files are re-analyzed and their"
+    echo "rows are replaced in the existing database."
+    echo "With --converge the callers of every function whose return_states"
+    echo "changed are re-analyzed as well, until nothing changes any more or"
+    echo "\$SMATCH_MAX_PASSES (default 10) passes have been done."
     echo
     exit 1
 }
@@ -26,6 +31,80 @@ else
     exit 1
 fi
 
+function reanalyze {
+    rm -f smatch_warns.partial.txt
+    for file in "$@" ; do
+        $SCRIPT_DIR/kchecker --info --spammy --data=$DATA_DIR --outfile=smatch_warns.partial.tmp $file
+        cat smatch_warns.partial.tmp >> smatch_warns.partial.txt
+    done
+    rm -f smatch_warns.partial.tmp
+    $DATA_DIR/db/reload_partial.sh -p=kernel smatch_warns.partial.txt
+}
+
+# One line per return_states row, sorted, so two snapshots can be compared
+# with comm.  The function name is the first field.
+function summaries {
+    sqlite3 smatch_db.sqlite "select function, file, static, return, type, parameter, key, value from return_states;" | LC_ALL=C sort
+}
+
+if [ "$1" = "--incremental" ] ; then
+    shift
+    if [ ! -e smatch_db.sqlite ] || [ "$1" = "" ] ; then
+        usage
+    fi
+    reanalyze "$@"
+    exit 0
+fi
+
+if [ "$1" = "--converge" ] ; then
+    shift
+    if [ ! -e smatch_db.sqlite ] || [ "$1" = "" ] ; then
+        usage
+    fi
+    tmp_dir=$(mktemp -d smatch_converge.XXXXXX)
+    trap 'rm -rf "${tmp_dir:?}"' EXIT
+    # The file columns are hashes so the callers are mapped back to the
+    # source files through the "file:line func()" prefix of the warns.
+    [ -e smatch_warns.txt ] && gzip -dcf smatch_warns.txt > $tmp_dir/warns
+    touch $tmp_dir/warns
+    files="$*"
+    pass=1
+    while true ; do
+        echo "pass $pass: $(echo $files | wc -w) files"
+        summaries > $tmp_dir/before
+        reanalyze $files
+        summaries > $tmp_dir/after
+        cat smatch_warns.partial.txt >> $tmp_dir/warns
+
+        LC_ALL=C comm -3 $tmp_dir/before $tmp_dir/after | sed -e 's/^\t//' | \
+            cut -d '|' -f 1 | LC_ALL=C sort -u > $tmp_dir/changed
+        if [ ! -s $tmp_dir/changed ] ; then
+            echo "converged after $pass passes"
+            break
+        fi
+        echo "$(wc -l < $tmp_dir/changed) functions changed"
+        pass=$((pass + 1))
+        if [ $pass -gt ${SMATCH_MAX_PASSES:-10} ] ; then
+            echo "giving up after ${SMATCH_MAX_PASSES:-10} passes"
+            break
+        fi
+
+        (
+            echo "CREATE TEMP TABLE changed (function varchar(64));"
+            sed -e "s/'/''/g" -e "s/.*/INSERT INTO changed VALUES ('&');/" $tmp_dir/changed
+            echo "SELECT DISTINCT caller FROM caller_info WHERE function IN (SELECT function FROM changed);"
+        ) | sqlite3 smatch_db.sqlite > $tmp_dir/callers
+        files=$(awk 'FNR == NR { callers[$0 "()"] = 1; next }
+                     $2 in callers { sub(/:[0-9]+$/, "", $1); print $1 }' \
+                $tmp_dir/callers $tmp_dir/warns | LC_ALL=C sort -u)
+        if [ "$files" = "" ] ; then
+            echo "converged after $pass passes"
+            break
+        fi
+    done
+    exit 0
+fi
+
 # If someone is building the database for the first time then make sure all the
 # required packages are installed
 if [ ! -e smatch_db.sqlite ] ; then
@@ -41,9 +120,7 @@ BUILD_STATUS=0
 $SCRIPT_DIR/test_kernel.sh --call-tree --info --spammy --data=$DATA_DIR || BUILD_STATUS=$?
 echo "smatch_warns.txt built."
 
-for i in $SCRIPT_DIR/gen_* ; do
-	$i smatch_warns.txt -p=kernel
-done
+$SCRIPT_DIR/extract_data_lists.pl smatch_warns.txt -p=kernel
 
 mv ${PROJECT}.* $DATA_DIR
 
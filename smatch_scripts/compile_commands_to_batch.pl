@@ -0,0 +1,50 @@
+#!/usr/bin/perl
+
+# Turns a compile_commands.json into a file for "smatch --batch=<file>".
+# Each line is the directory and then the compiler options and the .c file,
+# separated by tabs.  The compiler itself, -c and -o <file> are dropped.
+
+use strict;
+use JSON::PP;
+use Text::ParseWords;
+
+sub usage()
+{
+    print ("compile_commands_to_batch.pl <compile_commands.json>\n");
+    exit(1);
+}
+
+my $json_file = shift;
+usage() if (!$json_file);
+
+open(my $fh, '<', $json_file) or die "cannot open $json_file: $!";
+my $text = do { local $/; <$fh> };
+close($fh);
+
+my $commands = decode_json($text);
+
+foreach my $cmd (@$commands) {
+    my @args;
+
+    if ($cmd->{arguments}) {
+        @args = @{$cmd->{arguments}};
+    } else {
+        @args = shellwords($cmd->{command});
+    }
+    shift @args;
+
+    my @out;
+    while (@args) {
+        my $arg = shift @args;
+        next if ($arg eq "-c");
+        if ($arg eq "-o") {
+            shift @args;
+            next;
+        }
+        next if ($arg =~ /^-o./);
+        next if ($arg =~ /\t/);
+        push @out, $arg;
+    }
+
+    print join("\t", $cmd->{directory}, @out) . "\n";
+}
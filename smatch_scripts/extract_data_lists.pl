@@ -0,0 +1,268 @@
+#!/usr/bin/perl
+
+# This does the work of all the gen_*.sh scripts in one read of the smatch
+# output.  Each gen_*.sh greps the whole file again, which is slow when it is
+# several GB.  The lists are written the same way the scripts write them.
+
+use strict;
+use File::Basename;
+
+sub usage()
+{
+    print "Usage:  $0 <file with smatch messages> -p=<project>\n";
+    exit(1);
+}
+
+my $file = shift();
+my $project = shift();
+
+if (!$file) {
+    usage();
+}
+$project =~ s/.*=//;
+my $kernel = $project eq "kernel";
+
+if (! -e $file) {
+    printf("Error:  $file does not exist.\n");
+    exit(1);
+}
+
+my $data_dir = dirname($0) . "/../smatch_data";
+
+# The trace_params.pl targets of gen_dma_funcs.sh, gen_gfp_flags.sh and
+# gen_rosenberg_funcs.sh.
+my %traced = (
+    "dma_funcs" => [["usb_control_msg", 6], ["usb_fill_bulk_urb", 3],
+                    ["dma_map_single", 1]],
+    "gfp_flags" => [["kmalloc", 1], ["kzalloc", 1], ["kcalloc", 2]],
+    "rosenberg_funcs" => [["copy_to_user", 1], ["rds_info_copy", 1],
+                          ["nla_put", 3], ["skb_put_data", 1],
+                          ["snd_timer_user_append_to_tqueue", 1],
+                          ["__send_signal", 1], ["usb_bulk_msg", 2]],
+);
+
+my %lists;
+my @syscall_deps;
+my %param_map;
+my %callers;
+
+# Same as "cut -d ' ' -f $nr,...".  Lines without a space are printed whole.
+sub fields($@)
+{
+    my $line = shift;
+
+    return $line if ($line !~ / /);
+    my @fields = split(/ /, $line, -1);
+    return join(" ", grep { defined } @fields[map { $_ - 1 } @_]);
+}
+
+sub fields_from($$)
+{
+    my $line = shift;
+    my $nr = shift;
+
+    return $line if ($line !~ / /);
+    my @fields = split(/ /, $line, -1);
+    return join(" ", @fields[$nr - 1 .. $#fields]);
+}
+
+sub func_name($)
+{
+    my $line = shift;
+
+    my $func = fields($line, 2);
+    $func =~ s/\(.*//;
+    return $func;
+}
+
+sub add($$)
+{
+    my $list = shift;
+    my $val = shift;
+
+    push @{$lists{$list}}, $val;
+}
+
+open(FILE, "gzip -dcf $file |") or die "$file: $!";
+while (<FILE>) {
+    chomp;
+
+    if (/info: bit shifter/ && /'/) {
+        my $val = $_;
+        $val =~ s/^.*?'//;
+        $val =~ s/'//g;
+        add("bit_shifters", $val);
+    }
+    if (/no_return_funcs/) {
+        add("no_return_funcs", func_name($_));
+    }
+    if (/sizeof_param/) {
+        if (/[0-9] [0-9]$/) {
+            add("sizeof_param", fields_from($_, 5));
+        } elsif (/[0-9] -1$/) {
+            add("sizeof_param_unknown", fields_from($_, 5));
+        }
+    }
+
+    next if (!$kernel);
+
+    if (/allocation func$/ && / /) {
+        add("allocation_funcs", func_name($_));
+    }
+    if (/returns_err_ptr$/ && / /) {
+        add("returns_err_ptr", func_name($_));
+    }
+    if (/(?<!\w)expects ERR_PTR(?!\w)/) {
+        my $val = fields($_, 2, 6);
+        $val =~ s/\([0-9]*\)//;
+        add("expects_err_ptr", $val);
+    }
+    if (/(?<!\w)free_arg(?!\w)/) {
+        add("frees_argument", fields_from($_, 5));
+    }
+    if (/(?<!\w)puts_arg(?!\w)/) {
+        add("puts_argument", fields_from($_, 5));
+    }
+    if (/is unwind function/) {
+        add("unwind_functions", func_name($_));
+    }
+    push @syscall_deps, $_ if (/^\{"syscall": /);
+    if (/.*?:\d+ (.*?)\(\) info: param_mapper (\d+) => (.*?) (\d+)/) {
+        push @{$param_map{"$1%$2"}}, "$3%$4";
+        push @{$callers{"$3%$4"}}, "$1%$2";
+    }
+}
+close(FILE);
+
+sub uniq_sorted(@)
+{
+    my %seen;
+
+    return sort(grep { !$seen{$_}++ } @_);
+}
+
+# This is trace_params.pl.  Every parameter which leads to $target through
+# the param_mapper links is printed as "func param".  It walks the links
+# backwards from the target so unlike trace_params.pl the result doesn't
+# depend on the hash order when there are loops.
+sub trace_params($)
+{
+    my $target = shift;
+    my %seen;
+    my @todo;
+
+    return () if (!defined($param_map{$target}) && !defined($callers{$target}));
+
+    push @todo, $target;
+    $seen{$target} = 1;
+    while (my $link = shift(@todo)) {
+        foreach my $caller (@{$callers{$link}}) {
+            next if ($seen{$caller}++);
+            push @todo, $caller;
+        }
+    }
+    return map { s/%/ /r } keys %seen;
+}
+
+# The lines in the .remove file are dropped and so is anything which shows
+# up twice, like "cat $tmp $remove $remove | sort | uniq -u" in the scripts.
+sub write_list($$$$@)
+{
+    my $name = shift;
+    my $script = shift;
+    my $comment = shift;
+    my $extra = shift;
+    my $outfile = "$project.$name";
+
+    open(OUT, ">$outfile") or die "$outfile: $!";
+    print OUT "// $comment\n";
+    print OUT "// generated by `$script`\n";
+    print OUT $extra;
+    close(OUT);
+
+    open(OUT, "| sort | uniq -u >> $outfile") or die "sort: $!";
+    print OUT "$_\n" foreach (@_);
+    if (open(REMOVE, "<$data_dir/$outfile.remove")) {
+        my @remove = <REMOVE>;
+        close(REMOVE);
+        print OUT @remove, @remove;
+    }
+    close(OUT);
+    print "Done.  List saved as '$outfile'\n";
+}
+
+sub slurp($)
+{
+    my $name = shift;
+    my $ret = "";
+
+    open(IN, "<$name") or return "";
+    local $/;
+    $ret = <IN>;
+    close(IN);
+    return $ret;
+}
+
+write_list("bit_shifters", "gen_bit_shifters.sh", "list of macros used as shifters.", "",
+           uniq_sorted(@{$lists{"bit_shifters"}}));
+
+write_list("no_return_funcs", "gen_no_return_funcs.sh", "list of functions which don't return.",
+           slurp("$data_dir/no_return_funcs") .
+           slurp("$data_dir/$project.no_return_funcs.add"),
+           uniq_sorted(@{$lists{"no_return_funcs"}}));
+
+# gen_sizeof_param.sh treats its .remove file as grep patterns
+my @sizeof = map { s/'//gr } (uniq_sorted(@{$lists{"sizeof_param"}}),
+                              uniq_sorted(@{$lists{"sizeof_param_unknown"}}));
+my @patterns;
+if (open(REMOVE, "<$data_dir/$project.sizeof_param.remove")) {
+    @patterns = grep { $_ ne "" } map { chomp; $_ } <REMOVE>;
+    close(REMOVE);
+}
+my @removed;
+foreach my $line (@sizeof) {
+    push @removed, $line if (grep { $line =~ /$_/ } @patterns);
+}
+open(OUT, ">$project.sizeof_param") or die "$project.sizeof_param: $!";
+print OUT "// list of function parameters that are the size of a buffer.\n";
+print OUT "// generated by `gen_sizeof_param.sh`\n";
+close(OUT);
+open(OUT, "| sort | uniq -u >> $project.sizeof_param") or die "sort: $!";
+print OUT "$_\n" foreach (@sizeof, @removed);
+close(OUT);
+print "Done.  List saved as '$project.sizeof_param'\n";
+
+exit(0) if (!$kernel);
+
+write_list("allocation_funcs", "gen_allocation_list.sh", "list of functions that return a new allocation.", "",
+           uniq_sorted(@{$lists{"allocation_funcs"}}),
+           "kmalloc", "kzalloc", "kcalloc", "__alloc_skb");
+write_list("returns_err_ptr", "gen_err_ptr_list.sh", "list of functions that return a new allocation.", "",
+           uniq_sorted(@{$lists{"returns_err_ptr"}}));
+write_list("expects_err_ptr", "gen_expects_err_ptr.sh", "list of functions which expect an ERR_PTR.", "",
+           uniq_sorted(@{$lists{"expects_err_ptr"}}));
+write_list("frees_argument", "gen_frees_list.sh", "list of functions and the argument they free.", "",
+           @{$lists{"frees_argument"}});
+write_list("puts_argument", "gen_puts_list.sh", "list of functions and the argument they decrement the ref of.", "",
+           @{$lists{"puts_argument"}});
+write_list("unwind_functions", "gen_unwind_functions.sh", "list of unwind functions.", "",
+           uniq_sorted(@{$lists{"unwind_functions"}}));
+
+foreach my $name (sort(keys %traced)) {
+    my %comments = (
+        "dma_funcs" => "list of DMA function and buffer parameters.",
+        "gfp_flags" => "list of GFP flag parameters.",
+        "rosenberg_funcs" => "list of copy_to_user function and buffer parameters.",
+    );
+    my @found;
+
+    foreach my $t (@{$traced{$name}}) {
+        push @found, trace_params("$t->[0]%$t->[1]");
+    }
+    write_list($name, "gen_$name.sh", $comments{$name}, "", uniq_sorted(@found));
+}
+
+open(OUT, ">>kernel.implicit_dependencies") or die "kernel.implicit_dependencies: $!";
+print OUT "$_\n" foreach (@syscall_deps);
+close(OUT);
+print "Done.  List saved as 'kernel.implicit_dependencies\n";
@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Prints check_list.h with only the check_* modules which are listed in the
+# profile.  The register_* modules are always kept.  The profile has one
+# check per line, the "check_" is optional and '#' starts a comment.
+#
+# This is used by "make CHECK_PROFILE=<profile>".
+
+profile=$1
+list=$2
+
+if [[ "$profile" = "" || "$list" = "" ]] ; then
+    echo "Usage:  $(basename $0) <profile> <check_list.h>" >&2
+    exit 1
+fi
+
+checks=$(sed -e 's/#.*//' $profile | tr -s ' \t' '\n\n' | grep -v '^$' | \
+	 sed -e 's/^check_//' -e 's/^/check_/')
+
+for check in $checks ; do
+    if ! grep -q "^CK($check)" $list ; then
+        echo "$profile: '$check' is not in $list" >&2
+        exit 1
+    fi
+done
+
+echo "/* generated by \`gen_check_list.sh $profile\` */"
+while IFS= read -r line ; do
+    if [[ "$line" =~ ^CK\((check_[a-zA-Z0-9_]*)\) ]] ; then
+        echo "$checks" | grep -qx "${BASH_REMATCH[1]}" || continue
+    fi
+    echo "$line"
+done < $list
@@ -18,8 +18,7 @@ tmp=$(mktemp /tmp/smatch.XXXX)
 
 # echo "// list of syscalls and the fields they write/read to." > kernel.implicit_dependencies
 # echo '// generated by `gen_implicit_dependencies.sh`' >> kernel.implicit_dependencies
-grep -w read_list $file >> $tmp
-grep -w write_list $file >> $tmp
+grep '^{"syscall": ' $file >> $tmp
 # cat $tmp $remove $remove 2> /dev/null | sort | uniq -u >> kernel.implicit_dependencies
 cat $tmp >> kernel.implicit_dependencies
 rm $tmp
@@ -76,6 +76,14 @@ class Parser(object):
         derefs = self._split_field(field)
         return syscall, list_type, derefs
 
+    def _parse_record(self, line):
+        """ {"syscall": s, "read_list": [...], "write_list": [...]} """
+        record = json.loads(line)
+        syscall = self._sanitize_syscall(record['syscall'])
+        for list_type in (ListType.READ, ListType.WRITE):
+            derefs = [self._deref_to_tuple(deref) for deref in record.get(list_type, [])]
+            self._add_fields(syscall, list_type, derefs)
+
     def _add_fields(self, syscall, list_type, derefs):
         if list_type == ListType.READ:
             d = self.syscall_read_fields
@@ -105,6 +113,12 @@ class Parser(object):
 
     def parse(self):
         for line in self.impl_dep_file:
+            if line.startswith('//') or not line.strip():
+                continue
+            if line.startswith('{'):
+                self._parse_record(line)
+                continue
+            # the old "syscall read_list: [a, b, ]" format
             syscall, list_type, derefs = self._sanitize_line(line)
             self._add_fields(syscall, list_type, derefs)
         # pprint.pprint(dict(self.syscall_write_fields))
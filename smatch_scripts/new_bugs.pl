@@ -1,6 +1,15 @@
 #!/usr/bin/perl
 
+# The old warnings are stored in an SDBM database, $warns_dir/warnings,
+# keyed on the file name plus the message with the line numbers and the
+# other numbers taken out.  So a warning which only moved is still old and
+# checking for a new one is a single lookup.  The empty files in $warns_dir
+# which older versions used are still understood.
+
 use strict;
+use Fcntl;
+use SDBM_File;
+use Digest::MD5 qw(md5_hex);
 
 my $store = 0;
 my $unstore = 0;
@@ -34,6 +43,19 @@ if (int($du) > 100000) {
     exit(1);
 }
 
+if ($store) {
+    unless(-e "$warns_dir/" or mkdir "$warns_dir/") {
+        die "Unable to create $warns_dir";
+    }
+}
+
+my %old;
+my $flags = ($store || $unstore) ? O_RDWR | O_CREAT : O_RDONLY;
+if (-e "$warns_dir/warnings.pag" || $store) {
+    tie(%old, 'SDBM_File', "$warns_dir/warnings", $flags, 0666) or
+        die "Error opening: $warns_dir/warnings: $!\n";
+}
+
 open(WARNS, $warns_file);
 
 my ($orig, $file, $line, $msg);
@@ -70,25 +92,29 @@ while (<WARNS>) {
     $file =~ s/^\.//;
     $msg =~ s/\//./g;
 
+    # SDBM can't store keys much bigger than 1k
+    my $key = "$file.$msg";
+    $key = md5_hex($key) if (length($key) > 900);
+
     if ($store) {
-        unless(-e "$warns_dir/" or mkdir "$warns_dir/") {
-            die "Unable to create $warns_dir";
-        }
-        open(TMP, '>', "$warns_dir/$file.$msg") or
-            die "Error opening: $warns_dir/$file.$msg\n";
-        close(TMP);
+        $old{$key} = 1;
         next;
     }
 
     if ($unstore) {
+        if (exists($old{$key})) {
+            delete($old{$key});
+            print "removed: $file.$msg\n";
+        }
         unlink("$warns_dir/$file.$msg") and
             print "removed: $warns_dir/$file.$msg\n";
         next;
     }
 
-    unless (-e "$warns_dir/$file.$msg") {
+    unless (exists($old{$key}) || -e "$warns_dir/$file.$msg") {
         print "$orig";
     }
 }
 
 close(WARNS);
+untie(%old);
@@ -35,6 +35,8 @@ save_thoughts()
     echo $sm_err       >> summary
     echo $ans       >> summary
     echo ========== >> summary
+    summaries="$summaries
+$sm_err"
 }
 
 if [ "$1" = "--new" ] ; then
@@ -51,6 +53,11 @@ if [ "$file" = "" ] ; then
     fi
 fi
 
+# read the old summaries once instead of grepping them for every warning
+if [ "$NEW" = "Y" ] ; then
+    summaries=$(cat *summary* 2> /dev/null)
+fi
+
 IFS='
 '
 for sm_err in $(cat $file) ; do
@@ -72,7 +79,7 @@ for sm_err in $(cat $file) ; do
     last=$(echo $last | sed -e 's/line .*//')
 
     if [ "$NEW" = "Y" ] ; then
-        if grep -F "$last" *summary* > /dev/null ; then
+        if [[ "$summaries" == *"$last"* ]] ; then
             echo "skipping $sm_err"
             continue
         fi
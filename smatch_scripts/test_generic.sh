@@ -70,10 +70,16 @@ if [[ ! -z $O ]] ; then
 	KERNEL_O="O=$O"
 fi
 
+CGCC=$BIN_DIR/sm_cgcc
+if [ ! -x $CGCC ] ; then
+	CGCC=$BIN_DIR/cgcc
+fi
+
+SPOOL=$(realpath -m $WLOG)
 make $KERNEL_ARCH $KERNEL_CROSS_COMPILE $KERNEL_O clean
-find -name \*.c.smatch -exec rm \{\} \;
-make $KERNEL_ARCH $KERNEL_CROSS_COMPILE $KERNEL_O -j${NR_CPU} $ENDIAN -k CC=$BIN_DIR/cgcc CHECK="$CMD -p=${PROJECT} --full-path --file-output $*" \
+rm -f $WLOG
+touch $WLOG
+make $KERNEL_ARCH $KERNEL_CROSS_COMPILE $KERNEL_O -j${NR_CPU} $ENDIAN -k CC=$CGCC CHECK="$CMD -p=${PROJECT} --full-path --spool=$SPOOL $*" \
 	C=1 $TARGET 2>&1 | tee $LOG
-find -name \*.c.smatch -exec cat \{\} \; -exec rm \{\} \; > $WLOG
 
 echo "Done.  The warnings are saved to $WLOG"
@@ -73,18 +73,18 @@ if [[ ! -z $O ]] ; then
 	KERNEL_O="O=$O"
 fi
 
+# Every smatch process appends to the same three files so there is nothing
+# to collect afterwards.
+SPOOL=$(realpath -m $WLOG)
 make $KERNEL_ARCH $KERNEL_CROSS_COMPILE $KERNEL_O clean
-find -name \*.c.smatch -exec rm \{\} \;
-find -name \*.c.smatch.sql -exec rm \{\} \;
-find -name \*.c.smatch.caller_info -exec rm \{\} \;
-make $KERNEL_ARCH $KERNEL_CROSS_COMPILE $KERNEL_O -j${NR_CPU} $ENDIAN -k CHECK="$CMD -p=kernel --file-output --succeed $*" \
-	C=1 $BUILD_PARAM $TARGET 2>&1 | tee $LOG
-BUILD_STATUS=${PIPESTATUS[0]}
-find -name \*.c.smatch -exec cat \{\} \; -exec rm \{\} \; > $WLOG
+rm -f $WLOG $WLOG.sql $WLOG.caller_info
+touch $WLOG
 if [[ $INFO -eq 1 ]] ; then
-    find -name \*.c.smatch.sql -exec cat \{\} \; -exec rm \{\} \; > $WLOG.sql
-    find -name \*.c.smatch.caller_info -exec cat \{\} \; -exec rm \{\} \; > $WLOG.caller_info
+    touch $WLOG.sql $WLOG.caller_info
 fi
+make $KERNEL_ARCH $KERNEL_CROSS_COMPILE $KERNEL_O -j${NR_CPU} $ENDIAN -k CHECK="$CMD -p=kernel --spool=$SPOOL --succeed --db-immutable $*" \
+	C=1 $BUILD_PARAM $TARGET 2>&1 | tee $LOG
+BUILD_STATUS=${PIPESTATUS[0]}
 
 echo "Done. Build with status $BUILD_STATUS. The warnings are saved to $WLOG"
 exit $BUILD_STATUS
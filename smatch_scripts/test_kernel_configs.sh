@@ -0,0 +1,109 @@
+#!/bin/bash
+
+# Check the same kernel tree for several architectures or Kconfigs.
+#
+# Each config is built in its own O= directory, which needs a .config
+# already.  They all use the same --header-cache and --result-cache so the
+# source and headers are only tokenized once and a file is only analyzed
+# again when its preprocessed output is different from what an earlier
+# config had.  The warnings from all the configs are merged into one list
+# where each warning says which configs it was seen in.
+
+set -e
+
+NR_CPU=$(nproc)
+TARGET="vmlinux modules"
+WLOG="smatch_warns.txt"
+CACHE="smatch_cache"
+function usage {
+    echo
+    echo "Usage: $(basename $0) [options] NAME:ARCH:BUILD_DIR... [-- smatch options]"
+    echo "Checks the kernel once for every NAME:ARCH:BUILD_DIR"
+    echo " available options:"
+    echo "	--target {TARGET} : specify build target, default: $TARGET"
+    echo "	--cache {DIR}     : the header and result cache, default: $CACHE"
+    echo "	--wlog {FILE}     : Output merged warnings to file, default is: $WLOG"
+    echo "	--help            : Show this usage"
+    exit 1
+}
+
+CONFIGS=()
+while [[ $# -gt 0 ]] ; do
+    if [[ "$1" == "--target" ]] ; then
+	TARGET="$2"
+	shift 2
+    elif [[ "$1" == "--cache" ]] ; then
+	CACHE="$2"
+	shift 2
+    elif [[ "$1" == "--wlog" ]] ; then
+	WLOG="$2"
+	shift 2
+    elif [[ "$1" == "--help" ]] ; then
+	usage
+    elif [[ "$1" == "--" ]] ; then
+	shift
+	break
+    else
+	CONFIGS+=("$1")
+	shift
+    fi
+done
+
+if [[ ${#CONFIGS[@]} -eq 0 ]] ; then
+    usage
+fi
+
+SCRIPT_DIR=$(dirname $0)
+if [ -e $SCRIPT_DIR/../smatch ] ; then
+    cp $SCRIPT_DIR/../smatch $SCRIPT_DIR/../bak.smatch
+    CMD=$(realpath $SCRIPT_DIR/../bak.smatch)
+elif which smatch | grep smatch > /dev/null ; then
+    CMD=smatch
+else
+    echo "Smatch binary not found."
+    exit 1
+fi
+
+mkdir -p $CACHE/headers $CACHE/results
+CACHE=$(realpath $CACHE)
+WLOG=$(realpath -m $WLOG)
+
+rm -f $WLOG.tagged
+for config in "${CONFIGS[@]}" ; do
+    IFS=: read NAME CONFIG_ARCH BUILD_DIR <<< "$config"
+    if [[ -z $NAME || -z $CONFIG_ARCH || -z $BUILD_DIR ]] ; then
+	echo "Bad config '$config'.  It should be NAME:ARCH:BUILD_DIR."
+	exit 1
+    fi
+
+    SPOOL=$(realpath -m $BUILD_DIR/smatch_warns.txt)
+    rm -f $SPOOL
+    touch $SPOOL
+    make ARCH=$CONFIG_ARCH O=$BUILD_DIR clean
+    make ARCH=$CONFIG_ARCH O=$BUILD_DIR -j${NR_CPU} -k \
+	CHECK="$CMD -p=kernel --spool=$SPOOL --succeed --db-immutable --header-cache=$CACHE/headers --result-cache=$CACHE/results $*" \
+	C=1 $TARGET 2>&1 | tee $BUILD_DIR/smatch_compile.warns || true
+
+    sed -e "s/^/$NAME\t/" $SPOOL >> $WLOG.tagged
+done
+
+# "NAME<tab>warning" lines to "warning [NAME1,NAME2]"
+sort -t $'\t' -k 2 -s $WLOG.tagged | awk -F '\t' '
+    function flush() {
+        if (warn != "")
+            print warn " [" names "]"
+    }
+    {
+        if ($2 != warn) {
+            flush()
+            warn = $2
+            names = $1
+        } else if (index("," names ",", "," $1 ",") == 0) {
+            names = names "," $1
+        }
+    }
+    END { flush() }
+' > $WLOG
+rm -f $WLOG.tagged
+
+echo "Done. The warnings are saved to $WLOG"
@@ -23,14 +23,202 @@
 #undef CHECKORDER
 
 ALLOCATOR(smatch_state, "smatch state");
-ALLOCATOR(sm_state, "sm state");
+/*
+ * An sm_state is 64 bytes so line them up with the cache lines.  Otherwise
+ * every one of them is split across two lines.
+ */
+#define SM_STATE_ALIGN 64
+__DO_ALLOCATOR(struct sm_state, sizeof(struct sm_state), SM_STATE_ALIGN, "sm state", sm_state);
 ALLOCATOR(named_stree, "named slist");
 __DO_ALLOCATOR(char, 1, 4, "state names", sname);
+__DECLARE_ALLOCATOR(struct ptr_list, sm_ptrlist);
+__DECLARE_ALLOCATOR(struct ptr_list, small_sm_ptrlist);
+
+extern int sm_ptrlist_hack;
 
 int sm_state_counter;
+/* unlike sm_state_counter these aren't reset for each function */
+unsigned long sm_state_total;
+unsigned long sm_merge_total;
+unsigned long sm_pool_total;
 
 static struct stree_stack *all_pools;
 
+/*
+ * With --state-profile we count what each check is doing and print a line
+ * per check at the end of every function.  The last slot is for the
+ * internal owners like USHRT_MAX.
+ */
+struct owner_profile {
+	unsigned int sm_states;
+	unsigned int merges;
+	unsigned int pool_states;
+	unsigned int max_states;
+};
+static struct owner_profile *state_profile;
+static FILE *state_profile_fd;
+
+static struct owner_profile *get_owner_profile(unsigned short owner)
+{
+	if (!state_profile)
+		state_profile = calloc(num_checks + 1, sizeof(*state_profile));
+	if (owner >= num_checks)
+		owner = num_checks;
+	return &state_profile[owner];
+}
+
+static void profile_stree_size(struct stree *stree)
+{
+	struct owner_profile *prof;
+	struct sm_state *sm;
+	unsigned short owner = 0;
+	unsigned int cnt = 0;
+
+	FOR_EACH_SM(stree, sm) {
+		if (sm->owner != owner) {
+			prof = get_owner_profile(owner);
+			if (cnt > prof->max_states)
+				prof->max_states = cnt;
+			owner = sm->owner;
+			cnt = 0;
+		}
+		cnt++;
+	} END_FOR_EACH_SM(sm);
+	prof = get_owner_profile(owner);
+	if (cnt > prof->max_states)
+		prof->max_states = cnt;
+}
+
+static void print_state_profile(void)
+{
+	struct owner_profile *prof;
+	int i;
+
+	if (!state_profile)
+		return;
+
+	if (!state_profile_fd) {
+		state_profile_fd = fopen(option_state_profile, "w");
+		if (!state_profile_fd) {
+			sm_ierror("cannot open '%s': %m", option_state_profile);
+			option_state_profile = NULL;
+			return;
+		}
+		fprintf(state_profile_fd, "file\tfunction\tcheck\tsm_states\tmerges\tpool_states\tmax_states\n");
+	}
+
+	for (i = 0; i <= num_checks; i++) {
+		prof = &state_profile[i];
+		if (!prof->sm_states && !prof->merges && !prof->max_states)
+			continue;
+		fprintf(state_profile_fd, "%s\t%s\t%s\t%u\t%u\t%u\t%u\n",
+			get_filename(), get_function() ? get_function() : "",
+			check_name(i), prof->sm_states, prof->merges,
+			prof->pool_states, prof->max_states);
+	}
+	memset(state_profile, 0, (num_checks + 1) * sizeof(*state_profile));
+}
+/*
+ * How many bytes of sm_states and ->possible lists each check is holding.
+ * Everything is freed at the end of the function so the counts go back to
+ * zero there and the biggest count in the file is kept as the peak.  The
+ * smatch_state structs don't record who allocated them so they aren't
+ * counted.
+ */
+static unsigned long *owner_bytes;
+static unsigned long *owner_peak;
+
+static void charge_owner(unsigned short owner, unsigned long bytes)
+{
+	if (!owner_bytes) {
+		owner_bytes = calloc(num_checks + 1, sizeof(*owner_bytes));
+		owner_peak = calloc(num_checks + 1, sizeof(*owner_peak));
+	}
+	if (owner >= num_checks)
+		owner = num_checks;
+	owner_bytes[owner] += bytes;
+}
+
+static int cmp_owner_bytes(const void *a, const void *b)
+{
+	unsigned long one = *(const unsigned long *)a >> 16;
+	unsigned long two = *(const unsigned long *)b >> 16;
+
+	if (one > two)
+		return -1;
+	if (one < two)
+		return 1;
+	return 0;
+}
+
+/*
+ * Fills "buf" with the "nr" owners using the most memory, like
+ * "register_smatch_extra 4000Kb, check_locking 120Kb".
+ */
+static void show_owner_bytes(unsigned long *bytes, int nr, char *buf, int size)
+{
+	unsigned long *sorted;
+	int i, cnt = 0, pos = 0;
+
+	buf[0] = '\0';
+	if (!bytes)
+		return;
+
+	/* the owner goes in the low bits so it can be sorted with the count */
+	sorted = malloc((num_checks + 1) * sizeof(*sorted));
+	for (i = 0; i <= num_checks; i++) {
+		if (bytes[i])
+			sorted[cnt++] = (bytes[i] << 16) | i;
+	}
+	qsort(sorted, cnt, sizeof(*sorted), cmp_owner_bytes);
+	for (i = 0; i < cnt && i < nr && pos < size; i++) {
+		pos += snprintf(buf + pos, size - pos, "%s%s %luKb", i ? ", " : "",
+				check_name(sorted[i] & 0xffff), ((sorted[i] >> 16) + 1023) / 1024);
+	}
+	free(sorted);
+}
+
+void show_owner_mem(void)
+{
+	char buf[1024];
+
+	show_owner_bytes(owner_bytes, 10, buf, sizeof(buf));
+	sm_msg("owner mem: %s", buf);
+}
+
+static void update_owner_peak(void)
+{
+	int i;
+
+	for (i = 0; i <= num_checks; i++) {
+		if (owner_bytes[i] > owner_peak[i])
+			owner_peak[i] = owner_bytes[i];
+	}
+}
+
+/* the peak for each check since the last call */
+void show_owner_peak_mem(void)
+{
+	char buf[1024];
+
+	if (!owner_peak)
+		return;
+	update_owner_peak();
+	show_owner_bytes(owner_peak, 10, buf, sizeof(buf));
+	if (buf[0])
+		sm_msg("peak owner mem: %s", buf);
+	memset(owner_peak, 0, (num_checks + 1) * sizeof(*owner_peak));
+}
+
+static unsigned int pool_clock;
+static int evicted_pools;
+
+/*
+ * This is the number of stree nodes we allow before we start throwing away
+ * pools.  It's roughly 100MB.
+ */
+#define POOL_NODE_BUDGET 3000000
+
 const char *show_sm(struct sm_state *sm)
 {
 	char buf[256];
@@ -141,11 +329,14 @@ int cmp_tracker(const struct sm_state *a, const struct sm_state *b)
 	if (a->owner > b->owner)
 		return 1;
 
-	ret = strcmp(a->name, b->name);
-	if (ret < 0)
-		return -1;
-	if (ret > 0)
-		return 1;
+	/* the names are interned so this is normally just the pointer check */
+	if (a->name != b->name) {
+		ret = strcmp(a->name, b->name);
+		if (ret < 0)
+			return -1;
+		if (ret > 0)
+			return 1;
+	}
 
 	if (!b->sym && a->sym)
 		return -1;
@@ -177,6 +368,44 @@ bool has_dynamic_states(unsigned short owner)
 	return dynamic_states[owner];
 }
 
+/*
+ * For checks without dynamic states there is only one sm_state for each
+ * state pointer in ->possible.  The first few states for each check get a
+ * bit and ->possible_bits says which of them are already in ->possible so
+ * we don't have to walk the list to find out.  Any other state sets
+ * POSSIBLE_UNKNOWN.
+ */
+#define POSSIBLE_BITS 13
+#define POSSIBLE_UNKNOWN (1 << POSSIBLE_BITS)
+
+static struct smatch_state *(*possible_states)[POSSIBLE_BITS];
+
+static unsigned short possible_bit(const struct sm_state *sm)
+{
+	struct smatch_state **states;
+	int i;
+
+	if (!sm->state || has_dynamic_states(sm->owner) || sm->owner >= num_checks)
+		return POSSIBLE_UNKNOWN;
+
+	if (!possible_states)
+		possible_states = calloc(num_checks, sizeof(*possible_states));
+	states = possible_states[sm->owner];
+	for (i = 0; i < POSSIBLE_BITS; i++) {
+		if (!states[i])
+			states[i] = sm->state;
+		if (states[i] == sm->state)
+			return 1 << i;
+	}
+	return POSSIBLE_UNKNOWN;
+}
+
+static void clear_possible_states(void)
+{
+	if (possible_states)
+		memset(possible_states, 0, num_checks * sizeof(*possible_states));
+}
+
 static int cmp_possible_sm(const struct sm_state *a, const struct sm_state *b, int preserve)
 {
 	int ret;
@@ -216,20 +445,135 @@ static int cmp_possible_sm(const struct sm_state *a, const struct sm_state *b, i
 				return 1;
 		}
 	}
+	/* merge_estates() hands out the same state for the same merge */
+	if (a->state == b->state)
+		return 0;
 	if (!a->state->name || !b->state->name)
 		return 0;
 
 	return strcmp(a->state->name, b->state->name);
 }
 
+/*
+ * The sm_state names are interned so that the same name is the same pointer
+ * and cmp_tracker() doesn't have to strcmp() the whole thing.  They are
+ * allocated from the sname allocator and the table is cleared at the same
+ * time as it is.
+ */
+static const char **sname_table;
+static unsigned int sname_table_size, sname_table_count;
+
+static unsigned int sname_hash(const char *str)
+{
+	unsigned int hash = 5381;
+	int c;
+
+	while ((c = *str++))
+		hash = ((hash << 5) + hash) + c;
+	return hash;
+}
+
+static void grow_sname_table(void)
+{
+	const char **old = sname_table;
+	unsigned int old_size = sname_table_size;
+	unsigned int i, j;
+
+	sname_table_size = old_size ? old_size * 2 : 4096;
+	sname_table = calloc(sname_table_size, sizeof(*sname_table));
+	for (i = 0; i < old_size; i++) {
+		if (!old[i])
+			continue;
+		j = sname_hash(old[i]) & (sname_table_size - 1);
+		while (sname_table[j])
+			j = (j + 1) & (sname_table_size - 1);
+		sname_table[j] = old[i];
+	}
+	free(old);
+}
+
+static const char *intern_sname(const char *str)
+{
+	unsigned int i;
+
+	if (!str)
+		return NULL;
+
+	if (sname_table_count * 2 >= sname_table_size)
+		grow_sname_table();
+
+	i = sname_hash(str) & (sname_table_size - 1);
+	while (sname_table[i]) {
+		if (strcmp(sname_table[i], str) == 0)
+			return sname_table[i];
+		i = (i + 1) & (sname_table_size - 1);
+	}
+	sname_table[i] = alloc_sname(str);
+	sname_table_count++;
+	return sname_table[i];
+}
+
+static void clear_sname_table(void)
+{
+	if (sname_table)
+		memset(sname_table, 0, sname_table_size * sizeof(*sname_table));
+	sname_table_count = 0;
+}
+
+/*
+ * When one check's states blow up, out_of_memory() ends up turning off the
+ * merges for every check.  With --state-budget each check can only allocate
+ * so many sm_states in a function.  The check which goes over is turned off
+ * for the rest of the function, the same as if it didn't know anything, and
+ * the others carry on as normal.  The internal owners don't have a budget.
+ */
+static unsigned int *owner_states;
+static bool *owner_over_budget;
+
+static void count_owner_state(unsigned short owner)
+{
+	if (!option_state_budget || owner >= num_checks)
+		return;
+	if (!owner_states) {
+		owner_states = calloc(num_checks, sizeof(*owner_states));
+		owner_over_budget = calloc(num_checks, sizeof(*owner_over_budget));
+	}
+	if (++owner_states[owner] <= option_state_budget || owner_over_budget[owner])
+		return;
+
+	owner_over_budget[owner] = true;
+	final_pass++;
+	sm_perror("state budget: '%s' used %u states.  Turned off for this function.",
+		  check_name(owner), owner_states[owner]);
+	final_pass--;
+}
+
+bool over_state_budget(unsigned short owner)
+{
+	return owner_over_budget && owner < num_checks && owner_over_budget[owner];
+}
+
+static void reset_state_budget(void)
+{
+	if (!owner_states)
+		return;
+	memset(owner_states, 0, num_checks * sizeof(*owner_states));
+	memset(owner_over_budget, 0, num_checks * sizeof(*owner_over_budget));
+}
+
 struct sm_state *alloc_sm_state(int owner, const char *name,
 				struct symbol *sym, struct smatch_state *state)
 {
 	struct sm_state *sm_state = __alloc_sm_state(0);
 
 	sm_state_counter++;
+	sm_state_total++;
+	if (option_state_profile)
+		get_owner_profile(owner)->sm_states++;
+	charge_owner(owner, sizeof(*sm_state) + sizeof(void *));
+	count_owner_state(owner);
 
-	sm_state->name = alloc_sname(name);
+	sm_state->name = intern_sname(name);
 	sm_state->owner = owner;
 	sm_state->sym = sym;
 	sm_state->state = state;
@@ -239,7 +583,10 @@ struct sm_state *alloc_sm_state(int owner, const char *name,
 	sm_state->left = NULL;
 	sm_state->right = NULL;
 	sm_state->possible = NULL;
+	sm_ptrlist_hack = 1;
 	add_ptr_list(&sm_state->possible, sm_state);
+	sm_ptrlist_hack = 0;
+	sm_state->possible_bits = possible_bit(sm_state);
 	return sm_state;
 }
 
@@ -264,9 +611,19 @@ int too_many_possible(struct sm_state *sm)
 void add_possible_sm(struct sm_state *to, struct sm_state *new)
 {
 	struct sm_state *tmp;
+	unsigned short bit;
 	int preserve = 1;
 	int cmp;
 
+	/* people sometimes free ->possible and start over */
+	if (!to->possible)
+		to->possible_bits = 0;
+
+	bit = possible_bit(new);
+	if (bit != POSSIBLE_UNKNOWN && (to->possible_bits & bit))
+		return;
+	to->possible_bits |= bit;
+
 	if (too_many_possible(to))
 		preserve = 0;
 
@@ -277,11 +634,36 @@ void add_possible_sm(struct sm_state *to, struct sm_state *new)
 		else if (cmp == 0) {
 			return;
 		} else {
+			sm_ptrlist_hack = 1;
 			INSERT_CURRENT(new, tmp);
+			sm_ptrlist_hack = 0;
+			charge_owner(to->owner, sizeof(void *));
 			return;
 		}
 	} END_FOR_EACH_PTR(tmp);
+	sm_ptrlist_hack = 1;
 	add_ptr_list(&to->possible, new);
+	sm_ptrlist_hack = 0;
+	charge_owner(to->owner, sizeof(void *));
+}
+
+/*
+ * The ->possible lists come from sm_ptrlist which is cleared at the end of
+ * the function.  Don't use free_slist() on them.
+ */
+void clear_possibles(struct sm_state *sm)
+{
+	sm->possible = NULL;
+}
+
+static struct state_list *clone_possibles(struct state_list *possible)
+{
+	struct state_list *ret;
+
+	sm_ptrlist_hack = 1;
+	ret = clone_slist(possible);
+	sm_ptrlist_hack = 0;
+	return ret;
 }
 
 static void copy_possibles(struct sm_state *to, struct sm_state *one, struct sm_state *two)
@@ -302,8 +684,14 @@ static void copy_possibles(struct sm_state *to, struct sm_state *one, struct sm_
 		small = one;
 	}
 
-	to->possible = clone_slist(large->possible);
+	to->possible = clone_possibles(large->possible);
+	to->possible_bits = large->possible_bits;
 	add_possible_sm(to, to);
+
+	if (!(small->possible_bits & POSSIBLE_UNKNOWN) &&
+	    !(small->possible_bits & ~to->possible_bits))
+		return;
+
 	FOR_EACH_PTR(small->possible, tmp) {
 		add_possible_sm(to, tmp);
 	} END_FOR_EACH_PTR(tmp);
@@ -321,34 +709,33 @@ char *alloc_sname(const char *str)
 }
 
 static struct symbol *oom_func;
-static int oom_limit = 3000000;  /* Start with a 3GB limit */
 int out_of_memory(void)
 {
 	if (oom_func)
 		return 1;
 
 	/*
-	 * I decided to use 50M here based on trial and error.
+	 * I decided to use 100M here based on trial and error.
 	 * It works out OK for the kernel and so it should work
 	 * for most other projects as well.
 	 */
-	if (sm_state_counter * sizeof(struct sm_state) >= 100000000)
+	if (sm_state_allocator.useful_bytes >= 100000000)
+		return 1;
+	if (__degraded_pass && sm_state_allocator.useful_bytes >= 25000000)
 		return 1;
 
 	/*
-	 * We're reading from statm to figure out how much memory we
-	 * are using.  The problem is that at the end of the function
-	 * we release the memory, so that it can be re-used but it
-	 * stays in cache, it's not released to the OS.  So then if
-	 * we allocate memory for different purposes we can easily
-	 * hit the 3GB limit on the next function, so that's why I give
-	 * the next function an extra 100MB to work with.
-	 *
+	 * This used to read statm but freed memory isn't given back to the
+	 * OS so the limit had to be bumped after every function which ran
+	 * out.  The allocators know how much they are holding so use that.
 	 */
-	if (get_mem_kb() > oom_limit) {
+	if (get_allocated_kb() > mem_budget_kb()) {
+		char buf[256];
+
 		oom_func = cur_func_sym;
 		final_pass++;
-		sm_perror("OOM: %luKb sm_state_count = %d", get_mem_kb(), sm_state_counter);
+		show_owner_bytes(owner_bytes, 3, buf, sizeof(buf));
+		sm_perror("OOM: %luKb sm_state_count = %d (%s)", get_allocated_kb(), sm_state_counter, buf);
 		final_pass--;
 		return 1;
 	}
@@ -358,58 +745,140 @@ int out_of_memory(void)
 
 int low_on_memory(void)
 {
-	if (sm_state_counter * sizeof(struct sm_state) >= 25000000)
+	if (sm_state_allocator.useful_bytes >= 25000000)
+		return 1;
+	if (mem_pool_low())
 		return 1;
 	return 0;
 }
 
-static void free_sm_state(struct sm_state *sm)
-{
-	free_slist(&sm->possible);
-	/*
-	 * fixme.  Free the actual state.
-	 * Right now we leave it until the end of the function
-	 * because we don't want to double free it.
-	 * Use the freelist to not double free things
-	 */
-}
-
-static void free_all_sm_states(struct allocation_blob *blob)
-{
-	unsigned int size = sizeof(struct sm_state);
-	unsigned int offset = 0;
-
-	while (offset < blob->offset) {
-		free_sm_state((struct sm_state *)(blob->data + offset));
-		offset += size;
-	}
-}
-
 /* At the end of every function we free all the sm_states */
 void free_every_single_sm_state(void)
 {
 	struct allocator_struct *desc = &sm_state_allocator;
 	struct allocation_blob *blob = desc->blobs;
 
+	if (option_state_profile)
+		print_state_profile();
+
+	if (owner_bytes) {
+		update_owner_peak();
+		memset(owner_bytes, 0, (num_checks + 1) * sizeof(*owner_bytes));
+	}
+	reset_state_budget();
+
 	desc->blobs = NULL;
 	desc->allocations = 0;
 	desc->total_bytes = 0;
 	desc->useful_bytes = 0;
 	desc->freelist = NULL;
+	desc->freelist_bytes = 0;
 	while (blob) {
 		struct allocation_blob *next = blob->next;
-		free_all_sm_states(blob);
-		blob_free(blob, desc->chunking);
+		free_allocation_blob(desc, blob);
 		blob = next;
 	}
+	clear_sm_ptrlist_alloc();
+	clear_small_sm_ptrlist_alloc();
 	clear_sname_alloc();
+	clear_sname_table();
 	clear_smatch_state_alloc();
+	clear_possible_states();
 
 	free_stack_and_strees(&all_pools);
+	evicted_pools = 0;
 	sm_state_counter = 0;
-	if (oom_func) {
-		oom_limit += 100000;
-		oom_func = NULL;
+	oom_func = NULL;
+}
+
+/* Evicting pools is least recently used first */
+void touch_pool(struct stree *pool)
+{
+	if (pool)
+		pool->pool_used = ++pool_clock;
+}
+
+static int cmp_pool_used(const void *a, const void *b)
+{
+	const struct stree *one = *(const struct stree **)a;
+	const struct stree *two = *(const struct stree **)b;
+
+	if (one->pool_used != two->pool_used)
+		return one->pool_used < two->pool_used ? -1 : 1;
+	return 0;
+}
+
+static int cmp_pool_ptr(const void *a, const void *b)
+{
+	const struct stree *one = *(const struct stree **)a;
+	const struct stree *two = *(const struct stree **)b;
+
+	if (one == two)
+		return 0;
+	return one < two ? -1 : 1;
+}
+
+static void forget_evicted_pools(struct stree **evicted, int nr)
+{
+	struct allocation_blob *blob;
+	struct sm_state *sm;
+	unsigned int offset;
+
+	for (blob = sm_state_allocator.blobs; blob; blob = blob->next) {
+		offset = ALIGN(offsetof(struct allocation_blob, data), SM_STATE_ALIGN) -
+			 offsetof(struct allocation_blob, data);
+		for (; offset < blob->offset; offset += sizeof(*sm)) {
+			sm = (struct sm_state *)(blob->data + offset);
+			if (!sm->pool)
+				continue;
+			if (bsearch(&sm->pool, evicted, nr, sizeof(*evicted), cmp_pool_ptr))
+				sm->pool = NULL;
+		}
+	}
+}
+
+/*
+ * When there are too many pools, free the least recently used half instead
+ * of turning off implications for the rest of the function.  The sm_states
+ * which pointed to an evicted pool act like they don't have a pool so
+ * they don't contribute implications any more.
+ */
+static void evict_pools(void)
+{
+	static struct symbol *printed;
+	struct stree **pools;
+	struct stree *stree;
+	int nr, evict, i;
+
+	nr = ptr_list_size((struct ptr_list *)all_pools);
+	if (nr < 2)
+		return;
+
+	pools = malloc(nr * sizeof(*pools));
+	i = 0;
+	FOR_EACH_PTR(all_pools, stree) {
+		pools[i++] = stree;
+	} END_FOR_EACH_PTR(stree);
+	qsort(pools, nr, sizeof(*pools), cmp_pool_used);
+
+	evict = nr / 2;
+	qsort(pools, evict, sizeof(*pools), cmp_pool_ptr);
+	forget_evicted_pools(pools, evict);
+
+	/* each entry in all_pools holds a reference */
+	FOR_EACH_PTR(all_pools, stree) {
+		if (!bsearch(&stree, pools, evict, sizeof(*pools), cmp_pool_ptr))
+			continue;
+		DELETE_CURRENT_PTR(stree);
+		free_stree(&stree);
+	} END_FOR_EACH_PTR(stree);
+	PACK_PTR_LIST(&all_pools);
+	free(pools);
+
+	evicted_pools += evict;
+	if (!__inline_fn && final_pass && printed != cur_func_sym) {
+		sm_perror("evicting implication pools (%d so far)", evicted_pools);
+		printed = cur_func_sym;
 	}
 }
 
@@ -427,7 +896,8 @@ struct sm_state *clone_sm(struct sm_state *s)
 	ret->line = s->line;
 	/* clone_sm() doesn't copy the pools.  Each state needs to have
 	   only one pool. */
-	ret->possible = clone_slist(s->possible);
+	ret->possible = clone_possibles(s->possible);
+	ret->possible_bits = s->possible_bits;
 	ret->left = s->left;
 	ret->right = s->right;
 	return ret;
@@ -505,6 +975,9 @@ struct sm_state *merge_sm_states(struct sm_state *one, struct sm_state *two)
 		return one;
 	}
 	warned = 0;
+	sm_merge_total++;
+	if (option_state_profile)
+		get_owner_profile(one->owner)->merges++;
 	s = merge_states(one->owner, one->name, one->sym, one->state, two->state);
 	result = alloc_state_no_name(one->owner, one->name, one->sym, s);
 	result->merged = 1;
@@ -553,6 +1026,29 @@ struct sm_state *merge_sm_states(struct sm_state *one, struct sm_state *two)
 	return result;
 }
 
+/*
+ * Most lookups are for a variable by its own name, "x" and the symbol for
+ * x.  Those are cached in an array indexed by the symbol's number and the
+ * owner.  The stree ->gen changes every time the stree changes so an entry
+ * is only used while the stree is the same.  Misses are cached as well.
+ */
+#define STATE_CACHE_SIZE 16384
+
+static struct {
+	unsigned long long gen;
+	struct symbol *sym;
+	int owner;
+	struct sm_state *sm;
+} state_cache[STATE_CACHE_SIZE];
+
+static bool is_plain_var(const char *name, struct symbol *sym)
+{
+	if (!sym || !sym->ident)
+		return false;
+	return name[0] == sym->ident->name[0] &&
+	       strcmp(name, sym->ident->name) == 0;
+}
+
 struct sm_state *get_sm_state_stree(struct stree *stree, int owner, const char *name,
 				struct symbol *sym)
 {
@@ -561,11 +1057,27 @@ struct sm_state *get_sm_state_stree(struct stree *stree, int owner, const char *
 		.name = (char *)name,
 		.sym = sym,
 	};
+	struct sm_state *sm;
+	unsigned int idx;
 
-	if (!name)
+	if (!name || !stree)
 		return NULL;
 
-	return avl_lookup(stree, (struct sm_state *)&tracker);
+	if (owner >= num_checks || !is_plain_var(name, sym))
+		return avl_lookup(stree, (struct sm_state *)&tracker);
+
+	idx = (get_sym_nr(sym) * num_checks + owner) % STATE_CACHE_SIZE;
+	if (state_cache[idx].gen == stree->gen &&
+	    state_cache[idx].sym == sym &&
+	    state_cache[idx].owner == owner)
+		return state_cache[idx].sm;
+
+	sm = avl_lookup(stree, (struct sm_state *)&tracker);
+	state_cache[idx].gen = stree->gen;
+	state_cache[idx].sym = sym;
+	state_cache[idx].owner = owner;
+	state_cache[idx].sm = sm;
+	return sm;
 }
 
 struct smatch_state *get_state_stree(struct stree *stree,
@@ -732,40 +1244,39 @@ static void match_states_stree(struct stree **one, struct stree **two)
 	struct sm_state *sm;
 	struct state_list *add_to_one = NULL;
 	struct state_list *add_to_two = NULL;
-	AvlIter one_iter;
-	AvlIter two_iter;
+	AvlPairIter iter;
+	int cmp;
 
 	__set_cur_stree_readonly();
 
-	avl_iter_begin(&one_iter, *one, FORWARD);
-	avl_iter_begin(&two_iter, *two, FORWARD);
+	avl_pair_begin(&iter, *one, *two);
 
 	for (;;) {
-		if (!one_iter.sm && !two_iter.sm)
+		if (!iter.one && !iter.two)
 			break;
-		if (cmp_tracker(one_iter.sm, two_iter.sm) < 0) {
+		cmp = cmp_tracker(iter.one, iter.two);
+		if (cmp < 0) {
 			__set_fake_cur_stree_fast(*two);
 			__in_unmatched_hook++;
-			tmp_state = __client_unmatched_state_function(one_iter.sm);
+			tmp_state = __client_unmatched_state_function(iter.one);
 			__in_unmatched_hook--;
 			__pop_fake_cur_stree_fast();
-			sm = alloc_state_no_name(one_iter.sm->owner, one_iter.sm->name,
-						  one_iter.sm->sym, tmp_state);
+			sm = alloc_state_no_name(iter.one->owner, iter.one->name,
+						  iter.one->sym, tmp_state);
 			add_ptr_list(&add_to_two, sm);
-			avl_iter_next(&one_iter);
-		} else if (cmp_tracker(one_iter.sm, two_iter.sm) == 0) {
-			avl_iter_next(&one_iter);
-			avl_iter_next(&two_iter);
+			avl_pair_next(&iter, true, false);
+		} else if (cmp == 0) {
+			avl_pair_next(&iter, true, true);
 		} else {
 			__set_fake_cur_stree_fast(*one);
 			__in_unmatched_hook++;
-			tmp_state = __client_unmatched_state_function(two_iter.sm);
+			tmp_state = __client_unmatched_state_function(iter.two);
 			__in_unmatched_hook--;
 			__pop_fake_cur_stree_fast();
-			sm = alloc_state_no_name(two_iter.sm->owner, two_iter.sm->name,
-						  two_iter.sm->sym, tmp_state);
+			sm = alloc_state_no_name(iter.two->owner, iter.two->name,
+						  iter.two->sym, tmp_state);
 			add_ptr_list(&add_to_one, sm);
-			avl_iter_next(&two_iter);
+			avl_pair_next(&iter, false, true);
 		}
 	}
 
@@ -840,6 +1351,20 @@ static void clone_pool_havers_stree(struct stree **stree)
 
 int __stree_id;
 
+/*
+ * We hold a reference to implied_one and implied_two.  If set_stree_id() has
+ * to copy one of them because it's already a pool then drop the reference
+ * to the original or it stays around until the end of the function.
+ */
+static void set_pool_id(struct stree **stree)
+{
+	struct stree *old = *stree;
+
+	set_stree_id(stree, ++__stree_id);
+	if (*stree != old)
+		free_stree(&old);
+}
+
 /*
  * merge_slist() is called whenever paths merge, such as after
  * an if statement.  It takes the two slists and creates one.
@@ -849,8 +1374,7 @@ static void __merge_stree(struct stree **to, struct stree *stree, int add_pool)
 	struct stree *results = NULL;
 	struct stree *implied_one = NULL;
 	struct stree *implied_two = NULL;
-	AvlIter one_iter;
-	AvlIter two_iter;
+	AvlPairIter iter;
 	struct sm_state *one, *two, *res;
 
 	if (out_of_memory())
@@ -867,6 +1391,9 @@ static void __merge_stree(struct stree **to, struct stree *stree, int add_pool)
 		return;
 	}
 
+	if (add_pool && unfree_avl_node > POOL_NODE_BUDGET)
+		evict_pools();
+
 	implied_one = clone_stree(*to);
 	implied_two = clone_stree(stree);
 
@@ -877,8 +1404,8 @@ static void __merge_stree(struct stree **to, struct stree *stree, int add_pool)
 		clone_pool_havers_stree(&implied_one);
 		clone_pool_havers_stree(&implied_two);
 
-		set_stree_id(&implied_one, ++__stree_id);
-		set_stree_id(&implied_two, ++__stree_id);
+		set_pool_id(&implied_one);
+		set_pool_id(&implied_two);
 		if (implied_one->base_stree)
 			set_stree_id(&implied_one->base_stree, ++__stree_id);
 		if (implied_two->base_stree)
@@ -887,19 +1414,32 @@ static void __merge_stree(struct stree **to, struct stree *stree, int add_pool)
 
 	push_stree(&all_pools, implied_one);
 	push_stree(&all_pools, implied_two);
+	sm_pool_total += 2;
+	touch_pool(implied_one);
+	touch_pool(implied_two);
+
+	/*
+	 * The strees have the same trackers now.  Start with the states from
+	 * implied_one and only replace the ones which are different in
+	 * implied_two.
+	 */
+	results = avl_copy(implied_one);
 
-	avl_iter_begin(&one_iter, implied_one, FORWARD);
-	avl_iter_begin(&two_iter, implied_two, FORWARD);
+	avl_pair_begin(&iter, implied_one, implied_two);
 
 	for (;;) {
-		if (!one_iter.sm || !two_iter.sm)
+		if (!iter.one || !iter.two)
 			break;
 
-		one = one_iter.sm;
-		two = two_iter.sm;
+		one = iter.one;
+		two = iter.two;
+
+		if (one == two)
+			goto next;
 
-		if (one == two) {
-			avl_insert(&results, one);
+		/* a check which is over its budget forgets what it knew */
+		if (over_state_budget(one->owner)) {
+			avl_remove(&results, one);
 			goto next;
 		}
 
@@ -910,16 +1450,20 @@ static void __merge_stree(struct stree **to, struct stree *stree, int add_pool)
 			two->pool = implied_two;
 			if (implied_two->base_stree)
 				two->pool = implied_two->base_stree;
+			if (option_state_profile)
+				get_owner_profile(one->owner)->pool_states += 2;
 		}
 		res = merge_sm_states(one, two);
 		add_possible_sm(res, one);
 		add_possible_sm(res, two);
 		avl_insert(&results, res);
 next:
-		avl_iter_next(&one_iter);
-		avl_iter_next(&two_iter);
+		avl_pair_next(&iter, true, true);
 	}
 
+	if (option_state_profile)
+		profile_stree_size(results);
+
 	free_stree(to);
 	*to = results;
 }
@@ -945,11 +1489,12 @@ void merge_fake_stree(struct stree **to, struct stree *stree)
 {
 	struct stree *one = *to;
 	struct stree *two = stree;
+	struct stree *base_one, *base_two;
 	struct sm_state *sm;
 	struct state_list *add_to_one = NULL;
 	struct state_list *add_to_two = NULL;
-	AvlIter one_iter;
-	AvlIter two_iter;
+	AvlPairIter iter;
+	int cmp;
 
 	if (!stree)
 		return;
@@ -960,47 +1505,59 @@ void merge_fake_stree(struct stree **to, struct stree *stree)
 		return;
 	}
 
-	avl_iter_begin(&one_iter, one, FORWARD);
-	avl_iter_begin(&two_iter, two, FORWARD);
+	avl_pair_begin(&iter, one, two);
 
 	for (;;) {
-		if (!one_iter.sm && !two_iter.sm)
+		if (!iter.one && !iter.two)
 			break;
-		if (cmp_tracker(one_iter.sm, two_iter.sm) < 0) {
-			sm = get_sm_state(one_iter.sm->owner, one_iter.sm->name,
-					  one_iter.sm->sym);
+		cmp = cmp_tracker(iter.one, iter.two);
+		if (cmp < 0) {
+			sm = get_sm_state(iter.one->owner, iter.one->name,
+					  iter.one->sym);
 			if (sm)
 				add_ptr_list(&add_to_two, sm);
-			avl_iter_next(&one_iter);
-		} else if (cmp_tracker(one_iter.sm, two_iter.sm) == 0) {
-			avl_iter_next(&one_iter);
-			avl_iter_next(&two_iter);
+			avl_pair_next(&iter, true, false);
+		} else if (cmp == 0) {
+			avl_pair_next(&iter, true, true);
 		} else {
-			sm = get_sm_state(two_iter.sm->owner, two_iter.sm->name,
-					  two_iter.sm->sym);
+			sm = get_sm_state(iter.two->owner, iter.two->name,
+					  iter.two->sym);
 			if (sm)
 				add_ptr_list(&add_to_one, sm);
-			avl_iter_next(&two_iter);
+			avl_pair_next(&iter, false, true);
 		}
 	}
 
+	/*
+	 * The base strees are the cur stree with the fake states on top.
+	 * Most of the states in add_to_one and add_to_two are straight from
+	 * the cur stree so only the fake states and the ones which came from
+	 * an outer fake stree have to be copied into the bases.
+	 */
+	base_one = clone_stree(__get_cur_stree());
+	FOR_EACH_SM(one, sm) {
+		avl_insert(&base_one, sm);
+	} END_FOR_EACH_SM(sm);
+
+	base_two = clone_stree(__get_cur_stree());
+	FOR_EACH_SM(two, sm) {
+		avl_insert(&base_two, sm);
+	} END_FOR_EACH_SM(sm);
+
 	FOR_EACH_PTR(add_to_one, sm) {
+		if (get_sm_state_stree(__get_cur_stree(), sm->owner, sm->name, sm->sym) != sm)
+			avl_insert(&base_one, sm);
 		avl_insert(&one, sm);
 	} END_FOR_EACH_PTR(sm);
 
 	FOR_EACH_PTR(add_to_two, sm) {
+		if (get_sm_state_stree(__get_cur_stree(), sm->owner, sm->name, sm->sym) != sm)
+			avl_insert(&base_two, sm);
 		avl_insert(&two, sm);
 	} END_FOR_EACH_PTR(sm);
 
-	one->base_stree = clone_stree(__get_cur_stree());
-	FOR_EACH_SM(one, sm) {
-		avl_insert(&one->base_stree, sm);
-	} END_FOR_EACH_SM(sm);
-
-	two->base_stree = clone_stree(__get_cur_stree());
-	FOR_EACH_SM(two, sm) {
-		avl_insert(&two->base_stree, sm);
-	} END_FOR_EACH_SM(sm);
+	one->base_stree = base_one;
+	two->base_stree = base_two;
 
 	free_slist(&add_to_one);
 	free_slist(&add_to_two);
@@ -1010,33 +1567,69 @@ void merge_fake_stree(struct stree **to, struct stree *stree)
 	*to = one;
 }
 
+/*
+ * Merge a list of fake strees, such as one for every return_states row of a
+ * call.  Folding them into one result one at a time means every merge
+ * walks all the states which the earlier strees set.  Merging them in pairs
+ * means each state is only merged log(n) times.  The strees are freed.
+ */
+struct stree *merge_fake_stree_stack(struct stree_stack **stack)
+{
+	struct stree **strees, *stree, *ret;
+	int nr, i, step;
+
+	nr = ptr_list_size((struct ptr_list *)*stack);
+	if (!nr)
+		return NULL;
+
+	strees = malloc(nr * sizeof(*strees));
+	i = 0;
+	FOR_EACH_PTR(*stack, stree) {
+		strees[i++] = stree;
+	} END_FOR_EACH_PTR(stree);
+	free_stree_stack(stack);
+
+	for (step = 1; step < nr; step *= 2) {
+		for (i = 0; i + step < nr; i += step * 2) {
+			merge_fake_stree(&strees[i], strees[i + step]);
+			free_stree(&strees[i + step]);
+		}
+	}
+
+	ret = strees[0];
+	free(strees);
+	return ret;
+}
+
 /*
  * filter_slist() removes any sm states "slist" holds in common with "filter"
  */
+/*
+ * Remove the states which are the same in filter.  The strees normally
+ * share everything except for a few states so this only looks at the
+ * parts which are different.
+ */
 void filter_stree(struct stree **stree, struct stree *filter)
 {
 	struct stree *results = NULL;
-	AvlIter one_iter;
-	AvlIter two_iter;
-
-	avl_iter_begin(&one_iter, *stree, FORWARD);
-	avl_iter_begin(&two_iter, filter, FORWARD);
+	AvlPairIter iter;
+	int cmp;
 
-	/* FIXME: This should probably be re-written with trees in mind */
+	avl_pair_begin(&iter, *stree, filter);
 
 	for (;;) {
-		if (!one_iter.sm && !two_iter.sm)
+		if (!iter.one)
 			break;
-		if (cmp_tracker(one_iter.sm, two_iter.sm) < 0) {
-			avl_insert(&results, one_iter.sm);
-			avl_iter_next(&one_iter);
-		} else if (cmp_tracker(one_iter.sm, two_iter.sm) == 0) {
-			if (one_iter.sm != two_iter.sm)
-				avl_insert(&results, one_iter.sm);
-			avl_iter_next(&one_iter);
-			avl_iter_next(&two_iter);
+		cmp = cmp_tracker(iter.one, iter.two);
+		if (cmp < 0) {
+			avl_insert(&results, iter.one);
+			avl_pair_next(&iter, true, false);
+		} else if (cmp == 0) {
+			if (iter.one != iter.two)
+				avl_insert(&results, iter.one);
+			avl_pair_next(&iter, true, true);
 		} else {
-			avl_iter_next(&two_iter);
+			avl_pair_next(&iter, false, true);
 		}
 	}
 
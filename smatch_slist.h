@@ -1,6 +1,7 @@
 struct stree;
 
 extern int unfree_stree;
+extern int unfree_avl_node;
 
 DECLARE_PTR_LIST(state_list, struct sm_state);
 DECLARE_PTR_LIST(state_list_stack, struct state_list);
@@ -17,6 +18,9 @@ DECLARE_PTR_LIST(named_stree_stack, struct named_stree);
 extern struct state_list_stack *implied_pools;
 extern int __stree_id;
 extern int sm_state_counter;
+extern unsigned long sm_state_total;
+extern unsigned long sm_merge_total;
+extern unsigned long sm_pool_total;
 
 const char *show_sm(struct sm_state *sm);
 void __print_stree(struct stree *stree);
@@ -28,6 +32,7 @@ struct sm_state *alloc_sm_state(int owner, const char *name,
 				struct symbol *sym, struct smatch_state *state);
 
 void free_every_single_sm_state(void);
+void touch_pool(struct stree *pool);
 struct sm_state *clone_sm(struct sm_state *s);
 int is_merged(struct sm_state *sm);
 int is_leaf(struct sm_state *sm);
@@ -37,6 +42,7 @@ int slist_has_state(struct state_list *slist, struct smatch_state *state);
 
 int too_many_possible(struct sm_state *sm);
 void add_possible_sm(struct sm_state *to, struct sm_state *new);
+void clear_possibles(struct sm_state *sm);
 struct sm_state *merge_sm_states(struct sm_state *one, struct sm_state *two);
 struct smatch_state *get_state_stree(struct stree *stree, int owner, const char *name,
 		    struct symbol *sym);
@@ -64,6 +70,8 @@ void free_slist(struct state_list **slist);
 void free_stree_stack(struct stree_stack **stack);
 void free_stack_and_strees(struct stree_stack **stree_stack);
 unsigned long get_pool_count(void);
+void show_owner_mem(void);
+void show_owner_peak_mem(void);
 
 struct sm_state *set_state_stree_stack(struct stree_stack **stack, int owner, const char *name,
 				struct symbol *sym, struct smatch_state *state);
@@ -75,11 +83,13 @@ struct smatch_state *get_state_stree_stack(struct stree_stack *stack, int owner,
 				const char *name, struct symbol *sym);
 
 int out_of_memory(void);
+bool over_state_budget(unsigned short owner);
 int low_on_memory(void);
 void merge_stree(struct stree **to, struct stree *stree);
 void merge_stree_no_pools(struct stree **to, struct stree *stree);
 void merge_stree(struct stree **to, struct stree *right);
 void merge_fake_stree(struct stree **to, struct stree *stree);
+struct stree *merge_fake_stree_stack(struct stree_stack **stack);
 void filter_stree(struct stree **stree, struct stree *filter);
 void and_stree_stack(struct stree_stack **stree_stack);
 
@@ -0,0 +1,326 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * The sql_insert() macros print the values as an SQL tuple like:
+ * "0x1234, 'frob', -1, '$->foo', '0-u32max'".  This splits that back into
+ * separate values so they can be written as rows or bound to a prepared
+ * statement.  It's used by smatch and by the sm_fill_db loader so it
+ * shouldn't depend on anything except SQLite.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sqlite3.h>
+#include "smatch_sql_values.h"
+
+static char *skip_spaces(char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+static bool is_number_char(char c)
+{
+	if (c >= '0' && c <= '9')
+		return true;
+	if (c >= 'a' && c <= 'f')
+		return true;
+	if (c >= 'A' && c <= 'F')
+		return true;
+	return c == 'x' || c == 'X' || c == '-' || c == '+' || c == '.';
+}
+
+/*
+ * Split "buf" in place.  Quoted strings are unescaped ('' becomes ') and the
+ * values are NUL terminated.  Returns the number of values or -1 if the
+ * tuple isn't something simple that we understand.
+ */
+int sql_split_values(char *buf, struct sql_value *vals, int max)
+{
+	char *p = buf;
+	char *out;
+	int cnt = 0;
+
+	p = skip_spaces(p);
+	if (*p == '\0')
+		return 0;
+
+	while (1) {
+		if (cnt == max)
+			return -1;
+
+		p = skip_spaces(p);
+		if (*p == '\'') {
+			vals[cnt].type = SQL_VAL_TEXT;
+			p++;
+			vals[cnt].str = out = p;
+			while (1) {
+				if (*p == '\0')
+					return -1;
+				if (*p == '\'') {
+					if (p[1] != '\'')
+						break;
+					p++;
+				}
+				*out++ = *p++;
+			}
+			p++;
+			*out = '\0';
+			vals[cnt].len = out - vals[cnt].str;
+		} else {
+			vals[cnt].type = SQL_VAL_INT;
+			vals[cnt].str = p;
+			while (is_number_char(*p))
+				p++;
+			vals[cnt].len = p - vals[cnt].str;
+			if (vals[cnt].len == 0)
+				return -1;
+			if (memchr(vals[cnt].str, '.', vals[cnt].len))
+				vals[cnt].type = SQL_VAL_FLOAT;
+		}
+		cnt++;
+
+		out = p;
+		p = skip_spaces(p);
+		if (*p == '\0') {
+			*out = '\0';
+			return cnt;
+		}
+		if (*p != ',')
+			return -1;
+		*out = '\0';
+		p++;
+	}
+}
+
+/*
+ * Split "insert [or ignore] into table values(...);" in place.  Returns the
+ * number of values or -1 for anything else, which has to go to SQLite as it
+ * is.
+ */
+int sql_split_insert(char *sql, const char **table, int *table_len, int *ignore,
+		     struct sql_value *vals, int max)
+{
+	char *p, *end;
+	int len;
+
+	*ignore = 0;
+	p = skip_spaces(sql);
+	if (strncmp(p, "insert ", 7) != 0)
+		return -1;
+	p += 7;
+	if (strncmp(p, "or ignore ", 10) == 0) {
+		*ignore = 1;
+		p += 10;
+	}
+	if (strncmp(p, "into ", 5) != 0)
+		return -1;
+	*table = p + 5;
+	len = strspn(*table, "abcdefghijklmnopqrstuvwxyz_0123456789");
+	if (len == 0)
+		return -1;
+	*table_len = len;
+	p = skip_spaces((char *)*table + len);
+	if (strncmp(p, "values", 6) != 0)
+		return -1;
+	p = skip_spaces(p + 6);
+	if (*p != '(')
+		return -1;
+	p++;
+
+	end = strrchr(p, ')');
+	if (!end || strspn(end + 1, "; \n") != strlen(end + 1))
+		return -1;
+	*end = '\0';
+
+	len = sql_split_values(p, vals, max);
+	return len > 0 ? len : -1;
+}
+
+/* "<type><len>:<value>", returns a pointer to the end or NULL */
+static char *split_row_value(char *p, struct sql_value *val)
+{
+	switch (*p++) {
+	case 'i':
+		val->type = SQL_VAL_INT;
+		break;
+	case 'f':
+		val->type = SQL_VAL_FLOAT;
+		break;
+	case 's':
+		val->type = SQL_VAL_TEXT;
+		break;
+	default:
+		return NULL;
+	}
+	val->len = strtol(p, &p, 10);
+	if (*p++ != ':' || val->len < 0 || strnlen(p, val->len) != val->len)
+		return NULL;
+	val->str = p;
+	return p + val->len;
+}
+
+/*
+ * Split " <type><len>:<value> ..." into vals[start] to vals[end - 1].  The
+ * values were NUL terminated in smatch but not here.  That overwrites the
+ * space after each value so it returns a pointer past the space.
+ */
+static char *split_row_values(char *p, struct sql_value *vals, int start, int end)
+{
+	int i;
+
+	for (i = start; i < end; i++) {
+		if (*p++ != ' ')
+			return NULL;
+		p = split_row_value(p, &vals[i]);
+		if (!p)
+			return NULL;
+	}
+	if (*p == ' ')
+		p++;
+	else if (*p)
+		return NULL;
+	for (i = start; i < end; i++)
+		((char *)vals[i].str)[vals[i].len] = '\0';
+	return p;
+}
+
+static char *split_row_head(char *row, const char **table, int *table_len,
+			    int *ignore, int *late, int *cnt, int max)
+{
+	char *p;
+
+	*table = row;
+	*table_len = strcspn(row, " ");
+	p = row + *table_len;
+	if (p[0] != ' ' || !p[1] || !p[2])
+		return NULL;
+	*ignore = p[1] == 'i';
+	*late = p[2] == 'l';
+	p += 3;
+	*cnt = strtol(p, &p, 10);
+	if (*cnt <= 0 || *cnt > max)
+		return NULL;
+	return p;
+}
+
+/*
+ * Split a --sql-rows record, "<table> <flags> <count> <type><len>:<value> ..."
+ * in place.  Returns the number of values or -1 if it's garbled.
+ */
+int sql_split_row(char *row, const char **table, int *table_len, int *ignore,
+		  int *late, struct sql_value *vals, int max)
+{
+	char *p;
+	int cnt;
+
+	p = split_row_head(row, table, table_len, ignore, late, &cnt, max);
+	if (!p)
+		return -1;
+	p = split_row_values(p, vals, 0, cnt);
+	if (!p || *p)
+		return -1;
+	return cnt;
+}
+
+/*
+ * Split the start of a grouped record,
+ * "<table> <flags> <count> <shared> <shared values> <row values>...",
+ * into vals[0] to vals[shared - 1].  The rows are read with sql_next_row().
+ * Returns the number of values in a row or -1 if it's garbled.
+ */
+int sql_split_rows(char *row, const char **table, int *table_len, int *ignore,
+		   int *late, struct sql_value *vals, int max, int *shared,
+		   char **next)
+{
+	char *p;
+	int cnt;
+
+	p = split_row_head(row, table, table_len, ignore, late, &cnt, max);
+	if (!p || *p != ' ')
+		return -1;
+	*shared = strtol(p + 1, &p, 10);
+	if (*shared <= 0 || *shared >= cnt)
+		return -1;
+	p = split_row_values(p, vals, 0, *shared);
+	if (!p || !*p)
+		return -1;
+	*next = p;
+	return cnt;
+}
+
+/*
+ * Fill in vals[shared] to vals[cnt - 1] with the next row.  Returns 1 if
+ * there was a row, 0 at the end and -1 if it's garbled.
+ */
+int sql_next_row(char **next, struct sql_value *vals, int shared, int cnt)
+{
+	char *p = *next;
+
+	if (!*p)
+		return 0;
+	/* the space before the first value was eaten by split_row_values() */
+	p = split_row_value(p, &vals[shared]);
+	if (!p)
+		return -1;
+	p = split_row_values(p, vals, shared + 1, cnt);
+	if (!p)
+		return -1;
+	((char *)vals[shared].str)[vals[shared].len] = '\0';
+	*next = p;
+	return 1;
+}
+
+void sql_bind_value(struct sqlite3_stmt *stmt, int idx, struct sql_value *val)
+{
+	char *end;
+	long long ll;
+
+	/*
+	 * This is supposed to store exactly what SQLite would store if it
+	 * parsed the literal.  Decimals which don't fit in an s64 are REAL.
+	 */
+	switch (val->type) {
+	case SQL_VAL_TEXT:
+		sqlite3_bind_text(stmt, idx, val->str, val->len, SQLITE_STATIC);
+		return;
+	case SQL_VAL_FLOAT:
+		sqlite3_bind_double(stmt, idx, strtod(val->str, NULL));
+		return;
+	case SQL_VAL_INT:
+		break;
+	}
+
+	if (strncasecmp(val->str, "0x", 2) == 0 ||
+	    strncasecmp(val->str, "-0x", 3) == 0) {
+		ll = strtoull(val->str[0] == '-' ? val->str + 1 : val->str, NULL, 16);
+		if (val->str[0] == '-')
+			ll = -ll;
+		sqlite3_bind_int64(stmt, idx, ll);
+		return;
+	}
+
+	errno = 0;
+	ll = strtoll(val->str, &end, 10);
+	if (errno == ERANGE) {
+		sqlite3_bind_double(stmt, idx, strtod(val->str, NULL));
+		return;
+	}
+	sqlite3_bind_int64(stmt, idx, ll);
+}
@@ -0,0 +1,32 @@
+#ifndef SMATCH_SQL_VALUES_H
+#define SMATCH_SQL_VALUES_H
+
+#include <stdbool.h>
+
+enum sql_value_type {
+	SQL_VAL_INT,
+	SQL_VAL_FLOAT,
+	SQL_VAL_TEXT,
+};
+
+struct sql_value {
+	enum sql_value_type type;
+	const char *str;
+	int len;
+};
+
+#define SQL_MAX_VALUES 16
+int sql_split_values(char *buf, struct sql_value *vals, int max);
+int sql_split_insert(char *sql, const char **table, int *table_len, int *ignore,
+		     struct sql_value *vals, int max);
+int sql_split_row(char *row, const char **table, int *table_len, int *ignore,
+		  int *late, struct sql_value *vals, int max);
+int sql_split_rows(char *row, const char **table, int *table_len, int *ignore,
+		   int *late, struct sql_value *vals, int max, int *shared,
+		   char **next);
+int sql_next_row(char **next, struct sql_value *vals, int shared, int cnt);
+
+struct sqlite3_stmt;
+void sql_bind_value(struct sqlite3_stmt *stmt, int idx, struct sql_value *val);
+
+#endif
@@ -19,6 +19,10 @@
  * Store the states at the start of the function because this is something that
  * is used in a couple places.
  *
+ * This doesn't copy anything.  clone_stree() only takes a reference and the
+ * current stree copies the nodes on the way to a state as it changes them
+ * so the start states stay the way they were.
+ *
  */
 
 #include "smatch.h"
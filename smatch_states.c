@@ -59,6 +59,11 @@ static struct stree_stack *break_stack;
 static struct stree_stack *fake_break_stack;
 static struct stree_stack *switch_stack;
 static struct range_list_stack *remaining_cases;
+/*
+ * The case ranges which haven't been taken out of remaining_cases yet.  Each
+ * switch statement starts with a NULL.
+ */
+static struct range_list_stack *case_stack;
 static struct stree_stack *default_stack;
 static struct stree_stack *continue_stack;
 
@@ -193,6 +198,16 @@ struct sm_state *set_state(int owner, const char *name, struct symbol *sym, stru
 	if (owner != -1 && is_unreachable())
 		return NULL;
 
+	/* see parse_degraded() */
+	if (__degraded_pass && owner >= 0 && is_check_module(owner))
+		return NULL;
+
+	/* see count_owner_state(), don't leave the old state behind */
+	if (owner >= 0 && over_state_budget(owner)) {
+		__delete_state(owner, name, sym);
+		return NULL;
+	}
+
 	if (fake_cur_stree_stack)
 		set_state_stree_stack(&fake_cur_stree_stack, owner, name, sym, state);
 
@@ -203,18 +218,15 @@ struct sm_state *set_state(int owner, const char *name, struct symbol *sym, stru
 
 struct sm_state *set_state_expr(int owner, struct expression *expr, struct smatch_state *state)
 {
+	char buf[VAR_LEN];
 	char *name;
 	struct symbol *sym;
-	struct sm_state *ret = NULL;
 
 	expr = strip_expr(expr);
-	name = expr_to_var_sym(expr, &sym);
+	name = expr_to_var_sym_buf(expr, &sym, buf, sizeof(buf));
 	if (!name || !sym)
-		goto free;
-	ret = set_state(owner, name, sym, state);
-free:
-	free_string(name);
-	return ret;
+		return NULL;
+	return set_state(owner, name, sym, state);
 }
 
 struct stree *__swap_cur_stree(struct stree *stree)
@@ -327,28 +339,62 @@ void __set_sm_cur_stree(struct sm_state *sm)
 }
 
 typedef void (get_state_hook)(int owner, const char *name, struct symbol *sym);
-DECLARE_PTR_LIST(fn_list, get_state_hook *);
-static struct fn_list *get_state_hooks;
 
-void add_get_state_hook(get_state_hook *fn)
+struct get_state_hook_info {
+	get_state_hook *fn;
+	enum get_state_filter filter;
+};
+
+/*
+ * get_state() is called more than anything else so this has to be cheap.
+ * With no hooks it's just the check of nr_get_state_hooks.
+ */
+static struct get_state_hook_info *get_state_hooks;
+static int nr_get_state_hooks;
+
+void add_get_state_hook(get_state_hook *fn, enum get_state_filter filter)
 {
-	get_state_hook **p = malloc(sizeof(get_state_hook *));
-	*p = fn;
-	add_ptr_list(&get_state_hooks, p);
+	get_state_hooks = realloc(get_state_hooks, (nr_get_state_hooks + 1) * sizeof(*get_state_hooks));
+	get_state_hooks[nr_get_state_hooks].fn = fn;
+	get_state_hooks[nr_get_state_hooks].filter = filter;
+	nr_get_state_hooks++;
+}
+
+static bool is_cur_func_param(struct symbol *sym)
+{
+	struct symbol *tmp;
+
+	if (!sym || !cur_func_sym)
+		return false;
+	if (sym->ctype.modifiers & MOD_TOPLEVEL)
+		return false;
+
+	FOR_EACH_PTR(cur_func_sym->ctype.base_type->arguments, tmp) {
+		if (tmp == sym)
+			return true;
+	} END_FOR_EACH_PTR(tmp);
+	return false;
 }
 
 static void call_get_state_hooks(int owner, const char *name, struct symbol *sym)
 {
 	static int recursion;
-	get_state_hook **fn;
+	int is_param = -1;
+	int i;
 
 	if (recursion)
 		return;
 	recursion = 1;
 
-	FOR_EACH_PTR(get_state_hooks, fn) {
-		(*fn)(owner, name, sym);
-	} END_FOR_EACH_PTR(fn);
+	for (i = 0; i < nr_get_state_hooks; i++) {
+		if (get_state_hooks[i].filter == GET_STATE_PARAMS) {
+			if (is_param < 0)
+				is_param = is_cur_func_param(sym);
+			if (!is_param)
+				continue;
+		}
+		get_state_hooks[i].fn(owner, name, sym);
+	}
 
 	recursion = 0;
 }
@@ -376,7 +422,8 @@ struct smatch_state *__get_state(int owner, const char *name, struct symbol *sym
 
 struct smatch_state *get_state(int owner, const char *name, struct symbol *sym)
 {
-	call_get_state_hooks(owner, name, sym);
+	if (nr_get_state_hooks)
+		call_get_state_hooks(owner, name, sym);
 
 	return __get_state(owner, name, sym);
 }
@@ -394,24 +441,21 @@ struct smatch_state *get_check_state(const char *check_name, const char *name, s
 struct smatch_state *get_state_expr(int owner, struct expression *expr)
 {
 	struct expression *fake_parent;
+	char buf[VAR_LEN];
 	char *name;
 	struct symbol *sym;
-	struct smatch_state *ret = NULL;
 
 	expr = strip_expr(expr);
-	name = expr_to_var_sym(expr, &sym);
+	name = expr_to_var_sym_buf(expr, &sym, buf, sizeof(buf));
 	if (!name || !sym) {
 		fake_parent = expr_get_fake_parent_expr(expr);
 		if (!fake_parent)
-			goto free;
-		name = expr_to_var_sym(fake_parent->left, &sym);
+			return NULL;
+		name = expr_to_var_sym_buf(fake_parent->left, &sym, buf, sizeof(buf));
 		if (!name || !sym)
-			goto free;
+			return NULL;
 	}
-	ret = get_state(owner, name, sym);
-free:
-	free_string(name);
-	return ret;
+	return get_state(owner, name, sym);
 }
 
 struct smatch_state *get_check_state_expr(const char *check_name, struct expression *expr)
@@ -468,18 +512,15 @@ struct state_list *get_possible_states(int owner, const char *name, struct symbo
 
 struct state_list *get_possible_states_expr(int owner, struct expression *expr)
 {
+	char buf[VAR_LEN];
 	char *name;
 	struct symbol *sym;
-	struct state_list *ret = NULL;
 
 	expr = strip_expr(expr);
-	name = expr_to_var_sym(expr, &sym);
+	name = expr_to_var_sym_buf(expr, &sym, buf, sizeof(buf));
 	if (!name || !sym)
-		goto free;
-	ret = get_possible_states(owner, name, sym);
-free:
-	free_string(name);
-	return ret;
+		return NULL;
+	return get_possible_states(owner, name, sym);
 }
 
 struct sm_state *get_sm_state(int owner, const char *name, struct symbol *sym)
@@ -495,18 +536,15 @@ struct sm_state *get_sm_state(int owner, const char *name, struct symbol *sym)
 
 struct sm_state *get_sm_state_expr(int owner, struct expression *expr)
 {
+	char buf[VAR_LEN];
 	char *name;
 	struct symbol *sym;
-	struct sm_state *ret = NULL;
 
 	expr = strip_expr(expr);
-	name = expr_to_var_sym(expr, &sym);
+	name = expr_to_var_sym_buf(expr, &sym, buf, sizeof(buf));
 	if (!name || !sym)
-		goto free;
-	ret = get_sm_state(owner, name, sym);
-free:
-	free_string(name);
-	return ret;
+		return NULL;
+	return get_sm_state(owner, name, sym);
 }
 
 void __delete_state(int owner, const char *name, struct symbol *sym)
@@ -580,9 +618,8 @@ struct stree *get_all_states_from_stree(int owner, struct stree *source)
 	struct stree *ret = NULL;
 	struct sm_state *tmp;
 
-	FOR_EACH_SM(source, tmp) {
-		if (tmp->owner == owner)
-			avl_insert(&ret, tmp);
+	FOR_EACH_MY_SM(owner, source, tmp) {
+		avl_insert(&ret, tmp);
 	} END_FOR_EACH_SM(tmp);
 
 	return ret;
@@ -629,6 +666,9 @@ void set_true_false_states(int owner, const char *name, struct symbol *sym,
 	if (is_unreachable())
 		return;
 
+	if (__degraded_pass && owner >= 0 && is_check_module(owner))
+		return;
+
 	if (!cond_false_stack || !cond_true_stack) {
 		sm_perror("missing true/false stacks");
 		return;
@@ -644,16 +684,15 @@ void set_true_false_states_expr(int owner, struct expression *expr,
 			   struct smatch_state *true_state,
 			   struct smatch_state *false_state)
 {
+	char buf[VAR_LEN];
 	char *name;
 	struct symbol *sym;
 
 	expr = strip_expr(expr);
-	name = expr_to_var_sym(expr, &sym);
+	name = expr_to_var_sym_buf(expr, &sym, buf, sizeof(buf));
 	if (!name || !sym)
-		goto free;
+		return;
 	set_true_false_states(owner, name, sym, true_state, false_state);
-free:
-	free_string(name);
 }
 
 void __set_true_false_sm(struct sm_state *true_sm, struct sm_state *false_sm)
@@ -762,6 +801,8 @@ void save_all_states(void)
 	switch_stack = NULL;
 	__add_ptr_list(&backup, remaining_cases);
 	remaining_cases = NULL;
+	__add_ptr_list(&backup, case_stack);
+	case_stack = NULL;
 	__add_ptr_list(&backup, default_stack);
 	default_stack = NULL;
 	__add_ptr_list(&backup, continue_stack);
@@ -786,6 +827,7 @@ void restore_all_states(void)
 
 	continue_stack = pop_backup();
 	default_stack = pop_backup();
+	case_stack = pop_backup();
 	remaining_cases = pop_backup();
 	switch_stack = pop_backup();
 	fake_break_stack = pop_backup();
@@ -1198,11 +1240,28 @@ void __save_switch_states(struct expression *switch_expr)
 	get_absolute_rl(switch_expr, &rl);
 
 	push_rl(&remaining_cases, rl);
+	push_rl(&case_stack, NULL);
 	push_stree(&switch_stack, clone_stree(cur_stree));
 }
 
+static void update_remaining_cases(void)
+{
+	struct range_list_stack *cases = NULL;
+	struct range_list *rl;
+
+	while ((rl = pop_rl(&case_stack)))
+		push_rl(&cases, rl);
+	push_rl(&case_stack, NULL);
+	if (!cases)
+		return;
+
+	filter_top_rl(&remaining_cases, rl_union_stack(cases));
+	__free_ptr_list((struct ptr_list **)&cases);
+}
+
 int have_remaining_cases(void)
 {
+	update_remaining_cases();
 	return !!top_rl(remaining_cases);
 }
 
@@ -1221,7 +1280,13 @@ void __merge_switches(struct expression *switch_expr, struct range_list *case_rl
 		push_stree(&switch_stack, stree);
 		return;
 	}
-	implied_stree = __implied_case_stree(switch_expr, case_rl, &remaining_cases, &stree);
+	if (case_rl) {
+		push_rl(&case_stack, case_rl);
+	} else {
+		update_remaining_cases();
+		case_rl = clone_rl(top_rl(remaining_cases));
+	}
+	implied_stree = __implied_case_stree(switch_expr, case_rl, &stree);
 	merge_stree(&cur_stree, implied_stree);
 	free_stree(&implied_stree);
 	push_stree(&switch_stack, stree);
@@ -1232,6 +1297,8 @@ void __discard_switches(void)
 	struct stree *stree;
 
 	pop_rl(&remaining_cases);
+	while (pop_rl(&case_stack))
+		;
 	stree = pop_stree(&switch_stack);
 	free_stree(&stree);
 }
@@ -0,0 +1,256 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * "smatch --time-stmt[=<n>]" keeps the <n> slowest statements in each file
+ * (default 10) and prints them at the end of the file with the source lines
+ * around them.
+ *
+ * The time for a statement doesn't include the statements inside it, so an
+ * if statement is only charged for its condition and a compound statement
+ * is only charged for the merging.  Otherwise the function body would always
+ * be the slowest statement.  The hook cycles are split between the checks
+ * the same way as --hook-profile does it and the top three are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "smatch.h"
+#include "smatch_slist.h"
+
+#define NR_HOOKS 3
+
+struct slow_stmt {
+	struct position pos;
+	const char *func;
+	unsigned long states;
+	unsigned long long self_ns;
+	unsigned long long total_ns;
+	unsigned long long hook_cycles;
+	int hook_owner[NR_HOOKS];
+	unsigned long long owner_cycles[NR_HOOKS];
+};
+
+struct stmt_frame {
+	struct position pos;
+	const char *func;
+	unsigned long states;
+	unsigned long long start;
+	unsigned long long child_ns;
+	unsigned long long *hooks;
+};
+
+static struct stmt_frame *frames;
+static int nr_frames, max_frames;
+
+/* a min-heap, the fastest of the slow statements is at the top */
+static struct slow_stmt *slow;
+static int nr_slow;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void stmt_profile_start(struct statement *stmt)
+{
+	struct stmt_frame *frame;
+
+	if (nr_frames == max_frames) {
+		max_frames = max_frames ? max_frames * 2 : 64;
+		frames = realloc(frames, max_frames * sizeof(*frames));
+		memset(frames + nr_frames, 0, (max_frames - nr_frames) * sizeof(*frames));
+	}
+	frame = &frames[nr_frames++];
+	if (!frame->hooks)
+		frame->hooks = malloc((num_checks + 1) * sizeof(*frame->hooks));
+	memset(frame->hooks, 0, (num_checks + 1) * sizeof(*frame->hooks));
+	frame->pos = stmt->pos;
+	frame->func = get_function();
+	frame->states = stree_count(__get_cur_stree());
+	frame->child_ns = 0;
+	frame->start = now_ns();
+}
+
+/* called from __hook_profile_stop() */
+void stmt_profile_hook(int owner, unsigned long long cycles)
+{
+	if (!nr_frames)
+		return;
+	frames[nr_frames - 1].hooks[owner] += cycles;
+}
+
+static void swap_slow(int a, int b)
+{
+	struct slow_stmt tmp = slow[a];
+
+	slow[a] = slow[b];
+	slow[b] = tmp;
+}
+
+static void sift_down(int i)
+{
+	int smallest, child;
+
+	while (1) {
+		smallest = i;
+		child = i * 2 + 1;
+		if (child < nr_slow && slow[child].self_ns < slow[smallest].self_ns)
+			smallest = child;
+		child++;
+		if (child < nr_slow && slow[child].self_ns < slow[smallest].self_ns)
+			smallest = child;
+		if (smallest == i)
+			return;
+		swap_slow(i, smallest);
+		i = smallest;
+	}
+}
+
+static void sift_up(int i)
+{
+	while (i && slow[i].self_ns < slow[(i - 1) / 2].self_ns) {
+		swap_slow(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void fill_slow_stmt(struct slow_stmt *s, struct stmt_frame *frame,
+			   unsigned long long self, unsigned long long total)
+{
+	int owner, i, j;
+
+	memset(s, 0, sizeof(*s));
+	s->pos = frame->pos;
+	s->func = frame->func;
+	s->states = frame->states;
+	s->self_ns = self;
+	s->total_ns = total;
+	for (i = 0; i < NR_HOOKS; i++)
+		s->hook_owner[i] = -1;
+
+	for (owner = 0; owner <= num_checks; owner++) {
+		if (!frame->hooks[owner])
+			continue;
+		s->hook_cycles += frame->hooks[owner];
+		for (i = 0; i < NR_HOOKS; i++) {
+			if (frame->hooks[owner] > s->owner_cycles[i])
+				break;
+		}
+		if (i == NR_HOOKS)
+			continue;
+		for (j = NR_HOOKS - 1; j > i; j--) {
+			s->hook_owner[j] = s->hook_owner[j - 1];
+			s->owner_cycles[j] = s->owner_cycles[j - 1];
+		}
+		s->hook_owner[i] = owner;
+		s->owner_cycles[i] = frame->hooks[owner];
+	}
+}
+
+void stmt_profile_stop(void)
+{
+	struct stmt_frame *frame;
+	unsigned long long total, self;
+
+	if (!nr_frames)
+		return;
+	frame = &frames[--nr_frames];
+	total = now_ns() - frame->start;
+	self = total - frame->child_ns;
+	if (nr_frames)
+		frames[nr_frames - 1].child_ns += total;
+
+	if (!slow)
+		slow = calloc(option_time_stmt, sizeof(*slow));
+	if (nr_slow < option_time_stmt) {
+		fill_slow_stmt(&slow[nr_slow], frame, self, total);
+		sift_up(nr_slow++);
+		return;
+	}
+	if (self <= slow[0].self_ns)
+		return;
+	fill_slow_stmt(&slow[0], frame, self, total);
+	sift_down(0);
+}
+
+static int cmp_slow(const void *_a, const void *_b)
+{
+	const struct slow_stmt *a = _a;
+	const struct slow_stmt *b = _b;
+
+	if (a->self_ns > b->self_ns)
+		return -1;
+	if (a->self_ns < b->self_ns)
+		return 1;
+	return 0;
+}
+
+static void print_source(const char *filename, int line)
+{
+	char *buf = NULL;
+	size_t size = 0;
+	FILE *file;
+	int nr = 0;
+
+	file = fopen(filename, "r");
+	if (!file)
+		return;
+	while (getline(&buf, &size, file) >= 0) {
+		if (++nr < line - 2)
+			continue;
+		if (nr > line + 2)
+			break;
+		fprintf(sm_outfd, "  %c %5d | %s", nr == line ? '>' : ' ', nr, buf);
+		if (!strchr(buf, '\n'))
+			fprintf(sm_outfd, "\n");
+	}
+	free(buf);
+	fclose(file);
+}
+
+void print_stmt_profile(void)
+{
+	struct slow_stmt *s;
+	const char *filename;
+	int i, j;
+
+	if (!nr_slow)
+		return;
+
+	qsort(slow, nr_slow, sizeof(*slow), cmp_slow);
+	fprintf(sm_outfd, "slowest statements in %s:\n", get_base_file());
+	for (i = 0; i < nr_slow; i++) {
+		s = &slow[i];
+		filename = stream_name(s->pos.stream);
+		fprintf(sm_outfd, "%s:%d %s() %.3f ms (%.3f ms with the statements inside), %lu states\n",
+			filename, s->pos.line, s->func ? s->func : "",
+			s->self_ns / 1000000.0, s->total_ns / 1000000.0, s->states);
+		for (j = 0; j < NR_HOOKS && s->hook_owner[j] >= 0; j++) {
+			fprintf(sm_outfd, "%s %s %llu%%", j ? "," : "    hooks:",
+				check_name(s->hook_owner[j]),
+				s->owner_cycles[j] * 100 / s->hook_cycles);
+		}
+		if (j)
+			fprintf(sm_outfd, "\n");
+		print_source(filename, s->pos.line);
+	}
+	nr_slow = 0;
+}
@@ -43,7 +43,93 @@
 static int my_id;
 static int link_id;
 
-static struct smatch_state *alloc_link_state(struct expression_list *expr_list)
+/*
+ * The conditions are numbered in the order they are first seen in the
+ * function and the link state for a variable is a bitmap of the conditions
+ * which use it.  A loop which tests the same index over and over gets a long
+ * list of conditions and this way merging two link states is an OR instead
+ * of a search for each condition.  The numbers are shared with the inline
+ * functions so they stay the same until the end of the outer function.
+ */
+struct cond_bits {
+	int nr;
+	unsigned long bits[];
+};
+ALLOCATOR(cond_bits, "stored condition bits");
+
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+
+static struct expression **conditions;
+static int nr_conditions, conditions_size;
+
+struct cond_slot {
+	struct expression *expr;
+	int id;
+};
+static struct cond_slot *cond_hash;
+static int cond_hash_size;
+
+static unsigned int hash_expr(struct expression *expr)
+{
+	return ((unsigned long)expr >> 4) * 2654435761U;
+}
+
+static void add_cond_hash(struct expression *expr, int id)
+{
+	unsigned int h = hash_expr(expr);
+
+	while (cond_hash[h % cond_hash_size].expr)
+		h++;
+	cond_hash[h % cond_hash_size].expr = expr;
+	cond_hash[h % cond_hash_size].id = id;
+}
+
+static int get_condition_id(struct expression *expr)
+{
+	unsigned int h = hash_expr(expr);
+	int i;
+
+	if (cond_hash_size) {
+		while (cond_hash[h % cond_hash_size].expr) {
+			if (cond_hash[h % cond_hash_size].expr == expr)
+				return cond_hash[h % cond_hash_size].id;
+			h++;
+		}
+	}
+
+	if (nr_conditions == conditions_size) {
+		conditions_size = conditions_size ? conditions_size * 2 : 64;
+		conditions = realloc(conditions, conditions_size * sizeof(*conditions));
+		free(cond_hash);
+		cond_hash_size = conditions_size * 2;
+		cond_hash = calloc(cond_hash_size, sizeof(*cond_hash));
+		for (i = 0; i < nr_conditions; i++)
+			add_cond_hash(conditions[i], i);
+	}
+	conditions[nr_conditions] = expr;
+	add_cond_hash(expr, nr_conditions);
+	return nr_conditions++;
+}
+
+static struct cond_bits *alloc_cond_bits(int nr)
+{
+	struct cond_bits *bits;
+
+	bits = __alloc_cond_bits(nr * sizeof(unsigned long));
+	bits->nr = nr;
+	memset(bits->bits, 0, nr * sizeof(unsigned long));
+	return bits;
+}
+
+#define FOR_EACH_COND(_bits, _expr) do {					\
+	int __i;								\
+	for (__i = 0; _bits && __i < _bits->nr * BITS_PER_LONG; __i++) {	\
+		if (!(_bits->bits[__i / BITS_PER_LONG] & (1UL << (__i % BITS_PER_LONG)))) \
+			continue;						\
+		_expr = conditions[__i];
+#define END_FOR_EACH_COND(_expr) } } while (0)
+
+static struct smatch_state *alloc_link_state(struct cond_bits *bits)
 {
 	struct expression *tmp;
 	struct smatch_state *state;
@@ -53,87 +139,84 @@ static struct smatch_state *alloc_link_state(struct expression_list *expr_list)
 
 	state = __alloc_smatch_state(0);
 
-	FOR_EACH_PTR(expr_list, tmp) {
+	buf[0] = '\0';
+	FOR_EACH_COND(bits, tmp) {
 		name = expr_to_str(tmp);
 		cnt += snprintf(buf + cnt, sizeof(buf) - cnt, "%s%s",
 				cnt ? ", " : "", name);
 		free_string(name);
 		if (cnt >= sizeof(buf))
 			goto done;
-	} END_FOR_EACH_PTR(tmp);
+	} END_FOR_EACH_COND(tmp);
 
 done:
 	state->name = alloc_sname(buf);
-	state->data = expr_list;
+	state->data = bits;
 	return state;
 }
 
-static struct expression_list *clone_expression_list(struct expression_list *list)
-{
-	struct expression_list *ret = NULL;
-	struct expression *expr;
-
-	FOR_EACH_PTR(list, expr) {
-		add_ptr_list(&ret, expr);
-	} END_FOR_EACH_PTR(expr);
-
-	return ret;
-}
-
-static void insert_expression(struct expression_list **list, struct expression *expr)
-{
-	struct expression *tmp;
-
-	FOR_EACH_PTR(*list, tmp) {
-		if (tmp == expr)
-			return;
-	} END_FOR_EACH_PTR(tmp);
-
-	add_ptr_list(list, expr);
-}
-
 static struct smatch_state *merge_links(struct smatch_state *s1, struct smatch_state *s2)
 {
-	struct expression_list *list, *expr_list;
-	struct expression *expr;
-
-	expr_list = clone_expression_list(s1->data);
-
-	list = s2->data;
-	FOR_EACH_PTR(list, expr) {
-		insert_expression(&expr_list, expr);
-	} END_FOR_EACH_PTR(expr);
+	struct cond_bits *one = s1->data;
+	struct cond_bits *two = s2->data;
+	struct cond_bits *bits;
+	int i;
+
+	if (!one || !two)
+		return alloc_link_state(one ? one : two);
+
+	if (one->nr < two->nr) {
+		bits = one;
+		one = two;
+		two = bits;
+	}
+	bits = alloc_cond_bits(one->nr);
+	for (i = 0; i < one->nr; i++)
+		bits->bits[i] = one->bits[i] | (i < two->nr ? two->bits[i] : 0);
 
-	return alloc_link_state(expr_list);
+	return alloc_link_state(bits);
 }
 
 static void save_link_var_sym(const char *var, struct symbol *sym, struct expression *condition)
 {
-	struct smatch_state *old_state, *new_state;
-	struct expression_list *expr_list;
+	struct smatch_state *old_state;
+	struct cond_bits *old = NULL;
+	struct cond_bits *bits;
+	int id, nr;
 
 	old_state = get_state(link_id, var, sym);
-	expr_list = clone_expression_list(old_state ? old_state->data : NULL);
+	if (old_state)
+		old = old_state->data;
 
-	insert_expression(&expr_list, condition);
+	id = get_condition_id(condition);
+	if (old && id / BITS_PER_LONG < old->nr &&
+	    (old->bits[id / BITS_PER_LONG] & (1UL << (id % BITS_PER_LONG))))
+		return;
 
-	new_state = alloc_link_state(expr_list);
-	set_state(link_id, var, sym, new_state);
+	nr = id / BITS_PER_LONG + 1;
+	if (old && old->nr > nr)
+		nr = old->nr;
+	bits = alloc_cond_bits(nr);
+	if (old)
+		memcpy(bits->bits, old->bits, old->nr * sizeof(unsigned long));
+	bits->bits[id / BITS_PER_LONG] |= 1UL << (id % BITS_PER_LONG);
+
+	set_state(link_id, var, sym, alloc_link_state(bits));
 }
 
 static void match_link_modify(struct sm_state *sm, struct expression *mod_expr)
 {
-	struct expression_list *expr_list;
+	struct cond_bits *bits;
 	struct expression *tmp;
 	char *name;
 
-	expr_list = sm->state->data;
+	bits = sm->state->data;
 
-	FOR_EACH_PTR(expr_list, tmp) {
+	FOR_EACH_COND(bits, tmp) {
 		name = expr_to_str(tmp);
 		set_state(my_id, name, NULL, &undefined);
 		free_string(name);
-	} END_FOR_EACH_PTR(tmp);
+	} END_FOR_EACH_COND(tmp);
 	set_state(link_id, sm->name, sm->sym, &undefined);
 }
 
@@ -257,12 +340,29 @@ struct smatch_state *get_stored_condition(struct expression *expr)
 
 struct expression_list *get_conditions(struct expression *expr)
 {
+	struct expression_list *ret = NULL;
 	struct smatch_state *state;
+	struct cond_bits *bits;
+	struct expression *tmp;
 
 	state = get_state_expr(link_id, expr);
 	if (!state)
 		return NULL;
-	return state->data;
+	bits = state->data;
+	FOR_EACH_COND(bits, tmp) {
+		add_ptr_list(&ret, tmp);
+	} END_FOR_EACH_COND(tmp);
+	return ret;
+}
+
+static void free_conditions(struct symbol *sym)
+{
+	if (__inline_fn)
+		return;
+	nr_conditions = 0;
+	if (cond_hash_size)
+		memset(cond_hash, 0, cond_hash_size * sizeof(*cond_hash));
+	clear_cond_bits_alloc();
 }
 
 void register_stored_conditions(int id)
@@ -279,6 +379,7 @@ void register_stored_conditions_links(int id)
 	add_merge_hook(link_id, &merge_links);
 	add_modification_hook(link_id, &match_link_modify);
 	add_untracked_param_hook(&match_untracked);
+	add_hook(&free_conditions, AFTER_FUNC_HOOK);
 }
 
 #define RECURSE_LIMIT 50
@@ -15,46 +15,88 @@
  * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
  */
 
+/*
+ * The string lists are kept sorted so they can be searched a block at a time
+ * and merged in one pass.  Links to a struct with a lot of aliases get long
+ * and walking them a string at a time for every insert was quadratic.
+ */
+
 #include "smatch.h"
 
+/*
+ * Find where @str is or where it would go.  Sets @block and @idx to the slot
+ * or @block to NULL if @str is bigger than everything in the list.
+ */
+static bool find_string(struct string_list *str_list, const char *str,
+			struct string_list **block, int *idx)
+{
+	struct string_list *list = str_list;
+	int low, high, mid;
+
+	*block = NULL;
+	*idx = 0;
+	if (!str_list)
+		return false;
+
+	do {
+		if (list->nr && strcmp(list->list[list->nr - 1], str) >= 0)
+			goto found;
+		list = list->next;
+	} while (list != str_list);
+	return false;
+
+found:
+	low = 0;
+	high = list->nr - 1;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (strcmp(list->list[mid], str) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	*block = list;
+	*idx = low;
+	return strcmp(list->list[low], str) == 0;
+}
+
 int list_has_string(struct string_list *str_list, const char *str)
 {
-	char *tmp;
-	int cmp;
+	struct string_list *block;
+	int idx;
 
 	if (!str)
 		return 0;
-
-	FOR_EACH_PTR(str_list, tmp) {
-		cmp = strcmp(tmp, str);
-		if (cmp < 0)
-			continue;
-		if (cmp == 0)
-			return 1;
-		return 0;
-	} END_FOR_EACH_PTR(tmp);
-	return 0;
+	return find_string(str_list, str, &block, &idx);
 }
 
 int insert_string(struct string_list **str_list, const char *_new)
 {
-	char *new = (char *)_new;
-	char *tmp;
-	int cmp;
+	struct string_list *list;
+	char *new;
+	int nr;
 
-	FOR_EACH_PTR(*str_list, tmp) {
-		cmp = strcmp(tmp, new);
-		if (cmp < 0)
-			continue;
-		else if (cmp == 0) {
-			return 0;
-		} else {
-			INSERT_CURRENT(alloc_string(new), tmp);
-			return 1;
+	if (find_string(*str_list, _new, &list, &nr))
+		return 0;
+
+	new = alloc_string(_new);
+	if (!list) {
+		add_ptr_list(str_list, new);
+		return 1;
+	}
+
+	/* the same as INSERT_CURRENT() */
+	if (list->nr >= PTR_LIST_NODE_NR(list)) {
+		split_ptr_list_head((struct ptr_list *)list);
+		if (nr >= list->nr) {
+			nr -= list->nr;
+			list = list->next;
 		}
-	} END_FOR_EACH_PTR(tmp);
-	new = alloc_string(new);
-	add_ptr_list(str_list, new);
+	}
+	memmove(list->list + nr + 1, list->list + nr,
+		(list->nr - nr) * sizeof(*list->list));
+	list->list[nr] = new;
+	list->nr++;
 	return 1;
 }
 
@@ -71,13 +113,32 @@ struct string_list *clone_str_list(struct string_list *orig)
 
 struct string_list *combine_string_lists(struct string_list *one, struct string_list *two)
 {
-	struct string_list *ret;
-	char *tmp;
+	struct string_list *ret = NULL;
+	char *a, *b;
+	int cmp;
 
-	ret = clone_str_list(one);
-	FOR_EACH_PTR(two, tmp) {
-		insert_string(&ret, tmp);
-	} END_FOR_EACH_PTR(tmp);
+	PREPARE_PTR_LIST(one, a);
+	PREPARE_PTR_LIST(two, b);
+	while (a || b) {
+		if (!a)
+			cmp = 1;
+		else if (!b)
+			cmp = -1;
+		else
+			cmp = strcmp(a, b);
+
+		if (cmp <= 0) {
+			add_ptr_list(&ret, a);
+			NEXT_PTR_LIST(a);
+			if (cmp == 0)
+				NEXT_PTR_LIST(b);
+		} else {
+			add_ptr_list(&ret, b);
+			NEXT_PTR_LIST(b);
+		}
+	}
+	FINISH_PTR_LIST(b);
+	FINISH_PTR_LIST(a);
 	return ret;
 }
 
@@ -239,9 +239,72 @@ free:
 	return ret;
 }
 
+/*
+ * When one local struct is copied to another the care strees hold every
+ * state for both of them.  A member which doesn't have a state on either
+ * side is unknown before and after the copy, so the fake assignment would
+ * only create a lot of "could be anything" states.  Those members are
+ * skipped.
+ */
+static bool is_plain_local(struct expression *expr)
+{
+	struct symbol *sym;
+
+	if (!is_local_variable(expr))
+		return false;
+	sym = expr_to_sym(expr);
+	if (!sym || get_param_num_from_sym(sym) >= 0)
+		return false;
+	return true;
+}
+
+static bool skip_untracked_members(int mode, struct expression *left, struct expression *right)
+{
+	if (mode != COPY_NORMAL || !right)
+		return false;
+	return is_plain_local(left) && is_plain_local(right);
+}
+
+static bool has_member_states(struct stree *care, struct expression *expr)
+{
+	struct sm_state *sm;
+	const char *sm_name;
+	bool ret = false;
+	char *name;
+	int len;
+
+	name = expr_to_str(expr);
+	if (!name)
+		return true;
+	len = strlen(name);
+
+	FOR_EACH_SM(care, sm) {
+		sm_name = sm->name;
+		while (*sm_name == '*' || *sm_name == '(')
+			sm_name++;
+		if (strncmp(sm_name, name, len) == 0) {
+			ret = true;
+			break;
+		}
+	} END_FOR_EACH_SM(sm);
+
+	free_string(name);
+	return ret;
+}
+
+static bool untracked_member(struct stree *care_left, struct stree *care_right,
+			     struct expression *left, struct expression *right)
+{
+	if (has_member_states(care_left, left))
+		return false;
+	if (has_member_states(care_right ? care_right : care_left, right))
+		return false;
+	return true;
+}
+
 static void set_inner_struct_members(int mode, struct expression *faked,
 		struct expression *left, struct expression *right, struct symbol *member,
-		struct stree *care_left, struct stree *care_right,
+		struct stree *care_left, struct stree *care_right, bool skip_untracked,
 		void (*assign_handler)(struct expression *expr, void *data),
 		void *data)
 {
@@ -270,7 +333,7 @@ static void set_inner_struct_members(int mode, struct expression *faked,
 		if (type->type == SYM_ARRAY)
 			continue;
 		if (type->type == SYM_UNION || type->type == SYM_STRUCT) {
-			set_inner_struct_members(mode, faked, left, right, tmp, care_left, care_right, assign_handler, data);
+			set_inner_struct_members(mode, faked, left, right, tmp, care_left, care_right, skip_untracked, assign_handler, data);
 			continue;
 		}
 		if (!tmp->ident)
@@ -281,6 +344,9 @@ static void set_inner_struct_members(int mode, struct expression *faked,
 		right_expr = NULL;
 		if (mode == COPY_NORMAL && right)
 			right_expr = member_expression(right, '.', tmp->ident);
+		if (skip_untracked &&
+		    untracked_member(care_left, care_right, left_member, right_expr))
+			continue;
 		if (mode == COPY_ZERO)
 			right_expr = zero_expr();
 		if (!right_expr)
@@ -333,6 +399,7 @@ static void __struct_members_copy(int mode, struct expression *faked,
 	struct expression *left_member;
 	struct expression *right_expr;
 	struct expression *assign;
+	bool skip_untracked;
 
 	if (__in_fake_assign || !left)
 		return;
@@ -361,6 +428,7 @@ static void __struct_members_copy(int mode, struct expression *faked,
 
 	if (mode != COPY_ZERO)
 		get_care_stree(left, &care_left, right, &care_right);
+	skip_untracked = skip_untracked_members(mode, left, right);
 	FOR_EACH_PTR(struct_type->symbol_list, tmp) {
 		type = get_real_base_type(tmp);
 		if (!type)
@@ -368,7 +436,7 @@ static void __struct_members_copy(int mode, struct expression *faked,
 
 		if (type->type == SYM_UNION || type->type == SYM_STRUCT) {
 			set_inner_struct_members(mode, faked, left, right, tmp,
-						 care_left, care_right,
+						 care_left, care_right, skip_untracked,
 						 assign_handler, data);
 			continue;
 		}
@@ -381,6 +449,9 @@ static void __struct_members_copy(int mode, struct expression *faked,
 
 		if (mode == COPY_NORMAL && right)
 			right_expr = member_expression(right, '.', tmp->ident);
+		if (skip_untracked &&
+		    untracked_member(care_left, care_right, left_member, right_expr))
+			continue;
 		if (mode == COPY_ZERO)
 			right_expr = zero_expr();
 		if (!right_expr)
@@ -0,0 +1,193 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * The same struct types are looked at over and over.  Every member offset
+ * lookup walked the member list and added up the sizes again and the
+ * Rosenberg check searched for holes again for every copy_to_user().  The
+ * layout of a struct doesn't change once it has been defined so work it
+ * out once and keep it keyed by the struct symbol.
+ */
+
+#include "smatch.h"
+
+#define LAYOUT_HASH_BITS 9
+#define LAYOUT_HASH_SIZE (1 << LAYOUT_HASH_BITS)
+static struct struct_layout *layout_hash[LAYOUT_HASH_SIZE];
+
+static unsigned int layout_hashval(struct symbol *type)
+{
+	unsigned long hash = (unsigned long)type;
+
+	hash ^= hash >> 7;
+	hash ^= hash >> 17;
+	return hash & (LAYOUT_HASH_SIZE - 1);
+}
+
+static void set_offsets(struct struct_layout *layout, struct symbol *type)
+{
+	struct symbol *tmp;
+	int offset, bits;
+	int i = 0;
+
+	layout->nr = ptr_list_size((struct ptr_list *)type->symbol_list);
+	layout->members = calloc(layout->nr, sizeof(*layout->members));
+
+	bits = 0;
+	offset = 0;
+	FOR_EACH_PTR(type->symbol_list, tmp) {
+		if (bits_to_bytes(bits + type_bits(tmp)) > tmp->ctype.alignment) {
+			offset += bits_to_bytes(bits);
+			bits = 0;
+		}
+		offset = ALIGN(offset, tmp->ctype.alignment);
+		layout->members[i].sym = tmp;
+		layout->members[i].offset = offset;
+		i++;
+		if (!(type_bits(tmp) % 8) && type_bits(tmp) / 8 == type_bytes(tmp))
+			offset += type_bytes(tmp);
+		else
+			bits += type_bits(tmp);
+	} END_FOR_EACH_PTR(tmp);
+	layout->nr = i;
+}
+
+static void copy_hole(struct struct_layout *layout, const struct struct_layout *inner)
+{
+	layout->hole_after = inner->hole_after;
+	layout->hole_at_end = inner->hole_at_end;
+	layout->end_align = inner->end_align;
+	layout->unaligned += inner->unaligned;
+}
+
+/*
+ * Find the first hole the way check_rosenberg.c always has.  Members which
+ * are structs are searched first and their holes count as ours.
+ */
+static void set_hole(struct struct_layout *layout, struct symbol *type)
+{
+	const struct struct_layout *inner;
+	struct symbol *base_type, *prev_type;
+	struct symbol *tmp, *prev;
+	int align;
+
+	if (type->ctype.alignment == 1)
+		return;
+
+	align = 0;
+	prev = NULL;
+	prev_type = NULL;
+	FOR_EACH_PTR(type->symbol_list, tmp) {
+		base_type = get_real_base_type(tmp);
+		if (base_type && base_type->type == SYM_STRUCT) {
+			inner = get_struct_layout(base_type);
+			if (inner) {
+				if (inner->hole_after || inner->hole_at_end) {
+					copy_hole(layout, inner);
+					return;
+				}
+				layout->unaligned += inner->unaligned;
+			}
+		}
+		if (base_type && base_type->type == SYM_BITFIELD &&
+		    prev_type && prev_type->type == SYM_BITFIELD)
+			goto next;
+
+		if (!tmp->ctype.alignment) {
+			layout->unaligned++;
+		} else if (align % tmp->ctype.alignment) {
+			layout->hole_after = prev;
+			return;
+		}
+
+next:
+		if (base_type == &bool_ctype)
+			align += 1;
+		else if (type_bits(tmp) <= 0)
+			align = 0;
+		else
+			align += type_bytes(tmp);
+
+		prev = tmp;
+		prev_type = base_type;
+	} END_FOR_EACH_PTR(tmp);
+
+	// FIXME: this isn't the correct fix.  See sbni_siocdevprivate().
+	if (prev_type && prev_type->type == SYM_BITFIELD)
+		return;
+	if (align % type->ctype.alignment) {
+		layout->hole_after = prev;
+		layout->hole_at_end = true;
+		layout->end_align = align;
+	}
+}
+
+static bool is_resizable(struct symbol *type)
+{
+	const struct struct_layout *inner;
+	struct symbol *last_member;
+	sval_t sval;
+
+	last_member = last_ptr_list((struct ptr_list *)type->symbol_list);
+	if (!last_member || !last_member->ident)
+		return false;
+
+	type = get_real_base_type(last_member);
+	if (type->type == SYM_STRUCT) {
+		inner = get_struct_layout(type);
+		return inner && inner->resizable;
+	}
+	if (type->type != SYM_ARRAY)
+		return false;
+
+	if (!type->array_size)
+		return true;
+
+	if (!get_implied_value(type->array_size, &sval))
+		return false;
+
+	if (sval.value != 0 && sval.value != 1)
+		return false;
+
+	return true;
+}
+
+const struct struct_layout *get_struct_layout(struct symbol *type)
+{
+	struct struct_layout *layout;
+	unsigned int hash;
+
+	if (!type || type->type != SYM_STRUCT)
+		return NULL;
+	/* a struct which is only declared so far can still be defined later */
+	if (!type->symbol_list)
+		return NULL;
+
+	hash = layout_hashval(type);
+	for (layout = layout_hash[hash]; layout; layout = layout->next) {
+		if (layout->type == type)
+			return layout;
+	}
+
+	layout = calloc(1, sizeof(*layout));
+	layout->type = type;
+	set_offsets(layout, type);
+	set_hole(layout, type);
+	layout->resizable = is_resizable(type);
+
+	layout->next = layout_hash[hash];
+	layout_hash[hash] = layout;
+	return layout;
+}
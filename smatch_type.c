@@ -146,23 +146,12 @@ static struct symbol *get_type_symbol(struct expression *expr)
 	return type;
 }
 
+/* find_identifier() caches the answers so this is cheap */
 static struct symbol *get_member_symbol(struct symbol_list *symbol_list, struct ident *member)
 {
-	struct symbol *tmp, *sub;
-
-	FOR_EACH_PTR(symbol_list, tmp) {
-		if (!tmp->ident) {
-			sub = get_real_base_type(tmp);
-			sub = get_member_symbol(sub->symbol_list, member);
-			if (sub)
-				return sub;
-			continue;
-		}
-		if (tmp->ident == member)
-			return tmp;
-	} END_FOR_EACH_PTR(tmp);
+	int offset;
 
-	return NULL;
+	return find_identifier(member, symbol_list, &offset);
 }
 
 static struct symbol *get_symbol_from_deref(struct expression *expr)
@@ -513,7 +502,7 @@ static sval_t fp_max(struct symbol *type)
 	return ret;
 }
 
-sval_t sval_type_max(struct symbol *base_type)
+static sval_t calc_type_max(struct symbol *base_type)
 {
 	sval_t ret;
 
@@ -542,7 +531,7 @@ static sval_t fp_min(struct symbol *type)
 	return ret;
 }
 
-sval_t sval_type_min(struct symbol *base_type)
+static sval_t calc_type_min(struct symbol *base_type)
 {
 	sval_t ret;
 
@@ -563,6 +552,56 @@ sval_t sval_type_min(struct symbol *base_type)
 	return ret;
 }
 
+/*
+ * The min and max of the base types and pointers never change so they are
+ * looked up instead of worked out each time.  This is called from the inner
+ * loops of the range math.
+ */
+#define TYPE_BOUNDS_HASH 64
+
+static struct type_bounds {
+	struct symbol *type;
+	sval_t min;
+	sval_t max;
+} type_bounds[TYPE_BOUNDS_HASH];
+
+static struct type_bounds *get_type_bounds(struct symbol *type)
+{
+	struct type_bounds *bounds;
+
+	if (!type || (type->type != SYM_BASETYPE && type->type != SYM_PTR))
+		return NULL;
+
+	bounds = &type_bounds[((unsigned long)type >> 4) % TYPE_BOUNDS_HASH];
+	if (bounds->type == type)
+		return bounds;
+
+	bounds->type = type;
+	bounds->min = calc_type_min(type);
+	bounds->max = calc_type_max(type);
+	return bounds;
+}
+
+sval_t sval_type_max(struct symbol *base_type)
+{
+	struct type_bounds *bounds;
+
+	bounds = get_type_bounds(base_type);
+	if (bounds)
+		return bounds->max;
+	return calc_type_max(base_type);
+}
+
+sval_t sval_type_min(struct symbol *base_type)
+{
+	struct type_bounds *bounds;
+
+	bounds = get_type_bounds(base_type);
+	if (bounds)
+		return bounds->min;
+	return calc_type_min(base_type);
+}
+
 int nr_bits(struct expression *expr)
 {
 	struct symbol *type;
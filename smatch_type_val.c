@@ -35,6 +35,7 @@
 #include "smatch.h"
 #include "smatch_slist.h"
 #include "smatch_extra.h"
+#include "smatch_function_hashtable.h"
 
 static int my_id;
 
@@ -53,14 +54,67 @@ void enable_type_val_lookups(void)
 	no_type_vals--;
 }
 
-static int get_vals(void *_db_vals, int argc, char **argv, char **azColName)
+/*
+ * The type_value table doesn't change while Smatch runs so the values are
+ * saved in type_values for as long as the process lives, which includes
+ * every file in a batch.  The first time a member of a struct is looked up
+ * all the members of that struct are loaded with one query.  A member which
+ * isn't in type_values after that doesn't have a type_value row.
+ */
+DEFINE_STRING_HASHTABLE_STATIC(type_values);
+DEFINE_STRING_HASHTABLE_STATIC(loaded_type_values);
+
+static int save_type_value(void *unused, int argc, char **argv, char **azColName)
 {
-	char **db_vals = _db_vals;
+	char *old;
 
-	*db_vals = alloc_string(argv[0]);
+	if (argc != 2 || !argv[0] || !argv[1])
+		return 0;
+	/* if there is more than one row the last one wins */
+	old = (char *)search_type_values(type_values, argv[0]);
+	if (old) {
+		hashtable_remove(type_values, argv[0]);
+		free_string(old);
+	}
+	insert_type_values(type_values, alloc_string(argv[0]),
+			   (int *)alloc_string(argv[1]));
 	return 0;
 }
 
+static char *get_type_value_str(const char *member)
+{
+	char prefix[256], upper[256];
+	const char *p;
+	int len;
+
+	if (!type_values) {
+		type_values = create_function_hashtable(4000);
+		loaded_type_values = create_function_hashtable(1000);
+	}
+
+	/* "(struct foo)->" covers all the members of struct foo */
+	p = strstr(member, ")->");
+	len = p ? p + 3 - member : 0;
+	if (!p || len >= sizeof(prefix)) {
+		if (!search_type_values(type_values, (char *)member))
+			run_sql(save_type_value, NULL,
+				"select type, value from type_value where type = '%q';",
+				member);
+		return (char *)search_type_values(type_values, (char *)member);
+	}
+
+	snprintf(prefix, sizeof(prefix), "%.*s", len, member);
+	if (!search_loaded_type_values(loaded_type_values, prefix)) {
+		insert_loaded_type_values(loaded_type_values, alloc_string(prefix), INT_PTR(1));
+		/* "(struct foo)-?" is the first string after all the "(struct foo)->" */
+		snprintf(upper, sizeof(upper), "%.*s?", len - 1, member);
+		run_sql(save_type_value, NULL,
+			"select type, value from type_value where type >= '%q' and type < '%q';",
+			prefix, upper);
+	}
+	return (char *)search_type_values(type_values, (char *)member);
+}
+
 struct expr_rl {
 	struct expression *expr;
 	struct range_list *rl;
@@ -89,7 +143,7 @@ static int get_cached(struct expression *expr, struct range_list **rl, int *ret)
 
 int get_db_type_rl(struct expression *expr, struct range_list **rl)
 {
-	char *db_vals = NULL;
+	char *db_vals;
 	char *member;
 	struct range_list *tmp;
 	struct symbol *type;
@@ -109,13 +163,11 @@ int get_db_type_rl(struct expression *expr, struct range_list **rl)
 	cached_results[res_idx].expr = expr;
 	cached_results[res_idx].rl = NULL;
 
-	run_sql(get_vals, &db_vals,
-		"select value from type_value where type = '%s';", member);
+	db_vals = get_type_value_str(member);
 	if (!db_vals)
 		return 0;
 	type = get_type(expr);
 	str_to_rl(type, db_vals, &tmp);
-	free_string(db_vals);
 	if (is_whole_rl(tmp))
 		return 0;
 
@@ -398,13 +450,31 @@ static int set_param_type(void *_type_str, int argc, char **argv, char **azColNa
 	return 0;
 }
 
+/*
+ * The PASSES_TYPE rows for a function are looked up again for every
+ * assignment from a parameter so they're saved for the life of the process.
+ * NO_PARAM_TYPE means there wasn't a row.
+ */
+DEFINE_STRING_HASHTABLE_STATIC(param_types);
+static char NO_PARAM_TYPE[] = "";
+
 static char *db_get_parameter_type(int param)
 {
+	char key[256];
 	char *ret = NULL;
 
 	if (!cur_func_sym)
 		return NULL;
 
+	snprintf(key, sizeof(key), "%llx %s %d",
+		 (cur_func_sym->ctype.modifiers & MOD_STATIC) ? get_base_file_id() : 0,
+		 cur_func_sym->ident->name, param);
+	if (!param_types)
+		param_types = create_function_hashtable(1000);
+	ret = (char *)search_param_types(param_types, key);
+	if (ret)
+		return ret == NO_PARAM_TYPE ? NULL : ret;
+
 	run_sql(set_param_type, &ret,
 		"select value from fn_data_link where "
 		"file = 0x%llx and function = '%s' and static = %d and type = %d and parameter = %d and key = '$';",
@@ -413,7 +483,9 @@ static char *db_get_parameter_type(int param)
 		!!(cur_func_sym->ctype.modifiers & MOD_STATIC),
 		PASSES_TYPE, param);
 
-	return ret;
+	ret = ret ? alloc_string(ret) : NO_PARAM_TYPE;
+	insert_param_types(param_types, alloc_string(key), (int *)ret);
+	return ret == NO_PARAM_TYPE ? NULL : ret;
 }
 
 static int is_uncasted_fn_param_from_db(void)
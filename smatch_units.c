@@ -17,6 +17,7 @@
 
 #include "smatch.h"
 #include "smatch_slist.h"
+#include "smatch_function_hashtable.h"
 
 static int my_id;
 
@@ -128,8 +129,68 @@ static bool ARRAY_SIZE_is_bytes(struct expression *expr)
 	return true;
 }
 
+/*
+ * The units of a struct member used to be two SQL queries every time,
+ * one against the type_info rows this run saved in the cache DB and one
+ * against smatch_db.sqlite.  Now the UNITS rows of smatch_db.sqlite are
+ * read once and the rows we save are remembered next to them.  The answer
+ * is the same as before: the units if all the rows agree, otherwise
+ * nothing.
+ */
+struct member_units {
+	struct smatch_state *db;
+	struct smatch_state *saved;
+};
+
+/* rows which don't agree or which str_to_units() doesn't know */
+static struct smatch_state no_units = { .name = "unknown" };
+
+static DEFINE_HASHTABLE_INSERT(insert_member_units, char, struct member_units);
+static DEFINE_HASHTABLE_SEARCH(search_member_units, char, struct member_units);
+static struct hashtable *member_units_table;
+
+static struct smatch_state *combine_units(struct smatch_state *old, struct smatch_state *new)
+{
+	if (!old)
+		return new;
+	if (!new || old == new)
+		return old;
+	return &no_units;
+}
+
+static struct member_units *get_member_units(const char *member)
+{
+	struct member_units *mu;
+
+	mu = search_member_units(member_units_table, (char *)member);
+	if (mu)
+		return mu;
+	mu = calloc(1, sizeof(*mu));
+	insert_member_units(member_units_table, alloc_string(member), mu);
+	return mu;
+}
+
+static int load_units(void *unused, int argc, char **argv, char **azColName)
+{
+	struct member_units *mu;
+
+	mu = get_member_units(argv[0]);
+	mu->db = combine_units(mu->db, str_to_units(argv[1]) ?: &no_units);
+	return 0;
+}
+
+static void load_member_units(void)
+{
+	if (member_units_table)
+		return;
+	member_units_table = create_function_hashtable(1000);
+	run_sql(&load_units, NULL,
+		"select key, value from type_info where type = %d;", UNITS);
+}
+
 static void store_type_in_db(struct expression *expr, struct smatch_state *state)
 {
+	struct member_units *mu;
 	char *member;
 
 	member = get_member_name(expr);
@@ -139,6 +200,10 @@ static void store_type_in_db(struct expression *expr, struct smatch_state *state
 		return;
 
 	sql_insert_cache(type_info, "0x%llx, %d, '%s', '%s'", get_base_file_id(), UNITS, member, state->name);
+
+	load_member_units();
+	mu = get_member_units(member);
+	mu->saved = combine_units(mu->saved, str_to_units(state->name) ?: &no_units);
 }
 
 static void set_units(struct expression *expr, struct smatch_state *state)
@@ -238,27 +303,11 @@ static struct smatch_state *get_units_call(struct expression *expr)
 	return NULL;
 }
 
-static int db_units(void *_units, int argc, char **argv, char **azColName)
-{
-	char **units = _units;
-
-	if (*units) {
-		if (strcmp(*units, argv[0]) == 0)
-			return 0;
-		free_string(*units);
-		*units = alloc_string("unknown");
-		return 0;
-
-	}
-	*units = alloc_string(argv[0]);
-	return 0;
-}
-
 static struct smatch_state *get_units_from_type(struct expression *expr)
 {
+	struct member_units *mu;
+	struct smatch_state *ret;
 	char *member;
-	char *units = NULL;
-	struct smatch_state *ret = NULL;
 	int i;
 
 	member = get_member_name(expr);
@@ -270,17 +319,13 @@ static struct smatch_state *get_units_from_type(struct expression *expr)
 			return member_table[i].unit;
 	}
 
-	cache_sql(&db_units, &units, "select value from type_info where type = %d and key = '%s';",
-		  UNITS, member);
-	run_sql(&db_units, &units, "select value from type_info where type = %d and key = '%s';",
-		UNITS, member);
-	if (!units)
+	load_member_units();
+	mu = search_member_units(member_units_table, member);
+	if (!mu)
+		return NULL;
+	ret = combine_units(mu->saved, mu->db);
+	if (ret == &no_units)
 		return NULL;
-
-	ret = str_to_units(units);
-
-	free_string(units);
-
 	return ret;
 }
 
@@ -397,9 +442,6 @@ static void match_condition_set(struct expression *expr)
 {
 	struct smatch_state *left, *right;
 
-	if (expr->type != EXPR_COMPARE)
-		return;
-
 	left = get_units(expr->left);
 	right = get_units(expr->right);
 
@@ -546,7 +588,7 @@ void register_units(int id)
 	add_merge_hook(my_id, &merge_units);
 
 	add_hook(&match_binop_set, BINOP_HOOK);
-	add_hook(&match_condition_set, CONDITION_HOOK);
+	add_expr_type_hook(&match_condition_set, CONDITION_HOOK, EXPR_TYPE_BIT(EXPR_COMPARE));
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_hook(&match_call_info, FUNCTION_CALL_HOOK);
 	all_return_states_hook(&process_states);
@@ -19,6 +19,34 @@
 
 ALLOCATOR(var_sym, "var_sym structs");
 
+/*
+ * The symbols in a function are numbered the first time a state is looked
+ * up with the symbol's own name.  That's most states and the numbers let
+ * get_sm_state_stree() keep its cache in an array.  The numbers are only
+ * good until the end of the function.
+ */
+static struct symbol **numbered_syms;
+static unsigned int nr_syms, syms_size;
+
+int get_sym_nr(struct symbol *sym)
+{
+	if (sym->smatch_nr < nr_syms && numbered_syms[sym->smatch_nr] == sym)
+		return sym->smatch_nr;
+
+	if (nr_syms == syms_size) {
+		syms_size = syms_size ? syms_size * 2 : 256;
+		numbered_syms = realloc(numbered_syms, syms_size * sizeof(*numbered_syms));
+	}
+	numbered_syms[nr_syms] = sym;
+	sym->smatch_nr = nr_syms;
+	return nr_syms++;
+}
+
+void clear_sym_nrs(void)
+{
+	nr_syms = 0;
+}
+
 struct smatch_state *alloc_var_sym_state(const char *var, struct symbol *sym)
 {
 	struct smatch_state *state;
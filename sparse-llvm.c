@@ -4,15 +4,19 @@
  */
 
 #include <llvm-c/Core.h>
+#include <llvm-c/BitReader.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Analysis.h>
+#include <llvm-c/Linker.h>
 #include <llvm-c/Target.h>
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/wait.h>
 
 #include "symbol.h"
 #include "expression.h"
@@ -27,6 +31,11 @@ struct function {
 
 static LLVMTypeRef symbol_type(struct symbol *sym);
 
+// With -fjobs=N the functions are emitted into separate modules which are
+// linked together at the end.  Until then the static symbols need to be
+// visible from the other modules.
+static bool split_module;
+
 static LLVMTypeRef func_return_type(struct symbol *sym)
 {
 	if (sym->type == SYM_NODE)
@@ -253,6 +262,8 @@ static LLVMTypeRef insn_symbol_type(struct instruction *insn)
 
 static LLVMLinkage data_linkage(struct symbol *sym)
 {
+	if (split_module && sym->ident)
+		return LLVMExternalLinkage;
 	if (sym->ctype.modifiers & MOD_STATIC)
 		return LLVMPrivateLinkage;
 
@@ -261,6 +272,8 @@ static LLVMLinkage data_linkage(struct symbol *sym)
 
 static LLVMLinkage function_linkage(struct symbol *sym)
 {
+	if (split_module)
+		return LLVMExternalLinkage;
 	if (sym->ctype.modifiers & MOD_STATIC)
 		return LLVMInternalLinkage;
 
@@ -1290,10 +1303,155 @@ static int is_prototype(struct symbol *sym)
 	return sym && sym->type == SYM_FN && !sym->stmt;
 }
 
+static int is_fn_definition(struct symbol *sym)
+{
+	struct symbol *base_type = sym->ctype.base_type;
+
+	return base_type && base_type->type == SYM_FN && !is_prototype(sym);
+}
+
+static void set_target(LLVMModuleRef module);
+
+static void __attribute__((noreturn)) run_fn_job(FILE *out, int nr, struct symbol_list *list)
+{
+	LLVMModuleRef module;
+	struct symbol *sym;
+	int idx = 0;
+
+	module = LLVMModuleCreateWithName("sparse");
+	set_target(module);
+
+	FOR_EACH_PTR(list, sym) {
+		struct entrypoint *ep;
+
+		if (!is_fn_definition(sym))
+			continue;
+		if (idx++ % fjobs != nr)
+			continue;
+		expand_symbol(sym);
+		ep = linearize_symbol(sym);
+		if (ep)
+			output_fn(module, ep);
+	} END_FOR_EACH_PTR(sym);
+
+	if (LLVMWriteBitcodeToFD(module, fileno(out), 0, 0))
+		_exit(127);
+	_exit(has_error | (die_if_error << 2));
+}
+
+static void link_job(LLVMModuleRef module, FILE *file, int nr)
+{
+	LLVMMemoryBufferRef buf;
+	LLVMModuleRef job_module;
+	char *data;
+	long size;
+
+	if (fseek(file, 0, SEEK_END) < 0 || (size = ftell(file)) < 0)
+		die("job %d failed", nr);
+	data = malloc(size ?: 1);
+	if (!data)
+		die("out of memory");
+	if (pread(fileno(file), data, size, 0) != size)
+		die("job %d failed", nr);
+
+	buf = LLVMCreateMemoryBufferWithMemoryRange(data, size, "sparse", 0);
+	if (LLVMParseBitcode2(buf, &job_module))
+		die("job %d: bad bitcode", nr);
+	if (LLVMLinkModules2(module, job_module))
+		die("job %d: cannot link", nr);
+	LLVMDisposeMemoryBuffer(buf);
+	free(data);
+}
+
+static void restore_static_linkage(LLVMModuleRef module, struct symbol_list *list)
+{
+	struct symbol *sym;
+	LLVMValueRef val;
+
+	FOR_EACH_PTR(list, sym) {
+		const char *name;
+
+		if (!(sym->ctype.modifiers & MOD_STATIC) || !sym->ident)
+			continue;
+		name = show_ident(sym->ident);
+		if (is_fn_definition(sym)) {
+			val = LLVMGetNamedFunction(module, name);
+			if (val)
+				LLVMSetLinkage(val, LLVMInternalLinkage);
+		} else if (!is_prototype(sym)) {
+			val = LLVMGetNamedGlobal(module, name);
+			if (val)
+				LLVMSetLinkage(val, LLVMPrivateLinkage);
+		}
+	} END_FOR_EACH_PTR(sym);
+}
+
+// The linearization and the allocators are not thread safe so the functions
+// are split between forked processes, the same as -fjobs=N does for the
+// other tools.  Each one writes its module as bitcode to a temporary file.
+// The data and the prototypes are done here and the modules are linked in.
+static int compile_parallel(LLVMModuleRef module, struct symbol_list *list)
+{
+	struct symbol *sym;
+	pid_t *pids;
+	FILE **files;
+	int status;
+	int i;
+
+	split_module = true;
+
+	pids = calloc(fjobs, sizeof(*pids));
+	files = calloc(fjobs, sizeof(*files));
+	if (!pids || !files)
+		die("out of memory");
+	fflush(NULL);
+	for (i = 0; i < fjobs; i++) {
+		files[i] = tmpfile();
+		if (!files[i])
+			die("tmpfile() failed");
+		pids[i] = fork();
+		if (pids[i] < 0)
+			die("fork() failed");
+		if (!pids[i])
+			run_fn_job(files[i], i, list);
+	}
+
+	FOR_EACH_PTR(list, sym) {
+		if (is_fn_definition(sym))
+			continue;
+		expand_symbol(sym);
+		if (is_prototype(sym))
+			get_sym_value(module, sym);
+		else
+			output_data(module, sym);
+	} END_FOR_EACH_PTR(sym);
+
+	for (i = 0; i < fjobs; i++) {
+		if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status))
+			die("job %d failed", i);
+		status = WEXITSTATUS(status);
+		if (status == 127)
+			die("job %d failed", i);
+		has_error |= status & (ERROR_CURR_PHASE | ERROR_PREV_PHASE);
+		die_if_error |= status >> 2;
+		link_job(module, files[i], i);
+		fclose(files[i]);
+	}
+	free(pids);
+	free(files);
+
+	restore_static_linkage(module, list);
+	split_module = false;
+	return 0;
+}
+
 static int compile(LLVMModuleRef module, struct symbol_list *list)
 {
 	struct symbol *sym;
 
+	if (fjobs > 1 && symbol_list_size(list) > 1)
+		return compile_parallel(module, list);
+
 	FOR_EACH_PTR(list, sym) {
 		struct entrypoint *ep;
 		expand_symbol(sym);
@@ -398,4 +398,8 @@ void ssa_convert(struct entrypoint *ep)
 
 	// remove now dead stores
 	remove_dead_stores(stores);
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		phi_map_free(&bb->phi_map);
+	} END_FOR_EACH_PTR(bb);
 }
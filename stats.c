@@ -53,6 +53,8 @@ void show_allocation_stats(void)
 	//show_stats(get_storage_hash_stats, &tot);
 
 	show_stats(NULL, &tot);
+	if (hugepage_blobs)
+		fprintf(stderr, "%16s: %8lu\n", "2MB regions", hugepage_regions);
 }
 
 void report_stats(void)
@@ -57,15 +57,33 @@ void access_symbol(struct symbol *sym)
 	}
 }
 
+/*
+ * Every binding gets a serial number.  When lookup_horizon is set the file
+ * scope symbols which were bound after it are invisible, that's how a body
+ * parsed late sees the same declarations as it would have in place.
+ */
+static unsigned int bind_count;
+unsigned int lookup_horizon;
+
+unsigned int current_bind_nr(void)
+{
+	return bind_count;
+}
+
 struct symbol *lookup_symbol(struct ident *ident, enum namespace ns)
 {
 	struct symbol *sym;
 
+	if (!(ident->ns_mask & ns))
+		return NULL;
 	for (sym = ident->symbols; sym; sym = sym->next_id) {
-		if (sym->namespace & ns) {
-			sym->used = 1;
-			return sym;
-		}
+		if (!(sym->namespace & ns))
+			continue;
+		if (lookup_horizon && sym->bind_nr > lookup_horizon &&
+		    toplevel(sym->scope))
+			continue;
+		sym->used = 1;
+		return sym;
 	}
 	return NULL;
 }
@@ -778,10 +796,12 @@ void bind_symbol_with_scope(struct symbol *sym, struct ident *ident, enum namesp
 	sym->namespace = ns;
 	sym->next_id = ident->symbols;
 	ident->symbols = sym;
+	ident->ns_mask |= ns_mask_bits(ns);
 	if (sym->ident && sym->ident != ident)
 		warning(sym->pos, "Symbol '%s' already bound", show_ident(sym->ident));
 	sym->ident = ident;
 	sym->bound = 1;
+	sym->bind_nr = ++bind_count;
 
 	if (ns == NS_SYMBOL && toplevel(scope)) {
 		unsigned mod = MOD_ADDRESSABLE | MOD_TOPLEVEL;
@@ -148,6 +148,8 @@ struct symbol {
 	enum type type:8;
 	enum namespace namespace:9;
 	unsigned char used:1, attr:2, enum_member:1, bound:1, parsed:1;
+	unsigned int bind_nr;		/* see lookup_horizon */
+	unsigned int smatch_nr;		/* see get_sym_nr() */
 	struct position pos;		/* Where this symbol was declared */
 	struct position endpos;		/* Where this symbol ends*/
 	struct ident *ident;		/* What identifier this symbol is associated with */
@@ -168,6 +170,7 @@ struct symbol {
 			struct scope *used_in;
 			void (*expand_simple)(struct token *);
 			bool (*expand)(struct token *, struct arg *args);
+			struct macro_cache *expansion_cache;
 		};
 		struct /* NS_PREPROCESSOR */ {
 			int (*handler)(struct stream *, struct token **, struct token *);
@@ -196,7 +199,8 @@ struct symbol {
 					builtin:1,
 					torename:1,
 					packed:1,
-					transparent_union:1;
+					transparent_union:1,
+					referenced:1;
 			int		rank:3;	// arithmetic's rank
 			struct expression *array_size;
 			struct ctype ctype;
@@ -205,6 +209,8 @@ struct symbol {
 			struct symbol_list *symbol_list;
 			struct statement *inline_stmt;
 			struct symbol_list *inline_symbol_list;
+			struct token *lazy_body;	/* '{' of a deferred body */
+			unsigned int lazy_horizon;
 			struct expression *initializer;
 			struct expression *cleanup;
 			struct entrypoint *ep;
@@ -334,6 +340,19 @@ extern const char * type_difference(struct ctype *c1, struct ctype *c2,
 	unsigned long mod1, unsigned long mod2);
 
 extern struct symbol *lookup_symbol(struct ident *, enum namespace);
+
+/*
+ * The preprocessor flips a bound symbol between NS_MACRO and NS_UNDEF so the
+ * ident->ns_mask has to cover both.
+ */
+static inline unsigned int ns_mask_bits(enum namespace ns)
+{
+	if (ns & (NS_MACRO | NS_UNDEF))
+		return ns | NS_MACRO | NS_UNDEF;
+	return ns;
+}
+extern unsigned int lookup_horizon;
+extern unsigned int current_bind_nr(void);
 struct symbol *lookup_macro_symbol(const char *macro);
 extern struct symbol *create_symbol(int stream, const char *name, int type, int namespace);
 extern void init_symbols(void);
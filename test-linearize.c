@@ -38,20 +38,20 @@
 #include "expression.h"
 #include "linearize.h"
 
-static void clean_up_symbols(struct symbol_list *list)
+static void clean_up_symbol(struct symbol *sym)
 {
-	struct symbol *sym;
+	struct entrypoint *ep;
 
-	FOR_EACH_PTR(list, sym) {
-		struct entrypoint *ep;
+	ep = linearize_symbol(sym);
+	if (!(fdump_ir & PASS_FINAL))
+		return;
+	if (ep)
+		show_entry(ep);
+}
 
-		expand_symbol(sym);
-		ep = linearize_symbol(sym);
-		if (!(fdump_ir & PASS_FINAL))
-			continue;
-		if (ep)
-			show_entry(ep);
-	} END_FOR_EACH_PTR(sym);
+static void clean_up_symbols(struct symbol_list *list)
+{
+	process_symbols(list, clean_up_symbol);
 }
 
 int main(int argc, char **argv)
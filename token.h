@@ -66,16 +66,20 @@ struct stream {
 extern int input_stream_nr;
 extern struct stream *input_streams;
 extern unsigned int tabstop;
+extern const char *tokenize_cache_dir;
 extern int no_lineno;
 extern int *hash_stream(const char *name);
 
 struct ident {
 	struct ident *next;	/* Hash chain of identifiers */
 	struct symbol *symbols;	/* Pointer to semantic meaning list */
+	void *fn_hooks;		/* Smatch: function hooks cached for this name */
+	unsigned int fn_hooks_gen;
 	unsigned char len;	/* Length of identifier name */
 	unsigned char tainted:1,
 	              reserved:1,
 		      keyword:1;
+	unsigned short ns_mask;	/* The namespaces in ->symbols */
 	char name[];		/* Actual identifier */
 };
 
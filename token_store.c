@@ -27,125 +27,114 @@
 #include <string.h>
 #include "lib.h"
 #include "parse.h"
-#include "allocate.h"
 
-struct line {
-	struct position pos;
-	struct line *prev;
-	struct token *token;
-	struct line *next;
+/*
+ * A copy of every token of a file, before preprocessing, in one array sorted
+ * by position.  The ->next pointers link the tokens on the same line and
+ * ->lines[] has the index of the first token of each line, or -1.  The
+ * stored streams are found through an array indexed by the stream number.
+ */
+struct stored_stream {
+	int stream;
+	int nr;
+	struct token *tokens;
+	int nr_lines;
+	int *lines;
 };
 
-__ALLOCATOR(struct token, "token store", perm_token);
-ALLOCATOR(line, "line of tokens");
+static struct stored_stream *streams;
+static int nr_streams;
+static int *stream_index;
+static int stream_index_size;
 
-static struct token *copy_token(struct token *token)
+static int cmp_token_pos(const void *_a, const void *_b)
 {
-	struct token *new;
-
-	new = __alloc_perm_token(0);
-	memcpy(new, token, sizeof(*token));
-	new->next = NULL;
-	return new;
+	const struct token *a = _a;
+	const struct token *b = _b;
+
+	if (a->pos.line != b->pos.line)
+		return a->pos.line < b->pos.line ? -1 : 1;
+	if (a->pos.pos != b->pos.pos)
+		return a->pos.pos < b->pos.pos ? -1 : 1;
+	return 0;
 }
 
-static struct line *cursor;
-
-static void find_line(struct position pos)
-{
-	if (!cursor)
-		return;
-	if (pos.line == cursor->pos.line)
-		return;
-	if (pos.line < cursor->pos.line) {
-		if (!cursor->prev)
-			return;
-		cursor = cursor->prev;
-		find_line(pos);
-		return;
-	}
-	if (!cursor->next)
-		return;
-	if (pos.line < cursor->next->pos.line)
-		return;
-	cursor = cursor->next;
-	find_line(pos);
-}
-
-static void insert_into_line(struct token **current, struct token *new)
+void store_all_tokens(struct token *token)
 {
-	if (!*current) {
-		*current = new;
-		return;
-	}
-
-	if (new->pos.pos < (*current)->pos.pos) {
-		new->next = *current;
-		*current = new;
-		return;
-	}
-
-	if (new->pos.pos == (*current)->pos.pos)
+	struct stored_stream *ss;
+	struct token *tok, *tokens;
+	bool sorted = true;
+	int nr = 0, i;
+
+	for (tok = token; token_type(tok) != TOKEN_STREAMEND; tok = tok->next)
+		nr++;
+	if (!nr)
 		return;
 
-	insert_into_line(&(*current)->next, new);
-}
-
-static void store_token(struct token *token)
-{
-	token = copy_token(token);
-
-	find_line(token->pos);
-
-	if (!cursor) {
-		cursor = __alloc_line(0);
-		cursor->pos = token->pos;
-		cursor->token = token;
-		return;
+	tokens = malloc(nr * sizeof(*tokens));
+	if (!tokens)
+		die("out of memory");
+	for (i = 0, tok = token; i < nr; i++, tok = tok->next) {
+		tokens[i] = *tok;
+		if (i && cmp_token_pos(&tokens[i - 1], &tokens[i]) > 0)
+			sorted = false;
 	}
-
-	if (token->pos.line < cursor->pos.line) {
-		cursor->prev = __alloc_line(0);
-		cursor->prev->next = cursor;
-		cursor = cursor->prev;
-		cursor->pos = token->pos;
-		cursor->token = token;
-		return;
+	if (!sorted)
+		qsort(tokens, nr, sizeof(*tokens), cmp_token_pos);
+	for (i = 0; i < nr; i++) {
+		if (i + 1 < nr && tokens[i + 1].pos.line == tokens[i].pos.line)
+			tokens[i].next = &tokens[i + 1];
+		else
+			tokens[i].next = NULL;
 	}
 
-	if (token->pos.line == cursor->pos.line) {
-		insert_into_line(&cursor->token, token);
-		return;
+	streams = realloc(streams, (nr_streams + 1) * sizeof(*streams));
+	if (!streams)
+		die("out of memory");
+	ss = &streams[nr_streams++];
+	ss->stream = token->pos.stream;
+	ss->nr = nr;
+	ss->tokens = tokens;
+
+	ss->nr_lines = tokens[nr - 1].pos.line + 1;
+	ss->lines = malloc(ss->nr_lines * sizeof(*ss->lines));
+	if (!ss->lines)
+		die("out of memory");
+	memset(ss->lines, -1, ss->nr_lines * sizeof(*ss->lines));
+	for (i = nr - 1; i >= 0; i--)
+		ss->lines[tokens[i].pos.line] = i;
+
+	if (ss->stream >= stream_index_size) {
+		int size = stream_index_size;
+
+		stream_index_size = ss->stream * 2 + 16;
+		stream_index = realloc(stream_index, stream_index_size * sizeof(*stream_index));
+		if (!stream_index)
+			die("out of memory");
+		memset(stream_index + size, -1, (stream_index_size - size) * sizeof(*stream_index));
 	}
-
-	cursor->next = __alloc_line(0);
-	cursor->next->prev = cursor;
-	cursor = cursor->next;
-	cursor->pos = token->pos;
-	cursor->token = token;
+	stream_index[ss->stream] = nr_streams - 1;
 }
 
-void store_all_tokens(struct token *token)
+static struct stored_stream *find_stream(int stream)
 {
-	while (token_type(token) != TOKEN_STREAMEND) {
-		store_token(token);
-		token = token->next;
-	}
+	if (stream < 0 || stream >= stream_index_size || stream_index[stream] < 0)
+		return NULL;
+	return &streams[stream_index[stream]];
 }
 
 struct token *first_token_from_line(struct position pos)
 {
-	find_line(pos);
-
-	if (!cursor)
-		return NULL;
+	struct stored_stream *ss;
+	int idx;
 
-	if (cursor->pos.stream != pos.stream)
+	ss = find_stream(pos.stream);
+	if (!ss || pos.line >= ss->nr_lines)
 		return NULL;
-	if (cursor->pos.line != pos.line)
+	idx = ss->lines[pos.line];
+	if (idx < 0)
 		return NULL;
-
-	return cursor->token;
+	return &ss->tokens[idx];
 }
 
 struct token *pos_get_token(struct position pos)
@@ -31,6 +31,9 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "lib.h"
 #include "allocate.h"
@@ -799,16 +802,56 @@ static int get_one_special(int c, stream_t *stream)
 	return next;
 }
 
+/*
+ * The identifier table starts with 8192 buckets and doubles whenever there
+ * are more identifiers than buckets, so the chains stay short even for a
+ * kernel file with a few hundred thousand names.  ident_hash_end() gives a
+ * hash which doesn't depend on the table size, the bucket is picked by
+ * masking it with ident_hash_mask.
+ */
 #define IDENT_HASH_BITS (13)
 #define IDENT_HASH_SIZE (1<<IDENT_HASH_BITS)
-#define IDENT_HASH_MASK (IDENT_HASH_SIZE-1)
 
 #define ident_hash_init(c)		(c)
 #define ident_hash_add(oldhash,c)	((oldhash)*11 + (c))
-#define ident_hash_end(hash)		((((hash) >> IDENT_HASH_BITS) + (hash)) & IDENT_HASH_MASK)
+#define ident_hash_end(hash)		((unsigned int)((((hash) >> 15) ^ (hash)) * 0x9e3779b1))
+
+static struct ident *initial_hash_table[IDENT_HASH_SIZE];
+static struct ident **hash_table = initial_hash_table;
+static unsigned int ident_hash_mask = IDENT_HASH_SIZE - 1;
+static int ident_hit, ident_miss, idents, ident_resizes;
+
+static unsigned long hash_name(const char *name, int len);
+
+static void grow_ident_hash(void)
+{
+	unsigned int new_mask = ident_hash_mask * 2 + 1;
+	struct ident **new_table;
+	struct ident *ident, *next;
+	unsigned int i, hash;
 
-static struct ident *hash_table[IDENT_HASH_SIZE];
-static int ident_hit, ident_miss, idents;
+	new_table = calloc(new_mask + 1, sizeof(*new_table));
+	if (!new_table)
+		return;
+
+	/*
+	 * Idents are moved to the head of their new chain, which reverses
+	 * the order within a bucket.  Nothing depends on that order.
+	 */
+	for (i = 0; i <= ident_hash_mask; i++) {
+		for (ident = hash_table[i]; ident; ident = next) {
+			next = ident->next;
+			hash = hash_name(ident->name, ident->len) & new_mask;
+			ident->next = new_table[hash];
+			new_table[hash] = ident;
+		}
+	}
+	if (hash_table != initial_hash_table)
+		free(hash_table);
+	hash_table = new_table;
+	ident_hash_mask = new_mask;
+	ident_resizes++;
+}
 
 void show_identifier_stats(void)
 {
@@ -817,11 +860,13 @@ void show_identifier_stats(void)
 
 	fprintf(stderr, "identifiers: %d hits, %d misses\n",
 		ident_hit, ident_miss);
+	fprintf(stderr, "identifiers: %d in %u buckets (%d resizes)\n",
+		idents, ident_hash_mask + 1, ident_resizes);
 
 	for (i = 0; i < 100; i++)
 		distribution[i] = 0;
 
-	for (i = 0; i < IDENT_HASH_SIZE; i++) {
+	for (i = 0; i <= ident_hash_mask; i++) {
 		struct ident * ident = hash_table[i];
 		int count = 0;
 
@@ -842,19 +887,25 @@ void show_identifier_stats(void)
 
 struct ident *alloc_ident(const char *name, int len)
 {
-	struct ident *ident = __alloc_ident(len);
+	struct ident *ident = __alloc_ident(len + 1);
 	ident->symbols = NULL;
+	ident->ns_mask = 0;
 	ident->len = len;
 	ident->tainted = 0;
 	memcpy(ident->name, name, len);
+	ident->name[len] = '\0';
 	return ident;
 }
 
 static struct ident * insert_hash(struct ident *ident, unsigned long hash)
 {
+	if (idents > ident_hash_mask)
+		grow_ident_hash();
+	hash &= ident_hash_mask;
 	ident->next = hash_table[hash];
 	hash_table[hash] = ident;
 	ident_miss++;
+	idents++;
 	return ident;
 }
 
@@ -863,7 +914,9 @@ static struct ident *create_hashed_ident(const char *name, int len, unsigned lon
 	struct ident *ident;
 	struct ident **p;
 
-	p = &hash_table[hash];
+	if (idents > ident_hash_mask)
+		grow_ident_hash();
+	p = &hash_table[hash & ident_hash_mask];
 	while ((ident = *p) != NULL) {
 		if (ident->len == (unsigned char) len) {
 			if (strncmp(name, ident->name, len) != 0)
@@ -1022,11 +1075,278 @@ struct token * tokenize_buffer(void *buffer, unsigned long size, struct token **
 	return begin;
 }
 
+/*
+ * Regular files are mapped whole and scanned in place, the same as
+ * tokenize_buffer().  That saves a read() for every 8k of every header.
+ * Anything else (pipes, empty files, mmap() failing) is read in BUFSIZE
+ * chunks like before.
+ */
+static void *map_stream(int fd, size_t *size)
+{
+	struct stat st;
+	void *map;
+
+	if (fd < 0 || fstat(fd, &st) < 0)
+		return NULL;
+	if (!S_ISREG(st.st_mode) || st.st_size <= 0 || st.st_size > INT32_MAX)
+		return NULL;
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+	*size = st.st_size;
+	return map;
+}
+
+/*
+ * With a tokenize_cache_dir set, the raw token stream of every regular file
+ * is saved as <dir>/<dev>-<ino>.tok and later runs (other processes
+ * included) rebuild the tokens from that instead of scanning the file again.
+ * This is the tokenizer's output, before any preprocessing, so it doesn't
+ * depend on which macros are defined where the file is included.
+ *
+ * An entry is only used if the file's size, mtime and ctime still match and it
+ * was written with the same tabstop and -Wnewline-eof.  The times are compared
+ * with their nanoseconds, since a header can be edited more than once in the
+ * same second without changing size.  Files which produced a
+ * diagnostic while being tokenized are never saved, so the warnings still
+ * show up every time.
+ */
+const char *tokenize_cache_dir;
+
+#define TOKENIZE_CACHE_MAGIC "SPTOKC02"
+
+struct tokenize_cache_header {
+	char magic[8];
+	uint64_t dev;
+	uint64_t ino;
+	int64_t size;
+	int64_t mtime;
+	int64_t mtime_nsec;
+	int64_t ctime;
+	int64_t ctime_nsec;
+	uint32_t tabstop;
+	uint32_t flags;
+	uint32_t nr_tokens;
+	uint32_t pad;
+};
+
+struct tokenize_cache_rec {
+	struct position pos;
+	uint32_t len;
+	uint32_t val;
+	char data[];
+};
+
+static int tokenize_rec_size(int len)
+{
+	return (sizeof(struct tokenize_cache_rec) + len + 8) & ~7;
+}
+
+static void tokenize_cache_name(const struct stat *st, char *buf, int size)
+{
+	snprintf(buf, size, "%s/%llx-%llx.tok", tokenize_cache_dir,
+		 (unsigned long long)st->st_dev, (unsigned long long)st->st_ino);
+}
+
+static void tokenize_cache_fill(struct tokenize_cache_header *hdr, const struct stat *st)
+{
+	memset(hdr, 0, sizeof(*hdr));
+	memcpy(hdr->magic, TOKENIZE_CACHE_MAGIC, 8);
+	hdr->dev = st->st_dev;
+	hdr->ino = st->st_ino;
+	hdr->size = st->st_size;
+	hdr->mtime = st->st_mtim.tv_sec;
+	hdr->mtime_nsec = st->st_mtim.tv_nsec;
+	hdr->ctime = st->st_ctim.tv_sec;
+	hdr->ctime_nsec = st->st_ctim.tv_nsec;
+	hdr->tabstop = tabstop;
+	hdr->flags = Wnewline_eof;
+}
+
+static struct token *load_tokenize_cache(int idx, const struct stat *st, struct token **endp)
+{
+	struct tokenize_cache_header want, *hdr;
+	struct tokenize_cache_rec *rec;
+	struct token *begin = NULL, *token, **next;
+	struct string *string;
+	struct stat cache_st;
+	char buf[PATH_MAX];
+	char *p, *end;
+	void *map;
+	int fd, i;
+
+	tokenize_cache_name(st, buf, sizeof(buf));
+	fd = open(buf, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &cache_st) || cache_st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+	hdr = map;
+	tokenize_cache_fill(&want, st);
+	want.nr_tokens = hdr->nr_tokens;
+	if (memcmp(hdr, &want, sizeof(want)) != 0)
+		goto out;
+
+	next = &begin;
+	p = (char *)(hdr + 1);
+	end = (char *)map + cache_st.st_size;
+	for (i = 0; i < hdr->nr_tokens; i++) {
+		rec = (struct tokenize_cache_rec *)p;
+		if (p + sizeof(*rec) > end || rec->len > MAX_STRING ||
+		    p + tokenize_rec_size(rec->len) > end)
+			goto corrupt;
+		token = __alloc_token(0);
+		token->pos = rec->pos;
+		token->pos.stream = idx;
+		switch (token_type(token)) {
+		case TOKEN_IDENT:
+			token->ident = create_hashed_ident(rec->data, rec->len,
+						hash_name(rec->data, rec->len));
+			break;
+		case TOKEN_NUMBER:
+			token->number = xmemdup(rec->data, rec->len + 1);
+			break;
+		case TOKEN_CHAR:
+		case TOKEN_WIDE_CHAR:
+		case TOKEN_STRING:
+		case TOKEN_WIDE_STRING:
+			string = __alloc_string(rec->len + 1);
+			memcpy(string->data, rec->data, rec->len + 1);
+			string->length = rec->len + 1;
+			token->string = string;
+			break;
+		case TOKEN_CHAR_EMBEDDED_0 ... TOKEN_CHAR_EMBEDDED_3:
+		case TOKEN_WIDE_CHAR_EMBEDDED_0 ... TOKEN_WIDE_CHAR_EMBEDDED_3:
+			memcpy(token->embedded, &rec->val, 4);
+			break;
+		case TOKEN_SPECIAL:
+			token->special = rec->val;
+			break;
+		case TOKEN_STREAMBEGIN:
+		case TOKEN_STREAMEND:
+			break;
+		default:
+			goto corrupt;
+		}
+		*next = token;
+		next = &token->next;
+		p += tokenize_rec_size(rec->len);
+	}
+	if (!begin || token_type(begin) != TOKEN_STREAMBEGIN ||
+	    token_type(containing_token(next)) != TOKEN_STREAMEND)
+		goto corrupt;
+
+	token = containing_token(next);
+	eof_token_entry.pos = token->pos;
+	eof_token_entry.pos.type = TOKEN_EOF;
+	eof_token_entry.next = &eof_token_entry;
+	eof_token_entry.pos.newline = 1;
+	token->next = &eof_token_entry;
+	*endp = token;
+	munmap(map, cache_st.st_size);
+	return begin;
+
+corrupt:
+	/* The tokens allocated so far are simply dropped. */
+	unlink(buf);
+out:
+	munmap(map, cache_st.st_size);
+	return NULL;
+}
+
+static void save_tokenize_cache(const struct stat *st, struct token *begin)
+{
+	struct tokenize_cache_header hdr;
+	struct tokenize_cache_rec *rec;
+	struct token *token;
+	char buf[PATH_MAX];
+	char tmp[PATH_MAX + 16];
+	char recbuf[sizeof(*rec) + MAX_STRING + 8];
+	const char *str;
+	FILE *f;
+
+	rec = (struct tokenize_cache_rec *)recbuf;
+
+	tokenize_cache_name(st, buf, sizeof(buf));
+	snprintf(tmp, sizeof(tmp), "%s.%d", buf, getpid());
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+
+	tokenize_cache_fill(&hdr, st);
+	fwrite(&hdr, sizeof(hdr), 1, f);
+
+	for (token = begin; ; token = token->next) {
+		memset(recbuf, 0, sizeof(*rec));
+		rec->pos = token->pos;
+		str = "";
+		rec->len = 0;
+		switch (token_type(token)) {
+		case TOKEN_IDENT:
+			str = token->ident->name;
+			rec->len = token->ident->len;
+			break;
+		case TOKEN_NUMBER:
+			str = token->number;
+			rec->len = strlen(str);
+			break;
+		case TOKEN_CHAR:
+		case TOKEN_WIDE_CHAR:
+		case TOKEN_STRING:
+		case TOKEN_WIDE_STRING:
+			str = token->string->data;
+			rec->len = token->string->length - 1;
+			break;
+		case TOKEN_CHAR_EMBEDDED_0 ... TOKEN_CHAR_EMBEDDED_3:
+		case TOKEN_WIDE_CHAR_EMBEDDED_0 ... TOKEN_WIDE_CHAR_EMBEDDED_3:
+			memcpy(&rec->val, token->embedded, 4);
+			break;
+		case TOKEN_SPECIAL:
+			rec->val = token->special;
+			break;
+		case TOKEN_STREAMBEGIN:
+		case TOKEN_STREAMEND:
+			break;
+		default:
+			goto fail;
+		}
+		if (rec->len > MAX_STRING)
+			goto fail;
+		memset(rec->data, 0, tokenize_rec_size(rec->len) - sizeof(*rec));
+		memcpy(rec->data, str, rec->len);
+		fwrite(recbuf, tokenize_rec_size(rec->len), 1, f);
+		hdr.nr_tokens++;
+		if (token_type(token) == TOKEN_STREAMEND)
+			break;
+	}
+
+	rewind(f);
+	fwrite(&hdr, sizeof(hdr), 1, f);
+	if (fclose(f) == 0 && rename(tmp, buf) == 0)
+		return;
+	unlink(tmp);
+	return;
+fail:
+	fclose(f);
+	unlink(tmp);
+}
+
 struct token * tokenize(const struct position *pos, const char *name, int fd, struct token *endtoken, const char **next_path)
 {
 	struct token *begin, *end;
 	stream_t stream;
 	unsigned char buffer[BUFSIZE];
+	unsigned int diagnostics;
+	size_t map_size = 0;
+	struct stat st;
+	bool cache = false;
+	void *map;
 	int idx;
 
 	idx = init_stream(pos, name, fd, next_path);
@@ -1035,8 +1355,26 @@ struct token * tokenize(const struct position *pos, const char *name, int fd, st
 		return endtoken;
 	}
 
-	begin = setup_stream(&stream, idx, fd, buffer, 0);
+	if (tokenize_cache_dir && fd >= 0 && fstat(fd, &st) == 0 &&
+	    S_ISREG(st.st_mode)) {
+		cache = true;
+		begin = load_tokenize_cache(idx, &st, &end);
+		if (begin)
+			goto done;
+	}
+
+	diagnostics = diagnostic_count;
+	map = map_stream(fd, &map_size);
+	if (map)
+		begin = setup_stream(&stream, idx, -1, map, map_size);
+	else
+		begin = setup_stream(&stream, idx, fd, buffer, 0);
 	end = tokenize_stream(&stream);
+	if (map)
+		munmap(map, map_size);
+	if (cache && diagnostics == diagnostic_count)
+		save_tokenize_cache(&st, begin);
+done:
 	if (endtoken)
 		end->next = endtoken;
 	return begin;
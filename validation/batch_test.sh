@@ -0,0 +1,17 @@
+#!/bin/bash
+
+# Check the file given as the last argument three times from one --batch
+# file: with -DFIRST, with -DSECOND and from the parent directory.  The
+# other arguments are passed to smatch.
+
+file=${@: -1}
+opts=${@:1:$#-1}
+
+batch=$(mktemp)
+trap 'rm -f "$batch"' EXIT
+
+printf '.\t-I..\t-DFIRST\t%s\n' $file > $batch
+printf '.\t-I..\t-DSECOND\t%s\n' $file >> $batch
+printf '..\t-I.\t-DFIRST\tvalidation/%s\n' $file >> $batch
+
+../smatch $opts --batch=$batch
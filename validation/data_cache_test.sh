@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Run smatch three times with --data-cache: cold, warm and after the data
+# file was edited.  The edit keeps the size and the mtime in the same
+# second.  The data file is made here: smatch_generic.no_return_funcs says
+# "frob" doesn't return and then it says "frab" doesn't.
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+mkdir $dir/cache $dir/data
+data=$dir/data/smatch_generic.no_return_funcs
+echo "frob" > $data
+touch -d @1700000000.100000000 $data
+
+run()
+{
+    ../smatch --data=$dir/data --data-cache=$dir/cache $*
+    echo "cache entries: $(ls $dir/cache | wc -l)"
+}
+
+run $*
+run $*
+echo "frab" > $data
+touch -d @1700000000.200000000 $data
+run $*
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Build a DB, run smatch against it with --db-capture, then move the DB out
+# of the way and run again with --db-replay.  The replay has to give the
+# same answers without the DB.  The DB is built with -DDB_CAPTURE_LIB so
+# the file can define a function only for the DB.
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+db=$dir/smatch_db.sqlite
+
+../smatch --info -DDB_CAPTURE_LIB $* > $dir/warns.txt
+cat ../smatch_data/db/*.schema | sqlite3 $db > /dev/null
+../smatch_data/db/sm_fill_db $db $dir/warns.txt > /dev/null 2>&1
+
+../smatch --db-file=$db --db-capture=$dir/capture $*
+rm $db
+../smatch --db-file=$db --db-replay=$dir/capture $*
+# test2() makes queries which weren't captured
+../smatch --db-file=$db --db-replay=$dir/capture -DDB_CAPTURE_MORE $* 2> $dir/err
+sed 's/[0-9]* queries/<n> queries/; s|'$dir/'||' $dir/err
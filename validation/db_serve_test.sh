@@ -0,0 +1,36 @@
+#!/bin/bash
+
+# Serve a DB on a Unix socket and run smatch against it with --db-remote,
+# then with --info.  The --info rows end up in <db>.info on the server side
+# and that is loaded into a new DB.  The DB is built with -DDB_SERVE_LIB so
+# the file can define a function only for the DB.
+
+dir=$(mktemp -d)
+server=
+trap '[ -n "$server" ] && kill $server 2> /dev/null; rm -rf "$dir"' EXIT
+
+db=$dir/smatch_db.sqlite
+
+../smatch --info -DDB_SERVE_LIB $* > $dir/warns.txt
+cat ../smatch_data/db/*.schema | sqlite3 $db > /dev/null
+../smatch_data/db/sm_fill_db $db $dir/warns.txt > /dev/null 2>&1
+
+../smatch --db-file=$db --db-serve=$dir/sock 2> $dir/server.txt &
+server=$!
+for i in $(seq 50) ; do
+    [ -S $dir/sock ] && break
+    sleep 0.1
+done
+echo "socket mode: $(stat -c %a $dir/sock)"
+
+../smatch --db-remote=$dir/sock $*
+../smatch --db-remote=$dir/sock --info -DDB_SERVE_LIB $* > /dev/null
+
+kill $server
+wait $server
+server=
+echo "raw SQL lines: $(grep -c '() SQL: ' $db.info)"
+
+cat ../smatch_data/db/*.schema | sqlite3 $dir/new.sqlite > /dev/null
+../smatch_data/db/sm_fill_db $dir/new.sqlite $db.info > /dev/null 2>&1
+sqlite3 $dir/new.sqlite "select distinct return from return_states where function = 'frob';"
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Run smatch --info --spool --gzip twice, once with -DSECOND.  Each run adds
+# a gzip member to the files and "gzip -dc" reads them back as one file.
+# Then --file-output --gzip, which writes <file>.smatch next to the file.
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+../smatch --spool=$dir/out --gzip --info $*
+../smatch --spool=$dir/out --gzip --info -DSECOND $*
+for i in out out.sql out.caller_info ; do
+    gzip -t $dir/$i && echo "$i: gzip"
+done
+gzip -dc $dir/out | grep -v SQL
+echo "caller_info lines: $(gzip -dc $dir/out.caller_info | wc -l)"
+
+file=${@: -1}
+opts=${@:1:$#-1}
+cp $file $dir/
+../smatch --file-output --gzip $opts $dir/$file
+gzip -dc $dir/$file.smatch | grep -v SQL | sed "s|$dir/||"
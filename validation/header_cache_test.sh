@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Run smatch three times with --header-cache: cold, warm and after the
+# header was edited.  The edit keeps the size and the mtime in the same
+# second, which is what happens when a header is rewritten quickly.  The
+# header is made here: "#define VAL 1" and then "#define VAL 5".
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+mkdir $dir/cache
+echo "#define VAL 1" > $dir/sm_header_cache.h
+touch -d @1700000000.100000000 $dir/sm_header_cache.h
+
+run()
+{
+    ../smatch --header-cache=$dir/cache -I$dir $*
+    echo "cache entries: $(ls $dir/cache | wc -l)"
+}
+
+run $*
+run $*
+echo "#define VAL 5" > $dir/sm_header_cache.h
+touch -d @1700000000.200000000 $dir/sm_header_cache.h
+run $*
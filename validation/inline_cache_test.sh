@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Run smatch four times with a shared --inline-cache: cold, warm, with
+# -DBIG which changes the macro in the header's inline function and then
+# warm again with -DBIG.  The header is made here.
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+mkdir $dir/cache
+cat > $dir/sm_inline_cache.h <<'EOH'
+#ifdef BIG
+#define VAL 5
+#else
+#define VAL 1
+#endif
+
+static inline int get(void)
+{
+	return VAL;
+}
+EOH
+
+run()
+{
+    ../smatch --inline-cache=$dir/cache -I$dir $*
+    echo "cache entries: $(ls $dir/cache | wc -l)"
+}
+
+run $*
+run $*
+run -DBIG $*
+run -DBIG $*
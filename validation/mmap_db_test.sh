@@ -0,0 +1,24 @@
+#!/bin/bash
+
+# Build a DB and its smatch_db.sqlite.mmap copy and run smatch without the
+# copy, with it, and after the DB was changed in place.  The change keeps
+# the size and the mtime in the same second, like a quick reload would.
+# The change turns every returned 42 into 43.  The DB is built with
+# -DMMAP_DB_LIB so the file can define a function only for the DB.
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+db=$dir/smatch_db.sqlite
+
+../smatch --info -DMMAP_DB_LIB $* > $dir/warns.txt
+cat ../smatch_data/db/*.schema | sqlite3 $db > /dev/null
+../smatch_data/db/sm_fill_db $db $dir/warns.txt > /dev/null 2>&1
+touch -d @1700000000.100000000 $db
+
+../smatch --db-file=$db $*
+../smatch_data/db/sm_mmap_db $db 2> /dev/null
+../smatch --db-file=$db $*
+sqlite3 $db "update return_states set return = '43' where return = '42';"
+touch -d @1700000000.200000000 $db
+../smatch --db-file=$db $*
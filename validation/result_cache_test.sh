@@ -0,0 +1,30 @@
+#!/bin/bash
+
+# Run smatch with --result-cache before and after the DB is rebuilt and
+# print how many entries the cache has after each run.  The DB only needs
+# the --info rows so it's filled without the fixups from create_db.sh.
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+db=$dir/smatch_db.sqlite
+cache=$dir/result_cache
+mkdir $cache
+
+build_db()
+{
+    ../smatch --info $* > $dir/warns.txt
+    rm -f $db.new
+    cat ../smatch_data/db/*.schema | sqlite3 $db.new > /dev/null
+    ../smatch_data/db/sm_fill_db $db.new $dir/warns.txt > /dev/null 2>&1
+    mv $db.new $db
+}
+
+build_db $*
+../smatch --db-file=$db --result-cache=$cache $*
+echo "cache entries: $(ls $cache | wc -l)"
+../smatch --db-file=$db --result-cache=$cache $*
+echo "cache entries: $(ls $cache | wc -l)"
+build_db $*
+../smatch --db-file=$db --result-cache=$cache $*
+echo "cache entries: $(ls $cache | wc -l)"
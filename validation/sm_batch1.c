@@ -0,0 +1,37 @@
+#include <stdlib.h>
+#include "check_debug.h"
+
+void frob(void *p)
+{
+	free(p);
+#ifdef FIRST
+	free(p);
+#endif
+#ifdef SECOND
+	*(char *)p = 1;
+#endif
+}
+
+int value(void)
+{
+#ifdef FIRST
+	int x = 1;
+#else
+	int x = 2;
+#endif
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --batch applies the options of each line
+ * check-command: validation/batch_test.sh --jobs=2 sm_batch1.c
+ *
+ * check-output-start
+sm_batch1.c:8 frob() error: double free of 'p'
+sm_batch1.c:22 value() implied: x = '1'
+sm_batch1.c:11 frob() error: dereferencing freed memory 'p'
+sm_batch1.c:22 value() implied: x = '2'
+validation/sm_batch1.c:8 frob() error: double free of 'p'
+validation/sm_batch1.c:22 value() implied: x = '1'
+ * check-output-end
+ */
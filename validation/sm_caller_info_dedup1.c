@@ -0,0 +1,29 @@
+#include "check_debug.h"
+
+void frob(int x);
+
+void test(int a)
+{
+	frob(1);
+	frob(1);
+	frob(2);
+	if (a)
+		frob(1);
+}
+
+void test2(void)
+{
+	frob(1);
+}
+/*
+ * check-name: smatch: caller_info skips repeated calls
+ * check-command: smatch --info -I.. sm_caller_info_dedup1.c
+ *
+ * check-output-ignore
+ * check-output-pattern(3): caller_info values .*'%call_marker%'
+ * check-output-contains: :7 test() SQL_caller_info: .*'test', 'frob', %CALL_ID%, 0, 1001, 0, '$', '1'
+ * check-output-contains: :9 test() SQL_caller_info: .*'test', 'frob', %CALL_ID%, 0, 1001, 0, '$', '2'
+ * check-output-contains: :16 test2() SQL_caller_info: .*'test2', 'frob', %CALL_ID%, 0, 1001, 0, '$', '1'
+ * check-output-pattern(2): caller_info values .*'$', '1'
+ * check-output-pattern(1): caller_info values .*'$', '2'
+ */
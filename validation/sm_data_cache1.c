@@ -0,0 +1,30 @@
+#include "check_debug.h"
+
+void frob(void);
+
+int test(int a)
+{
+	int x = 1;
+
+	if (a) {
+		frob();
+		x = 2;
+	}
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --data-cache notices an edited data file
+ * check-command: validation/data_cache_test.sh -I.. sm_data_cache1.c
+ *
+ * check-output-start
+sm_data_cache1.c:11 test() warn: ignoring unreachable code.
+sm_data_cache1.c:13 test() implied: x = '1'
+cache entries: 1
+sm_data_cache1.c:11 test() warn: ignoring unreachable code.
+sm_data_cache1.c:13 test() implied: x = '1'
+cache entries: 1
+sm_data_cache1.c:13 test() implied: x = '1-2'
+cache entries: 1
+ * check-output-end
+ */
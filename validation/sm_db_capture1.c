@@ -0,0 +1,46 @@
+#include "check_debug.h"
+
+int frob(void);
+int frab(void);
+
+#ifdef DB_CAPTURE_LIB
+int frob(void)
+{
+	return 42;
+}
+
+int frab(void)
+{
+	return 43;
+}
+#endif
+
+int test(void)
+{
+	int x = frob();
+
+	__smatch_implied(x);
+	return x;
+}
+
+#ifdef DB_CAPTURE_MORE
+int test2(void)
+{
+	int x = frab();
+
+	__smatch_implied(x);
+	return x;
+}
+#endif
+/*
+ * check-name: smatch: --db-replay answers the queries from a --db-capture
+ * check-command: validation/db_capture_test.sh -I.. sm_db_capture1.c
+ *
+ * check-output-start
+sm_db_capture1.c:22 test() implied: x = '42'
+sm_db_capture1.c:22 test() implied: x = '42'
+sm_db_capture1.c:22 test() implied: x = '42'
+sm_db_capture1.c:31 test2() implied: x = 's32min-s32max'
+smatch: <n> queries were not in capture
+ * check-output-end
+ */
@@ -0,0 +1,29 @@
+#include "check_debug.h"
+
+int frob(void);
+
+#ifdef DB_SERVE_LIB
+int frob(void)
+{
+	return 42;
+}
+#endif
+
+int test(void)
+{
+	int x = frob();
+
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --db-serve answers queries and keeps the --info rows
+ * check-command: validation/db_serve_test.sh -I.. sm_db_serve1.c
+ *
+ * check-output-start
+socket mode: 600
+sm_db_serve1.c:16 test() implied: x = '42'
+raw SQL lines: 0
+42
+ * check-output-end
+ */
@@ -0,0 +1,31 @@
+#include <stdlib.h>
+#include "check_debug.h"
+
+int frob(void);
+
+int func(void)
+{
+	void *x;
+
+	x = malloc(42);
+
+	free(x);
+	free(x);
+
+	__smatch_over_budget();
+	if (frob())
+		return -12;
+	return 0;
+}
+/*
+ * check-name: smatch: degraded pass keeps the warnings
+ * check-command: smatch --info -I.. sm_degraded1.c
+ *
+ * check-exit-value: 1
+ * check-output-ignore
+ * check-output-pattern(1): error: double free of 'x'
+ * check-output-pattern(1): Parsing it again without implications
+ * check-output-contains: return_states values.*'(-12)', 0, 0, -1, '17'
+ * check-output-contains: return_states values.*'0', 0, 0, -1, '18'
+ * check-output-excludes: return_states values.*'15', 'int
+ */
@@ -0,0 +1,22 @@
+#include "check_debug.h"
+
+int frob(int a)
+{
+	int x = 0;
+
+	if (a)
+		x = 1;
+	if (a)
+		__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --fast skips the implications and --info
+ * check-command: smatch --fast --info -I.. sm_fast1.c
+ *
+ * Without --fast x is '1' and the --info SQL is printed.
+ *
+ * check-output-start
+sm_fast1.c:10 frob() implied: x = '0-1'
+ * check-output-end
+ */
@@ -0,0 +1,31 @@
+#include "check_debug.h"
+
+long double ld_frob(void);
+
+void func(void)
+{
+	long double big = 18446744073709551615.0L;
+	long double a = ld_frob();
+	long double pos = 2.5L;
+	long double neg = -2.5L;
+	long double quad = 10.0L;
+
+	__smatch_implied(big);
+	__smatch_implied(a);
+	__smatch_implied(pos);
+	__smatch_implied(neg);
+	__smatch_implied(quad);
+}
+
+/*
+ * check-name: smatch floating point #2
+ * check-command: smatch -I.. sm_float2.c
+ *
+ * check-output-start
+sm_float2.c:13 func() implied: big = '18446744073709551615.000000'
+sm_float2.c:14 func() implied: a = '-118973149535723176502126385303-1189731495357231765021263853030'
+sm_float2.c:15 func() implied: pos = '2.500000'
+sm_float2.c:16 func() implied: neg = '-118973149535723176502126385303-1189731495357231765021263853030'
+sm_float2.c:17 func() implied: quad = '10.000000'
+ * check-output-end
+ */
@@ -0,0 +1,30 @@
+#include "check_debug.h"
+
+int frob(void);
+
+void func(void)
+{
+	long double a, b;
+
+	if (frob())
+		a = 2.5L;
+	else
+		a = 3.0L;
+	if (frob())
+		b = 10.0L;
+	else
+		b = 12.0L;
+
+	__smatch_implied(a);
+	__smatch_implied(b);
+}
+
+/*
+ * check-name: smatch floating point #3
+ * check-command: smatch -I.. sm_float3.c
+ *
+ * check-output-start
+sm_float3.c:18 func() implied: a = '2.500000,3.000000'
+sm_float3.c:19 func() implied: b = '10.000000,12.000000'
+ * check-output-end
+ */
@@ -0,0 +1,26 @@
+#include "check_debug.h"
+
+int frob(int x)
+{
+#ifdef SECOND
+	x = 2;
+#else
+	x = 1;
+#endif
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --gzip output reads back with gzip -dc
+ * check-command: validation/gzip_test.sh -I.. sm_gzip1.c
+ *
+ * check-output-start
+out: gzip
+out.sql: gzip
+out.caller_info: gzip
+sm_gzip1.c:10 frob() implied: x = '1'
+sm_gzip1.c:10 frob() implied: x = '2'
+caller_info lines: 4
+sm_gzip1.c:10 frob() implied: x = '1'
+ * check-output-end
+ */
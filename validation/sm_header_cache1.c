@@ -0,0 +1,23 @@
+#include "check_debug.h"
+#include "sm_header_cache.h"
+
+int frob(void)
+{
+	int x = VAL;
+
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --header-cache notices an edited header
+ * check-command: validation/header_cache_test.sh -I.. sm_header_cache1.c
+ *
+ * check-output-start
+sm_header_cache1.c:8 frob() implied: x = '1'
+cache entries: 4
+sm_header_cache1.c:8 frob() implied: x = '1'
+cache entries: 4
+sm_header_cache1.c:8 frob() implied: x = '5'
+cache entries: 4
+ * check-output-end
+ */
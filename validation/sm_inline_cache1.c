@@ -0,0 +1,25 @@
+#include "check_debug.h"
+#include "sm_inline_cache.h"
+
+int frob(void)
+{
+	int x = get();
+
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --inline-cache notices a different -D
+ * check-command: validation/inline_cache_test.sh -I.. sm_inline_cache1.c
+ *
+ * check-output-start
+sm_inline_cache1.c:8 frob() implied: x = '1'
+cache entries: 1
+sm_inline_cache1.c:8 frob() implied: x = '1'
+cache entries: 1
+sm_inline_cache1.c:8 frob() implied: x = '5'
+cache entries: 2
+sm_inline_cache1.c:8 frob() implied: x = '5'
+cache entries: 2
+ * check-output-end
+ */
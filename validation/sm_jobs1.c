@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include "check_debug.h"
+
+static inline void drop(void *p)
+{
+	free(p);
+}
+
+void one(void *p)
+{
+	free(p);
+	free(p);
+}
+
+void two(void *p)
+{
+	drop(p);
+	drop(p);
+}
+
+int three(void)
+{
+	int x = 10;
+
+	__smatch_implied(x);
+	return x;
+}
+
+void four(void *p)
+{
+	drop(p);
+	free(p);
+}
+
+void five(void *p)
+{
+	free(p);
+	*(char *)p = 1;
+}
+/*
+ * check-name: smatch: --jobs keeps the warnings in source order
+ * check-command: smatch --jobs=3 -I.. sm_jobs1.c
+ *
+ * check-output-start
+sm_jobs1.c:12 one() error: double free of 'p'
+sm_jobs1.c:18 two() warn: passing freed memory 'p'
+sm_jobs1.c:25 three() implied: x = '10'
+sm_jobs1.c:32 four() error: double free of 'p'
+sm_jobs1.c:38 five() error: dereferencing freed memory 'p'
+ * check-output-end
+ */
@@ -0,0 +1,16 @@
+int frob(void);
+
+static inline int used(void)
+{
+	return 42;
+}
+
+static inline int calls_frob(void)
+{
+	return frob();
+}
+
+static inline int unused(void)
+{
+	return 1;
+}
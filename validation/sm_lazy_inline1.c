@@ -0,0 +1,29 @@
+#include "check_debug.h"
+#include "sm_lazy_inline.h"
+
+int test(void)
+{
+	int x = used();
+	int y = calls_frob();
+
+	__smatch_implied(x);
+	__smatch_implied(y);
+	return x + y;
+}
+
+int frob(void)
+{
+	return 7;
+}
+/*
+ * check-name: smatch: --lazy-inline still inlines the used header functions
+ * check-command: smatch --lazy-inline -I.. sm_lazy_inline1.c
+ *
+ * unused() is never parsed.  frob() is defined after the header so the
+ * late parse of calls_frob() must not see the definition.
+ *
+ * check-output-start
+sm_lazy_inline1.c:9 test() implied: x = '42'
+sm_lazy_inline1.c:10 test() implied: y = 's32min-s32max'
+ * check-output-end
+ */
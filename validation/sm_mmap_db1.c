@@ -0,0 +1,28 @@
+#include "check_debug.h"
+
+int frob(void);
+
+#ifdef MMAP_DB_LIB
+int frob(void)
+{
+	return 42;
+}
+#endif
+
+int test(void)
+{
+	int x = frob();
+
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: the mmap DB copy is not used after the DB changes
+ * check-command: validation/mmap_db_test.sh -I.. sm_mmap_db1.c
+ *
+ * check-output-start
+sm_mmap_db1.c:16 test() implied: x = '42'
+sm_mmap_db1.c:16 test() implied: x = '42'
+sm_mmap_db1.c:16 test() implied: x = '43'
+ * check-output-end
+ */
@@ -0,0 +1,23 @@
+#include "check_debug.h"
+
+int frob(int x)
+{
+	int a = 42;
+
+	__smatch_implied(a);
+	return x + a;
+}
+
+/*
+ * check-name: smatch result cache #1
+ * check-command: validation/result_cache_test.sh -I.. sm_result_cache1.c
+ *
+ * check-output-start
+sm_result_cache1.c:7 frob() implied: a = '42'
+cache entries: 1
+sm_result_cache1.c:7 frob() implied: a = '42'
+cache entries: 1
+sm_result_cache1.c:7 frob() implied: a = '42'
+cache entries: 2
+ * check-output-end
+ */
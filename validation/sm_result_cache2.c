@@ -0,0 +1,23 @@
+#include "check_debug.h"
+
+int frob(int x)
+{
+	int a = 42;
+
+	__smatch_implied(a);
+	return x + a;
+}
+
+/*
+ * check-name: smatch result cache #2
+ * check-command: validation/result_cache_test.sh --function-cache -I.. sm_result_cache2.c
+ *
+ * check-output-start
+sm_result_cache2.c:7 frob() implied: a = '42'
+cache entries: 2
+sm_result_cache2.c:7 frob() implied: a = '42'
+cache entries: 2
+sm_result_cache2.c:7 frob() implied: a = '42'
+cache entries: 4
+ * check-output-end
+ */
@@ -0,0 +1,37 @@
+#include "check_debug.h"
+
+int frob(void);
+
+int test(int x)
+{
+	if (x == 1)
+		return 10;
+	if (x == 2)
+		return 20;
+	if (x == 3)
+		return 30;
+	if (x == 4)
+		return 40;
+	if (x == 5)
+		return 50;
+	if (x == 6)
+		return 60;
+	return frob() ? -12 : 0;
+}
+
+int test2(void)
+{
+	return frob() ? -12 : 0;
+}
+/*
+ * check-name: smatch: --return-budget stops splitting the returns
+ * check-command: smatch --info --return-budget=4 -I.. sm_return_budget1.c
+ *
+ * check-output-ignore
+ * check-output-contains: :19 test() info: return budget: 7 rows, 5 returns not split
+ * check-output-contains: 'test', .*, 7, '(-12),0', 0, 0, -1, '19'
+ * check-output-excludes: 'test', .*, '(-12)', 0, 0, -1, '19'
+ * check-output-contains: 'test2', .*, '(-12)', 0, 0, -1, '24'
+ * check-output-contains: 'test2', .*, '0', 0, 0, -1, '24'
+ * check-output-pattern(1): return budget:
+ */
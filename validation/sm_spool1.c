@@ -0,0 +1,23 @@
+#include "check_debug.h"
+
+int frob(int x)
+{
+#ifdef SECOND
+	x = 2;
+#else
+	x = 1;
+#endif
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --spool appends the same lines as --info prints
+ * check-command: validation/spool_test.sh -I.. sm_spool1.c
+ *
+ * check-output-start
+same lines
+sm_spool1.c:10 frob() implied: x = '1'
+sm_spool1.c:10 frob() implied: x = '2'
+caller_info lines: 4
+ * check-output-end
+ */
@@ -0,0 +1,45 @@
+#include "check_debug.h"
+
+struct ops {
+	int (*get)(void);
+	int (*set)(int);
+};
+
+int frob(void);
+
+#ifdef SQL_ROWS_LIB
+int frob(void)
+{
+	return 42;
+}
+
+static int set(int x)
+{
+	if (x < 0)
+		return -22;
+	return 0;
+}
+
+struct ops my_ops = {
+	.get = frob,
+	.set = set,
+};
+#endif
+
+int test(void)
+{
+	int x = frob();
+
+	__smatch_implied(x);
+	return x;
+}
+/*
+ * check-name: smatch: --sql-rows loads the same rows as the SQL
+ * check-command: validation/sql_rows_test.sh -I.. sm_sql_rows1.c
+ *
+ * check-output-start
+has SQL_row records
+same rows
+sm_sql_rows1.c:33 test() implied: x = '42'
+ * check-output-end
+ */
@@ -0,0 +1,30 @@
+#include <stdlib.h>
+#include "check_debug.h"
+
+void test(void *a, void *b, void *c, void *d, void *e, void *f)
+{
+	free(a);
+	free(b);
+	free(c);
+	free(d);
+	free(e);
+	free(f);
+	free(f);
+}
+
+void test2(void *p)
+{
+	free(p);
+	free(p);
+}
+/*
+ * check-name: smatch: --state-budget turns a check off for the function
+ * check-command: smatch --state-budget=4 -I.. sm_state_budget1.c
+ *
+ * check-exit-value: 1
+ * check-output-ignore
+ * check-output-contains: :10 test() parse error: state budget: 'check_free' used 5 states.  Turned off for this function.
+ * check-output-excludes: double free of 'f'
+ * check-output-contains: :18 test2() error: double free of 'p'
+ * check-output-pattern(1): 'check_free' used
+ */
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Run smatch --info twice with --spool: once plain and once with -DSECOND.
+# The first run has to write the same lines as --info on stdout does, split
+# into <file>, <file>.sql and <file>.caller_info.  The second one is
+# appended.  The mtag_data tags change from run to run so those lines are
+# left out of the comparison.
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+../smatch --info $* | grep -v mtag_data | sort > $dir/stdout.txt
+../smatch --spool=$dir/out --info $*
+cat $dir/out $dir/out.sql $dir/out.caller_info | grep -v mtag_data | sort > $dir/spool.txt
+cmp -s $dir/stdout.txt $dir/spool.txt && echo "same lines"
+
+../smatch --spool=$dir/out --info -DSECOND $*
+grep -v SQL $dir/out
+echo "caller_info lines: $(wc -l < $dir/out.caller_info)"
@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Load the --info output into one DB as SQL and into another as --sql-rows
+# records and check that sm_fill_db makes the same tables from both.  Then
+# use the --sql-rows DB.  The DBs are built with -DSQL_ROWS_LIB so the file
+# can define a function only for the DB.  The mtag_data tags are different
+# for every run so that table is left out.
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+../smatch --info -DSQL_ROWS_LIB $* > $dir/sql.txt
+../smatch --info --sql-rows -DSQL_ROWS_LIB $* > $dir/rows.txt
+grep -q '() SQL_rows\?: ' $dir/rows.txt && echo "has SQL_row records"
+
+for i in sql rows ; do
+    cat ../smatch_data/db/*.schema | sqlite3 $dir/$i.sqlite > /dev/null
+    ../smatch_data/db/sm_fill_db $dir/$i.sqlite $dir/$i.txt > /dev/null 2>&1
+    sqlite3 $dir/$i.sqlite .dump | grep -v 'INSERT INTO mtag_data' | sort > $dir/$i.dump
+done
+cmp -s $dir/sql.dump $dir/rows.dump && echo "same rows"
+
+../smatch --db-file=$dir/rows.sqlite $*